@@ -0,0 +1,240 @@
+/* Build-time tool: decodes images into one texture bundle.
+ *
+ * Usage: BakeTextures [--mips] <output> <input.png>...
+ *
+ * Entries are named after the input's file name, which is what the
+ * texture loader looks them up by. With --mips every entry also gets a
+ * box-filtered mip chain down to 1x1; without it only level 0 is stored,
+ * matching what the PNG path uploads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Refresh_Image.h>
+
+#include "texture_bundle.h"
+
+static const char* BakeTextures_BaseName(const char *path)
+{
+	const char *forward = strrchr(path, '/');
+	const char *backward = strrchr(path, '\\');
+	const char *separator = (forward > backward) ? forward : backward;
+
+	return (separator != NULL) ? separator + 1 : path;
+}
+
+static uint32_t BakeTextures_LevelSide(uint32_t side, uint32_t level)
+{
+	side >>= level;
+	return (side > 0) ? side : 1;
+}
+
+static uint32_t BakeTextures_LevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t levelCount = 1;
+
+	while ((width > 1 || height > 1) && levelCount < TEXTURE_BUNDLE_MAX_LEVELS)
+	{
+		width = (width > 1) ? width / 2 : 1;
+		height = (height > 1) ? height / 2 : 1;
+		levelCount += 1;
+	}
+
+	return levelCount;
+}
+
+/* Averages 2x2 RGBA blocks of source into the next level down. An odd
+ * last row or column is folded into its neighbor by clamping.
+ */
+static void BakeTextures_Downsample(
+	const uint8_t *source,
+	uint32_t sourceWidth,
+	uint32_t sourceHeight,
+	uint8_t *destination,
+	uint32_t width,
+	uint32_t height
+) {
+	uint32_t x, y, channel;
+
+	for (y = 0; y < height; y += 1)
+	{
+		uint32_t y0 = (y * 2 < sourceHeight) ? y * 2 : sourceHeight - 1;
+		uint32_t y1 = (y * 2 + 1 < sourceHeight) ? y * 2 + 1 : sourceHeight - 1;
+
+		for (x = 0; x < width; x += 1)
+		{
+			uint32_t x0 = (x * 2 < sourceWidth) ? x * 2 : sourceWidth - 1;
+			uint32_t x1 = (x * 2 + 1 < sourceWidth) ? x * 2 + 1 : sourceWidth - 1;
+
+			for (channel = 0; channel < 4; channel += 1)
+			{
+				uint32_t sum =
+					source[(y0 * sourceWidth + x0) * 4 + channel] +
+					source[(y0 * sourceWidth + x1) * 4 + channel] +
+					source[(y1 * sourceWidth + x0) * 4 + channel] +
+					source[(y1 * sourceWidth + x1) * 4 + channel];
+
+				destination[(y * width + x) * 4 + channel] = (uint8_t) ((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+/* Returns every level of one image back to back, level 0 first */
+static uint8_t* BakeTextures_Load(const char *path, TextureBundleEntry *entry, int mips)
+{
+	int32_t width, height, channelCount;
+	uint8_t *pixels = REFRESH_Image_Load(path, &width, &height, &channelCount);
+	uint8_t *levels, *level;
+	uint32_t i, size, totalSize;
+
+	if (pixels == NULL || width <= 0 || height <= 0)
+	{
+		return NULL;
+	}
+
+	entry->format = TEXTURE_BUNDLE_FORMAT_RGBA8;
+	entry->width = (uint32_t) width;
+	entry->height = (uint32_t) height;
+	entry->levelCount = mips ? BakeTextures_LevelCount(entry->width, entry->height) : 1;
+
+	totalSize = 0;
+	for (i = 0; i < entry->levelCount; i += 1)
+	{
+		totalSize += BakeTextures_LevelSide(entry->width, i) * BakeTextures_LevelSide(entry->height, i) * 4;
+	}
+
+	levels = malloc(totalSize);
+	memcpy(levels, pixels, entry->width * entry->height * 4);
+	REFRESH_Image_Free(pixels);
+
+	level = levels;
+	for (i = 1; i < entry->levelCount; i += 1)
+	{
+		size = BakeTextures_LevelSide(entry->width, i - 1) * BakeTextures_LevelSide(entry->height, i - 1) * 4;
+		BakeTextures_Downsample(
+			level,
+			BakeTextures_LevelSide(entry->width, i - 1),
+			BakeTextures_LevelSide(entry->height, i - 1),
+			level + size,
+			BakeTextures_LevelSide(entry->width, i),
+			BakeTextures_LevelSide(entry->height, i)
+		);
+		level += size;
+	}
+
+	return levels;
+}
+
+int main(int argc, char *argv[])
+{
+	static const uint8_t padding[TEXTURE_BUNDLE_ALIGNMENT] = { 0 };
+	TextureBundleHeader header;
+	TextureBundleEntry *entries;
+	uint8_t **contents;
+	uint32_t entryCount, offset, level, size, i;
+	const char *name;
+	const char *outputPath;
+	FILE *output;
+	int mips = 0;
+	int firstInput = 1;
+	int result = 0;
+
+	if (argc > 1 && strcmp(argv[1], "--mips") == 0)
+	{
+		mips = 1;
+		firstInput += 1;
+	}
+
+	if (argc < firstInput + 2)
+	{
+		fprintf(stderr, "Usage: %s [--mips] <output> <input.png>...\n", argv[0]);
+		return 1;
+	}
+
+	outputPath = argv[firstInput];
+	firstInput += 1;
+
+	entryCount = (uint32_t) (argc - firstInput);
+	entries = calloc(entryCount, sizeof(TextureBundleEntry));
+	contents = calloc(entryCount, sizeof(uint8_t*));
+
+	offset = sizeof(TextureBundleHeader) + entryCount * sizeof(TextureBundleEntry);
+
+	for (i = 0; i < entryCount; i += 1)
+	{
+		name = BakeTextures_BaseName(argv[firstInput + i]);
+		if (strlen(name) >= TEXTURE_BUNDLE_NAME_LENGTH)
+		{
+			fprintf(stderr, "Texture name too long for a bundle: %s\n", name);
+			result = 1;
+			break;
+		}
+
+		contents[i] = BakeTextures_Load(argv[firstInput + i], &entries[i], mips);
+		if (contents[i] == NULL)
+		{
+			fprintf(stderr, "Could not decode %s\n", argv[firstInput + i]);
+			result = 1;
+			break;
+		}
+
+		strcpy(entries[i].name, name);
+
+		for (level = 0; level < entries[i].levelCount; level += 1)
+		{
+			offset = (offset + TEXTURE_BUNDLE_ALIGNMENT - 1) & ~(uint32_t) (TEXTURE_BUNDLE_ALIGNMENT - 1);
+			entries[i].levelOffset[level] = offset;
+			offset += BakeTextures_LevelSide(entries[i].width, level) * BakeTextures_LevelSide(entries[i].height, level) * 4;
+		}
+	}
+
+	if (result == 0)
+	{
+		output = fopen(outputPath, "wb");
+		if (output == NULL)
+		{
+			fprintf(stderr, "Could not open %s for writing\n", outputPath);
+			result = 1;
+		}
+		else
+		{
+			header.magic = TEXTURE_BUNDLE_MAGIC;
+			header.version = TEXTURE_BUNDLE_VERSION;
+			header.entryCount = entryCount;
+			header.reserved = 0;
+
+			fwrite(&header, sizeof(header), 1, output);
+			fwrite(entries, sizeof(TextureBundleEntry), entryCount, output);
+
+			offset = sizeof(TextureBundleHeader) + entryCount * sizeof(TextureBundleEntry);
+			for (i = 0; i < entryCount; i += 1)
+			{
+				const uint8_t *levelData = contents[i];
+
+				for (level = 0; level < entries[i].levelCount; level += 1)
+				{
+					size = BakeTextures_LevelSide(entries[i].width, level) * BakeTextures_LevelSide(entries[i].height, level) * 4;
+
+					fwrite(padding, 1, entries[i].levelOffset[level] - offset, output);
+					fwrite(levelData, 1, size, output);
+					levelData += size;
+					offset = entries[i].levelOffset[level] + size;
+				}
+			}
+
+			fclose(output);
+		}
+	}
+
+	for (i = 0; i < entryCount; i += 1)
+	{
+		free(contents[i]);
+	}
+	free(contents);
+	free(entries);
+
+	return result;
+}
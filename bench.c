@@ -0,0 +1,349 @@
+#include "bench.h"
+
+#include <stdio.h>
+
+#include <SDL.h>
+
+typedef struct BenchSeries
+{
+	double *samples;
+	uint32_t count;
+	uint32_t capacity;
+} BenchSeries;
+
+struct BenchReport
+{
+	BenchSeries series[BENCH_PHASE_COUNT];
+};
+
+static const char *phaseNames[BENCH_PHASE_COUNT] =
+{
+	"init",
+	"shader_load",
+	"pipeline_create",
+	"texture_upload",
+	"buffer_upload",
+	"simulate",
+	"render",
+	"frame_wait",
+	"readback",
+	"reorder"
+};
+
+BenchReport* BenchReport_Create(void)
+{
+	BenchReport *report = SDL_malloc(sizeof(BenchReport));
+	SDL_memset(report, 0, sizeof(BenchReport));
+	return report;
+}
+
+void BenchReport_Destroy(BenchReport *report)
+{
+	uint32_t i;
+
+	if (report == NULL)
+	{
+		return;
+	}
+
+	for (i = 0; i < BENCH_PHASE_COUNT; i += 1)
+	{
+		SDL_free(report->series[i].samples);
+	}
+	SDL_free(report);
+}
+
+uint64_t Bench_Now(void)
+{
+	return SDL_GetPerformanceCounter();
+}
+
+double Bench_Seconds(uint64_t start, uint64_t end)
+{
+	return (end - start) / (double) SDL_GetPerformanceFrequency();
+}
+
+void BenchReport_AddSample(BenchReport *report, BenchPhase phase, double seconds)
+{
+	BenchSeries *series = &report->series[phase];
+
+	if (series->count == series->capacity)
+	{
+		series->capacity = SDL_max(series->capacity * 2, 64);
+		series->samples = SDL_realloc(series->samples, sizeof(double) * series->capacity);
+	}
+
+	series->samples[series->count] = seconds;
+	series->count += 1;
+}
+
+uint64_t BenchReport_AddSince(BenchReport *report, BenchPhase phase, uint64_t start)
+{
+	uint64_t now = Bench_Now();
+	BenchReport_AddSample(report, phase, Bench_Seconds(start, now));
+	return now;
+}
+
+static int Bench_CompareDouble(const void *a, const void *b)
+{
+	double x = *(const double*) a;
+	double y = *(const double*) b;
+	return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of a sorted array */
+static double Bench_Percentile(const double *sorted, uint32_t count, double percentile)
+{
+	uint32_t rank = (uint32_t) SDL_ceil(percentile * count);
+	rank = SDL_min(SDL_max(rank, 1), count);
+	return sorted[rank - 1];
+}
+
+void BenchReport_GetStats(BenchReport *report, BenchPhase phase, BenchStats *stats)
+{
+	uint32_t i;
+	BenchSeries *series = &report->series[phase];
+	double *sorted;
+
+	SDL_memset(stats, 0, sizeof(BenchStats));
+	stats->sampleCount = series->count;
+
+	if (series->count == 0)
+	{
+		return;
+	}
+
+	sorted = SDL_malloc(sizeof(double) * series->count);
+	SDL_memcpy(sorted, series->samples, sizeof(double) * series->count);
+	SDL_qsort(sorted, series->count, sizeof(double), Bench_CompareDouble);
+
+	for (i = 0; i < series->count; i += 1)
+	{
+		stats->total += sorted[i];
+	}
+
+	stats->min = sorted[0];
+	stats->median = Bench_Percentile(sorted, series->count, 0.5);
+	stats->p99 = Bench_Percentile(sorted, series->count, 0.99);
+	stats->mean = stats->total / series->count;
+
+	SDL_free(sorted);
+}
+
+const char* Bench_GetPhaseName(BenchPhase phase)
+{
+	return phaseNames[phase];
+}
+
+uint64_t Bench_Checksum(const void *data, uint64_t length)
+{
+	uint64_t i;
+	uint64_t hash = 0xCBF29CE484222325ull;
+	const uint8_t *bytes = (const uint8_t*) data;
+
+	for (i = 0; i < length; i += 1)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ull;
+	}
+
+	return hash;
+}
+
+static double BenchReport_ParticlesPerSecond(BenchReport *report, const BenchInfo *info)
+{
+	BenchStats stats;
+	BenchReport_GetStats(report, BENCH_PHASE_SIMULATE, &stats);
+	return (stats.median > 0.0) ? ((double) info->particleCount * info->substepCount / stats.median) : 0.0;
+}
+
+void BenchReport_Log(BenchReport *report, const BenchInfo *info)
+{
+	uint32_t i;
+	BenchStats stats;
+
+	SDL_Log(
+		"benchmark: backend %s, kernel %s, layout %s, %u threads, %u particles, %u frames x %u steps, %u in flight, neighbor radius %g, mesh %u, seed %u, checksum %016llx",
+		info->backend,
+		info->kernel,
+		info->layout,
+		info->threadCount,
+		info->particleCount,
+		info->frameCount,
+		info->substepCount,
+		info->framesInFlight,
+		info->neighborRadius,
+		info->meshSize,
+		info->seed,
+		(unsigned long long) info->checksum
+	);
+
+	for (i = 0; i < BENCH_PHASE_COUNT; i += 1)
+	{
+		BenchReport_GetStats(report, (BenchPhase) i, &stats);
+		if (stats.sampleCount == 0)
+		{
+			continue;
+		}
+
+		SDL_Log(
+			"  %-16s n=%-6u min %9.3f ms  median %9.3f ms  p99 %9.3f ms  total %9.3f ms",
+			phaseNames[i],
+			stats.sampleCount,
+			stats.min * 1000.0,
+			stats.median * 1000.0,
+			stats.p99 * 1000.0,
+			stats.total * 1000.0
+		);
+	}
+
+	if (info->startupSeconds > 0.0)
+	{
+		SDL_Log(
+			"  startup          %s %.3f ms, last cold start %.3f ms",
+			info->startup,
+			info->startupSeconds * 1000.0,
+			info->coldStartupSeconds * 1000.0
+		);
+	}
+
+	if (info->frameRate > 0.0)
+	{
+		SDL_Log(
+			"  pacing           %s at %.2f Hz, %u of %u frames missed their deadline, input to submit median %.3f ms p99 %.3f ms",
+			info->pacing,
+			info->frameRate,
+			info->paced.missedCount,
+			info->paced.frameCount,
+			info->paced.latencyMedian * 1000.0,
+			info->paced.latencyP99 * 1000.0
+		);
+	}
+	else
+	{
+		SDL_Log(
+			"  pacing           %s, input to submit median %.3f ms p99 %.3f ms",
+			info->pacing,
+			info->paced.latencyMedian * 1000.0,
+			info->paced.latencyP99 * 1000.0
+		);
+	}
+
+	SDL_Log("  throughput       %.3f Mparticles/s", BenchReport_ParticlesPerSecond(report, info) / 1e6);
+}
+
+bool BenchReport_WriteJSON(BenchReport *report, const BenchInfo *info, const char *path)
+{
+	uint32_t i;
+	BenchStats stats;
+	FILE *file = fopen(path, "w");
+
+	if (file == NULL)
+	{
+		SDL_Log("Could not open %s for writing", path);
+		return false;
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "\t\"backend\": \"%s\",\n", info->backend);
+	fprintf(file, "\t\"kernel\": \"%s\",\n", info->kernel);
+	fprintf(file, "\t\"layout\": \"%s\",\n", info->layout);
+	fprintf(file, "\t\"threads\": %u,\n", info->threadCount);
+	fprintf(file, "\t\"particles\": %u,\n", info->particleCount);
+	fprintf(file, "\t\"frames\": %u,\n", info->frameCount);
+	fprintf(file, "\t\"substeps\": %u,\n", info->substepCount);
+	fprintf(file, "\t\"framesInFlight\": %u,\n", info->framesInFlight);
+	fprintf(file, "\t\"neighborRadius\": %g,\n", info->neighborRadius);
+	fprintf(file, "\t\"meshSize\": %u,\n", info->meshSize);
+	fprintf(file, "\t\"seed\": %u,\n", info->seed);
+	fprintf(file, "\t\"startup\": \"%s\",\n", info->startup);
+	fprintf(file, "\t\"startupMs\": %.6f,\n", info->startupSeconds * 1000.0);
+	fprintf(file, "\t\"coldStartupMs\": %.6f,\n", info->coldStartupSeconds * 1000.0);
+	fprintf(file, "\t\"checksum\": \"%016llx\",\n", (unsigned long long) info->checksum);
+	fprintf(file, "\t\"particlesPerSecond\": %.1f,\n", BenchReport_ParticlesPerSecond(report, info));
+	fprintf(file, "\t\"pacing\": \"%s\",\n", info->pacing);
+	fprintf(file, "\t\"frameRate\": %.6f,\n", info->frameRate);
+	fprintf(file, "\t\"missedDeadlines\": %u,\n", info->paced.missedCount);
+	fprintf(file, "\t\"pacedFrameMedianMs\": %.6f,\n", info->paced.frameMedian * 1000.0);
+	fprintf(file, "\t\"pacedFrameP99Ms\": %.6f,\n", info->paced.frameP99 * 1000.0);
+	fprintf(file, "\t\"inputToSubmitMedianMs\": %.6f,\n", info->paced.latencyMedian * 1000.0);
+	fprintf(file, "\t\"inputToSubmitP99Ms\": %.6f,\n", info->paced.latencyP99 * 1000.0);
+	fprintf(file, "\t\"phases\": {\n");
+
+	for (i = 0; i < BENCH_PHASE_COUNT; i += 1)
+	{
+		BenchReport_GetStats(report, (BenchPhase) i, &stats);
+		fprintf(
+			file,
+			"\t\t\"%s\": { \"samples\": %u, \"totalMs\": %.6f, \"minMs\": %.6f, \"medianMs\": %.6f, \"p99Ms\": %.6f, \"meanMs\": %.6f }%s\n",
+			phaseNames[i],
+			stats.sampleCount,
+			stats.total * 1000.0,
+			stats.min * 1000.0,
+			stats.median * 1000.0,
+			stats.p99 * 1000.0,
+			stats.mean * 1000.0,
+			(i + 1 < BENCH_PHASE_COUNT) ? "," : ""
+		);
+	}
+
+	fprintf(file, "\t}\n");
+	fprintf(file, "}\n");
+
+	fclose(file);
+	return true;
+}
+
+bool BenchReport_WriteCSV(BenchReport *report, const BenchInfo *info, const char *path)
+{
+	uint32_t i;
+	BenchStats stats;
+	FILE *file = fopen(path, "w");
+
+	if (file == NULL)
+	{
+		SDL_Log("Could not open %s for writing", path);
+		return false;
+	}
+
+	fprintf(file, "backend,kernel,layout,threads,particles,frames,substeps,frames_in_flight,neighbor_radius,mesh_size,seed,startup,startup_ms,cold_startup_ms,pacing,frame_rate,missed_deadlines,input_to_submit_median_ms,input_to_submit_p99_ms,phase,samples,total_ms,min_ms,median_ms,p99_ms,mean_ms,particles_per_second\n");
+
+	for (i = 0; i < BENCH_PHASE_COUNT; i += 1)
+	{
+		BenchReport_GetStats(report, (BenchPhase) i, &stats);
+		fprintf(
+			file,
+			"%s,%s,%s,%u,%u,%u,%u,%u,%g,%u,%u,%s,%.6f,%.6f,%s,%g,%u,%.6f,%.6f,%s,%u,%.6f,%.6f,%.6f,%.6f,%.6f,%.1f\n",
+			info->backend,
+			info->kernel,
+			info->layout,
+			info->threadCount,
+			info->particleCount,
+			info->frameCount,
+			info->substepCount,
+			info->framesInFlight,
+			info->neighborRadius,
+			info->meshSize,
+			info->seed,
+			info->startup,
+			info->startupSeconds * 1000.0,
+			info->coldStartupSeconds * 1000.0,
+			info->pacing,
+			info->frameRate,
+			info->paced.missedCount,
+			info->paced.latencyMedian * 1000.0,
+			info->paced.latencyP99 * 1000.0,
+			phaseNames[i],
+			stats.sampleCount,
+			stats.total * 1000.0,
+			stats.min * 1000.0,
+			stats.median * 1000.0,
+			stats.p99 * 1000.0,
+			stats.mean * 1000.0,
+			(i == BENCH_PHASE_SIMULATE) ? BenchReport_ParticlesPerSecond(report, info) : 0.0
+		);
+	}
+
+	fclose(file);
+	return true;
+}
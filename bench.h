@@ -0,0 +1,85 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "frame_pacer.h"
+
+/* Per-phase timing collection for headless runs.
+ *
+ * Every phase keeps all of its samples so that order statistics can be
+ * reported; one-shot phases such as shader loading simply have one sample.
+ */
+
+typedef enum BenchPhase
+{
+	BENCH_PHASE_INIT,
+	BENCH_PHASE_SHADER_LOAD,
+	BENCH_PHASE_PIPELINE_CREATE,
+	BENCH_PHASE_TEXTURE_UPLOAD,
+	BENCH_PHASE_BUFFER_UPLOAD,
+	BENCH_PHASE_SIMULATE,
+	BENCH_PHASE_RENDER, /* CPU splatting; GPU rendering is part of the simulate interval */
+	BENCH_PHASE_FRAME_WAIT, /* CPU blocked on an earlier frame before it could submit */
+	BENCH_PHASE_READBACK,
+	BENCH_PHASE_REORDER, /* CPU Morton sorts; GPU ones are part of the simulate interval */
+	BENCH_PHASE_COUNT
+} BenchPhase;
+
+typedef struct BenchStats
+{
+	uint32_t sampleCount;
+	double total;
+	double min;
+	double median;
+	double p99;
+	double mean;
+} BenchStats;
+
+typedef struct BenchInfo
+{
+	const char *backend;
+	const char *kernel;
+	const char *layout;
+	uint32_t threadCount;
+	uint32_t particleCount;
+	uint32_t frameCount;
+	uint32_t substepCount; /* simulation steps per frame */
+	uint32_t framesInFlight;
+	float neighborRadius; /* 0 when neighbor interaction is off */
+	uint32_t meshSize;    /* 0 when mesh gravity is off */
+	uint32_t seed;
+	const char *startup;       /* "cold", "warm", or "off" without a pipeline cache */
+	double startupSeconds;     /* process start until every pipeline exists */
+	double coldStartupSeconds; /* of the last cold start, 0 if unknown */
+	uint64_t checksum; /* FNV-1a of the final particle state */
+	const char *pacing;     /* frame pacing mode, run on the simulated clock */
+	double frameRate;       /* of the pacing, 0 for throughput */
+	FramePacerStats paced;
+} BenchInfo;
+
+typedef struct BenchReport BenchReport;
+
+BenchReport* BenchReport_Create(void);
+void BenchReport_Destroy(BenchReport *report);
+
+/* Timestamps are SDL performance counter ticks */
+uint64_t Bench_Now(void);
+double Bench_Seconds(uint64_t start, uint64_t end);
+
+void BenchReport_AddSample(BenchReport *report, BenchPhase phase, double seconds);
+
+/* Convenience for Bench_Seconds(start, Bench_Now()); returns the new "now" */
+uint64_t BenchReport_AddSince(BenchReport *report, BenchPhase phase, uint64_t start);
+
+void BenchReport_GetStats(BenchReport *report, BenchPhase phase, BenchStats *stats);
+const char* Bench_GetPhaseName(BenchPhase phase);
+
+uint64_t Bench_Checksum(const void *data, uint64_t length);
+
+void BenchReport_Log(BenchReport *report, const BenchInfo *info);
+bool BenchReport_WriteJSON(BenchReport *report, const BenchInfo *info, const char *path);
+bool BenchReport_WriteCSV(BenchReport *report, const BenchInfo *info, const char *path);
+
+#endif /* BENCH_H */
@@ -0,0 +1,1110 @@
+/* Benchmark suite: times the simulation step over a sweep of particle
+ * counts, and for each count over the CPU kernels and thread counts and
+ * the device layouts, substep modes and workgroup sizes. The Morton
+ * reorder is timed alongside, as kernel "reorder" with one sort per step.
+ *
+ * Usage: RefreshComputeBench [options], see --help
+ *
+ * The CPU cases always run; the device cases run when a device can be
+ * created. Every case is one row of CSV, and with --baseline the medians
+ * are compared against an earlier run's CSV, so a kernel change that slows
+ * a case by more than its threshold fails the run (exit code 1).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <SDL.h>
+#include <Refresh.h>
+
+#include "bench.h"
+#include "compute_pass.h"
+#include "cpu_sim.h"
+#include "dispatch_tuner.h"
+#include "particle.h"
+#include "particle_buffers.h"
+#include "particle_reorder.h"
+#include "particle_reorder_gpu.h"
+#include "shader_module.h"
+#include "thread_pool.h"
+
+#define BENCH_SUITE_MAX_VALUES 16
+#define BENCH_SUITE_KERNEL_LENGTH 32
+#define BENCH_SUITE_LINE_LENGTH 512
+
+typedef struct BenchSuiteList
+{
+	uint32_t values[BENCH_SUITE_MAX_VALUES];
+	uint32_t count;
+} BenchSuiteList;
+
+typedef struct BenchSuiteOptions
+{
+	BenchSuiteList counts;
+	BenchSuiteList threads;
+	BenchSuiteList kernels;        /* CPUSimKernel */
+	BenchSuiteList layouts;        /* ParticleLayout */
+	BenchSuiteList workgroupSizes;
+	uint32_t steps;   /* simulation steps per sample */
+	uint32_t samples;
+	uint32_t seed;
+	bool cpu;
+	bool device;
+	const char *shaderBundlePath;
+	const char *csvPath;
+	const char *baselinePath;
+	double threshold; /* allowed slowdown of the median, 0.1 = 10% */
+} BenchSuiteOptions;
+
+typedef struct BenchSuiteResult
+{
+	const char *backend;
+	char kernel[BENCH_SUITE_KERNEL_LENGTH];
+	const char *layout;
+	uint32_t threads;
+	uint32_t workgroupSize; /* 0 on the CPU */
+	uint32_t particleCount;
+	uint32_t steps;
+	uint32_t samples;
+
+	/* Per step */
+	double medianSeconds;
+	double minSeconds;
+	double p99Seconds;
+} BenchSuiteResult;
+
+typedef struct BenchSuiteResults
+{
+	BenchSuiteResult *results;
+	uint32_t count;
+	uint32_t capacity;
+} BenchSuiteResults;
+
+static const char *csvHeader =
+	"backend,kernel,layout,threads,workgroup,particles,steps,samples,median_ms,min_ms,p99_ms,mparticles_per_s,threshold";
+
+/* Options */
+
+static void BenchSuite_PrintUsage(const char *programName)
+{
+	SDL_Log(
+		"Usage: %s [options]\n"
+		"  --counts LIST           particle counts, K and M suffixes allowed (default 64K,256K,1M,4M,16M,64M)\n"
+		"  --threads LIST          CPU thread counts (default powers of two up to the core count, and it)\n"
+		"  --kernels LIST          CPU kernels: scalar, sse2, avx2 (default every one this CPU runs)\n"
+		"  --layouts LIST          device layouts: interleaved, split, quantized (default all)\n"
+		"  --workgroup-sizes LIST  device workgroup sizes, each run with every particles per\n"
+		"                          invocation it is built for (default every built size)\n"
+		"  --steps N               simulation steps per sample (default 8)\n"
+		"  --samples N             samples per case, after one warm-up (default 5)\n"
+		"  --seed N                initial state seed (default 1)\n"
+		"  --no-cpu                skip the CPU cases\n"
+		"  --no-device             skip the device cases\n"
+		"  --shader-bundle PATH    SPIR-V bundle for the device cases (default shaders.bundle)\n"
+		"  --csv PATH              write the results as CSV\n"
+		"  --baseline PATH         compare against the CSV of an earlier run\n"
+		"  --threshold F           allowed slowdown of a case's median over the baseline\n"
+		"                          (default 0.1); a baseline row's threshold column overrides it\n"
+		"Lists are comma separated.",
+		programName
+	);
+}
+
+static bool BenchSuite_ParseCount(const char *value, uint32_t *count)
+{
+	char *end;
+	unsigned long long parsed = SDL_strtoull(value, &end, 10);
+
+	if (end == value)
+	{
+		return false;
+	}
+	if (*end == 'K' || *end == 'k')
+	{
+		parsed *= 1024;
+		end += 1;
+	}
+	else if (*end == 'M' || *end == 'm')
+	{
+		parsed *= 1024 * 1024;
+		end += 1;
+	}
+
+	if (*end != '\0' || parsed == 0 || parsed > UINT32_MAX)
+	{
+		return false;
+	}
+
+	*count = (uint32_t) parsed;
+	return true;
+}
+
+static bool BenchSuite_ParseKernel(const char *value, uint32_t *kernel)
+{
+	if (SDL_strcmp(value, "scalar") == 0)
+	{
+		*kernel = CPUSIM_KERNEL_SCALAR;
+	}
+	else if (SDL_strcmp(value, "sse2") == 0)
+	{
+		*kernel = CPUSIM_KERNEL_SSE2;
+	}
+	else if (SDL_strcmp(value, "avx2") == 0)
+	{
+		*kernel = CPUSIM_KERNEL_AVX2;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+static bool BenchSuite_ParseLayout(const char *value, uint32_t *layout)
+{
+	if (SDL_strcmp(value, "interleaved") == 0)
+	{
+		*layout = PARTICLE_LAYOUT_INTERLEAVED;
+	}
+	else if (SDL_strcmp(value, "split") == 0)
+	{
+		*layout = PARTICLE_LAYOUT_SPLIT;
+	}
+	else if (SDL_strcmp(value, "quantized") == 0)
+	{
+		*layout = PARTICLE_LAYOUT_QUANTIZED;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+static bool BenchSuite_ParseList(
+	const char *option,
+	const char *value,
+	bool (*parse)(const char *value, uint32_t *parsed),
+	BenchSuiteList *list
+) {
+	char item[64];
+	const char *start = value;
+	const char *end;
+	size_t length;
+
+	list->count = 0;
+	while (true)
+	{
+		end = SDL_strchr(start, ',');
+		length = (end != NULL) ? (size_t) (end - start) : SDL_strlen(start);
+
+		if (list->count == BENCH_SUITE_MAX_VALUES)
+		{
+			SDL_Log("%s takes at most %d values", option, BENCH_SUITE_MAX_VALUES);
+			return false;
+		}
+		if (length == 0 || length >= sizeof(item))
+		{
+			SDL_Log("Bad value for %s: %s", option, value);
+			return false;
+		}
+
+		SDL_memcpy(item, start, length);
+		item[length] = '\0';
+		if (!parse(item, &list->values[list->count]))
+		{
+			SDL_Log("Bad value for %s: %s", option, item);
+			return false;
+		}
+		list->count += 1;
+
+		if (end == NULL)
+		{
+			return true;
+		}
+		start = end + 1;
+	}
+}
+
+static void BenchSuite_AddValue(BenchSuiteList *list, uint32_t value)
+{
+	if (list->count < BENCH_SUITE_MAX_VALUES)
+	{
+		list->values[list->count++] = value;
+	}
+}
+
+static bool BenchSuite_ListContains(const BenchSuiteList *list, uint32_t value)
+{
+	uint32_t i;
+
+	for (i = 0; i < list->count; i += 1)
+	{
+		if (list->values[i] == value)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Kernels that CPUSim would not fall back from */
+static bool BenchSuite_KernelSupported(CPUSimKernel kernel)
+{
+	CPUSim *sim = CPUSim_Create(0, kernel, NULL);
+	bool supported = CPUSim_GetKernel(sim) == kernel;
+
+	CPUSim_Destroy(sim);
+	return supported;
+}
+
+static void BenchSuite_SetDefaults(BenchSuiteOptions *options)
+{
+	uint32_t coreCount = (uint32_t) SDL_max(SDL_GetCPUCount(), 1);
+	uint32_t count, threads, kernel, i;
+	DispatchVariant variant;
+
+	SDL_zerop(options);
+
+	for (count = 64 * 1024; count <= 64 * 1024 * 1024; count *= 4)
+	{
+		BenchSuite_AddValue(&options->counts, count);
+	}
+
+	for (threads = 1; threads < coreCount; threads *= 2)
+	{
+		BenchSuite_AddValue(&options->threads, threads);
+	}
+	BenchSuite_AddValue(&options->threads, coreCount);
+
+	for (kernel = CPUSIM_KERNEL_SCALAR; kernel <= CPUSIM_KERNEL_AVX2; kernel += 1)
+	{
+		if (BenchSuite_KernelSupported((CPUSimKernel) kernel))
+		{
+			BenchSuite_AddValue(&options->kernels, kernel);
+		}
+	}
+
+	BenchSuite_AddValue(&options->layouts, PARTICLE_LAYOUT_INTERLEAVED);
+	BenchSuite_AddValue(&options->layouts, PARTICLE_LAYOUT_SPLIT);
+	BenchSuite_AddValue(&options->layouts, PARTICLE_LAYOUT_QUANTIZED);
+
+	for (i = 0; i < DispatchVariant_GetCount(); i += 1)
+	{
+		variant = DispatchVariant_Get(i);
+		if (!BenchSuite_ListContains(&options->workgroupSizes, variant.workgroupSize))
+		{
+			BenchSuite_AddValue(&options->workgroupSizes, variant.workgroupSize);
+		}
+	}
+
+	options->steps = 8;
+	options->samples = 5;
+	options->seed = 1;
+	options->cpu = true;
+	options->device = true;
+	options->shaderBundlePath = "shaders.bundle";
+	options->threshold = 0.1;
+}
+
+static const char* BenchSuite_NextValue(int argc, char *argv[], int *i)
+{
+	if (*i + 1 >= argc)
+	{
+		SDL_Log("Missing value for %s", argv[*i]);
+		return NULL;
+	}
+	*i += 1;
+	return argv[*i];
+}
+
+static bool BenchSuite_ParseOptions(BenchSuiteOptions *options, int argc, char *argv[])
+{
+	int i;
+	const char *value;
+	uint32_t parsed;
+
+	BenchSuite_SetDefaults(options);
+
+	for (i = 1; i < argc; i += 1)
+	{
+		const char *arg = argv[i];
+
+		if (SDL_strcmp(arg, "--help") == 0)
+		{
+			BenchSuite_PrintUsage(argv[0]);
+			return false;
+		}
+		else if (SDL_strcmp(arg, "--no-cpu") == 0)
+		{
+			options->cpu = false;
+			continue;
+		}
+		else if (SDL_strcmp(arg, "--no-device") == 0)
+		{
+			options->device = false;
+			continue;
+		}
+
+		if ((value = BenchSuite_NextValue(argc, argv, &i)) == NULL)
+		{
+			return false;
+		}
+
+		if (SDL_strcmp(arg, "--counts") == 0)
+		{
+			if (!BenchSuite_ParseList(arg, value, BenchSuite_ParseCount, &options->counts))
+			{
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--threads") == 0)
+		{
+			if (!BenchSuite_ParseList(arg, value, BenchSuite_ParseCount, &options->threads))
+			{
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--workgroup-sizes") == 0)
+		{
+			if (!BenchSuite_ParseList(arg, value, BenchSuite_ParseCount, &options->workgroupSizes))
+			{
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--kernels") == 0)
+		{
+			if (!BenchSuite_ParseList(arg, value, BenchSuite_ParseKernel, &options->kernels))
+			{
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--layouts") == 0)
+		{
+			if (!BenchSuite_ParseList(arg, value, BenchSuite_ParseLayout, &options->layouts))
+			{
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--steps") == 0 || SDL_strcmp(arg, "--samples") == 0 || SDL_strcmp(arg, "--seed") == 0)
+		{
+			if (!BenchSuite_ParseCount(value, &parsed))
+			{
+				SDL_Log("Bad value for %s: %s", arg, value);
+				return false;
+			}
+
+			if (SDL_strcmp(arg, "--steps") == 0)
+			{
+				options->steps = parsed;
+			}
+			else if (SDL_strcmp(arg, "--samples") == 0)
+			{
+				options->samples = parsed;
+			}
+			else
+			{
+				options->seed = parsed;
+			}
+		}
+		else if (SDL_strcmp(arg, "--shader-bundle") == 0)
+		{
+			options->shaderBundlePath = value;
+		}
+		else if (SDL_strcmp(arg, "--csv") == 0)
+		{
+			options->csvPath = value;
+		}
+		else if (SDL_strcmp(arg, "--baseline") == 0)
+		{
+			options->baselinePath = value;
+		}
+		else if (SDL_strcmp(arg, "--threshold") == 0)
+		{
+			options->threshold = SDL_strtod(value, NULL);
+			if (options->threshold < 0.0)
+			{
+				SDL_Log("--threshold must not be negative");
+				return false;
+			}
+		}
+		else
+		{
+			SDL_Log("Unknown option: %s", arg);
+			BenchSuite_PrintUsage(argv[0]);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Results */
+
+static BenchSuiteResult* BenchSuite_AddResult(
+	BenchSuiteResults *results,
+	const char *backend,
+	const char *kernel,
+	const char *layout,
+	uint32_t threads,
+	uint32_t workgroupSize,
+	uint32_t particleCount,
+	uint32_t steps,
+	BenchReport *report
+) {
+	BenchSuiteResult *result;
+	BenchStats stats;
+
+	if (results->count == results->capacity)
+	{
+		results->capacity = SDL_max(results->capacity * 2, 64);
+		results->results = SDL_realloc(results->results, sizeof(BenchSuiteResult) * results->capacity);
+	}
+
+	BenchReport_GetStats(report, BENCH_PHASE_SIMULATE, &stats);
+
+	result = &results->results[results->count++];
+	result->backend = backend;
+	SDL_strlcpy(result->kernel, kernel, sizeof(result->kernel));
+	result->layout = layout;
+	result->threads = threads;
+	result->workgroupSize = workgroupSize;
+	result->particleCount = particleCount;
+	result->steps = steps;
+	result->samples = stats.sampleCount;
+	result->medianSeconds = stats.median / steps;
+	result->minSeconds = stats.min / steps;
+	result->p99Seconds = stats.p99 / steps;
+
+	SDL_Log(
+		"%s %s %s, %u threads, workgroup %u, %u particles: %.3f ms/step median, %.3f min, %.3f p99, %.1f Mparticles/s",
+		result->backend,
+		result->kernel,
+		result->layout,
+		result->threads,
+		result->workgroupSize,
+		result->particleCount,
+		result->medianSeconds * 1e3,
+		result->minSeconds * 1e3,
+		result->p99Seconds * 1e3,
+		result->particleCount / result->medianSeconds * 1e-6
+	);
+
+	return result;
+}
+
+static bool BenchSuite_WriteCSV(const BenchSuiteResults *results, const char *path)
+{
+	const BenchSuiteResult *result;
+	uint32_t i;
+	FILE *file = fopen(path, "w");
+
+	if (file == NULL)
+	{
+		SDL_Log("Could not open %s for writing", path);
+		return false;
+	}
+
+	fprintf(file, "%s\n", csvHeader);
+	for (i = 0; i < results->count; i += 1)
+	{
+		result = &results->results[i];
+		fprintf(
+			file,
+			"%s,%s,%s,%u,%u,%u,%u,%u,%.6f,%.6f,%.6f,%.3f,\n",
+			result->backend,
+			result->kernel,
+			result->layout,
+			result->threads,
+			result->workgroupSize,
+			result->particleCount,
+			result->steps,
+			result->samples,
+			result->medianSeconds * 1e3,
+			result->minSeconds * 1e3,
+			result->p99Seconds * 1e3,
+			result->particleCount / result->medianSeconds * 1e-6
+		);
+	}
+
+	fclose(file);
+	SDL_Log("Wrote %u results to %s", results->count, path);
+	return true;
+}
+
+/* Splits a CSV line in place; returns the number of fields */
+static uint32_t BenchSuite_SplitLine(char *line, char **fields, uint32_t maxFields)
+{
+	uint32_t count = 0;
+	char *end = line + SDL_strlen(line);
+
+	while (end > line && (end[-1] == '\n' || end[-1] == '\r'))
+	{
+		*--end = '\0';
+	}
+
+	while (count < maxFields)
+	{
+		fields[count++] = line;
+		line = SDL_strchr(line, ',');
+		if (line == NULL)
+		{
+			break;
+		}
+		*line++ = '\0';
+	}
+
+	return count;
+}
+
+/* Compares every result with the baseline row for the same case, which is
+ * matched on every column up to and including the particle count. Cases
+ * missing from either side are reported but do not fail the run. Returns
+ * the number of regressions, or -1 if the baseline could not be read.
+ */
+static int BenchSuite_CompareBaseline(const BenchSuiteResults *results, const char *path, double defaultThreshold)
+{
+	char line[BENCH_SUITE_LINE_LENGTH];
+	char *fields[13];
+	bool *matched;
+	const BenchSuiteResult *result;
+	double baselineMedian, threshold, change;
+	uint32_t fieldCount, i;
+	uint32_t lineNumber = 0;
+	uint32_t compared = 0;
+	uint32_t improved = 0;
+	uint32_t missing = 0;
+	int regressions = 0;
+	FILE *file = fopen(path, "r");
+
+	if (file == NULL)
+	{
+		SDL_Log("Could not open baseline %s", path);
+		return -1;
+	}
+
+	matched = SDL_calloc(SDL_max(results->count, 1), sizeof(bool));
+
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		lineNumber += 1;
+		if (lineNumber == 1 && SDL_strncmp(line, "backend,", 8) == 0)
+		{
+			continue;
+		}
+
+		fieldCount = BenchSuite_SplitLine(line, fields, SDL_arraysize(fields));
+		if (fieldCount < 11)
+		{
+			if (fieldCount > 1 || fields[0][0] != '\0')
+			{
+				SDL_Log("%s:%u: expected at least 11 columns, skipped", path, lineNumber);
+			}
+			continue;
+		}
+
+		for (i = 0; i < results->count; i += 1)
+		{
+			result = &results->results[i];
+			if (
+				SDL_strcmp(fields[0], result->backend) == 0 &&
+				SDL_strcmp(fields[1], result->kernel) == 0 &&
+				SDL_strcmp(fields[2], result->layout) == 0 &&
+				SDL_strtoul(fields[3], NULL, 10) == result->threads &&
+				SDL_strtoul(fields[4], NULL, 10) == result->workgroupSize &&
+				SDL_strtoul(fields[5], NULL, 10) == result->particleCount
+			) {
+				break;
+			}
+		}
+
+		if (i == results->count)
+		{
+			missing += 1;
+			continue;
+		}
+
+		matched[i] = true;
+		compared += 1;
+
+		baselineMedian = SDL_strtod(fields[8], NULL) * 1e-3;
+		threshold = (fieldCount > 12 && fields[12][0] != '\0') ? SDL_strtod(fields[12], NULL) : defaultThreshold;
+		change = (baselineMedian > 0.0) ? result->medianSeconds / baselineMedian - 1.0 : 0.0;
+
+		if (change > threshold)
+		{
+			regressions += 1;
+			SDL_Log(
+				"REGRESSION %s %s %s, %u threads, workgroup %u, %u particles: %.3f -> %.3f ms/step (%+.1f%%, threshold %.1f%%)",
+				result->backend,
+				result->kernel,
+				result->layout,
+				result->threads,
+				result->workgroupSize,
+				result->particleCount,
+				baselineMedian * 1e3,
+				result->medianSeconds * 1e3,
+				change * 100.0,
+				threshold * 100.0
+			);
+		}
+		else if (change < -threshold)
+		{
+			improved += 1;
+		}
+	}
+
+	fclose(file);
+
+	for (i = 0; i < results->count; i += 1)
+	{
+		if (!matched[i])
+		{
+			SDL_Log(
+				"No baseline for %s %s %s, %u threads, workgroup %u, %u particles",
+				results->results[i].backend,
+				results->results[i].kernel,
+				results->results[i].layout,
+				results->results[i].threads,
+				results->results[i].workgroupSize,
+				results->results[i].particleCount
+			);
+		}
+	}
+	SDL_free(matched);
+
+	SDL_Log(
+		"Baseline %s: %u cases compared, %d regressed, %u improved past the threshold, %u baseline rows not run",
+		path,
+		compared,
+		regressions,
+		improved,
+		missing
+	);
+
+	return regressions;
+}
+
+/* CPU cases */
+
+/* Every sample sorts the initial random order, the most a reorder ever
+ * has to move
+ */
+static void BenchSuite_RunCPUReorder(
+	const BenchSuiteOptions *options,
+	const Particle *particles,
+	uint32_t particleCount,
+	uint32_t threadCount,
+	ThreadPool *pool,
+	BenchSuiteResults *results
+) {
+	CPUSim *sim = CPUSim_Create(particleCount, CPUSIM_KERNEL_AUTO, pool);
+	ParticleReorder *reorder = ParticleReorder_Create(particleCount, pool);
+	BenchReport *report = BenchReport_Create();
+	uint64_t start;
+	uint32_t s;
+
+	for (s = 0; s <= options->samples; s += 1)
+	{
+		CPUSim_SetParticles(sim, particles);
+
+		start = Bench_Now();
+		CPUSim_Reorder(sim, reorder);
+		if (s > 0)
+		{
+			BenchReport_AddSince(report, BENCH_PHASE_SIMULATE, start);
+		}
+	}
+
+	BenchSuite_AddResult(results, "cpu", "reorder", "soa", threadCount, 0, particleCount, 1, report);
+
+	BenchReport_Destroy(report);
+	ParticleReorder_Destroy(reorder);
+	CPUSim_Destroy(sim);
+}
+
+static void BenchSuite_FillSteps(ParticleComputeUniforms *steps, uint32_t stepCount, uint32_t particleCount)
+{
+	const double dt = 0.01;
+	uint32_t i;
+
+	for (i = 0; i < stepCount; i += 1)
+	{
+		Particle_FillUniforms(&steps[i], particleCount, i * dt, dt);
+	}
+}
+
+static void BenchSuite_RunCPU(const BenchSuiteOptions *options, BenchSuiteResults *results)
+{
+	ParticleComputeUniforms *steps = SDL_malloc(sizeof(ParticleComputeUniforms) * options->steps);
+	Particle *particles;
+	ThreadPool *pool;
+	CPUSim *sim;
+	BenchReport *report;
+	uint64_t start;
+	uint32_t c, t, k, s;
+
+	for (c = 0; c < options->counts.count; c += 1)
+	{
+		uint32_t particleCount = options->counts.values[c];
+
+		particles = SDL_malloc(sizeof(Particle) * particleCount);
+		if (particles == NULL)
+		{
+			SDL_Log("Could not allocate %u particles, skipping the CPU cases for that count", particleCount);
+			continue;
+		}
+
+		BenchSuite_FillSteps(steps, options->steps, particleCount);
+
+		for (t = 0; t < options->threads.count; t += 1)
+		{
+			uint32_t threadCount = options->threads.values[t];
+
+			pool = (threadCount > 1) ? ThreadPool_Create(threadCount) : NULL;
+			Particle_InitializeArray(particles, particleCount, options->seed, pool);
+
+			for (k = 0; k < options->kernels.count; k += 1)
+			{
+				CPUSimKernel kernel = (CPUSimKernel) options->kernels.values[k];
+
+				if (!BenchSuite_KernelSupported(kernel))
+				{
+					SDL_Log("This CPU cannot run the %s kernel, skipped", CPUSim_GetKernelName(kernel));
+					continue;
+				}
+
+				sim = CPUSim_Create(particleCount, kernel, pool);
+				CPUSim_SetParticles(sim, particles);
+				CPUSim_StepMany(sim, steps, options->steps);
+
+				report = BenchReport_Create();
+				for (s = 0; s < options->samples; s += 1)
+				{
+					start = Bench_Now();
+					CPUSim_StepMany(sim, steps, options->steps);
+					BenchReport_AddSince(report, BENCH_PHASE_SIMULATE, start);
+				}
+
+				BenchSuite_AddResult(
+					results,
+					"cpu",
+					CPUSim_GetKernelName(kernel),
+					"soa",
+					threadCount,
+					0,
+					particleCount,
+					options->steps,
+					report
+				);
+
+				BenchReport_Destroy(report);
+				CPUSim_Destroy(sim);
+			}
+
+			BenchSuite_RunCPUReorder(options, particles, particleCount, threadCount, pool, results);
+
+			ThreadPool_Destroy(pool);
+		}
+
+		SDL_free(particles);
+	}
+
+	SDL_free(steps);
+}
+
+/* Device cases */
+
+static void BenchSuite_RunDeviceCase(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	const BenchSuiteOptions *options,
+	ParticleBuffers *particleBuffers,
+	const ParticleComputeUniforms *steps,
+	bool loop,
+	const DispatchVariant *variant,
+	BenchSuiteResults *results
+) {
+	const char *basePath = loop ?
+		ParticleLayout_GetSubstepShaderPath(particleBuffers->layout) :
+		ParticleLayout_GetComputeShaderPath(particleBuffers->layout);
+	uint32_t groupCount = DispatchVariant_GetGroupCount(variant, particleBuffers->particleCount);
+	char shaderPath[128];
+	char kernel[BENCH_SUITE_KERNEL_LENGTH];
+	REFRESH_CommandBuffer *commandBuffer;
+	BenchReport *report;
+	ComputePass pass;
+	uint64_t start;
+	uint32_t s;
+
+	DispatchVariant_GetShaderPath(variant, basePath, shaderPath, sizeof(shaderPath));
+
+	if (!ComputePass_Create(
+		device,
+		shaderCache,
+		&pass,
+		shaderPath,
+		loop ? sizeof(ParticleSubstepUniforms) : sizeof(ParticleComputeUniforms),
+		particleBuffers->buffers,
+		particleBuffers->bufferCount
+	)) {
+		SDL_Log("Could not load %s, skipped", shaderPath);
+		ComputePass_Destroy(device, &pass);
+		return;
+	}
+
+	/* One warm-up sample, then every sample is submitted and waited for on
+	 * its own, so each covers the whole round trip of its steps
+	 */
+	report = BenchReport_Create();
+	for (s = 0; s <= options->samples; s += 1)
+	{
+		start = Bench_Now();
+		commandBuffer = REFRESH_AcquireCommandBuffer(device, 0);
+		DispatchTuner_RecordSteps(device, commandBuffer, &pass, loop, steps, options->steps, groupCount);
+		REFRESH_Submit(device, 1, &commandBuffer);
+		REFRESH_Wait(device);
+
+		if (s > 0)
+		{
+			BenchReport_AddSince(report, BENCH_PHASE_SIMULATE, start);
+		}
+	}
+
+	/* Shapes with several particles per invocation are their own kernels */
+	if (variant->particlesPerInvocation > 1)
+	{
+		SDL_snprintf(kernel, sizeof(kernel), "%s_x%u", loop ? "loop" : "dispatch", variant->particlesPerInvocation);
+	}
+	else
+	{
+		SDL_strlcpy(kernel, loop ? "loop" : "dispatch", sizeof(kernel));
+	}
+
+	BenchSuite_AddResult(
+		results,
+		"gpu",
+		kernel,
+		ParticleLayout_GetName(particleBuffers->layout),
+		0,
+		variant->workgroupSize,
+		particleBuffers->particleCount,
+		options->steps,
+		report
+	);
+
+	BenchReport_Destroy(report);
+	ComputePass_Destroy(device, &pass);
+}
+
+/* As on the CPU, every sample sorts the initial random order */
+static void BenchSuite_RunDeviceReorder(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	const BenchSuiteOptions *options,
+	ParticleBuffers *particleBuffers,
+	BenchSuiteResults *results
+) {
+	ParticleReorderGPU *reorderGPU = ParticleReorderGPU_Create(device, shaderCache, particleBuffers);
+	REFRESH_CommandBuffer *commandBuffer;
+	BenchReport *report;
+	uint64_t start;
+	uint32_t s;
+
+	if (reorderGPU == NULL)
+	{
+		SDL_Log("Could not create the GPU reorder, skipped");
+		return;
+	}
+
+	report = BenchReport_Create();
+	for (s = 0; s <= options->samples; s += 1)
+	{
+		ParticleBuffers_InitializeOnDevice(device, shaderCache, particleBuffers, options->seed);
+
+		start = Bench_Now();
+		commandBuffer = REFRESH_AcquireCommandBuffer(device, 0);
+		ParticleReorderGPU_Record(device, commandBuffer, reorderGPU);
+		REFRESH_Submit(device, 1, &commandBuffer);
+		REFRESH_Wait(device);
+
+		if (s > 0)
+		{
+			BenchReport_AddSince(report, BENCH_PHASE_SIMULATE, start);
+		}
+	}
+
+	BenchSuite_AddResult(
+		results,
+		"gpu",
+		"reorder",
+		ParticleLayout_GetName(particleBuffers->layout),
+		0,
+		256,
+		particleBuffers->particleCount,
+		1,
+		report
+	);
+
+	BenchReport_Destroy(report);
+	ParticleReorderGPU_Destroy(device, reorderGPU);
+}
+
+static void BenchSuite_RunDevice(REFRESH_Device *device, const BenchSuiteOptions *options, BenchSuiteResults *results)
+{
+	ShaderCache *shaderCache = ShaderCache_Create(options->shaderBundlePath, NULL);
+	ParticleComputeUniforms *steps = SDL_malloc(sizeof(ParticleComputeUniforms) * options->steps);
+	BenchSuiteList builtSizes;
+	ParticleBuffers *particleBuffers;
+	DispatchVariant variant;
+	uint32_t c, l, v, w, loop;
+
+	SDL_zero(builtSizes);
+	for (v = 0; v < DispatchVariant_GetCount(); v += 1)
+	{
+		variant = DispatchVariant_Get(v);
+		if (!BenchSuite_ListContains(&builtSizes, variant.workgroupSize))
+		{
+			BenchSuite_AddValue(&builtSizes, variant.workgroupSize);
+		}
+	}
+	for (w = 0; w < options->workgroupSizes.count; w += 1)
+	{
+		if (!BenchSuite_ListContains(&builtSizes, options->workgroupSizes.values[w]))
+		{
+			SDL_Log("No shaders are built with a workgroup size of %u, skipped", options->workgroupSizes.values[w]);
+		}
+	}
+
+	for (c = 0; c < options->counts.count; c += 1)
+	{
+		uint32_t particleCount = options->counts.values[c];
+
+		BenchSuite_FillSteps(steps, options->steps, particleCount);
+
+		for (l = 0; l < options->layouts.count; l += 1)
+		{
+			particleBuffers = ParticleBuffers_Create(device, (ParticleLayout) options->layouts.values[l], particleCount);
+			if (!ParticleBuffers_InitializeOnDevice(device, shaderCache, particleBuffers, options->seed))
+			{
+				SDL_Log("Could not initialize the %s layout, skipped", ParticleLayout_GetName(particleBuffers->layout));
+				ParticleBuffers_Destroy(device, particleBuffers);
+				continue;
+			}
+
+			for (v = 0; v < DispatchVariant_GetCount(); v += 1)
+			{
+				variant = DispatchVariant_Get(v);
+				if (!BenchSuite_ListContains(&options->workgroupSizes, variant.workgroupSize))
+				{
+					continue;
+				}
+
+				for (loop = 0; loop < 2; loop += 1)
+				{
+					BenchSuite_RunDeviceCase(
+						device,
+						shaderCache,
+						options,
+						particleBuffers,
+						steps,
+						loop != 0,
+						&variant,
+						results
+					);
+				}
+			}
+
+			BenchSuite_RunDeviceReorder(device, shaderCache, options, particleBuffers, results);
+
+			ParticleBuffers_Destroy(device, particleBuffers);
+		}
+	}
+
+	SDL_free(steps);
+	ShaderCache_Destroy(shaderCache);
+}
+
+int main(int argc, char *argv[])
+{
+	BenchSuiteOptions options;
+	BenchSuiteResults results;
+	SDL_Window *window = NULL;
+	REFRESH_Device *device = NULL;
+	REFRESH_PresentationParameters presentationParameters;
+	int regressions = 0;
+
+	if (!BenchSuite_ParseOptions(&options, argc, argv))
+	{
+		return -1;
+	}
+
+	SDL_zero(results);
+
+	if (options.cpu)
+	{
+		BenchSuite_RunCPU(&options, &results);
+	}
+
+	if (options.device)
+	{
+		if (SDL_Init(SDL_INIT_VIDEO) < 0)
+		{
+			SDL_Log("Failed to initialize SDL, running the CPU cases only: %s", SDL_GetError());
+		}
+		else
+		{
+			/* Refresh needs a window to create a device, but it is never shown */
+			window = SDL_CreateWindow(
+				"Refresh Compute Bench",
+				SDL_WINDOWPOS_UNDEFINED,
+				SDL_WINDOWPOS_UNDEFINED,
+				64,
+				64,
+				SDL_WINDOW_VULKAN | SDL_WINDOW_HIDDEN
+			);
+
+			if (window != NULL)
+			{
+				presentationParameters.deviceWindowHandle = window;
+				presentationParameters.presentMode = REFRESH_PRESENTMODE_IMMEDIATE;
+				device = REFRESH_CreateDevice(&presentationParameters, 0);
+			}
+
+			if (device != NULL)
+			{
+				BenchSuite_RunDevice(device, &options, &results);
+				REFRESH_DestroyDevice(device);
+			}
+			else
+			{
+				SDL_Log("No device available, running the CPU cases only");
+			}
+
+			if (window != NULL)
+			{
+				SDL_DestroyWindow(window);
+			}
+			SDL_Quit();
+		}
+	}
+
+	if (options.csvPath != NULL)
+	{
+		BenchSuite_WriteCSV(&results, options.csvPath);
+	}
+
+	if (options.baselinePath != NULL)
+	{
+		regressions = BenchSuite_CompareBaseline(&results, options.baselinePath, options.threshold);
+	}
+
+	SDL_free(results.results);
+
+	if (regressions < 0)
+	{
+		return -1;
+	}
+	return (regressions > 0) ? 1 : 0;
+}
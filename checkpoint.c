@@ -0,0 +1,468 @@
+#include "checkpoint.h"
+
+#include <stdio.h>
+
+#include <SDL.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+#include "bench.h"
+#include "file_map.h"
+#include "particle_snapshot.h"
+#include "readback_ring.h"
+#include "trace.h"
+
+#define CHECKPOINT_PATH_LENGTH 256
+
+static uint64_t Checkpoint_Align(uint64_t offset)
+{
+	return (offset + CHECKPOINT_ALIGNMENT - 1) & ~((uint64_t) CHECKPOINT_ALIGNMENT - 1);
+}
+
+/* Places the buffers' streams after the header and returns the file size */
+static uint64_t Checkpoint_Layout(CheckpointHeader *header, const ParticleBuffers *particleBuffers)
+{
+	uint32_t i;
+	uint64_t offset = sizeof(CheckpointHeader);
+
+	SDL_zerop(header);
+	header->magic = CHECKPOINT_MAGIC;
+	header->version = CHECKPOINT_VERSION;
+	header->layout = (uint32_t) particleBuffers->layout;
+	header->particleCount = particleBuffers->particleCount;
+	header->streamCount = particleBuffers->bufferCount;
+
+	for (i = 0; i < particleBuffers->bufferCount; i += 1)
+	{
+		offset = Checkpoint_Align(offset);
+		header->streamOffset[i] = offset;
+		header->streamSize[i] = particleBuffers->bufferSizes[i];
+		offset += particleBuffers->bufferSizes[i];
+	}
+
+	return offset;
+}
+
+/* Reading */
+
+struct Checkpoint
+{
+	FileMap map;
+	CheckpointHeader header;
+};
+
+static bool Checkpoint_Validate(Checkpoint *checkpoint)
+{
+	const CheckpointHeader *header = &checkpoint->header;
+	uint64_t size = checkpoint->map.size;
+	uint32_t i;
+
+	if (size < sizeof(CheckpointHeader))
+	{
+		return false;
+	}
+
+	SDL_memcpy(&checkpoint->header, checkpoint->map.data, sizeof(CheckpointHeader));
+
+	if (header->magic != CHECKPOINT_MAGIC ||
+		header->version != CHECKPOINT_VERSION ||
+		header->layout > PARTICLE_LAYOUT_QUANTIZED ||
+		header->streamCount == 0 ||
+		header->streamCount > CHECKPOINT_MAX_STREAMS)
+	{
+		return false;
+	}
+
+	for (i = 0; i < header->streamCount; i += 1)
+	{
+		if (header->streamOffset[i] % CHECKPOINT_ALIGNMENT != 0 ||
+			header->streamOffset[i] > size ||
+			header->streamSize[i] > size - header->streamOffset[i])
+		{
+			return false;
+		}
+	}
+
+	return Bench_Checksum(
+		checkpoint->map.data + sizeof(CheckpointHeader),
+		size - sizeof(CheckpointHeader)
+	) == header->checksum;
+}
+
+Checkpoint* Checkpoint_Open(const char *path)
+{
+	Checkpoint *checkpoint = SDL_malloc(sizeof(Checkpoint));
+
+	SDL_zerop(checkpoint);
+
+	if (!FileMap_Open(&checkpoint->map, path))
+	{
+		SDL_Log("Could not read the checkpoint %s", path);
+		SDL_free(checkpoint);
+		return NULL;
+	}
+
+	if (!Checkpoint_Validate(checkpoint))
+	{
+		SDL_Log("%s is not an intact version %u checkpoint", path, CHECKPOINT_VERSION);
+		Checkpoint_Close(checkpoint);
+		return NULL;
+	}
+
+	return checkpoint;
+}
+
+void Checkpoint_Close(Checkpoint *checkpoint)
+{
+	if (checkpoint == NULL)
+	{
+		return;
+	}
+
+	FileMap_Close(&checkpoint->map);
+	SDL_free(checkpoint);
+}
+
+const CheckpointHeader* Checkpoint_GetHeader(Checkpoint *checkpoint)
+{
+	return &checkpoint->header;
+}
+
+void Checkpoint_GetState(Checkpoint *checkpoint, CheckpointState *state)
+{
+	state->t = checkpoint->header.t;
+	state->accumulator = checkpoint->header.accumulator;
+	state->seed = checkpoint->header.seed;
+}
+
+bool Checkpoint_Upload(Checkpoint *checkpoint, REFRESH_Device *device, ParticleBuffers *particleBuffers)
+{
+	const CheckpointHeader *header = &checkpoint->header;
+	uint32_t i;
+
+	if (header->layout != (uint32_t) particleBuffers->layout || header->particleCount != particleBuffers->particleCount)
+	{
+		SDL_Log(
+			"The checkpoint holds %u particles in the %s layout, this run has %u in the %s layout",
+			header->particleCount,
+			ParticleLayout_GetName((ParticleLayout) header->layout),
+			particleBuffers->particleCount,
+			ParticleLayout_GetName(particleBuffers->layout)
+		);
+		return false;
+	}
+
+	for (i = 0; i < header->streamCount; i += 1)
+	{
+		/* The layouts always agree on stream sizes; this guards a bad file */
+		if (header->streamSize[i] != particleBuffers->bufferSizes[i])
+		{
+			SDL_Log("Checkpoint stream %u is %llu bytes, expected %u", i, (unsigned long long) header->streamSize[i], particleBuffers->bufferSizes[i]);
+			return false;
+		}
+	}
+
+	for (i = 0; i < header->streamCount; i += 1)
+	{
+		REFRESH_SetBufferData(
+			device,
+			particleBuffers->buffers[i],
+			0,
+			(void*) (checkpoint->map.data + header->streamOffset[i]),
+			(uint32_t) header->streamSize[i]
+		);
+	}
+
+	return true;
+}
+
+void Checkpoint_GetParticles(Checkpoint *checkpoint, Particle *particles)
+{
+	const uint8_t *streams[CHECKPOINT_MAX_STREAMS];
+	uint32_t i;
+
+	for (i = 0; i < checkpoint->header.streamCount; i += 1)
+	{
+		streams[i] = checkpoint->map.data + checkpoint->header.streamOffset[i];
+	}
+
+	ParticleLayout_DecodeStreams((ParticleLayout) checkpoint->header.layout, streams, checkpoint->header.particleCount, particles);
+}
+
+/* Writing */
+
+struct CheckpointWriter
+{
+	ParticleSnapshot snapshot;
+	ReadbackRing ring; /* of one slot, the snapshot */
+
+	/* The file as it will be written: header, then the streams */
+	uint8_t *file;
+	uint64_t fileSize;
+
+	/* The snapshot recorded and not yet read back */
+	CheckpointState pendingState;
+	char pendingPath[CHECKPOINT_PATH_LENGTH];
+
+	/* Everything below is guarded by mutex. While writing is set the
+	 * worker owns file and path.
+	 */
+	SDL_mutex *mutex;
+	SDL_cond *jobAvailable;
+	bool writing;
+	bool shutdown;
+	char path[CHECKPOINT_PATH_LENGTH];
+	CheckpointWriterStats stats;
+
+	SDL_Thread *thread;
+};
+
+/* Moves from over to in one step. POSIX rename replaces an existing file
+ * atomically; the Windows CRT's refuses to, where MoveFileEx does not.
+ */
+static bool Checkpoint_Replace(const char *from, const char *to)
+{
+#ifdef _WIN32
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return rename(from, to) == 0;
+#endif
+}
+
+static bool CheckpointWriter_WriteFile(CheckpointWriter *writer)
+{
+	CheckpointHeader *header = (CheckpointHeader*) writer->file;
+	char temporaryPath[CHECKPOINT_PATH_LENGTH + 4];
+	SDL_RWops *file;
+	bool written;
+
+	header->checksum = Bench_Checksum(writer->file + sizeof(CheckpointHeader), writer->fileSize - sizeof(CheckpointHeader));
+
+	SDL_snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", writer->path);
+
+	file = SDL_RWFromFile(temporaryPath, "wb");
+	if (file == NULL)
+	{
+		SDL_Log("Could not open %s for writing", temporaryPath);
+		return false;
+	}
+
+	written = SDL_RWwrite(file, writer->file, (size_t) writer->fileSize, 1) == 1;
+	written = (SDL_RWclose(file) == 0) && written;
+
+	/* The previous checkpoint stays until this one replaces it */
+	if (!written || !Checkpoint_Replace(temporaryPath, writer->path))
+	{
+		SDL_Log("Could not write the checkpoint %s", writer->path);
+		remove(temporaryPath);
+		return false;
+	}
+
+	return true;
+}
+
+static int CheckpointWriter_WorkerMain(void *data)
+{
+	CheckpointWriter *writer = (CheckpointWriter*) data;
+	bool written;
+
+	Trace_SetThreadName("checkpoint");
+
+	SDL_LockMutex(writer->mutex);
+
+	for (;;)
+	{
+		while (!writer->writing && !writer->shutdown)
+		{
+			SDL_CondWait(writer->jobAvailable, writer->mutex);
+		}
+
+		/* Shutdown only takes effect once the last checkpoint is written */
+		if (!writer->writing)
+		{
+			break;
+		}
+
+		SDL_UnlockMutex(writer->mutex);
+
+		TRACE_BEGIN(writeScope, "write checkpoint");
+		written = CheckpointWriter_WriteFile(writer);
+		TRACE_END(writeScope);
+
+		SDL_LockMutex(writer->mutex);
+
+		if (written)
+		{
+			SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Checkpoint written to %s", writer->path);
+			writer->stats.written += 1;
+		}
+		else
+		{
+			writer->stats.failed += 1;
+		}
+		writer->writing = false;
+	}
+
+	SDL_UnlockMutex(writer->mutex);
+
+	return 0;
+}
+
+CheckpointWriter* CheckpointWriter_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ParticleBuffers *particleBuffers,
+	uint32_t latency
+) {
+	CheckpointHeader header;
+	CheckpointWriter *writer = SDL_malloc(sizeof(CheckpointWriter));
+
+	SDL_zerop(writer);
+
+	ReadbackRing_Create(&writer->ring, latency, 1);
+
+	if (!ParticleSnapshot_Create(device, shaderCache, &writer->snapshot, particleBuffers))
+	{
+		CheckpointWriter_Destroy(device, writer);
+		return NULL;
+	}
+
+	/* Zeroed once, so the alignment gaps stay zero in every file */
+	writer->fileSize = Checkpoint_Layout(&header, particleBuffers);
+	writer->file = SDL_calloc(1, (size_t) writer->fileSize);
+	SDL_memcpy(writer->file, &header, sizeof(CheckpointHeader));
+
+	writer->mutex = SDL_CreateMutex();
+	writer->jobAvailable = SDL_CreateCond();
+	writer->thread = SDL_CreateThread(CheckpointWriter_WorkerMain, "Checkpoint", writer);
+
+	return writer;
+}
+
+/* Reads the snapshot back into the file block and hands it to the worker */
+static void CheckpointWriter_Retire(CheckpointWriter *writer, REFRESH_Device *device)
+{
+	CheckpointHeader *header = (CheckpointHeader*) writer->file;
+	uint8_t *streams[CHECKPOINT_MAX_STREAMS];
+	uint32_t i;
+
+	TRACE_BEGIN(retireScope, "checkpoint readback");
+
+	header->t = writer->pendingState.t;
+	header->accumulator = writer->pendingState.accumulator;
+	header->seed = writer->pendingState.seed;
+
+	for (i = 0; i < header->streamCount; i += 1)
+	{
+		streams[i] = writer->file + header->streamOffset[i];
+	}
+	ParticleSnapshot_Download(device, &writer->snapshot, streams);
+
+	SDL_LockMutex(writer->mutex);
+	SDL_strlcpy(writer->path, writer->pendingPath, sizeof(writer->path));
+	writer->writing = true;
+	SDL_CondSignal(writer->jobAvailable);
+	SDL_UnlockMutex(writer->mutex);
+
+	TRACE_END(retireScope);
+}
+
+void CheckpointWriter_Destroy(REFRESH_Device *device, CheckpointWriter *writer)
+{
+	uint32_t slotIndex;
+
+	if (writer == NULL)
+	{
+		return;
+	}
+
+	if (writer->thread != NULL)
+	{
+		REFRESH_Wait(device);
+
+		if (ReadbackRing_Retire(&writer->ring, true, &slotIndex))
+		{
+			CheckpointWriter_Retire(writer, device);
+		}
+
+		SDL_LockMutex(writer->mutex);
+		writer->shutdown = true;
+		SDL_CondSignal(writer->jobAvailable);
+		SDL_UnlockMutex(writer->mutex);
+
+		SDL_WaitThread(writer->thread, NULL);
+
+		if (writer->stats.requested > 0)
+		{
+			SDL_Log(
+				"Checkpoints: %u requested, %u written, %u dropped while another was in flight, %u failed",
+				writer->stats.requested,
+				writer->stats.written,
+				writer->stats.dropped,
+				writer->stats.failed
+			);
+		}
+
+		SDL_DestroyCond(writer->jobAvailable);
+		SDL_DestroyMutex(writer->mutex);
+	}
+
+	ParticleSnapshot_Destroy(device, &writer->snapshot);
+	ReadbackRing_Destroy(&writer->ring);
+	SDL_free(writer->file);
+	SDL_free(writer);
+}
+
+bool CheckpointWriter_Record(
+	CheckpointWriter *writer,
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	const CheckpointState *state,
+	const char *path
+) {
+	bool busy = !ReadbackRing_CanRecord(&writer->ring);
+
+	SDL_LockMutex(writer->mutex);
+	writer->stats.requested += 1;
+	busy = busy || writer->writing;
+	if (busy)
+	{
+		writer->stats.dropped += 1;
+	}
+	SDL_UnlockMutex(writer->mutex);
+
+	if (busy)
+	{
+		return false;
+	}
+
+	ReadbackRing_Record(&writer->ring);
+	ParticleSnapshot_Record(device, commandBuffer, &writer->snapshot);
+
+	writer->pendingState = *state;
+	SDL_strlcpy(writer->pendingPath, path, sizeof(writer->pendingPath));
+
+	return true;
+}
+
+void CheckpointWriter_EndFrame(CheckpointWriter *writer, REFRESH_Device *device)
+{
+	uint32_t slotIndex;
+
+	if (ReadbackRing_Retire(&writer->ring, false, &slotIndex))
+	{
+		CheckpointWriter_Retire(writer, device);
+	}
+
+	ReadbackRing_EndFrame(&writer->ring);
+}
+
+void CheckpointWriter_GetStats(CheckpointWriter *writer, CheckpointWriterStats *stats)
+{
+	SDL_LockMutex(writer->mutex);
+	*stats = writer->stats;
+	SDL_UnlockMutex(writer->mutex);
+}
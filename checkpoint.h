@@ -0,0 +1,129 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <Refresh.h>
+
+#include "particle.h"
+#include "particle_buffers.h"
+#include "shader_module.h"
+
+/* Snapshots of a GPU simulation that a later run can pick up from.
+ *
+ * A checkpoint holds every stream of the particle buffers exactly as the
+ * device stores them, plus the simulation time, the fixed-step accumulator
+ * and the seed the run started from. Restoring maps the file and hands each
+ * stream to REFRESH_SetBufferData straight from the mapping, so nothing is
+ * decoded or staged on the way.
+ *
+ * Layout: a CheckpointHeader, then each stream at its offset, aligned to
+ * CHECKPOINT_ALIGNMENT bytes so a stream starts on its own page. The gaps
+ * are zero. All fields are little endian.
+ */
+
+#define CHECKPOINT_MAGIC 0x4B435052 /* "RPCK" */
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_ALIGNMENT 4096
+#define CHECKPOINT_MAX_STREAMS MAX_PARTICLE_BUFFERS
+
+typedef struct CheckpointHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t layout;        /* ParticleLayout */
+	uint32_t particleCount;
+	uint32_t streamCount;   /* in compute binding order */
+	uint32_t seed;
+	double t;
+	double accumulator;
+	uint64_t streamOffset[CHECKPOINT_MAX_STREAMS]; /* from the start of the file */
+	uint64_t streamSize[CHECKPOINT_MAX_STREAMS];
+	uint64_t checksum;      /* Bench_Checksum of everything after the header */
+} CheckpointHeader;
+
+/* The host state saved next to the particles */
+typedef struct CheckpointState
+{
+	double t;
+	double accumulator;
+	uint32_t seed;
+} CheckpointState;
+
+/* Reading */
+
+typedef struct Checkpoint Checkpoint;
+
+/* Maps the file and checks its header and checksum. Logs and returns NULL
+ * if it cannot be read or is not a version CHECKPOINT_VERSION checkpoint.
+ */
+Checkpoint* Checkpoint_Open(const char *path);
+void Checkpoint_Close(Checkpoint *checkpoint);
+
+const CheckpointHeader* Checkpoint_GetHeader(Checkpoint *checkpoint);
+void Checkpoint_GetState(Checkpoint *checkpoint, CheckpointState *state);
+
+/* Uploads every stream from the mapping. Logs and returns false if the
+ * buffers do not have the checkpoint's layout and particle count.
+ */
+bool Checkpoint_Upload(Checkpoint *checkpoint, REFRESH_Device *device, ParticleBuffers *particleBuffers);
+
+/* The particles as a Particle array, for validation on the host */
+void Checkpoint_GetParticles(Checkpoint *checkpoint, Particle *particles);
+
+/* Writing, without stalling the frame.
+ *
+ * A checkpoint is recorded as a ParticleSnapshot after the frame's update.
+ * The snapshot sits in a one-slot readback ring (readback_ring.h), is
+ * only read back `latency` frames later, and the file is written by a
+ * worker thread. The file first goes to <path>.tmp and is renamed over
+ * path once complete, so a crash mid-write leaves the previous checkpoint.
+ *
+ * One checkpoint is in flight at a time. Asking for another before the
+ * last one is on disk drops it and counts it.
+ */
+
+typedef struct CheckpointWriter CheckpointWriter;
+
+typedef struct CheckpointWriterStats
+{
+	uint32_t requested;
+	uint32_t written;
+	uint32_t dropped; /* the previous checkpoint was still in flight */
+	uint32_t failed;  /* could not write the file */
+} CheckpointWriterStats;
+
+/* Returns NULL if the snapshot shader could not be loaded */
+CheckpointWriter* CheckpointWriter_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ParticleBuffers *particleBuffers,
+	uint32_t latency
+);
+
+/* Waits for the device, writes the outstanding checkpoint, joins the
+ * worker and logs the stats
+ */
+void CheckpointWriter_Destroy(REFRESH_Device *device, CheckpointWriter *writer);
+
+/* Records the snapshot into commandBuffer, after everything that updates
+ * the particles this frame. state is what the file will hold alongside
+ * them. Returns false if the checkpoint had to be dropped.
+ */
+bool CheckpointWriter_Record(
+	CheckpointWriter *writer,
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	const CheckpointState *state,
+	const char *path
+);
+
+/* Call once per frame after REFRESH_Submit. Reads the snapshot back once
+ * it is `latency` frames old and hands it to the worker thread.
+ */
+void CheckpointWriter_EndFrame(CheckpointWriter *writer, REFRESH_Device *device);
+
+void CheckpointWriter_GetStats(CheckpointWriter *writer, CheckpointWriterStats *stats);
+
+#endif /* CHECKPOINT_H */
@@ -0,0 +1,69 @@
+#include "compute_pass.h"
+
+#include <SDL.h>
+
+bool ComputePass_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ComputePass *pass,
+	const char *shaderPath,
+	uint32_t uniformBufferSize,
+	REFRESH_Buffer **buffers,
+	uint32_t bufferCount
+) {
+	REFRESH_ComputePipelineCreateInfo computePipelineCreateInfo;
+	uint32_t i;
+
+	SDL_assert(bufferCount <= COMPUTE_PASS_MAX_BINDINGS);
+
+	pass->pipeline = NULL;
+	pass->bufferCount = bufferCount;
+	for (i = 0; i < bufferCount; i += 1)
+	{
+		pass->buffers[i] = buffers[i];
+	}
+
+	pass->shaderModule = ShaderModule_Load(device, shaderCache, shaderPath);
+	if (pass->shaderModule == NULL)
+	{
+		return false;
+	}
+
+	computePipelineCreateInfo.computeShaderState.shaderModule = pass->shaderModule;
+	computePipelineCreateInfo.computeShaderState.entryPointName = "main";
+	computePipelineCreateInfo.computeShaderState.uniformBufferSize = uniformBufferSize;
+	computePipelineCreateInfo.pipelineLayoutCreateInfo.bufferBindingCount = bufferCount;
+	computePipelineCreateInfo.pipelineLayoutCreateInfo.imageBindingCount = 0;
+
+	pass->pipeline = ShaderCache_CreateComputePipeline(shaderCache, device, &computePipelineCreateInfo);
+	return true;
+}
+
+void ComputePass_Destroy(REFRESH_Device *device, ComputePass *pass)
+{
+	if (pass->pipeline != NULL)
+	{
+		REFRESH_AddDisposeComputePipeline(device, pass->pipeline);
+	}
+	if (pass->shaderModule != NULL)
+	{
+		REFRESH_AddDisposeShaderModule(device, pass->shaderModule);
+	}
+	pass->pipeline = NULL;
+	pass->shaderModule = NULL;
+}
+
+void ComputePass_Record(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	ComputePass *pass,
+	void *uniforms,
+	uint32_t groupCount
+) {
+	uint32_t computeParamOffset;
+
+	REFRESH_BindComputePipeline(device, commandBuffer, pass->pipeline);
+	REFRESH_BindComputeBuffers(device, commandBuffer, pass->buffers);
+	computeParamOffset = REFRESH_PushComputeShaderParams(device, commandBuffer, uniforms, 1);
+	REFRESH_DispatchCompute(device, commandBuffer, groupCount, 1, 1, computeParamOffset);
+}
@@ -0,0 +1,53 @@
+#ifndef COMPUTE_PASS_H
+#define COMPUTE_PASS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <Refresh.h>
+
+#include "shader_module.h"
+
+/* One compute shader with a fixed set of buffer bindings, for the helper
+ * passes that run before the particle update (neighbor_grid.comp,
+ * particle_mesh.comp).
+ */
+
+#define COMPUTE_PASS_MAX_BINDINGS 6
+
+typedef struct ComputePass
+{
+	REFRESH_ShaderModule *shaderModule;
+	REFRESH_ComputePipeline *pipeline;
+
+	/* In the shader's binding order */
+	REFRESH_Buffer *buffers[COMPUTE_PASS_MAX_BINDINGS];
+	uint32_t bufferCount;
+} ComputePass;
+
+/* Returns false if the shader could not be loaded. The pass may be
+ * partially created either way and must still be destroyed.
+ */
+bool ComputePass_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ComputePass *pass,
+	const char *shaderPath,
+	uint32_t uniformBufferSize,
+	REFRESH_Buffer **buffers,
+	uint32_t bufferCount
+);
+void ComputePass_Destroy(REFRESH_Device *device, ComputePass *pass);
+
+/* Binds the pass, pushes one uniform block and dispatches groupCount groups.
+ * Rebinding the buffers places a barrier after the previous dispatch.
+ */
+void ComputePass_Record(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	ComputePass *pass,
+	void *uniforms,
+	uint32_t groupCount
+);
+
+#endif /* COMPUTE_PASS_H */
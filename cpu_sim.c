@@ -0,0 +1,782 @@
+#include "cpu_sim.h"
+
+#include <SDL.h>
+
+#include "simd.h"
+
+/* Work is handed out in multiples of this so AVX2 never straddles chunks
+ * and neighbouring threads never write the same cache line.
+ */
+#define CPUSIM_GRAIN_SIZE 64
+
+/* Particles per block when running several steps back to back:
+ * 5 streams * 4 bytes * 1024 = 20KB, comfortably inside L1/L2.
+ */
+#define CPUSIM_SUBSTEP_BLOCK_SIZE 1024
+
+/* Constants from particle.comp. They are kept as separate multiplies, in
+ * the same order as the GLSL, so every kernel rounds identically.
+ */
+#define REPULSION_SCALE -0.000035f
+#define REPULSION_WEIGHT 0.05f
+#define ATTRACTION_DAMP 0.5f
+#define ATTRACTION_SCALE 0.0035f
+#define ATTRACTION_WEIGHT 12.0f
+#define BOUNCE_DAMP 0.1f
+#define GRADIENT_SPEED 0.02f
+
+struct CPUSim
+{
+	uint32_t particleCount;
+	CPUSimKernel kernel;
+	ThreadPool *pool;
+	NeighborGrid *neighborGrid;
+	ParticleMesh *particleMesh;
+	ForceField *forceField;
+
+	float *xPosition;
+	float *yPosition;
+	float *xVelocity;
+	float *yVelocity;
+	float *gradientPosition;
+};
+
+typedef struct CPUSimStepContext
+{
+	CPUSim *sim;
+	const ParticleComputeUniforms *steps;
+	uint32_t stepCount;
+} CPUSimStepContext;
+
+/* Scalar kernel */
+
+static void CPUSim_StepRange_Scalar(
+	CPUSim *sim,
+	const ParticleComputeUniforms *uniforms,
+	uint32_t start,
+	uint32_t end
+) {
+	uint32_t i;
+	float deltaTime = uniforms->deltaTime;
+	float destinationX = uniforms->destinationX;
+	float destinationY = uniforms->destinationY;
+	float gradientStep = GRADIENT_SPEED * deltaTime;
+
+	for (i = start; i < end; i += 1)
+	{
+		float xPosition = sim->xPosition[i];
+		float yPosition = sim->yPosition[i];
+		float xVelocity = sim->xVelocity[i];
+		float yVelocity = sim->yVelocity[i];
+		float gradientPosition = sim->gradientPosition[i];
+
+		float deltaX = destinationX - xPosition;
+		float deltaY = destinationY - yPosition;
+		float distance = SDL_sqrtf(deltaX * deltaX + deltaY * deltaY);
+		float inverseCubed = 1.0f / (distance * distance * distance);
+
+		xVelocity += deltaX * inverseCubed * REPULSION_SCALE * REPULSION_WEIGHT;
+		yVelocity += deltaY * inverseCubed * REPULSION_SCALE * REPULSION_WEIGHT;
+
+		float newX = xPosition + xVelocity * deltaTime;
+		float newY = yPosition + yVelocity * deltaTime;
+
+		if (newX < -1.0f || newX > 1.0f || newY < -1.0f || newY > 1.0f)
+		{
+			float attractX = destinationX - newX;
+			float attractY = destinationY - newY;
+			float inverseDistance = 1.0f / SDL_sqrtf(attractX * attractX + attractY * attractY + ATTRACTION_DAMP);
+			float inverseDistanceCubed = inverseDistance * inverseDistance * inverseDistance;
+
+			xVelocity = (-xVelocity * BOUNCE_DAMP) + attractX * inverseDistanceCubed * ATTRACTION_SCALE * ATTRACTION_WEIGHT;
+			yVelocity = (-yVelocity * BOUNCE_DAMP) + attractY * inverseDistanceCubed * ATTRACTION_SCALE * ATTRACTION_WEIGHT;
+		}
+		else
+		{
+			sim->xPosition[i] = newX;
+			sim->yPosition[i] = newY;
+		}
+
+		sim->xVelocity[i] = xVelocity;
+		sim->yVelocity[i] = yVelocity;
+
+		gradientPosition += gradientStep;
+		if (gradientPosition > 1.0f)
+		{
+			gradientPosition -= 1.0f;
+		}
+		sim->gradientPosition[i] = gradientPosition;
+	}
+}
+
+#ifdef SIMD_X86
+
+/* SSE2 kernel, 4 particles per iteration */
+
+SIMD_TARGET_SSE2
+static void CPUSim_StepRange_SSE2(
+	CPUSim *sim,
+	const ParticleComputeUniforms *uniforms,
+	uint32_t start,
+	uint32_t end
+) {
+	uint32_t i;
+	uint32_t vectorEnd = start + ((end - start) & ~3u);
+
+	const __m128 deltaTime = _mm_set1_ps(uniforms->deltaTime);
+	const __m128 destinationX = _mm_set1_ps(uniforms->destinationX);
+	const __m128 destinationY = _mm_set1_ps(uniforms->destinationY);
+	const __m128 gradientStep = _mm_set1_ps(GRADIENT_SPEED * uniforms->deltaTime);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 negativeOne = _mm_set1_ps(-1.0f);
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 repulsionScale = _mm_set1_ps(REPULSION_SCALE);
+	const __m128 repulsionWeight = _mm_set1_ps(REPULSION_WEIGHT);
+	const __m128 attractionDamp = _mm_set1_ps(ATTRACTION_DAMP);
+	const __m128 attractionScale = _mm_set1_ps(ATTRACTION_SCALE);
+	const __m128 attractionWeight = _mm_set1_ps(ATTRACTION_WEIGHT);
+	const __m128 bounceDamp = _mm_set1_ps(BOUNCE_DAMP);
+
+	for (i = start; i < vectorEnd; i += 4)
+	{
+		__m128 xPosition = _mm_loadu_ps(sim->xPosition + i);
+		__m128 yPosition = _mm_loadu_ps(sim->yPosition + i);
+		__m128 xVelocity = _mm_loadu_ps(sim->xVelocity + i);
+		__m128 yVelocity = _mm_loadu_ps(sim->yVelocity + i);
+		__m128 gradientPosition = _mm_loadu_ps(sim->gradientPosition + i);
+
+		/* repulsion */
+		__m128 deltaX = _mm_sub_ps(destinationX, xPosition);
+		__m128 deltaY = _mm_sub_ps(destinationY, yPosition);
+		__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(deltaX, deltaX), _mm_mul_ps(deltaY, deltaY)));
+		__m128 inverseCubed = _mm_div_ps(one, _mm_mul_ps(_mm_mul_ps(distance, distance), distance));
+
+		xVelocity = _mm_add_ps(xVelocity, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(deltaX, inverseCubed), repulsionScale), repulsionWeight));
+		yVelocity = _mm_add_ps(yVelocity, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(deltaY, inverseCubed), repulsionScale), repulsionWeight));
+
+		/* integrate */
+		__m128 newX = _mm_add_ps(xPosition, _mm_mul_ps(xVelocity, deltaTime));
+		__m128 newY = _mm_add_ps(yPosition, _mm_mul_ps(yVelocity, deltaTime));
+
+		__m128 outside = _mm_or_ps(
+			_mm_or_ps(_mm_cmplt_ps(newX, negativeOne), _mm_cmpgt_ps(newX, one)),
+			_mm_or_ps(_mm_cmplt_ps(newY, negativeOne), _mm_cmpgt_ps(newY, one))
+		);
+
+		/* boundary bounce, evaluated for every lane and then masked in */
+		__m128 attractX = _mm_sub_ps(destinationX, newX);
+		__m128 attractY = _mm_sub_ps(destinationY, newY);
+		__m128 inverseDistance = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(attractX, attractX), _mm_mul_ps(attractY, attractY)), attractionDamp)));
+		__m128 inverseDistanceCubed = _mm_mul_ps(_mm_mul_ps(inverseDistance, inverseDistance), inverseDistance);
+
+		__m128 bounceX = _mm_add_ps(
+			_mm_mul_ps(_mm_xor_ps(xVelocity, signMask), bounceDamp),
+			_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(attractX, inverseDistanceCubed), attractionScale), attractionWeight)
+		);
+		__m128 bounceY = _mm_add_ps(
+			_mm_mul_ps(_mm_xor_ps(yVelocity, signMask), bounceDamp),
+			_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(attractY, inverseDistanceCubed), attractionScale), attractionWeight)
+		);
+
+		xVelocity = _mm_or_ps(_mm_and_ps(outside, bounceX), _mm_andnot_ps(outside, xVelocity));
+		yVelocity = _mm_or_ps(_mm_and_ps(outside, bounceY), _mm_andnot_ps(outside, yVelocity));
+		xPosition = _mm_or_ps(_mm_and_ps(outside, xPosition), _mm_andnot_ps(outside, newX));
+		yPosition = _mm_or_ps(_mm_and_ps(outside, yPosition), _mm_andnot_ps(outside, newY));
+
+		/* gradient wrap */
+		gradientPosition = _mm_add_ps(gradientPosition, gradientStep);
+		gradientPosition = _mm_sub_ps(gradientPosition, _mm_and_ps(_mm_cmpgt_ps(gradientPosition, one), one));
+
+		_mm_storeu_ps(sim->xPosition + i, xPosition);
+		_mm_storeu_ps(sim->yPosition + i, yPosition);
+		_mm_storeu_ps(sim->xVelocity + i, xVelocity);
+		_mm_storeu_ps(sim->yVelocity + i, yVelocity);
+		_mm_storeu_ps(sim->gradientPosition + i, gradientPosition);
+	}
+
+	CPUSim_StepRange_Scalar(sim, uniforms, vectorEnd, end);
+}
+
+/* AVX2 kernel, 8 particles per iteration, without FMA (simd.h) */
+
+SIMD_TARGET_AVX2
+static void CPUSim_StepRange_AVX2(
+	CPUSim *sim,
+	const ParticleComputeUniforms *uniforms,
+	uint32_t start,
+	uint32_t end
+) {
+	uint32_t i;
+	uint32_t vectorEnd = start + ((end - start) & ~7u);
+
+	const __m256 deltaTime = _mm256_set1_ps(uniforms->deltaTime);
+	const __m256 destinationX = _mm256_set1_ps(uniforms->destinationX);
+	const __m256 destinationY = _mm256_set1_ps(uniforms->destinationY);
+	const __m256 gradientStep = _mm256_set1_ps(GRADIENT_SPEED * uniforms->deltaTime);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 negativeOne = _mm256_set1_ps(-1.0f);
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+	const __m256 repulsionScale = _mm256_set1_ps(REPULSION_SCALE);
+	const __m256 repulsionWeight = _mm256_set1_ps(REPULSION_WEIGHT);
+	const __m256 attractionDamp = _mm256_set1_ps(ATTRACTION_DAMP);
+	const __m256 attractionScale = _mm256_set1_ps(ATTRACTION_SCALE);
+	const __m256 attractionWeight = _mm256_set1_ps(ATTRACTION_WEIGHT);
+	const __m256 bounceDamp = _mm256_set1_ps(BOUNCE_DAMP);
+
+	for (i = start; i < vectorEnd; i += 8)
+	{
+		__m256 xPosition = _mm256_loadu_ps(sim->xPosition + i);
+		__m256 yPosition = _mm256_loadu_ps(sim->yPosition + i);
+		__m256 xVelocity = _mm256_loadu_ps(sim->xVelocity + i);
+		__m256 yVelocity = _mm256_loadu_ps(sim->yVelocity + i);
+		__m256 gradientPosition = _mm256_loadu_ps(sim->gradientPosition + i);
+
+		/* repulsion */
+		__m256 deltaX = _mm256_sub_ps(destinationX, xPosition);
+		__m256 deltaY = _mm256_sub_ps(destinationY, yPosition);
+		__m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(deltaX, deltaX), _mm256_mul_ps(deltaY, deltaY)));
+		__m256 inverseCubed = _mm256_div_ps(one, _mm256_mul_ps(_mm256_mul_ps(distance, distance), distance));
+
+		xVelocity = _mm256_add_ps(xVelocity, _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(deltaX, inverseCubed), repulsionScale), repulsionWeight));
+		yVelocity = _mm256_add_ps(yVelocity, _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(deltaY, inverseCubed), repulsionScale), repulsionWeight));
+
+		/* integrate */
+		__m256 newX = _mm256_add_ps(xPosition, _mm256_mul_ps(xVelocity, deltaTime));
+		__m256 newY = _mm256_add_ps(yPosition, _mm256_mul_ps(yVelocity, deltaTime));
+
+		__m256 outside = _mm256_or_ps(
+			_mm256_or_ps(_mm256_cmp_ps(newX, negativeOne, _CMP_LT_OQ), _mm256_cmp_ps(newX, one, _CMP_GT_OQ)),
+			_mm256_or_ps(_mm256_cmp_ps(newY, negativeOne, _CMP_LT_OQ), _mm256_cmp_ps(newY, one, _CMP_GT_OQ))
+		);
+
+		/* boundary bounce */
+		__m256 attractX = _mm256_sub_ps(destinationX, newX);
+		__m256 attractY = _mm256_sub_ps(destinationY, newY);
+		__m256 inverseDistance = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(attractX, attractX), _mm256_mul_ps(attractY, attractY)), attractionDamp)));
+		__m256 inverseDistanceCubed = _mm256_mul_ps(_mm256_mul_ps(inverseDistance, inverseDistance), inverseDistance);
+
+		__m256 bounceX = _mm256_add_ps(
+			_mm256_mul_ps(_mm256_xor_ps(xVelocity, signMask), bounceDamp),
+			_mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(attractX, inverseDistanceCubed), attractionScale), attractionWeight)
+		);
+		__m256 bounceY = _mm256_add_ps(
+			_mm256_mul_ps(_mm256_xor_ps(yVelocity, signMask), bounceDamp),
+			_mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(attractY, inverseDistanceCubed), attractionScale), attractionWeight)
+		);
+
+		xVelocity = _mm256_blendv_ps(xVelocity, bounceX, outside);
+		yVelocity = _mm256_blendv_ps(yVelocity, bounceY, outside);
+		xPosition = _mm256_blendv_ps(newX, xPosition, outside);
+		yPosition = _mm256_blendv_ps(newY, yPosition, outside);
+
+		/* gradient wrap */
+		gradientPosition = _mm256_add_ps(gradientPosition, gradientStep);
+		gradientPosition = _mm256_sub_ps(gradientPosition, _mm256_and_ps(_mm256_cmp_ps(gradientPosition, one, _CMP_GT_OQ), one));
+
+		_mm256_storeu_ps(sim->xPosition + i, xPosition);
+		_mm256_storeu_ps(sim->yPosition + i, yPosition);
+		_mm256_storeu_ps(sim->xVelocity + i, xVelocity);
+		_mm256_storeu_ps(sim->yVelocity + i, yVelocity);
+		_mm256_storeu_ps(sim->gradientPosition + i, gradientPosition);
+	}
+
+	CPUSim_StepRange_Scalar(sim, uniforms, vectorEnd, end);
+}
+
+#endif /* SIMD_X86 */
+
+static void CPUSim_StepKernel(
+	CPUSim *sim,
+	const ParticleComputeUniforms *uniforms,
+	uint32_t start,
+	uint32_t end
+) {
+	switch (sim->kernel)
+	{
+#ifdef SIMD_X86
+	case CPUSIM_KERNEL_AVX2:
+		CPUSim_StepRange_AVX2(sim, uniforms, start, end);
+		break;
+
+	case CPUSIM_KERNEL_SSE2:
+		CPUSim_StepRange_SSE2(sim, uniforms, start, end);
+		break;
+#endif
+
+	default:
+		CPUSim_StepRange_Scalar(sim, uniforms, start, end);
+		break;
+	}
+}
+
+static void CPUSim_StepRange(void *userdata, uint32_t start, uint32_t end)
+{
+	CPUSimStepContext *context = (CPUSimStepContext*) userdata;
+	uint32_t blockStart, blockEnd, step;
+
+	if (context->stepCount == 1)
+	{
+		CPUSim_StepKernel(context->sim, context->steps, start, end);
+		return;
+	}
+
+	for (blockStart = start; blockStart < end; blockStart = blockEnd)
+	{
+		blockEnd = SDL_min(blockStart + CPUSIM_SUBSTEP_BLOCK_SIZE, end);
+
+		for (step = 0; step < context->stepCount; step += 1)
+		{
+			CPUSim_StepKernel(context->sim, &context->steps[step], blockStart, blockEnd);
+		}
+	}
+}
+
+static CPUSimKernel CPUSim_ResolveKernel(CPUSimKernel kernel)
+{
+	switch (Simd_ResolveVectorWidth(CPUSim_GetKernelWidth(kernel)))
+	{
+	case 8:
+		return CPUSIM_KERNEL_AVX2;
+	case 4:
+		return CPUSIM_KERNEL_SSE2;
+	default:
+		return CPUSIM_KERNEL_SCALAR;
+	}
+}
+
+/* Public API */
+
+CPUSim* CPUSim_Create(uint32_t particleCount, CPUSimKernel kernel, ThreadPool *pool)
+{
+	CPUSim *sim = SDL_malloc(sizeof(CPUSim));
+
+	sim->particleCount = particleCount;
+	sim->kernel = CPUSim_ResolveKernel(kernel);
+	sim->pool = pool;
+	sim->neighborGrid = NULL;
+	sim->particleMesh = NULL;
+	sim->forceField = NULL;
+
+	sim->xPosition = SDL_calloc(particleCount, sizeof(float));
+	sim->yPosition = SDL_calloc(particleCount, sizeof(float));
+	sim->xVelocity = SDL_calloc(particleCount, sizeof(float));
+	sim->yVelocity = SDL_calloc(particleCount, sizeof(float));
+	sim->gradientPosition = SDL_calloc(particleCount, sizeof(float));
+
+	return sim;
+}
+
+void CPUSim_Destroy(CPUSim *sim)
+{
+	if (sim == NULL)
+	{
+		return;
+	}
+
+	SDL_free(sim->xPosition);
+	SDL_free(sim->yPosition);
+	SDL_free(sim->xVelocity);
+	SDL_free(sim->yVelocity);
+	SDL_free(sim->gradientPosition);
+	SDL_free(sim);
+}
+
+CPUSimKernel CPUSim_GetKernel(CPUSim *sim)
+{
+	return sim->kernel;
+}
+
+const char* CPUSim_GetKernelName(CPUSimKernel kernel)
+{
+	switch (kernel)
+	{
+	case CPUSIM_KERNEL_AUTO:
+		return "auto";
+	case CPUSIM_KERNEL_SCALAR:
+		return "scalar";
+	case CPUSIM_KERNEL_SSE2:
+		return "sse2";
+	case CPUSIM_KERNEL_AVX2:
+		return "avx2";
+	}
+	return "unknown";
+}
+
+uint32_t CPUSim_GetKernelWidth(CPUSimKernel kernel)
+{
+	switch (kernel)
+	{
+	case CPUSIM_KERNEL_AUTO:
+	case CPUSIM_KERNEL_AVX2:
+		return 8;
+	case CPUSIM_KERNEL_SSE2:
+		return 4;
+	case CPUSIM_KERNEL_SCALAR:
+		return 1;
+	}
+	return 1;
+}
+
+uint32_t CPUSim_GetParticleCount(CPUSim *sim)
+{
+	return sim->particleCount;
+}
+
+void CPUSim_SetNeighborGrid(CPUSim *sim, NeighborGrid *grid)
+{
+	sim->neighborGrid = grid;
+}
+
+void CPUSim_SetParticleMesh(CPUSim *sim, ParticleMesh *mesh)
+{
+	sim->particleMesh = mesh;
+}
+
+void CPUSim_SetForceField(CPUSim *sim, ForceField *field)
+{
+	sim->forceField = field;
+}
+
+void CPUSim_SetParticles(CPUSim *sim, const Particle *particles)
+{
+	uint32_t i;
+
+	for (i = 0; i < sim->particleCount; i += 1)
+	{
+		sim->xPosition[i] = particles[i].xPosition;
+		sim->yPosition[i] = particles[i].yPosition;
+		sim->xVelocity[i] = particles[i].xVelocity;
+		sim->yVelocity[i] = particles[i].yVelocity;
+		sim->gradientPosition[i] = particles[i].gradientPosition;
+	}
+}
+
+void CPUSim_GetParticles(CPUSim *sim, Particle *particles)
+{
+	uint32_t i;
+
+	for (i = 0; i < sim->particleCount; i += 1)
+	{
+		particles[i].xPosition = sim->xPosition[i];
+		particles[i].yPosition = sim->yPosition[i];
+		particles[i].xVelocity = sim->xVelocity[i];
+		particles[i].yVelocity = sim->yVelocity[i];
+		particles[i].gradientPosition = sim->gradientPosition[i];
+	}
+}
+
+void CPUSim_GetRenderStreams(CPUSim *sim, float *positions, float *gradientPositions)
+{
+	uint32_t i;
+
+	for (i = 0; i < sim->particleCount; i += 1)
+	{
+		positions[i * 2 + 0] = sim->xPosition[i];
+		positions[i * 2 + 1] = sim->yPosition[i];
+	}
+
+	SDL_memcpy(gradientPositions, sim->gradientPosition, sizeof(float) * sim->particleCount);
+}
+
+void CPUSim_Reorder(CPUSim *sim, ParticleReorder *reorder)
+{
+	ParticleReorder_Sort(reorder, sim->xPosition, sim->yPosition, sim->particleCount);
+	ParticleReorder_Permute(reorder, &sim->xPosition);
+	ParticleReorder_Permute(reorder, &sim->yPosition);
+	ParticleReorder_Permute(reorder, &sim->xVelocity);
+	ParticleReorder_Permute(reorder, &sim->yVelocity);
+	ParticleReorder_Permute(reorder, &sim->gradientPosition);
+}
+
+void CPUSim_Step(CPUSim *sim, const ParticleComputeUniforms *uniforms)
+{
+	CPUSim_StepMany(sim, uniforms, 1);
+}
+
+void CPUSim_StepMany(CPUSim *sim, const ParticleComputeUniforms *steps, uint32_t stepCount)
+{
+	CPUSimStepContext context;
+	uint32_t i;
+	uint32_t count;
+
+	if (stepCount == 0)
+	{
+		return;
+	}
+
+	count = SDL_min(steps[0].particleCount, sim->particleCount);
+
+	context.sim = sim;
+	context.steps = steps;
+	context.stepCount = stepCount;
+
+	/* Neighbor interaction, mesh gravity and the force field need every
+	 * particle's position after each step
+	 */
+	if (sim->neighborGrid != NULL || sim->particleMesh != NULL || sim->forceField != NULL)
+	{
+		context.stepCount = 1;
+	}
+
+	for (i = 0; i < stepCount; i += context.stepCount)
+	{
+		context.steps = &steps[i];
+
+		if (sim->forceField != NULL)
+		{
+			ForceField_Apply(
+				sim->forceField,
+				sim->xPosition,
+				sim->yPosition,
+				sim->xVelocity,
+				sim->yVelocity,
+				count,
+				steps[i].deltaTime
+			);
+		}
+
+		if (sim->particleMesh != NULL)
+		{
+			ParticleMesh_Apply(
+				sim->particleMesh,
+				sim->xPosition,
+				sim->yPosition,
+				sim->xVelocity,
+				sim->yVelocity,
+				count,
+				steps[i].deltaTime
+			);
+		}
+
+		if (sim->neighborGrid != NULL)
+		{
+			NeighborGrid_Apply(
+				sim->neighborGrid,
+				sim->xPosition,
+				sim->yPosition,
+				sim->xVelocity,
+				sim->yVelocity,
+				count,
+				steps[i].deltaTime
+			);
+		}
+
+		if (sim->pool == NULL)
+		{
+			CPUSim_StepRange(&context, 0, count);
+		}
+		else
+		{
+			ThreadPool_ParallelFor(sim->pool, count, CPUSIM_GRAIN_SIZE, CPUSim_StepRange, &context);
+		}
+	}
+}
+
+/* Reference implementation, written to mirror particle.comp as closely as C allows */
+
+static float CPUSim_Dot(float x0, float y0, float x1, float y1)
+{
+	return x0 * x1 + y0 * y1;
+}
+
+static void CPUSim_Attraction(float posX, float posY, float attractX, float attractY, float *outX, float *outY)
+{
+	float deltaX = attractX - posX;
+	float deltaY = attractY - posY;
+	const float damp = ATTRACTION_DAMP;
+	float dDampedDot = CPUSim_Dot(deltaX, deltaY, deltaX, deltaY) + damp;
+	float invDist = 1.0f / SDL_sqrtf(dDampedDot);
+	float invDistCubed = invDist * invDist * invDist;
+	*outX = deltaX * invDistCubed * ATTRACTION_SCALE;
+	*outY = deltaY * invDistCubed * ATTRACTION_SCALE;
+}
+
+static void CPUSim_Repulsion(float posX, float posY, float attractX, float attractY, float *outX, float *outY)
+{
+	float deltaX = attractX - posX;
+	float deltaY = attractY - posY;
+	float targetDistance = SDL_sqrtf(CPUSim_Dot(deltaX, deltaY, deltaX, deltaY));
+	float scale = 1.0f / (targetDistance * targetDistance * targetDistance);
+	*outX = deltaX * scale * REPULSION_SCALE;
+	*outY = deltaY * scale * REPULSION_SCALE;
+}
+
+void CPUSim_ReferenceStep(Particle *particles, const ParticleComputeUniforms *uniforms)
+{
+	uint32_t index;
+	float forceX, forceY;
+
+	for (index = 0; index < uniforms->particleCount; index += 1)
+	{
+		Particle *particle = &particles[index];
+
+		float vVelX = particle->xVelocity;
+		float vVelY = particle->yVelocity;
+		float vPosX = particle->xPosition;
+		float vPosY = particle->yPosition;
+
+		float destPosX = uniforms->destinationX;
+		float destPosY = uniforms->destinationY;
+
+		CPUSim_Repulsion(vPosX, vPosY, destPosX, destPosY, &forceX, &forceY);
+		vVelX += forceX * REPULSION_WEIGHT;
+		vVelY += forceY * REPULSION_WEIGHT;
+
+		vPosX += vVelX * uniforms->deltaTime;
+		vPosY += vVelY * uniforms->deltaTime;
+
+		if ((vPosX < -1.0f) || (vPosX > 1.0f) || (vPosY < -1.0f) || (vPosY > 1.0f))
+		{
+			CPUSim_Attraction(vPosX, vPosY, destPosX, destPosY, &forceX, &forceY);
+			vVelX = (-vVelX * BOUNCE_DAMP) + forceX * ATTRACTION_WEIGHT;
+			vVelY = (-vVelY * BOUNCE_DAMP) + forceY * ATTRACTION_WEIGHT;
+		}
+		else
+		{
+			particle->xPosition = vPosX;
+			particle->yPosition = vPosY;
+		}
+
+		particle->xVelocity = vVelX;
+		particle->yVelocity = vVelY;
+		particle->gradientPosition += GRADIENT_SPEED * uniforms->deltaTime;
+		if (particle->gradientPosition > 1.0f)
+		{
+			particle->gradientPosition -= 1.0f;
+		}
+	}
+}
+
+/* Comparison */
+
+static float CPUSim_Error(float expected, float actual)
+{
+	float magnitude = SDL_fabsf(expected);
+	float difference = SDL_fabsf(expected - actual);
+
+	if (expected == actual)
+	{
+		return 0.0f;
+	}
+	if (difference != difference)
+	{
+		/* NaN on one side only, or mismatched infinities */
+		return SDL_MAX_SINT32;
+	}
+	return (magnitude > 1.0f) ? (difference / magnitude) : difference;
+}
+
+static float CPUSim_GradientError(float expected, float actual)
+{
+	float difference = CPUSim_Error(expected, actual);
+	return SDL_min(difference, SDL_fabsf(1.0f - difference));
+}
+
+bool CPUSim_Compare(
+	const Particle *expected,
+	const Particle *actual,
+	uint32_t count,
+	float tolerance,
+	CPUSimCompareReport *report
+) {
+	uint32_t i;
+	float worstError = 0.0f;
+
+	report->comparedCount = count;
+	report->mismatchCount = 0;
+	report->worstIndex = 0;
+	report->maxPositionError = 0.0f;
+	report->maxVelocityError = 0.0f;
+	report->maxGradientError = 0.0f;
+
+	for (i = 0; i < count; i += 1)
+	{
+		float positionError = SDL_max(
+			CPUSim_Error(expected[i].xPosition, actual[i].xPosition),
+			CPUSim_Error(expected[i].yPosition, actual[i].yPosition)
+		);
+		float velocityError = SDL_max(
+			CPUSim_Error(expected[i].xVelocity, actual[i].xVelocity),
+			CPUSim_Error(expected[i].yVelocity, actual[i].yVelocity)
+		);
+		float gradientError = CPUSim_GradientError(
+			expected[i].gradientPosition,
+			actual[i].gradientPosition
+		);
+		float error = SDL_max(positionError, SDL_max(velocityError, gradientError));
+
+		report->maxPositionError = SDL_max(report->maxPositionError, positionError);
+		report->maxVelocityError = SDL_max(report->maxVelocityError, velocityError);
+		report->maxGradientError = SDL_max(report->maxGradientError, gradientError);
+
+		if (error > tolerance)
+		{
+			report->mismatchCount += 1;
+		}
+		if (error > worstError)
+		{
+			worstError = error;
+			report->worstIndex = i;
+		}
+	}
+
+	return report->mismatchCount == 0;
+}
+
+bool CPUSim_ValidateSteps(
+	Particle *referenceParticles,
+	const Particle *actualParticles,
+	const ParticleComputeUniforms *steps,
+	uint32_t stepCount,
+	ForceField *forceField,
+	ParticleMesh *particleMesh,
+	NeighborGrid *neighborGrid,
+	float tolerance
+) {
+	CPUSimCompareReport report;
+	uint32_t i;
+	bool result;
+
+	/* A frame that ran no step has nothing new to compare, and no step to
+	 * take the particle count from
+	 */
+	if (stepCount == 0)
+	{
+		return true;
+	}
+
+	for (i = 0; i < stepCount; i += 1)
+	{
+		if (forceField != NULL)
+		{
+			ForceField_ReferenceApply(forceField, referenceParticles, steps[i].particleCount, steps[i].deltaTime);
+		}
+		if (particleMesh != NULL)
+		{
+			ParticleMesh_ReferenceApply(particleMesh, referenceParticles, steps[i].particleCount, steps[i].deltaTime);
+		}
+		if (neighborGrid != NULL)
+		{
+			NeighborGrid_ReferenceApply(neighborGrid, referenceParticles, steps[i].particleCount, steps[i].deltaTime);
+		}
+		CPUSim_ReferenceStep(referenceParticles, &steps[i]);
+	}
+
+	result = CPUSim_Compare(referenceParticles, actualParticles, steps[0].particleCount, tolerance, &report);
+	if (!result)
+	{
+		SDL_LogInfo(
+			SDL_LOG_CATEGORY_APPLICATION,
+			"validation: %u/%u particles outside tolerance, max error pos %g vel %g gradient %g (worst particle %u)",
+			report.mismatchCount,
+			report.comparedCount,
+			report.maxPositionError,
+			report.maxVelocityError,
+			report.maxGradientError,
+			report.worstIndex
+		);
+	}
+
+	SDL_memcpy(referenceParticles, actualParticles, sizeof(Particle) * steps[0].particleCount);
+	return result;
+}
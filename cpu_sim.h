@@ -0,0 +1,131 @@
+#ifndef CPU_SIM_H
+#define CPU_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "force_field.h"
+#include "neighbor_grid.h"
+#include "particle.h"
+#include "particle_mesh.h"
+#include "particle_reorder.h"
+#include "thread_pool.h"
+
+/* CPU implementation of the particle.comp update step.
+ *
+ * Particles are kept in structure-of-arrays form so that the SSE2 and AVX2
+ * kernels can load 4/8 particles per register, and the update is split over
+ * a ThreadPool. CPUSim_ReferenceStep is a line-by-line transliteration of the
+ * GLSL that the other paths (including the GPU) are validated against.
+ */
+
+typedef enum CPUSimKernel
+{
+	CPUSIM_KERNEL_AUTO,
+	CPUSIM_KERNEL_SCALAR,
+	CPUSIM_KERNEL_SSE2,
+	CPUSIM_KERNEL_AVX2
+} CPUSimKernel;
+
+typedef struct CPUSim CPUSim;
+
+/* pool may be NULL, in which case steps run on the calling thread.
+ * Requesting a kernel the CPU cannot run falls back to the best one it can.
+ */
+CPUSim* CPUSim_Create(uint32_t particleCount, CPUSimKernel kernel, ThreadPool *pool);
+void CPUSim_Destroy(CPUSim *sim);
+
+CPUSimKernel CPUSim_GetKernel(CPUSim *sim);
+const char* CPUSim_GetKernelName(CPUSimKernel kernel);
+
+/* Floats per register of a kernel, AUTO counting as the widest */
+uint32_t CPUSim_GetKernelWidth(CPUSimKernel kernel);
+uint32_t CPUSim_GetParticleCount(CPUSim *sim);
+
+/* Conversion between the GPU vertex layout and the internal streams */
+void CPUSim_SetParticles(CPUSim *sim, const Particle *particles);
+void CPUSim_GetParticles(CPUSim *sim, Particle *particles);
+
+/* With a grid set, every step first applies NeighborGrid separation, and
+ * CPUSim_StepMany runs the steps one at a time over all particles instead
+ * of block by block. Pass NULL to turn it off again.
+ */
+void CPUSim_SetNeighborGrid(CPUSim *sim, NeighborGrid *grid);
+
+/* The same for ParticleMesh gravity, which is applied before the neighbor
+ * grid when both are set.
+ */
+void CPUSim_SetParticleMesh(CPUSim *sim, ParticleMesh *mesh);
+
+/* The same for a ForceField, which is applied first of the three */
+void CPUSim_SetForceField(CPUSim *sim, ForceField *field);
+
+/* Writes just what the split-layout vertex shader reads: interleaved xy
+ * positions and the gradient positions.
+ */
+void CPUSim_GetRenderStreams(CPUSim *sim, float *positions, float *gradientPositions);
+
+/* Sorts the particles into Morton order (particle_reorder.h), moving every
+ * stream
+ */
+void CPUSim_Reorder(CPUSim *sim, ParticleReorder *reorder);
+
+/* Advances every particle by one particle.comp dispatch */
+void CPUSim_Step(CPUSim *sim, const ParticleComputeUniforms *uniforms);
+
+/* Advances every particle by stepCount consecutive steps. Each block of
+ * particles runs all of its steps while it is still in cache, the CPU
+ * counterpart of particle_substep.comp.
+ */
+void CPUSim_StepMany(CPUSim *sim, const ParticleComputeUniforms *steps, uint32_t stepCount);
+
+/* Scalar GLSL-semantics reference, operating directly on the GPU layout.
+ * Only the first uniforms->particleCount particles are touched.
+ */
+void CPUSim_ReferenceStep(Particle *particles, const ParticleComputeUniforms *uniforms);
+
+typedef struct CPUSimCompareReport
+{
+	uint32_t comparedCount;
+	uint32_t mismatchCount;
+	uint32_t worstIndex;
+	float maxPositionError;
+	float maxVelocityError;
+	float maxGradientError;
+} CPUSimCompareReport;
+
+/* Compares two particle arrays field by field. Errors are absolute below a
+ * magnitude of 1 and relative above it; gradient positions are compared on
+ * the [0, 1) circle since they wrap. Returns true if no particle exceeds the
+ * tolerance.
+ */
+bool CPUSim_Compare(
+	const Particle *expected,
+	const Particle *actual,
+	uint32_t count,
+	float tolerance,
+	CPUSimCompareReport *report
+);
+
+/* Steps referenceParticles stepCount times with CPUSim_ReferenceStep,
+ * preceded by ForceField_ReferenceApply, ParticleMesh_ReferenceApply and
+ * NeighborGrid_ReferenceApply for whichever of forceField, particleMesh and
+ * neighborGrid is not NULL.
+ * It then compares the result with actualParticles and logs any mismatch.
+ * referenceParticles is then resynced to actualParticles so one divergent
+ * step is not reported forever.
+ * Returns false if any particle is outside tolerance. With no steps there is
+ * nothing to compare, and it returns true.
+ */
+bool CPUSim_ValidateSteps(
+	Particle *referenceParticles,
+	const Particle *actualParticles,
+	const ParticleComputeUniforms *steps,
+	uint32_t stepCount,
+	ForceField *forceField,
+	ParticleMesh *particleMesh,
+	NeighborGrid *neighborGrid,
+	float tolerance
+);
+
+#endif /* CPU_SIM_H */
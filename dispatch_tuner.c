@@ -0,0 +1,403 @@
+#include "dispatch_tuner.h"
+
+#include <SDL.h>
+
+#include "bench.h"
+#include "particle_buffers.h"
+
+#define DISPATCH_TUNE_MAGIC 0x4E544452 /* "RDTN" */
+#define DISPATCH_TUNE_VERSION 1
+
+/* Each shape runs one warm-up submission, then the fastest of the timed
+ * ones counts
+ */
+#define DISPATCH_TUNER_SAMPLES 3
+#define DISPATCH_TUNER_STEPS 8
+
+typedef struct DispatchTuneHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t reserved;
+} DispatchTuneHeader;
+
+typedef struct DispatchTuneEntry
+{
+	uint32_t layout;
+	uint32_t substepLoop;
+	uint32_t particleCount;
+	uint32_t workgroupSize;
+	uint32_t particlesPerInvocation;
+	uint32_t reserved;
+	double stepSeconds;
+} DispatchTuneEntry;
+
+/* Must match the shapes CMakeLists.txt builds */
+static const DispatchVariant dispatchVariants[] =
+{
+	{ 256, 1 },
+	{ 64, 1 },
+	{ 128, 1 },
+	{ 128, 2 },
+	{ 256, 2 },
+	{ 256, 4 }
+};
+
+DispatchVariant DispatchVariant_GetDefault(void)
+{
+	return dispatchVariants[0];
+}
+
+uint32_t DispatchVariant_GetCount(void)
+{
+	return SDL_arraysize(dispatchVariants);
+}
+
+DispatchVariant DispatchVariant_Get(uint32_t index)
+{
+	return dispatchVariants[SDL_min(index, SDL_arraysize(dispatchVariants) - 1)];
+}
+
+static bool DispatchVariant_IsDefault(const DispatchVariant *variant)
+{
+	return variant->workgroupSize == dispatchVariants[0].workgroupSize &&
+		variant->particlesPerInvocation == dispatchVariants[0].particlesPerInvocation;
+}
+
+void DispatchVariant_GetName(const DispatchVariant *variant, char *name, size_t nameSize)
+{
+	if (variant->particlesPerInvocation > 1)
+	{
+		SDL_snprintf(name, nameSize, "%ux%u", variant->workgroupSize, variant->particlesPerInvocation);
+	}
+	else
+	{
+		SDL_snprintf(name, nameSize, "%u", variant->workgroupSize);
+	}
+}
+
+bool DispatchVariant_Parse(const char *value, DispatchVariant *variant)
+{
+	char name[DISPATCH_VARIANT_NAME_LENGTH];
+	uint32_t i;
+
+	for (i = 0; i < SDL_arraysize(dispatchVariants); i += 1)
+	{
+		DispatchVariant_GetName(&dispatchVariants[i], name, sizeof(name));
+		if (SDL_strcmp(value, name) == 0)
+		{
+			*variant = dispatchVariants[i];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void DispatchVariant_GetShaderPath(
+	const DispatchVariant *variant,
+	const char *basePath,
+	char *path,
+	size_t pathSize
+) {
+	char name[DISPATCH_VARIANT_NAME_LENGTH];
+	const char *extension = SDL_strstr(basePath, ".comp.spv");
+	size_t stemLength;
+
+	if (DispatchVariant_IsDefault(variant) || extension == NULL)
+	{
+		SDL_strlcpy(path, basePath, pathSize);
+		return;
+	}
+
+	DispatchVariant_GetName(variant, name, sizeof(name));
+	stemLength = (size_t) (extension - basePath);
+	SDL_snprintf(path, pathSize, "%.*s_wg%s%s", (int) stemLength, basePath, name, extension);
+}
+
+uint32_t DispatchVariant_GetGroupCount(const DispatchVariant *variant, uint32_t particleCount)
+{
+	uint32_t groupParticles = variant->workgroupSize * variant->particlesPerInvocation;
+
+	return (uint32_t) (((uint64_t) particleCount + groupParticles - 1) / groupParticles);
+}
+
+void DispatchTuner_RecordSteps(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	ComputePass *pass,
+	bool substepLoop,
+	const ParticleComputeUniforms *steps,
+	uint32_t stepCount,
+	uint32_t groupCount
+) {
+	ParticleSubstepUniforms substepUniforms;
+	uint32_t i, batchCount;
+
+	for (i = 0; i < stepCount; i += batchCount)
+	{
+		if (substepLoop)
+		{
+			batchCount = SDL_min(stepCount - i, MAX_SUBSTEPS);
+			Particle_FillSubstepUniforms(&substepUniforms, &steps[i], batchCount);
+			ComputePass_Record(device, commandBuffer, pass, &substepUniforms, groupCount);
+		}
+		else
+		{
+			batchCount = 1;
+			ComputePass_Record(device, commandBuffer, pass, (void*) &steps[i], groupCount);
+		}
+	}
+}
+
+/* Tune file */
+
+static DispatchTuneEntry* DispatchTuner_ReadFile(const char *path, uint32_t *entryCount)
+{
+	DispatchTuneHeader header;
+	DispatchTuneEntry *entries;
+	SDL_RWops *file = SDL_RWFromFile(path, "rb");
+
+	*entryCount = 0;
+	if (file == NULL)
+	{
+		return NULL;
+	}
+
+	if (SDL_RWread(file, &header, sizeof(header), 1) != 1 ||
+		header.magic != DISPATCH_TUNE_MAGIC ||
+		header.version != DISPATCH_TUNE_VERSION)
+	{
+		SDL_Log("%s is not a version %u dispatch tune file, starting a new one", path, DISPATCH_TUNE_VERSION);
+		SDL_RWclose(file);
+		return NULL;
+	}
+
+	entries = SDL_malloc(sizeof(DispatchTuneEntry) * SDL_max(header.entryCount, 1));
+	*entryCount = (uint32_t) SDL_RWread(file, entries, sizeof(DispatchTuneEntry), header.entryCount);
+
+	SDL_RWclose(file);
+	return entries;
+}
+
+static void DispatchTuner_WriteFile(const char *path, const DispatchTuneEntry *entries, uint32_t entryCount)
+{
+	DispatchTuneHeader header;
+	SDL_RWops *file = SDL_RWFromFile(path, "wb");
+
+	if (file == NULL)
+	{
+		SDL_Log("Could not open %s for writing: %s", path, SDL_GetError());
+		return;
+	}
+
+	header.magic = DISPATCH_TUNE_MAGIC;
+	header.version = DISPATCH_TUNE_VERSION;
+	header.entryCount = entryCount;
+	header.reserved = 0;
+
+	SDL_RWwrite(file, &header, sizeof(header), 1);
+	SDL_RWwrite(file, entries, sizeof(DispatchTuneEntry), entryCount);
+	SDL_RWclose(file);
+}
+
+static DispatchTuneEntry* DispatchTuner_FindEntry(
+	DispatchTuneEntry *entries,
+	uint32_t entryCount,
+	ParticleLayout layout,
+	bool substepLoop,
+	uint32_t particleCount
+) {
+	uint32_t i;
+
+	for (i = 0; i < entryCount; i += 1)
+	{
+		if (entries[i].layout == (uint32_t) layout &&
+			entries[i].substepLoop == (uint32_t) substepLoop &&
+			entries[i].particleCount == particleCount)
+		{
+			return &entries[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Timing */
+
+/* Seconds per step of the fastest sample, or a negative value if the
+ * shape's shader is not in the bundle
+ */
+static double DispatchTuner_Time(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ParticleBuffers *particleBuffers,
+	bool substepLoop,
+	const DispatchVariant *variant,
+	const ParticleComputeUniforms *steps
+) {
+	char shaderPath[128];
+	const char *basePath = substepLoop ?
+		ParticleLayout_GetSubstepShaderPath(particleBuffers->layout) :
+		ParticleLayout_GetComputeShaderPath(particleBuffers->layout);
+	uint32_t groupCount = DispatchVariant_GetGroupCount(variant, particleBuffers->particleCount);
+	REFRESH_CommandBuffer *commandBuffer;
+	ComputePass pass;
+	uint64_t start;
+	double seconds;
+	double best = -1.0;
+	uint32_t i;
+
+	DispatchVariant_GetShaderPath(variant, basePath, shaderPath, sizeof(shaderPath));
+
+	if (!ComputePass_Create(
+		device,
+		shaderCache,
+		&pass,
+		shaderPath,
+		substepLoop ? sizeof(ParticleSubstepUniforms) : sizeof(ParticleComputeUniforms),
+		particleBuffers->buffers,
+		particleBuffers->bufferCount
+	)) {
+		ComputePass_Destroy(device, &pass);
+		return -1.0;
+	}
+
+	for (i = 0; i <= DISPATCH_TUNER_SAMPLES; i += 1)
+	{
+		start = Bench_Now();
+		commandBuffer = REFRESH_AcquireCommandBuffer(device, 0);
+		DispatchTuner_RecordSteps(device, commandBuffer, &pass, substepLoop, steps, DISPATCH_TUNER_STEPS, groupCount);
+		REFRESH_Submit(device, 1, &commandBuffer);
+		REFRESH_Wait(device);
+		seconds = Bench_Seconds(start, Bench_Now()) / DISPATCH_TUNER_STEPS;
+
+		if (i > 0 && (best < 0.0 || seconds < best))
+		{
+			best = seconds;
+		}
+	}
+
+	ComputePass_Destroy(device, &pass);
+	return best;
+}
+
+bool DispatchTuner_Select(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ParticleLayout layout,
+	bool substepLoop,
+	uint32_t particleCount,
+	uint32_t seed,
+	const char *cachePath,
+	DispatchVariant *selected
+) {
+	ParticleComputeUniforms steps[DISPATCH_TUNER_STEPS];
+	char name[DISPATCH_VARIANT_NAME_LENGTH];
+	DispatchTuneEntry *entries = NULL;
+	DispatchTuneEntry *entry = NULL;
+	ParticleBuffers *scratch;
+	DispatchVariant variant;
+	uint32_t entryCount = 0;
+	uint64_t start = Bench_Now();
+	double seconds;
+	double bestSeconds = -1.0;
+	uint32_t i;
+
+	*selected = DispatchVariant_GetDefault();
+
+	if (cachePath != NULL)
+	{
+		entries = DispatchTuner_ReadFile(cachePath, &entryCount);
+		entry = DispatchTuner_FindEntry(entries, entryCount, layout, substepLoop, particleCount);
+	}
+
+	if (entry != NULL)
+	{
+		selected->workgroupSize = entry->workgroupSize;
+		selected->particlesPerInvocation = entry->particlesPerInvocation;
+		DispatchVariant_GetName(selected, name, sizeof(name));
+
+		SDL_Log(
+			"Dispatch: workgroup %s from %s (%.3f ms/step when tuned)",
+			name,
+			cachePath,
+			entry->stepSeconds * 1e3
+		);
+		SDL_free(entries);
+		return true;
+	}
+
+	/* The real buffers are not touched, so tuning never moves the
+	 * simulation on
+	 */
+	scratch = ParticleBuffers_Create(device, layout, particleCount);
+	if (!ParticleBuffers_InitializeOnDevice(device, shaderCache, scratch, seed))
+	{
+		SDL_Log("Dispatch: could not initialize the tuning buffers, using the default workgroup");
+		ParticleBuffers_Destroy(device, scratch);
+		SDL_free(entries);
+		return false;
+	}
+
+	for (i = 0; i < DISPATCH_TUNER_STEPS; i += 1)
+	{
+		Particle_FillUniforms(&steps[i], particleCount, i * 0.01, 0.01);
+	}
+
+	for (i = 0; i < DispatchVariant_GetCount(); i += 1)
+	{
+		variant = DispatchVariant_Get(i);
+		DispatchVariant_GetName(&variant, name, sizeof(name));
+
+		seconds = DispatchTuner_Time(device, shaderCache, scratch, substepLoop, &variant, steps);
+		if (seconds < 0.0)
+		{
+			SDL_Log("Dispatch: workgroup %s not built, skipped", name);
+			continue;
+		}
+
+		SDL_Log("Dispatch: workgroup %s, %.3f ms/step", name, seconds * 1e3);
+		if (bestSeconds < 0.0 || seconds < bestSeconds)
+		{
+			bestSeconds = seconds;
+			*selected = variant;
+		}
+	}
+
+	ParticleBuffers_Destroy(device, scratch);
+
+	if (bestSeconds < 0.0)
+	{
+		SDL_Log("Dispatch: no workgroup shape could be timed, using the default");
+		SDL_free(entries);
+		return false;
+	}
+
+	DispatchVariant_GetName(selected, name, sizeof(name));
+	SDL_Log(
+		"Dispatch: tuned %u particles in %.2f s, workgroup %s is fastest",
+		particleCount,
+		Bench_Seconds(start, Bench_Now()),
+		name
+	);
+
+	if (cachePath != NULL)
+	{
+		entries = SDL_realloc(entries, sizeof(DispatchTuneEntry) * (entryCount + 1));
+		entry = &entries[entryCount++];
+		entry->layout = (uint32_t) layout;
+		entry->substepLoop = (uint32_t) substepLoop;
+		entry->particleCount = particleCount;
+		entry->workgroupSize = selected->workgroupSize;
+		entry->particlesPerInvocation = selected->particlesPerInvocation;
+		entry->reserved = 0;
+		entry->stepSeconds = bestSeconds;
+
+		DispatchTuner_WriteFile(cachePath, entries, entryCount);
+	}
+
+	SDL_free(entries);
+	return true;
+}
@@ -0,0 +1,92 @@
+#ifndef DISPATCH_TUNER_H
+#define DISPATCH_TUNER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Refresh.h>
+
+#include "compute_pass.h"
+#include "particle.h"
+#include "shader_module.h"
+
+/* Workgroup shapes of the particle update, and the startup search for the
+ * fastest one.
+ *
+ * particle.comp, its split and quantized versions and particle_substep.comp
+ * are also built for a few other workgroup sizes and particles per
+ * invocation (see CMakeLists.txt). DispatchTuner_Select times every shape
+ * on the device and keeps the winner in a small file keyed by layout,
+ * substep mode and particle count, so later starts skip the search.
+ *
+ * Refresh does not say which adapter it opened, so, like the pipeline
+ * index, the file stands for this machine's device. Delete it after
+ * changing the GPU or its driver.
+ */
+
+typedef struct DispatchVariant
+{
+	uint32_t workgroupSize;
+	uint32_t particlesPerInvocation;
+} DispatchVariant;
+
+#define DISPATCH_VARIANT_NAME_LENGTH 16
+
+/* 256 threads with one particle each, the shaders without a suffix */
+DispatchVariant DispatchVariant_GetDefault(void);
+
+/* Every built shape, the default first */
+uint32_t DispatchVariant_GetCount(void);
+DispatchVariant DispatchVariant_Get(uint32_t index);
+
+/* "256", or "256x2" with more than one particle per invocation. Parse
+ * accepts the same and fails for shapes that were not built.
+ */
+void DispatchVariant_GetName(const DispatchVariant *variant, char *name, size_t nameSize);
+bool DispatchVariant_Parse(const char *value, DispatchVariant *variant);
+
+/* The shape's build of basePath, e.g. particle_split_wg128x2.comp.spv for
+ * particle_split.comp.spv
+ */
+void DispatchVariant_GetShaderPath(
+	const DispatchVariant *variant,
+	const char *basePath,
+	char *path,
+	size_t pathSize
+);
+
+/* Groups covering particleCount, rounded up */
+uint32_t DispatchVariant_GetGroupCount(const DispatchVariant *variant, uint32_t particleCount);
+
+/* Records stepCount steps with the pass: a dispatch per step, or with
+ * substepLoop particle_substep.comp batches of up to MAX_SUBSTEPS
+ */
+void DispatchTuner_RecordSteps(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	ComputePass *pass,
+	bool substepLoop,
+	const ParticleComputeUniforms *steps,
+	uint32_t stepCount,
+	uint32_t groupCount
+);
+
+/* Picks the shape for layout, substep mode and particleCount: the one in
+ * the file at cachePath if an earlier run timed them, otherwise the
+ * fastest of a timing run on scratch buffers, which is then stored.
+ * cachePath may be NULL to time every start. Submits and waits. Falls back
+ * to the default and returns false if no shape could be timed.
+ */
+bool DispatchTuner_Select(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ParticleLayout layout,
+	bool substepLoop,
+	uint32_t particleCount,
+	uint32_t seed,
+	const char *cachePath,
+	DispatchVariant *selected
+);
+
+#endif /* DISPATCH_TUNER_H */
@@ -0,0 +1,193 @@
+#include "file_map.h"
+
+#include <SDL.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define FILE_MAP_PAGE_SIZE 4096
+
+#ifdef _WIN32
+
+static bool FileMap_Map(FileMap *map, const char *path)
+{
+	LARGE_INTEGER fileSize;
+	HANDLE file, mapping;
+	const void *data;
+
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == NULL)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	map->data = data;
+	map->size = (uint64_t) fileSize.QuadPart;
+	map->mapped = true;
+	map->file = file;
+	map->mapping = mapping;
+	return true;
+}
+
+static void FileMap_Unmap(FileMap *map)
+{
+	UnmapViewOfFile(map->data);
+	CloseHandle((HANDLE) map->mapping);
+	CloseHandle((HANDLE) map->file);
+}
+
+static void FileMap_Advise(FileMap *map, uint64_t offset, uint64_t length)
+{
+}
+
+#else
+
+static bool FileMap_Map(FileMap *map, const char *path)
+{
+	struct stat fileStat;
+	void *data;
+	int file = open(path, O_RDONLY);
+
+	if (file < 0)
+	{
+		return false;
+	}
+
+	if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+
+	data = mmap(NULL, (size_t) fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+
+	map->data = data;
+	map->size = (uint64_t) fileStat.st_size;
+	map->mapped = true;
+	return true;
+}
+
+static void FileMap_Unmap(FileMap *map)
+{
+	munmap((void*) map->data, (size_t) map->size);
+}
+
+static void FileMap_Advise(FileMap *map, uint64_t offset, uint64_t length)
+{
+	uint64_t pageStart = offset & ~(uint64_t) (FILE_MAP_PAGE_SIZE - 1);
+	madvise((void*) (map->data + pageStart), (size_t) (offset + length - pageStart), MADV_WILLNEED);
+}
+
+#endif
+
+static bool FileMap_Read(FileMap *map, const char *path)
+{
+	SDL_RWops *file = SDL_RWFromFile(path, "rb");
+	Sint64 size;
+	uint8_t *data;
+
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	size = SDL_RWsize(file);
+	if (size <= 0)
+	{
+		SDL_RWclose(file);
+		return false;
+	}
+
+	data = SDL_malloc((size_t) size);
+	if (SDL_RWread(file, data, 1, (size_t) size) != (size_t) size)
+	{
+		SDL_free(data);
+		SDL_RWclose(file);
+		return false;
+	}
+	SDL_RWclose(file);
+
+	map->data = data;
+	map->size = (uint64_t) size;
+	map->mapped = false;
+	return true;
+}
+
+bool FileMap_Open(FileMap *map, const char *path)
+{
+	SDL_zerop(map);
+	return FileMap_Map(map, path) || FileMap_Read(map, path);
+}
+
+void FileMap_Close(FileMap *map)
+{
+	if (map->data == NULL)
+	{
+		return;
+	}
+
+	if (map->mapped)
+	{
+		FileMap_Unmap(map);
+	}
+	else
+	{
+		SDL_free((void*) map->data);
+	}
+	SDL_zerop(map);
+}
+
+void FileMap_Prefetch(FileMap *map, uint64_t offset, uint64_t length)
+{
+	const volatile uint8_t *bytes = map->data;
+	uint64_t i;
+
+	if (length == 0 || offset + length > map->size)
+	{
+		return;
+	}
+
+	if (map->mapped)
+	{
+		FileMap_Advise(map, offset, length);
+	}
+
+	for (i = offset; i < offset + length; i += FILE_MAP_PAGE_SIZE)
+	{
+		(void) bytes[i];
+	}
+}
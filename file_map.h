@@ -0,0 +1,32 @@
+#ifndef FILE_MAP_H
+#define FILE_MAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A whole file mapped read-only into memory, for the baked asset bundles.
+ * Where mapping is not available the file is read into a heap buffer
+ * instead, so callers only ever see data and size.
+ */
+
+typedef struct FileMap
+{
+	const uint8_t *data;
+	uint64_t size;
+	bool mapped; /* otherwise data is a heap copy */
+
+	/* Windows file and mapping handles */
+	void *file;
+	void *mapping;
+} FileMap;
+
+/* Returns false without logging if the file does not exist or is empty */
+bool FileMap_Open(FileMap *map, const char *path);
+void FileMap_Close(FileMap *map);
+
+/* Hints that [offset, offset + length) is about to be read and faults it
+ * in by touching one byte per page
+ */
+void FileMap_Prefetch(FileMap *map, uint64_t offset, uint64_t length);
+
+#endif /* FILE_MAP_H */
@@ -0,0 +1,813 @@
+#include "force_field.h"
+
+#include <stdbool.h>
+
+#include <SDL.h>
+
+#include "bench.h"
+#include "simd.h"
+
+#define FORCE_FIELD_GRAIN_SIZE 256
+
+/* Particles summed at once before their velocities are updated */
+#define FORCE_FIELD_BLOCK_SIZE 64
+
+/* Attractors are drawn from counters past any particle's (2i and 2i + 1),
+ * three per attractor
+ */
+#define FORCE_FIELD_COUNTER_BASE (1ull << 40)
+
+/* Repetitions of each timed step in ForceField_LogSweep */
+#define FORCE_FIELD_SWEEP_REPEATS 5
+
+struct ForceField
+{
+	ThreadPool *pool;
+	ForceFieldMode mode;
+	uint32_t vectorWidth;
+
+	uint32_t gridSize;
+	float invCellSize;
+
+	ForceFieldAttractor *attractors;
+	uint32_t attractorCount;
+
+	/* Every cell's center, the points the GRID bake sums at */
+	float *cellX; /* [gridSize^2] */
+	float *cellY;
+
+	/* The baked attractors (GRID only) and the texture, each NULL if
+	 * absent, and their sum, which is what particles interpolate
+	 */
+	float *bakedX;
+	float *bakedY;
+	float *textureX;
+	float *textureY;
+	float *fieldX;
+	float *fieldY;
+	float *field; /* [gridSize^2][2], fieldX and fieldY interleaved */
+	bool sampleField;
+
+	/* Serial scalar bake for ForceField_ReferenceApply, made on first use */
+	float *referenceFieldX;
+	float *referenceFieldY;
+
+	ForceFieldTimings timings;
+};
+
+typedef struct ForceFieldContext
+{
+	ForceField *field;
+	const float *xPosition;
+	const float *yPosition;
+	float *xVelocity;
+	float *yVelocity;
+	float deltaTime;
+} ForceFieldContext;
+
+/* Shared by every path; force_field.comp has the same functions */
+
+static float ForceField_Softening2(void)
+{
+	return FORCE_FIELD_SOFTENING * FORCE_FIELD_SOFTENING;
+}
+
+/* The same location as ParticleMesh_LocateOne on this grid */
+static void ForceField_LocateOne(
+	const ForceField *field,
+	float x,
+	float y,
+	uint32_t *cell,
+	float *fractionX,
+	float *fractionY
+) {
+	float maxCoordinate = (float) (field->gridSize - 1);
+	float maxBase = (float) (field->gridSize - 2);
+	float gridX = (x + 1.0f) * field->invCellSize - 0.5f;
+	float gridY = (y + 1.0f) * field->invCellSize - 0.5f;
+	float baseX, baseY;
+
+	gridX = SDL_max(SDL_min(gridX, maxCoordinate), 0.0f);
+	gridY = SDL_max(SDL_min(gridY, maxCoordinate), 0.0f);
+	baseX = SDL_min(SDL_floorf(gridX), maxBase);
+	baseY = SDL_min(SDL_floorf(gridY), maxBase);
+
+	*cell = (uint32_t) baseY * field->gridSize + (uint32_t) baseX;
+	*fractionX = gridX - baseX;
+	*fractionY = gridY - baseY;
+}
+
+static float ForceField_Interpolate(const float *values, uint32_t gridSize, uint32_t cell, float fractionX, float fractionY)
+{
+	float restX = 1.0f - fractionX;
+	float restY = 1.0f - fractionY;
+
+	return (values[cell] * restX + values[cell + 1] * fractionX) * restY +
+		(values[cell + gridSize] * restX + values[cell + gridSize + 1] * fractionX) * fractionY;
+}
+
+/* Attractor sums at count points, overwriting forceX and forceY. Each lane
+ * runs the scalar loop's operations in the scalar loop's order.
+ */
+
+static void ForceField_Sum_Scalar(
+	const ForceFieldAttractor *attractors,
+	uint32_t attractorCount,
+	const float *x,
+	const float *y,
+	float *forceX,
+	float *forceY,
+	uint32_t start,
+	uint32_t end
+) {
+	float softening2 = ForceField_Softening2();
+	uint32_t i, j;
+
+	for (i = start; i < end; i += 1)
+	{
+		float sumX = 0.0f;
+		float sumY = 0.0f;
+
+		for (j = 0; j < attractorCount; j += 1)
+		{
+			float deltaX = attractors[j].x - x[i];
+			float deltaY = attractors[j].y - y[i];
+			float inverseDistance = 1.0f / SDL_sqrtf(deltaX * deltaX + deltaY * deltaY + softening2);
+			float scale = attractors[j].strength * (inverseDistance * inverseDistance * inverseDistance);
+
+			sumX += deltaX * scale;
+			sumY += deltaY * scale;
+		}
+
+		forceX[i] = sumX;
+		forceY[i] = sumY;
+	}
+}
+
+#ifdef SIMD_X86
+
+/* SSE2 kernel, 4 points per iteration */
+
+SIMD_TARGET_SSE2
+static void ForceField_Sum_SSE2(
+	const ForceFieldAttractor *attractors,
+	uint32_t attractorCount,
+	const float *x,
+	const float *y,
+	float *forceX,
+	float *forceY,
+	uint32_t start,
+	uint32_t end
+) {
+	uint32_t i, j;
+	uint32_t vectorEnd = start + ((end - start) & ~3u);
+
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 softening2 = _mm_set1_ps(ForceField_Softening2());
+
+	for (i = start; i < vectorEnd; i += 4)
+	{
+		__m128 pointX = _mm_loadu_ps(x + i);
+		__m128 pointY = _mm_loadu_ps(y + i);
+		__m128 sumX = _mm_setzero_ps();
+		__m128 sumY = _mm_setzero_ps();
+
+		for (j = 0; j < attractorCount; j += 1)
+		{
+			__m128 deltaX = _mm_sub_ps(_mm_set1_ps(attractors[j].x), pointX);
+			__m128 deltaY = _mm_sub_ps(_mm_set1_ps(attractors[j].y), pointY);
+			__m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(deltaX, deltaX), _mm_mul_ps(deltaY, deltaY)), softening2);
+			__m128 inverseDistance = _mm_div_ps(one, _mm_sqrt_ps(distance2));
+			__m128 scale = _mm_mul_ps(
+				_mm_set1_ps(attractors[j].strength),
+				_mm_mul_ps(_mm_mul_ps(inverseDistance, inverseDistance), inverseDistance)
+			);
+
+			sumX = _mm_add_ps(sumX, _mm_mul_ps(deltaX, scale));
+			sumY = _mm_add_ps(sumY, _mm_mul_ps(deltaY, scale));
+		}
+
+		_mm_storeu_ps(forceX + i, sumX);
+		_mm_storeu_ps(forceY + i, sumY);
+	}
+
+	ForceField_Sum_Scalar(attractors, attractorCount, x, y, forceX, forceY, vectorEnd, end);
+}
+
+/* AVX2 kernel, 8 points per iteration, without FMA (simd.h) */
+
+SIMD_TARGET_AVX2
+static void ForceField_Sum_AVX2(
+	const ForceFieldAttractor *attractors,
+	uint32_t attractorCount,
+	const float *x,
+	const float *y,
+	float *forceX,
+	float *forceY,
+	uint32_t start,
+	uint32_t end
+) {
+	uint32_t i, j;
+	uint32_t vectorEnd = start + ((end - start) & ~7u);
+
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 softening2 = _mm256_set1_ps(ForceField_Softening2());
+
+	for (i = start; i < vectorEnd; i += 8)
+	{
+		__m256 pointX = _mm256_loadu_ps(x + i);
+		__m256 pointY = _mm256_loadu_ps(y + i);
+		__m256 sumX = _mm256_setzero_ps();
+		__m256 sumY = _mm256_setzero_ps();
+
+		for (j = 0; j < attractorCount; j += 1)
+		{
+			__m256 deltaX = _mm256_sub_ps(_mm256_set1_ps(attractors[j].x), pointX);
+			__m256 deltaY = _mm256_sub_ps(_mm256_set1_ps(attractors[j].y), pointY);
+			__m256 distance2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(deltaX, deltaX), _mm256_mul_ps(deltaY, deltaY)), softening2);
+			__m256 inverseDistance = _mm256_div_ps(one, _mm256_sqrt_ps(distance2));
+			__m256 scale = _mm256_mul_ps(
+				_mm256_set1_ps(attractors[j].strength),
+				_mm256_mul_ps(_mm256_mul_ps(inverseDistance, inverseDistance), inverseDistance)
+			);
+
+			sumX = _mm256_add_ps(sumX, _mm256_mul_ps(deltaX, scale));
+			sumY = _mm256_add_ps(sumY, _mm256_mul_ps(deltaY, scale));
+		}
+
+		_mm256_storeu_ps(forceX + i, sumX);
+		_mm256_storeu_ps(forceY + i, sumY);
+	}
+
+	ForceField_Sum_Scalar(attractors, attractorCount, x, y, forceX, forceY, vectorEnd, end);
+}
+
+#endif /* SIMD_X86 */
+
+static void ForceField_Sum(
+	const ForceField *field,
+	const float *x,
+	const float *y,
+	float *forceX,
+	float *forceY,
+	uint32_t start,
+	uint32_t end
+) {
+	switch (field->vectorWidth)
+	{
+#ifdef SIMD_X86
+	case 8:
+		ForceField_Sum_AVX2(field->attractors, field->attractorCount, x, y, forceX, forceY, start, end);
+		break;
+
+	case 4:
+		ForceField_Sum_SSE2(field->attractors, field->attractorCount, x, y, forceX, forceY, start, end);
+		break;
+#endif
+
+	default:
+		ForceField_Sum_Scalar(field->attractors, field->attractorCount, x, y, forceX, forceY, start, end);
+		break;
+	}
+}
+
+static void ForceField_ParallelFor(ForceField *field, uint32_t count, uint32_t grainSize, ThreadPoolRangeFunc func, void *userdata)
+{
+	if (field->pool == NULL)
+	{
+		func(userdata, 0, count);
+	}
+	else
+	{
+		ThreadPool_ParallelFor(field->pool, count, grainSize, func, userdata);
+	}
+}
+
+/* Creation */
+
+static void ForceField_GenerateAttractors(ForceFieldAttractor *attractors, uint32_t count, float strength, uint32_t seed)
+{
+	uint64_t key = Particle_RandomKey(seed);
+	uint64_t counter;
+	float weight, totalWeight = 0.0f;
+	uint32_t i;
+
+	for (i = 0; i < count; i += 1)
+	{
+		counter = FORCE_FIELD_COUNTER_BASE + (uint64_t) i * 3;
+		attractors[i].x = Particle_RandomSigned(Particle_Random(key, counter + 0)) * 0.9f;
+		attractors[i].y = Particle_RandomSigned(Particle_Random(key, counter + 1)) * 0.9f;
+
+		/* Weights in [0.5, 1.5), one draw in four negative */
+		weight = Particle_RandomSigned(Particle_Random(key, counter + 2)) * 0.5f + 1.0f;
+		attractors[i].strength = ((Particle_Random(key, counter + 2) & 3) == 0) ? -weight : weight;
+		attractors[i].padding = 0.0f;
+		totalWeight += weight;
+	}
+
+	for (i = 0; i < count; i += 1)
+	{
+		attractors[i].strength *= strength / totalWeight;
+	}
+}
+
+static void ForceField_BakeRange(void *userdata, uint32_t start, uint32_t end)
+{
+	ForceField *field = ((ForceFieldContext*) userdata)->field;
+	uint32_t gridSize = field->gridSize;
+
+	ForceField_Sum(field, field->cellX, field->cellY, field->bakedX, field->bakedY, start * gridSize, end * gridSize);
+}
+
+/* fieldX/fieldY and the interleaved copy from the baked attractors and the
+ * texture, in that order
+ */
+static void ForceField_Combine(ForceField *field)
+{
+	uint32_t i;
+	uint32_t cellCount = field->gridSize * field->gridSize;
+
+	for (i = 0; i < cellCount; i += 1)
+	{
+		float x = (field->bakedX != NULL) ? field->bakedX[i] : 0.0f;
+		float y = (field->bakedY != NULL) ? field->bakedY[i] : 0.0f;
+
+		if (field->textureX != NULL)
+		{
+			x += field->textureX[i];
+			y += field->textureY[i];
+		}
+
+		field->fieldX[i] = x;
+		field->fieldY[i] = y;
+		field->field[i * 2 + 0] = x;
+		field->field[i * 2 + 1] = y;
+	}
+
+	field->sampleField = (field->bakedX != NULL || field->textureX != NULL);
+}
+
+ForceField* ForceField_Create(
+	ForceFieldMode mode,
+	uint32_t gridSize,
+	uint32_t attractorCount,
+	float strength,
+	uint32_t seed,
+	uint32_t maxVectorWidth,
+	ThreadPool *pool
+) {
+	ForceFieldContext context;
+	uint32_t x, y;
+	uint32_t cellCount = gridSize * gridSize;
+	uint64_t start;
+	ForceField *field = SDL_malloc(sizeof(ForceField));
+
+	SDL_assert(gridSize >= FORCE_FIELD_MIN_SIZE && gridSize <= FORCE_FIELD_MAX_SIZE);
+	SDL_assert(attractorCount <= FORCE_FIELD_MAX_ATTRACTORS);
+
+	SDL_zerop(field);
+	field->pool = pool;
+	field->mode = mode;
+	field->vectorWidth = Simd_ResolveVectorWidth(maxVectorWidth);
+	field->gridSize = gridSize;
+	field->invCellSize = gridSize / 2.0f;
+
+	/* Never empty, so the GPU buffer holding them is not either */
+	field->attractorCount = attractorCount;
+	field->attractors = SDL_malloc(sizeof(ForceFieldAttractor) * SDL_max(attractorCount, 1));
+	SDL_zerop(field->attractors);
+	ForceField_GenerateAttractors(field->attractors, attractorCount, strength, seed);
+
+	field->cellX = SDL_malloc(sizeof(float) * cellCount);
+	field->cellY = SDL_malloc(sizeof(float) * cellCount);
+	field->fieldX = SDL_malloc(sizeof(float) * cellCount);
+	field->fieldY = SDL_malloc(sizeof(float) * cellCount);
+	field->field = SDL_malloc(sizeof(float) * 2 * cellCount);
+
+	for (y = 0; y < gridSize; y += 1)
+	{
+		for (x = 0; x < gridSize; x += 1)
+		{
+			field->cellX[y * gridSize + x] = ((float) x + 0.5f) / field->invCellSize - 1.0f;
+			field->cellY[y * gridSize + x] = ((float) y + 0.5f) / field->invCellSize - 1.0f;
+		}
+	}
+
+	start = Bench_Now();
+	if (mode == FORCE_FIELD_MODE_GRID)
+	{
+		field->bakedX = SDL_malloc(sizeof(float) * cellCount);
+		field->bakedY = SDL_malloc(sizeof(float) * cellCount);
+
+		context.field = field;
+		ForceField_ParallelFor(field, gridSize, 1, ForceField_BakeRange, &context);
+	}
+	ForceField_Combine(field);
+	field->timings.bakeSeconds = Bench_Seconds(start, Bench_Now());
+
+	return field;
+}
+
+void ForceField_Destroy(ForceField *field)
+{
+	if (field == NULL)
+	{
+		return;
+	}
+
+	SDL_free(field->attractors);
+	SDL_free(field->cellX);
+	SDL_free(field->cellY);
+	SDL_free(field->bakedX);
+	SDL_free(field->bakedY);
+	SDL_free(field->textureX);
+	SDL_free(field->textureY);
+	SDL_free(field->fieldX);
+	SDL_free(field->fieldY);
+	SDL_free(field->field);
+	SDL_free(field->referenceFieldX);
+	SDL_free(field->referenceFieldY);
+	SDL_free(field);
+}
+
+/* One channel of the image, bilinear with clamped edges */
+static float ForceField_SampleImage(const uint8_t *rgba, uint32_t width, uint32_t height, uint32_t channel, float u, float v)
+{
+	float sx = SDL_max(SDL_min(u * (float) width - 0.5f, (float) (width - 1)), 0.0f);
+	float sy = SDL_max(SDL_min(v * (float) height - 0.5f, (float) (height - 1)), 0.0f);
+	uint32_t x0 = (uint32_t) sx;
+	uint32_t y0 = (uint32_t) sy;
+	uint32_t x1 = SDL_min(x0 + 1, width - 1);
+	uint32_t y1 = SDL_min(y0 + 1, height - 1);
+	float tx = sx - (float) x0;
+	float ty = sy - (float) y0;
+
+	float top = rgba[(y0 * width + x0) * 4 + channel] * (1.0f - tx) + rgba[(y0 * width + x1) * 4 + channel] * tx;
+	float bottom = rgba[(y1 * width + x0) * 4 + channel] * (1.0f - tx) + rgba[(y1 * width + x1) * 4 + channel] * tx;
+
+	return top * (1.0f - ty) + bottom * ty;
+}
+
+void ForceField_SetTexture(ForceField *field, const uint8_t *rgba, uint32_t width, uint32_t height, float strength)
+{
+	uint32_t i;
+	uint32_t cellCount = field->gridSize * field->gridSize;
+	float scale = 2.0f * strength / 255.0f;
+
+	if (field->textureX == NULL)
+	{
+		field->textureX = SDL_malloc(sizeof(float) * cellCount);
+		field->textureY = SDL_malloc(sizeof(float) * cellCount);
+	}
+
+	for (i = 0; i < cellCount; i += 1)
+	{
+		float u = (field->cellX[i] + 1.0f) * 0.5f;
+		float v = (field->cellY[i] + 1.0f) * 0.5f;
+
+		field->textureX[i] = ForceField_SampleImage(rgba, width, height, 0, u, v) * scale - strength;
+		field->textureY[i] = ForceField_SampleImage(rgba, width, height, 1, u, v) * scale - strength;
+	}
+
+	ForceField_Combine(field);
+
+	/* The reference field is rebuilt with the texture on its next use */
+	SDL_free(field->referenceFieldX);
+	SDL_free(field->referenceFieldY);
+	field->referenceFieldX = NULL;
+	field->referenceFieldY = NULL;
+}
+
+ForceFieldMode ForceField_GetMode(ForceField *field)
+{
+	return field->mode;
+}
+
+const char* ForceField_GetModeName(ForceFieldMode mode)
+{
+	switch (mode)
+	{
+	case FORCE_FIELD_MODE_DIRECT:
+		return "direct";
+	case FORCE_FIELD_MODE_GRID:
+		return "grid";
+	default:
+		return "unknown";
+	}
+}
+
+uint32_t ForceField_GetGridSize(ForceField *field)
+{
+	return field->gridSize;
+}
+
+uint32_t ForceField_GetAttractorCount(ForceField *field)
+{
+	return field->attractorCount;
+}
+
+uint32_t ForceField_GetVectorWidth(ForceField *field)
+{
+	return field->vectorWidth;
+}
+
+const ForceFieldAttractor* ForceField_GetAttractors(ForceField *field)
+{
+	return field->attractors;
+}
+
+const float* ForceField_GetField(ForceField *field)
+{
+	return field->field;
+}
+
+void ForceField_FillUniforms(
+	ForceField *field,
+	ForceFieldUniforms *uniforms,
+	uint32_t particleCount,
+	float deltaTime
+) {
+	uniforms->deltaTime = deltaTime;
+	uniforms->invCellSize = field->invCellSize;
+	uniforms->softening2 = ForceField_Softening2();
+	uniforms->particleCount = particleCount;
+	uniforms->gridSize = field->gridSize;
+	uniforms->attractorCount = (field->mode == FORCE_FIELD_MODE_DIRECT) ? field->attractorCount : 0;
+	uniforms->sampleField = field->sampleField ? 1 : 0;
+	uniforms->padding = 0;
+}
+
+/* Stepping */
+
+static void ForceField_ApplyRange(void *userdata, uint32_t start, uint32_t end)
+{
+	ForceFieldContext *context = (ForceFieldContext*) userdata;
+	ForceField *field = context->field;
+	bool direct = (field->mode == FORCE_FIELD_MODE_DIRECT);
+	float forceX[FORCE_FIELD_BLOCK_SIZE];
+	float forceY[FORCE_FIELD_BLOCK_SIZE];
+	uint32_t blockStart, blockEnd, i, index, cell;
+	float fractionX, fractionY, x, y;
+
+	for (blockStart = start; blockStart < end; blockStart = blockEnd)
+	{
+		blockEnd = SDL_min(blockStart + FORCE_FIELD_BLOCK_SIZE, end);
+
+		if (direct)
+		{
+			ForceField_Sum(
+				field,
+				context->xPosition + blockStart,
+				context->yPosition + blockStart,
+				forceX,
+				forceY,
+				0,
+				blockEnd - blockStart
+			);
+		}
+
+		for (i = 0; i < blockEnd - blockStart; i += 1)
+		{
+			index = blockStart + i;
+			x = 0.0f;
+			y = 0.0f;
+
+			if (field->sampleField)
+			{
+				ForceField_LocateOne(field, context->xPosition[index], context->yPosition[index], &cell, &fractionX, &fractionY);
+				x = ForceField_Interpolate(field->fieldX, field->gridSize, cell, fractionX, fractionY);
+				y = ForceField_Interpolate(field->fieldY, field->gridSize, cell, fractionX, fractionY);
+			}
+			if (direct)
+			{
+				x += forceX[i];
+				y += forceY[i];
+			}
+
+			context->xVelocity[index] += x * context->deltaTime;
+			context->yVelocity[index] += y * context->deltaTime;
+		}
+	}
+}
+
+void ForceField_Apply(
+	ForceField *field,
+	const float *xPosition,
+	const float *yPosition,
+	float *xVelocity,
+	float *yVelocity,
+	uint32_t count,
+	float deltaTime
+) {
+	ForceFieldContext context;
+	uint64_t start = Bench_Now();
+
+	context.field = field;
+	context.xPosition = xPosition;
+	context.yPosition = yPosition;
+	context.xVelocity = xVelocity;
+	context.yVelocity = yVelocity;
+	context.deltaTime = deltaTime;
+
+	ForceField_ParallelFor(field, count, FORCE_FIELD_GRAIN_SIZE, ForceField_ApplyRange, &context);
+
+	field->timings.applySeconds += Bench_Seconds(start, Bench_Now());
+	field->timings.stepCount += 1;
+}
+
+/* Reference: serial and scalar, one particle and one attractor at a time */
+
+void ForceField_ReferenceApply(ForceField *field, Particle *particles, uint32_t count, float deltaTime)
+{
+	uint32_t cellCount = field->gridSize * field->gridSize;
+	uint32_t i, cell;
+	float fractionX, fractionY, forceX, forceY, x, y;
+
+	if (field->sampleField && field->referenceFieldX == NULL)
+	{
+		field->referenceFieldX = SDL_malloc(sizeof(float) * cellCount);
+		field->referenceFieldY = SDL_malloc(sizeof(float) * cellCount);
+
+		for (i = 0; i < cellCount; i += 1)
+		{
+			x = 0.0f;
+			y = 0.0f;
+
+			if (field->mode == FORCE_FIELD_MODE_GRID)
+			{
+				ForceField_Sum_Scalar(field->attractors, field->attractorCount, &field->cellX[i], &field->cellY[i], &x, &y, 0, 1);
+			}
+			if (field->textureX != NULL)
+			{
+				x += field->textureX[i];
+				y += field->textureY[i];
+			}
+
+			field->referenceFieldX[i] = x;
+			field->referenceFieldY[i] = y;
+		}
+	}
+
+	for (i = 0; i < count; i += 1)
+	{
+		x = 0.0f;
+		y = 0.0f;
+
+		if (field->sampleField)
+		{
+			ForceField_LocateOne(field, particles[i].xPosition, particles[i].yPosition, &cell, &fractionX, &fractionY);
+			x = ForceField_Interpolate(field->referenceFieldX, field->gridSize, cell, fractionX, fractionY);
+			y = ForceField_Interpolate(field->referenceFieldY, field->gridSize, cell, fractionX, fractionY);
+		}
+		if (field->mode == FORCE_FIELD_MODE_DIRECT)
+		{
+			ForceField_Sum_Scalar(field->attractors, field->attractorCount, &particles[i].xPosition, &particles[i].yPosition, &forceX, &forceY, 0, 1);
+			x += forceX;
+			y += forceY;
+		}
+
+		particles[i].xVelocity += x * deltaTime;
+		particles[i].yVelocity += y * deltaTime;
+	}
+}
+
+/* Reporting */
+
+void ForceField_GetTimings(ForceField *field, ForceFieldTimings *timings)
+{
+	*timings = field->timings;
+}
+
+void ForceField_LogTimings(ForceField *field)
+{
+	ForceFieldTimings *timings = &field->timings;
+	double scale = (timings->stepCount > 0) ? (1000.0 / timings->stepCount) : 0.0;
+
+	SDL_Log(
+		"Force field: %s, %u attractors, %ux%u grid (%u-wide), bake %.3f ms, %u steps, %.3f ms per step",
+		ForceField_GetModeName(field->mode),
+		field->attractorCount,
+		field->gridSize,
+		field->gridSize,
+		field->vectorWidth,
+		timings->bakeSeconds * 1000.0,
+		timings->stepCount,
+		timings->applySeconds * scale
+	);
+}
+
+static uint32_t ForceField_SampleIndex(uint32_t sample, uint32_t sampleCount, uint32_t count)
+{
+	return (uint32_t) ((uint64_t) sample * count / sampleCount);
+}
+
+/* Average milliseconds per ForceField_Apply over every particle. With
+ * zeroed velocities and a unit step the velocity is the force.
+ */
+static double ForceField_TimeSteps(
+	ForceField *field,
+	const float *xPosition,
+	const float *yPosition,
+	float *xVelocity,
+	float *yVelocity,
+	uint32_t count
+) {
+	ForceFieldTimings timings;
+	uint32_t repeat;
+
+	for (repeat = 0; repeat < FORCE_FIELD_SWEEP_REPEATS; repeat += 1)
+	{
+		SDL_memset(xVelocity, 0, sizeof(float) * count);
+		SDL_memset(yVelocity, 0, sizeof(float) * count);
+		ForceField_Apply(field, xPosition, yPosition, xVelocity, yVelocity, count, 1.0f);
+	}
+
+	ForceField_GetTimings(field, &timings);
+	return timings.applySeconds * 1000.0 / timings.stepCount;
+}
+
+void ForceField_LogSweep(
+	const Particle *particles,
+	uint32_t count,
+	uint32_t gridSize,
+	uint32_t maxAttractorCount,
+	float strength,
+	uint32_t seed,
+	uint32_t sampleCount,
+	uint32_t maxVectorWidth,
+	ThreadPool *pool
+) {
+	ForceField *direct, *grid;
+	ForceFieldTimings gridTimings;
+	uint32_t i, attractorCount, index;
+	double directMilliseconds, gridMilliseconds, errorX, errorY, error2, force2, maxError2;
+	float *xPosition = SDL_malloc(sizeof(float) * count);
+	float *yPosition = SDL_malloc(sizeof(float) * count);
+	float *directX = SDL_malloc(sizeof(float) * count);
+	float *directY = SDL_malloc(sizeof(float) * count);
+	float *gridX = SDL_malloc(sizeof(float) * count);
+	float *gridY = SDL_malloc(sizeof(float) * count);
+
+	sampleCount = SDL_max(SDL_min(sampleCount, count), 1);
+	maxAttractorCount = SDL_min(maxAttractorCount, FORCE_FIELD_MAX_ATTRACTORS);
+
+	for (i = 0; i < count; i += 1)
+	{
+		xPosition[i] = particles[i].xPosition;
+		yPosition[i] = particles[i].yPosition;
+	}
+
+	SDL_Log(
+		"Force field sweep: %u particles, %ux%u grid, strength %g, softening %g, grid error against direct summation at %u particles",
+		count,
+		gridSize,
+		gridSize,
+		strength,
+		FORCE_FIELD_SOFTENING,
+		sampleCount
+	);
+
+	for (attractorCount = 1; attractorCount <= maxAttractorCount; attractorCount *= 4)
+	{
+		direct = ForceField_Create(FORCE_FIELD_MODE_DIRECT, gridSize, attractorCount, strength, seed, maxVectorWidth, pool);
+		grid = ForceField_Create(FORCE_FIELD_MODE_GRID, gridSize, attractorCount, strength, seed, maxVectorWidth, pool);
+
+		directMilliseconds = ForceField_TimeSteps(direct, xPosition, yPosition, directX, directY, count);
+		gridMilliseconds = ForceField_TimeSteps(grid, xPosition, yPosition, gridX, gridY, count);
+		ForceField_GetTimings(grid, &gridTimings);
+
+		force2 = 0.0;
+		error2 = 0.0;
+		maxError2 = 0.0;
+		for (i = 0; i < sampleCount; i += 1)
+		{
+			index = ForceField_SampleIndex(i, sampleCount, count);
+			errorX = (double) gridX[index] - directX[index];
+			errorY = (double) gridY[index] - directY[index];
+			force2 += (double) directX[index] * directX[index] + (double) directY[index] * directY[index];
+			error2 += errorX * errorX + errorY * errorY;
+			maxError2 = SDL_max(maxError2, errorX * errorX + errorY * errorY);
+		}
+		force2 = SDL_max(force2 / sampleCount, 1e-30);
+
+		SDL_Log(
+			"  %5u attractors  direct %9.3f ms/step  grid bake %9.3f ms + %7.3f ms/step  rms error %6.2f%%  max error %7.2f%%",
+			attractorCount,
+			directMilliseconds,
+			gridTimings.bakeSeconds * 1000.0,
+			gridMilliseconds,
+			100.0 * SDL_sqrt(error2 / sampleCount / force2),
+			100.0 * SDL_sqrt(maxError2 / force2)
+		);
+
+		ForceField_Destroy(direct);
+		ForceField_Destroy(grid);
+	}
+
+	SDL_free(xPosition);
+	SDL_free(yPosition);
+	SDL_free(directX);
+	SDL_free(directY);
+	SDL_free(gridX);
+	SDL_free(gridY);
+}
@@ -0,0 +1,159 @@
+#ifndef FORCE_FIELD_H
+#define FORCE_FIELD_H
+
+#include <stdint.h>
+
+#include "particle.h"
+#include "thread_pool.h"
+
+/* Many fixed attractors and repulsors, plus an optional baked vector
+ * field, pulling on every particle on top of the moving destination.
+ *
+ * Each attractor pulls with strength * d / (|d|^2 + softening^2)^(3/2),
+ * d pointing from the particle to it; a negative strength repels. The
+ * strength magnitudes of a generated set add up to the requested total, so
+ * the overall pull does not grow with the attractor count.
+ *
+ * DIRECT sums every attractor at every particle, O(N * A) per step.
+ * GRID sums them once at the centers of a gridSize x gridSize field over
+ * the [-1, 1] square when the field is created, O(G^2 * A), and every step
+ * only interpolates the field at each particle, O(N) whatever the count.
+ * A field texture is resampled onto the same grid and interpolated in
+ * either mode.
+ *
+ * Every path sums the attractors in the same order with the same
+ * operations, so the threaded SIMD CPU path matches the serial reference
+ * bit for bit. force_field.comp runs the same sums and interpolation on
+ * the GPU.
+ */
+
+typedef enum ForceFieldMode
+{
+	FORCE_FIELD_MODE_DIRECT,
+	FORCE_FIELD_MODE_GRID
+} ForceFieldMode;
+
+#define FORCE_FIELD_MAX_ATTRACTORS 4096
+
+/* Powers of two are not required, only a cell either side of the center */
+#define FORCE_FIELD_MIN_SIZE 16
+#define FORCE_FIELD_MAX_SIZE 1024
+
+/* Plummer softening length, in simulation units. It also bounds how sharp
+ * the field gets, and so how fine a grid has to be to follow it.
+ */
+#define FORCE_FIELD_SOFTENING 0.05f
+
+/* Matches struct Attractor in force_field.comp (std430) */
+typedef struct ForceFieldAttractor
+{
+	float x, y;
+	float strength;
+	float padding;
+} ForceFieldAttractor;
+
+/* Matches the UBO block in force_field.comp */
+typedef struct ForceFieldUniforms
+{
+	float deltaTime;
+	float invCellSize;
+	float softening2;
+	uint32_t particleCount;
+	uint32_t gridSize;
+	uint32_t attractorCount; /* summed directly per particle, 0 in GRID mode */
+	uint32_t sampleField;    /* 0 in DIRECT mode without a texture */
+	uint32_t padding;
+} ForceFieldUniforms;
+
+typedef struct ForceFieldTimings
+{
+	uint32_t stepCount;
+	double bakeSeconds;  /* once, at creation */
+	double applySeconds; /* direct sums or field interpolation, and the velocity update */
+} ForceFieldTimings;
+
+typedef struct ForceField ForceField;
+
+/* Generates attractorCount attractors from seed, about a quarter of them
+ * repulsors, with strength magnitudes summing to strength. gridSize must be in
+ * [FORCE_FIELD_MIN_SIZE, FORCE_FIELD_MAX_SIZE]. maxVectorWidth caps the
+ * SIMD path (1, 4 or 8 floats) and the best one the CPU supports below it
+ * is used. pool may be NULL.
+ */
+ForceField* ForceField_Create(
+	ForceFieldMode mode,
+	uint32_t gridSize,
+	uint32_t attractorCount,
+	float strength,
+	uint32_t seed,
+	uint32_t maxVectorWidth,
+	ThreadPool *pool
+);
+void ForceField_Destroy(ForceField *field);
+
+/* Adds an R8G8B8A8 image to the field, red and green mapping [0, 255] to
+ * [-strength, strength] along x and y, with the image's top row at y = -1
+ * as on screen. The image is sampled bilinearly at every cell center.
+ */
+void ForceField_SetTexture(ForceField *field, const uint8_t *rgba, uint32_t width, uint32_t height, float strength);
+
+ForceFieldMode ForceField_GetMode(ForceField *field);
+const char* ForceField_GetModeName(ForceFieldMode mode);
+uint32_t ForceField_GetGridSize(ForceField *field);
+uint32_t ForceField_GetAttractorCount(ForceField *field);
+uint32_t ForceField_GetVectorWidth(ForceField *field);
+
+/* For force_field_gpu.c: the attractors, and the field as gridSize^2
+ * interleaved x, y pairs
+ */
+const ForceFieldAttractor* ForceField_GetAttractors(ForceField *field);
+const float* ForceField_GetField(ForceField *field);
+
+void ForceField_FillUniforms(
+	ForceField *field,
+	ForceFieldUniforms *uniforms,
+	uint32_t particleCount,
+	float deltaTime
+);
+
+/* Adds the force at the current positions to the velocities */
+void ForceField_Apply(
+	ForceField *field,
+	const float *xPosition,
+	const float *yPosition,
+	float *xVelocity,
+	float *yVelocity,
+	uint32_t count,
+	float deltaTime
+);
+
+/* Single-threaded scalar version on the GPU layout, run before
+ * CPUSim_ReferenceStep when validating. The first call bakes the field
+ * again on its own rather than trusting the threaded bake.
+ */
+void ForceField_ReferenceApply(ForceField *field, Particle *particles, uint32_t count, float deltaTime);
+
+void ForceField_GetTimings(ForceField *field, ForceFieldTimings *timings);
+void ForceField_LogTimings(ForceField *field);
+
+/* Particles the sweep compares the grid against direct summation at */
+#define FORCE_FIELD_SWEEP_SAMPLES 4096
+
+/* For every power of four attractors up to maxAttractorCount, times a
+ * direct step and a grid step over all particles and the grid's bake, and
+ * logs them next to the grid's force error against direct summation at
+ * sampleCount of the particles.
+ */
+void ForceField_LogSweep(
+	const Particle *particles,
+	uint32_t count,
+	uint32_t gridSize,
+	uint32_t maxAttractorCount,
+	float strength,
+	uint32_t seed,
+	uint32_t sampleCount,
+	uint32_t maxVectorWidth,
+	ThreadPool *pool
+);
+
+#endif /* FORCE_FIELD_H */
@@ -0,0 +1,100 @@
+#include "force_field_gpu.h"
+
+#include <SDL.h>
+
+#include "compute_pass.h"
+
+struct ForceFieldGPU
+{
+	ForceField *field;
+
+	REFRESH_Buffer *fieldBuffer;
+	REFRESH_Buffer *attractors;
+
+	ComputePass pass;
+};
+
+ForceFieldGPU* ForceFieldGPU_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ForceField *field,
+	ParticleBuffers *particleBuffers
+) {
+	uint32_t gridSize = ForceField_GetGridSize(field);
+	uint32_t attractorCount = SDL_max(ForceField_GetAttractorCount(field), 1);
+	uint32_t bindingCount = 0;
+	const char *shaderPath;
+	REFRESH_Buffer *bindings[4];
+	ForceFieldGPU *fieldGPU = SDL_malloc(sizeof(ForceFieldGPU));
+
+	SDL_zerop(fieldGPU);
+	fieldGPU->field = field;
+
+	fieldGPU->fieldBuffer = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, sizeof(float) * 2 * gridSize * gridSize);
+	fieldGPU->attractors = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, sizeof(ForceFieldAttractor) * attractorCount);
+
+	REFRESH_SetBufferData(
+		device,
+		fieldGPU->fieldBuffer,
+		0,
+		(void*) ForceField_GetField(field),
+		sizeof(float) * 2 * gridSize * gridSize
+	);
+	REFRESH_SetBufferData(
+		device,
+		fieldGPU->attractors,
+		0,
+		(void*) ForceField_GetAttractors(field),
+		sizeof(ForceFieldAttractor) * attractorCount
+	);
+
+	/* The split layout binds positions and velocities separately; the
+	 * interleaved one has both in the Particle struct.
+	 */
+	bindings[bindingCount++] = particleBuffers->buffers[0];
+	if (particleBuffers->layout == PARTICLE_LAYOUT_SPLIT)
+	{
+		bindings[bindingCount++] = particleBuffers->buffers[1];
+		shaderPath = "ff_split_apply.comp.spv";
+	}
+	else
+	{
+		shaderPath = "ff_apply.comp.spv";
+	}
+	bindings[bindingCount++] = fieldGPU->fieldBuffer;
+	bindings[bindingCount++] = fieldGPU->attractors;
+
+	if (!ComputePass_Create(device, shaderCache, &fieldGPU->pass, shaderPath, sizeof(ForceFieldUniforms), bindings, bindingCount))
+	{
+		ForceFieldGPU_Destroy(device, fieldGPU);
+		return NULL;
+	}
+
+	return fieldGPU;
+}
+
+void ForceFieldGPU_Destroy(REFRESH_Device *device, ForceFieldGPU *fieldGPU)
+{
+	if (fieldGPU == NULL)
+	{
+		return;
+	}
+
+	ComputePass_Destroy(device, &fieldGPU->pass);
+
+	REFRESH_AddDisposeBuffer(device, fieldGPU->fieldBuffer);
+	REFRESH_AddDisposeBuffer(device, fieldGPU->attractors);
+	SDL_free(fieldGPU);
+}
+
+void ForceFieldGPU_Record(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	ForceFieldGPU *fieldGPU,
+	const ParticleComputeUniforms *step
+) {
+	ForceFieldUniforms uniforms;
+
+	ForceField_FillUniforms(fieldGPU->field, &uniforms, step->particleCount, step->deltaTime);
+	ComputePass_Record(device, commandBuffer, &fieldGPU->pass, &uniforms, (step->particleCount + 255) / 256);
+}
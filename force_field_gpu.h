@@ -0,0 +1,35 @@
+#ifndef FORCE_FIELD_GPU_H
+#define FORCE_FIELD_GPU_H
+
+#include <Refresh.h>
+
+#include "force_field.h"
+#include "particle_buffers.h"
+#include "shader_module.h"
+
+/* The force_field.comp pass and its buffers.
+ *
+ * The attractors and the field are fixed, so both are uploaded once at
+ * creation, the field as the CPU baked it. Recording one step is a single
+ * dispatch over the particles.
+ */
+
+typedef struct ForceFieldGPU ForceFieldGPU;
+
+/* Returns NULL if the shader could not be loaded */
+ForceFieldGPU* ForceFieldGPU_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ForceField *field,
+	ParticleBuffers *particleBuffers
+);
+void ForceFieldGPU_Destroy(REFRESH_Device *device, ForceFieldGPU *fieldGPU);
+
+void ForceFieldGPU_Record(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	ForceFieldGPU *fieldGPU,
+	const ParticleComputeUniforms *step
+);
+
+#endif /* FORCE_FIELD_GPU_H */
@@ -0,0 +1,348 @@
+#include "frame_capture.h"
+
+#include <SDL.h>
+#include <Refresh_Image.h>
+
+#include "readback_ring.h"
+#include "trace.h"
+
+#define FRAME_CAPTURE_PATH_LENGTH 256
+
+/* Pixel blocks shared between the queue and the worker; bounds memory use */
+#define FRAME_CAPTURE_QUEUE_SIZE 4
+
+typedef struct FrameCaptureSlot
+{
+	REFRESH_Buffer *buffer;
+	char path[FRAME_CAPTURE_PATH_LENGTH];
+} FrameCaptureSlot;
+
+typedef struct FrameCaptureJob
+{
+	FrameCapture *capture;
+	uint8_t *pixels;
+	char path[FRAME_CAPTURE_PATH_LENGTH];
+	bool running; /* encode jobs only */
+} FrameCaptureJob;
+
+struct FrameCapture
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t byteCount;
+
+	/* One per ring slot */
+	ReadbackRing ring;
+	FrameCaptureSlot *slots;
+
+	/* Everything below is guarded by mutex */
+	SDL_mutex *mutex;
+	SDL_cond *jobAvailable;
+	SDL_cond *pixelsAvailable;
+	FrameCaptureJob jobs[FRAME_CAPTURE_QUEUE_SIZE];
+	uint32_t jobHead;
+	uint32_t jobCount;
+	uint8_t *freePixels[FRAME_CAPTURE_QUEUE_SIZE];
+	uint32_t freePixelCount;
+	bool shutdown;
+	FrameCaptureStats stats;
+
+	/* One or the other encodes. Jobs take their FrameCaptureJob from
+	 * encodes, of which there is one per pixel block.
+	 */
+	SDL_Thread *thread;
+	JobSystem *jobSystem;
+	FrameCaptureJob encodes[FRAME_CAPTURE_QUEUE_SIZE];
+};
+
+static void FrameCapture_Encode(FrameCapture *capture, FrameCaptureJob *job)
+{
+	TRACE_BEGIN(encodeScope, "encode png");
+	REFRESH_Image_SavePNG(job->path, capture->width, capture->height, job->pixels);
+	TRACE_END(encodeScope);
+}
+
+/* Called with the mutex held */
+static void FrameCapture_ReturnPixels(FrameCapture *capture, uint8_t *pixels)
+{
+	capture->freePixels[capture->freePixelCount] = pixels;
+	capture->freePixelCount += 1;
+	capture->stats.written += 1;
+	SDL_CondSignal(capture->pixelsAvailable);
+}
+
+static void FrameCapture_EncodeJob(void *data)
+{
+	FrameCaptureJob *job = (FrameCaptureJob*) data;
+	FrameCapture *capture = job->capture;
+
+	FrameCapture_Encode(capture, job);
+
+	SDL_LockMutex(capture->mutex);
+	FrameCapture_ReturnPixels(capture, job->pixels);
+	job->running = false;
+	SDL_UnlockMutex(capture->mutex);
+}
+
+static int FrameCapture_WorkerMain(void *data)
+{
+	FrameCapture *capture = (FrameCapture*) data;
+	FrameCaptureJob job;
+
+	Trace_SetThreadName("frame capture");
+
+	SDL_LockMutex(capture->mutex);
+
+	for (;;)
+	{
+		while (capture->jobCount == 0 && !capture->shutdown)
+		{
+			SDL_CondWait(capture->jobAvailable, capture->mutex);
+		}
+
+		/* Shutdown only takes effect once the queue is drained */
+		if (capture->jobCount == 0)
+		{
+			break;
+		}
+
+		job = capture->jobs[capture->jobHead];
+		capture->jobHead = (capture->jobHead + 1) % FRAME_CAPTURE_QUEUE_SIZE;
+		capture->jobCount -= 1;
+
+		SDL_UnlockMutex(capture->mutex);
+
+		FrameCapture_Encode(capture, &job);
+
+		SDL_LockMutex(capture->mutex);
+		FrameCapture_ReturnPixels(capture, job.pixels);
+	}
+
+	SDL_UnlockMutex(capture->mutex);
+
+	return 0;
+}
+
+FrameCapture* FrameCapture_Create(
+	REFRESH_Device *device,
+	uint32_t width,
+	uint32_t height,
+	uint32_t latency,
+	JobSystem *jobs
+) {
+	uint32_t i;
+	FrameCapture *capture = SDL_malloc(sizeof(FrameCapture));
+
+	SDL_zerop(capture);
+
+	capture->width = width;
+	capture->height = height;
+	capture->byteCount = width * height * 4;
+
+	ReadbackRing_Create(&capture->ring, latency, 0);
+	capture->slots = SDL_malloc(sizeof(FrameCaptureSlot) * capture->ring.slotCount);
+
+	for (i = 0; i < capture->ring.slotCount; i += 1)
+	{
+		capture->slots[i].buffer = REFRESH_CreateBuffer(device, 0, capture->byteCount);
+		capture->slots[i].path[0] = '\0';
+	}
+
+	for (i = 0; i < FRAME_CAPTURE_QUEUE_SIZE; i += 1)
+	{
+		capture->freePixels[i] = SDL_malloc(capture->byteCount);
+	}
+	capture->freePixelCount = FRAME_CAPTURE_QUEUE_SIZE;
+
+	capture->mutex = SDL_CreateMutex();
+	capture->jobAvailable = SDL_CreateCond();
+	capture->pixelsAvailable = SDL_CreateCond();
+
+	if (jobs != NULL)
+	{
+		capture->jobSystem = jobs;
+		for (i = 0; i < FRAME_CAPTURE_QUEUE_SIZE; i += 1)
+		{
+			capture->encodes[i].capture = capture;
+		}
+	}
+	else
+	{
+		capture->thread = SDL_CreateThread(FrameCapture_WorkerMain, "FrameCapture", capture);
+	}
+
+	return capture;
+}
+
+/* Reads a retired slot back and queues it for encoding. When wait is false
+ * a full queue drops the capture instead of blocking.
+ */
+static void FrameCapture_RetireSlot(FrameCapture *capture, REFRESH_Device *device, uint32_t slotIndex, bool wait)
+{
+	FrameCaptureSlot *slot = &capture->slots[slotIndex];
+	FrameCaptureJob *job = NULL;
+	uint8_t *pixels = NULL;
+	uint32_t i;
+
+	TRACE_BEGIN(retireScope, "capture readback");
+
+	SDL_LockMutex(capture->mutex);
+
+	while (wait && capture->freePixelCount == 0)
+	{
+		SDL_CondWait(capture->pixelsAvailable, capture->mutex);
+	}
+
+	if (capture->freePixelCount > 0)
+	{
+		capture->freePixelCount -= 1;
+		pixels = capture->freePixels[capture->freePixelCount];
+	}
+	else
+	{
+		capture->stats.droppedQueueFull += 1;
+	}
+
+	SDL_UnlockMutex(capture->mutex);
+
+	if (pixels != NULL)
+	{
+		REFRESH_GetBufferData(device, slot->buffer, pixels, capture->byteCount);
+
+		SDL_LockMutex(capture->mutex);
+
+		if (capture->jobSystem != NULL)
+		{
+			/* Holding a pixel block means one of these is not running */
+			for (i = 0; job == NULL; i += 1)
+			{
+				if (!capture->encodes[i].running)
+				{
+					job = &capture->encodes[i];
+				}
+			}
+			job->running = true;
+		}
+		else
+		{
+			job = &capture->jobs[(capture->jobHead + capture->jobCount) % FRAME_CAPTURE_QUEUE_SIZE];
+			capture->jobCount += 1;
+			SDL_CondSignal(capture->jobAvailable);
+		}
+		job->pixels = pixels;
+		SDL_strlcpy(job->path, slot->path, sizeof(job->path));
+
+		SDL_UnlockMutex(capture->mutex);
+
+		if (capture->jobSystem != NULL)
+		{
+			JobSystem_Release(
+				capture->jobSystem,
+				JobSystem_Add(capture->jobSystem, "encode png", FrameCapture_EncodeJob, job, NULL, 0)
+			);
+		}
+	}
+
+	TRACE_END(retireScope);
+}
+
+void FrameCapture_Destroy(REFRESH_Device *device, FrameCapture *capture)
+{
+	uint32_t i, slotIndex;
+
+	if (capture == NULL)
+	{
+		return;
+	}
+
+	REFRESH_Wait(device);
+
+	while (ReadbackRing_Retire(&capture->ring, true, &slotIndex))
+	{
+		FrameCapture_RetireSlot(capture, device, slotIndex, true);
+	}
+
+	SDL_LockMutex(capture->mutex);
+	capture->shutdown = true;
+	SDL_CondSignal(capture->jobAvailable);
+	while (capture->jobSystem != NULL && capture->freePixelCount < FRAME_CAPTURE_QUEUE_SIZE)
+	{
+		/* Every encode job hands its pixel block back */
+		SDL_CondWait(capture->pixelsAvailable, capture->mutex);
+	}
+	SDL_UnlockMutex(capture->mutex);
+
+	SDL_WaitThread(capture->thread, NULL);
+
+	if (capture->stats.requested > 0)
+	{
+		SDL_Log(
+			"Frame capture: %u requested, %u written, %u dropped (%u no readback slot, %u encoder behind)",
+			capture->stats.requested,
+			capture->stats.written,
+			capture->stats.droppedNoSlot + capture->stats.droppedQueueFull,
+			capture->stats.droppedNoSlot,
+			capture->stats.droppedQueueFull
+		);
+	}
+
+	for (i = 0; i < capture->ring.slotCount; i += 1)
+	{
+		REFRESH_AddDisposeBuffer(device, capture->slots[i].buffer);
+	}
+
+	for (i = 0; i < capture->freePixelCount; i += 1)
+	{
+		SDL_free(capture->freePixels[i]);
+	}
+
+	SDL_DestroyCond(capture->pixelsAvailable);
+	SDL_DestroyCond(capture->jobAvailable);
+	SDL_DestroyMutex(capture->mutex);
+	ReadbackRing_Destroy(&capture->ring);
+	SDL_free(capture->slots);
+	SDL_free(capture);
+}
+
+bool FrameCapture_Record(
+	FrameCapture *capture,
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	REFRESH_TextureSlice *textureSlice,
+	const char *path
+) {
+	FrameCaptureSlot *slot;
+
+	capture->stats.requested += 1;
+
+	if (!ReadbackRing_CanRecord(&capture->ring))
+	{
+		capture->stats.droppedNoSlot += 1;
+		return false;
+	}
+
+	slot = &capture->slots[ReadbackRing_Record(&capture->ring)];
+	REFRESH_CopyTextureToBuffer(device, commandBuffer, textureSlice, slot->buffer);
+	SDL_strlcpy(slot->path, path, sizeof(slot->path));
+
+	return true;
+}
+
+void FrameCapture_EndFrame(FrameCapture *capture, REFRESH_Device *device)
+{
+	uint32_t slotIndex;
+
+	while (ReadbackRing_Retire(&capture->ring, false, &slotIndex))
+	{
+		FrameCapture_RetireSlot(capture, device, slotIndex, false);
+	}
+
+	ReadbackRing_EndFrame(&capture->ring);
+}
+
+void FrameCapture_GetStats(FrameCapture *capture, FrameCaptureStats *stats)
+{
+	SDL_LockMutex(capture->mutex);
+	*stats = capture->stats;
+	SDL_UnlockMutex(capture->mutex);
+}
@@ -0,0 +1,68 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <Refresh.h>
+
+#include "job_system.h"
+
+/* Non-stalling color target readback.
+ *
+ * Each capture copies the color target into a buffer of a readback ring
+ * (readback_ring.h), read back once `latency` more frames have been
+ * submitted. PNG encoding plus the disk write happen on a worker thread, or
+ * as a job, so the render thread never waits on the GPU or the filesystem.
+ * The default latency of 2 leaves a frame of slack on top of the one
+ * Refresh needs.
+ *
+ * If every ring slot or every encode slot is busy the capture is dropped
+ * and counted rather than stalling the frame.
+ */
+
+typedef struct FrameCapture FrameCapture;
+
+typedef struct FrameCaptureStats
+{
+	uint32_t requested;
+	uint32_t written;
+	uint32_t droppedNoSlot;    /* every readback buffer still in flight */
+	uint32_t droppedQueueFull; /* encoder fell behind */
+} FrameCaptureStats;
+
+/* With jobs, each capture is encoded by a job of its own; NULL starts a
+ * worker thread for them.
+ */
+FrameCapture* FrameCapture_Create(
+	REFRESH_Device *device,
+	uint32_t width,
+	uint32_t height,
+	uint32_t latency,
+	JobSystem *jobs
+);
+
+/* Waits for the device, writes every outstanding capture, waits for the
+ * encoder and logs the capture stats.
+ */
+void FrameCapture_Destroy(REFRESH_Device *device, FrameCapture *capture);
+
+/* Records a copy of textureSlice into commandBuffer, to be written to path.
+ * Returns false if the capture had to be dropped.
+ */
+bool FrameCapture_Record(
+	FrameCapture *capture,
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	REFRESH_TextureSlice *textureSlice,
+	const char *path
+);
+
+/* Call once per frame after REFRESH_Submit. Hands every capture that is
+ * at least `latency` frames old to the encoder.
+ */
+void FrameCapture_EndFrame(FrameCapture *capture, REFRESH_Device *device);
+
+void FrameCapture_GetStats(FrameCapture *capture, FrameCaptureStats *stats);
+
+#endif /* FRAME_CAPTURE_H */
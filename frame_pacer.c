@@ -0,0 +1,365 @@
+#include "frame_pacer.h"
+
+#include <SDL.h>
+
+#include "bench.h"
+#include "trace.h"
+
+typedef struct FramePacerHistogram
+{
+	uint32_t bins[FRAME_PACER_HISTOGRAM_BINS];
+	uint32_t count;
+	double min;
+	double max;
+} FramePacerHistogram;
+
+struct FramePacer
+{
+	FramePaceMode mode;
+	double rate;
+	uint64_t period; /* ticks */
+	bool simulatedClock;
+	uint64_t skippedTicks; /* simulated clock: waited without sleeping */
+
+	/* On the waiting thread */
+	uint64_t nextStart;    /* fixed */
+	uint64_t nextDeadline; /* low latency */
+	uint32_t skippedCount; /* frame slots given up after falling behind */
+	uint32_t wakeCount;
+	double lateSeconds;
+	double maxLateSeconds;
+
+	/* Everything below is guarded by lock */
+	SDL_SpinLock lock;
+	uint64_t lastSubmit;
+	uint32_t missedCount;
+	FramePacerHistogram frameTimes;
+	FramePacerHistogram latencies;
+	double recentLatencies[FRAME_PACER_PREDICT_FRAMES];
+	uint32_t recentCount;
+};
+
+static void FramePacerHistogram_Add(FramePacerHistogram *histogram, double seconds)
+{
+	uint32_t bin = (uint32_t) (seconds / FRAME_PACER_BIN_SECONDS);
+
+	histogram->bins[SDL_min(bin, FRAME_PACER_HISTOGRAM_BINS - 1)] += 1;
+	histogram->min = (histogram->count > 0) ? SDL_min(histogram->min, seconds) : seconds;
+	histogram->max = SDL_max(histogram->max, seconds);
+	histogram->count += 1;
+}
+
+/* Nearest rank, as Bench_Percentile, placed linearly within its bin and
+ * kept between the smallest and largest sample
+ */
+static double FramePacerHistogram_Percentile(const FramePacerHistogram *histogram, double percentile)
+{
+	uint32_t i;
+	uint32_t seen = 0;
+	uint32_t rank = (uint32_t) SDL_ceil(percentile * histogram->count);
+	double estimate;
+
+	if (histogram->count == 0)
+	{
+		return 0.0;
+	}
+
+	rank = SDL_max(rank, 1);
+
+	for (i = 0; i < FRAME_PACER_HISTOGRAM_BINS - 1; i += 1)
+	{
+		if (seen + histogram->bins[i] >= rank)
+		{
+			estimate = (i + (double) (rank - seen) / histogram->bins[i]) * FRAME_PACER_BIN_SECONDS;
+			return SDL_max(SDL_min(estimate, histogram->max), histogram->min);
+		}
+		seen += histogram->bins[i];
+	}
+
+	return histogram->max;
+}
+
+FramePacer* FramePacer_Create(FramePaceMode mode, double rate, bool simulatedClock)
+{
+	FramePacer *pacer = SDL_malloc(sizeof(FramePacer));
+
+	SDL_zerop(pacer);
+
+	pacer->mode = mode;
+	pacer->rate = rate;
+	pacer->period = (rate > 0.0) ? (uint64_t) (SDL_GetPerformanceFrequency() / rate) : 0;
+	pacer->period = SDL_max(pacer->period, 1); /* deadlines must move on */
+	pacer->simulatedClock = simulatedClock;
+
+	return pacer;
+}
+
+void FramePacer_Destroy(FramePacer *pacer)
+{
+	SDL_free(pacer);
+}
+
+const char* FramePacer_GetModeName(FramePaceMode mode)
+{
+	switch (mode)
+	{
+	case FRAME_PACE_FIXED:
+		return "fixed";
+	case FRAME_PACE_LOW_LATENCY:
+		return "latency";
+	default:
+		return "throughput";
+	}
+}
+
+uint64_t FramePacer_Now(FramePacer *pacer)
+{
+	return Bench_Now() + pacer->skippedTicks;
+}
+
+static void FramePacer_SleepUntil(FramePacer *pacer, uint64_t deadline)
+{
+	uint64_t now = FramePacer_Now(pacer);
+	double remaining, late;
+
+	if (now >= deadline)
+	{
+		return;
+	}
+
+	if (pacer->simulatedClock)
+	{
+		pacer->skippedTicks += deadline - now;
+		return;
+	}
+
+	TRACE_BEGIN(sleepScope, "pace wait");
+	do
+	{
+		remaining = Bench_Seconds(now, deadline);
+		if (remaining > FRAME_PACER_SPIN_SECONDS)
+		{
+			SDL_Delay((Uint32) ((remaining - FRAME_PACER_SPIN_SECONDS) * 1000.0));
+		}
+		else
+		{
+			SDL_Delay(0);
+		}
+		now = FramePacer_Now(pacer);
+	} while (now < deadline);
+	TRACE_END(sleepScope);
+
+	late = Bench_Seconds(deadline, now);
+	pacer->wakeCount += 1;
+	pacer->lateSeconds += late;
+	pacer->maxLateSeconds = SDL_max(pacer->maxLateSeconds, late);
+}
+
+/* How long before its deadline a low-latency frame samples input. Until a
+ * frame has been submitted, a whole period.
+ */
+static uint64_t FramePacer_PredictLead(FramePacer *pacer)
+{
+	uint32_t i, count;
+	double longest = 0.0;
+
+	SDL_AtomicLock(&pacer->lock);
+	count = SDL_min(pacer->recentCount, FRAME_PACER_PREDICT_FRAMES);
+	for (i = 0; i < count; i += 1)
+	{
+		longest = SDL_max(longest, pacer->recentLatencies[i]);
+	}
+	SDL_AtomicUnlock(&pacer->lock);
+
+	if (count == 0)
+	{
+		return pacer->period;
+	}
+
+	return (uint64_t) ((longest + FRAME_PACER_PREDICT_MARGIN) * SDL_GetPerformanceFrequency());
+}
+
+void FramePacer_Wait(FramePacer *pacer, uint64_t stepDue, FramePacerFrame *frame)
+{
+	uint64_t now = FramePacer_Now(pacer);
+	uint64_t lead, skipped;
+
+	frame->deadline = 0;
+
+	switch (pacer->mode)
+	{
+	case FRAME_PACE_THROUGHPUT:
+		FramePacer_SleepUntil(pacer, stepDue);
+		break;
+
+	case FRAME_PACE_FIXED:
+		/* More than a frame behind, start the schedule over rather than
+		 * rush through the frames missed
+		 */
+		if (pacer->nextStart == 0)
+		{
+			pacer->nextStart = now;
+		}
+		else if (now > pacer->nextStart + pacer->period)
+		{
+			pacer->skippedCount += (uint32_t) ((now - pacer->nextStart) / pacer->period);
+			pacer->nextStart = now;
+		}
+		FramePacer_SleepUntil(pacer, pacer->nextStart);
+		pacer->nextStart += pacer->period;
+		frame->deadline = pacer->nextStart;
+		break;
+
+	case FRAME_PACE_LOW_LATENCY:
+		lead = FramePacer_PredictLead(pacer);
+		if (pacer->nextDeadline == 0)
+		{
+			pacer->nextDeadline = now + lead;
+		}
+		if (pacer->nextDeadline < now + lead)
+		{
+			/* Too late to make those, on to the first that can be */
+			skipped = (now + lead - pacer->nextDeadline + pacer->period - 1) / pacer->period;
+			pacer->nextDeadline += skipped * pacer->period;
+			pacer->skippedCount += (uint32_t) skipped;
+		}
+		FramePacer_SleepUntil(pacer, pacer->nextDeadline - lead);
+		frame->deadline = pacer->nextDeadline;
+		pacer->nextDeadline += pacer->period;
+		break;
+	}
+
+	frame->inputTicks = FramePacer_Now(pacer);
+}
+
+void FramePacer_Submit(FramePacer *pacer, const FramePacerFrame *frame)
+{
+	uint64_t now = FramePacer_Now(pacer);
+	double latency = Bench_Seconds(frame->inputTicks, now);
+
+	if (!pacer->simulatedClock)
+	{
+		Trace_Add("input to submit", frame->inputTicks, now, 0);
+	}
+
+	SDL_AtomicLock(&pacer->lock);
+
+	if (pacer->lastSubmit != 0)
+	{
+		FramePacerHistogram_Add(&pacer->frameTimes, Bench_Seconds(pacer->lastSubmit, now));
+	}
+	pacer->lastSubmit = now;
+
+	FramePacerHistogram_Add(&pacer->latencies, latency);
+	pacer->recentLatencies[pacer->recentCount % FRAME_PACER_PREDICT_FRAMES] = latency;
+	pacer->recentCount += 1;
+
+	if (frame->deadline != 0 && now > frame->deadline)
+	{
+		pacer->missedCount += 1;
+	}
+
+	SDL_AtomicUnlock(&pacer->lock);
+}
+
+void FramePacer_GetStats(FramePacer *pacer, FramePacerStats *stats)
+{
+	SDL_AtomicLock(&pacer->lock);
+
+	stats->frameCount = pacer->latencies.count;
+	stats->missedCount = pacer->missedCount;
+	stats->frameMedian = FramePacerHistogram_Percentile(&pacer->frameTimes, 0.5);
+	stats->frameP99 = FramePacerHistogram_Percentile(&pacer->frameTimes, 0.99);
+	stats->frameMax = pacer->frameTimes.max;
+	stats->latencyMedian = FramePacerHistogram_Percentile(&pacer->latencies, 0.5);
+	stats->latencyP99 = FramePacerHistogram_Percentile(&pacer->latencies, 0.99);
+	stats->latencyMax = pacer->latencies.max;
+
+	SDL_AtomicUnlock(&pacer->lock);
+}
+
+void FramePacer_LogStats(FramePacer *pacer)
+{
+	uint32_t i;
+	FramePacerStats stats;
+
+	FramePacer_GetStats(pacer, &stats);
+
+	if (stats.frameCount == 0)
+	{
+		return;
+	}
+
+	if (pacer->mode == FRAME_PACE_THROUGHPUT)
+	{
+		SDL_Log(
+			"Frame pacing: throughput%s, %u frames",
+			pacer->simulatedClock ? " on the simulated clock" : "",
+			stats.frameCount
+		);
+	}
+	else
+	{
+		SDL_Log(
+			"Frame pacing: %s at %.2f Hz%s, %u frames, %u missed their deadline, %u slots skipped after falling behind",
+			FramePacer_GetModeName(pacer->mode),
+			pacer->rate,
+			pacer->simulatedClock ? " on the simulated clock" : "",
+			stats.frameCount,
+			stats.missedCount,
+			pacer->skippedCount
+		);
+	}
+
+	SDL_Log(
+		"  frame time       median %7.2f ms  p99 %7.2f ms  max %7.2f ms",
+		stats.frameMedian * 1000.0,
+		stats.frameP99 * 1000.0,
+		stats.frameMax * 1000.0
+	);
+	SDL_Log(
+		"  input to submit  median %7.2f ms  p99 %7.2f ms  max %7.2f ms",
+		stats.latencyMedian * 1000.0,
+		stats.latencyP99 * 1000.0,
+		stats.latencyMax * 1000.0
+	);
+
+	if (pacer->wakeCount > 0)
+	{
+		SDL_Log(
+			"  waits woke %.3f ms late on average, %.3f ms at most",
+			pacer->lateSeconds * 1000.0 / pacer->wakeCount,
+			pacer->maxLateSeconds * 1000.0
+		);
+	}
+
+	/* Only the bins either histogram has samples in */
+	SDL_Log("  histogram        frames  inputs");
+	for (i = 0; i < FRAME_PACER_HISTOGRAM_BINS; i += 1)
+	{
+		if (pacer->frameTimes.bins[i] == 0 && pacer->latencies.bins[i] == 0)
+		{
+			continue;
+		}
+
+		if (i + 1 < FRAME_PACER_HISTOGRAM_BINS)
+		{
+			SDL_Log(
+				"  %6.2f-%6.2f ms %6u  %6u",
+				i * FRAME_PACER_BIN_SECONDS * 1000.0,
+				(i + 1) * FRAME_PACER_BIN_SECONDS * 1000.0,
+				pacer->frameTimes.bins[i],
+				pacer->latencies.bins[i]
+			);
+		}
+		else
+		{
+			SDL_Log(
+				"  %6.2f ms and up %6u  %6u",
+				i * FRAME_PACER_BIN_SECONDS * 1000.0,
+				pacer->frameTimes.bins[i],
+				pacer->latencies.bins[i]
+			);
+		}
+	}
+}
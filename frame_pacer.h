@@ -0,0 +1,99 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Decides when a frame starts, and measures how frames come out.
+ *
+ * The loop calls FramePacer_Wait before it samples input, and
+ * FramePacer_Submit once the frame is submitted. Waits sleep until a
+ * deadline, handing the last FRAME_PACER_SPIN_SECONDS to a yielding spin
+ * since SDL_Delay only has millisecond resolution.
+ *
+ * Throughput starts a frame as soon as the simulation has a step due. Fixed
+ * starts one every 1 / rate seconds. Low latency also runs at the rate, but
+ * starts each frame as late as it can: it predicts the input-to-submit time
+ * from the frames before and samples input that long before the submit
+ * deadline. Refresh reports no vblank times, so the deadlines follow the
+ * clock rather than the display.
+ *
+ * Headless runs use a simulated clock, on which a wait passes no real time
+ * but moves the clock to its deadline. Work between waits still counts, so
+ * a run's schedule is the one real sleeps would have given, at full speed.
+ */
+
+#define FRAME_PACER_SPIN_SECONDS 0.002
+
+/* Highest frame rate fixed and low-latency pacing accept */
+#define FRAME_PACER_MAX_RATE 1000.0
+
+/* Histogram bins, the last also holding everything longer */
+#define FRAME_PACER_HISTOGRAM_BINS 200
+#define FRAME_PACER_BIN_SECONDS 0.00025
+
+/* Input-to-submit times the low-latency prediction takes the longest of */
+#define FRAME_PACER_PREDICT_FRAMES 16
+#define FRAME_PACER_PREDICT_MARGIN 0.0005
+
+typedef enum FramePaceMode
+{
+	FRAME_PACE_THROUGHPUT,
+	FRAME_PACE_FIXED,
+	FRAME_PACE_LOW_LATENCY
+} FramePaceMode;
+
+/* One frame's input sample and the time it should be submitted by */
+typedef struct FramePacerFrame
+{
+	uint64_t inputTicks;
+	uint64_t deadline; /* 0 for no deadline */
+} FramePacerFrame;
+
+typedef struct FramePacerStats
+{
+	uint32_t frameCount;
+	uint32_t missedCount; /* submitted after their deadline */
+	double frameMedian;   /* submit to submit */
+	double frameP99;
+	double frameMax;
+	double latencyMedian; /* input sample to submit */
+	double latencyP99;
+	double latencyMax;
+} FramePacerStats;
+
+typedef struct FramePacer FramePacer;
+
+/* rate is in frames per second, up to FRAME_PACER_MAX_RATE, and unused by
+ * throughput
+ */
+FramePacer* FramePacer_Create(FramePaceMode mode, double rate, bool simulatedClock);
+void FramePacer_Destroy(FramePacer *pacer);
+
+const char* FramePacer_GetModeName(FramePaceMode mode);
+
+/* The pacer's clock, in performance counter ticks. The simulated clock may
+ * only be read on the thread that waits.
+ */
+uint64_t FramePacer_Now(FramePacer *pacer);
+
+/* Sleeps until the next frame should sample its input, and marks the
+ * sample. stepDue is when the simulation next has a fixed step to run, 0
+ * for now; only throughput waits for it.
+ */
+void FramePacer_Wait(FramePacer *pacer, uint64_t stepDue, FramePacerFrame *frame);
+
+/* Call right after the frame has been submitted, with frames in the order
+ * they were waited for. On the real clock any thread may call it.
+ */
+void FramePacer_Submit(FramePacer *pacer, const FramePacerFrame *frame);
+
+/* Percentiles are read from the histograms, to within a bin */
+void FramePacer_GetStats(FramePacer *pacer, FramePacerStats *stats);
+
+/* Frame and input-to-submit times with their histograms, missed deadlines,
+ * and how late the waits woke up. Call once nothing submits any more.
+ */
+void FramePacer_LogStats(FramePacer *pacer);
+
+#endif /* FRAME_PACER_H */
@@ -0,0 +1,182 @@
+#include "frame_ring.h"
+
+#include <SDL.h>
+
+#include "bench.h"
+#include "trace.h"
+
+struct FrameRing
+{
+	FrameSlot slots[FRAME_RING_MAX_FRAMES];
+	uint32_t framesInFlight;
+
+	uint64_t submittedCount; /* also the number of the frame being recorded */
+	uint64_t retiredCount;   /* frames known to have finished on the GPU */
+
+	double currentWait; /* blocked time so far for the frame being recorded */
+
+	/* When Submit returned for each frame still on the GPU, and the frames
+	 * already on the trace's GPU track
+	 */
+	uint64_t submitTicks[FRAME_RING_MAX_FRAMES];
+	uint64_t tracedCount;
+};
+
+/* Frames up to retiredCount were seen to retire at now */
+static void FrameRing_TraceRetired(FrameRing *ring, uint64_t now)
+{
+	for (; ring->tracedCount < ring->retiredCount; ring->tracedCount += 1)
+	{
+		Trace_AddGPU(
+			"frame",
+			ring->submitTicks[ring->tracedCount % ring->framesInFlight],
+			now,
+			(int64_t) ring->tracedCount
+		);
+	}
+}
+
+static void FrameRing_ChargeWait(FrameRing *ring, uint64_t frameNumber, double seconds)
+{
+	FrameSlot *slot = &ring->slots[frameNumber % ring->framesInFlight];
+
+	slot->waitCount += 1;
+	slot->waitSeconds += seconds;
+	slot->maxWaitSeconds = SDL_max(slot->maxWaitSeconds, seconds);
+}
+
+FrameRing* FrameRing_Create(uint32_t framesInFlight, uint32_t substepCapacity)
+{
+	uint32_t i;
+	FrameRing *ring = SDL_malloc(sizeof(FrameRing));
+
+	SDL_zerop(ring);
+
+	ring->framesInFlight = SDL_max(SDL_min(framesInFlight, FRAME_RING_MAX_FRAMES), 1);
+
+	for (i = 0; i < ring->framesInFlight; i += 1)
+	{
+		ring->slots[i].index = i;
+		ring->slots[i].substepUniforms = SDL_malloc(sizeof(ParticleComputeUniforms) * substepCapacity);
+	}
+
+	return ring;
+}
+
+void FrameRing_Destroy(FrameRing *ring)
+{
+	uint32_t i;
+
+	if (ring == NULL)
+	{
+		return;
+	}
+
+	for (i = 0; i < ring->framesInFlight; i += 1)
+	{
+		SDL_free(ring->slots[i].substepUniforms);
+	}
+
+	SDL_free(ring);
+}
+
+uint32_t FrameRing_GetFramesInFlight(FrameRing *ring)
+{
+	return ring->framesInFlight;
+}
+
+FrameSlot* FrameRing_BeginFrame(FrameRing *ring, REFRESH_Device *device)
+{
+	uint64_t start, end;
+	double wait;
+	uint64_t frameNumber = ring->submittedCount;
+	FrameSlot *slot = &ring->slots[frameNumber % ring->framesInFlight];
+
+	/* The slot's previous frame is frameNumber - framesInFlight */
+	if (frameNumber >= ring->framesInFlight && frameNumber - ring->framesInFlight >= ring->retiredCount)
+	{
+		TRACE_BEGIN(waitScope, "wait for frame");
+		start = Bench_Now();
+		REFRESH_Wait(device);
+		end = Bench_Now();
+		wait = Bench_Seconds(start, end);
+		TRACE_END(waitScope);
+
+		FrameRing_ChargeWait(ring, frameNumber - ring->framesInFlight, wait);
+		ring->currentWait += wait;
+		ring->retiredCount = ring->submittedCount;
+		FrameRing_TraceRetired(ring, end);
+	}
+
+	slot->frameNumber = frameNumber;
+	return slot;
+}
+
+double FrameRing_Submit(FrameRing *ring, REFRESH_Device *device, REFRESH_CommandBuffer *commandBuffer)
+{
+	double wait;
+	uint64_t end;
+	uint64_t start = Bench_Now();
+
+	TRACE_BEGIN(submitScope, "submit");
+	REFRESH_Submit(device, 1, &commandBuffer);
+	end = Bench_Now();
+	wait = Bench_Seconds(start, end);
+	TRACE_END(submitScope);
+
+	/* Submit returned, so the previous frame has retired */
+	if (ring->submittedCount > 0)
+	{
+		FrameRing_ChargeWait(ring, ring->submittedCount - 1, wait);
+	}
+
+	ring->retiredCount = SDL_max(ring->retiredCount, ring->submittedCount);
+	FrameRing_TraceRetired(ring, end);
+	ring->submitTicks[ring->submittedCount % ring->framesInFlight] = end;
+	ring->submittedCount += 1;
+
+	wait += ring->currentWait;
+	ring->currentWait = 0.0;
+	return wait;
+}
+
+void FrameRing_Drain(FrameRing *ring, REFRESH_Device *device)
+{
+	uint64_t start, end;
+
+	if (ring->retiredCount == ring->submittedCount)
+	{
+		return;
+	}
+
+	TRACE_BEGIN(drainScope, "drain");
+	start = Bench_Now();
+	REFRESH_Wait(device);
+	end = Bench_Now();
+	TRACE_END(drainScope);
+
+	FrameRing_ChargeWait(ring, ring->submittedCount - 1, Bench_Seconds(start, end));
+	ring->retiredCount = ring->submittedCount;
+	FrameRing_TraceRetired(ring, end);
+}
+
+void FrameRing_LogStats(FrameRing *ring)
+{
+	uint32_t i;
+	FrameSlot *slot;
+
+	SDL_Log("Frames in flight: %u, %llu frames submitted", ring->framesInFlight, (unsigned long long) ring->submittedCount);
+
+	for (i = 0; i < ring->framesInFlight; i += 1)
+	{
+		slot = &ring->slots[i];
+		SDL_Log(
+			"  slot %u: %u waits, total %.3f ms, mean %.3f ms, max %.3f ms",
+			i,
+			slot->waitCount,
+			slot->waitSeconds * 1000.0,
+			(slot->waitCount > 0) ? (slot->waitSeconds * 1000.0 / slot->waitCount) : 0.0,
+			slot->maxWaitSeconds * 1000.0
+		);
+	}
+}
@@ -0,0 +1,74 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <Refresh.h>
+
+#include "particle.h"
+
+/* Frames-in-flight bookkeeping.
+ *
+ * Each frame records into one of framesInFlight slots, and anything the
+ * frame owns (its substep uniforms, and in main.c its CPU-written vertex
+ * buffers) lives in that slot, so recording frame N + 1 never touches data
+ * that frame N may still be executing with.
+ *
+ * Refresh exposes no per-submission fence. Its Submit waits for the
+ * previous submission to retire before queueing a new one, so once frame N
+ * has been submitted every frame before it is known to be complete. At
+ * most one frame executes while the next is recorded, which makes two
+ * slots the most Refresh can overlap: a third would never be waited on and
+ * would only add a frame of latency. With two slots a slot is always free
+ * by the time it is reused, and the only CPU blocking left is inside
+ * Submit.
+ *
+ * With one slot BeginFrame falls back to REFRESH_Wait, which waits for the
+ * whole device since there is nothing finer to wait on. The only frame it
+ * can find in flight is the previous one, so that is all it waits for.
+ * Both waits are timed and charged to the slot whose frame was being
+ * waited on.
+ */
+
+#define FRAME_RING_MAX_FRAMES 2
+
+typedef struct FrameSlot
+{
+	uint32_t index;
+	uint64_t frameNumber; /* last frame recorded with this slot */
+
+	ParticleComputeUniforms *substepUniforms;
+	uint32_t substepCount;
+
+	/* CPU time spent blocked on this slot's frames */
+	uint32_t waitCount;
+	double waitSeconds;
+	double maxWaitSeconds;
+} FrameSlot;
+
+typedef struct FrameRing FrameRing;
+
+/* framesInFlight is clamped to [1, FRAME_RING_MAX_FRAMES] */
+FrameRing* FrameRing_Create(uint32_t framesInFlight, uint32_t substepCapacity);
+void FrameRing_Destroy(FrameRing *ring);
+
+uint32_t FrameRing_GetFramesInFlight(FrameRing *ring);
+
+/* Returns the slot for the next frame once the frame that last used it has
+ * retired, waiting on the whole device with REFRESH_Wait if it has not.
+ * Calling it again before FrameRing_Submit returns the same slot.
+ */
+FrameSlot* FrameRing_BeginFrame(FrameRing *ring, REFRESH_Device *device);
+
+/* Submits the current frame and moves on to the next slot. Returns the
+ * seconds the CPU was blocked for this frame, in BeginFrame and in Submit.
+ */
+double FrameRing_Submit(FrameRing *ring, REFRESH_Device *device, REFRESH_CommandBuffer *commandBuffer);
+
+/* Waits for every submitted frame, for when the CPU needs GPU results now */
+void FrameRing_Drain(FrameRing *ring, REFRESH_Device *device);
+
+void FrameRing_LogStats(FrameRing *ring);
+
+#endif /* FRAME_RING_H */
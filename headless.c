@@ -0,0 +1,465 @@
+#include "headless.h"
+
+#include <SDL.h>
+#include <Refresh_Image.h>
+
+#include "cpu_sim.h"
+#include "neighbor_grid.h"
+#include "particle_mesh.h"
+#include "particle_quantize.h"
+#include "particle_reorder.h"
+#include "texture_loader.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+/* Outlive the texture loader */
+static const char *splatTextureNames[] = { SPLAT_SPRITE_TEXTURE, SPLAT_RAMP_TEXTURE };
+
+static void Headless_LogSplatCompare(const char *label, bool matched, const SplatCompareReport *report)
+{
+	SDL_Log(
+		"Splat %s: %s, %u of %u pixels differ by more than the tolerance, max difference %u, PSNR %.2f dB",
+		label,
+		matched ? "match" : "MISMATCH",
+		report->differentCount,
+		report->pixelCount,
+		report->maxDifference,
+		report->psnr
+	);
+}
+
+ForceField* Headless_CreateForceField(const Options *options, uint32_t maxVectorWidth, ThreadPool *pool)
+{
+	TextureLoader *textureLoader;
+	const char *textureNames[1];
+	const uint8_t *pixels;
+	uint32_t width, height;
+	ForceField *field = ForceField_Create(
+		options->fieldMode,
+		options->fieldSize,
+		options->fieldAttractorCount,
+		options->fieldStrength,
+		options->seed,
+		maxVectorWidth,
+		pool
+	);
+
+	if (options->fieldTexturePath != NULL)
+	{
+		textureNames[0] = options->fieldTexturePath;
+		textureLoader = TextureLoader_Start(NULL, textureNames, 1, NULL);
+		pixels = TextureLoader_GetPixels(textureLoader, 0, &width, &height);
+		if (pixels == NULL)
+		{
+			SDL_Log("Could not load field texture %s", options->fieldTexturePath);
+			TextureLoader_Destroy(textureLoader);
+			ForceField_Destroy(field);
+			return NULL;
+		}
+
+		ForceField_SetTexture(field, pixels, width, height, options->fieldTextureStrength);
+		TextureLoader_Destroy(textureLoader);
+	}
+
+	SDL_Log(
+		"Force field: %s, %u attractors, %ux%u grid%s%s",
+		ForceField_GetModeName(options->fieldMode),
+		options->fieldAttractorCount,
+		options->fieldSize,
+		options->fieldSize,
+		(options->fieldTexturePath != NULL) ? ", texture " : "",
+		(options->fieldTexturePath != NULL) ? options->fieldTexturePath : ""
+	);
+
+	return field;
+}
+
+int Headless_RunCPU(const Options *options)
+{
+	uint32_t frame, step;
+	uint32_t particleCount = options->particleCount;
+	double t = 0.0;
+	double dt = 0.01;
+	uint64_t start;
+	BenchInfo info;
+	bool validationFailed = false;
+
+	ParticleComputeUniforms *substepUniforms = SDL_malloc(sizeof(ParticleComputeUniforms) * options->substeps);
+
+	BenchReport *report = BenchReport_Create();
+
+	start = Bench_Now();
+	ThreadPool *threadPool = ThreadPool_Create(options->threadCount);
+	CPUSim *cpuSim = CPUSim_Create(particleCount, options->cpuKernel, threadPool);
+	NeighborGrid *neighborGrid = NULL;
+	if (options->neighbors)
+	{
+		neighborGrid = NeighborGrid_Create(particleCount, options->neighborRadius, options->neighborStrength, threadPool);
+		CPUSim_SetNeighborGrid(cpuSim, neighborGrid);
+	}
+	ParticleMesh *particleMesh = NULL;
+	if (options->mesh)
+	{
+		particleMesh = ParticleMesh_Create(
+			particleCount,
+			options->meshSize,
+			options->meshGravity,
+			CPUSim_GetKernelWidth(CPUSim_GetKernel(cpuSim)),
+			threadPool
+		);
+		CPUSim_SetParticleMesh(cpuSim, particleMesh);
+	}
+	ForceField *forceField = NULL;
+	if (options->field)
+	{
+		forceField = Headless_CreateForceField(options, CPUSim_GetKernelWidth(CPUSim_GetKernel(cpuSim)), threadPool);
+		if (forceField == NULL)
+		{
+			CPUSim_Destroy(cpuSim);
+			NeighborGrid_Destroy(neighborGrid);
+			ParticleMesh_Destroy(particleMesh);
+			ThreadPool_Destroy(threadPool);
+			BenchReport_Destroy(report);
+			SDL_free(substepUniforms);
+			return -1;
+		}
+		CPUSim_SetForceField(cpuSim, forceField);
+	}
+	ParticleReorder *reorder = NULL;
+	uint32_t stepsSinceReorder = options->reorderInterval; /* the first frame sorts */
+	bool reordered;
+	if (options->reorderInterval > 0)
+	{
+		reorder = ParticleReorder_Create(particleCount, threadPool);
+	}
+	start = BenchReport_AddSince(report, BENCH_PHASE_INIT, start);
+
+	Particle *particles = SDL_malloc(sizeof(Particle) * particleCount);
+	Particle_InitializeArray(particles, particleCount, options->seed, threadPool);
+	CPUSim_SetParticles(cpuSim, particles);
+	BenchReport_AddSince(report, BENCH_PHASE_BUFFER_UPLOAD, start);
+
+	if (options->meshSweep)
+	{
+		ParticleMesh_LogSweep(
+			particles,
+			particleCount,
+			options->meshGravity,
+			options->meshSize,
+			PARTICLE_MESH_SWEEP_SAMPLES,
+			CPUSim_GetKernelWidth(CPUSim_GetKernel(cpuSim)),
+			threadPool
+		);
+	}
+
+	if (options->fieldSweep)
+	{
+		ForceField_LogSweep(
+			particles,
+			particleCount,
+			options->fieldSize,
+			options->fieldAttractorCount,
+			options->fieldStrength,
+			options->seed,
+			FORCE_FIELD_SWEEP_SAMPLES,
+			CPUSim_GetKernelWidth(CPUSim_GetKernel(cpuSim)),
+			threadPool
+		);
+	}
+
+	if (options->quantizeDriftSteps > 0)
+	{
+		ParticleQuantize_LogDrift(particles, particleCount, options->quantizeDriftSteps, PARTICLE_QUANTIZE_DRIFT_SAMPLES, threadPool);
+	}
+
+	Particle *referenceParticles = NULL;
+	if (options->validate)
+	{
+		referenceParticles = SDL_malloc(sizeof(Particle) * particleCount);
+		SDL_memcpy(referenceParticles, particles, sizeof(Particle) * particleCount);
+	}
+
+	/* Splatting renders every frame from the render streams, as the
+	 * windowed split layout uploads them
+	 */
+	TextureLoader *textureLoader = NULL;
+	SplatTexture sprite, ramp;
+	Splatter *splatter = NULL;
+	float *positions = NULL;
+	float *gradientPositions = NULL;
+	uint8_t *image = NULL;
+	uint8_t *referenceImage = NULL;
+	uint32_t pixelCount = SPLAT_IMAGE_WIDTH * SPLAT_IMAGE_HEIGHT;
+
+	if (options->renderMode == RENDER_MODE_SPLAT)
+	{
+		start = Bench_Now();
+		textureLoader = TextureLoader_Start(options->textureBundlePath, splatTextureNames, SDL_arraysize(splatTextureNames), NULL);
+		sprite.pixels = TextureLoader_GetPixels(textureLoader, 0, &sprite.width, &sprite.height);
+		ramp.pixels = TextureLoader_GetPixels(textureLoader, 1, &ramp.width, &ramp.height);
+		BenchReport_AddSince(report, BENCH_PHASE_TEXTURE_UPLOAD, start);
+
+		if (sprite.pixels != NULL && ramp.pixels != NULL)
+		{
+			splatter = Splatter_Create(SPLAT_IMAGE_WIDTH, SPLAT_IMAGE_HEIGHT, &sprite, &ramp, particleCount, threadPool);
+		}
+		if (splatter == NULL)
+		{
+			SDL_Log("Could not set up splat rendering");
+			TextureLoader_Destroy(textureLoader);
+			SDL_free(referenceParticles);
+			SDL_free(particles);
+			SDL_free(substepUniforms);
+			CPUSim_Destroy(cpuSim);
+			ParticleReorder_Destroy(reorder);
+			NeighborGrid_Destroy(neighborGrid);
+			ParticleMesh_Destroy(particleMesh);
+			ForceField_Destroy(forceField);
+			ThreadPool_Destroy(threadPool);
+			BenchReport_Destroy(report);
+			return -1;
+		}
+
+		positions = SDL_malloc(sizeof(float) * 2 * particleCount);
+		gradientPositions = SDL_malloc(sizeof(float) * particleCount);
+		image = SDL_malloc(sizeof(uint32_t) * pixelCount);
+		if (options->validate)
+		{
+			referenceImage = SDL_malloc(sizeof(uint32_t) * pixelCount);
+		}
+	}
+
+	FramePacer *framePacer = FramePacer_Create(options->paceMode, options->frameRate, true);
+	FramePacerFrame pacedFrame;
+
+	for (frame = 0; frame < options->frameCount; frame += 1)
+	{
+		FramePacer_Wait(framePacer, 0, &pacedFrame);
+
+		for (step = 0; step < options->substeps; step += 1)
+		{
+			t += dt;
+			Particle_FillUniforms(&substepUniforms[step], particleCount, t, dt);
+		}
+
+		reordered = false;
+		if (reorder != NULL && stepsSinceReorder >= options->reorderInterval)
+		{
+			TRACE_BEGIN(reorderScope, "morton reorder");
+			start = Bench_Now();
+			CPUSim_Reorder(cpuSim, reorder);
+			BenchReport_AddSince(report, BENCH_PHASE_REORDER, start);
+			TRACE_END(reorderScope);
+			stepsSinceReorder = 0;
+			reordered = true;
+		}
+		stepsSinceReorder += options->substeps;
+
+		TRACE_BEGIN(simulateScope, "cpu simulate");
+		start = Bench_Now();
+		CPUSim_StepMany(cpuSim, substepUniforms, options->substeps);
+		BenchReport_AddSince(report, BENCH_PHASE_SIMULATE, start);
+		TRACE_END(simulateScope);
+
+		if (splatter != NULL)
+		{
+			TRACE_BEGIN(renderScope, "splat render");
+			start = Bench_Now();
+			CPUSim_GetRenderStreams(cpuSim, positions, gradientPositions);
+			Splatter_Render(splatter, positions, gradientPositions, particleCount, image);
+			BenchReport_AddSince(report, BENCH_PHASE_RENDER, start);
+			TRACE_END(renderScope);
+		}
+
+		/* Nothing to submit on the CPU, the frame is done once rendered */
+		FramePacer_Submit(framePacer, &pacedFrame);
+
+		if (options->validate)
+		{
+			TRACE_BEGIN(validateScope, "validate");
+			CPUSim_GetParticles(cpuSim, particles);
+			if (reordered)
+			{
+				/* CPUSim keys its float positions, as every unquantized layout does */
+				ParticleReorder_ReferenceApply(referenceParticles, particleCount, PARTICLE_LAYOUT_INTERLEAVED);
+			}
+			if (!CPUSim_ValidateSteps(referenceParticles, particles, substepUniforms, options->substeps, forceField, particleMesh, neighborGrid, options->validateTolerance))
+			{
+				validationFailed = true;
+			}
+
+			/* Binning and threading must not change a single bit */
+			if (splatter != NULL)
+			{
+				SplatCompareReport compareReport;
+				Splatter_RenderReference(splatter, positions, gradientPositions, particleCount, referenceImage);
+				if (!Splat_CompareImages(referenceImage, image, pixelCount, 0, &compareReport))
+				{
+					validationFailed = true;
+					SDL_Log("Frame %u:", frame);
+					Headless_LogSplatCompare("against the reference splatter", false, &compareReport);
+				}
+			}
+			TRACE_END(validateScope);
+		}
+	}
+
+	start = Bench_Now();
+	CPUSim_GetParticles(cpuSim, particles);
+	BenchReport_AddSince(report, BENCH_PHASE_READBACK, start);
+
+	info.backend = "cpu";
+	info.kernel = CPUSim_GetKernelName(CPUSim_GetKernel(cpuSim));
+	info.layout = "soa";
+	info.threadCount = ThreadPool_GetThreadCount(threadPool);
+	info.particleCount = particleCount;
+	info.frameCount = options->frameCount;
+	info.substepCount = options->substeps;
+	info.framesInFlight = 1;
+	info.neighborRadius = (neighborGrid != NULL) ? NeighborGrid_GetRadius(neighborGrid) : 0.0f;
+	info.meshSize = (particleMesh != NULL) ? ParticleMesh_GetGridSize(particleMesh) : 0;
+	info.seed = options->seed;
+	info.startup = "off";
+	info.startupSeconds = 0.0;
+	info.coldStartupSeconds = 0.0;
+	info.checksum = Bench_Checksum(particles, sizeof(Particle) * particleCount);
+	Headless_SetPacing(&info, framePacer, options);
+
+	Headless_FinishReport(report, &info, options);
+	FramePacer_LogStats(framePacer);
+	if (forceField != NULL)
+	{
+		ForceField_LogTimings(forceField);
+	}
+	if (particleMesh != NULL)
+	{
+		ParticleMesh_LogTimings(particleMesh);
+	}
+	if (reorder != NULL)
+	{
+		ParticleReorder_LogTimings(reorder);
+	}
+	if (splatter != NULL)
+	{
+		Splatter_LogTimings(splatter);
+		Headless_FinishSplat(image, SPLAT_IMAGE_WIDTH, SPLAT_IMAGE_HEIGHT, options);
+	}
+
+	FramePacer_Destroy(framePacer);
+	Splatter_Destroy(splatter);
+	TextureLoader_Destroy(textureLoader);
+	SDL_free(positions);
+	SDL_free(gradientPositions);
+	SDL_free(image);
+	SDL_free(referenceImage);
+	SDL_free(substepUniforms);
+	SDL_free(referenceParticles);
+	SDL_free(particles);
+	CPUSim_Destroy(cpuSim);
+	ParticleReorder_Destroy(reorder);
+	NeighborGrid_Destroy(neighborGrid);
+	ParticleMesh_Destroy(particleMesh);
+	ForceField_Destroy(forceField);
+	ThreadPool_Destroy(threadPool);
+	BenchReport_Destroy(report);
+
+	return validationFailed ? 1 : 0;
+}
+
+void Headless_SetPacing(BenchInfo *info, FramePacer *pacer, const Options *options)
+{
+	info->pacing = FramePacer_GetModeName(options->paceMode);
+	info->frameRate = (options->paceMode == FRAME_PACE_THROUGHPUT) ? 0.0 : options->frameRate;
+	FramePacer_GetStats(pacer, &info->paced);
+}
+
+void Headless_FinishReport(BenchReport *report, const BenchInfo *info, const Options *options)
+{
+	BenchReport_Log(report, info);
+
+	if (options->reportJSONPath != NULL)
+	{
+		BenchReport_WriteJSON(report, info, options->reportJSONPath);
+	}
+	if (options->reportCSVPath != NULL)
+	{
+		BenchReport_WriteCSV(report, info, options->reportCSVPath);
+	}
+}
+
+void Headless_FinishSplat(uint8_t *rgba, uint32_t width, uint32_t height, const Options *options)
+{
+	if (options->splatReferencePath != NULL)
+	{
+		int32_t referenceWidth, referenceHeight, channelCount;
+		uint8_t *reference = REFRESH_Image_Load(options->splatReferencePath, &referenceWidth, &referenceHeight, &channelCount);
+
+		if (reference == NULL)
+		{
+			SDL_Log("Could not load splat reference %s", options->splatReferencePath);
+		}
+		else if ((uint32_t) referenceWidth != width || (uint32_t) referenceHeight != height)
+		{
+			SDL_Log(
+				"Splat reference %s is %dx%d, the frame is %ux%u",
+				options->splatReferencePath,
+				referenceWidth,
+				referenceHeight,
+				width,
+				height
+			);
+		}
+		else
+		{
+			SplatCompareReport compareReport;
+			bool matched = Splat_CompareImages(reference, rgba, width * height, SPLAT_COMPARE_TOLERANCE, &compareReport);
+			Headless_LogSplatCompare("against the reference image", matched, &compareReport);
+		}
+
+		if (reference != NULL)
+		{
+			REFRESH_Image_Free(reference);
+		}
+	}
+
+	if (options->splatOutputPath != NULL)
+	{
+		REFRESH_Image_SavePNG(options->splatOutputPath, width, height, rgba);
+	}
+}
+
+bool Headless_ValidateSplat(
+	const uint8_t *rgba,
+	const Particle *particles,
+	uint32_t particleCount,
+	const SplatTexture *sprite,
+	const SplatTexture *ramp,
+	ThreadPool *pool
+) {
+	uint32_t i;
+	uint32_t pixelCount = SPLAT_IMAGE_WIDTH * SPLAT_IMAGE_HEIGHT;
+	Splatter *splatter = Splatter_Create(SPLAT_IMAGE_WIDTH, SPLAT_IMAGE_HEIGHT, sprite, ramp, particleCount, pool);
+	float *positions = SDL_malloc(sizeof(float) * 2 * particleCount);
+	float *gradientPositions = SDL_malloc(sizeof(float) * particleCount);
+	uint8_t *expected = SDL_malloc(sizeof(uint32_t) * pixelCount);
+	SplatCompareReport compareReport;
+	bool matched;
+
+	for (i = 0; i < particleCount; i += 1)
+	{
+		positions[i * 2 + 0] = particles[i].xPosition;
+		positions[i * 2 + 1] = particles[i].yPosition;
+		gradientPositions[i] = particles[i].gradientPosition;
+	}
+
+	Splatter_Render(splatter, positions, gradientPositions, particleCount, expected);
+	matched = Splat_CompareImages(expected, rgba, pixelCount, SPLAT_COMPARE_TOLERANCE, &compareReport);
+	Headless_LogSplatCompare("against the CPU splatter", matched, &compareReport);
+
+	Splatter_Destroy(splatter);
+	SDL_free(positions);
+	SDL_free(gradientPositions);
+	SDL_free(expected);
+
+	return matched;
+}
@@ -0,0 +1,46 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include "bench.h"
+#include "force_field.h"
+#include "options.h"
+#include "splat.h"
+
+/* Runs the fixed-frame benchmark on CPUSim alone.
+ * No SDL video subsystem or Refresh device is created, so this works on
+ * machines without a GPU.
+ * Returns 0, -1 if setup failed, or 1 if --validate found a mismatch.
+ */
+int Headless_RunCPU(const Options *options);
+
+/* The force field options ask for, with their texture loaded and added.
+ * Returns NULL if the texture could not be loaded.
+ */
+ForceField* Headless_CreateForceField(const Options *options, uint32_t maxVectorWidth, ThreadPool *pool);
+
+/* Fills in info's pacing from a run paced on pacer */
+void Headless_SetPacing(BenchInfo *info, FramePacer *pacer, const Options *options);
+
+/* Logs the report and writes the JSON/CSV files requested in options */
+void Headless_FinishReport(BenchReport *report, const BenchInfo *info, const Options *options);
+
+/* Compares the last splat frame, width x height R8G8B8A8 pixels, against
+ * options->splatReferencePath within SPLAT_COMPARE_TOLERANCE and writes it
+ * to options->splatOutputPath, each if set
+ */
+void Headless_FinishSplat(uint8_t *rgba, uint32_t width, uint32_t height, const Options *options);
+
+/* Renders the particles with a Splatter on the pool and logs how far the
+ * GPU's SPLAT_IMAGE_WIDTH x SPLAT_IMAGE_HEIGHT image is from it.
+ * Returns false if it is outside SPLAT_COMPARE_TOLERANCE.
+ */
+bool Headless_ValidateSplat(
+	const uint8_t *rgba,
+	const Particle *particles,
+	uint32_t particleCount,
+	const SplatTexture *sprite,
+	const SplatTexture *ramp,
+	ThreadPool *pool
+);
+
+#endif /* HEADLESS_H */
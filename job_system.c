@@ -0,0 +1,716 @@
+#include "job_system.h"
+
+#include <SDL.h>
+
+#include "bench.h"
+#include "trace.h"
+
+/* Per worker; more ready jobs than this spill into the shared queue */
+#define JOB_DEQUE_CAPACITY 256
+
+/* Empty searches before a worker goes to sleep, or a waiter yields */
+#define JOB_SYSTEM_SPIN_COUNT 256
+
+/* Keeps the ends that different threads write off each other's lines */
+#define JOB_SYSTEM_CACHE_LINE 64
+
+/* Positions run over the int in SDL_atomic_t; only their differences count */
+#define JOB_DISTANCE(a, b) ((int32_t) ((uint32_t) (a) - (uint32_t) (b)))
+
+/* Lock-free queue, Vyukov's bounded MPMC design: each cell's sequence says
+ * whether it is free for the producer at that position or full for the
+ * consumer at it
+ */
+
+typedef struct JobQueueCell
+{
+	SDL_atomic_t sequence;
+	void *item;
+} JobQueueCell;
+
+struct JobQueue
+{
+	JobQueueCell *cells;
+	uint32_t mask;
+	char padding0[JOB_SYSTEM_CACHE_LINE];
+	SDL_atomic_t pushPosition;
+	char padding1[JOB_SYSTEM_CACHE_LINE];
+	SDL_atomic_t popPosition;
+	char padding2[JOB_SYSTEM_CACHE_LINE];
+};
+
+JobQueue* JobQueue_Create(uint32_t capacity)
+{
+	JobQueue *queue = SDL_malloc(sizeof(JobQueue));
+	uint32_t size = 2;
+	uint32_t i;
+
+	while (size < capacity)
+	{
+		size *= 2;
+	}
+
+	SDL_zerop(queue);
+	queue->cells = SDL_malloc(sizeof(JobQueueCell) * size);
+	queue->mask = size - 1;
+
+	for (i = 0; i < size; i += 1)
+	{
+		SDL_AtomicSet(&queue->cells[i].sequence, (int) i);
+		queue->cells[i].item = NULL;
+	}
+	SDL_AtomicSet(&queue->pushPosition, 0);
+	SDL_AtomicSet(&queue->popPosition, 0);
+
+	return queue;
+}
+
+void JobQueue_Destroy(JobQueue *queue)
+{
+	if (queue == NULL)
+	{
+		return;
+	}
+
+	SDL_free(queue->cells);
+	SDL_free(queue);
+}
+
+bool JobQueue_Push(JobQueue *queue, void *item)
+{
+	JobQueueCell *cell;
+	int position = SDL_AtomicGet(&queue->pushPosition);
+	int32_t distance;
+
+	for (;;)
+	{
+		cell = &queue->cells[(uint32_t) position & queue->mask];
+		distance = JOB_DISTANCE(SDL_AtomicGet(&cell->sequence), position);
+
+		if (distance == 0)
+		{
+			if (SDL_AtomicCAS(&queue->pushPosition, position, (int) ((uint32_t) position + 1)))
+			{
+				break;
+			}
+			position = SDL_AtomicGet(&queue->pushPosition);
+		}
+		else if (distance < 0)
+		{
+			return false;
+		}
+		else
+		{
+			position = SDL_AtomicGet(&queue->pushPosition);
+		}
+	}
+
+	SDL_AtomicSetPtr(&cell->item, item);
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&cell->sequence, (int) ((uint32_t) position + 1));
+	return true;
+}
+
+void* JobQueue_Pop(JobQueue *queue)
+{
+	JobQueueCell *cell;
+	void *item;
+	int position = SDL_AtomicGet(&queue->popPosition);
+	int32_t distance;
+
+	for (;;)
+	{
+		cell = &queue->cells[(uint32_t) position & queue->mask];
+		distance = JOB_DISTANCE(SDL_AtomicGet(&cell->sequence), (uint32_t) position + 1);
+
+		if (distance == 0)
+		{
+			if (SDL_AtomicCAS(&queue->popPosition, position, (int) ((uint32_t) position + 1)))
+			{
+				break;
+			}
+			position = SDL_AtomicGet(&queue->popPosition);
+		}
+		else if (distance < 0)
+		{
+			return NULL;
+		}
+		else
+		{
+			position = SDL_AtomicGet(&queue->popPosition);
+		}
+	}
+
+	item = SDL_AtomicGetPtr(&cell->item);
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&cell->sequence, (int) ((uint32_t) position + queue->mask + 1));
+	return item;
+}
+
+/* Work-stealing deque, after Chase and Lev, fixed size. The owner pushes
+ * and pops at bottom, thieves take from top, and the last job is settled
+ * with a compare-and-swap on top. Every update of bottom is an atomic add,
+ * a full barrier in SDL, which orders it before the owner's read of top.
+ */
+
+typedef struct JobDeque
+{
+	void *items[JOB_DEQUE_CAPACITY];
+	char padding0[JOB_SYSTEM_CACHE_LINE];
+	SDL_atomic_t top;
+	char padding1[JOB_SYSTEM_CACHE_LINE];
+	SDL_atomic_t bottom;
+	char padding2[JOB_SYSTEM_CACHE_LINE];
+} JobDeque;
+
+static bool JobDeque_Push(JobDeque *deque, Job *job)
+{
+	int bottom = SDL_AtomicGet(&deque->bottom);
+
+	if (JOB_DISTANCE(bottom, SDL_AtomicGet(&deque->top)) >= JOB_DEQUE_CAPACITY)
+	{
+		return false;
+	}
+
+	SDL_AtomicSetPtr(&deque->items[(uint32_t) bottom % JOB_DEQUE_CAPACITY], job);
+	SDL_AtomicAdd(&deque->bottom, 1);
+	return true;
+}
+
+static Job* JobDeque_Pop(JobDeque *deque)
+{
+	int bottom = (int) ((uint32_t) SDL_AtomicAdd(&deque->bottom, -1) - 1);
+	int top = SDL_AtomicGet(&deque->top);
+	Job *job;
+
+	if (JOB_DISTANCE(bottom, top) < 0)
+	{
+		SDL_AtomicAdd(&deque->bottom, 1);
+		return NULL;
+	}
+
+	job = (Job*) SDL_AtomicGetPtr(&deque->items[(uint32_t) bottom % JOB_DEQUE_CAPACITY]);
+
+	if (bottom == top)
+	{
+		/* The last job, which a thief may be taking too */
+		if (!SDL_AtomicCAS(&deque->top, top, (int) ((uint32_t) top + 1)))
+		{
+			job = NULL;
+		}
+		SDL_AtomicAdd(&deque->bottom, 1);
+	}
+
+	return job;
+}
+
+static Job* JobDeque_Steal(JobDeque *deque)
+{
+	int top = SDL_AtomicGet(&deque->top);
+	int bottom = SDL_AtomicGet(&deque->bottom);
+	Job *job;
+
+	if (JOB_DISTANCE(bottom, top) <= 0)
+	{
+		return NULL;
+	}
+
+	job = (Job*) SDL_AtomicGetPtr(&deque->items[(uint32_t) top % JOB_DEQUE_CAPACITY]);
+	if (!SDL_AtomicCAS(&deque->top, top, (int) ((uint32_t) top + 1)))
+	{
+		return NULL;
+	}
+
+	return job;
+}
+
+/* Jobs */
+
+typedef struct JobLink
+{
+	Job *job;             /* the dependent */
+	struct JobLink *next;
+} JobLink;
+
+struct Job
+{
+	const char *name;
+	JobFunc func;
+	void *userdata;
+
+	SDL_atomic_t unfinished;  /* dependencies left, plus one while being added */
+	SDL_atomic_t references;  /* the handle and the run */
+	SDL_atomic_t done;
+
+	/* Jobs waiting on this one, pushed by JobSystem_Add. Swapped for
+	 * jobClosed when the job finishes, after which nothing is added.
+	 */
+	void *dependents;
+	JobLink links[JOB_MAX_DEPENDENCIES];
+};
+
+static JobLink jobClosed;
+
+typedef struct JobWorker
+{
+	JobSystem *system;
+	uint32_t index;
+	SDL_Thread *thread;
+	JobDeque deque;
+
+	SDL_atomic_t jobCount;
+	SDL_atomic_t stealCount;
+
+	/* Bench_Now ticks since the last EndFrame, which takes them */
+	SDL_SpinLock busyLock;
+	uint64_t busyTicks;
+	double busySeconds; /* summed by EndFrame */
+} JobWorker;
+
+struct JobSystem
+{
+	JobWorker workers[JOB_SYSTEM_MAX_WORKERS];
+	uint32_t workerCount;
+	JobWorker external; /* stats of jobs run by threads that are not workers */
+	SDL_TLSID workerIndex; /* worker index plus one, 0 elsewhere */
+
+	Job *jobs;
+	JobQueue *freeJobs;
+	JobQueue *injected;
+	SDL_atomic_t liveJobCount;
+
+	SDL_sem *wake;
+	SDL_atomic_t sleeperCount;
+	SDL_atomic_t shutdown;
+
+	/* EndFrame, from one thread */
+	uint64_t frameStart;
+	uint32_t frameCount;
+	double frameSeconds;
+};
+
+/* A push can find its cell still taken by a pop at an earlier lap that has
+ * not quite finished; that pop will, so wait rather than lose the job
+ */
+static void JobSystem_Enqueue(JobQueue *queue, Job *job)
+{
+	while (!JobQueue_Push(queue, job))
+	{
+		SDL_Delay(0);
+	}
+}
+
+static int32_t JobSystem_GetCurrentWorker(JobSystem *system)
+{
+	return (int32_t) (uintptr_t) SDL_TLSGet(system->workerIndex) - 1;
+}
+
+static void JobSystem_Push(JobSystem *system, Job *job, int32_t worker)
+{
+	if (worker < 0 || !JobDeque_Push(&system->workers[worker].deque, job))
+	{
+		/* Holds every job there can be, so it is never full for long */
+		JobSystem_Enqueue(system->injected, job);
+	}
+
+	if (SDL_AtomicGet(&system->sleeperCount) > 0)
+	{
+		SDL_SemPost(system->wake);
+	}
+}
+
+static Job* JobSystem_Find(JobSystem *system, int32_t worker, bool *stolen)
+{
+	Job *job;
+	uint32_t i, victim;
+
+	*stolen = false;
+
+	if (worker >= 0 && (job = JobDeque_Pop(&system->workers[worker].deque)) != NULL)
+	{
+		return job;
+	}
+
+	if ((job = (Job*) JobQueue_Pop(system->injected)) != NULL)
+	{
+		return job;
+	}
+
+	for (i = 1; i <= system->workerCount; i += 1)
+	{
+		victim = ((uint32_t) SDL_max(worker, 0) + i) % system->workerCount;
+		if ((int32_t) victim != worker && (job = JobDeque_Steal(&system->workers[victim].deque)) != NULL)
+		{
+			*stolen = true;
+			return job;
+		}
+	}
+
+	return NULL;
+}
+
+static void JobSystem_Unreference(JobSystem *system, Job *job)
+{
+	if (SDL_AtomicAdd(&job->references, -1) == 1)
+	{
+		SDL_AtomicAdd(&system->liveJobCount, -1);
+		JobSystem_Enqueue(system->freeJobs, job);
+	}
+}
+
+static void JobSystem_Run(JobSystem *system, Job *job, int32_t worker, bool stolen)
+{
+	JobWorker *stats = (worker >= 0) ? &system->workers[worker] : &system->external;
+	JobLink *link, *next;
+	Job *dependent;
+	uint64_t start = Bench_Now();
+	uint64_t end;
+
+	TRACE_BEGIN(jobScope, job->name);
+	job->func(job->userdata);
+	TRACE_END(jobScope);
+
+	end = Bench_Now();
+	SDL_AtomicLock(&stats->busyLock);
+	stats->busyTicks += end - start;
+	SDL_AtomicUnlock(&stats->busyLock);
+	SDL_AtomicAdd(&stats->jobCount, 1);
+	if (stolen)
+	{
+		SDL_AtomicAdd(&stats->stealCount, 1);
+	}
+
+	link = (JobLink*) SDL_AtomicSetPtr(&job->dependents, &jobClosed);
+	for (; link != NULL; link = next)
+	{
+		/* The dependent may run and be reused as soon as it is released */
+		next = link->next;
+		dependent = link->job;
+
+		if (SDL_AtomicAdd(&dependent->unfinished, -1) == 1)
+		{
+			JobSystem_Push(system, dependent, worker);
+		}
+	}
+
+	SDL_AtomicAdd(&job->done, 1);
+	JobSystem_Unreference(system, job);
+}
+
+/* Runs one ready job if there is one */
+static bool JobSystem_RunOne(JobSystem *system, int32_t worker)
+{
+	bool stolen;
+	Job *job = JobSystem_Find(system, worker, &stolen);
+
+	if (job == NULL)
+	{
+		return false;
+	}
+
+	JobSystem_Run(system, job, worker, stolen);
+	return true;
+}
+
+static int JobSystem_WorkerMain(void *data)
+{
+	JobWorker *worker = (JobWorker*) data;
+	JobSystem *system = worker->system;
+	int32_t index = (int32_t) worker->index;
+	uint32_t spinCount = 0;
+
+	SDL_TLSSet(system->workerIndex, (void*) (uintptr_t) (worker->index + 1), NULL);
+	Trace_SetThreadName("job worker");
+
+	for (;;)
+	{
+		if (JobSystem_RunOne(system, index))
+		{
+			spinCount = 0;
+			continue;
+		}
+
+		if (SDL_AtomicGet(&system->shutdown))
+		{
+			break;
+		}
+
+		if (spinCount < JOB_SYSTEM_SPIN_COUNT)
+		{
+			spinCount += 1;
+			continue;
+		}
+
+		/* Announce the sleep before the last look, so a push either sees
+		 * the sleeper or is seen by the look
+		 */
+		SDL_AtomicAdd(&system->sleeperCount, 1);
+		if (!JobSystem_RunOne(system, index) && !SDL_AtomicGet(&system->shutdown))
+		{
+			SDL_SemWait(system->wake);
+		}
+		SDL_AtomicAdd(&system->sleeperCount, -1);
+		spinCount = 0;
+	}
+
+	return 0;
+}
+
+/* Public API */
+
+JobSystem* JobSystem_Create(uint32_t workerCount)
+{
+	JobSystem *system = SDL_malloc(sizeof(JobSystem));
+	uint32_t i;
+
+	SDL_zerop(system);
+
+	system->workerCount = SDL_max(SDL_min(workerCount, JOB_SYSTEM_MAX_WORKERS), 1);
+	system->workerIndex = SDL_TLSCreate();
+
+	system->jobs = SDL_malloc(sizeof(Job) * JOB_SYSTEM_MAX_JOBS);
+	system->freeJobs = JobQueue_Create(JOB_SYSTEM_MAX_JOBS);
+	system->injected = JobQueue_Create(JOB_SYSTEM_MAX_JOBS);
+	for (i = 0; i < JOB_SYSTEM_MAX_JOBS; i += 1)
+	{
+		JobQueue_Push(system->freeJobs, &system->jobs[i]);
+	}
+
+	system->wake = SDL_CreateSemaphore(0);
+
+	for (i = 0; i < system->workerCount; i += 1)
+	{
+		system->workers[i].system = system;
+		system->workers[i].index = i;
+		system->workers[i].thread = SDL_CreateThread(JobSystem_WorkerMain, "JobWorker", &system->workers[i]);
+	}
+
+	return system;
+}
+
+void JobSystem_Destroy(JobSystem *system)
+{
+	uint32_t i;
+
+	if (system == NULL)
+	{
+		return;
+	}
+
+	while (SDL_AtomicGet(&system->liveJobCount) > 0)
+	{
+		if (!JobSystem_RunOne(system, JobSystem_GetCurrentWorker(system)))
+		{
+			SDL_Delay(1);
+		}
+	}
+
+	SDL_AtomicSet(&system->shutdown, 1);
+	for (i = 0; i < system->workerCount; i += 1)
+	{
+		SDL_SemPost(system->wake);
+	}
+	for (i = 0; i < system->workerCount; i += 1)
+	{
+		SDL_WaitThread(system->workers[i].thread, NULL);
+	}
+
+	SDL_DestroySemaphore(system->wake);
+	JobQueue_Destroy(system->injected);
+	JobQueue_Destroy(system->freeJobs);
+	SDL_free(system->jobs);
+	SDL_free(system);
+}
+
+uint32_t JobSystem_GetWorkerCount(JobSystem *system)
+{
+	return system->workerCount;
+}
+
+Job* JobSystem_Add(
+	JobSystem *system,
+	const char *name,
+	JobFunc func,
+	void *userdata,
+	Job *const *dependencies,
+	uint32_t dependencyCount
+) {
+	int32_t worker = JobSystem_GetCurrentWorker(system);
+	uint32_t i, linkCount = 0;
+	JobLink *link, *head;
+	Job *job;
+
+	while ((job = (Job*) JobQueue_Pop(system->freeJobs)) == NULL)
+	{
+		if (!JobSystem_RunOne(system, worker))
+		{
+			SDL_Delay(0);
+		}
+	}
+
+	SDL_AtomicAdd(&system->liveJobCount, 1);
+
+	job->name = name;
+	job->func = func;
+	job->userdata = userdata;
+	SDL_AtomicSet(&job->unfinished, 1);
+	SDL_AtomicSet(&job->references, 2);
+	SDL_AtomicSet(&job->done, 0);
+	SDL_AtomicSetPtr(&job->dependents, NULL);
+
+	SDL_assert(dependencyCount <= JOB_MAX_DEPENDENCIES);
+
+	for (i = 0; i < SDL_min(dependencyCount, JOB_MAX_DEPENDENCIES); i += 1)
+	{
+		if (dependencies[i] == NULL)
+		{
+			continue;
+		}
+
+		link = &job->links[linkCount];
+		link->job = job;
+		linkCount += 1;
+
+		SDL_AtomicAdd(&job->unfinished, 1);
+		for (;;)
+		{
+			head = (JobLink*) SDL_AtomicGetPtr(&dependencies[i]->dependents);
+			if (head == &jobClosed)
+			{
+				/* Already finished */
+				SDL_AtomicAdd(&job->unfinished, -1);
+				break;
+			}
+
+			link->next = head;
+			if (SDL_AtomicCASPtr(&dependencies[i]->dependents, head, link))
+			{
+				break;
+			}
+		}
+	}
+
+	if (SDL_AtomicAdd(&job->unfinished, -1) == 1)
+	{
+		JobSystem_Push(system, job, worker);
+	}
+
+	return job;
+}
+
+void JobSystem_Wait(JobSystem *system, Job *job)
+{
+	int32_t worker = JobSystem_GetCurrentWorker(system);
+	uint32_t spinCount = 0;
+
+	if (job == NULL)
+	{
+		return;
+	}
+
+	TRACE_BEGIN(waitScope, "wait for job");
+	while (!SDL_AtomicGet(&job->done))
+	{
+		if (JobSystem_RunOne(system, worker))
+		{
+			spinCount = 0;
+		}
+		else if (++spinCount >= JOB_SYSTEM_SPIN_COUNT)
+		{
+			SDL_Delay(0);
+		}
+	}
+	TRACE_END(waitScope);
+
+	JobSystem_Unreference(system, job);
+}
+
+void JobSystem_Release(JobSystem *system, Job *job)
+{
+	if (job != NULL)
+	{
+		JobSystem_Unreference(system, job);
+	}
+}
+
+static void JobSystem_TakeBusySeconds(JobWorker *worker)
+{
+	uint64_t ticks;
+
+	SDL_AtomicLock(&worker->busyLock);
+	ticks = worker->busyTicks;
+	worker->busyTicks = 0;
+	SDL_AtomicUnlock(&worker->busyLock);
+
+	worker->busySeconds += Bench_Seconds(0, ticks);
+}
+
+void JobSystem_EndFrame(JobSystem *system)
+{
+	uint64_t now = Bench_Now();
+	uint32_t i;
+
+	/* A job counts toward the frame it finishes in */
+	for (i = 0; i < system->workerCount; i += 1)
+	{
+		JobSystem_TakeBusySeconds(&system->workers[i]);
+	}
+	JobSystem_TakeBusySeconds(&system->external);
+
+	if (system->frameStart == 0)
+	{
+		/* Nothing before the first frame counts */
+		for (i = 0; i < system->workerCount; i += 1)
+		{
+			system->workers[i].busySeconds = 0.0;
+		}
+		system->external.busySeconds = 0.0;
+		system->frameStart = now;
+		return;
+	}
+
+	system->frameSeconds += Bench_Seconds(system->frameStart, now);
+	system->frameStart = now;
+	system->frameCount += 1;
+}
+
+void JobSystem_LogStats(JobSystem *system)
+{
+	double busySeconds = system->external.busySeconds;
+	uint32_t i;
+
+	if (system->frameCount == 0 || system->frameSeconds <= 0.0)
+	{
+		return;
+	}
+
+	for (i = 0; i < system->workerCount; i += 1)
+	{
+		busySeconds += system->workers[i].busySeconds;
+	}
+
+	SDL_Log(
+		"Job system: %u workers over %u frames, %.2f ms of jobs per frame, %.2f cores busy on average",
+		system->workerCount,
+		system->frameCount,
+		busySeconds * 1000.0 / system->frameCount,
+		busySeconds / system->frameSeconds
+	);
+
+	for (i = 0; i < system->workerCount; i += 1)
+	{
+		SDL_Log(
+			"  worker %u: %d jobs, %d stolen, %.1f%% busy",
+			i,
+			SDL_AtomicGet(&system->workers[i].jobCount),
+			SDL_AtomicGet(&system->workers[i].stealCount),
+			100.0 * system->workers[i].busySeconds / system->frameSeconds
+		);
+	}
+
+	SDL_Log(
+		"  other threads: %d jobs, %.1f%% of a core",
+		SDL_AtomicGet(&system->external.jobCount),
+		100.0 * system->external.busySeconds / system->frameSeconds
+	);
+}
@@ -0,0 +1,100 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A work-stealing job system for the CPU side of a frame.
+ *
+ * Each worker thread owns a deque of ready jobs. It pushes and pops at one
+ * end, and workers with nothing to do steal from the other. Threads that
+ * are not workers, like the main and record threads, hand jobs in through
+ * a queue every worker also takes from. The deques and that queue are
+ * fixed size and lock free; a worker only sleeps, on a semaphore, once it
+ * has found nothing to run anywhere.
+ *
+ * A job becomes ready once every job it depends on has finished, and goes
+ * on the deque of the worker that finished the last of them, so a chain of
+ * jobs tends to stay on one core. Jobs should not wait on each other; make
+ * it a dependency instead.
+ *
+ * ThreadPool (thread_pool.h) stays the way to split one loop across cores.
+ * A job may call into a pool as long as no other job uses it at the same
+ * time.
+ */
+
+#define JOB_SYSTEM_MAX_WORKERS 32
+#define JOB_SYSTEM_MAX_JOBS 1024 /* not yet released at once */
+#define JOB_MAX_DEPENDENCIES 4
+
+/* A bounded lock-free queue of pointers for any number of producers and
+ * consumers, which the job system also uses to hand jobs in
+ */
+typedef struct JobQueue JobQueue;
+
+/* capacity is rounded up to a power of two */
+JobQueue* JobQueue_Create(uint32_t capacity);
+void JobQueue_Destroy(JobQueue *queue);
+
+/* Returns false if the queue is full. That includes the moment a pop of the
+ * same cell, one lap earlier, is still finishing, so a caller that knows
+ * there is room should try again.
+ */
+bool JobQueue_Push(JobQueue *queue, void *item);
+
+/* Returns NULL if the queue is empty, or if the push of its oldest item is
+ * still finishing while a later one has finished
+ */
+void* JobQueue_Pop(JobQueue *queue);
+
+typedef struct JobSystem JobSystem;
+typedef struct Job Job;
+
+typedef void (*JobFunc)(void *userdata);
+
+/* workerCount is clamped to [1, JOB_SYSTEM_MAX_WORKERS] */
+JobSystem* JobSystem_Create(uint32_t workerCount);
+
+/* Waits for every job to be released, then joins the workers */
+void JobSystem_Destroy(JobSystem *system);
+
+uint32_t JobSystem_GetWorkerCount(JobSystem *system);
+
+/* Adds a job that runs func(userdata) once each of the dependencies has
+ * finished. NULL dependencies are skipped, so an optional step can be
+ * passed as is. name must be a string literal or otherwise outlive the
+ * trace (trace.h).
+ *
+ * The returned handle stays valid, also as a later job's dependency, until
+ * it is given to JobSystem_Wait or JobSystem_Release. If every job slot is
+ * taken, runs other jobs until one is released.
+ */
+Job* JobSystem_Add(
+	JobSystem *system,
+	const char *name,
+	JobFunc func,
+	void *userdata,
+	Job *const *dependencies,
+	uint32_t dependencyCount
+);
+
+/* Runs ready jobs until job has finished, then releases it. NULL is
+ * ignored.
+ */
+void JobSystem_Wait(JobSystem *system, Job *job);
+
+/* Gives the handle up, whether or not the job has finished. NULL is
+ * ignored.
+ */
+void JobSystem_Release(JobSystem *system, Job *job);
+
+/* Utilization statistics. Each call closes a frame: the time since the
+ * previous call, and how much of it each worker spent running jobs. The
+ * first call only opens the first frame.
+ */
+void JobSystem_EndFrame(JobSystem *system);
+
+/* Job time per frame, and jobs, steals and busy share per worker */
+void JobSystem_LogStats(JobSystem *system);
+
+#endif /* JOB_SYSTEM_H */
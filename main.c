@@ -14,33 +14,718 @@
 #include <Refresh.h>
 #include <Refresh_Image.h>
 
-#define PARTICLE_COUNT 256 * 1024
+#include "particle.h"
+#include "bench.h"
+#include "checkpoint.h"
+#include "cpu_sim.h"
+#include "dispatch_tuner.h"
+#include "frame_capture.h"
+#include "frame_pacer.h"
+#include "frame_ring.h"
+#include "force_field.h"
+#include "force_field_gpu.h"
+#include "headless.h"
+#include "job_system.h"
+#include "neighbor_grid.h"
+#include "neighbor_grid_gpu.h"
+#include "options.h"
+#include "particle_buffers.h"
+#include "particle_mesh.h"
+#include "particle_mesh_gpu.h"
+#include "particle_pool.h"
+#include "particle_pool_gpu.h"
+#include "particle_quantize.h"
+#include "particle_reorder.h"
+#include "particle_reorder_gpu.h"
+#include "shader_module.h"
+#include "splat_gpu.h"
+#include "texture_loader.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "trajectory.h"
+#include "trajectory_export.h"
+
+/* Records stepCount fixed steps into one command buffer. With a force
+ * field, particle mesh or neighbor grid every step is preceded by their
+ * passes, so steps cannot be batched.
+ */
+static void RecordParticleUpdate(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	REFRESH_ComputePipeline *computePipeline,
+	const DispatchVariant *dispatchVariant,
+	ParticleBuffers *particleBuffers,
+	ForceFieldGPU *forceFieldGPU,
+	ParticleMeshGPU *meshGPU,
+	NeighborGridGPU *neighborGridGPU,
+	SubstepMode substepMode,
+	const ParticleComputeUniforms *steps,
+	uint32_t stepCount
+) {
+	uint32_t i, batchCount;
+	uint32_t groupCount = DispatchVariant_GetGroupCount(dispatchVariant, steps[0].particleCount);
+	uint32_t computeParamOffset;
+	ParticleSubstepUniforms substepUniforms;
+	bool perStepPasses = (forceFieldGPU != NULL || meshGPU != NULL || neighborGridGPU != NULL);
+
+	REFRESH_BindComputePipeline(device, commandBuffer, computePipeline);
+
+	for (i = 0; i < stepCount; i += batchCount)
+	{
+		if (forceFieldGPU != NULL)
+		{
+			ForceFieldGPU_Record(device, commandBuffer, forceFieldGPU, &steps[i]);
+		}
+		if (meshGPU != NULL)
+		{
+			ParticleMeshGPU_Record(device, commandBuffer, meshGPU, &steps[i]);
+		}
+		if (neighborGridGPU != NULL)
+		{
+			NeighborGridGPU_Record(device, commandBuffer, neighborGridGPU, &steps[i]);
+		}
+		if (perStepPasses)
+		{
+			REFRESH_BindComputePipeline(device, commandBuffer, computePipeline);
+		}
+
+		/* Rebinding per dispatch makes Refresh insert the barrier between
+		 * consecutive dispatches that read and write the same buffers.
+		 */
+		REFRESH_BindComputeBuffers(device, commandBuffer, particleBuffers->buffers);
 
-typedef struct Particle
+		if (substepMode == SUBSTEP_MODE_LOOP)
+		{
+			batchCount = perStepPasses ? 1 : SDL_min(stepCount - i, MAX_SUBSTEPS);
+			Particle_FillSubstepUniforms(&substepUniforms, &steps[i], batchCount);
+			computeParamOffset = REFRESH_PushComputeShaderParams(device, commandBuffer, &substepUniforms, 1);
+		}
+		else
+		{
+			batchCount = 1;
+			computeParamOffset = REFRESH_PushComputeShaderParams(device, commandBuffer, (void*) &steps[i], 1);
+		}
+
+		REFRESH_DispatchCompute(device, commandBuffer, groupCount, 1, 1, computeParamOffset);
+	}
+}
+
+/* Runs the pool's kill and emit bookkeeping for the frame's steps and
+ * points every step at the predicted live particles
+ */
+static void BeginPoolFrame(ParticlePool *particlePool, FrameSlot *frameSlot, ParticlePoolFrame *poolFrame)
 {
-	float xPosition, yPosition;
-	float xVelocity, yVelocity;
-	float gradientPosition, dummy1, dummy2, dummy3;
-} Particle;
+	uint32_t i;
+
+	ParticlePool_BeginFrame(particlePool, frameSlot->substepCount, poolFrame);
+
+	for (i = 0; i < frameSlot->substepCount; i += 1)
+	{
+		frameSlot->substepUniforms[i].particleCount = poolFrame->liveCount;
+	}
+}
 
-typedef struct ParticleComputeUniforms
+/* Records a checkpoint of the particles as this frame leaves them */
+static void RecordCheckpoint(
+	CheckpointWriter *checkpointWriter,
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	const Options *options,
+	double t,
+	double accumulator
+) {
+	CheckpointState state;
+
+	state.t = t;
+	state.accumulator = accumulator;
+	state.seed = options->seed;
+
+	if (CheckpointWriter_Record(checkpointWriter, device, commandBuffer, &state, options->checkpointPath))
+	{
+		SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "checkpoint at t = %.2f", t);
+	}
+}
+
+/* Writes the --trace file once every traced thread has stopped */
+static void FinishTrace(const Options *options)
 {
-	float deltaTime;
-	float destinationX, destinationY;
+	if (options->tracePath != NULL)
+	{
+		Trace_WriteChromeJSON(options->tracePath);
+		Trace_Stop();
+	}
+}
+
+/* Packets pass between the simulation and record threads through a queue
+ * each way. There are never more packets than frame ring slots, so a put
+ * never waits, and a take sleeps on the condition until one arrives.
+ */
+typedef struct FramePacketQueue
+{
+	SDL_mutex *mutex;
+	SDL_cond *packetAvailable;
+	struct FramePacket *packets[FRAME_RING_MAX_FRAMES];
+	uint32_t head;
+	uint32_t count;
+} FramePacketQueue;
+
+/* The CPU side of a windowed frame, as the frame jobs see it */
+typedef struct FrameSimulation
+{
+	const Options *options;
 	uint32_t particleCount;
-} ParticleComputeUniforms;
+	CPUSim *cpuSim;
+	ParticleReorder *particleReorder;
+	ParticleBuffers **frameParticleBuffers;
+	Particle *referenceParticles;
+	ForceField *forceField;
+	ParticleMesh *particleMesh;
+	NeighborGrid *neighborGrid;
+	FramePacketQueue *readyPackets; /* with --jobs */
+	bool validationFailed; /* stays set once any frame mismatched */
+} FrameSimulation;
+
+/* One windowed frame on its way from the simulation to the recording side.
+ * There is one per frame ring slot, and they go round in order, so a packet
+ * is always recorded into the slot of its index.
+ */
+typedef struct FramePacket
+{
+	uint32_t index;
+	FrameSimulation *simulation;
+
+	ParticleComputeUniforms *substepUniforms;
+	uint32_t substepCount;
+	double startT; /* before the first step */
+	double t;      /* after the last */
+	double dt;
+	double accumulator;
+
+	bool reordered;
+	bool screenshot;
+	bool checkpoint;
+	bool quit; /* stops the record thread */
+
+	FramePacerFrame paced; /* input sample and submit deadline */
+
+	/* CPU backend: the stepped particles, uploaded unless the split
+	 * streams went straight to the slot's staging arrays
+	 */
+	Particle *particles;
+} FramePacket;
+
+static void FramePacketQueue_Create(FramePacketQueue *queue)
+{
+	SDL_zerop(queue);
+	queue->mutex = SDL_CreateMutex();
+	queue->packetAvailable = SDL_CreateCond();
+}
 
-float randomFloat(float min, float max)
+static void FramePacketQueue_Destroy(FramePacketQueue *queue)
 {
-    float scale = rand() / (float) RAND_MAX; /* [0, 1.0] */
-    return min + scale * ( max - min );      /* [min, max] */
+	SDL_DestroyCond(queue->packetAvailable);
+	SDL_DestroyMutex(queue->mutex);
 }
 
-int main(int argc, char *argv[])
+static void FramePacketQueue_Put(FramePacketQueue *queue, FramePacket *packet)
+{
+	SDL_LockMutex(queue->mutex);
+	SDL_assert(queue->count < FRAME_RING_MAX_FRAMES);
+	queue->packets[(queue->head + queue->count) % FRAME_RING_MAX_FRAMES] = packet;
+	queue->count += 1;
+	SDL_CondSignal(queue->packetAvailable);
+	SDL_UnlockMutex(queue->mutex);
+}
+
+static FramePacket* FramePacketQueue_Take(FramePacketQueue *queue)
+{
+	FramePacket *packet;
+
+	SDL_LockMutex(queue->mutex);
+	while (queue->count == 0)
+	{
+		SDL_CondWait(queue->packetAvailable, queue->mutex);
+	}
+	packet = queue->packets[queue->head];
+	queue->head = (queue->head + 1) % FRAME_RING_MAX_FRAMES;
+	queue->count -= 1;
+	SDL_UnlockMutex(queue->mutex);
+
+	return packet;
+}
+
+/* Frame jobs. Run inline they are the single-threaded frame. */
+
+static void FramePacket_FillUniforms(void *data)
 {
+	FramePacket *packet = (FramePacket*) data;
+	double t = packet->startT;
 	uint32_t i;
 
-	srand((uint32_t)time(NULL));
+	/* Advances t as the loop did, so the uniforms match it to the bit */
+	for (i = 0; i < packet->substepCount; i += 1)
+	{
+		t += packet->dt;
+		Particle_FillUniforms(&packet->substepUniforms[i], packet->simulation->particleCount, t, packet->dt);
+	}
+}
+
+static void FramePacket_Reorder(void *data)
+{
+	FramePacket *packet = (FramePacket*) data;
+
+	TRACE_BEGIN(reorderScope, "morton reorder");
+	CPUSim_Reorder(packet->simulation->cpuSim, packet->simulation->particleReorder);
+	TRACE_END(reorderScope);
+}
+
+static void FramePacket_Step(void *data)
+{
+	FramePacket *packet = (FramePacket*) data;
+
+	TRACE_BEGIN(simulateScope, "cpu simulate");
+	CPUSim_StepMany(packet->simulation->cpuSim, packet->substepUniforms, packet->substepCount);
+	TRACE_END(simulateScope);
+}
+
+static void FramePacket_Extract(void *data)
+{
+	FramePacket *packet = (FramePacket*) data;
+	FrameSimulation *simulation = packet->simulation;
+	ParticleBuffers *frameBuffers = simulation->frameParticleBuffers[packet->index];
+
+	TRACE_BEGIN(extractScope, "extract particles");
+	if (simulation->options->layout == PARTICLE_LAYOUT_SPLIT)
+	{
+		CPUSim_GetRenderStreams(simulation->cpuSim, frameBuffers->positions, frameBuffers->gradientPositions);
+	}
+	else
+	{
+		CPUSim_GetParticles(simulation->cpuSim, packet->particles);
+	}
+	TRACE_END(extractScope);
+}
+
+static void FramePacket_Validate(void *data)
+{
+	FramePacket *packet = (FramePacket*) data;
+	FrameSimulation *simulation = packet->simulation;
+
+	TRACE_BEGIN(validateScope, "validate");
+	if (simulation->options->layout == PARTICLE_LAYOUT_SPLIT)
+	{
+		CPUSim_GetParticles(simulation->cpuSim, packet->particles);
+	}
+	if (packet->reordered)
+	{
+		/* CPUSim keys its float positions whatever the upload layout */
+		ParticleReorder_ReferenceApply(simulation->referenceParticles, simulation->particleCount, PARTICLE_LAYOUT_INTERLEAVED);
+	}
+	if (!CPUSim_ValidateSteps(
+		simulation->referenceParticles,
+		packet->particles,
+		packet->substepUniforms,
+		packet->substepCount,
+		simulation->forceField,
+		simulation->particleMesh,
+		simulation->neighborGrid,
+		simulation->options->validateTolerance
+	)) {
+		simulation->validationFailed = true;
+	}
+	TRACE_END(validateScope);
+}
+
+static void FramePacket_Hand(void *data)
+{
+	FramePacket *packet = (FramePacket*) data;
+
+	FramePacketQueue_Put(packet->simulation->readyPackets, packet);
+}
+
+/* The frame's CPU work, in order, on the calling thread */
+static void FramePacket_Simulate(FramePacket *packet)
+{
+	FrameSimulation *simulation = packet->simulation;
+
+	FramePacket_FillUniforms(packet);
+
+	if (simulation->cpuSim != NULL)
+	{
+		if (packet->reordered)
+		{
+			FramePacket_Reorder(packet);
+		}
+		FramePacket_Step(packet);
+		FramePacket_Extract(packet);
+		if (simulation->options->validate)
+		{
+			FramePacket_Validate(packet);
+		}
+	}
+}
+
+/* The same work as jobs. CPUSim and the validation reference carry over
+ * from frame to frame, so their jobs follow previousTail, the last job of
+ * the frame before. Returns this frame's last job, which the caller owns.
+ */
+static Job* FramePacket_AddJobs(JobSystem *jobSystem, FramePacket *packet, Job *previousTail)
+{
+	FrameSimulation *simulation = packet->simulation;
+	Job *uniforms, *reorder = NULL, *step, *extract, *validate;
+	Job *dependencies[2];
+
+	uniforms = JobSystem_Add(jobSystem, "fill uniforms", FramePacket_FillUniforms, packet, NULL, 0);
+
+	if (simulation->cpuSim == NULL)
+	{
+		return uniforms;
+	}
+
+	if (packet->reordered)
+	{
+		reorder = JobSystem_Add(jobSystem, "morton reorder", FramePacket_Reorder, packet, &previousTail, 1);
+	}
+
+	dependencies[0] = uniforms;
+	dependencies[1] = (reorder != NULL) ? reorder : previousTail;
+	step = JobSystem_Add(jobSystem, "cpu simulate", FramePacket_Step, packet, dependencies, 2);
+	extract = JobSystem_Add(jobSystem, "extract particles", FramePacket_Extract, packet, &step, 1);
+
+	JobSystem_Release(jobSystem, uniforms);
+	JobSystem_Release(jobSystem, reorder);
+	JobSystem_Release(jobSystem, step);
+
+	if (!simulation->options->validate)
+	{
+		return extract;
+	}
+
+	validate = JobSystem_Add(jobSystem, "validate", FramePacket_Validate, packet, &extract, 1);
+	JobSystem_Release(jobSystem, extract);
+	return validate;
+}
+
+/* Everything a windowed frame asks of Refresh, which only one thread may
+ * call into: the main thread, or with --jobs the record thread
+ */
+typedef struct FrameRecorder
+{
+	REFRESH_Device *device;
+	const Options *options;
+	uint32_t particleCount;
+	FrameRing *frameRing;
+
+	ParticleBuffers *particleBuffers;
+	ParticleBuffers **frameParticleBuffers;
+	Particle *particles; /* GPU validation readback */
+	Particle *referenceParticles;
+
+	ParticlePool *particlePool;
+	ParticlePoolGPU *particlePoolGPU;
+	ParticlePoolFrame poolFrame;
+	ParticleReorderGPU *particleReorderGPU;
+	REFRESH_ComputePipeline *computePipeline;
+	const DispatchVariant *dispatchVariant;
+	ForceFieldGPU *forceFieldGPU;
+	ParticleMeshGPU *particleMeshGPU;
+	NeighborGridGPU *neighborGridGPU;
+	ForceField *forceField;
+	ParticleMesh *particleMesh;
+	NeighborGrid *neighborGrid;
+
+	CheckpointWriter *checkpointWriter;
+	TrajectoryExport *trajectoryExport;
+	FrameCapture *frameCapture;
+
+	SplatGPU *splatGPU;
+	REFRESH_GraphicsPipeline *splatResolvePipeline;
+	REFRESH_GraphicsPipeline *graphicsPipeline;
+	REFRESH_RenderPass *renderPass;
+	REFRESH_Framebuffer *framebuffer;
+	REFRESH_Rect renderArea;
+	REFRESH_Color clearColor;
+	REFRESH_DepthStencilValue depthStencilClear;
+	REFRESH_TextureSlice colorTargetSlice;
+	REFRESH_Texture **sampleTextures;
+	REFRESH_Sampler **sampleSamplers;
+
+	FramePacer *framePacer;
+	uint32_t presentedFrameCount;
+	bool validationFailed; /* stays set once any frame mismatched */
+
+	/* Record thread */
+	FramePacketQueue *freePackets;
+	FramePacketQueue *readyPackets;
+	double recordSeconds;
+	double waitSeconds; /* for the simulation to hand a frame over */
+} FrameRecorder;
+
+static void RecordFrame(FrameRecorder *recorder, FramePacket *packet)
+{
+	REFRESH_Device *device = recorder->device;
+	const Options *options = recorder->options;
+	FrameSlot *frameSlot = FrameRing_BeginFrame(recorder->frameRing, device);
+	ParticleBuffers *frameBuffers = recorder->frameParticleBuffers[frameSlot->index];
+	uint32_t drawCount;
+	char capturePath[256];
+
+	/* The CPU backend wrote the split streams into this slot's arrays */
+	SDL_assert(frameSlot->index == packet->index);
+
+	SDL_memcpy(frameSlot->substepUniforms, packet->substepUniforms, sizeof(ParticleComputeUniforms) * packet->substepCount);
+	frameSlot->substepCount = packet->substepCount;
+
+	if (options->backend == SIMULATION_BACKEND_CPU)
+	{
+		TRACE_BEGIN(uploadScope, "upload particles");
+		if (options->layout == PARTICLE_LAYOUT_SPLIT)
+		{
+			ParticleBuffers_UploadRenderStreams(device, frameBuffers);
+		}
+		else
+		{
+			ParticleBuffers_Upload(device, frameBuffers, packet->particles);
+		}
+		TRACE_END(uploadScope);
+	}
+
+	TRACE_BEGIN(recordScope, "record commands");
+	REFRESH_CommandBuffer *commandBuffer = REFRESH_AcquireCommandBuffer(device, 0);
+
+	if (options->backend == SIMULATION_BACKEND_GPU)
+	{
+		if (packet->reordered)
+		{
+			ParticleReorderGPU_Record(device, commandBuffer, recorder->particleReorderGPU);
+		}
+		if (recorder->particlePool != NULL)
+		{
+			BeginPoolFrame(recorder->particlePool, frameSlot, &recorder->poolFrame);
+			ParticlePoolGPU_Record(device, commandBuffer, recorder->particlePoolGPU, &recorder->poolFrame);
+		}
+		RecordParticleUpdate(
+			device,
+			commandBuffer,
+			recorder->computePipeline,
+			recorder->dispatchVariant,
+			recorder->particleBuffers,
+			recorder->forceFieldGPU,
+			recorder->particleMeshGPU,
+			recorder->neighborGridGPU,
+			options->substepMode,
+			frameSlot->substepUniforms,
+			frameSlot->substepCount
+		);
+
+		if (recorder->checkpointWriter != NULL &&
+			(packet->checkpoint || (options->checkpointInterval > 0 && (recorder->presentedFrameCount + 1) % options->checkpointInterval == 0)))
+		{
+			RecordCheckpoint(recorder->checkpointWriter, device, commandBuffer, options, packet->t, packet->accumulator);
+		}
+		if (recorder->trajectoryExport != NULL && recorder->presentedFrameCount % options->exportInterval == 0)
+		{
+			TrajectoryExport_Record(recorder->trajectoryExport, device, commandBuffer, recorder->presentedFrameCount, packet->t);
+		}
+	}
+
+	drawCount = (recorder->particlePool != NULL) ? ParticlePool_GetLiveCount(recorder->particlePool) : recorder->particleCount;
+
+	if (recorder->splatGPU != NULL)
+	{
+		SplatGPU_Record(device, commandBuffer, recorder->splatGPU, drawCount);
+	}
+
+	REFRESH_BeginRenderPass(
+		device,
+		commandBuffer,
+		recorder->renderPass,
+		recorder->framebuffer,
+		recorder->renderArea,
+		&recorder->clearColor,
+		1,
+		&recorder->depthStencilClear
+	);
+
+	if (recorder->splatGPU != NULL)
+	{
+		REFRESH_Buffer *splatImageBuffer = SplatGPU_GetImageBuffer(recorder->splatGPU);
+		uint64_t splatImageOffset = 0;
+
+		REFRESH_BindGraphicsPipeline(device, commandBuffer, recorder->splatResolvePipeline);
+		REFRESH_BindVertexBuffers(device, commandBuffer, 0, 1, &splatImageBuffer, &splatImageOffset);
+		REFRESH_DrawPrimitives(device, commandBuffer, 0, SplatGPU_GetPixelCount(recorder->splatGPU), 0, 0);
+	}
+	else
+	{
+		REFRESH_BindGraphicsPipeline(
+			device,
+			commandBuffer,
+			recorder->graphicsPipeline
+		);
+
+		REFRESH_BindVertexBuffers(
+			device,
+			commandBuffer,
+			0,
+			frameBuffers->vertexBufferCount,
+			frameBuffers->vertexBuffers,
+			frameBuffers->vertexOffsets
+		);
+		REFRESH_SetFragmentSamplers(device, commandBuffer, recorder->sampleTextures, recorder->sampleSamplers);
+		REFRESH_DrawPrimitives(
+			device,
+			commandBuffer,
+			0,
+			drawCount,
+			0,
+			0
+		);
+	}
+
+	REFRESH_EndRenderPass(device, commandBuffer);
+
+	if (packet->screenshot)
+	{
+		SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "screenshot!");
+		FrameCapture_Record(recorder->frameCapture, device, commandBuffer, &recorder->colorTargetSlice, "screenshot.png");
+	}
+	else if (options->captureInterval > 0 && recorder->presentedFrameCount % options->captureInterval == 0)
+	{
+		SDL_snprintf(capturePath, sizeof(capturePath), "%s_%06u.png", options->capturePrefix, recorder->presentedFrameCount);
+		FrameCapture_Record(recorder->frameCapture, device, commandBuffer, &recorder->colorTargetSlice, capturePath);
+	}
+
+	TRACE_END(recordScope);
+
+	TRACE_BEGIN(presentScope, "queue present");
+	REFRESH_QueuePresent(device, commandBuffer, &recorder->colorTargetSlice, &recorder->renderArea, REFRESH_FILTER_NEAREST);
+	TRACE_END(presentScope);
+	FrameRing_Submit(recorder->frameRing, device, commandBuffer);
+	FramePacer_Submit(recorder->framePacer, &packet->paced);
+
+	/* Reads back captures from earlier frames, never this one */
+	FrameCapture_EndFrame(recorder->frameCapture, device);
+	if (recorder->checkpointWriter != NULL)
+	{
+		CheckpointWriter_EndFrame(recorder->checkpointWriter, device);
+	}
+	if (recorder->trajectoryExport != NULL)
+	{
+		TrajectoryExport_EndFrame(recorder->trajectoryExport, device);
+	}
+	recorder->presentedFrameCount += 1;
+
+	/* The CPU backend validates with its frame jobs */
+	if (options->validate && options->backend == SIMULATION_BACKEND_GPU)
+	{
+		TRACE_BEGIN(validateScope, "validate");
+		FrameRing_Drain(recorder->frameRing, device);
+		ParticleBuffers_Download(device, recorder->particleBuffers, recorder->particles);
+		if (recorder->particlePool != NULL)
+		{
+			ParticlePool_ReferenceApply(recorder->particlePool, &recorder->poolFrame, recorder->referenceParticles);
+		}
+		if (packet->reordered)
+		{
+			ParticleReorder_ReferenceApply(recorder->referenceParticles, recorder->particleCount, options->layout);
+		}
+
+		if (!CPUSim_ValidateSteps(
+			recorder->referenceParticles,
+			recorder->particles,
+			frameSlot->substepUniforms,
+			frameSlot->substepCount,
+			recorder->forceField,
+			recorder->particleMesh,
+			recorder->neighborGrid,
+			options->validateTolerance
+		)) {
+			recorder->validationFailed = true;
+		}
+		TRACE_END(validateScope);
+	}
+}
+
+/* Records each packet the simulation thread hands over and gives it back */
+static int FrameRecorder_ThreadMain(void *data)
+{
+	FrameRecorder *recorder = (FrameRecorder*) data;
+	FramePacket *packet;
+	uint64_t start;
+
+	Trace_SetThreadName("record");
+
+	for (;;)
+	{
+		start = Bench_Now();
+		packet = FramePacketQueue_Take(recorder->readyPackets);
+		recorder->waitSeconds += Bench_Seconds(start, Bench_Now());
+
+		if (packet->quit)
+		{
+			break;
+		}
+
+		start = Bench_Now();
+		TRACE_BEGIN(frameScope, "record frame");
+		RecordFrame(recorder, packet);
+		TRACE_END(frameScope);
+		recorder->recordSeconds += Bench_Seconds(start, Bench_Now());
+
+		FramePacketQueue_Put(recorder->freePackets, packet);
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	Options options;
+
+	if (!Options_Parse(&options, argc, argv))
+	{
+		return -1;
+	}
+
+	if (!options.seedSet)
+	{
+		options.seed = (uint32_t)time(NULL);
+	}
+
+	/* A restored run keeps the seed it started from, so everything else
+	 * seeded from it, like the force field's attractors, comes out the same
+	 */
+	Checkpoint *checkpoint = NULL;
+	CheckpointState checkpointState;
+
+	if (options.restorePath != NULL)
+	{
+		if ((checkpoint = Checkpoint_Open(options.restorePath)) == NULL)
+		{
+			return -1;
+		}
+		Checkpoint_GetState(checkpoint, &checkpointState);
+		options.seed = checkpointState.seed;
+	}
+
+	if (options.tracePath != NULL)
+	{
+		Trace_Start(options.traceEvents);
+		Trace_SetThreadName("main");
+	}
+
+	if (options.headless && options.backend == SIMULATION_BACKEND_CPU)
+	{
+		int result = Headless_RunCPU(&options);
+		FinishTrace(&options);
+		return result;
+	}
+
+	const uint32_t particleCount = options.particleCount;
+	BenchReport *benchReport = BenchReport_Create();
+	uint64_t phaseStart = Bench_Now();
+	uint64_t startupStart = phaseStart;
 
 	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_GAMECONTROLLER) < 0)
 	{
@@ -48,24 +733,42 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
+	/* With --jobs the frame's CPU work, texture loads and capture encoding
+	 * run as jobs
+	 */
+	JobSystem *jobSystem = (options.jobCount > 0) ? JobSystem_Create(options.jobCount) : NULL;
+
+	/* Textures load on a worker while shaders and pipelines are created */
+	const char *textureNames[] = { SPLAT_SPRITE_TEXTURE, SPLAT_RAMP_TEXTURE };
+	TextureLoader *textureLoader = TextureLoader_Start(options.textureBundlePath, textureNames, SDL_arraysize(textureNames), jobSystem);
+
 	const int windowWidth = 1280;
 	const int windowHeight = 720;
 
+#ifdef REFRESH_NULL
+	/* The null device (refresh_record.h) presents nothing and needs no Vulkan */
+	const Uint32 windowFlags = SDL_WINDOW_HIDDEN;
+#else
+	const Uint32 windowFlags = SDL_WINDOW_VULKAN | (options.headless ? SDL_WINDOW_HIDDEN : 0);
+#endif
+
 	SDL_Window *window = SDL_CreateWindow(
 		"Refresh Compute Test",
 		SDL_WINDOWPOS_UNDEFINED,
 		SDL_WINDOWPOS_UNDEFINED,
 		windowWidth,
 		windowHeight,
-		SDL_WINDOW_VULKAN
+		windowFlags
 	);
 
 	REFRESH_PresentationParameters presentationParameters;
 	presentationParameters.deviceWindowHandle = window;
-	presentationParameters.presentMode = REFRESH_PRESENTMODE_IMMEDIATE;
+	presentationParameters.presentMode = options.presentMode;
 
 	REFRESH_Device *device = REFRESH_CreateDevice(&presentationParameters, 1);
 
+	phaseStart = BenchReport_AddSince(benchReport, BENCH_PHASE_INIT, phaseStart);
+
 	bool quit = false;
 
 	double t = 0.0;
@@ -80,144 +783,318 @@ int main(int argc, char *argv[])
 	renderArea.w = windowWidth;
 	renderArea.h = windowHeight;
 
+	/* A setup step that fails jumps to cleanup, which releases whatever
+	 * exists by then, so everything it releases starts out NULL
+	 */
+	int result = -1;
+	bool validationFailed = false;
+	ThreadPool *threadPool = NULL;
+	Particle *particles = NULL;
+	ParticleBuffers *particleBuffers = NULL;
+	ParticlePool *particlePool = NULL;
+	ParticlePoolGPU *particlePoolGPU = NULL;
+	CPUSim *cpuSim = NULL;
+	Particle *referenceParticles = NULL;
+	NeighborGrid *neighborGrid = NULL;
+	NeighborGridGPU *neighborGridGPU = NULL;
+	ParticleMesh *particleMesh = NULL;
+	ParticleMeshGPU *particleMeshGPU = NULL;
+	ForceField *forceField = NULL;
+	ForceFieldGPU *forceFieldGPU = NULL;
+	ParticleReorder *particleReorder = NULL;
+	ParticleReorderGPU *particleReorderGPU = NULL;
+	REFRESH_RenderPass *mainRenderPass = NULL;
+	REFRESH_Texture *mainColorTargetTexture = NULL;
+	REFRESH_ColorTarget *mainColorTarget = NULL;
+	REFRESH_DepthStencilTarget *mainDepthStencilTarget = NULL;
+	REFRESH_Framebuffer *mainFramebuffer = NULL;
+	REFRESH_GraphicsPipeline *graphicsPipeline = NULL;
+	REFRESH_ShaderModule *splatResolveVertexShaderModule = NULL;
+	REFRESH_ShaderModule *splatResolveFragmentShaderModule = NULL;
+	REFRESH_GraphicsPipeline *splatResolvePipeline = NULL;
+	REFRESH_ComputePipeline *computePipeline = NULL;
+	REFRESH_Texture *particleTexture = NULL;
+	REFRESH_Texture *particleGradientTexture = NULL;
+	SplatGPU *splatGPU = NULL;
+
 	/* Compile shaders */
 
-	SDL_RWops* file = SDL_RWFromFile("particle.vert.spv", "rb");
-	Sint64 shaderCodeSize = SDL_RWsize(file);
-	uint32_t* byteCode = SDL_malloc(sizeof(uint32_t) * shaderCodeSize);
-	SDL_RWread(file, byteCode, sizeof(uint32_t), shaderCodeSize);
-	SDL_RWclose(file);
+	ShaderCache *shaderCache = ShaderCache_Create(options.shaderBundlePath, options.pipelineCachePath);
 
-	REFRESH_ShaderModuleCreateInfo particleVertexShaderModuleCreateInfo;
-	particleVertexShaderModuleCreateInfo.byteCode = byteCode;
-	particleVertexShaderModuleCreateInfo.codeSize = shaderCodeSize;
+	REFRESH_ShaderModule *particleVertexShaderModule = ShaderModule_Load(device, shaderCache, ParticleLayout_GetVertexShaderPath(options.layout));
+	REFRESH_ShaderModule *particleFragmentShaderModule = ShaderModule_Load(device, shaderCache, "particle.frag.spv");
+	const char *computeShaderBasePath = (options.substepMode == SUBSTEP_MODE_LOOP) ?
+		ParticleLayout_GetSubstepShaderPath(options.layout) :
+		ParticleLayout_GetComputeShaderPath(options.layout);
 
-	REFRESH_ShaderModule* particleVertexShaderModule = REFRESH_CreateShaderModule(device, &particleVertexShaderModuleCreateInfo);
+	/* The workgroup shape of the update, timed on the device unless one
+	 * was asked for or an earlier run already tuned this layout and count
+	 */
+	DispatchVariant dispatchVariant = options.dispatchVariant;
 
-	file = SDL_RWFromFile("particle.frag.spv", "rb");
-	shaderCodeSize = SDL_RWsize(file);
-	byteCode = SDL_realloc(byteCode, sizeof(uint32_t) * shaderCodeSize);
-	SDL_RWread(file, byteCode, sizeof(uint32_t), shaderCodeSize);
-	SDL_RWclose(file);
+	if (options.backend == SIMULATION_BACKEND_GPU && options.dispatchAutotune)
+	{
+		DispatchTuner_Select(
+			device,
+			shaderCache,
+			options.layout,
+			options.substepMode == SUBSTEP_MODE_LOOP,
+			particleCount,
+			options.seed,
+			options.dispatchTunePath,
+			&dispatchVariant
+		);
+	}
 
-	REFRESH_ShaderModuleCreateInfo particleFragmentShaderModuleCreateInfo;
-	particleFragmentShaderModuleCreateInfo.byteCode = byteCode;
-	particleFragmentShaderModuleCreateInfo.codeSize = shaderCodeSize;
+	char computeShaderPath[128];
+	DispatchVariant_GetShaderPath(&dispatchVariant, computeShaderBasePath, computeShaderPath, sizeof(computeShaderPath));
+	REFRESH_ShaderModule *particleComputeShaderModule = ShaderModule_Load(device, shaderCache, computeShaderPath);
 
-	REFRESH_ShaderModule* particleFragmentShaderModule = REFRESH_CreateShaderModule(device, &particleFragmentShaderModuleCreateInfo);
+	if (particleComputeShaderModule == NULL && SDL_strcmp(computeShaderPath, computeShaderBasePath) != 0)
+	{
+		SDL_Log("Falling back to the default workgroup shape");
+		dispatchVariant = DispatchVariant_GetDefault();
+		SDL_strlcpy(computeShaderPath, computeShaderBasePath, sizeof(computeShaderPath));
+		particleComputeShaderModule = ShaderModule_Load(device, shaderCache, computeShaderPath);
+	}
 
-	file = SDL_RWFromFile("particle.comp.spv", "rb");
-	shaderCodeSize = SDL_RWsize(file);
-	byteCode = SDL_realloc(byteCode, sizeof(uint32_t) * shaderCodeSize);
-	SDL_RWread(file, byteCode, sizeof(uint32_t), shaderCodeSize);
-	SDL_RWclose(file);
+	if (particleVertexShaderModule == NULL || particleFragmentShaderModule == NULL || particleComputeShaderModule == NULL)
+	{
+		goto cleanup;
+	}
 
-	REFRESH_ShaderModuleCreateInfo particleComputeShaderModuleCreateInfo;
-	particleComputeShaderModuleCreateInfo.byteCode = byteCode;
-	particleComputeShaderModuleCreateInfo.codeSize = shaderCodeSize;
+	phaseStart = BenchReport_AddSince(benchReport, BENCH_PHASE_SHADER_LOAD, phaseStart);
+
+	/* Define vertex buffer */
 
-	REFRESH_ShaderModule *particleComputeShaderModule = REFRESH_CreateShaderModule(device, &particleComputeShaderModuleCreateInfo);
+	threadPool = ThreadPool_Create(options.threadCount);
+	particles = SDL_malloc(sizeof(Particle) * particleCount);
+	particleBuffers = ParticleBuffers_Create(device, options.layout, particleCount);
+
+	/* With --emit particleCount is the pool capacity. The pool starts
+	 * empty, so there is nothing to initialize.
+	 */
+	ParticlePoolFrame poolFrame;
+
+	if (options.emitPerStep > 0)
+	{
+		particlePool = ParticlePool_Create(particleCount, options.emitPerStep, options.lifetime, options.seed, threadPool);
+		particlePoolGPU = ParticlePoolGPU_Create(device, shaderCache, particlePool, particleBuffers);
+	}
+
+	/* With --gpu-init the device writes the initial state itself, and a
+	 * restored state goes from the checkpoint's mapping straight to the
+	 * device. The host copy is still filled when something on the CPU
+	 * starts from it.
+	 */
+	bool deviceInit = (options.gpuInit && options.backend == SIMULATION_BACKEND_GPU) || checkpoint != NULL;
+
+	if (particlePool == NULL && (!deviceInit || options.validate || options.meshSweep || options.quantizeDriftSteps > 0))
+	{
+		if (checkpoint != NULL)
+		{
+			Checkpoint_GetParticles(checkpoint, particles);
+		}
+		else
+		{
+			Particle_InitializeArray(particles, particleCount, options.seed, threadPool);
+		}
+	}
+
+	if (particlePool != NULL)
+	{
+		if (particlePoolGPU == NULL)
+		{
+			goto cleanup;
+		}
+	}
+	else if (checkpoint != NULL)
+	{
+		bool restored = Checkpoint_Upload(checkpoint, device, particleBuffers);
+
+		Checkpoint_Close(checkpoint);
+		checkpoint = NULL;
+
+		if (!restored)
+		{
+			goto cleanup;
+		}
+
+		t = checkpointState.t;
+		accumulator = checkpointState.accumulator;
+		SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Restored %s at t = %.2f", options.restorePath, t);
+	}
+	else if (!deviceInit)
+	{
+		ParticleBuffers_Upload(device, particleBuffers, particles);
+	}
+	else if (!ParticleBuffers_InitializeOnDevice(device, shaderCache, particleBuffers, options.seed))
+	{
+		goto cleanup;
+	}
+
+	BenchReport_AddSince(benchReport, BENCH_PHASE_BUFFER_UPLOAD, phaseStart);
+
+	/* CPU simulation and validation */
+
+	if (options.backend == SIMULATION_BACKEND_CPU)
+	{
+		cpuSim = CPUSim_Create(particleCount, options.cpuKernel, threadPool);
+		CPUSim_SetParticles(cpuSim, particles);
+
+		SDL_LogInfo(
+			SDL_LOG_CATEGORY_APPLICATION,
+			"CPU backend: %s kernel, %u threads",
+			CPUSim_GetKernelName(CPUSim_GetKernel(cpuSim)),
+			ThreadPool_GetThreadCount(threadPool)
+		);
+	}
+
+	if (options.validate)
+	{
+		referenceParticles = SDL_malloc(sizeof(Particle) * particleCount);
+		SDL_memcpy(referenceParticles, particles, sizeof(Particle) * particleCount);
+	}
+
+	/* Short-range neighbor interaction */
+
+	if (options.neighbors)
+	{
+		neighborGrid = NeighborGrid_Create(particleCount, options.neighborRadius, options.neighborStrength, threadPool);
+
+		if (options.backend == SIMULATION_BACKEND_CPU)
+		{
+			CPUSim_SetNeighborGrid(cpuSim, neighborGrid);
+		}
+		else
+		{
+			neighborGridGPU = NeighborGridGPU_Create(device, shaderCache, neighborGrid, particleBuffers);
+			if (neighborGridGPU == NULL)
+			{
+				goto cleanup;
+			}
+		}
 
-	SDL_free(byteCode);
+		SDL_LogInfo(
+			SDL_LOG_CATEGORY_APPLICATION,
+			"Neighbor grid: radius %g, strength %g, %u cells",
+			NeighborGrid_GetRadius(neighborGrid),
+			options.neighborStrength,
+			NeighborGrid_GetCellCount(neighborGrid)
+		);
+	}
 
-	/* Load textures */
+	/* Long-range mesh gravity */
 
-	int32_t textureWidth, textureHeight, numChannels;
-	uint8_t *particleTexturePixels = REFRESH_Image_Load(
-		"particle01_rgba.png",
-		&textureWidth,
-		&textureHeight,
-		&numChannels
-	);
+	if (options.meshSweep)
+	{
+		ParticleMesh_LogSweep(
+			particles,
+			particleCount,
+			options.meshGravity,
+			options.meshSize,
+			PARTICLE_MESH_SWEEP_SAMPLES,
+			CPUSim_GetKernelWidth(options.cpuKernel),
+			threadPool
+		);
+	}
 
-	REFRESH_Texture *particleTexture = REFRESH_CreateTexture2D(
-		device,
-		REFRESH_COLORFORMAT_R8G8B8A8,
-		textureWidth,
-		textureHeight,
-		1,
-		REFRESH_TEXTUREUSAGE_SAMPLER_BIT
-	);
+	/* A pool starts empty, so there is nothing to drift */
+	if (options.quantizeDriftSteps > 0 && particlePool == NULL)
+	{
+		ParticleQuantize_LogDrift(particles, particleCount, options.quantizeDriftSteps, PARTICLE_QUANTIZE_DRIFT_SAMPLES, threadPool);
+	}
 
-	REFRESH_TextureSlice setTextureSlice;
-	setTextureSlice.texture = particleTexture;
-	setTextureSlice.rectangle.x = 0;
-	setTextureSlice.rectangle.y = 0;
-	setTextureSlice.rectangle.w = textureWidth;
-	setTextureSlice.rectangle.h = textureHeight;
-	setTextureSlice.depth = 0;
-	setTextureSlice.layer = 0;
-	setTextureSlice.level = 0;
-
-	REFRESH_SetTextureData(
-		device,
-		&setTextureSlice,
-		particleTexturePixels,
-		textureWidth * textureHeight * 4
-	);
+	if (options.mesh)
+	{
+		particleMesh = ParticleMesh_Create(
+			particleCount,
+			options.meshSize,
+			options.meshGravity,
+			CPUSim_GetKernelWidth(options.cpuKernel),
+			threadPool
+		);
+
+		if (options.backend == SIMULATION_BACKEND_CPU)
+		{
+			CPUSim_SetParticleMesh(cpuSim, particleMesh);
+		}
+		else
+		{
+			particleMeshGPU = ParticleMeshGPU_Create(device, shaderCache, particleMesh, particleBuffers);
+			if (particleMeshGPU == NULL)
+			{
+				goto cleanup;
+			}
+		}
 
-	REFRESH_Image_Free(particleTexturePixels);
+		SDL_LogInfo(
+			SDL_LOG_CATEGORY_APPLICATION,
+			"Particle mesh: %ux%u cells, gravity %g",
+			ParticleMesh_GetGridSize(particleMesh),
+			ParticleMesh_GetGridSize(particleMesh),
+			options.meshGravity
+		);
+	}
 
-	uint8_t *particleGradientTexturePixels = REFRESH_Image_Load(
-		"particle_gradient_rgba.png",
-		&textureWidth,
-		&textureHeight,
-		&numChannels
-	);
+	/* Fixed attractors and the field texture */
 
-	REFRESH_Texture *particleGradientTexture = REFRESH_CreateTexture2D(
-		device,
-		REFRESH_COLORFORMAT_R8G8B8A8,
-		textureWidth,
-		textureHeight,
-		1,
-		REFRESH_TEXTUREUSAGE_SAMPLER_BIT
-	);
+	if (options.fieldSweep)
+	{
+		ForceField_LogSweep(
+			particles,
+			particleCount,
+			options.fieldSize,
+			options.fieldAttractorCount,
+			options.fieldStrength,
+			options.seed,
+			FORCE_FIELD_SWEEP_SAMPLES,
+			CPUSim_GetKernelWidth(options.cpuKernel),
+			threadPool
+		);
+	}
 
-	setTextureSlice.texture = particleGradientTexture;
-	setTextureSlice.rectangle.x = 0;
-	setTextureSlice.rectangle.y = 0;
-	setTextureSlice.rectangle.w = textureWidth;
-	setTextureSlice.rectangle.h = textureHeight;
-	setTextureSlice.depth = 0;
-	setTextureSlice.layer = 0;
-	setTextureSlice.level = 0;
+	if (options.field)
+	{
+		forceField = Headless_CreateForceField(&options, CPUSim_GetKernelWidth(options.cpuKernel), threadPool);
 
-	REFRESH_SetTextureData(
-		device,
-		&setTextureSlice,
-		particleGradientTexturePixels,
-		textureWidth * textureHeight * 4
-	);
+		if (forceField != NULL && options.backend == SIMULATION_BACKEND_CPU)
+		{
+			CPUSim_SetForceField(cpuSim, forceField);
+		}
+		else if (forceField != NULL)
+		{
+			forceFieldGPU = ForceFieldGPU_Create(device, shaderCache, forceField, particleBuffers);
+		}
 
-	REFRESH_Image_Free(particleGradientTexturePixels);
+		if (forceField == NULL || (options.backend == SIMULATION_BACKEND_GPU && forceFieldGPU == NULL))
+		{
+			goto cleanup;
+		}
+	}
 
-	/* Define vertex buffer */
+	/* Periodic Morton sorting */
 
-	Particle *particles = SDL_malloc(sizeof(Particle) * PARTICLE_COUNT);
+	uint32_t stepsSinceReorder = options.reorderInterval; /* the first frame sorts */
+	bool reordered = false;
 
-	for (i = 0; i < PARTICLE_COUNT; i += 1)
+	if (options.reorderInterval > 0)
 	{
-		particles[i].xPosition = randomFloat(-1, 1);
-		particles[i].yPosition = randomFloat(-1, 1);
-		particles[i].xVelocity = 0;
-		particles[i].yVelocity = 1;
-		particles[i].gradientPosition = particles[i].xPosition / 2.0f;
-		particles[i].dummy1 = 0;
-		particles[i].dummy2 = 0;
-		particles[i].dummy3 = 0;
-	}
-
-	REFRESH_Buffer* particleBuffer = REFRESH_CreateBuffer(
-		device,
-		REFRESH_BUFFERUSAGE_VERTEX_BIT | REFRESH_BUFFERUSAGE_COMPUTE_BIT,
-		sizeof(Particle) * PARTICLE_COUNT
-	);
-
-	REFRESH_SetBufferData(device, particleBuffer, 0, particles, sizeof(Particle) * PARTICLE_COUNT);
+		if (options.backend == SIMULATION_BACKEND_CPU)
+		{
+			particleReorder = ParticleReorder_Create(particleCount, threadPool);
+		}
+		else
+		{
+			particleReorderGPU = ParticleReorderGPU_Create(device, shaderCache, particleBuffers);
+			if (particleReorderGPU == NULL)
+			{
+				goto cleanup;
+			}
+		}
 
-	uint64_t* offsets = SDL_malloc(sizeof(uint64_t));
-	offsets[0] = 0;
+		SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Morton reorder every %u steps", options.reorderInterval);
+	}
 
 	/* Define RenderPass */
 
@@ -239,11 +1116,11 @@ int main(int argc, char *argv[])
 	mainRenderPassCreateInfo.colorTargetDescriptions = &mainColorTargetDescription;
 	mainRenderPassCreateInfo.depthTargetDescription = &mainDepthStencilTargetDescription;
 
-	REFRESH_RenderPass *mainRenderPass = REFRESH_CreateRenderPass(device, &mainRenderPassCreateInfo);
+	mainRenderPass = REFRESH_CreateRenderPass(device, &mainRenderPassCreateInfo);
 
 	/* Define ColorTarget */
 
-	REFRESH_Texture *mainColorTargetTexture = REFRESH_CreateTexture2D(
+	mainColorTargetTexture = REFRESH_CreateTexture2D(
 		device,
 		REFRESH_COLORFORMAT_R8G8B8A8,
 		windowWidth,
@@ -262,13 +1139,13 @@ int main(int argc, char *argv[])
 	mainColorTargetTextureSlice.layer = 0;
 	mainColorTargetTextureSlice.level = 0;
 
-	REFRESH_ColorTarget *mainColorTarget = REFRESH_CreateColorTarget(
+	mainColorTarget = REFRESH_CreateColorTarget(
 		device,
 		REFRESH_SAMPLECOUNT_1,
 		&mainColorTargetTextureSlice
 	);
 
-	REFRESH_DepthStencilTarget *mainDepthStencilTarget = REFRESH_CreateDepthStencilTarget(
+	mainDepthStencilTarget = REFRESH_CreateDepthStencilTarget(
 		device,
 		windowWidth,
 		windowHeight,
@@ -285,7 +1162,7 @@ int main(int argc, char *argv[])
 	framebufferCreateInfo.pDepthStencilTarget = mainDepthStencilTarget;
 	framebufferCreateInfo.renderPass = mainRenderPass;
 
-	REFRESH_Framebuffer *mainFramebuffer = REFRESH_CreateFramebuffer(device, &framebufferCreateInfo);
+	mainFramebuffer = REFRESH_CreateFramebuffer(device, &framebufferCreateInfo);
 
 	/* Define pipeline */
 	REFRESH_ColorTargetBlendState renderTargetBlendState;
@@ -348,7 +1225,9 @@ int main(int argc, char *argv[])
 	REFRESH_ShaderStageState computeShaderStageState;
 	computeShaderStageState.shaderModule = particleComputeShaderModule;
 	computeShaderStageState.entryPointName = "main";
-	computeShaderStageState.uniformBufferSize = sizeof(ParticleComputeUniforms);
+	computeShaderStageState.uniformBufferSize = (options.substepMode == SUBSTEP_MODE_LOOP) ?
+		sizeof(ParticleSubstepUniforms) :
+		sizeof(ParticleComputeUniforms);
 
 	REFRESH_MultisampleState multisampleState;
 	multisampleState.multisampleCount = REFRESH_SAMPLECOUNT_1;
@@ -372,27 +1251,8 @@ int main(int argc, char *argv[])
 	REFRESH_TopologyState topologyState;
 	topologyState.topology = REFRESH_PRIMITIVETYPE_POINTLIST;
 
-	REFRESH_VertexBinding vertexBinding;
-	vertexBinding.binding = 0;
-	vertexBinding.inputRate = REFRESH_VERTEXINPUTRATE_VERTEX;
-	vertexBinding.stride = sizeof(Particle);
-
-	REFRESH_VertexAttribute *vertexAttributes = SDL_stack_alloc(REFRESH_VertexAttribute, 2);
-	vertexAttributes[0].binding = 0;
-	vertexAttributes[0].location = 0;
-	vertexAttributes[0].format = REFRESH_VERTEXELEMENTFORMAT_VECTOR2;
-	vertexAttributes[0].offset = 0;
-
-	vertexAttributes[1].binding = 0;
-	vertexAttributes[1].location = 1;
-	vertexAttributes[1].format = REFRESH_VERTEXELEMENTFORMAT_VECTOR4;
-	vertexAttributes[1].offset = sizeof(float) * 4;
-
-	REFRESH_VertexInputState vertexInputState;
-	vertexInputState.vertexBindings = &vertexBinding;
-	vertexInputState.vertexBindingCount = 1;
-	vertexInputState.vertexAttributes = vertexAttributes;
-	vertexInputState.vertexAttributeCount = 2;
+	ParticleVertexInput particleVertexInput;
+	ParticleBuffers_GetVertexInput(options.layout, &particleVertexInput);
 
 	REFRESH_Viewport viewport;
 	viewport.x = 0;
@@ -417,21 +1277,103 @@ int main(int argc, char *argv[])
 	graphicsPipelineCreateInfo.pipelineLayoutCreateInfo = pipelineLayoutCreateInfo;
 	graphicsPipelineCreateInfo.rasterizerState = rasterizerState;
 	graphicsPipelineCreateInfo.topologyState = topologyState;
-	graphicsPipelineCreateInfo.vertexInputState = vertexInputState;
+	graphicsPipelineCreateInfo.vertexInputState = particleVertexInput.state;
 	graphicsPipelineCreateInfo.viewportState = viewportState;
 	graphicsPipelineCreateInfo.renderPass = mainRenderPass;
 
-	REFRESH_GraphicsPipeline* graphicsPipeline = REFRESH_CreateGraphicsPipeline(device, &graphicsPipelineCreateInfo);
+	graphicsPipeline = ShaderCache_CreateGraphicsPipeline(shaderCache, device, &graphicsPipelineCreateInfo);
+
+	/* Splat rendering draws the compute-accumulated image as one unblended
+	 * point per pixel
+	 */
+	bool splat = (options.renderMode == RENDER_MODE_SPLAT);
+
+	if (splat)
+	{
+		splatResolveVertexShaderModule = ShaderModule_Load(device, shaderCache, "splat_resolve.vert.spv");
+		splatResolveFragmentShaderModule = ShaderModule_Load(device, shaderCache, "splat_resolve.frag.spv");
+	}
+
+	if (splatResolveVertexShaderModule != NULL && splatResolveFragmentShaderModule != NULL)
+	{
+		ParticleVertexInput splatVertexInput;
+		REFRESH_ColorTargetBlendState resolveBlendState = renderTargetBlendState;
+		REFRESH_GraphicsPipelineCreateInfo resolvePipelineCreateInfo = graphicsPipelineCreateInfo;
+
+		SplatGPU_GetVertexInput(&splatVertexInput);
+		resolveBlendState.blendEnable = 0;
+		resolvePipelineCreateInfo.colorBlendState.blendStates = &resolveBlendState;
+		resolvePipelineCreateInfo.vertexShaderState.shaderModule = splatResolveVertexShaderModule;
+		resolvePipelineCreateInfo.fragmentShaderState.shaderModule = splatResolveFragmentShaderModule;
+		resolvePipelineCreateInfo.pipelineLayoutCreateInfo.fragmentSamplerBindingCount = 0;
+		resolvePipelineCreateInfo.vertexInputState = splatVertexInput.state;
+
+		splatResolvePipeline = ShaderCache_CreateGraphicsPipeline(shaderCache, device, &resolvePipelineCreateInfo);
+	}
 
 	REFRESH_ComputePipelineLayoutCreateInfo computePipelineLayoutCreateInfo;
-	computePipelineLayoutCreateInfo.bufferBindingCount = 1;
+	computePipelineLayoutCreateInfo.bufferBindingCount = particleBuffers->bufferCount;
 	computePipelineLayoutCreateInfo.imageBindingCount = 0;
 
 	REFRESH_ComputePipelineCreateInfo computePipelineCreateInfo;
 	computePipelineCreateInfo.computeShaderState = computeShaderStageState;
 	computePipelineCreateInfo.pipelineLayoutCreateInfo = computePipelineLayoutCreateInfo;
 
-	REFRESH_ComputePipeline *computePipeline = REFRESH_CreateComputePipeline(device, &computePipelineCreateInfo);
+	computePipeline = ShaderCache_CreateComputePipeline(shaderCache, device, &computePipelineCreateInfo);
+
+	/* Upload textures */
+
+	uint64_t textureStart = Bench_Now();
+	REFRESH_Texture *loadedTextures[SDL_arraysize(textureNames)];
+
+	TextureLoader_Upload(textureLoader, device, loadedTextures);
+
+	particleTexture = loadedTextures[0];
+	particleGradientTexture = loadedTextures[1];
+
+	/* The splat passes take the sprite as a buffer and the ramp as uniforms,
+	 * and headless validation splats the same pixels on the CPU, so the
+	 * loader stays alive until the end
+	 */
+	SplatTexture splatSprite, splatRamp;
+
+	if (splat)
+	{
+		splatSprite.pixels = TextureLoader_GetPixels(textureLoader, 0, &splatSprite.width, &splatSprite.height);
+		splatRamp.pixels = TextureLoader_GetPixels(textureLoader, 1, &splatRamp.width, &splatRamp.height);
+
+		if (splatResolvePipeline != NULL && splatSprite.pixels != NULL && splatRamp.pixels != NULL)
+		{
+			splatGPU = SplatGPU_Create(device, shaderCache, particleBuffers, windowWidth, windowHeight, &splatSprite, &splatRamp);
+		}
+		if (splatGPU == NULL)
+		{
+			SDL_Log("Could not set up splat rendering");
+			goto cleanup;
+		}
+	}
+	else
+	{
+		TextureLoader_Destroy(textureLoader);
+		textureLoader = NULL;
+	}
+
+	BenchReport_AddSince(benchReport, BENCH_PHASE_TEXTURE_UPLOAD, textureStart);
+
+	/* Every pipeline, including the helper passes, and every texture exists
+	 * from here on
+	 */
+	ShaderCacheStats shaderCacheStats;
+	double startupSeconds = Bench_Seconds(startupStart, Bench_Now());
+
+	ShaderCache_FinishStartup(shaderCache, startupSeconds);
+	ShaderCache_GetStats(shaderCache, &shaderCacheStats);
+	ShaderCache_LogStats(shaderCache);
+	BenchReport_AddSample(
+		benchReport,
+		BENCH_PHASE_PIPELINE_CREATE,
+		shaderCacheStats.coldPipelineSeconds + shaderCacheStats.warmPipelineSeconds
+	);
 
 	REFRESH_Color clearColor;
 	clearColor.r = 0;
@@ -475,14 +1417,338 @@ int main(int argc, char *argv[])
 	sampleSamplers[1] = sampler;
 
 	uint8_t screenshotKey = 0;
-	uint8_t *screenshotPixels = SDL_malloc(sizeof(uint8_t) * windowWidth * windowHeight * 4);
-	REFRESH_Buffer *screenshotBuffer = REFRESH_CreateBuffer(device, 0, windowWidth * windowHeight * 4);
+	FrameCapture *frameCapture = NULL;
+
+	if (!options.headless)
+	{
+		frameCapture = FrameCapture_Create(device, windowWidth, windowHeight, options.captureLatency, jobSystem);
+	}
+
+	/* Each frame slot holds one uniform entry per fixed step taken since the last frame */
+	uint32_t substepCapacity = SDL_max(options.maxSubsteps, options.substeps);
+	FrameRing *frameRing = FrameRing_Create(options.framesInFlight, substepCapacity);
+	FrameSlot *frameSlot = NULL;
+	double frameWait;
+
+	/* The snapshot is read back once its frame has left the ring */
+	uint8_t checkpointKey = 0;
+	CheckpointWriter *checkpointWriter = NULL;
+
+	if (options.checkpointPath != NULL)
+	{
+		checkpointWriter = CheckpointWriter_Create(device, shaderCache, particleBuffers, FrameRing_GetFramesInFlight(frameRing));
+		if (checkpointWriter == NULL)
+		{
+			SDL_Log("Could not load the snapshot shader, no checkpoints will be written");
+		}
+	}
+
+	/* Exported frames are read back the same way, then encoded off this
+	 * thread
+	 */
+	TrajectoryExport *trajectoryExport = NULL;
+
+	if (options.exportPath != NULL)
+	{
+		trajectoryExport = TrajectoryExport_Create(
+			device,
+			shaderCache,
+			particleBuffers,
+			options.exportPath,
+			options.exportStep,
+			TRAJECTORY_DEFAULT_FRAMES_PER_CHUNK,
+			FrameRing_GetFramesInFlight(frameRing)
+		);
+		if (trajectoryExport == NULL)
+		{
+			SDL_Log("Could not start the trajectory export, no trajectory will be written");
+		}
+	}
+
+	/* The CPU backend rewrites the vertex data every frame, so each slot
+	 * draws from its own buffers. GPU-simulated particles are only touched
+	 * by the GPU, which already runs frames in order.
+	 */
+	ParticleBuffers *frameParticleBuffers[FRAME_RING_MAX_FRAMES];
+	uint32_t frameBufferIndex;
+
+	for (frameBufferIndex = 0; frameBufferIndex < FrameRing_GetFramesInFlight(frameRing); frameBufferIndex += 1)
+	{
+		if (options.backend == SIMULATION_BACKEND_CPU && frameBufferIndex > 0)
+		{
+			frameParticleBuffers[frameBufferIndex] = ParticleBuffers_Create(device, options.layout, particleCount);
+		}
+		else
+		{
+			frameParticleBuffers[frameBufferIndex] = particleBuffers;
+		}
+	}
+
+	/* Headless frames never wait for real */
+	FramePacer *framePacer = FramePacer_Create(options.paceMode, options.frameRate, options.headless);
+	FramePacerFrame pacedFrame;
+
+	if (options.headless)
+	{
+		/* Fixed-frame benchmark. Frames are pipelined through the frame ring,
+		 * so a simulate sample is the interval between consecutive submits.
+		 * Validation drains the ring every frame and is left out of the samples.
+		 */
+
+		uint32_t frame;
+		BenchInfo benchInfo;
+
+		phaseStart = Bench_Now();
+
+		for (frame = 0; frame < options.frameCount; frame += 1)
+		{
+			FramePacer_Wait(framePacer, 0, &pacedFrame);
+			frameSlot = FrameRing_BeginFrame(frameRing, device);
+
+			for (frameSlot->substepCount = 0; frameSlot->substepCount < options.substeps; frameSlot->substepCount += 1)
+			{
+				t += dt;
+				Particle_FillUniforms(&frameSlot->substepUniforms[frameSlot->substepCount], particleCount, t, dt);
+			}
+
+			TRACE_BEGIN(recordScope, "record commands");
+			REFRESH_CommandBuffer *commandBuffer = REFRESH_AcquireCommandBuffer(device, 0);
+			reordered = false;
+			if (particleReorderGPU != NULL && stepsSinceReorder >= options.reorderInterval)
+			{
+				ParticleReorderGPU_Record(device, commandBuffer, particleReorderGPU);
+				stepsSinceReorder = 0;
+				reordered = true;
+			}
+			stepsSinceReorder += frameSlot->substepCount;
+			if (particlePool != NULL)
+			{
+				BeginPoolFrame(particlePool, frameSlot, &poolFrame);
+				ParticlePoolGPU_Record(device, commandBuffer, particlePoolGPU, &poolFrame);
+			}
+			RecordParticleUpdate(device, commandBuffer, computePipeline, &dispatchVariant, particleBuffers, forceFieldGPU, particleMeshGPU, neighborGridGPU, options.substepMode, frameSlot->substepUniforms, frameSlot->substepCount);
+			if (splatGPU != NULL)
+			{
+				SplatGPU_Record(device, commandBuffer, splatGPU, (particlePool != NULL) ? ParticlePool_GetLiveCount(particlePool) : particleCount);
+			}
+			if (checkpointWriter != NULL &&
+				(options.checkpointInterval > 0 ? (frame + 1) % options.checkpointInterval == 0 : frame + 1 == options.frameCount))
+			{
+				RecordCheckpoint(checkpointWriter, device, commandBuffer, &options, t, accumulator);
+			}
+			if (trajectoryExport != NULL && frame % options.exportInterval == 0)
+			{
+				TrajectoryExport_Record(trajectoryExport, device, commandBuffer, frame, t);
+			}
+			TRACE_END(recordScope);
+			frameWait = FrameRing_Submit(frameRing, device, commandBuffer);
+			FramePacer_Submit(framePacer, &pacedFrame);
+			if (checkpointWriter != NULL)
+			{
+				CheckpointWriter_EndFrame(checkpointWriter, device);
+			}
+			if (trajectoryExport != NULL)
+			{
+				TrajectoryExport_EndFrame(trajectoryExport, device);
+			}
+
+			BenchReport_AddSample(benchReport, BENCH_PHASE_FRAME_WAIT, frameWait);
+			phaseStart = BenchReport_AddSince(benchReport, BENCH_PHASE_SIMULATE, phaseStart);
 
-	ParticleComputeUniforms particleComputeUniforms;
-	particleComputeUniforms.particleCount = PARTICLE_COUNT;
+			if (options.validate)
+			{
+				TRACE_BEGIN(validateScope, "validate");
+				FrameRing_Drain(frameRing, device);
+				ParticleBuffers_Download(device, particleBuffers, particles);
+				if (particlePool != NULL)
+				{
+					ParticlePool_ReferenceApply(particlePool, &poolFrame, referenceParticles);
+				}
+				if (reordered)
+				{
+					ParticleReorder_ReferenceApply(referenceParticles, particleCount, options.layout);
+				}
+				if (!CPUSim_ValidateSteps(referenceParticles, particles, frameSlot->substepUniforms, frameSlot->substepCount, forceField, particleMesh, neighborGrid, options.validateTolerance))
+				{
+					validationFailed = true;
+				}
+				TRACE_END(validateScope);
+				phaseStart = Bench_Now();
+			}
+		}
+
+		phaseStart = Bench_Now();
+		FrameRing_Drain(frameRing, device);
+		ParticleBuffers_Download(device, particleBuffers, particles);
+		BenchReport_AddSince(benchReport, BENCH_PHASE_READBACK, phaseStart);
+
+		if (particleReorderGPU != NULL)
+		{
+			ParticleReorder_LogLocality(particles, particleCount, options.layout);
+		}
+
+		if (splatGPU != NULL)
+		{
+			uint8_t *splatImage = SDL_malloc(sizeof(uint32_t) * SplatGPU_GetPixelCount(splatGPU));
+			uint32_t liveCount = (particlePool != NULL) ? ParticlePool_GetLiveCount(particlePool) : particleCount;
+
+			SplatGPU_Download(device, splatGPU, splatImage);
+			if (options.validate)
+			{
+				if (!Headless_ValidateSplat(splatImage, particles, liveCount, &splatSprite, &splatRamp, threadPool))
+				{
+					validationFailed = true;
+				}
+			}
+			Headless_FinishSplat(splatImage, windowWidth, windowHeight, &options);
+			SDL_free(splatImage);
+		}
+
+		benchInfo.backend = "gpu";
+		benchInfo.kernel = computeShaderPath;
+		benchInfo.layout = ParticleLayout_GetName(options.layout);
+		benchInfo.threadCount = 1;
+		benchInfo.particleCount = particleCount;
+		benchInfo.frameCount = options.frameCount;
+		benchInfo.substepCount = options.substeps;
+		benchInfo.framesInFlight = FrameRing_GetFramesInFlight(frameRing);
+		benchInfo.neighborRadius = (neighborGrid != NULL) ? NeighborGrid_GetRadius(neighborGrid) : 0.0f;
+		benchInfo.meshSize = (particleMesh != NULL) ? ParticleMesh_GetGridSize(particleMesh) : 0;
+		benchInfo.seed = options.seed;
+		benchInfo.startup = ShaderCache_GetStartupKind(shaderCache);
+		benchInfo.startupSeconds = startupSeconds;
+		benchInfo.coldStartupSeconds = shaderCacheStats.coldStartupSeconds;
+		benchInfo.checksum = Bench_Checksum(
+			particles,
+			sizeof(Particle) * ((particlePool != NULL) ? ParticlePool_GetLiveCount(particlePool) : particleCount)
+		);
+		Headless_SetPacing(&benchInfo, framePacer, &options);
+
+		Headless_FinishReport(benchReport, &benchInfo, &options);
+
+		quit = true;
+	}
+
+	/* The windowed loop. A frame's CPU work runs inline, or with --jobs as
+	 * jobs, while the record thread makes every Refresh call of the frames
+	 * before it.
+	 */
+	FrameSimulation frameSimulation;
+	frameSimulation.options = &options;
+	frameSimulation.particleCount = particleCount;
+	frameSimulation.cpuSim = cpuSim;
+	frameSimulation.particleReorder = particleReorder;
+	frameSimulation.frameParticleBuffers = frameParticleBuffers;
+	frameSimulation.referenceParticles = referenceParticles;
+	frameSimulation.forceField = forceField;
+	frameSimulation.particleMesh = particleMesh;
+	frameSimulation.neighborGrid = neighborGrid;
+	frameSimulation.readyPackets = NULL;
+	frameSimulation.validationFailed = false;
+
+	FrameRecorder frameRecorder;
+	SDL_zero(frameRecorder);
+	frameRecorder.device = device;
+	frameRecorder.options = &options;
+	frameRecorder.particleCount = particleCount;
+	frameRecorder.frameRing = frameRing;
+	frameRecorder.particleBuffers = particleBuffers;
+	frameRecorder.frameParticleBuffers = frameParticleBuffers;
+	frameRecorder.particles = particles;
+	frameRecorder.referenceParticles = referenceParticles;
+	frameRecorder.particlePool = particlePool;
+	frameRecorder.particlePoolGPU = particlePoolGPU;
+	frameRecorder.particleReorderGPU = particleReorderGPU;
+	frameRecorder.computePipeline = computePipeline;
+	frameRecorder.dispatchVariant = &dispatchVariant;
+	frameRecorder.forceFieldGPU = forceFieldGPU;
+	frameRecorder.particleMeshGPU = particleMeshGPU;
+	frameRecorder.neighborGridGPU = neighborGridGPU;
+	frameRecorder.forceField = forceField;
+	frameRecorder.particleMesh = particleMesh;
+	frameRecorder.neighborGrid = neighborGrid;
+	frameRecorder.checkpointWriter = checkpointWriter;
+	frameRecorder.trajectoryExport = trajectoryExport;
+	frameRecorder.frameCapture = frameCapture;
+	frameRecorder.splatGPU = splatGPU;
+	frameRecorder.splatResolvePipeline = splatResolvePipeline;
+	frameRecorder.graphicsPipeline = graphicsPipeline;
+	frameRecorder.renderPass = mainRenderPass;
+	frameRecorder.framebuffer = mainFramebuffer;
+	frameRecorder.renderArea = renderArea;
+	frameRecorder.clearColor = clearColor;
+	frameRecorder.depthStencilClear = depthStencilClear;
+	frameRecorder.colorTargetSlice = mainColorTargetTextureSlice;
+	frameRecorder.sampleTextures = sampleTextures;
+	frameRecorder.sampleSamplers = sampleSamplers;
+	frameRecorder.framePacer = framePacer;
+
+	/* On the record thread the upload of one packet's particles overlaps
+	 * the steps of the next, so each needs its own
+	 */
+	FramePacket framePackets[FRAME_RING_MAX_FRAMES];
+	uint32_t framePacketCount = FrameRing_GetFramesInFlight(frameRing);
+	uint32_t framePacketIndex;
+
+	for (framePacketIndex = 0; framePacketIndex < framePacketCount; framePacketIndex += 1)
+	{
+		FramePacket *framePacket = &framePackets[framePacketIndex];
+
+		SDL_zerop(framePacket);
+		framePacket->index = framePacketIndex;
+		framePacket->simulation = &frameSimulation;
+		framePacket->substepUniforms = SDL_malloc(sizeof(ParticleComputeUniforms) * substepCapacity);
+		framePacket->particles = (jobSystem != NULL && cpuSim != NULL) ?
+			SDL_malloc(sizeof(Particle) * particleCount) :
+			particles;
+	}
+
+	FramePacketQueue freePackets, readyPackets;
+	SDL_Thread *recordThread = NULL;
+	FramePacket *packet;
+	Job *previousTail = NULL;
+	Job *previousHand = NULL;
+	Job *handDependencies[2];
+
+	if (jobSystem != NULL && !quit)
+	{
+		FramePacketQueue_Create(&freePackets);
+		FramePacketQueue_Create(&readyPackets);
+
+		for (framePacketIndex = 0; framePacketIndex < framePacketCount; framePacketIndex += 1)
+		{
+			FramePacketQueue_Put(&freePackets, &framePackets[framePacketIndex]);
+		}
+
+		frameSimulation.readyPackets = &readyPackets;
+		frameRecorder.freePackets = &freePackets;
+		frameRecorder.readyPackets = &readyPackets;
+		recordThread = SDL_CreateThread(FrameRecorder_ThreadMain, "Record", &frameRecorder);
+
+		SDL_LogInfo(
+			SDL_LOG_CATEGORY_APPLICATION,
+			"Job system: %u workers, commands recorded on their own thread",
+			JobSystem_GetWorkerCount(jobSystem)
+		);
+		JobSystem_EndFrame(jobSystem);
+	}
+
+	framePacketIndex = 0;
 
 	while (!quit)
 	{
+		/* Sleeps instead of spinning until the next step is due, or until
+		 * the fixed or low-latency schedule says to start
+		 */
+		FramePacer_Wait(
+			framePacer,
+			currentTime + (uint64_t) SDL_ceil(SDL_max(dt - accumulator, 0.0) * SDL_GetPerformanceFrequency()),
+			&pacedFrame
+		);
+
+		TRACE_BEGIN(frameScope, "frame");
+
+		TRACE_BEGIN(pollScope, "poll events");
 		SDL_Event event;
 		while (SDL_PollEvent(&event))
 		{
@@ -493,6 +1759,7 @@ int main(int argc, char *argv[])
 				break;
 			}
 		}
+		TRACE_END(pollScope);
 
 		uint64_t newTime = SDL_GetPerformanceCounter();
 		double frameTime = (newTime - currentTime) / (double)SDL_GetPerformanceFrequency();
@@ -503,118 +1770,292 @@ int main(int argc, char *argv[])
 
 		accumulator += frameTime;
 
-		bool updateThisLoop = (accumulator >= dt);
-
-		while (accumulator >= dt && !quit)
+		if (accumulator >= dt && !quit)
 		{
-			// Update here!
-
-			t += dt;
-			accumulator -= dt;
+			/* Packets come back in the order they went out */
+			if (recordThread != NULL)
+			{
+				packet = FramePacketQueue_Take(&freePackets);
+			}
+			else
+			{
+				packet = &framePackets[framePacketIndex];
+				framePacketIndex = (framePacketIndex + 1) % framePacketCount;
+			}
 
-			const uint8_t *keyboardState = SDL_GetKeyboardState(NULL);
+			packet->startT = t;
+			packet->dt = dt;
+			packet->substepCount = 0;
+			packet->paced = pacedFrame;
 
-			if (keyboardState[SDL_SCANCODE_S])
+			TRACE_BEGIN(stepScope, "fixed steps");
+			while (accumulator >= dt)
 			{
-				if (screenshotKey == 1)
+				// Update here!
+
+				t += dt;
+				accumulator -= dt;
+				packet->substepCount += 1;
+
+				if (packet->substepCount == options.maxSubsteps)
+				{
+					/* Too far behind to catch up in one frame, drop the rest */
+					accumulator = 0.0;
+				}
+
+				const uint8_t *keyboardState = SDL_GetKeyboardState(NULL);
+
+				if (keyboardState[SDL_SCANCODE_S])
 				{
-					screenshotKey = 2;
+					if (screenshotKey == 1)
+					{
+						screenshotKey = 2;
+					}
+					else
+					{
+						screenshotKey = 1;
+					}
 				}
 				else
 				{
-					screenshotKey = 1;
+					screenshotKey = 0;
+				}
+
+				if (keyboardState[SDL_SCANCODE_C])
+				{
+					if (checkpointKey == 1)
+					{
+						checkpointKey = 2;
+					}
+					else
+					{
+						checkpointKey = 1;
+					}
+				}
+				else
+				{
+					checkpointKey = 0;
 				}
 			}
-			else
+			TRACE_END(stepScope);
+
+			packet->t = t;
+			packet->accumulator = accumulator;
+			packet->screenshot = (screenshotKey == 1);
+			packet->checkpoint = (checkpointKey == 1);
+
+			/* A frame's steps share one command buffer, so the sort waits
+			 * for the first frame after the interval has run out
+			 */
+			packet->reordered = options.reorderInterval > 0 && stepsSinceReorder >= options.reorderInterval;
+			if (packet->reordered)
 			{
-				screenshotKey = 0;
+				stepsSinceReorder = 0;
 			}
-		}
+			stepsSinceReorder += packet->substepCount;
 
-		if (updateThisLoop && !quit)
-		{
-			// Draw here!
-
-			particleComputeUniforms.deltaTime = (float)dt * 0.25f;
-			particleComputeUniforms.destinationX = (float)SDL_sin((t)) * 0.75f;
-			particleComputeUniforms.destinationY = 0.0f;
+			if (recordThread != NULL)
+			{
+				/* Hands are chained so packets reach the record thread in order */
+				handDependencies[0] = FramePacket_AddJobs(jobSystem, packet, previousTail);
+				handDependencies[1] = previousHand;
 
-			REFRESH_CommandBuffer *commandBuffer = REFRESH_AcquireCommandBuffer(device, 0);
+				JobSystem_Release(jobSystem, previousTail);
+				previousTail = handDependencies[0];
+				previousHand = JobSystem_Add(jobSystem, "hand to record thread", FramePacket_Hand, packet, handDependencies, 2);
+				JobSystem_Release(jobSystem, handDependencies[1]);
 
-			REFRESH_BindComputePipeline(device, commandBuffer, computePipeline);
-			REFRESH_BindComputeBuffers(device, commandBuffer, &particleBuffer);
-			uint32_t computeParamOffset = REFRESH_PushComputeShaderParams(device, commandBuffer, &particleComputeUniforms, 1);
-			REFRESH_DispatchCompute(device, commandBuffer, PARTICLE_COUNT / 256, 1, 1, computeParamOffset);
-
-			REFRESH_BeginRenderPass(
-				device,
-				commandBuffer,
-				mainRenderPass,
-				mainFramebuffer,
-				renderArea,
-				&clearColor,
-				1,
-				&depthStencilClear
-			);
+				JobSystem_EndFrame(jobSystem);
+			}
+			else
+			{
+				// Draw here!
 
-			REFRESH_BindGraphicsPipeline(
-				device,
-				commandBuffer,
-				graphicsPipeline
-			);
+				FramePacket_Simulate(packet);
+				RecordFrame(&frameRecorder, packet);
+			}
+		}
 
-			REFRESH_BindVertexBuffers(device, commandBuffer, 0, 1, &particleBuffer, offsets);
-			REFRESH_SetFragmentSamplers(device, commandBuffer, sampleTextures, sampleSamplers);
-			REFRESH_DrawPrimitives(device, commandBuffer, 0, PARTICLE_COUNT, 0, 0);
+		TRACE_END(frameScope);
+	}
 
-			REFRESH_EndRenderPass(device, commandBuffer);
+	if (recordThread != NULL)
+	{
+		/* Every handed frame is recorded before the packet that stops the
+		 * thread, and no job is left touching the simulation
+		 */
+		JobSystem_Wait(jobSystem, previousHand);
+		JobSystem_Wait(jobSystem, previousTail);
+
+		packet = FramePacketQueue_Take(&freePackets);
+		packet->quit = true;
+		FramePacketQueue_Put(&readyPackets, packet);
+		SDL_WaitThread(recordThread, NULL);
+
+		if (frameRecorder.presentedFrameCount > 0)
+		{
+			SDL_Log(
+				"Record thread: %u frames, %.2f ms recording and %.2f ms waiting for the simulation per frame",
+				frameRecorder.presentedFrameCount,
+				frameRecorder.recordSeconds * 1000.0 / frameRecorder.presentedFrameCount,
+				frameRecorder.waitSeconds * 1000.0 / frameRecorder.presentedFrameCount
+			);
+		}
 
-			if (screenshotKey == 1)
-			{
-				SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "screenshot!");
-				REFRESH_CopyTextureToBuffer(device, commandBuffer, &mainColorTargetTextureSlice, screenshotBuffer);
-			}
+		FramePacketQueue_Destroy(&freePackets);
+		FramePacketQueue_Destroy(&readyPackets);
+	}
 
-			REFRESH_QueuePresent(device, commandBuffer, &mainColorTargetTextureSlice, &renderArea, REFRESH_FILTER_NEAREST);
-			REFRESH_Submit(device, 1, &commandBuffer);
+	TrajectoryExport_Destroy(device, trajectoryExport);
+	CheckpointWriter_Destroy(device, checkpointWriter);
+	FrameCapture_Destroy(device, frameCapture);
+	FrameRing_Drain(frameRing, device);
+	FrameRing_LogStats(frameRing);
+	FramePacer_LogStats(framePacer);
+	FramePacer_Destroy(framePacer);
 
-			/* FIXME: sync */
-			if (screenshotKey == 1)
-			{
-				REFRESH_Wait(device);
-				REFRESH_GetBufferData(device, screenshotBuffer, screenshotPixels, windowWidth * windowHeight * 4);
-				REFRESH_Image_SavePNG("screenshot.png", windowWidth, windowHeight, screenshotPixels);
-			}
+	for (frameBufferIndex = 1; frameBufferIndex < FrameRing_GetFramesInFlight(frameRing); frameBufferIndex += 1)
+	{
+		if (frameParticleBuffers[frameBufferIndex] != particleBuffers)
+		{
+			ParticleBuffers_Destroy(device, frameParticleBuffers[frameBufferIndex]);
 		}
 	}
 
-	SDL_free(screenshotPixels);
+	FrameRing_Destroy(frameRing);
+	for (framePacketIndex = 0; framePacketIndex < framePacketCount; framePacketIndex += 1)
+	{
+		SDL_free(framePackets[framePacketIndex].substepUniforms);
+		if (framePackets[framePacketIndex].particles != particles)
+		{
+			SDL_free(framePackets[framePacketIndex].particles);
+		}
+	}
 
-	REFRESH_AddDisposeColorTarget(device, mainColorTarget);
-	REFRESH_AddDisposeDepthStencilTarget(device, mainDepthStencilTarget);
+	if (particleMesh != NULL && options.backend == SIMULATION_BACKEND_CPU)
+	{
+		ParticleMesh_LogTimings(particleMesh);
+	}
+	if (forceField != NULL && options.backend == SIMULATION_BACKEND_CPU)
+	{
+		ForceField_LogTimings(forceField);
+	}
+	if (particleReorder != NULL)
+	{
+		ParticleReorder_LogTimings(particleReorder);
+	}
+	if (particlePool != NULL)
+	{
+		ParticlePool_LogStats(particlePool);
+	}
+	if (jobSystem != NULL)
+	{
+		JobSystem_LogStats(jobSystem);
+	}
 
-	REFRESH_AddDisposeTexture(device, particleTexture);
-	REFRESH_AddDisposeTexture(device, particleGradientTexture);
-	REFRESH_AddDisposeTexture(device, mainColorTargetTexture);
 	REFRESH_AddDisposeSampler(device, sampler);
 
-	REFRESH_AddDisposeBuffer(device, screenshotBuffer);
-	REFRESH_AddDisposeBuffer(device, particleBuffer);
+	/* A --validate run on CI fails its job on any mismatch */
+	validationFailed = validationFailed || frameSimulation.validationFailed || frameRecorder.validationFailed;
+	result = validationFailed ? 1 : 0;
+
+cleanup:
+	SDL_free(referenceParticles);
+	SDL_free(particles);
+
+	Checkpoint_Close(checkpoint);
+	CPUSim_Destroy(cpuSim);
+	ParticleReorder_Destroy(particleReorder);
+	NeighborGrid_Destroy(neighborGrid);
+	ParticleMesh_Destroy(particleMesh);
+	ForceField_Destroy(forceField);
+	ParticlePool_Destroy(particlePool);
+	ThreadPool_Destroy(threadPool);
+	BenchReport_Destroy(benchReport);
+	TextureLoader_Destroy(textureLoader);
+	JobSystem_Destroy(jobSystem);
+
+	/* Setup may have stopped anywhere, and Refresh takes no NULL handles */
+	if (mainColorTarget != NULL)
+	{
+		REFRESH_AddDisposeColorTarget(device, mainColorTarget);
+	}
+	if (mainDepthStencilTarget != NULL)
+	{
+		REFRESH_AddDisposeDepthStencilTarget(device, mainDepthStencilTarget);
+	}
+
+	if (particleTexture != NULL)
+	{
+		REFRESH_AddDisposeTexture(device, particleTexture);
+	}
+	if (particleGradientTexture != NULL)
+	{
+		REFRESH_AddDisposeTexture(device, particleGradientTexture);
+	}
+	if (mainColorTargetTexture != NULL)
+	{
+		REFRESH_AddDisposeTexture(device, mainColorTargetTexture);
+	}
+
+	NeighborGridGPU_Destroy(device, neighborGridGPU);
+	ParticleMeshGPU_Destroy(device, particleMeshGPU);
+	ForceFieldGPU_Destroy(device, forceFieldGPU);
+	ParticleReorderGPU_Destroy(device, particleReorderGPU);
+	ParticlePoolGPU_Destroy(device, particlePoolGPU);
+	SplatGPU_Destroy(device, splatGPU);
+	ParticleBuffers_Destroy(device, particleBuffers);
 
-	REFRESH_AddDisposeGraphicsPipeline(device, graphicsPipeline);
-	REFRESH_AddDisposeComputePipeline(device, computePipeline);
+	if (graphicsPipeline != NULL)
+	{
+		REFRESH_AddDisposeGraphicsPipeline(device, graphicsPipeline);
+	}
+	if (computePipeline != NULL)
+	{
+		REFRESH_AddDisposeComputePipeline(device, computePipeline);
+	}
+	if (splatResolvePipeline != NULL)
+	{
+		REFRESH_AddDisposeGraphicsPipeline(device, splatResolvePipeline);
+	}
 
-	REFRESH_AddDisposeShaderModule(device, particleVertexShaderModule);
-	REFRESH_AddDisposeShaderModule(device, particleFragmentShaderModule);
-	REFRESH_AddDisposeShaderModule(device, particleComputeShaderModule);
+	if (splatResolveVertexShaderModule != NULL)
+	{
+		REFRESH_AddDisposeShaderModule(device, splatResolveVertexShaderModule);
+	}
+	if (splatResolveFragmentShaderModule != NULL)
+	{
+		REFRESH_AddDisposeShaderModule(device, splatResolveFragmentShaderModule);
+	}
+	if (particleVertexShaderModule != NULL)
+	{
+		REFRESH_AddDisposeShaderModule(device, particleVertexShaderModule);
+	}
+	if (particleFragmentShaderModule != NULL)
+	{
+		REFRESH_AddDisposeShaderModule(device, particleFragmentShaderModule);
+	}
+	if (particleComputeShaderModule != NULL)
+	{
+		REFRESH_AddDisposeShaderModule(device, particleComputeShaderModule);
+	}
+	ShaderCache_Destroy(shaderCache);
 
-	REFRESH_AddDisposeFramebuffer(device, mainFramebuffer);
-	REFRESH_AddDisposeRenderPass(device, mainRenderPass);
+	if (mainFramebuffer != NULL)
+	{
+		REFRESH_AddDisposeFramebuffer(device, mainFramebuffer);
+	}
+	if (mainRenderPass != NULL)
+	{
+		REFRESH_AddDisposeRenderPass(device, mainRenderPass);
+	}
 
 	REFRESH_DestroyDevice(device);
 
 	SDL_DestroyWindow(window);
 	SDL_Quit();
 
-	return 0;
+	FinishTrace(&options);
+
+	return result;
 }
@@ -0,0 +1,407 @@
+#include "neighbor_grid.h"
+
+#include <SDL.h>
+
+#define NEIGHBOR_GRID_GRAIN_SIZE 256
+
+/* Cells per prefix sum block; each block is summed and written by one task */
+#define NEIGHBOR_GRID_SCAN_BLOCK 4096
+
+struct NeighborGrid
+{
+	ThreadPool *pool;
+	uint32_t capacity;
+
+	float radius;
+	float strength;
+	uint32_t gridWidth;
+	uint32_t gridHeight;
+	uint32_t cellCount;
+	float invCellSize;
+
+	SDL_atomic_t *cellCounts; /* [cellCount] */
+	uint32_t *cellStart;      /* [cellCount + 1], the last entry is the total */
+	uint32_t *blockSums;
+	uint32_t blockCount;
+
+	uint32_t *particleCell;
+	uint32_t *particleRank; /* position within its cell, from the counting pass */
+
+	/* Positions in cell order, and where each one came from */
+	float *sortedX;
+	float *sortedY;
+	uint32_t *sortedIndex;
+};
+
+typedef struct NeighborGridContext
+{
+	NeighborGrid *grid;
+	const float *xPosition;
+	const float *yPosition;
+	float *xVelocity;
+	float *yVelocity;
+	float deltaTime;
+} NeighborGridContext;
+
+/* Shared by every path */
+
+static uint32_t NeighborGrid_CellCoordinate(float position, float invCellSize, uint32_t size)
+{
+	float scaled = (position + 1.0f) * invCellSize;
+	scaled = SDL_max(SDL_min(scaled, (float) (size - 1)), 0.0f);
+	return (uint32_t) scaled;
+}
+
+static uint32_t NeighborGrid_CellIndex(const NeighborGrid *grid, float x, float y)
+{
+	uint32_t cellX = NeighborGrid_CellCoordinate(x, grid->invCellSize, grid->gridWidth);
+	uint32_t cellY = NeighborGrid_CellCoordinate(y, grid->invCellSize, grid->gridHeight);
+	return cellY * grid->gridWidth + cellX;
+}
+
+/* Sums the fixed point push from every neighbor in the 3x3 cells around (x, y) */
+static void NeighborGrid_Gather(
+	const NeighborGrid *grid,
+	const uint32_t *cellStart,
+	const float *sortedX,
+	const float *sortedY,
+	float x,
+	float y,
+	int32_t *impulseX,
+	int32_t *impulseY
+) {
+	uint32_t cellX = NeighborGrid_CellCoordinate(x, grid->invCellSize, grid->gridWidth);
+	uint32_t cellY = NeighborGrid_CellCoordinate(y, grid->invCellSize, grid->gridHeight);
+	uint32_t minX = (cellX > 0) ? cellX - 1 : 0;
+	uint32_t minY = (cellY > 0) ? cellY - 1 : 0;
+	uint32_t maxX = SDL_min(cellX + 1, grid->gridWidth - 1);
+	uint32_t maxY = SDL_min(cellY + 1, grid->gridHeight - 1);
+	float radius2 = grid->radius * grid->radius;
+	float invRadius = 1.0f / grid->radius;
+	float scaledStrength = grid->strength * NEIGHBOR_GRID_FIXED_SCALE;
+	uint32_t neighborX, neighborY, cell, k;
+	int32_t sumX = 0;
+	int32_t sumY = 0;
+
+	for (neighborY = minY; neighborY <= maxY; neighborY += 1)
+	{
+		for (neighborX = minX; neighborX <= maxX; neighborX += 1)
+		{
+			cell = neighborY * grid->gridWidth + neighborX;
+
+			for (k = cellStart[cell]; k < cellStart[cell + 1]; k += 1)
+			{
+				float deltaX = x - sortedX[k];
+				float deltaY = y - sortedY[k];
+				float distance2 = deltaX * deltaX + deltaY * deltaY;
+
+				/* Skips the particle itself along with anything out of range */
+				if (distance2 > 0.0f && distance2 < radius2)
+				{
+					float distance = SDL_sqrtf(distance2);
+					float weight = (1.0f - distance * invRadius) / distance * scaledStrength;
+					sumX += (int32_t) (deltaX * weight);
+					sumY += (int32_t) (deltaY * weight);
+				}
+			}
+		}
+	}
+
+	*impulseX = sumX;
+	*impulseY = sumY;
+}
+
+static float NeighborGrid_VelocityChange(int32_t impulse, float deltaTime)
+{
+	return (float) impulse * (1.0f / NEIGHBOR_GRID_FIXED_SCALE) * deltaTime;
+}
+
+/* Creation */
+
+NeighborGrid* NeighborGrid_Create(uint32_t particleCount, float radius, float strength, ThreadPool *pool)
+{
+	NeighborGrid *grid = SDL_malloc(sizeof(NeighborGrid));
+
+	grid->pool = pool;
+	grid->capacity = particleCount;
+	grid->strength = strength;
+
+	/* Spread uniformly over the area-4 square, pi * r^2 * N / 4 neighbors */
+	if (radius <= 0.0f)
+	{
+		radius = SDL_sqrtf(4.0f * NEIGHBOR_GRID_AUTO_NEIGHBORS / (3.14159265f * SDL_max(particleCount, 1)));
+	}
+	grid->radius = radius;
+
+	/* Cells are at least one radius wide so 3x3 cells cover every neighbor */
+	grid->gridWidth = (uint32_t) SDL_max(SDL_min(2.0f / radius, (float) NEIGHBOR_GRID_MAX_DIMENSION), 1.0f);
+	grid->gridHeight = grid->gridWidth;
+	grid->cellCount = grid->gridWidth * grid->gridHeight;
+	grid->invCellSize = grid->gridWidth / 2.0f;
+
+	grid->blockCount = (grid->cellCount + NEIGHBOR_GRID_SCAN_BLOCK - 1) / NEIGHBOR_GRID_SCAN_BLOCK;
+	grid->cellCounts = SDL_malloc(sizeof(SDL_atomic_t) * grid->cellCount);
+	grid->cellStart = SDL_malloc(sizeof(uint32_t) * (grid->cellCount + 1));
+	grid->blockSums = SDL_malloc(sizeof(uint32_t) * grid->blockCount);
+
+	grid->particleCell = SDL_malloc(sizeof(uint32_t) * particleCount);
+	grid->particleRank = SDL_malloc(sizeof(uint32_t) * particleCount);
+	grid->sortedX = SDL_malloc(sizeof(float) * particleCount);
+	grid->sortedY = SDL_malloc(sizeof(float) * particleCount);
+	grid->sortedIndex = SDL_malloc(sizeof(uint32_t) * particleCount);
+
+	return grid;
+}
+
+void NeighborGrid_Destroy(NeighborGrid *grid)
+{
+	if (grid == NULL)
+	{
+		return;
+	}
+
+	SDL_free(grid->cellCounts);
+	SDL_free(grid->cellStart);
+	SDL_free(grid->blockSums);
+	SDL_free(grid->particleCell);
+	SDL_free(grid->particleRank);
+	SDL_free(grid->sortedX);
+	SDL_free(grid->sortedY);
+	SDL_free(grid->sortedIndex);
+	SDL_free(grid);
+}
+
+float NeighborGrid_GetRadius(NeighborGrid *grid)
+{
+	return grid->radius;
+}
+
+uint32_t NeighborGrid_GetCellCount(NeighborGrid *grid)
+{
+	return grid->cellCount;
+}
+
+void NeighborGrid_FillUniforms(
+	NeighborGrid *grid,
+	NeighborGridUniforms *uniforms,
+	uint32_t particleCount,
+	float deltaTime
+) {
+	uniforms->deltaTime = deltaTime;
+	uniforms->radius = grid->radius;
+	uniforms->strength = grid->strength;
+	uniforms->particleCount = particleCount;
+	uniforms->gridWidth = grid->gridWidth;
+	uniforms->gridHeight = grid->gridHeight;
+	uniforms->cellCount = grid->cellCount;
+	uniforms->invCellSize = grid->invCellSize;
+}
+
+/* Threaded passes, one ThreadPool_ParallelFor each, mirroring neighbor_grid.comp */
+
+static void NeighborGrid_ParallelFor(NeighborGrid *grid, uint32_t count, uint32_t grainSize, ThreadPoolRangeFunc func, void *userdata)
+{
+	if (grid->pool == NULL)
+	{
+		func(userdata, 0, count);
+	}
+	else
+	{
+		ThreadPool_ParallelFor(grid->pool, count, grainSize, func, userdata);
+	}
+}
+
+static void NeighborGrid_CountRange(void *userdata, uint32_t start, uint32_t end)
+{
+	NeighborGridContext *context = (NeighborGridContext*) userdata;
+	NeighborGrid *grid = context->grid;
+	uint32_t i, cell;
+
+	for (i = start; i < end; i += 1)
+	{
+		cell = NeighborGrid_CellIndex(grid, context->xPosition[i], context->yPosition[i]);
+		grid->particleCell[i] = cell;
+		grid->particleRank[i] = (uint32_t) SDL_AtomicAdd(&grid->cellCounts[cell], 1);
+	}
+}
+
+static void NeighborGrid_SumBlocks(void *userdata, uint32_t start, uint32_t end)
+{
+	NeighborGrid *grid = ((NeighborGridContext*) userdata)->grid;
+	uint32_t block, cell, cellEnd, sum;
+
+	for (block = start; block < end; block += 1)
+	{
+		sum = 0;
+		cellEnd = SDL_min((block + 1) * NEIGHBOR_GRID_SCAN_BLOCK, grid->cellCount);
+
+		for (cell = block * NEIGHBOR_GRID_SCAN_BLOCK; cell < cellEnd; cell += 1)
+		{
+			sum += (uint32_t) SDL_AtomicGet(&grid->cellCounts[cell]);
+		}
+
+		grid->blockSums[block] = sum;
+	}
+}
+
+static void NeighborGrid_ScanBlocks(void *userdata, uint32_t start, uint32_t end)
+{
+	NeighborGrid *grid = ((NeighborGridContext*) userdata)->grid;
+	uint32_t block, cell, cellEnd, running;
+
+	for (block = start; block < end; block += 1)
+	{
+		running = grid->blockSums[block];
+		cellEnd = SDL_min((block + 1) * NEIGHBOR_GRID_SCAN_BLOCK, grid->cellCount);
+
+		for (cell = block * NEIGHBOR_GRID_SCAN_BLOCK; cell < cellEnd; cell += 1)
+		{
+			grid->cellStart[cell] = running;
+			running += (uint32_t) SDL_AtomicGet(&grid->cellCounts[cell]);
+		}
+	}
+}
+
+static void NeighborGrid_ScatterRange(void *userdata, uint32_t start, uint32_t end)
+{
+	NeighborGridContext *context = (NeighborGridContext*) userdata;
+	NeighborGrid *grid = context->grid;
+	uint32_t i, slot;
+
+	for (i = start; i < end; i += 1)
+	{
+		slot = grid->cellStart[grid->particleCell[i]] + grid->particleRank[i];
+		grid->sortedX[slot] = context->xPosition[i];
+		grid->sortedY[slot] = context->yPosition[i];
+		grid->sortedIndex[slot] = i;
+	}
+}
+
+/* Runs in cell order so neighboring slots read neighboring memory */
+static void NeighborGrid_SeparateRange(void *userdata, uint32_t start, uint32_t end)
+{
+	NeighborGridContext *context = (NeighborGridContext*) userdata;
+	NeighborGrid *grid = context->grid;
+	uint32_t slot, index;
+	int32_t impulseX, impulseY;
+
+	for (slot = start; slot < end; slot += 1)
+	{
+		NeighborGrid_Gather(
+			grid,
+			grid->cellStart,
+			grid->sortedX,
+			grid->sortedY,
+			grid->sortedX[slot],
+			grid->sortedY[slot],
+			&impulseX,
+			&impulseY
+		);
+
+		index = grid->sortedIndex[slot];
+		context->xVelocity[index] += NeighborGrid_VelocityChange(impulseX, context->deltaTime);
+		context->yVelocity[index] += NeighborGrid_VelocityChange(impulseY, context->deltaTime);
+	}
+}
+
+void NeighborGrid_Apply(
+	NeighborGrid *grid,
+	const float *xPosition,
+	const float *yPosition,
+	float *xVelocity,
+	float *yVelocity,
+	uint32_t count,
+	float deltaTime
+) {
+	NeighborGridContext context;
+	uint32_t block, sum, blockSum;
+
+	count = SDL_min(count, grid->capacity);
+
+	context.grid = grid;
+	context.xPosition = xPosition;
+	context.yPosition = yPosition;
+	context.xVelocity = xVelocity;
+	context.yVelocity = yVelocity;
+	context.deltaTime = deltaTime;
+
+	SDL_memset(grid->cellCounts, 0, sizeof(SDL_atomic_t) * grid->cellCount);
+	NeighborGrid_ParallelFor(grid, count, NEIGHBOR_GRID_GRAIN_SIZE, NeighborGrid_CountRange, &context);
+
+	/* Exclusive prefix sum: block totals in parallel, the few block offsets
+	 * serially, then every block's cells in parallel.
+	 */
+	NeighborGrid_ParallelFor(grid, grid->blockCount, 1, NeighborGrid_SumBlocks, &context);
+
+	sum = 0;
+	for (block = 0; block < grid->blockCount; block += 1)
+	{
+		blockSum = grid->blockSums[block];
+		grid->blockSums[block] = sum;
+		sum += blockSum;
+	}
+	grid->cellStart[grid->cellCount] = sum;
+
+	NeighborGrid_ParallelFor(grid, grid->blockCount, 1, NeighborGrid_ScanBlocks, &context);
+
+	NeighborGrid_ParallelFor(grid, count, NEIGHBOR_GRID_GRAIN_SIZE, NeighborGrid_ScatterRange, &context);
+	NeighborGrid_ParallelFor(grid, count, NEIGHBOR_GRID_GRAIN_SIZE, NeighborGrid_SeparateRange, &context);
+}
+
+/* Reference: a plain serial counting sort, visiting particles in index order */
+
+void NeighborGrid_ReferenceApply(NeighborGrid *grid, Particle *particles, uint32_t count, float deltaTime)
+{
+	uint32_t i, cell, slot;
+	int32_t impulseX, impulseY;
+	uint32_t *cellStart = SDL_calloc(grid->cellCount + 1, sizeof(uint32_t));
+	uint32_t *cursor = SDL_malloc(sizeof(uint32_t) * grid->cellCount);
+	uint32_t *particleCell = SDL_malloc(sizeof(uint32_t) * count);
+	float *sortedX = SDL_malloc(sizeof(float) * count);
+	float *sortedY = SDL_malloc(sizeof(float) * count);
+
+	for (i = 0; i < count; i += 1)
+	{
+		cell = NeighborGrid_CellIndex(grid, particles[i].xPosition, particles[i].yPosition);
+		particleCell[i] = cell;
+		cellStart[cell + 1] += 1;
+	}
+
+	for (cell = 0; cell < grid->cellCount; cell += 1)
+	{
+		cellStart[cell + 1] += cellStart[cell];
+	}
+
+	SDL_memcpy(cursor, cellStart, sizeof(uint32_t) * grid->cellCount);
+
+	for (i = 0; i < count; i += 1)
+	{
+		slot = cursor[particleCell[i]];
+		cursor[particleCell[i]] += 1;
+		sortedX[slot] = particles[i].xPosition;
+		sortedY[slot] = particles[i].yPosition;
+	}
+
+	for (i = 0; i < count; i += 1)
+	{
+		NeighborGrid_Gather(
+			grid,
+			cellStart,
+			sortedX,
+			sortedY,
+			particles[i].xPosition,
+			particles[i].yPosition,
+			&impulseX,
+			&impulseY
+		);
+
+		particles[i].xVelocity += NeighborGrid_VelocityChange(impulseX, deltaTime);
+		particles[i].yVelocity += NeighborGrid_VelocityChange(impulseY, deltaTime);
+	}
+
+	SDL_free(cellStart);
+	SDL_free(cursor);
+	SDL_free(particleCell);
+	SDL_free(sortedX);
+	SDL_free(sortedY);
+}
@@ -0,0 +1,82 @@
+#ifndef NEIGHBOR_GRID_H
+#define NEIGHBOR_GRID_H
+
+#include <stdint.h>
+
+#include "particle.h"
+#include "thread_pool.h"
+
+/* Short-range particle separation on a uniform grid.
+ *
+ * Every step bins the particles into square cells at least one interaction
+ * radius wide (a counting sort: per-cell counts, an exclusive prefix sum
+ * into cell ranges, then a scatter), and each particle then only visits
+ * the 3x3 cells around its own. Cost stays near-linear in particle count.
+ *
+ * Each neighbor closer than the radius pushes the particle away, linearly
+ * weaker towards the edge of the radius. The pushes are rounded to
+ * NEIGHBOR_GRID_FIXED_SCALE fixed point and summed as integers, so the
+ * total does not depend on the order neighbors are visited in. The
+ * threaded CPU path and the reference therefore match bit for bit however
+ * the work is split. neighbor_grid.comp uses the same formula and differs
+ * from them only by GPU float rounding.
+ */
+
+#define NEIGHBOR_GRID_FIXED_SCALE 65536.0f
+
+/* Neighbors within the radius a particle sees on average when
+ * NeighborGrid_Create picks the radius itself
+ */
+#define NEIGHBOR_GRID_AUTO_NEIGHBORS 8.0f
+
+/* Caps the cell count at 1024x1024 */
+#define NEIGHBOR_GRID_MAX_DIMENSION 1024
+
+/* Matches the UBO block in neighbor_grid.comp */
+typedef struct NeighborGridUniforms
+{
+	float deltaTime;
+	float radius;
+	float strength;
+	uint32_t particleCount;
+	uint32_t gridWidth;
+	uint32_t gridHeight;
+	uint32_t cellCount;
+	float invCellSize;
+} NeighborGridUniforms;
+
+typedef struct NeighborGrid NeighborGrid;
+
+/* Covers the [-1, 1] simulation square. A radius of 0 is sized from the
+ * particle count so the pair count stays linear. pool may be NULL.
+ */
+NeighborGrid* NeighborGrid_Create(uint32_t particleCount, float radius, float strength, ThreadPool *pool);
+void NeighborGrid_Destroy(NeighborGrid *grid);
+
+float NeighborGrid_GetRadius(NeighborGrid *grid);
+uint32_t NeighborGrid_GetCellCount(NeighborGrid *grid);
+
+void NeighborGrid_FillUniforms(
+	NeighborGrid *grid,
+	NeighborGridUniforms *uniforms,
+	uint32_t particleCount,
+	float deltaTime
+);
+
+/* Bins the particles and adds the separation impulse to their velocities */
+void NeighborGrid_Apply(
+	NeighborGrid *grid,
+	const float *xPosition,
+	const float *yPosition,
+	float *xVelocity,
+	float *yVelocity,
+	uint32_t count,
+	float deltaTime
+);
+
+/* Single-threaded version on the GPU layout, run before CPUSim_ReferenceStep
+ * when validating.
+ */
+void NeighborGrid_ReferenceApply(NeighborGrid *grid, Particle *particles, uint32_t count, float deltaTime);
+
+#endif /* NEIGHBOR_GRID_H */
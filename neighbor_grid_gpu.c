@@ -0,0 +1,176 @@
+#include "neighbor_grid_gpu.h"
+
+#include <stdbool.h>
+
+#include <SDL.h>
+
+#include "compute_pass.h"
+
+typedef enum NeighborGridPassType
+{
+	NEIGHBOR_GRID_PASS_CLEAR,
+	NEIGHBOR_GRID_PASS_COUNT,
+	NEIGHBOR_GRID_PASS_SCAN,
+	NEIGHBOR_GRID_PASS_SCATTER,
+	NEIGHBOR_GRID_PASS_SEPARATE,
+	NEIGHBOR_GRID_PASS_TYPE_COUNT
+} NeighborGridPassType;
+
+struct NeighborGridGPU
+{
+	NeighborGrid *grid;
+
+	REFRESH_Buffer *cellStart;
+	REFRESH_Buffer *particleCell;
+	REFRESH_Buffer *particleRank;
+	REFRESH_Buffer *sortedPositions;
+	REFRESH_Buffer *sortedIndex;
+
+	ComputePass passes[NEIGHBOR_GRID_PASS_TYPE_COUNT];
+};
+
+static const char* NeighborGridGPU_GetShaderPath(NeighborGridPassType type, ParticleLayout layout)
+{
+	bool split = (layout == PARTICLE_LAYOUT_SPLIT);
+
+	switch (type)
+	{
+	case NEIGHBOR_GRID_PASS_CLEAR:
+		return "neighbor_clear.comp.spv";
+	case NEIGHBOR_GRID_PASS_COUNT:
+		return split ? "neighbor_split_count.comp.spv" : "neighbor_count.comp.spv";
+	case NEIGHBOR_GRID_PASS_SCAN:
+		return "neighbor_scan.comp.spv";
+	case NEIGHBOR_GRID_PASS_SCATTER:
+		return split ? "neighbor_split_scatter.comp.spv" : "neighbor_scatter.comp.spv";
+	case NEIGHBOR_GRID_PASS_SEPARATE:
+		return split ? "neighbor_split_separate.comp.spv" : "neighbor_separate.comp.spv";
+	default:
+		return NULL;
+	}
+}
+
+NeighborGridGPU* NeighborGridGPU_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	NeighborGrid *grid,
+	ParticleBuffers *particleBuffers
+) {
+	uint32_t i;
+	uint32_t particleCount = particleBuffers->particleCount;
+	NeighborGridGPU *neighborGridGPU = SDL_malloc(sizeof(NeighborGridGPU));
+
+	SDL_zerop(neighborGridGPU);
+	neighborGridGPU->grid = grid;
+
+	neighborGridGPU->cellStart = REFRESH_CreateBuffer(
+		device,
+		REFRESH_BUFFERUSAGE_COMPUTE_BIT,
+		sizeof(uint32_t) * (NeighborGrid_GetCellCount(grid) + 1)
+	);
+	neighborGridGPU->particleCell = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, sizeof(uint32_t) * particleCount);
+	neighborGridGPU->particleRank = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, sizeof(uint32_t) * particleCount);
+	neighborGridGPU->sortedPositions = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, sizeof(float) * 2 * particleCount);
+	neighborGridGPU->sortedIndex = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, sizeof(uint32_t) * particleCount);
+
+	/* Both layouts keep positions in buffers[0]; velocities are in the
+	 * Particle struct or in their own stream.
+	 */
+	REFRESH_Buffer *positions = particleBuffers->buffers[0];
+	REFRESH_Buffer *velocities = (particleBuffers->layout == PARTICLE_LAYOUT_SPLIT) ?
+		particleBuffers->buffers[1] :
+		particleBuffers->buffers[0];
+
+	REFRESH_Buffer *clearBindings[] = { neighborGridGPU->cellStart };
+	REFRESH_Buffer *countBindings[] = {
+		positions,
+		neighborGridGPU->cellStart,
+		neighborGridGPU->particleCell,
+		neighborGridGPU->particleRank
+	};
+	REFRESH_Buffer *scatterBindings[] = {
+		positions,
+		neighborGridGPU->cellStart,
+		neighborGridGPU->particleCell,
+		neighborGridGPU->particleRank,
+		neighborGridGPU->sortedPositions,
+		neighborGridGPU->sortedIndex
+	};
+	REFRESH_Buffer *separateBindings[] = {
+		velocities,
+		neighborGridGPU->cellStart,
+		neighborGridGPU->sortedPositions,
+		neighborGridGPU->sortedIndex
+	};
+
+	REFRESH_Buffer **bindings[NEIGHBOR_GRID_PASS_TYPE_COUNT] = {
+		clearBindings,
+		countBindings,
+		clearBindings,
+		scatterBindings,
+		separateBindings
+	};
+	uint32_t bindingCounts[NEIGHBOR_GRID_PASS_TYPE_COUNT] = {
+		SDL_arraysize(clearBindings),
+		SDL_arraysize(countBindings),
+		SDL_arraysize(clearBindings),
+		SDL_arraysize(scatterBindings),
+		SDL_arraysize(separateBindings)
+	};
+
+	for (i = 0; i < NEIGHBOR_GRID_PASS_TYPE_COUNT; i += 1)
+	{
+		const char *shaderPath = NeighborGridGPU_GetShaderPath((NeighborGridPassType) i, particleBuffers->layout);
+
+		if (!ComputePass_Create(device, shaderCache, &neighborGridGPU->passes[i], shaderPath, sizeof(NeighborGridUniforms), bindings[i], bindingCounts[i]))
+		{
+			NeighborGridGPU_Destroy(device, neighborGridGPU);
+			return NULL;
+		}
+	}
+
+	return neighborGridGPU;
+}
+
+void NeighborGridGPU_Destroy(REFRESH_Device *device, NeighborGridGPU *neighborGridGPU)
+{
+	uint32_t i;
+
+	if (neighborGridGPU == NULL)
+	{
+		return;
+	}
+
+	for (i = 0; i < NEIGHBOR_GRID_PASS_TYPE_COUNT; i += 1)
+	{
+		ComputePass_Destroy(device, &neighborGridGPU->passes[i]);
+	}
+
+	REFRESH_AddDisposeBuffer(device, neighborGridGPU->cellStart);
+	REFRESH_AddDisposeBuffer(device, neighborGridGPU->particleCell);
+	REFRESH_AddDisposeBuffer(device, neighborGridGPU->particleRank);
+	REFRESH_AddDisposeBuffer(device, neighborGridGPU->sortedPositions);
+	REFRESH_AddDisposeBuffer(device, neighborGridGPU->sortedIndex);
+	SDL_free(neighborGridGPU);
+}
+
+void NeighborGridGPU_Record(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	NeighborGridGPU *neighborGridGPU,
+	const ParticleComputeUniforms *step
+) {
+	NeighborGridUniforms uniforms;
+	ComputePass *passes = neighborGridGPU->passes;
+	uint32_t particleGroupCount = (step->particleCount + 255) / 256;
+	uint32_t cellGroupCount;
+
+	NeighborGrid_FillUniforms(neighborGridGPU->grid, &uniforms, step->particleCount, step->deltaTime);
+	cellGroupCount = (uniforms.cellCount + 1 + 255) / 256;
+
+	ComputePass_Record(device, commandBuffer, &passes[NEIGHBOR_GRID_PASS_CLEAR], &uniforms, cellGroupCount);
+	ComputePass_Record(device, commandBuffer, &passes[NEIGHBOR_GRID_PASS_COUNT], &uniforms, particleGroupCount);
+	ComputePass_Record(device, commandBuffer, &passes[NEIGHBOR_GRID_PASS_SCAN], &uniforms, 1);
+	ComputePass_Record(device, commandBuffer, &passes[NEIGHBOR_GRID_PASS_SCATTER], &uniforms, particleGroupCount);
+	ComputePass_Record(device, commandBuffer, &passes[NEIGHBOR_GRID_PASS_SEPARATE], &uniforms, particleGroupCount);
+}
@@ -0,0 +1,37 @@
+#ifndef NEIGHBOR_GRID_GPU_H
+#define NEIGHBOR_GRID_GPU_H
+
+#include <Refresh.h>
+
+#include "neighbor_grid.h"
+#include "particle_buffers.h"
+#include "shader_module.h"
+
+/* The neighbor_grid.comp passes and their scratch buffers.
+ *
+ * Recording one step clears the cell counts, counts particles per cell,
+ * scans the counts into cell offsets, scatters positions into cell order
+ * and adds the separation impulse to each particle's velocity. These are
+ * five dispatches, and each rebinds its buffers so Refresh places a barrier
+ * between them. The particle update dispatch for the same step must follow.
+ */
+
+typedef struct NeighborGridGPU NeighborGridGPU;
+
+/* Returns NULL if a shader could not be loaded */
+NeighborGridGPU* NeighborGridGPU_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	NeighborGrid *grid,
+	ParticleBuffers *particleBuffers
+);
+void NeighborGridGPU_Destroy(REFRESH_Device *device, NeighborGridGPU *neighborGridGPU);
+
+void NeighborGridGPU_Record(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	NeighborGridGPU *neighborGridGPU,
+	const ParticleComputeUniforms *step
+);
+
+#endif /* NEIGHBOR_GRID_GPU_H */
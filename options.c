@@ -0,0 +1,937 @@
+#include "options.h"
+
+#include <SDL.h>
+
+#include "frame_ring.h"
+#include "job_system.h"
+#include "particle_pool.h"
+#include "particle_quantize.h"
+#include "trace.h"
+#include "trajectory.h"
+
+void Options_SetDefaults(Options *options)
+{
+	options->backend = SIMULATION_BACKEND_GPU;
+	options->layout = PARTICLE_LAYOUT_INTERLEAVED;
+	options->substepMode = SUBSTEP_MODE_DISPATCH;
+	options->maxSubsteps = 8;
+	options->substeps = 1;
+	options->framesInFlight = 2;
+	options->paceMode = FRAME_PACE_THROUGHPUT;
+	options->frameRate = 60.0;
+	options->presentMode = REFRESH_PRESENTMODE_IMMEDIATE;
+	options->dispatchAutotune = true;
+	options->dispatchVariant = DispatchVariant_GetDefault();
+	options->dispatchTunePath = "dispatch_tune.bin";
+	options->cpuKernel = CPUSIM_KERNEL_AUTO;
+	options->threadCount = 0;
+	options->jobCount = 0;
+	options->neighbors = false;
+	options->neighborRadius = 0.0f;
+	options->neighborStrength = 1.0f;
+	options->mesh = false;
+	options->meshSize = 128;
+	options->meshGravity = 0.5f;
+	options->meshSweep = false;
+	options->field = false;
+	options->fieldMode = FORCE_FIELD_MODE_GRID;
+	options->fieldAttractorCount = 256;
+	options->fieldSize = 256;
+	options->fieldStrength = 0.05f;
+	options->fieldTexturePath = NULL;
+	options->fieldTextureStrength = 0.5f;
+	options->fieldSweep = false;
+	options->quantizeDriftSteps = 0;
+	options->emitPerStep = 0;
+	options->reorderInterval = 0;
+	options->lifetime = 600;
+	options->validate = false;
+	options->validateTolerance = 1e-4f;
+	options->headless = false;
+	options->frameCount = 1000;
+	options->particleCount = PARTICLE_COUNT;
+	options->gpuInit = false;
+	options->seedSet = false;
+	options->seed = 0;
+	options->reportJSONPath = NULL;
+	options->reportCSVPath = NULL;
+	options->tracePath = NULL;
+	options->traceEvents = TRACE_DEFAULT_EVENTS_PER_THREAD;
+	options->captureInterval = 0;
+	options->capturePrefix = "capture";
+	options->captureLatency = 2;
+	options->checkpointPath = NULL;
+	options->checkpointInterval = 0;
+	options->restorePath = NULL;
+	options->exportPath = NULL;
+	options->exportInterval = 1;
+	options->exportStep = TRAJECTORY_DEFAULT_STEP;
+	options->shaderBundlePath = "shaders.bundle";
+	options->pipelineCachePath = "pipeline_cache.bin";
+	options->textureBundlePath = "textures.bundle";
+	options->renderMode = RENDER_MODE_POINTS;
+	options->splatOutputPath = NULL;
+	options->splatReferencePath = NULL;
+}
+
+void Options_PrintUsage(const char *programName)
+{
+	SDL_Log(
+		"Usage: %s [options]\n"
+		"  --backend gpu|cpu       where the particle update runs (default gpu)\n"
+		"  --layout NAME           GPU particle layout, interleaved, split or quantized (default\n"
+		"                          interleaved)\n"
+		"  --substep-mode MODE     dispatch (one dispatch per step) or loop (all steps in one dispatch)\n"
+		"  --max-substeps N        most fixed steps recorded into one frame (default 8)\n"
+		"  --substeps N            fixed steps per frame in headless mode (default 1)\n"
+		"  --frames-in-flight N    frames the CPU may record ahead of the GPU, 1 or 2 (default 2)\n"
+		"  --pacing MODE           when frames start: throughput (whenever a step is due), fixed\n"
+		"                          (at the frame rate) or latency (at the frame rate, sampling\n"
+		"                          input as late as the predicted submit allows) (default\n"
+		"                          throughput)\n"
+		"  --frame-rate HZ         target frame rate of fixed and latency pacing, up to 1000\n"
+		"                          (default 60)\n"
+		"  --present-mode MODE     immediate, mailbox, fifo or fifo-relaxed (default immediate)\n"
+		"  --workgroup SHAPE       GPU update workgroup size, with xN for N particles per\n"
+		"                          invocation (64, 128, 128x2, 256, 256x2 or 256x4), or auto to\n"
+		"                          time each at startup (default auto)\n"
+		"  --tune-cache PATH       fastest workgroup per layout and particle count from earlier\n"
+		"                          runs; none to time every start (default dispatch_tune.bin)\n"
+		"  --cpu-kernel NAME       auto, scalar, sse2 or avx2 (default auto)\n"
+		"  --threads N             CPU worker threads, 0 for one per core (default 0)\n"
+		"  --jobs N                run the CPU side of windowed frames as jobs on N workers,\n"
+		"                          recording commands on a thread of their own, up to %u\n"
+		"                          (default 0: all on the main thread)\n"
+		"  --neighbors             push apart particles closer than the neighbor radius\n"
+		"  --neighbor-radius R     interaction radius in simulation units (default 0: about\n"
+		"                          eight neighbors at the starting density)\n"
+		"  --neighbor-strength S   velocity change per second from a touching neighbor (default 1)\n"
+		"  --mesh                  add particle-mesh gravity between all particles\n"
+		"  --mesh-size N           mesh cells per side, a power of two from %u to %u (default 128)\n"
+		"  --mesh-gravity G        strength of the mesh gravity (default 0.5)\n"
+		"  --mesh-sweep            log mesh solve time and force error for each grid size up to\n"
+		"                          the mesh size before running\n"
+		"  --field MODE            add fixed attractors and repulsors, summed per particle (direct)\n"
+		"                          or baked into a grid once (grid)\n"
+		"  --field-attractors N    attractor count, up to %u (default 256)\n"
+		"  --field-size N          field grid cells per side, %u to %u (default 256)\n"
+		"  --field-strength S      summed strength of every attractor (default 0.05)\n"
+		"  --field-texture PATH    add the vector field in a PNG's red and green channels\n"
+		"  --field-texture-strength S\n"
+		"                          force at full red or green (default 0.5)\n"
+		"  --field-sweep           log direct and grid cost and error for attractor counts up to\n"
+		"                          the attractor count before running\n"
+		"  --quantize-drift STEPS  log how far each quantized storage format drifts from fp32\n"
+		"                          over STEPS steps before running\n"
+		"  --emit N                emit N particles per step into a pool of --particles slots,\n"
+		"                          killing them when their lifetime runs out (GPU backend,\n"
+		"                          interleaved layout, default 0: every particle lives forever)\n"
+		"  --lifetime STEPS        longest particle lifetime, the shortest being half (default 600)\n"
+		"  --reorder-every STEPS   sort the particles into Morton order in memory once STEPS steps\n"
+		"                          have run since the last sort (default 0, off)\n"
+		"  --validate              compare every step against the scalar GLSL reference, exiting\n"
+		"                          with 1 if any frame is outside tolerance\n"
+		"  --tolerance X           allowed per-field error when validating (default 1e-4, or 4e-3\n"
+		"                          for the quantized layout on the GPU backend)\n"
+		"  --headless              run a fixed number of frames without a window and report timings\n"
+		"  --frames N              frames to simulate in headless mode (default 1000)\n"
+		"  --particles N           particle count (default %u)\n"
+		"  --seed S                seed for particle initialization (default: current time)\n"
+		"  --gpu-init              write the initial particles on the GPU instead of uploading them\n"
+		"  --report-json PATH      write the headless timing report as JSON\n"
+		"  --report-csv PATH       write the headless timing report as CSV\n"
+		"  --trace PATH            write a Chrome trace of every frame's hot paths at exit\n"
+		"  --trace-events N        most recent events kept per thread (default %u)\n"
+		"  --capture-every N       save every Nth presented frame as a numbered PNG (default 0, off)\n"
+		"  --capture-prefix PATH   file prefix for captured frames (default capture)\n"
+		"  --capture-latency N     frames a capture stays on the GPU before readback (default 2)\n"
+		"  --checkpoint PATH       write the simulation state to PATH after the last headless\n"
+		"                          frame, or on the C key (GPU backend)\n"
+		"  --checkpoint-every N    write the checkpoint every Nth frame instead (default 0, off)\n"
+		"  --restore PATH          continue from a checkpoint, whose seed replaces --seed; --layout\n"
+		"                          and --particles must match it\n"
+		"  --export PATH           stream the particles to a chunked trajectory file (GPU backend)\n"
+		"  --export-every N        export every Nth frame (default 1)\n"
+		"  --export-step X         quantization step of exported positions and velocities\n"
+		"                          (default 1/65536)\n"
+		"  --shader-bundle PATH    packed SPIR-V to map at startup, none for loose .spv files\n"
+		"                          (default shaders.bundle)\n"
+		"  --pipeline-cache PATH   index of pipelines built on earlier runs, used to report cold\n"
+		"                          and warm startup; none to turn off (default pipeline_cache.bin)\n"
+		"  --texture-bundle PATH   baked textures to map at startup, none to decode the PNGs\n"
+		"                          (default textures.bundle)\n"
+		"  --render MODE           points (blended point sprites) or splat (tiled compute\n"
+		"                          splatting; headless only on the CPU backend) (default points)\n"
+		"  --splat-output PATH     write the last headless splat frame as a PNG\n"
+		"  --splat-reference PATH  compare the last headless splat frame against this PNG\n"
+		"  --help                  show this message",
+		programName,
+		JOB_SYSTEM_MAX_WORKERS,
+		PARTICLE_MESH_MIN_SIZE,
+		PARTICLE_MESH_MAX_SIZE,
+		FORCE_FIELD_MAX_ATTRACTORS,
+		FORCE_FIELD_MIN_SIZE,
+		FORCE_FIELD_MAX_SIZE,
+		PARTICLE_COUNT,
+		TRACE_DEFAULT_EVENTS_PER_THREAD
+	);
+}
+
+static const char* Options_NextValue(int argc, char *argv[], int *i)
+{
+	if (*i + 1 >= argc)
+	{
+		SDL_Log("Missing value for %s", argv[*i]);
+		return NULL;
+	}
+	*i += 1;
+	return argv[*i];
+}
+
+bool Options_Parse(Options *options, int argc, char *argv[])
+{
+	int i;
+	const char *value;
+	bool toleranceSet = false;
+
+	Options_SetDefaults(options);
+
+	for (i = 1; i < argc; i += 1)
+	{
+		const char *arg = argv[i];
+
+		if (SDL_strcmp(arg, "--help") == 0)
+		{
+			Options_PrintUsage(argv[0]);
+			return false;
+		}
+		else if (SDL_strcmp(arg, "--backend") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+
+			if (SDL_strcmp(value, "gpu") == 0)
+			{
+				options->backend = SIMULATION_BACKEND_GPU;
+			}
+			else if (SDL_strcmp(value, "cpu") == 0)
+			{
+				options->backend = SIMULATION_BACKEND_CPU;
+			}
+			else
+			{
+				SDL_Log("Unknown backend: %s", value);
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--layout") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+
+			if (SDL_strcmp(value, "interleaved") == 0)
+			{
+				options->layout = PARTICLE_LAYOUT_INTERLEAVED;
+			}
+			else if (SDL_strcmp(value, "split") == 0)
+			{
+				options->layout = PARTICLE_LAYOUT_SPLIT;
+			}
+			else if (SDL_strcmp(value, "quantized") == 0)
+			{
+				options->layout = PARTICLE_LAYOUT_QUANTIZED;
+			}
+			else
+			{
+				SDL_Log("Unknown layout: %s", value);
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--substep-mode") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+
+			if (SDL_strcmp(value, "dispatch") == 0)
+			{
+				options->substepMode = SUBSTEP_MODE_DISPATCH;
+			}
+			else if (SDL_strcmp(value, "loop") == 0)
+			{
+				options->substepMode = SUBSTEP_MODE_LOOP;
+			}
+			else
+			{
+				SDL_Log("Unknown substep mode: %s", value);
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--max-substeps") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->maxSubsteps = SDL_max((uint32_t) SDL_strtoul(value, NULL, 10), 1);
+		}
+		else if (SDL_strcmp(arg, "--substeps") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->substeps = SDL_max((uint32_t) SDL_strtoul(value, NULL, 10), 1);
+		}
+		else if (SDL_strcmp(arg, "--frames-in-flight") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->framesInFlight = (uint32_t) SDL_strtoul(value, NULL, 10);
+			if (options->framesInFlight < 1 || options->framesInFlight > FRAME_RING_MAX_FRAMES)
+			{
+				SDL_Log("Frames in flight must be between 1 and %u", FRAME_RING_MAX_FRAMES);
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--pacing") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+
+			if (SDL_strcmp(value, "throughput") == 0)
+			{
+				options->paceMode = FRAME_PACE_THROUGHPUT;
+			}
+			else if (SDL_strcmp(value, "fixed") == 0)
+			{
+				options->paceMode = FRAME_PACE_FIXED;
+			}
+			else if (SDL_strcmp(value, "latency") == 0)
+			{
+				options->paceMode = FRAME_PACE_LOW_LATENCY;
+			}
+			else
+			{
+				SDL_Log("Unknown pacing mode: %s", value);
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--frame-rate") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->frameRate = SDL_strtod(value, NULL);
+			if (!(options->frameRate > 0.0 && options->frameRate <= FRAME_PACER_MAX_RATE))
+			{
+				SDL_Log("Frame rate must be positive and at most %g", FRAME_PACER_MAX_RATE);
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--present-mode") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+
+			if (SDL_strcmp(value, "immediate") == 0)
+			{
+				options->presentMode = REFRESH_PRESENTMODE_IMMEDIATE;
+			}
+			else if (SDL_strcmp(value, "mailbox") == 0)
+			{
+				options->presentMode = REFRESH_PRESENTMODE_MAILBOX;
+			}
+			else if (SDL_strcmp(value, "fifo") == 0)
+			{
+				options->presentMode = REFRESH_PRESENTMODE_FIFO;
+			}
+			else if (SDL_strcmp(value, "fifo-relaxed") == 0)
+			{
+				options->presentMode = REFRESH_PRESENTMODE_FIFO_RELAXED;
+			}
+			else
+			{
+				SDL_Log("Unknown present mode: %s", value);
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--cpu-kernel") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+
+			if (SDL_strcmp(value, "auto") == 0)
+			{
+				options->cpuKernel = CPUSIM_KERNEL_AUTO;
+			}
+			else if (SDL_strcmp(value, "scalar") == 0)
+			{
+				options->cpuKernel = CPUSIM_KERNEL_SCALAR;
+			}
+			else if (SDL_strcmp(value, "sse2") == 0)
+			{
+				options->cpuKernel = CPUSIM_KERNEL_SSE2;
+			}
+			else if (SDL_strcmp(value, "avx2") == 0)
+			{
+				options->cpuKernel = CPUSIM_KERNEL_AVX2;
+			}
+			else
+			{
+				SDL_Log("Unknown CPU kernel: %s", value);
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--threads") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->threadCount = (uint32_t) SDL_strtoul(value, NULL, 10);
+		}
+		else if (SDL_strcmp(arg, "--jobs") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->jobCount = (uint32_t) SDL_strtoul(value, NULL, 10);
+			if (options->jobCount > JOB_SYSTEM_MAX_WORKERS)
+			{
+				SDL_Log("Job workers must be at most %u", JOB_SYSTEM_MAX_WORKERS);
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--neighbors") == 0)
+		{
+			options->neighbors = true;
+		}
+		else if (SDL_strcmp(arg, "--neighbor-radius") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->neighborRadius = (float) SDL_strtod(value, NULL);
+			if (!(options->neighborRadius >= 0.0f))
+			{
+				SDL_Log("Neighbor radius must not be negative");
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--neighbor-strength") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->neighborStrength = (float) SDL_strtod(value, NULL);
+		}
+		else if (SDL_strcmp(arg, "--mesh") == 0)
+		{
+			options->mesh = true;
+		}
+		else if (SDL_strcmp(arg, "--mesh-size") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->meshSize = (uint32_t) SDL_strtoul(value, NULL, 10);
+			if (options->meshSize < PARTICLE_MESH_MIN_SIZE ||
+				options->meshSize > PARTICLE_MESH_MAX_SIZE ||
+				(options->meshSize & (options->meshSize - 1)) != 0)
+			{
+				SDL_Log("Mesh size must be a power of two from %u to %u", PARTICLE_MESH_MIN_SIZE, PARTICLE_MESH_MAX_SIZE);
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--mesh-gravity") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->meshGravity = (float) SDL_strtod(value, NULL);
+		}
+		else if (SDL_strcmp(arg, "--mesh-sweep") == 0)
+		{
+			options->meshSweep = true;
+		}
+		else if (SDL_strcmp(arg, "--field") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+
+			if (SDL_strcmp(value, "direct") == 0)
+			{
+				options->fieldMode = FORCE_FIELD_MODE_DIRECT;
+			}
+			else if (SDL_strcmp(value, "grid") == 0)
+			{
+				options->fieldMode = FORCE_FIELD_MODE_GRID;
+			}
+			else
+			{
+				SDL_Log("Unknown field mode: %s", value);
+				return false;
+			}
+			options->field = true;
+		}
+		else if (SDL_strcmp(arg, "--field-attractors") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->fieldAttractorCount = (uint32_t) SDL_strtoul(value, NULL, 10);
+			if (options->fieldAttractorCount > FORCE_FIELD_MAX_ATTRACTORS)
+			{
+				SDL_Log("At most %u attractors are supported", FORCE_FIELD_MAX_ATTRACTORS);
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--field-size") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->fieldSize = (uint32_t) SDL_strtoul(value, NULL, 10);
+			if (options->fieldSize < FORCE_FIELD_MIN_SIZE || options->fieldSize > FORCE_FIELD_MAX_SIZE)
+			{
+				SDL_Log("Field size must be from %u to %u", FORCE_FIELD_MIN_SIZE, FORCE_FIELD_MAX_SIZE);
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--field-strength") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->fieldStrength = (float) SDL_strtod(value, NULL);
+		}
+		else if (SDL_strcmp(arg, "--field-texture") == 0)
+		{
+			if ((options->fieldTexturePath = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--field-texture-strength") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->fieldTextureStrength = (float) SDL_strtod(value, NULL);
+		}
+		else if (SDL_strcmp(arg, "--field-sweep") == 0)
+		{
+			options->fieldSweep = true;
+		}
+		else if (SDL_strcmp(arg, "--quantize-drift") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->quantizeDriftSteps = (uint32_t) SDL_strtoul(value, NULL, 10);
+		}
+		else if (SDL_strcmp(arg, "--emit") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->emitPerStep = (uint32_t) SDL_strtoul(value, NULL, 10);
+		}
+		else if (SDL_strcmp(arg, "--lifetime") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->lifetime = SDL_max((uint32_t) SDL_strtoul(value, NULL, 10), 1);
+		}
+		else if (SDL_strcmp(arg, "--reorder-every") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->reorderInterval = (uint32_t) SDL_strtoul(value, NULL, 10);
+		}
+		else if (SDL_strcmp(arg, "--validate") == 0)
+		{
+			options->validate = true;
+		}
+		else if (SDL_strcmp(arg, "--tolerance") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->validateTolerance = (float) SDL_strtod(value, NULL);
+			toleranceSet = true;
+		}
+		else if (SDL_strcmp(arg, "--headless") == 0)
+		{
+			options->headless = true;
+		}
+		else if (SDL_strcmp(arg, "--frames") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->frameCount = (uint32_t) SDL_strtoul(value, NULL, 10);
+		}
+		else if (SDL_strcmp(arg, "--particles") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->particleCount = (uint32_t) SDL_strtoul(value, NULL, 10);
+			if (options->particleCount == 0)
+			{
+				SDL_Log("Particle count must be positive");
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--gpu-init") == 0)
+		{
+			options->gpuInit = true;
+		}
+		else if (SDL_strcmp(arg, "--seed") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->seedSet = true;
+			options->seed = (uint32_t) SDL_strtoul(value, NULL, 10);
+		}
+		else if (SDL_strcmp(arg, "--report-json") == 0)
+		{
+			if ((options->reportJSONPath = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--report-csv") == 0)
+		{
+			if ((options->reportCSVPath = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--trace") == 0)
+		{
+			if ((options->tracePath = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--trace-events") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->traceEvents = (uint32_t) SDL_strtoul(value, NULL, 10);
+		}
+		else if (SDL_strcmp(arg, "--capture-every") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->captureInterval = (uint32_t) SDL_strtoul(value, NULL, 10);
+		}
+		else if (SDL_strcmp(arg, "--capture-prefix") == 0)
+		{
+			if ((options->capturePrefix = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--capture-latency") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->captureLatency = SDL_max((uint32_t) SDL_strtoul(value, NULL, 10), 1);
+		}
+		else if (SDL_strcmp(arg, "--checkpoint") == 0)
+		{
+			if ((options->checkpointPath = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--checkpoint-every") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->checkpointInterval = (uint32_t) SDL_strtoul(value, NULL, 10);
+		}
+		else if (SDL_strcmp(arg, "--restore") == 0)
+		{
+			if ((options->restorePath = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--export") == 0)
+		{
+			if ((options->exportPath = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--export-every") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->exportInterval = SDL_max((uint32_t) SDL_strtoul(value, NULL, 10), 1);
+		}
+		else if (SDL_strcmp(arg, "--export-step") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->exportStep = (float) SDL_strtod(value, NULL);
+		}
+		else if (SDL_strcmp(arg, "--shader-bundle") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->shaderBundlePath = (SDL_strcmp(value, "none") == 0) ? NULL : value;
+		}
+		else if (SDL_strcmp(arg, "--workgroup") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+
+			options->dispatchAutotune = SDL_strcmp(value, "auto") == 0;
+			if (!options->dispatchAutotune && !DispatchVariant_Parse(value, &options->dispatchVariant))
+			{
+				SDL_Log("Unknown workgroup shape: %s", value);
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--tune-cache") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->dispatchTunePath = (SDL_strcmp(value, "none") == 0) ? NULL : value;
+		}
+		else if (SDL_strcmp(arg, "--pipeline-cache") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->pipelineCachePath = (SDL_strcmp(value, "none") == 0) ? NULL : value;
+		}
+		else if (SDL_strcmp(arg, "--texture-bundle") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+			options->textureBundlePath = (SDL_strcmp(value, "none") == 0) ? NULL : value;
+		}
+		else if (SDL_strcmp(arg, "--render") == 0)
+		{
+			if ((value = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+
+			if (SDL_strcmp(value, "points") == 0)
+			{
+				options->renderMode = RENDER_MODE_POINTS;
+			}
+			else if (SDL_strcmp(value, "splat") == 0)
+			{
+				options->renderMode = RENDER_MODE_SPLAT;
+			}
+			else
+			{
+				SDL_Log("Unknown render mode: %s", value);
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--splat-output") == 0)
+		{
+			if ((options->splatOutputPath = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+		}
+		else if (SDL_strcmp(arg, "--splat-reference") == 0)
+		{
+			if ((options->splatReferencePath = Options_NextValue(argc, argv, &i)) == NULL)
+			{
+				return false;
+			}
+		}
+		else
+		{
+			SDL_Log("Unknown option: %s", arg);
+			Options_PrintUsage(argv[0]);
+			return false;
+		}
+	}
+
+	if (options->layout == PARTICLE_LAYOUT_QUANTIZED)
+	{
+		/* The neighbor, mesh and field passes only read the fp32 layouts */
+		if (options->backend == SIMULATION_BACKEND_GPU && (options->neighbors || options->mesh || options->field))
+		{
+			SDL_Log("The quantized layout cannot run --neighbors, --mesh or --field on the GPU backend");
+			return false;
+		}
+		if (!toleranceSet && options->backend == SIMULATION_BACKEND_GPU)
+		{
+			options->validateTolerance = PARTICLE_QUANTIZE_TOLERANCE;
+		}
+	}
+
+	if (options->emitPerStep > 0)
+	{
+		/* Only the interleaved Particle carries a lifetime, and the helper
+		 * passes and CPU backend run over a fixed particle count
+		 */
+		if (options->backend != SIMULATION_BACKEND_GPU ||
+			options->layout != PARTICLE_LAYOUT_INTERLEAVED ||
+			options->neighbors ||
+			options->mesh ||
+			options->field)
+		{
+			SDL_Log("--emit needs the GPU backend and interleaved layout, without --neighbors, --mesh or --field");
+			return false;
+		}
+		if (options->particleCount > PARTICLE_POOL_MAX_CAPACITY)
+		{
+			SDL_Log("A particle pool holds at most %u particles", PARTICLE_POOL_MAX_CAPACITY);
+			return false;
+		}
+	}
+
+	if (options->checkpointPath != NULL || options->restorePath != NULL)
+	{
+		/* A checkpoint is the device buffers; the pool's free list and
+		 * emitter live on the host and are not saved
+		 */
+		if (options->backend != SIMULATION_BACKEND_GPU || options->emitPerStep > 0)
+		{
+			SDL_Log("--checkpoint and --restore need the GPU backend, without --emit");
+			return false;
+		}
+	}
+	else if (options->checkpointInterval > 0)
+	{
+		SDL_Log("--checkpoint-every needs --checkpoint");
+		return false;
+	}
+
+	if (options->reorderInterval > 0)
+	{
+		/* The pool's free list and the exported trajectory both follow
+		 * particles by their index, which a sort changes
+		 */
+		if (options->emitPerStep > 0 || options->exportPath != NULL)
+		{
+			SDL_Log("--reorder-every cannot be combined with --emit or --export");
+			return false;
+		}
+	}
+
+	if (options->exportPath != NULL)
+	{
+		/* With --emit most of the buffer is dead slots */
+		if (options->backend != SIMULATION_BACKEND_GPU || options->emitPerStep > 0)
+		{
+			SDL_Log("--export needs the GPU backend, without --emit");
+			return false;
+		}
+		if (!(options->exportStep > 0.0f))
+		{
+			SDL_Log("--export-step must be positive");
+			return false;
+		}
+	}
+
+	if (options->jobCount > 0 && options->headless)
+	{
+		/* The headless loops keep their frames on one thread to time them */
+		SDL_Log("--jobs runs the windowed frame loop and cannot be combined with --headless");
+		return false;
+	}
+
+	if (options->tracePath != NULL && !TRACE_COMPILED_IN)
+	{
+		SDL_Log("--trace needs a build with tracing compiled in (not a release build)");
+		return false;
+	}
+
+	if (options->fieldTexturePath != NULL && !options->field)
+	{
+		SDL_Log("--field-texture needs --field");
+		return false;
+	}
+
+	if (options->renderMode == RENDER_MODE_SPLAT)
+	{
+		/* The windowed CPU backend uploads particles for the point draw and
+		 * has nothing to bin on the GPU
+		 */
+		if (options->backend == SIMULATION_BACKEND_CPU && !options->headless)
+		{
+			SDL_Log("--render splat needs --headless on the CPU backend");
+			return false;
+		}
+	}
+	else if (options->splatOutputPath != NULL || options->splatReferencePath != NULL)
+	{
+		SDL_Log("--splat-output and --splat-reference need --render splat");
+		return false;
+	}
+
+	return true;
+}
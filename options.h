@@ -0,0 +1,175 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <Refresh.h>
+
+#include "cpu_sim.h"
+#include "dispatch_tuner.h"
+#include "frame_pacer.h"
+
+typedef enum SimulationBackend
+{
+	SIMULATION_BACKEND_GPU,
+	SIMULATION_BACKEND_CPU
+} SimulationBackend;
+
+/* How several fixed steps are recorded into one command buffer */
+typedef enum SubstepMode
+{
+	SUBSTEP_MODE_DISPATCH, /* one dispatch per step, each with its own uniforms */
+	SUBSTEP_MODE_LOOP      /* one dispatch running every step in-shader (particle_substep.comp) */
+} SubstepMode;
+
+/* How particles reach the color target */
+typedef enum RenderMode
+{
+	RENDER_MODE_POINTS, /* blended point sprites (particle.vert/.frag) */
+	RENDER_MODE_SPLAT   /* tiled compute splatting (splat.comp, or Splatter on the CPU backend) */
+} RenderMode;
+
+typedef struct Options
+{
+	SimulationBackend backend;
+	ParticleLayout layout;
+	SubstepMode substepMode;
+	uint32_t maxSubsteps; /* catch-up steps batched into one frame */
+	uint32_t substeps;    /* steps per frame in headless mode */
+	uint32_t framesInFlight;
+
+	/* When frames start (frame_pacer.h), frameRate times a second unless
+	 * pacing for throughput. Headless runs pace on a simulated clock.
+	 */
+	FramePaceMode paceMode;
+	double frameRate;
+	REFRESH_PresentMode presentMode;
+
+	/* Workgroup shape of the GPU particle update. With dispatchAutotune it
+	 * is timed at startup, or read from dispatchTunePath (NULL to always
+	 * time it) when an earlier run tuned the same layout and count.
+	 */
+	bool dispatchAutotune;
+	DispatchVariant dispatchVariant;
+	const char *dispatchTunePath;
+
+	CPUSimKernel cpuKernel;
+	uint32_t threadCount; /* 0 means one per core */
+
+	/* Workers of the job system (job_system.h) that runs the CPU side of a
+	 * windowed frame, with Refresh calls recorded on a thread of their own.
+	 * 0 keeps the whole frame on the main thread.
+	 */
+	uint32_t jobCount;
+
+	/* Uniform grid separation between particles closer than neighborRadius,
+	 * 0 picks one from the particle count
+	 */
+	bool neighbors;
+	float neighborRadius;
+	float neighborStrength;
+
+	/* Particle-mesh gravity on a meshSize x meshSize grid. meshSweep logs
+	 * solve time against force error for every grid size up to meshSize
+	 * before the run starts.
+	 */
+	bool mesh;
+	uint32_t meshSize;
+	float meshGravity;
+	bool meshSweep;
+
+	/* fieldAttractorCount fixed attractors and repulsors, summed per
+	 * particle or baked into a fieldSize x fieldSize grid, plus the vector
+	 * field in the image at fieldTexturePath unless it is NULL. fieldSweep
+	 * logs direct and grid cost and error for growing attractor counts
+	 * before the run starts.
+	 */
+	bool field;
+	ForceFieldMode fieldMode;
+	uint32_t fieldAttractorCount;
+	uint32_t fieldSize;
+	float fieldStrength;
+	const char *fieldTexturePath;
+	float fieldTextureStrength;
+	bool fieldSweep;
+
+	/* Steps of the drift report comparing the quantized storage formats
+	 * against fp32 before the run starts, 0 for none
+	 */
+	uint32_t quantizeDriftSteps;
+
+	/* Particle pool: emitPerStep new particles every step, each living up
+	 * to lifetime steps, in a pool of particleCount slots. 0 keeps every
+	 * particle alive forever.
+	 */
+	uint32_t emitPerStep;
+	uint32_t lifetime;
+
+	/* Morton-order the particles in memory once this many steps have run
+	 * since the last sort, 0 to keep their initial order
+	 */
+	uint32_t reorderInterval;
+
+	/* Check every step of the active backend against CPUSim_ReferenceStep */
+	bool validate;
+	float validateTolerance;
+
+	/* Headless benchmark: no visible window, no present, fixed frame count */
+	bool headless;
+	uint32_t frameCount;
+	uint32_t particleCount;
+	bool gpuInit; /* write the initial state with particle_init.comp instead of uploading it */
+	bool seedSet; /* otherwise seeded from the clock */
+	uint32_t seed;
+	const char *reportJSONPath;
+	const char *reportCSVPath;
+
+	/* Chrome trace of the run's hot paths, written at exit (trace.h) */
+	const char *tracePath;
+	uint32_t traceEvents; /* ring size per thread */
+
+	/* Color target capture, written by a background thread */
+	uint32_t captureInterval;  /* capture every Nth frame, 0 for only on the S key */
+	const char *capturePrefix; /* sequence files are <prefix>_<frame>.png */
+	uint32_t captureLatency;   /* frames between a capture and its readback */
+
+	/* Checkpoints of the device particle buffers (checkpoint.h). With no
+	 * interval a headless run writes one after its last frame and a
+	 * windowed one on the C key.
+	 */
+	const char *checkpointPath;   /* NULL to never write one */
+	uint32_t checkpointInterval;  /* write every Nth frame, overwriting the last */
+	const char *restorePath;      /* start from this checkpoint instead of a new state */
+
+	/* Trajectory export of the device particles (trajectory_export.h) */
+	const char *exportPath;  /* NULL to export nothing */
+	uint32_t exportInterval; /* export every Nth frame */
+	float exportStep;        /* quantization step of every field */
+
+	/* Startup: the memory-mapped shader bundle and the pipeline cache
+	 * index, either NULL to go without
+	 */
+	const char *shaderBundlePath;
+	const char *pipelineCachePath;
+
+	/* Baked textures mapped by the loader thread, NULL to decode PNGs */
+	const char *textureBundlePath;
+
+	/* Splat rendering. Headless runs write the last frame to splatOutputPath
+	 * and compare it against the image at splatReferencePath, either NULL
+	 * to skip.
+	 */
+	RenderMode renderMode;
+	const char *splatOutputPath;
+	const char *splatReferencePath;
+} Options;
+
+void Options_SetDefaults(Options *options);
+
+/* Returns false if the arguments were invalid or --help was requested */
+bool Options_Parse(Options *options, int argc, char *argv[]);
+
+void Options_PrintUsage(const char *programName);
+
+#endif /* OPTIONS_H */
@@ -0,0 +1,155 @@
+/* Build-time tool: packs SPIR-V files into one shader bundle.
+ *
+ * Usage: PackShaders <output> <input.spv>...
+ *
+ * Entries are named after the input's file name, which is what
+ * ShaderModule_Load looks them up by. This does not link SDL so it can run
+ * before anything else is built.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shader_bundle.h"
+
+static const char* PackShaders_BaseName(const char *path)
+{
+	const char *forward = strrchr(path, '/');
+	const char *backward = strrchr(path, '\\');
+	const char *separator = (forward > backward) ? forward : backward;
+
+	return (separator != NULL) ? separator + 1 : path;
+}
+
+/* Same FNV-1a as ShaderBundle_Hash */
+static uint64_t PackShaders_Hash(const uint8_t *bytes, uint32_t length)
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+	uint32_t i;
+
+	for (i = 0; i < length; i += 1)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ull;
+	}
+
+	return hash;
+}
+
+static uint8_t* PackShaders_ReadFile(const char *path, uint32_t *size)
+{
+	FILE *file = fopen(path, "rb");
+	uint8_t *data;
+	long length;
+
+	if (file == NULL)
+	{
+		return NULL;
+	}
+
+	fseek(file, 0, SEEK_END);
+	length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	data = malloc(length > 0 ? (size_t) length : 1);
+	if (length <= 0 || fread(data, 1, (size_t) length, file) != (size_t) length)
+	{
+		free(data);
+		fclose(file);
+		return NULL;
+	}
+
+	fclose(file);
+	*size = (uint32_t) length;
+	return data;
+}
+
+int main(int argc, char *argv[])
+{
+	static const uint8_t padding[SHADER_BUNDLE_ALIGNMENT] = { 0 };
+	ShaderBundleHeader header;
+	ShaderBundleEntry *entries;
+	uint8_t **contents;
+	uint32_t entryCount, offset, i;
+	const char *name;
+	FILE *output;
+	int result = 0;
+
+	if (argc < 3)
+	{
+		fprintf(stderr, "Usage: %s <output> <input.spv>...\n", argv[0]);
+		return 1;
+	}
+
+	entryCount = (uint32_t) (argc - 2);
+	entries = calloc(entryCount, sizeof(ShaderBundleEntry));
+	contents = calloc(entryCount, sizeof(uint8_t*));
+
+	offset = sizeof(ShaderBundleHeader) + entryCount * sizeof(ShaderBundleEntry);
+
+	for (i = 0; i < entryCount; i += 1)
+	{
+		name = PackShaders_BaseName(argv[i + 2]);
+		if (strlen(name) >= SHADER_BUNDLE_NAME_LENGTH)
+		{
+			fprintf(stderr, "Shader name too long for a bundle: %s\n", name);
+			result = 1;
+			break;
+		}
+
+		contents[i] = PackShaders_ReadFile(argv[i + 2], &entries[i].size);
+		if (contents[i] == NULL || (entries[i].size % 4) != 0)
+		{
+			fprintf(stderr, "Could not read SPIR-V from %s\n", argv[i + 2]);
+			result = 1;
+			break;
+		}
+
+		strcpy(entries[i].name, name);
+		entries[i].hash = PackShaders_Hash(contents[i], entries[i].size);
+
+		offset = (offset + SHADER_BUNDLE_ALIGNMENT - 1) & ~(uint32_t) (SHADER_BUNDLE_ALIGNMENT - 1);
+		entries[i].offset = offset;
+		offset += entries[i].size;
+	}
+
+	if (result == 0)
+	{
+		output = fopen(argv[1], "wb");
+		if (output == NULL)
+		{
+			fprintf(stderr, "Could not open %s for writing\n", argv[1]);
+			result = 1;
+		}
+		else
+		{
+			header.magic = SHADER_BUNDLE_MAGIC;
+			header.version = SHADER_BUNDLE_VERSION;
+			header.entryCount = entryCount;
+			header.reserved = 0;
+
+			fwrite(&header, sizeof(header), 1, output);
+			fwrite(entries, sizeof(ShaderBundleEntry), entryCount, output);
+
+			offset = sizeof(ShaderBundleHeader) + entryCount * sizeof(ShaderBundleEntry);
+			for (i = 0; i < entryCount; i += 1)
+			{
+				fwrite(padding, 1, entries[i].offset - offset, output);
+				fwrite(contents[i], 1, entries[i].size, output);
+				offset = entries[i].offset + entries[i].size;
+			}
+
+			fclose(output);
+		}
+	}
+
+	for (i = 0; i < entryCount; i += 1)
+	{
+		free(contents[i]);
+	}
+	free(contents);
+	free(entries);
+
+	return result;
+}
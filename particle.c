@@ -0,0 +1,115 @@
+#include "particle.h"
+
+#include <SDL.h>
+
+#define PARTICLE_INIT_GRAIN 16384
+
+typedef struct ParticleInitJob
+{
+	Particle *particles;
+	uint64_t key;
+} ParticleInitJob;
+
+static void Particle_InitializeRange(void *userdata, uint32_t start, uint32_t end)
+{
+	ParticleInitJob *job = (ParticleInitJob*) userdata;
+	uint32_t i;
+
+	for (i = start; i < end; i += 1)
+	{
+		Particle *particle = &job->particles[i];
+
+		particle->xPosition = Particle_RandomSigned(Particle_Random(job->key, (uint64_t) i * 2));
+		particle->yPosition = Particle_RandomSigned(Particle_Random(job->key, (uint64_t) i * 2 + 1));
+		particle->xVelocity = 0;
+		particle->yVelocity = 1;
+		particle->gradientPosition = particle->xPosition * 0.5f;
+		particle->life = 0;
+		particle->dummy2 = 0;
+		particle->dummy3 = 0;
+	}
+}
+
+uint64_t Particle_RandomKey(uint32_t seed)
+{
+	/* splitmix64 finalizer; an odd key keeps every counter distinct */
+	uint64_t key = (uint64_t) seed + 0x9E3779B97F4A7C15ull;
+
+	key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ull;
+	key = (key ^ (key >> 27)) * 0x94D049BB133111EBull;
+	key = key ^ (key >> 31);
+
+	return key | 1;
+}
+
+uint32_t Particle_Random(uint64_t key, uint64_t counter)
+{
+	/* Widynski's Squares, four rounds */
+	uint64_t x = counter * key;
+	uint64_t y = x;
+	uint64_t z = y + key;
+
+	x = x * x + y;
+	x = (x >> 32) | (x << 32);
+	x = x * x + z;
+	x = (x >> 32) | (x << 32);
+	x = x * x + y;
+	x = (x >> 32) | (x << 32);
+
+	return (uint32_t) ((x * x + z) >> 32);
+}
+
+float Particle_RandomSigned(uint32_t bits)
+{
+	/* 24 bits scale exactly, so the GPU arrives at the same float */
+	return (float) (bits >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+void Particle_InitializeArray(Particle *particles, uint32_t count, uint32_t seed, ThreadPool *pool)
+{
+	Particle_InitializeArrayFromKey(particles, count, Particle_RandomKey(seed), pool);
+}
+
+void Particle_InitializeArrayFromKey(Particle *particles, uint32_t count, uint64_t key, ThreadPool *pool)
+{
+	ParticleInitJob job;
+
+	job.particles = particles;
+	job.key = key;
+
+	if (pool == NULL)
+	{
+		Particle_InitializeRange(&job, 0, count);
+	}
+	else
+	{
+		ThreadPool_ParallelFor(pool, count, PARTICLE_INIT_GRAIN, Particle_InitializeRange, &job);
+	}
+}
+
+void Particle_FillUniforms(ParticleComputeUniforms *uniforms, uint32_t count, double t, double dt)
+{
+	uniforms->deltaTime = (float)dt * 0.25f;
+	uniforms->destinationX = (float)SDL_sin((t)) * 0.75f;
+	uniforms->destinationY = 0.0f;
+	uniforms->particleCount = count;
+}
+
+void Particle_FillSubstepUniforms(
+	ParticleSubstepUniforms *substepUniforms,
+	const ParticleComputeUniforms *steps,
+	uint32_t stepCount
+) {
+	uint32_t i;
+
+	SDL_memset(substepUniforms, 0, sizeof(ParticleSubstepUniforms));
+	substepUniforms->particleCount = steps[0].particleCount;
+	substepUniforms->stepCount = SDL_min(stepCount, MAX_SUBSTEPS);
+
+	for (i = 0; i < substepUniforms->stepCount; i += 1)
+	{
+		substepUniforms->steps[i].deltaTime = steps[i].deltaTime;
+		substepUniforms->steps[i].destinationX = steps[i].destinationX;
+		substepUniforms->steps[i].destinationY = steps[i].destinationY;
+	}
+}
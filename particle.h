@@ -0,0 +1,102 @@
+#ifndef PARTICLE_H
+#define PARTICLE_H
+
+#include <stdint.h>
+
+#include "thread_pool.h"
+
+#define PARTICLE_COUNT (256 * 1024)
+
+/* Matches the std430 layout of struct Particle in particle.comp */
+typedef struct Particle
+{
+	float xPosition, yPosition;
+	float xVelocity, yVelocity;
+	float gradientPosition;
+	float life; /* steps left for pooled particles, see particle_pool.h */
+	float dummy2, dummy3;
+} Particle;
+
+/* How particle state is laid out in GPU memory.
+ *
+ * INTERLEAVED is the 32 byte Particle struct used by particle.comp.
+ * SPLIT keeps separate tightly packed streams (vec2 position, vec2 velocity,
+ * float gradient) used by particle_split.comp, so the vertex fetch only
+ * touches position and gradient, 12 of the original 32 bytes.
+ * QUANTIZED is the 12 byte QuantizedParticle of particle_quantize.h used by
+ * particle_quantized.comp: snorm16 positions and gradient, half velocity,
+ * decoded to fp32 on load and rounded on store.
+ */
+typedef enum ParticleLayout
+{
+	PARTICLE_LAYOUT_INTERLEAVED,
+	PARTICLE_LAYOUT_SPLIT,
+	PARTICLE_LAYOUT_QUANTIZED
+} ParticleLayout;
+
+/* Matches the UBO block in particle.comp */
+typedef struct ParticleComputeUniforms
+{
+	float deltaTime;
+	float destinationX, destinationY;
+	uint32_t particleCount;
+} ParticleComputeUniforms;
+
+/* Matches the UBO block in particle_init.comp */
+typedef struct ParticleInitUniforms
+{
+	uint32_t keyLow, keyHigh; /* Particle_RandomKey */
+	uint32_t particleCount;
+	uint32_t invocationCount;
+} ParticleInitUniforms;
+
+/* Matches the UBO block in particle_substep.comp (std140) */
+#define MAX_SUBSTEPS 16
+
+typedef struct ParticleSubstep
+{
+	float deltaTime;
+	float destinationX, destinationY;
+	float padding;
+} ParticleSubstep;
+
+typedef struct ParticleSubstepUniforms
+{
+	uint32_t particleCount;
+	uint32_t stepCount;
+	uint32_t padding[2];
+	ParticleSubstep steps[MAX_SUBSTEPS];
+} ParticleSubstepUniforms;
+
+/* Fills the array with the initial state used by every backend, split
+ * across the pool (which may be NULL). Every particle is a pure function
+ * of its index and the seed, so the result is bit-identical for a given
+ * seed whatever the thread count, and particle_init.comp produces the
+ * same state on the device.
+ */
+void Particle_InitializeArray(Particle *particles, uint32_t count, uint32_t seed, ThreadPool *pool);
+
+/* The same from the generator key, which is all particle_init.comp is given */
+void Particle_InitializeArrayFromKey(Particle *particles, uint32_t count, uint64_t key, ThreadPool *pool);
+
+/* The counter-based generator behind initialization: 32 random bits for
+ * any (key, counter) pair, with no state between calls. Particle i draws
+ * counters 2i and 2i + 1.
+ */
+uint64_t Particle_RandomKey(uint32_t seed);
+uint32_t Particle_Random(uint64_t key, uint64_t counter);
+
+/* The top 24 bits of a Particle_Random result as a float in [-1, 1) */
+float Particle_RandomSigned(uint32_t bits);
+
+/* The attractor path driven by simulation time t, shared by every backend */
+void Particle_FillUniforms(ParticleComputeUniforms *uniforms, uint32_t count, double t, double dt);
+
+/* Packs up to MAX_SUBSTEPS consecutive steps for particle_substep.comp */
+void Particle_FillSubstepUniforms(
+	ParticleSubstepUniforms *substepUniforms,
+	const ParticleComputeUniforms *steps,
+	uint32_t stepCount
+);
+
+#endif /* PARTICLE_H */
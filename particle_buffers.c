@@ -0,0 +1,369 @@
+#include "particle_buffers.h"
+
+#include <SDL.h>
+
+#include "compute_pass.h"
+
+/* Past the guaranteed maxComputeWorkGroupCount; particle_init.comp strides */
+#define PARTICLE_INIT_MAX_GROUPS 65535
+
+ParticleBuffers* ParticleBuffers_Create(REFRESH_Device *device, ParticleLayout layout, uint32_t particleCount)
+{
+	ParticleBuffers *particleBuffers = SDL_malloc(sizeof(ParticleBuffers));
+	SDL_memset(particleBuffers, 0, sizeof(ParticleBuffers));
+
+	particleBuffers->layout = layout;
+	particleBuffers->particleCount = particleCount;
+
+	if (layout == PARTICLE_LAYOUT_SPLIT)
+	{
+		particleBuffers->bufferCount = 3;
+		particleBuffers->bufferSizes[0] = sizeof(float) * 2 * particleCount;
+		particleBuffers->bufferSizes[1] = sizeof(float) * 2 * particleCount;
+		particleBuffers->bufferSizes[2] = sizeof(float) * particleCount;
+		particleBuffers->buffers[0] = REFRESH_CreateBuffer(
+			device,
+			REFRESH_BUFFERUSAGE_VERTEX_BIT | REFRESH_BUFFERUSAGE_COMPUTE_BIT,
+			particleBuffers->bufferSizes[0]
+		);
+		particleBuffers->buffers[1] = REFRESH_CreateBuffer(
+			device,
+			REFRESH_BUFFERUSAGE_COMPUTE_BIT,
+			particleBuffers->bufferSizes[1]
+		);
+		particleBuffers->buffers[2] = REFRESH_CreateBuffer(
+			device,
+			REFRESH_BUFFERUSAGE_VERTEX_BIT | REFRESH_BUFFERUSAGE_COMPUTE_BIT,
+			particleBuffers->bufferSizes[2]
+		);
+
+		particleBuffers->vertexBufferCount = 2;
+		particleBuffers->vertexBuffers[0] = particleBuffers->buffers[0];
+		particleBuffers->vertexBuffers[1] = particleBuffers->buffers[2];
+
+		particleBuffers->positions = SDL_malloc(sizeof(float) * 2 * particleCount);
+		particleBuffers->velocities = SDL_malloc(sizeof(float) * 2 * particleCount);
+		particleBuffers->gradientPositions = SDL_malloc(sizeof(float) * particleCount);
+	}
+	else if (layout == PARTICLE_LAYOUT_QUANTIZED)
+	{
+		particleBuffers->bufferCount = 1;
+		particleBuffers->bufferSizes[0] = sizeof(QuantizedParticle) * particleCount;
+		particleBuffers->buffers[0] = REFRESH_CreateBuffer(
+			device,
+			REFRESH_BUFFERUSAGE_VERTEX_BIT | REFRESH_BUFFERUSAGE_COMPUTE_BIT,
+			particleBuffers->bufferSizes[0]
+		);
+
+		particleBuffers->vertexBufferCount = 1;
+		particleBuffers->vertexBuffers[0] = particleBuffers->buffers[0];
+
+		particleBuffers->quantized = SDL_malloc(sizeof(QuantizedParticle) * particleCount);
+	}
+	else
+	{
+		particleBuffers->bufferCount = 1;
+		particleBuffers->bufferSizes[0] = sizeof(Particle) * particleCount;
+		particleBuffers->buffers[0] = REFRESH_CreateBuffer(
+			device,
+			REFRESH_BUFFERUSAGE_VERTEX_BIT | REFRESH_BUFFERUSAGE_COMPUTE_BIT,
+			particleBuffers->bufferSizes[0]
+		);
+
+		particleBuffers->vertexBufferCount = 1;
+		particleBuffers->vertexBuffers[0] = particleBuffers->buffers[0];
+	}
+
+	return particleBuffers;
+}
+
+void ParticleBuffers_Destroy(REFRESH_Device *device, ParticleBuffers *particleBuffers)
+{
+	uint32_t i;
+
+	if (particleBuffers == NULL)
+	{
+		return;
+	}
+
+	for (i = 0; i < particleBuffers->bufferCount; i += 1)
+	{
+		REFRESH_AddDisposeBuffer(device, particleBuffers->buffers[i]);
+	}
+
+	SDL_free(particleBuffers->positions);
+	SDL_free(particleBuffers->velocities);
+	SDL_free(particleBuffers->gradientPositions);
+	SDL_free(particleBuffers->quantized);
+	SDL_free(particleBuffers);
+}
+
+void ParticleBuffers_Upload(REFRESH_Device *device, ParticleBuffers *particleBuffers, const Particle *particles)
+{
+	uint32_t i;
+	uint32_t particleCount = particleBuffers->particleCount;
+
+	if (particleBuffers->layout == PARTICLE_LAYOUT_INTERLEAVED)
+	{
+		REFRESH_SetBufferData(device, particleBuffers->buffers[0], 0, (void*) particles, sizeof(Particle) * particleCount);
+		return;
+	}
+
+	if (particleBuffers->layout == PARTICLE_LAYOUT_QUANTIZED)
+	{
+		ParticleQuantize_Encode(particles, particleBuffers->quantized, particleCount);
+		REFRESH_SetBufferData(device, particleBuffers->buffers[0], 0, particleBuffers->quantized, sizeof(QuantizedParticle) * particleCount);
+		return;
+	}
+
+	for (i = 0; i < particleCount; i += 1)
+	{
+		particleBuffers->positions[i * 2 + 0] = particles[i].xPosition;
+		particleBuffers->positions[i * 2 + 1] = particles[i].yPosition;
+		particleBuffers->velocities[i * 2 + 0] = particles[i].xVelocity;
+		particleBuffers->velocities[i * 2 + 1] = particles[i].yVelocity;
+		particleBuffers->gradientPositions[i] = particles[i].gradientPosition;
+	}
+
+	REFRESH_SetBufferData(device, particleBuffers->buffers[0], 0, particleBuffers->positions, sizeof(float) * 2 * particleCount);
+	REFRESH_SetBufferData(device, particleBuffers->buffers[1], 0, particleBuffers->velocities, sizeof(float) * 2 * particleCount);
+	REFRESH_SetBufferData(device, particleBuffers->buffers[2], 0, particleBuffers->gradientPositions, sizeof(float) * particleCount);
+}
+
+void ParticleBuffers_UploadRenderStreams(REFRESH_Device *device, ParticleBuffers *particleBuffers)
+{
+	uint32_t particleCount = particleBuffers->particleCount;
+
+	REFRESH_SetBufferData(device, particleBuffers->buffers[0], 0, particleBuffers->positions, sizeof(float) * 2 * particleCount);
+	REFRESH_SetBufferData(device, particleBuffers->buffers[2], 0, particleBuffers->gradientPositions, sizeof(float) * particleCount);
+}
+
+bool ParticleBuffers_InitializeOnDevice(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ParticleBuffers *particleBuffers,
+	uint32_t seed
+) {
+	ComputePass pass;
+	ParticleInitUniforms uniforms;
+	REFRESH_CommandBuffer *commandBuffer;
+	uint64_t key = Particle_RandomKey(seed);
+	uint32_t groupCount = SDL_min((particleBuffers->particleCount + 255) / 256, PARTICLE_INIT_MAX_GROUPS);
+
+	if (!ComputePass_Create(
+		device,
+		shaderCache,
+		&pass,
+		ParticleLayout_GetInitShaderPath(particleBuffers->layout),
+		sizeof(ParticleInitUniforms),
+		particleBuffers->buffers,
+		particleBuffers->bufferCount
+	)) {
+		ComputePass_Destroy(device, &pass);
+		return false;
+	}
+
+	uniforms.keyLow = (uint32_t) key;
+	uniforms.keyHigh = (uint32_t) (key >> 32);
+	uniforms.particleCount = particleBuffers->particleCount;
+	uniforms.invocationCount = SDL_max(groupCount, 1) * 256;
+
+	commandBuffer = REFRESH_AcquireCommandBuffer(device, 0);
+	ComputePass_Record(device, commandBuffer, &pass, &uniforms, groupCount);
+	REFRESH_Submit(device, 1, &commandBuffer);
+	REFRESH_Wait(device);
+
+	ComputePass_Destroy(device, &pass);
+	return true;
+}
+
+void ParticleBuffers_Download(REFRESH_Device *device, ParticleBuffers *particleBuffers, Particle *particles)
+{
+	const uint8_t *streams[MAX_PARTICLE_BUFFERS];
+	uint32_t particleCount = particleBuffers->particleCount;
+
+	if (particleBuffers->layout == PARTICLE_LAYOUT_INTERLEAVED)
+	{
+		REFRESH_GetBufferData(device, particleBuffers->buffers[0], particles, sizeof(Particle) * particleCount);
+		return;
+	}
+
+	if (particleBuffers->layout == PARTICLE_LAYOUT_QUANTIZED)
+	{
+		REFRESH_GetBufferData(device, particleBuffers->buffers[0], particleBuffers->quantized, sizeof(QuantizedParticle) * particleCount);
+		ParticleQuantize_Decode(particleBuffers->quantized, particles, particleCount);
+		return;
+	}
+
+	REFRESH_GetBufferData(device, particleBuffers->buffers[0], particleBuffers->positions, sizeof(float) * 2 * particleCount);
+	REFRESH_GetBufferData(device, particleBuffers->buffers[1], particleBuffers->velocities, sizeof(float) * 2 * particleCount);
+	REFRESH_GetBufferData(device, particleBuffers->buffers[2], particleBuffers->gradientPositions, sizeof(float) * particleCount);
+
+	streams[0] = (const uint8_t*) particleBuffers->positions;
+	streams[1] = (const uint8_t*) particleBuffers->velocities;
+	streams[2] = (const uint8_t*) particleBuffers->gradientPositions;
+	ParticleLayout_DecodeStreams(PARTICLE_LAYOUT_SPLIT, streams, particleCount, particles);
+}
+
+void ParticleLayout_DecodeStreams(
+	ParticleLayout layout,
+	const uint8_t *const *streams,
+	uint32_t particleCount,
+	Particle *particles
+) {
+	const float *positions, *velocities, *gradientPositions;
+	uint32_t i;
+
+	if (layout == PARTICLE_LAYOUT_INTERLEAVED)
+	{
+		SDL_memcpy(particles, streams[0], sizeof(Particle) * particleCount);
+		return;
+	}
+
+	if (layout == PARTICLE_LAYOUT_QUANTIZED)
+	{
+		ParticleQuantize_Decode((const QuantizedParticle*) streams[0], particles, particleCount);
+		return;
+	}
+
+	positions = (const float*) streams[0];
+	velocities = (const float*) streams[1];
+	gradientPositions = (const float*) streams[2];
+
+	for (i = 0; i < particleCount; i += 1)
+	{
+		particles[i].xPosition = positions[i * 2 + 0];
+		particles[i].yPosition = positions[i * 2 + 1];
+		particles[i].xVelocity = velocities[i * 2 + 0];
+		particles[i].yVelocity = velocities[i * 2 + 1];
+		particles[i].gradientPosition = gradientPositions[i];
+		particles[i].life = 0;
+		particles[i].dummy2 = 0;
+		particles[i].dummy3 = 0;
+	}
+}
+
+void ParticleBuffers_GetVertexInput(ParticleLayout layout, ParticleVertexInput *vertexInput)
+{
+	if (layout == PARTICLE_LAYOUT_SPLIT)
+	{
+		vertexInput->bindings[0].binding = 0;
+		vertexInput->bindings[0].inputRate = REFRESH_VERTEXINPUTRATE_VERTEX;
+		vertexInput->bindings[0].stride = sizeof(float) * 2;
+
+		vertexInput->bindings[1].binding = 1;
+		vertexInput->bindings[1].inputRate = REFRESH_VERTEXINPUTRATE_VERTEX;
+		vertexInput->bindings[1].stride = sizeof(float);
+
+		vertexInput->attributes[0].binding = 0;
+		vertexInput->attributes[0].location = 0;
+		vertexInput->attributes[0].format = REFRESH_VERTEXELEMENTFORMAT_VECTOR2;
+		vertexInput->attributes[0].offset = 0;
+
+		vertexInput->attributes[1].binding = 1;
+		vertexInput->attributes[1].location = 1;
+		vertexInput->attributes[1].format = REFRESH_VERTEXELEMENTFORMAT_SINGLE;
+		vertexInput->attributes[1].offset = 0;
+
+		vertexInput->state.vertexBindingCount = 2;
+	}
+	else if (layout == PARTICLE_LAYOUT_QUANTIZED)
+	{
+		/* particle_split.vert takes the first component of the gradient pair */
+		vertexInput->bindings[0].binding = 0;
+		vertexInput->bindings[0].inputRate = REFRESH_VERTEXINPUTRATE_VERTEX;
+		vertexInput->bindings[0].stride = sizeof(QuantizedParticle);
+
+		vertexInput->attributes[0].binding = 0;
+		vertexInput->attributes[0].location = 0;
+		vertexInput->attributes[0].format = REFRESH_VERTEXELEMENTFORMAT_NORMALIZEDSHORT2;
+		vertexInput->attributes[0].offset = 0;
+
+		vertexInput->attributes[1].binding = 0;
+		vertexInput->attributes[1].location = 1;
+		vertexInput->attributes[1].format = REFRESH_VERTEXELEMENTFORMAT_NORMALIZEDSHORT2;
+		vertexInput->attributes[1].offset = sizeof(int16_t) * 4;
+
+		vertexInput->state.vertexBindingCount = 1;
+	}
+	else
+	{
+		vertexInput->bindings[0].binding = 0;
+		vertexInput->bindings[0].inputRate = REFRESH_VERTEXINPUTRATE_VERTEX;
+		vertexInput->bindings[0].stride = sizeof(Particle);
+
+		vertexInput->attributes[0].binding = 0;
+		vertexInput->attributes[0].location = 0;
+		vertexInput->attributes[0].format = REFRESH_VERTEXELEMENTFORMAT_VECTOR2;
+		vertexInput->attributes[0].offset = 0;
+
+		vertexInput->attributes[1].binding = 0;
+		vertexInput->attributes[1].location = 1;
+		vertexInput->attributes[1].format = REFRESH_VERTEXELEMENTFORMAT_VECTOR4;
+		vertexInput->attributes[1].offset = sizeof(float) * 4;
+
+		vertexInput->state.vertexBindingCount = 1;
+	}
+
+	vertexInput->state.vertexBindings = vertexInput->bindings;
+	vertexInput->state.vertexAttributes = vertexInput->attributes;
+	vertexInput->state.vertexAttributeCount = 2;
+}
+
+const char* ParticleLayout_GetName(ParticleLayout layout)
+{
+	switch (layout)
+	{
+	case PARTICLE_LAYOUT_INTERLEAVED:
+		return "interleaved";
+	case PARTICLE_LAYOUT_SPLIT:
+		return "split";
+	case PARTICLE_LAYOUT_QUANTIZED:
+		return "quantized";
+	}
+	return "unknown";
+}
+
+const char* ParticleLayout_GetComputeShaderPath(ParticleLayout layout)
+{
+	switch (layout)
+	{
+	case PARTICLE_LAYOUT_SPLIT:
+		return "particle_split.comp.spv";
+	case PARTICLE_LAYOUT_QUANTIZED:
+		return "particle_quantized.comp.spv";
+	default:
+		return "particle.comp.spv";
+	}
+}
+
+const char* ParticleLayout_GetSubstepShaderPath(ParticleLayout layout)
+{
+	switch (layout)
+	{
+	case PARTICLE_LAYOUT_SPLIT:
+		return "particle_split_substep.comp.spv";
+	case PARTICLE_LAYOUT_QUANTIZED:
+		return "particle_quantized_substep.comp.spv";
+	default:
+		return "particle_substep.comp.spv";
+	}
+}
+
+const char* ParticleLayout_GetInitShaderPath(ParticleLayout layout)
+{
+	switch (layout)
+	{
+	case PARTICLE_LAYOUT_SPLIT:
+		return "particle_split_init.comp.spv";
+	case PARTICLE_LAYOUT_QUANTIZED:
+		return "particle_quantized_init.comp.spv";
+	default:
+		return "particle_init.comp.spv";
+	}
+}
+
+const char* ParticleLayout_GetVertexShaderPath(ParticleLayout layout)
+{
+	return (layout == PARTICLE_LAYOUT_INTERLEAVED) ? "particle.vert.spv" : "particle_split.vert.spv";
+}
@@ -0,0 +1,103 @@
+#ifndef PARTICLE_BUFFERS_H
+#define PARTICLE_BUFFERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <Refresh.h>
+
+#include "particle.h"
+#include "particle_quantize.h"
+#include "shader_module.h"
+
+/* The GPU-side storage for one particle system in a given ParticleLayout.
+ *
+ * Whatever the layout, data moves in and out as Particle arrays so that the
+ * CPU backend, validation and checksums do not need to care.
+ */
+
+#define MAX_PARTICLE_BUFFERS 3
+#define MAX_PARTICLE_VERTEX_ATTRIBUTES 2
+
+typedef struct ParticleBuffers
+{
+	ParticleLayout layout;
+	uint32_t particleCount;
+
+	/* In compute binding order */
+	REFRESH_Buffer *buffers[MAX_PARTICLE_BUFFERS];
+	uint32_t bufferSizes[MAX_PARTICLE_BUFFERS]; /* in bytes */
+	uint32_t bufferCount;
+
+	/* The subset the vertex shader reads, in vertex binding order */
+	REFRESH_Buffer *vertexBuffers[MAX_PARTICLE_VERTEX_ATTRIBUTES];
+	uint64_t vertexOffsets[MAX_PARTICLE_VERTEX_ATTRIBUTES];
+	uint32_t vertexBufferCount;
+
+	/* Staging for the split layout */
+	float *positions;
+	float *velocities;
+	float *gradientPositions;
+
+	/* Staging for the quantized layout */
+	QuantizedParticle *quantized;
+} ParticleBuffers;
+
+typedef struct ParticleVertexInput
+{
+	REFRESH_VertexBinding bindings[MAX_PARTICLE_VERTEX_ATTRIBUTES];
+	REFRESH_VertexAttribute attributes[MAX_PARTICLE_VERTEX_ATTRIBUTES];
+	REFRESH_VertexInputState state;
+} ParticleVertexInput;
+
+ParticleBuffers* ParticleBuffers_Create(REFRESH_Device *device, ParticleLayout layout, uint32_t particleCount);
+void ParticleBuffers_Destroy(REFRESH_Device *device, ParticleBuffers *particleBuffers);
+
+/* Uploads every stream, encoding to the quantized layout if need be */
+void ParticleBuffers_Upload(REFRESH_Device *device, ParticleBuffers *particleBuffers, const Particle *particles);
+
+/* Writes the Particle_InitializeArray state for seed with
+ * particle_init.comp instead of uploading it, so nothing goes through
+ * staging. Submits and waits. Returns false if the shader could not be
+ * loaded.
+ */
+bool ParticleBuffers_InitializeOnDevice(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ParticleBuffers *particleBuffers,
+	uint32_t seed
+);
+
+/* Split layout only: uploads the positions and gradientPositions staging
+ * arrays, which is all the vertex shader reads. Used when simulation happens
+ * on the CPU and the GPU copy of velocity is never read.
+ */
+void ParticleBuffers_UploadRenderStreams(REFRESH_Device *device, ParticleBuffers *particleBuffers);
+
+/* Reads every stream back, decoding the quantized layout; the caller is
+ * responsible for synchronization
+ */
+void ParticleBuffers_Download(REFRESH_Device *device, ParticleBuffers *particleBuffers, Particle *particles);
+
+/* Decodes the layout's streams, laid out as in the device buffers, into
+ * Particles. Fields the layout does not store come back as zero.
+ */
+void ParticleLayout_DecodeStreams(
+	ParticleLayout layout,
+	const uint8_t *const *streams,
+	uint32_t particleCount,
+	Particle *particles
+);
+
+/* Fills in the vertex bindings and attributes for the layout's vertex shader.
+ * state points into the struct itself, so it must not be copied afterwards.
+ */
+void ParticleBuffers_GetVertexInput(ParticleLayout layout, ParticleVertexInput *vertexInput);
+
+const char* ParticleLayout_GetName(ParticleLayout layout);
+const char* ParticleLayout_GetComputeShaderPath(ParticleLayout layout);
+const char* ParticleLayout_GetSubstepShaderPath(ParticleLayout layout);
+const char* ParticleLayout_GetInitShaderPath(ParticleLayout layout);
+const char* ParticleLayout_GetVertexShaderPath(ParticleLayout layout);
+
+#endif /* PARTICLE_BUFFERS_H */
@@ -0,0 +1,1210 @@
+#include "particle_mesh.h"
+
+#include <SDL.h>
+
+#include "bench.h"
+#include "simd.h"
+
+#define PARTICLE_MESH_GRAIN_SIZE 256
+
+/* Particles located at once before their cells are touched */
+#define PARTICLE_MESH_BLOCK_SIZE 64
+
+/* Columns per FFT task, a multiple of every vector width */
+#define PARTICLE_MESH_COLUMN_GRAIN 8
+
+/* Solves timed per grid size in ParticleMesh_LogSweep */
+#define PARTICLE_MESH_SWEEP_REPEATS 5
+
+struct ParticleMesh
+{
+	ThreadPool *pool;
+	uint32_t capacity;
+	uint32_t vectorWidth;
+
+	uint32_t gridSize;
+	uint32_t paddedSize;
+	uint32_t paddedLog2;
+	float cellSize;
+	float invCellSize;
+
+	SDL_atomic_t *density; /* [gridSize^2], fixed point mass per cell */
+
+	/* paddedSize rows of gridSize columns. The columns past gridSize are
+	 * always zero in the density and never needed in the potential, so
+	 * they are left out; after a solve the first gridSize rows hold the
+	 * potential.
+	 */
+	float *spectrumRe;
+	float *spectrumIm;
+
+	float *kernelSpectrum; /* [paddedSize^2] */
+	float *twiddles;       /* [paddedSize / 2][2] */
+
+	/* The twiddles of the stage with half span m at [m, 2m) */
+	float *stageRe;
+	float *stageIm;
+	float *stageImInverse;
+
+	uint32_t *bitReverse; /* [paddedSize] */
+
+	float *forceX; /* [gridSize^2] */
+	float *forceY;
+
+	ParticleMeshTimings timings;
+};
+
+typedef struct ParticleMeshContext
+{
+	ParticleMesh *mesh;
+	const float *xPosition;
+	const float *yPosition;
+	float *xVelocity;
+	float *yVelocity;
+	float deltaTime;
+} ParticleMeshContext;
+
+/* Cloud-in-cell location of one particle: the cell whose center is the
+ * nearest one below and left of it, and how far past that center it is.
+ * Particles in the outer half cell are clamped onto the edge centers.
+ */
+
+static void ParticleMesh_LocateOne(
+	const ParticleMesh *mesh,
+	float x,
+	float y,
+	uint32_t *cell,
+	float *fractionX,
+	float *fractionY
+) {
+	float maxCoordinate = (float) (mesh->gridSize - 1);
+	float maxBase = (float) (mesh->gridSize - 2);
+	float gridX = (x + 1.0f) * mesh->invCellSize - 0.5f;
+	float gridY = (y + 1.0f) * mesh->invCellSize - 0.5f;
+	float baseX, baseY;
+
+	gridX = SDL_max(SDL_min(gridX, maxCoordinate), 0.0f);
+	gridY = SDL_max(SDL_min(gridY, maxCoordinate), 0.0f);
+	baseX = SDL_min((float) (int32_t) gridX, maxBase);
+	baseY = SDL_min((float) (int32_t) gridY, maxBase);
+
+	*cell = (uint32_t) (baseY * (float) mesh->gridSize + baseX);
+	*fractionX = gridX - baseX;
+	*fractionY = gridY - baseY;
+}
+
+static void ParticleMesh_Locate_Scalar(
+	const ParticleMesh *mesh,
+	const float *xPosition,
+	const float *yPosition,
+	uint32_t start,
+	uint32_t end,
+	uint32_t *cell,
+	float *fractionX,
+	float *fractionY
+) {
+	uint32_t i;
+
+	for (i = start; i < end; i += 1)
+	{
+		ParticleMesh_LocateOne(mesh, xPosition[i], yPosition[i], &cell[i], &fractionX[i], &fractionY[i]);
+	}
+}
+
+static int ParticleMesh_FixedWeight(float weight)
+{
+	return (int) (weight * PARTICLE_MESH_FIXED_SCALE + 0.5f);
+}
+
+static void ParticleMesh_Deposit(SDL_atomic_t *density, uint32_t gridSize, uint32_t cell, float fractionX, float fractionY)
+{
+	float restX = 1.0f - fractionX;
+	float restY = 1.0f - fractionY;
+
+	SDL_AtomicAdd(&density[cell], ParticleMesh_FixedWeight(restX * restY));
+	SDL_AtomicAdd(&density[cell + 1], ParticleMesh_FixedWeight(fractionX * restY));
+	SDL_AtomicAdd(&density[cell + gridSize], ParticleMesh_FixedWeight(restX * fractionY));
+	SDL_AtomicAdd(&density[cell + gridSize + 1], ParticleMesh_FixedWeight(fractionX * fractionY));
+}
+
+static float ParticleMesh_Interpolate(const float *field, uint32_t gridSize, uint32_t cell, float fractionX, float fractionY)
+{
+	float restX = 1.0f - fractionX;
+	float restY = 1.0f - fractionY;
+
+	return (field[cell] * restX + field[cell + 1] * fractionX) * restY +
+		(field[cell + gridSize] * restX + field[cell + gridSize + 1] * fractionX) * fractionY;
+}
+
+/* Radix-2 butterflies over count consecutive element pairs:
+ * a' = a + w * b, b' = a - w * b. A twiddleStride of 0 uses one twiddle
+ * for every pair (the column passes), 1 steps through a twiddle array
+ * alongside the data (the row passes).
+ */
+
+static void ParticleMesh_Butterfly_Scalar(
+	float *aRe,
+	float *aIm,
+	float *bRe,
+	float *bIm,
+	const float *twiddleRe,
+	const float *twiddleIm,
+	uint32_t twiddleStride,
+	uint32_t start,
+	uint32_t end
+) {
+	uint32_t i;
+
+	for (i = start; i < end; i += 1)
+	{
+		float wRe = twiddleRe[i * twiddleStride];
+		float wIm = twiddleIm[i * twiddleStride];
+		float tRe = wRe * bRe[i] - wIm * bIm[i];
+		float tIm = wRe * bIm[i] + wIm * bRe[i];
+
+		bRe[i] = aRe[i] - tRe;
+		bIm[i] = aIm[i] - tIm;
+		aRe[i] = aRe[i] + tRe;
+		aIm[i] = aIm[i] + tIm;
+	}
+}
+
+#ifdef SIMD_X86
+
+/* SSE2 kernels, 4 lanes per iteration */
+
+SIMD_TARGET_SSE2
+static void ParticleMesh_Locate_SSE2(
+	const ParticleMesh *mesh,
+	const float *xPosition,
+	const float *yPosition,
+	uint32_t start,
+	uint32_t end,
+	uint32_t *cell,
+	float *fractionX,
+	float *fractionY
+) {
+	uint32_t i;
+	uint32_t vectorEnd = start + ((end - start) & ~3u);
+
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 invCellSize = _mm_set1_ps(mesh->invCellSize);
+	const __m128 maxCoordinate = _mm_set1_ps((float) (mesh->gridSize - 1));
+	const __m128 maxBase = _mm_set1_ps((float) (mesh->gridSize - 2));
+	const __m128 gridSize = _mm_set1_ps((float) mesh->gridSize);
+
+	for (i = start; i < vectorEnd; i += 4)
+	{
+		__m128 gridX = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_loadu_ps(xPosition + i), one), invCellSize), half);
+		__m128 gridY = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_loadu_ps(yPosition + i), one), invCellSize), half);
+
+		gridX = _mm_max_ps(_mm_min_ps(gridX, maxCoordinate), zero);
+		gridY = _mm_max_ps(_mm_min_ps(gridY, maxCoordinate), zero);
+
+		__m128 baseX = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(gridX)), maxBase);
+		__m128 baseY = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(gridY)), maxBase);
+
+		/* Exact in float: the cell count is far below 2^24 */
+		_mm_storeu_si128((__m128i*) (cell + i), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(baseY, gridSize), baseX)));
+		_mm_storeu_ps(fractionX + i, _mm_sub_ps(gridX, baseX));
+		_mm_storeu_ps(fractionY + i, _mm_sub_ps(gridY, baseY));
+	}
+
+	ParticleMesh_Locate_Scalar(mesh, xPosition, yPosition, vectorEnd, end, cell, fractionX, fractionY);
+}
+
+SIMD_TARGET_SSE2
+static void ParticleMesh_Butterfly_SSE2(
+	float *aRe,
+	float *aIm,
+	float *bRe,
+	float *bIm,
+	const float *twiddleRe,
+	const float *twiddleIm,
+	uint32_t twiddleStride,
+	uint32_t count
+) {
+	uint32_t i;
+	uint32_t vectorEnd = count & ~3u;
+	__m128 wRe = _mm_set1_ps(twiddleRe[0]);
+	__m128 wIm = _mm_set1_ps(twiddleIm[0]);
+
+	for (i = 0; i < vectorEnd; i += 4)
+	{
+		if (twiddleStride != 0)
+		{
+			wRe = _mm_loadu_ps(twiddleRe + i);
+			wIm = _mm_loadu_ps(twiddleIm + i);
+		}
+
+		__m128 aR = _mm_loadu_ps(aRe + i);
+		__m128 aI = _mm_loadu_ps(aIm + i);
+		__m128 bR = _mm_loadu_ps(bRe + i);
+		__m128 bI = _mm_loadu_ps(bIm + i);
+		__m128 tRe = _mm_sub_ps(_mm_mul_ps(wRe, bR), _mm_mul_ps(wIm, bI));
+		__m128 tIm = _mm_add_ps(_mm_mul_ps(wRe, bI), _mm_mul_ps(wIm, bR));
+
+		_mm_storeu_ps(bRe + i, _mm_sub_ps(aR, tRe));
+		_mm_storeu_ps(bIm + i, _mm_sub_ps(aI, tIm));
+		_mm_storeu_ps(aRe + i, _mm_add_ps(aR, tRe));
+		_mm_storeu_ps(aIm + i, _mm_add_ps(aI, tIm));
+	}
+
+	ParticleMesh_Butterfly_Scalar(aRe, aIm, bRe, bIm, twiddleRe, twiddleIm, twiddleStride, vectorEnd, count);
+}
+
+/* AVX2 kernels, 8 lanes per iteration, without FMA (simd.h) */
+
+SIMD_TARGET_AVX2
+static void ParticleMesh_Locate_AVX2(
+	const ParticleMesh *mesh,
+	const float *xPosition,
+	const float *yPosition,
+	uint32_t start,
+	uint32_t end,
+	uint32_t *cell,
+	float *fractionX,
+	float *fractionY
+) {
+	uint32_t i;
+	uint32_t vectorEnd = start + ((end - start) & ~7u);
+
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 invCellSize = _mm256_set1_ps(mesh->invCellSize);
+	const __m256 maxCoordinate = _mm256_set1_ps((float) (mesh->gridSize - 1));
+	const __m256 maxBase = _mm256_set1_ps((float) (mesh->gridSize - 2));
+	const __m256 gridSize = _mm256_set1_ps((float) mesh->gridSize);
+
+	for (i = start; i < vectorEnd; i += 8)
+	{
+		__m256 gridX = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(xPosition + i), one), invCellSize), half);
+		__m256 gridY = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(yPosition + i), one), invCellSize), half);
+
+		gridX = _mm256_max_ps(_mm256_min_ps(gridX, maxCoordinate), zero);
+		gridY = _mm256_max_ps(_mm256_min_ps(gridY, maxCoordinate), zero);
+
+		__m256 baseX = _mm256_min_ps(_mm256_cvtepi32_ps(_mm256_cvttps_epi32(gridX)), maxBase);
+		__m256 baseY = _mm256_min_ps(_mm256_cvtepi32_ps(_mm256_cvttps_epi32(gridY)), maxBase);
+
+		_mm256_storeu_si256((__m256i*) (cell + i), _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(baseY, gridSize), baseX)));
+		_mm256_storeu_ps(fractionX + i, _mm256_sub_ps(gridX, baseX));
+		_mm256_storeu_ps(fractionY + i, _mm256_sub_ps(gridY, baseY));
+	}
+
+	ParticleMesh_Locate_Scalar(mesh, xPosition, yPosition, vectorEnd, end, cell, fractionX, fractionY);
+}
+
+SIMD_TARGET_AVX2
+static void ParticleMesh_Butterfly_AVX2(
+	float *aRe,
+	float *aIm,
+	float *bRe,
+	float *bIm,
+	const float *twiddleRe,
+	const float *twiddleIm,
+	uint32_t twiddleStride,
+	uint32_t count
+) {
+	uint32_t i;
+	uint32_t vectorEnd = count & ~7u;
+	__m256 wRe = _mm256_set1_ps(twiddleRe[0]);
+	__m256 wIm = _mm256_set1_ps(twiddleIm[0]);
+
+	for (i = 0; i < vectorEnd; i += 8)
+	{
+		if (twiddleStride != 0)
+		{
+			wRe = _mm256_loadu_ps(twiddleRe + i);
+			wIm = _mm256_loadu_ps(twiddleIm + i);
+		}
+
+		__m256 aR = _mm256_loadu_ps(aRe + i);
+		__m256 aI = _mm256_loadu_ps(aIm + i);
+		__m256 bR = _mm256_loadu_ps(bRe + i);
+		__m256 bI = _mm256_loadu_ps(bIm + i);
+		__m256 tRe = _mm256_sub_ps(_mm256_mul_ps(wRe, bR), _mm256_mul_ps(wIm, bI));
+		__m256 tIm = _mm256_add_ps(_mm256_mul_ps(wRe, bI), _mm256_mul_ps(wIm, bR));
+
+		_mm256_storeu_ps(bRe + i, _mm256_sub_ps(aR, tRe));
+		_mm256_storeu_ps(bIm + i, _mm256_sub_ps(aI, tIm));
+		_mm256_storeu_ps(aRe + i, _mm256_add_ps(aR, tRe));
+		_mm256_storeu_ps(aIm + i, _mm256_add_ps(aI, tIm));
+	}
+
+	ParticleMesh_Butterfly_Scalar(aRe, aIm, bRe, bIm, twiddleRe, twiddleIm, twiddleStride, vectorEnd, count);
+}
+
+#endif /* SIMD_X86 */
+
+static void ParticleMesh_Locate(
+	const ParticleMesh *mesh,
+	const float *xPosition,
+	const float *yPosition,
+	uint32_t start,
+	uint32_t end,
+	uint32_t *cell,
+	float *fractionX,
+	float *fractionY
+) {
+	switch (mesh->vectorWidth)
+	{
+#ifdef SIMD_X86
+	case 8:
+		ParticleMesh_Locate_AVX2(mesh, xPosition, yPosition, start, end, cell, fractionX, fractionY);
+		break;
+
+	case 4:
+		ParticleMesh_Locate_SSE2(mesh, xPosition, yPosition, start, end, cell, fractionX, fractionY);
+		break;
+#endif
+
+	default:
+		ParticleMesh_Locate_Scalar(mesh, xPosition, yPosition, start, end, cell, fractionX, fractionY);
+		break;
+	}
+}
+
+static void ParticleMesh_Butterfly(
+	const ParticleMesh *mesh,
+	float *aRe,
+	float *aIm,
+	float *bRe,
+	float *bIm,
+	const float *twiddleRe,
+	const float *twiddleIm,
+	uint32_t twiddleStride,
+	uint32_t count
+) {
+	/* The narrow stages of a row would only run the scalar tail anyway */
+	switch ((count >= mesh->vectorWidth) ? mesh->vectorWidth : 1)
+	{
+#ifdef SIMD_X86
+	case 8:
+		ParticleMesh_Butterfly_AVX2(aRe, aIm, bRe, bIm, twiddleRe, twiddleIm, twiddleStride, count);
+		break;
+
+	case 4:
+		ParticleMesh_Butterfly_SSE2(aRe, aIm, bRe, bIm, twiddleRe, twiddleIm, twiddleStride, count);
+		break;
+#endif
+
+	default:
+		ParticleMesh_Butterfly_Scalar(aRe, aIm, bRe, bIm, twiddleRe, twiddleIm, twiddleStride, 0, count);
+		break;
+	}
+}
+
+/* In-place FFT of paddedSize elements spaced stride apart, already in bit
+ * reversed order. Scalar and one butterfly at a time; used for the kernel
+ * and by the reference.
+ */
+static void ParticleMesh_TransformLine(const ParticleMesh *mesh, float *re, float *im, uint32_t stride, bool inverse)
+{
+	const float *stageIm = inverse ? mesh->stageImInverse : mesh->stageIm;
+	uint32_t span, k, j, a, b;
+
+	for (span = 1; span < mesh->paddedSize; span *= 2)
+	{
+		for (k = 0; k < mesh->paddedSize; k += span * 2)
+		{
+			for (j = 0; j < span; j += 1)
+			{
+				a = (k + j) * stride;
+				b = (k + j + span) * stride;
+				ParticleMesh_Butterfly_Scalar(&re[a], &im[a], &re[b], &im[b], &mesh->stageRe[span + j], &stageIm[span + j], 0, 0, 1);
+			}
+		}
+	}
+}
+
+/* Creation */
+
+/* Transforms the softened 1/r kernel once. It is even in both axes, so its
+ * spectrum is real.
+ */
+static void ParticleMesh_BuildKernel(ParticleMesh *mesh, float gravity)
+{
+	uint32_t x, y, offsetX, offsetY;
+	uint32_t paddedSize = mesh->paddedSize;
+	float *re = SDL_calloc(paddedSize * paddedSize, sizeof(float));
+	float *im = SDL_calloc(paddedSize * paddedSize, sizeof(float));
+	double scale = (double) gravity /
+		((double) SDL_max(mesh->capacity, 1) * PARTICLE_MESH_FIXED_SCALE * paddedSize * paddedSize);
+
+	/* Offsets past half the padded size wrap around to negative ones */
+	for (y = 0; y < paddedSize; y += 1)
+	{
+		offsetY = SDL_min(y, paddedSize - y);
+
+		for (x = 0; x < paddedSize; x += 1)
+		{
+			offsetX = SDL_min(x, paddedSize - x);
+
+			double distance2 = (double) (offsetX * offsetX + offsetY * offsetY) * mesh->cellSize * mesh->cellSize;
+			re[mesh->bitReverse[y] * paddedSize + mesh->bitReverse[x]] = (float) (
+				-1.0 / SDL_sqrt(distance2 + (double) PARTICLE_MESH_SOFTENING * PARTICLE_MESH_SOFTENING)
+			);
+		}
+	}
+
+	for (y = 0; y < paddedSize; y += 1)
+	{
+		ParticleMesh_TransformLine(mesh, &re[y * paddedSize], &im[y * paddedSize], 1, false);
+	}
+	for (x = 0; x < paddedSize; x += 1)
+	{
+		ParticleMesh_TransformLine(mesh, &re[x], &im[x], paddedSize, false);
+	}
+
+	for (x = 0; x < paddedSize * paddedSize; x += 1)
+	{
+		mesh->kernelSpectrum[x] = (float) (re[x] * scale);
+	}
+
+	SDL_free(re);
+	SDL_free(im);
+}
+
+ParticleMesh* ParticleMesh_Create(
+	uint32_t particleCount,
+	uint32_t gridSize,
+	float gravity,
+	uint32_t maxVectorWidth,
+	ThreadPool *pool
+) {
+	uint32_t i, bit, span;
+	ParticleMesh *mesh = SDL_malloc(sizeof(ParticleMesh));
+
+	SDL_assert(gridSize >= PARTICLE_MESH_MIN_SIZE && gridSize <= PARTICLE_MESH_MAX_SIZE);
+	SDL_assert((gridSize & (gridSize - 1)) == 0);
+
+	SDL_zerop(mesh);
+	mesh->pool = pool;
+	mesh->capacity = particleCount;
+	mesh->vectorWidth = Simd_ResolveVectorWidth(maxVectorWidth);
+
+	mesh->gridSize = gridSize;
+	mesh->paddedSize = gridSize * 2;
+	while ((1u << mesh->paddedLog2) < mesh->paddedSize)
+	{
+		mesh->paddedLog2 += 1;
+	}
+	mesh->cellSize = 2.0f / gridSize;
+	mesh->invCellSize = gridSize / 2.0f;
+
+	mesh->density = SDL_malloc(sizeof(SDL_atomic_t) * gridSize * gridSize);
+	mesh->spectrumRe = SDL_malloc(sizeof(float) * mesh->paddedSize * gridSize);
+	mesh->spectrumIm = SDL_malloc(sizeof(float) * mesh->paddedSize * gridSize);
+	mesh->kernelSpectrum = SDL_malloc(sizeof(float) * mesh->paddedSize * mesh->paddedSize);
+	mesh->twiddles = SDL_malloc(sizeof(float) * mesh->paddedSize);
+	mesh->stageRe = SDL_malloc(sizeof(float) * mesh->paddedSize);
+	mesh->stageIm = SDL_malloc(sizeof(float) * mesh->paddedSize);
+	mesh->stageImInverse = SDL_malloc(sizeof(float) * mesh->paddedSize);
+	mesh->bitReverse = SDL_malloc(sizeof(uint32_t) * mesh->paddedSize);
+	mesh->forceX = SDL_malloc(sizeof(float) * gridSize * gridSize);
+	mesh->forceY = SDL_malloc(sizeof(float) * gridSize * gridSize);
+
+	for (i = 0; i < mesh->paddedSize; i += 1)
+	{
+		mesh->bitReverse[i] = 0;
+		for (bit = 0; bit < mesh->paddedLog2; bit += 1)
+		{
+			mesh->bitReverse[i] |= ((i >> bit) & 1) << (mesh->paddedLog2 - 1 - bit);
+		}
+	}
+
+	for (i = 0; i < mesh->paddedSize / 2; i += 1)
+	{
+		double angle = -2.0 * 3.14159265358979323846 * i / mesh->paddedSize;
+		mesh->twiddles[i * 2 + 0] = (float) SDL_cos(angle);
+		mesh->twiddles[i * 2 + 1] = (float) SDL_sin(angle);
+	}
+
+	/* Stage tables copy the shared twiddles exactly, so every path and the
+	 * GPU multiply by the same values.
+	 */
+	for (span = 1; span < mesh->paddedSize; span *= 2)
+	{
+		for (i = 0; i < span; i += 1)
+		{
+			uint32_t twiddle = i * (mesh->paddedSize / (span * 2));
+			mesh->stageRe[span + i] = mesh->twiddles[twiddle * 2 + 0];
+			mesh->stageIm[span + i] = mesh->twiddles[twiddle * 2 + 1];
+			mesh->stageImInverse[span + i] = -mesh->twiddles[twiddle * 2 + 1];
+		}
+	}
+
+	ParticleMesh_BuildKernel(mesh, gravity);
+
+	return mesh;
+}
+
+void ParticleMesh_Destroy(ParticleMesh *mesh)
+{
+	if (mesh == NULL)
+	{
+		return;
+	}
+
+	SDL_free(mesh->density);
+	SDL_free(mesh->spectrumRe);
+	SDL_free(mesh->spectrumIm);
+	SDL_free(mesh->kernelSpectrum);
+	SDL_free(mesh->twiddles);
+	SDL_free(mesh->stageRe);
+	SDL_free(mesh->stageIm);
+	SDL_free(mesh->stageImInverse);
+	SDL_free(mesh->bitReverse);
+	SDL_free(mesh->forceX);
+	SDL_free(mesh->forceY);
+	SDL_free(mesh);
+}
+
+uint32_t ParticleMesh_GetGridSize(ParticleMesh *mesh)
+{
+	return mesh->gridSize;
+}
+
+uint32_t ParticleMesh_GetVectorWidth(ParticleMesh *mesh)
+{
+	return mesh->vectorWidth;
+}
+
+void ParticleMesh_FillUniforms(
+	ParticleMesh *mesh,
+	ParticleMeshUniforms *uniforms,
+	uint32_t particleCount,
+	float deltaTime
+) {
+	uniforms->deltaTime = deltaTime;
+	uniforms->invCellSize = mesh->invCellSize;
+	uniforms->cellSize = mesh->cellSize;
+	uniforms->particleCount = particleCount;
+	uniforms->gridSize = mesh->gridSize;
+	uniforms->paddedSize = mesh->paddedSize;
+	uniforms->paddedShift = 32 - mesh->paddedLog2;
+	uniforms->fftPass = PARTICLE_MESH_FFT_COLUMNS_FORWARD;
+}
+
+const float* ParticleMesh_GetKernelSpectrum(ParticleMesh *mesh)
+{
+	return mesh->kernelSpectrum;
+}
+
+const float* ParticleMesh_GetTwiddles(ParticleMesh *mesh)
+{
+	return mesh->twiddles;
+}
+
+/* Threaded passes, one ThreadPool_ParallelFor each, mirroring particle_mesh.comp */
+
+static void ParticleMesh_ParallelFor(ParticleMesh *mesh, uint32_t count, uint32_t grainSize, ThreadPoolRangeFunc func, void *userdata)
+{
+	if (mesh->pool == NULL)
+	{
+		func(userdata, 0, count);
+	}
+	else
+	{
+		ThreadPool_ParallelFor(mesh->pool, count, grainSize, func, userdata);
+	}
+}
+
+static void ParticleMesh_DepositRange(void *userdata, uint32_t start, uint32_t end)
+{
+	ParticleMeshContext *context = (ParticleMeshContext*) userdata;
+	ParticleMesh *mesh = context->mesh;
+	uint32_t cell[PARTICLE_MESH_BLOCK_SIZE];
+	float fractionX[PARTICLE_MESH_BLOCK_SIZE];
+	float fractionY[PARTICLE_MESH_BLOCK_SIZE];
+	uint32_t blockStart, blockEnd, i;
+
+	for (blockStart = start; blockStart < end; blockStart = blockEnd)
+	{
+		blockEnd = SDL_min(blockStart + PARTICLE_MESH_BLOCK_SIZE, end);
+
+		ParticleMesh_Locate(
+			mesh,
+			context->xPosition + blockStart,
+			context->yPosition + blockStart,
+			0,
+			blockEnd - blockStart,
+			cell,
+			fractionX,
+			fractionY
+		);
+
+		for (i = 0; i < blockEnd - blockStart; i += 1)
+		{
+			ParticleMesh_Deposit(mesh->density, mesh->gridSize, cell[i], fractionX[i], fractionY[i]);
+		}
+	}
+}
+
+/* Every column of the density, zero padded to paddedSize rows, into the
+ * spectrum. Each butterfly covers the whole range of columns at once.
+ */
+static void ParticleMesh_ForwardColumnsRange(void *userdata, uint32_t start, uint32_t end)
+{
+	ParticleMesh *mesh = ((ParticleMeshContext*) userdata)->mesh;
+	uint32_t gridSize = mesh->gridSize;
+	uint32_t x, y, row, span, k, j, a, b;
+
+	for (y = 0; y < mesh->paddedSize; y += 1)
+	{
+		row = mesh->bitReverse[y] * gridSize;
+
+		for (x = start; x < end; x += 1)
+		{
+			mesh->spectrumRe[row + x] = (y < gridSize) ? (float) SDL_AtomicGet(&mesh->density[y * gridSize + x]) : 0.0f;
+			mesh->spectrumIm[row + x] = 0.0f;
+		}
+	}
+
+	for (span = 1; span < mesh->paddedSize; span *= 2)
+	{
+		for (k = 0; k < mesh->paddedSize; k += span * 2)
+		{
+			for (j = 0; j < span; j += 1)
+			{
+				a = (k + j) * gridSize + start;
+				b = (k + j + span) * gridSize + start;
+				ParticleMesh_Butterfly(
+					mesh,
+					&mesh->spectrumRe[a],
+					&mesh->spectrumIm[a],
+					&mesh->spectrumRe[b],
+					&mesh->spectrumIm[b],
+					&mesh->stageRe[span + j],
+					&mesh->stageIm[span + j],
+					0,
+					end - start
+				);
+			}
+		}
+	}
+}
+
+/* Forward along each row, times the kernel, and back again. Stages whose
+ * span is narrower than a vector run through the scalar tail.
+ */
+static void ParticleMesh_ConvolveRowsRange(void *userdata, uint32_t start, uint32_t end)
+{
+	ParticleMesh *mesh = ((ParticleMeshContext*) userdata)->mesh;
+	uint32_t gridSize = mesh->gridSize;
+	uint32_t paddedSize = mesh->paddedSize;
+	float re[PARTICLE_MESH_MAX_SIZE * 2];
+	float im[PARTICLE_MESH_MAX_SIZE * 2];
+	const float *kernel;
+	uint32_t x, y, reversed, span, k, pass;
+	float swap;
+
+	for (y = start; y < end; y += 1)
+	{
+		for (x = 0; x < paddedSize; x += 1)
+		{
+			reversed = mesh->bitReverse[x];
+			re[reversed] = (x < gridSize) ? mesh->spectrumRe[y * gridSize + x] : 0.0f;
+			im[reversed] = (x < gridSize) ? mesh->spectrumIm[y * gridSize + x] : 0.0f;
+		}
+
+		for (pass = 0; pass < 2; pass += 1)
+		{
+			for (span = 1; span < paddedSize; span *= 2)
+			{
+				for (k = 0; k < paddedSize; k += span * 2)
+				{
+					ParticleMesh_Butterfly(
+						mesh,
+						&re[k],
+						&im[k],
+						&re[k + span],
+						&im[k + span],
+						&mesh->stageRe[span],
+						(pass == 0) ? &mesh->stageIm[span] : &mesh->stageImInverse[span],
+						1,
+						span
+					);
+				}
+			}
+
+			if (pass == 1)
+			{
+				break;
+			}
+
+			kernel = &mesh->kernelSpectrum[y * paddedSize];
+			for (x = 0; x < paddedSize; x += 1)
+			{
+				re[x] = re[x] * kernel[x];
+				im[x] = im[x] * kernel[x];
+			}
+
+			for (x = 0; x < paddedSize; x += 1)
+			{
+				reversed = mesh->bitReverse[x];
+				if (reversed > x)
+				{
+					swap = re[x]; re[x] = re[reversed]; re[reversed] = swap;
+					swap = im[x]; im[x] = im[reversed]; im[reversed] = swap;
+				}
+			}
+		}
+
+		for (x = 0; x < gridSize; x += 1)
+		{
+			mesh->spectrumRe[y * gridSize + x] = re[x];
+			mesh->spectrumIm[y * gridSize + x] = im[x];
+		}
+	}
+}
+
+static void ParticleMesh_InverseColumnsRange(void *userdata, uint32_t start, uint32_t end)
+{
+	ParticleMesh *mesh = ((ParticleMeshContext*) userdata)->mesh;
+	uint32_t gridSize = mesh->gridSize;
+	uint32_t x, y, reversed, span, k, j, a, b;
+	float swap;
+
+	for (y = 0; y < mesh->paddedSize; y += 1)
+	{
+		reversed = mesh->bitReverse[y];
+		if (reversed <= y)
+		{
+			continue;
+		}
+
+		for (x = start; x < end; x += 1)
+		{
+			swap = mesh->spectrumRe[y * gridSize + x];
+			mesh->spectrumRe[y * gridSize + x] = mesh->spectrumRe[reversed * gridSize + x];
+			mesh->spectrumRe[reversed * gridSize + x] = swap;
+
+			swap = mesh->spectrumIm[y * gridSize + x];
+			mesh->spectrumIm[y * gridSize + x] = mesh->spectrumIm[reversed * gridSize + x];
+			mesh->spectrumIm[reversed * gridSize + x] = swap;
+		}
+	}
+
+	for (span = 1; span < mesh->paddedSize; span *= 2)
+	{
+		for (k = 0; k < mesh->paddedSize; k += span * 2)
+		{
+			for (j = 0; j < span; j += 1)
+			{
+				a = (k + j) * gridSize + start;
+				b = (k + j + span) * gridSize + start;
+				ParticleMesh_Butterfly(
+					mesh,
+					&mesh->spectrumRe[a],
+					&mesh->spectrumIm[a],
+					&mesh->spectrumRe[b],
+					&mesh->spectrumIm[b],
+					&mesh->stageRe[span + j],
+					&mesh->stageImInverse[span + j],
+					0,
+					end - start
+				);
+			}
+		}
+	}
+}
+
+/* Central differences of the potential, one-sided on the edges */
+static void ParticleMesh_GradientRows(
+	const ParticleMesh *mesh,
+	const float *potential,
+	float *forceX,
+	float *forceY,
+	uint32_t start,
+	uint32_t end
+) {
+	uint32_t gridSize = mesh->gridSize;
+	uint32_t x, y, low, high;
+
+	for (y = start; y < end; y += 1)
+	{
+		for (x = 0; x < gridSize; x += 1)
+		{
+			low = (x > 0) ? x - 1 : x;
+			high = (x + 1 < gridSize) ? x + 1 : x;
+			forceX[y * gridSize + x] = (potential[y * gridSize + low] - potential[y * gridSize + high]) *
+				(mesh->invCellSize / (float) (high - low));
+
+			low = (y > 0) ? y - 1 : y;
+			high = (y + 1 < gridSize) ? y + 1 : y;
+			forceY[y * gridSize + x] = (potential[low * gridSize + x] - potential[high * gridSize + x]) *
+				(mesh->invCellSize / (float) (high - low));
+		}
+	}
+}
+
+static void ParticleMesh_GradientRange(void *userdata, uint32_t start, uint32_t end)
+{
+	ParticleMesh *mesh = ((ParticleMeshContext*) userdata)->mesh;
+	ParticleMesh_GradientRows(mesh, mesh->spectrumRe, mesh->forceX, mesh->forceY, start, end);
+}
+
+static void ParticleMesh_KickRange(void *userdata, uint32_t start, uint32_t end)
+{
+	ParticleMeshContext *context = (ParticleMeshContext*) userdata;
+	ParticleMesh *mesh = context->mesh;
+	uint32_t cell[PARTICLE_MESH_BLOCK_SIZE];
+	float fractionX[PARTICLE_MESH_BLOCK_SIZE];
+	float fractionY[PARTICLE_MESH_BLOCK_SIZE];
+	uint32_t blockStart, blockEnd, i;
+
+	for (blockStart = start; blockStart < end; blockStart = blockEnd)
+	{
+		blockEnd = SDL_min(blockStart + PARTICLE_MESH_BLOCK_SIZE, end);
+
+		ParticleMesh_Locate(
+			mesh,
+			context->xPosition + blockStart,
+			context->yPosition + blockStart,
+			0,
+			blockEnd - blockStart,
+			cell,
+			fractionX,
+			fractionY
+		);
+
+		for (i = 0; i < blockEnd - blockStart; i += 1)
+		{
+			context->xVelocity[blockStart + i] += ParticleMesh_Interpolate(mesh->forceX, mesh->gridSize, cell[i], fractionX[i], fractionY[i]) * context->deltaTime;
+			context->yVelocity[blockStart + i] += ParticleMesh_Interpolate(mesh->forceY, mesh->gridSize, cell[i], fractionX[i], fractionY[i]) * context->deltaTime;
+		}
+	}
+}
+
+void ParticleMesh_Apply(
+	ParticleMesh *mesh,
+	const float *xPosition,
+	const float *yPosition,
+	float *xVelocity,
+	float *yVelocity,
+	uint32_t count,
+	float deltaTime
+) {
+	ParticleMeshContext context;
+	uint64_t start = Bench_Now();
+
+	count = SDL_min(count, mesh->capacity);
+
+	context.mesh = mesh;
+	context.xPosition = xPosition;
+	context.yPosition = yPosition;
+	context.xVelocity = xVelocity;
+	context.yVelocity = yVelocity;
+	context.deltaTime = deltaTime;
+
+	SDL_memset(mesh->density, 0, sizeof(SDL_atomic_t) * mesh->gridSize * mesh->gridSize);
+	ParticleMesh_ParallelFor(mesh, count, PARTICLE_MESH_GRAIN_SIZE, ParticleMesh_DepositRange, &context);
+	mesh->timings.depositSeconds += Bench_Seconds(start, Bench_Now());
+
+	start = Bench_Now();
+	ParticleMesh_ParallelFor(mesh, mesh->gridSize, PARTICLE_MESH_COLUMN_GRAIN, ParticleMesh_ForwardColumnsRange, &context);
+	ParticleMesh_ParallelFor(mesh, mesh->paddedSize, 1, ParticleMesh_ConvolveRowsRange, &context);
+	ParticleMesh_ParallelFor(mesh, mesh->gridSize, PARTICLE_MESH_COLUMN_GRAIN, ParticleMesh_InverseColumnsRange, &context);
+	mesh->timings.solveSeconds += Bench_Seconds(start, Bench_Now());
+
+	start = Bench_Now();
+	ParticleMesh_ParallelFor(mesh, mesh->gridSize, 1, ParticleMesh_GradientRange, &context);
+	mesh->timings.gradientSeconds += Bench_Seconds(start, Bench_Now());
+
+	start = Bench_Now();
+	ParticleMesh_ParallelFor(mesh, count, PARTICLE_MESH_GRAIN_SIZE, ParticleMesh_KickRange, &context);
+	mesh->timings.kickSeconds += Bench_Seconds(start, Bench_Now());
+
+	mesh->timings.stepCount += 1;
+}
+
+/* Reference: serial and scalar, transforming one line at a time */
+
+void ParticleMesh_ReferenceApply(ParticleMesh *mesh, Particle *particles, uint32_t count, float deltaTime)
+{
+	uint32_t gridSize = mesh->gridSize;
+	uint32_t paddedSize = mesh->paddedSize;
+	uint32_t i, x, y, cell;
+	float fractionX, fractionY;
+	SDL_atomic_t *density = SDL_calloc(gridSize * gridSize, sizeof(SDL_atomic_t));
+	float *re = SDL_calloc(paddedSize * paddedSize, sizeof(float));
+	float *im = SDL_calloc(paddedSize * paddedSize, sizeof(float));
+	float *potential = SDL_malloc(sizeof(float) * gridSize * gridSize);
+	float *forceX = SDL_malloc(sizeof(float) * gridSize * gridSize);
+	float *forceY = SDL_malloc(sizeof(float) * gridSize * gridSize);
+
+	for (i = 0; i < count; i += 1)
+	{
+		ParticleMesh_LocateOne(mesh, particles[i].xPosition, particles[i].yPosition, &cell, &fractionX, &fractionY);
+		ParticleMesh_Deposit(density, gridSize, cell, fractionX, fractionY);
+	}
+
+	/* Columns past gridSize are zero and stay zero until the row pass */
+	for (y = 0; y < gridSize; y += 1)
+	{
+		for (x = 0; x < gridSize; x += 1)
+		{
+			re[mesh->bitReverse[y] * paddedSize + x] = (float) SDL_AtomicGet(&density[y * gridSize + x]);
+		}
+	}
+
+	for (x = 0; x < gridSize; x += 1)
+	{
+		ParticleMesh_TransformLine(mesh, &re[x], &im[x], paddedSize, false);
+	}
+
+	for (y = 0; y < paddedSize; y += 1)
+	{
+		float *rowRe = &re[y * paddedSize];
+		float *rowIm = &im[y * paddedSize];
+		const float *kernel = &mesh->kernelSpectrum[y * paddedSize];
+		float swap;
+
+		for (x = 0; x < paddedSize; x += 1)
+		{
+			if (mesh->bitReverse[x] > x)
+			{
+				swap = rowRe[x]; rowRe[x] = rowRe[mesh->bitReverse[x]]; rowRe[mesh->bitReverse[x]] = swap;
+				swap = rowIm[x]; rowIm[x] = rowIm[mesh->bitReverse[x]]; rowIm[mesh->bitReverse[x]] = swap;
+			}
+		}
+
+		ParticleMesh_TransformLine(mesh, rowRe, rowIm, 1, false);
+
+		for (x = 0; x < paddedSize; x += 1)
+		{
+			rowRe[x] = rowRe[x] * kernel[x];
+			rowIm[x] = rowIm[x] * kernel[x];
+		}
+
+		for (x = 0; x < paddedSize; x += 1)
+		{
+			if (mesh->bitReverse[x] > x)
+			{
+				swap = rowRe[x]; rowRe[x] = rowRe[mesh->bitReverse[x]]; rowRe[mesh->bitReverse[x]] = swap;
+				swap = rowIm[x]; rowIm[x] = rowIm[mesh->bitReverse[x]]; rowIm[mesh->bitReverse[x]] = swap;
+			}
+		}
+
+		ParticleMesh_TransformLine(mesh, rowRe, rowIm, 1, true);
+	}
+
+	for (x = 0; x < gridSize; x += 1)
+	{
+		for (y = 0; y < paddedSize; y += 1)
+		{
+			uint32_t reversed = mesh->bitReverse[y];
+			if (reversed > y)
+			{
+				float swap;
+				swap = re[y * paddedSize + x]; re[y * paddedSize + x] = re[reversed * paddedSize + x]; re[reversed * paddedSize + x] = swap;
+				swap = im[y * paddedSize + x]; im[y * paddedSize + x] = im[reversed * paddedSize + x]; im[reversed * paddedSize + x] = swap;
+			}
+		}
+
+		ParticleMesh_TransformLine(mesh, &re[x], &im[x], paddedSize, true);
+
+		for (y = 0; y < gridSize; y += 1)
+		{
+			potential[y * gridSize + x] = re[y * paddedSize + x];
+		}
+	}
+
+	ParticleMesh_GradientRows(mesh, potential, forceX, forceY, 0, gridSize);
+
+	for (i = 0; i < count; i += 1)
+	{
+		ParticleMesh_LocateOne(mesh, particles[i].xPosition, particles[i].yPosition, &cell, &fractionX, &fractionY);
+		particles[i].xVelocity += ParticleMesh_Interpolate(forceX, gridSize, cell, fractionX, fractionY) * deltaTime;
+		particles[i].yVelocity += ParticleMesh_Interpolate(forceY, gridSize, cell, fractionX, fractionY) * deltaTime;
+	}
+
+	SDL_free(density);
+	SDL_free(re);
+	SDL_free(im);
+	SDL_free(potential);
+	SDL_free(forceX);
+	SDL_free(forceY);
+}
+
+/* Reporting */
+
+void ParticleMesh_GetTimings(ParticleMesh *mesh, ParticleMeshTimings *timings)
+{
+	*timings = mesh->timings;
+}
+
+void ParticleMesh_LogTimings(ParticleMesh *mesh)
+{
+	ParticleMeshTimings *timings = &mesh->timings;
+	double scale = (timings->stepCount > 0) ? (1000.0 / timings->stepCount) : 0.0;
+
+	SDL_Log(
+		"Particle mesh %ux%u (%u-wide), %u steps, per step: deposit %.3f ms, solve %.3f ms, gradient %.3f ms, kick %.3f ms",
+		mesh->gridSize,
+		mesh->gridSize,
+		mesh->vectorWidth,
+		timings->stepCount,
+		timings->depositSeconds * scale,
+		timings->solveSeconds * scale,
+		timings->gradientSeconds * scale,
+		timings->kickSeconds * scale
+	);
+}
+
+typedef struct ParticleMeshDirectContext
+{
+	const Particle *particles;
+	uint32_t count;
+	uint32_t sampleCount;
+	double *forceX; /* [sampleCount] */
+	double *forceY;
+} ParticleMeshDirectContext;
+
+static uint32_t ParticleMesh_SampleIndex(uint32_t sample, uint32_t sampleCount, uint32_t count)
+{
+	return (uint32_t) ((uint64_t) sample * count / sampleCount);
+}
+
+/* The exact softened force on each sample particle, per unit gravity */
+static void ParticleMesh_DirectRange(void *userdata, uint32_t start, uint32_t end)
+{
+	ParticleMeshDirectContext *context = (ParticleMeshDirectContext*) userdata;
+	double softening2 = (double) PARTICLE_MESH_SOFTENING * PARTICLE_MESH_SOFTENING;
+	uint32_t sample, j, index;
+
+	for (sample = start; sample < end; sample += 1)
+	{
+		double sumX = 0.0;
+		double sumY = 0.0;
+
+		index = ParticleMesh_SampleIndex(sample, context->sampleCount, context->count);
+
+		for (j = 0; j < context->count; j += 1)
+		{
+			double deltaX = (double) context->particles[j].xPosition - context->particles[index].xPosition;
+			double deltaY = (double) context->particles[j].yPosition - context->particles[index].yPosition;
+			double distance2 = deltaX * deltaX + deltaY * deltaY + softening2;
+			double inverseCubed = 1.0 / (distance2 * SDL_sqrt(distance2));
+
+			sumX += deltaX * inverseCubed;
+			sumY += deltaY * inverseCubed;
+		}
+
+		context->forceX[sample] = sumX / context->count;
+		context->forceY[sample] = sumY / context->count;
+	}
+}
+
+void ParticleMesh_LogSweep(
+	const Particle *particles,
+	uint32_t count,
+	float gravity,
+	uint32_t maxGridSize,
+	uint32_t sampleCount,
+	uint32_t maxVectorWidth,
+	ThreadPool *pool
+) {
+	ParticleMeshDirectContext direct;
+	ParticleMeshTimings timings;
+	ParticleMesh *mesh;
+	uint32_t i, gridSize, repeat, index;
+	double scale, errorX, errorY, error2, force2, maxError2;
+	float *xPosition = SDL_malloc(sizeof(float) * count);
+	float *yPosition = SDL_malloc(sizeof(float) * count);
+	float *xVelocity = SDL_malloc(sizeof(float) * count);
+	float *yVelocity = SDL_malloc(sizeof(float) * count);
+
+	sampleCount = SDL_max(SDL_min(sampleCount, count), 1);
+
+	for (i = 0; i < count; i += 1)
+	{
+		xPosition[i] = particles[i].xPosition;
+		yPosition[i] = particles[i].yPosition;
+	}
+
+	direct.particles = particles;
+	direct.count = count;
+	direct.sampleCount = sampleCount;
+	direct.forceX = SDL_malloc(sizeof(double) * sampleCount);
+	direct.forceY = SDL_malloc(sizeof(double) * sampleCount);
+
+	if (pool == NULL)
+	{
+		ParticleMesh_DirectRange(&direct, 0, sampleCount);
+	}
+	else
+	{
+		ThreadPool_ParallelFor(pool, sampleCount, 1, ParticleMesh_DirectRange, &direct);
+	}
+
+	force2 = 0.0;
+	for (i = 0; i < sampleCount; i += 1)
+	{
+		direct.forceX[i] *= gravity;
+		direct.forceY[i] *= gravity;
+		force2 += direct.forceX[i] * direct.forceX[i] + direct.forceY[i] * direct.forceY[i];
+	}
+	force2 = SDL_max(force2 / sampleCount, 1e-30);
+
+	SDL_Log(
+		"Particle mesh sweep: %u particles, gravity %g, softening %g, force error against direct summation at %u particles",
+		count,
+		gravity,
+		PARTICLE_MESH_SOFTENING,
+		sampleCount
+	);
+
+	for (gridSize = PARTICLE_MESH_MIN_SIZE; gridSize <= maxGridSize; gridSize *= 2)
+	{
+		mesh = ParticleMesh_Create(count, gridSize, gravity, maxVectorWidth, pool);
+
+		/* With zeroed velocities and a unit step the velocity is the force */
+		for (repeat = 0; repeat < PARTICLE_MESH_SWEEP_REPEATS; repeat += 1)
+		{
+			SDL_memset(xVelocity, 0, sizeof(float) * count);
+			SDL_memset(yVelocity, 0, sizeof(float) * count);
+			ParticleMesh_Apply(mesh, xPosition, yPosition, xVelocity, yVelocity, count, 1.0f);
+		}
+
+		error2 = 0.0;
+		maxError2 = 0.0;
+		for (i = 0; i < sampleCount; i += 1)
+		{
+			index = ParticleMesh_SampleIndex(i, sampleCount, count);
+			errorX = xVelocity[index] - direct.forceX[i];
+			errorY = yVelocity[index] - direct.forceY[i];
+			error2 += errorX * errorX + errorY * errorY;
+			maxError2 = SDL_max(maxError2, errorX * errorX + errorY * errorY);
+		}
+
+		ParticleMesh_GetTimings(mesh, &timings);
+		scale = 1000.0 / timings.stepCount;
+
+		SDL_Log(
+			"  %4ux%-4u deposit %8.3f ms  solve %8.3f ms  gradient %8.3f ms  kick %8.3f ms  rms error %6.2f%%  max error %7.2f%%",
+			gridSize,
+			gridSize,
+			timings.depositSeconds * scale,
+			timings.solveSeconds * scale,
+			timings.gradientSeconds * scale,
+			timings.kickSeconds * scale,
+			100.0 * SDL_sqrt(error2 / sampleCount / force2),
+			100.0 * SDL_sqrt(maxError2 / force2)
+		);
+
+		ParticleMesh_Destroy(mesh);
+	}
+
+	SDL_free(direct.forceX);
+	SDL_free(direct.forceY);
+	SDL_free(xPosition);
+	SDL_free(yPosition);
+	SDL_free(xVelocity);
+	SDL_free(yVelocity);
+}
@@ -0,0 +1,138 @@
+#ifndef PARTICLE_MESH_H
+#define PARTICLE_MESH_H
+
+#include <stdint.h>
+
+#include "particle.h"
+#include "thread_pool.h"
+
+/* Long-range gravity between every pair of particles, solved on a mesh.
+ *
+ * Every step deposits each particle's mass onto a gridSize x gridSize grid
+ * over the [-1, 1] square with cloud-in-cell weights, convolves the density
+ * with a softened 1/r potential through an FFT, differences the potential
+ * into a force per cell, and adds the force interpolated back at each
+ * particle to its velocity. Cost is O(N + G^2 log G) instead of O(N^2).
+ *
+ * The grid is zero padded to twice its size before the FFT so the
+ * convolution is not periodic: mass on one edge does not pull on the other.
+ * Particles all have mass 1 / particleCount, so gravity sets the pull of
+ * the whole system independent of particle count.
+ *
+ * Deposited weights are rounded to PARTICLE_MESH_FIXED_SCALE fixed point
+ * and summed as integers, and the FFT always runs its butterflies in the
+ * same order, so the threaded and SIMD CPU path matches the serial
+ * reference bit for bit. particle_mesh.comp runs the same passes.
+ */
+
+#define PARTICLE_MESH_FIXED_SCALE 1024.0f
+
+/* Plummer softening length of the 1/r potential, in simulation units. It
+ * does not depend on the grid size, so every grid solves the same problem
+ * and coarser grids only add smoothing on top of it.
+ */
+#define PARTICLE_MESH_SOFTENING 0.03f
+
+/* Powers of two only; the padded FFT is twice this wide */
+#define PARTICLE_MESH_MIN_SIZE 16
+#define PARTICLE_MESH_MAX_SIZE 512
+
+/* Matches the UBO block in particle_mesh.comp */
+typedef struct ParticleMeshUniforms
+{
+	float deltaTime;
+	float invCellSize;
+	float cellSize;
+	uint32_t particleCount;
+	uint32_t gridSize;
+	uint32_t paddedSize;
+	uint32_t paddedShift; /* 32 - log2(paddedSize), for bit reversal */
+	uint32_t fftPass;     /* PARTICLE_MESH_FFT_* */
+} ParticleMeshUniforms;
+
+/* The three FFT dispatches of one solve */
+#define PARTICLE_MESH_FFT_COLUMNS_FORWARD 0 /* density columns into the spectrum */
+#define PARTICLE_MESH_FFT_ROWS_CONVOLVE 1   /* forward, times the kernel, inverse */
+#define PARTICLE_MESH_FFT_COLUMNS_INVERSE 2 /* spectrum columns into the potential */
+
+typedef struct ParticleMeshTimings
+{
+	uint32_t stepCount;
+	double depositSeconds;
+	double solveSeconds;
+	double gradientSeconds;
+	double kickSeconds;
+} ParticleMeshTimings;
+
+typedef struct ParticleMesh ParticleMesh;
+
+/* gridSize must be a power of two in [PARTICLE_MESH_MIN_SIZE,
+ * PARTICLE_MESH_MAX_SIZE]. maxVectorWidth caps the SIMD path (1, 4 or 8
+ * floats) and the best one the CPU supports below it is used. pool may
+ * be NULL.
+ */
+ParticleMesh* ParticleMesh_Create(
+	uint32_t particleCount,
+	uint32_t gridSize,
+	float gravity,
+	uint32_t maxVectorWidth,
+	ThreadPool *pool
+);
+void ParticleMesh_Destroy(ParticleMesh *mesh);
+
+uint32_t ParticleMesh_GetGridSize(ParticleMesh *mesh);
+uint32_t ParticleMesh_GetVectorWidth(ParticleMesh *mesh);
+
+void ParticleMesh_FillUniforms(
+	ParticleMesh *mesh,
+	ParticleMeshUniforms *uniforms,
+	uint32_t particleCount,
+	float deltaTime
+);
+
+/* For particle_mesh_gpu.c: the kernel spectrum (paddedSize^2 floats, already
+ * scaled by gravity, particle mass, the fixed point scale and the FFT
+ * normalization) and the forward twiddle factors (paddedSize / 2
+ * interleaved cos, -sin pairs; the inverse transform conjugates them).
+ */
+const float* ParticleMesh_GetKernelSpectrum(ParticleMesh *mesh);
+const float* ParticleMesh_GetTwiddles(ParticleMesh *mesh);
+
+/* Solves for the current positions and adds the mesh force to the velocities */
+void ParticleMesh_Apply(
+	ParticleMesh *mesh,
+	const float *xPosition,
+	const float *yPosition,
+	float *xVelocity,
+	float *yVelocity,
+	uint32_t count,
+	float deltaTime
+);
+
+/* Single-threaded scalar version on the GPU layout, run before
+ * CPUSim_ReferenceStep when validating.
+ */
+void ParticleMesh_ReferenceApply(ParticleMesh *mesh, Particle *particles, uint32_t count, float deltaTime);
+
+/* Time spent in each phase of ParticleMesh_Apply so far */
+void ParticleMesh_GetTimings(ParticleMesh *mesh, ParticleMeshTimings *timings);
+void ParticleMesh_LogTimings(ParticleMesh *mesh);
+
+/* Particles the sweep compares at; direct summation costs N per sample */
+#define PARTICLE_MESH_SWEEP_SAMPLES 1024
+
+/* Solves once for each grid size from PARTICLE_MESH_MIN_SIZE up to
+ * maxGridSize and logs the solve time next to the force error against
+ * direct summation over every particle, evaluated at sampleCount of them.
+ */
+void ParticleMesh_LogSweep(
+	const Particle *particles,
+	uint32_t count,
+	float gravity,
+	uint32_t maxGridSize,
+	uint32_t sampleCount,
+	uint32_t maxVectorWidth,
+	ThreadPool *pool
+);
+
+#endif /* PARTICLE_MESH_H */
@@ -0,0 +1,199 @@
+#include "particle_mesh_gpu.h"
+
+#include <stdbool.h>
+
+#include <SDL.h>
+
+#include "compute_pass.h"
+
+typedef enum ParticleMeshPassType
+{
+	PARTICLE_MESH_PASS_CLEAR,
+	PARTICLE_MESH_PASS_DEPOSIT,
+	PARTICLE_MESH_PASS_FFT,
+	PARTICLE_MESH_PASS_GRADIENT,
+	PARTICLE_MESH_PASS_KICK,
+	PARTICLE_MESH_PASS_TYPE_COUNT
+} ParticleMeshPassType;
+
+struct ParticleMeshGPU
+{
+	ParticleMesh *mesh;
+
+	REFRESH_Buffer *density;
+	REFRESH_Buffer *spectrum;
+	REFRESH_Buffer *kernelSpectrum;
+	REFRESH_Buffer *twiddles;
+	REFRESH_Buffer *force;
+
+	ComputePass passes[PARTICLE_MESH_PASS_TYPE_COUNT];
+};
+
+static const char* ParticleMeshGPU_GetShaderPath(ParticleMeshPassType type, ParticleLayout layout)
+{
+	bool split = (layout == PARTICLE_LAYOUT_SPLIT);
+
+	switch (type)
+	{
+	case PARTICLE_MESH_PASS_CLEAR:
+		return "mesh_clear.comp.spv";
+	case PARTICLE_MESH_PASS_DEPOSIT:
+		return split ? "mesh_split_deposit.comp.spv" : "mesh_deposit.comp.spv";
+	case PARTICLE_MESH_PASS_FFT:
+		return "mesh_fft.comp.spv";
+	case PARTICLE_MESH_PASS_GRADIENT:
+		return "mesh_gradient.comp.spv";
+	case PARTICLE_MESH_PASS_KICK:
+		return split ? "mesh_split_kick.comp.spv" : "mesh_kick.comp.spv";
+	default:
+		return NULL;
+	}
+}
+
+ParticleMeshGPU* ParticleMeshGPU_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ParticleMesh *mesh,
+	ParticleBuffers *particleBuffers
+) {
+	uint32_t i;
+	uint32_t gridSize = ParticleMesh_GetGridSize(mesh);
+	uint32_t paddedSize = gridSize * 2;
+	uint32_t bindingCount;
+	ParticleMeshGPU *meshGPU = SDL_malloc(sizeof(ParticleMeshGPU));
+
+	SDL_zerop(meshGPU);
+	meshGPU->mesh = mesh;
+
+	meshGPU->density = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, sizeof(uint32_t) * gridSize * gridSize);
+	meshGPU->spectrum = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, sizeof(float) * 2 * paddedSize * gridSize);
+	meshGPU->kernelSpectrum = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, sizeof(float) * paddedSize * paddedSize);
+	meshGPU->twiddles = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, sizeof(float) * paddedSize);
+	meshGPU->force = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, sizeof(float) * 2 * gridSize * gridSize);
+
+	REFRESH_SetBufferData(
+		device,
+		meshGPU->kernelSpectrum,
+		0,
+		(void*) ParticleMesh_GetKernelSpectrum(mesh),
+		sizeof(float) * paddedSize * paddedSize
+	);
+	REFRESH_SetBufferData(
+		device,
+		meshGPU->twiddles,
+		0,
+		(void*) ParticleMesh_GetTwiddles(mesh),
+		sizeof(float) * paddedSize
+	);
+
+	/* The split layout binds positions and velocities separately; the
+	 * interleaved one has both in the Particle struct.
+	 */
+	REFRESH_Buffer *particleBindings[3];
+	if (particleBuffers->layout == PARTICLE_LAYOUT_SPLIT)
+	{
+		particleBindings[0] = particleBuffers->buffers[0];
+		particleBindings[1] = particleBuffers->buffers[1];
+		bindingCount = 2;
+	}
+	else
+	{
+		particleBindings[0] = particleBuffers->buffers[0];
+		bindingCount = 1;
+	}
+
+	REFRESH_Buffer *clearBindings[] = { meshGPU->density };
+	REFRESH_Buffer *fftBindings[] = {
+		meshGPU->density,
+		meshGPU->spectrum,
+		meshGPU->kernelSpectrum,
+		meshGPU->twiddles
+	};
+	REFRESH_Buffer *gradientBindings[] = { meshGPU->spectrum, meshGPU->force };
+	REFRESH_Buffer *depositBindings[3];
+	REFRESH_Buffer *kickBindings[3];
+
+	SDL_memcpy(depositBindings, particleBindings, sizeof(REFRESH_Buffer*) * bindingCount);
+	SDL_memcpy(kickBindings, particleBindings, sizeof(REFRESH_Buffer*) * bindingCount);
+	depositBindings[bindingCount] = meshGPU->density;
+	kickBindings[bindingCount] = meshGPU->force;
+
+	REFRESH_Buffer **bindings[PARTICLE_MESH_PASS_TYPE_COUNT] = {
+		clearBindings,
+		depositBindings,
+		fftBindings,
+		gradientBindings,
+		kickBindings
+	};
+	uint32_t bindingCounts[PARTICLE_MESH_PASS_TYPE_COUNT] = {
+		SDL_arraysize(clearBindings),
+		bindingCount + 1,
+		SDL_arraysize(fftBindings),
+		SDL_arraysize(gradientBindings),
+		bindingCount + 1
+	};
+
+	for (i = 0; i < PARTICLE_MESH_PASS_TYPE_COUNT; i += 1)
+	{
+		const char *shaderPath = ParticleMeshGPU_GetShaderPath((ParticleMeshPassType) i, particleBuffers->layout);
+
+		if (!ComputePass_Create(device, shaderCache, &meshGPU->passes[i], shaderPath, sizeof(ParticleMeshUniforms), bindings[i], bindingCounts[i]))
+		{
+			ParticleMeshGPU_Destroy(device, meshGPU);
+			return NULL;
+		}
+	}
+
+	return meshGPU;
+}
+
+void ParticleMeshGPU_Destroy(REFRESH_Device *device, ParticleMeshGPU *meshGPU)
+{
+	uint32_t i;
+
+	if (meshGPU == NULL)
+	{
+		return;
+	}
+
+	for (i = 0; i < PARTICLE_MESH_PASS_TYPE_COUNT; i += 1)
+	{
+		ComputePass_Destroy(device, &meshGPU->passes[i]);
+	}
+
+	REFRESH_AddDisposeBuffer(device, meshGPU->density);
+	REFRESH_AddDisposeBuffer(device, meshGPU->spectrum);
+	REFRESH_AddDisposeBuffer(device, meshGPU->kernelSpectrum);
+	REFRESH_AddDisposeBuffer(device, meshGPU->twiddles);
+	REFRESH_AddDisposeBuffer(device, meshGPU->force);
+	SDL_free(meshGPU);
+}
+
+void ParticleMeshGPU_Record(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	ParticleMeshGPU *meshGPU,
+	const ParticleComputeUniforms *step
+) {
+	ParticleMeshUniforms uniforms;
+	ComputePass *passes = meshGPU->passes;
+	uint32_t particleGroupCount = (step->particleCount + 255) / 256;
+	uint32_t cellGroupCount;
+
+	ParticleMesh_FillUniforms(meshGPU->mesh, &uniforms, step->particleCount, step->deltaTime);
+	cellGroupCount = (uniforms.gridSize * uniforms.gridSize + 255) / 256;
+
+	ComputePass_Record(device, commandBuffer, &passes[PARTICLE_MESH_PASS_CLEAR], &uniforms, cellGroupCount);
+	ComputePass_Record(device, commandBuffer, &passes[PARTICLE_MESH_PASS_DEPOSIT], &uniforms, particleGroupCount);
+
+	/* One workgroup per line: columns, then padded rows, then columns */
+	uniforms.fftPass = PARTICLE_MESH_FFT_COLUMNS_FORWARD;
+	ComputePass_Record(device, commandBuffer, &passes[PARTICLE_MESH_PASS_FFT], &uniforms, uniforms.gridSize);
+	uniforms.fftPass = PARTICLE_MESH_FFT_ROWS_CONVOLVE;
+	ComputePass_Record(device, commandBuffer, &passes[PARTICLE_MESH_PASS_FFT], &uniforms, uniforms.paddedSize);
+	uniforms.fftPass = PARTICLE_MESH_FFT_COLUMNS_INVERSE;
+	ComputePass_Record(device, commandBuffer, &passes[PARTICLE_MESH_PASS_FFT], &uniforms, uniforms.gridSize);
+
+	ComputePass_Record(device, commandBuffer, &passes[PARTICLE_MESH_PASS_GRADIENT], &uniforms, cellGroupCount);
+	ComputePass_Record(device, commandBuffer, &passes[PARTICLE_MESH_PASS_KICK], &uniforms, particleGroupCount);
+}
@@ -0,0 +1,38 @@
+#ifndef PARTICLE_MESH_GPU_H
+#define PARTICLE_MESH_GPU_H
+
+#include <Refresh.h>
+
+#include "particle_buffers.h"
+#include "particle_mesh.h"
+#include "shader_module.h"
+
+/* The particle_mesh.comp passes and their buffers.
+ *
+ * Recording one step clears the density, deposits every particle into it,
+ * runs the three FFT dispatches of the solve, differences the potential
+ * into a force grid and kicks every particle's velocity with it. Each
+ * dispatch rebinds its buffers so Refresh places a barrier between them.
+ * The kernel spectrum and twiddles are computed once by the CPU mesh and
+ * uploaded at creation.
+ */
+
+typedef struct ParticleMeshGPU ParticleMeshGPU;
+
+/* Returns NULL if a shader could not be loaded */
+ParticleMeshGPU* ParticleMeshGPU_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ParticleMesh *mesh,
+	ParticleBuffers *particleBuffers
+);
+void ParticleMeshGPU_Destroy(REFRESH_Device *device, ParticleMeshGPU *meshGPU);
+
+void ParticleMeshGPU_Record(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	ParticleMeshGPU *meshGPU,
+	const ParticleComputeUniforms *step
+);
+
+#endif /* PARTICLE_MESH_GPU_H */
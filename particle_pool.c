@@ -0,0 +1,299 @@
+#include "particle_pool.h"
+
+#include <SDL.h>
+
+/* Particles per block in the CPU reference; any size gives the same result */
+#define PARTICLE_POOL_CPU_BLOCK_SIZE 4096
+
+/* Emission draws counters 4e, 4e + 1 and 4e + 2 above everything
+ * Particle_InitializeArray can use
+ */
+#define PARTICLE_POOL_EMIT_COUNTER_BASE (1ull << 33)
+
+struct ParticlePool
+{
+	uint32_t capacity;
+	uint32_t emitPerStep;
+	uint32_t minLifetime;
+	uint32_t lifetimeRange;
+	uint64_t key;
+	ThreadPool *threadPool;
+
+	/* Predicted state */
+	uint32_t liveCount;
+	uint64_t stepCount;
+	uint64_t emittedCount;
+
+	/* deaths[s % deathSlotCount] is how many particles run out of life at
+	 * step s. Lifetimes are at most minLifetime + lifetimeRange - 1, so
+	 * pending deaths never share a slot.
+	 */
+	uint32_t *deaths;
+	uint32_t deathSlotCount;
+
+	uint64_t killedCount;
+	uint32_t peakLiveCount;
+
+	/* Reference compaction */
+	uint8_t *alive;
+	uint32_t *blockOffsets;
+	Particle *scratch;
+};
+
+typedef struct ParticlePoolJob
+{
+	ParticlePool *particlePool;
+	const ParticlePoolFrame *frame;
+	Particle *particles;
+} ParticlePoolJob;
+
+static uint32_t ParticlePool_Lifetime(ParticlePool *particlePool, uint64_t emitIndex)
+{
+	uint64_t counter = PARTICLE_POOL_EMIT_COUNTER_BASE + emitIndex * 4;
+
+	return particlePool->minLifetime + Particle_Random(particlePool->key, counter + 2) % particlePool->lifetimeRange;
+}
+
+static void ParticlePool_Emit(ParticlePool *particlePool, uint64_t emitIndex, Particle *particle)
+{
+	uint64_t counter = PARTICLE_POOL_EMIT_COUNTER_BASE + emitIndex * 4;
+
+	particle->xPosition = Particle_RandomSigned(Particle_Random(particlePool->key, counter));
+	particle->yPosition = Particle_RandomSigned(Particle_Random(particlePool->key, counter + 1));
+	particle->xVelocity = 0;
+	particle->yVelocity = 1;
+	particle->gradientPosition = particle->xPosition * 0.5f;
+	particle->life = (float) ParticlePool_Lifetime(particlePool, emitIndex);
+	particle->dummy2 = 0;
+	particle->dummy3 = 0;
+}
+
+ParticlePool* ParticlePool_Create(
+	uint32_t capacity,
+	uint32_t emitPerStep,
+	uint32_t lifetime,
+	uint32_t seed,
+	ThreadPool *pool
+) {
+	ParticlePool *particlePool = SDL_malloc(sizeof(ParticlePool));
+	uint32_t blockCount = (capacity + PARTICLE_POOL_CPU_BLOCK_SIZE - 1) / PARTICLE_POOL_CPU_BLOCK_SIZE;
+
+	SDL_zerop(particlePool);
+
+	lifetime = SDL_max(lifetime, 1);
+	particlePool->capacity = SDL_min(capacity, PARTICLE_POOL_MAX_CAPACITY);
+	particlePool->emitPerStep = emitPerStep;
+	particlePool->minLifetime = SDL_max(lifetime / 2, 1);
+	particlePool->lifetimeRange = lifetime - particlePool->minLifetime + 1;
+	particlePool->key = Particle_RandomKey(seed);
+	particlePool->threadPool = pool;
+
+	particlePool->deathSlotCount = lifetime + 1;
+	particlePool->deaths = SDL_calloc(particlePool->deathSlotCount, sizeof(uint32_t));
+
+	particlePool->alive = SDL_malloc(particlePool->capacity);
+	particlePool->blockOffsets = SDL_malloc(sizeof(uint32_t) * (blockCount + 1));
+	particlePool->scratch = SDL_malloc(sizeof(Particle) * particlePool->capacity);
+
+	return particlePool;
+}
+
+void ParticlePool_Destroy(ParticlePool *particlePool)
+{
+	if (particlePool == NULL)
+	{
+		return;
+	}
+
+	SDL_free(particlePool->deaths);
+	SDL_free(particlePool->alive);
+	SDL_free(particlePool->blockOffsets);
+	SDL_free(particlePool->scratch);
+	SDL_free(particlePool);
+}
+
+uint32_t ParticlePool_GetCapacity(ParticlePool *particlePool)
+{
+	return particlePool->capacity;
+}
+
+uint32_t ParticlePool_GetLiveCount(ParticlePool *particlePool)
+{
+	return particlePool->liveCount;
+}
+
+void ParticlePool_BeginFrame(ParticlePool *particlePool, uint32_t stepCount, ParticlePoolFrame *frame)
+{
+	uint32_t i, *deathSlot;
+	uint64_t step;
+
+	frame->stepCount = stepCount;
+	frame->previousCount = particlePool->liveCount;
+
+	/* Kill: everything whose life ends within this frame's steps */
+	for (step = particlePool->stepCount + 1; step <= particlePool->stepCount + stepCount; step += 1)
+	{
+		deathSlot = &particlePool->deaths[step % particlePool->deathSlotCount];
+		particlePool->liveCount -= *deathSlot;
+		particlePool->killedCount += *deathSlot;
+		*deathSlot = 0;
+	}
+	particlePool->stepCount += stepCount;
+	frame->survivorCount = particlePool->liveCount;
+
+	/* Emit: lifetimes count down from the end of this frame */
+	frame->emitBase = particlePool->emittedCount;
+	frame->emitCount = (uint32_t) SDL_min(
+		(uint64_t) particlePool->emitPerStep * stepCount,
+		particlePool->capacity - particlePool->liveCount
+	);
+
+	for (i = 0; i < frame->emitCount; i += 1)
+	{
+		step = particlePool->stepCount + ParticlePool_Lifetime(particlePool, frame->emitBase + i);
+		particlePool->deaths[step % particlePool->deathSlotCount] += 1;
+	}
+
+	particlePool->emittedCount += frame->emitCount;
+	particlePool->liveCount += frame->emitCount;
+	particlePool->peakLiveCount = SDL_max(particlePool->peakLiveCount, particlePool->liveCount);
+	frame->liveCount = particlePool->liveCount;
+}
+
+void ParticlePool_FillUniforms(
+	ParticlePool *particlePool,
+	const ParticlePoolFrame *frame,
+	ParticlePoolUniforms *uniforms
+) {
+	uniforms->keyLow = (uint32_t) particlePool->key;
+	uniforms->keyHigh = (uint32_t) (particlePool->key >> 32);
+	uniforms->emitBaseLow = (uint32_t) frame->emitBase;
+	uniforms->emitBaseHigh = (uint32_t) (frame->emitBase >> 32);
+	uniforms->stepCount = frame->stepCount;
+	uniforms->previousCount = frame->previousCount;
+	uniforms->survivorCount = frame->survivorCount;
+	uniforms->emitCount = frame->emitCount;
+	uniforms->minLifetime = particlePool->minLifetime;
+	uniforms->lifetimeRange = particlePool->lifetimeRange;
+	uniforms->blockCount = (frame->previousCount + PARTICLE_POOL_BLOCK_SIZE - 1) / PARTICLE_POOL_BLOCK_SIZE;
+	uniforms->padding = 0;
+}
+
+/* Reference stages, split into blocks of PARTICLE_POOL_CPU_BLOCK_SIZE */
+
+static void ParticlePool_ParallelFor(ParticlePool *particlePool, uint32_t count, uint32_t grainSize, ThreadPoolRangeFunc func, void *userdata)
+{
+	if (particlePool->threadPool == NULL)
+	{
+		func(userdata, 0, count);
+	}
+	else
+	{
+		ThreadPool_ParallelFor(particlePool->threadPool, count, grainSize, func, userdata);
+	}
+}
+
+static void ParticlePool_KillBlocks(void *userdata, uint32_t start, uint32_t end)
+{
+	ParticlePoolJob *job = (ParticlePoolJob*) userdata;
+	ParticlePool *particlePool = job->particlePool;
+	float stepCount = (float) job->frame->stepCount;
+	uint32_t block, i, blockEnd, aliveCount;
+
+	for (block = start; block < end; block += 1)
+	{
+		blockEnd = SDL_min((block + 1) * PARTICLE_POOL_CPU_BLOCK_SIZE, job->frame->previousCount);
+		aliveCount = 0;
+
+		for (i = block * PARTICLE_POOL_CPU_BLOCK_SIZE; i < blockEnd; i += 1)
+		{
+			job->particles[i].life -= stepCount;
+			particlePool->alive[i] = (job->particles[i].life > 0.0f);
+			aliveCount += particlePool->alive[i];
+		}
+
+		particlePool->blockOffsets[block] = aliveCount;
+	}
+}
+
+static void ParticlePool_ScatterBlocks(void *userdata, uint32_t start, uint32_t end)
+{
+	ParticlePoolJob *job = (ParticlePoolJob*) userdata;
+	ParticlePool *particlePool = job->particlePool;
+	uint32_t block, i, blockEnd, destination;
+
+	for (block = start; block < end; block += 1)
+	{
+		blockEnd = SDL_min((block + 1) * PARTICLE_POOL_CPU_BLOCK_SIZE, job->frame->previousCount);
+		destination = particlePool->blockOffsets[block];
+
+		for (i = block * PARTICLE_POOL_CPU_BLOCK_SIZE; i < blockEnd; i += 1)
+		{
+			if (particlePool->alive[i])
+			{
+				particlePool->scratch[destination] = job->particles[i];
+				destination += 1;
+			}
+		}
+	}
+}
+
+static void ParticlePool_EmitRange(void *userdata, uint32_t start, uint32_t end)
+{
+	ParticlePoolJob *job = (ParticlePoolJob*) userdata;
+	uint32_t i;
+
+	for (i = start; i < end; i += 1)
+	{
+		ParticlePool_Emit(job->particlePool, job->frame->emitBase + i, &job->particles[job->frame->survivorCount + i]);
+	}
+}
+
+void ParticlePool_ReferenceApply(ParticlePool *particlePool, const ParticlePoolFrame *frame, Particle *particles)
+{
+	ParticlePoolJob job;
+	uint32_t blockCount = (frame->previousCount + PARTICLE_POOL_CPU_BLOCK_SIZE - 1) / PARTICLE_POOL_CPU_BLOCK_SIZE;
+	uint32_t block, count, running;
+
+	job.particlePool = particlePool;
+	job.frame = frame;
+	job.particles = particles;
+
+	if (blockCount > 0)
+	{
+		ParticlePool_ParallelFor(particlePool, blockCount, 1, ParticlePool_KillBlocks, &job);
+
+		/* Exclusive prefix sum of the per-block alive counts */
+		running = 0;
+		for (block = 0; block < blockCount; block += 1)
+		{
+			count = particlePool->blockOffsets[block];
+			particlePool->blockOffsets[block] = running;
+			running += count;
+		}
+
+		if (running != frame->survivorCount)
+		{
+			SDL_Log("particle pool: %u survivors, %u predicted", running, frame->survivorCount);
+		}
+
+		ParticlePool_ParallelFor(particlePool, blockCount, 1, ParticlePool_ScatterBlocks, &job);
+		SDL_memcpy(particles, particlePool->scratch, sizeof(Particle) * SDL_min(running, frame->survivorCount));
+	}
+
+	ParticlePool_ParallelFor(particlePool, frame->emitCount, PARTICLE_POOL_CPU_BLOCK_SIZE, ParticlePool_EmitRange, &job);
+}
+
+void ParticlePool_LogStats(ParticlePool *particlePool)
+{
+	SDL_LogInfo(
+		SDL_LOG_CATEGORY_APPLICATION,
+		"Particle pool: %u live of %u (peak %u), %llu emitted, %llu killed over %llu steps",
+		particlePool->liveCount,
+		particlePool->capacity,
+		particlePool->peakLiveCount,
+		(unsigned long long) particlePool->emittedCount,
+		(unsigned long long) particlePool->killedCount,
+		(unsigned long long) particlePool->stepCount
+	);
+}
@@ -0,0 +1,99 @@
+#ifndef PARTICLE_POOL_H
+#define PARTICLE_POOL_H
+
+#include <stdint.h>
+
+#include "particle.h"
+#include "thread_pool.h"
+
+/* A fixed-capacity pool of particles with lifetimes.
+ *
+ * The first liveCount slots of the particle buffer are alive. Every frame
+ * runs three stages before the simulation steps:
+ *
+ *   kill    - Particle.life drops by the frame's step count, and particles
+ *             with none left are flagged dead
+ *   compact - survivors are packed to the front, in order, by an exclusive
+ *             prefix sum over per-block alive counts and a scatter
+ *   emit    - new particles are appended after the survivors
+ *
+ * Emitted particles draw their position and lifetime from Particle_Random
+ * keyed by the seed and counted by emission index, so which particles
+ * exist at any step is fully determined. ParticlePool_BeginFrame uses that
+ * to predict the live count on the CPU without reading anything back, and
+ * that count sizes the simulation dispatches and the draw.
+ *
+ * ParticlePool_ReferenceApply runs the stages on the CPU over the GPU
+ * layout and particle_pool.comp on the device; both produce the same
+ * particles in the same order.
+ */
+
+/* Particles per compaction block in particle_pool.comp */
+#define PARTICLE_POOL_BLOCK_SIZE 256
+
+/* One block per workgroup, within the guaranteed dispatch size */
+#define PARTICLE_POOL_MAX_CAPACITY (65535 * PARTICLE_POOL_BLOCK_SIZE)
+
+/* Matches the UBO block in particle_pool.comp */
+typedef struct ParticlePoolUniforms
+{
+	uint32_t keyLow, keyHigh;             /* Particle_RandomKey */
+	uint32_t emitBaseLow, emitBaseHigh;   /* emission index of the first new particle */
+	uint32_t stepCount;
+	uint32_t previousCount;               /* live before the kill stage */
+	uint32_t survivorCount;
+	uint32_t emitCount;
+	uint32_t minLifetime;                 /* in steps */
+	uint32_t lifetimeRange;               /* lifetimes are minLifetime + [0, lifetimeRange) */
+	uint32_t blockCount;
+	uint32_t padding;
+} ParticlePoolUniforms;
+
+/* What one frame does to the pool, planned by ParticlePool_BeginFrame */
+typedef struct ParticlePoolFrame
+{
+	uint32_t stepCount;
+	uint32_t previousCount;
+	uint32_t survivorCount;
+	uint32_t emitCount;
+	uint64_t emitBase;
+	uint32_t liveCount; /* survivorCount + emitCount, what the steps run on */
+} ParticlePoolFrame;
+
+typedef struct ParticlePool ParticlePool;
+
+/* Starts empty. emitPerStep particles are emitted for every step while
+ * there is room, each living between lifetime / 2 and lifetime steps.
+ * pool may be NULL.
+ */
+ParticlePool* ParticlePool_Create(
+	uint32_t capacity,
+	uint32_t emitPerStep,
+	uint32_t lifetime,
+	uint32_t seed,
+	ThreadPool *pool
+);
+void ParticlePool_Destroy(ParticlePool *particlePool);
+
+uint32_t ParticlePool_GetCapacity(ParticlePool *particlePool);
+uint32_t ParticlePool_GetLiveCount(ParticlePool *particlePool);
+
+/* Plans the next frame of stepCount steps and advances the predicted live
+ * count to the end of it
+ */
+void ParticlePool_BeginFrame(ParticlePool *particlePool, uint32_t stepCount, ParticlePoolFrame *frame);
+
+void ParticlePool_FillUniforms(
+	ParticlePool *particlePool,
+	const ParticlePoolFrame *frame,
+	ParticlePoolUniforms *uniforms
+);
+
+/* Runs the kill, compact and emit stages of frame on the GPU layout, split
+ * across the thread pool. particles must hold the capacity.
+ */
+void ParticlePool_ReferenceApply(ParticlePool *particlePool, const ParticlePoolFrame *frame, Particle *particles);
+
+void ParticlePool_LogStats(ParticlePool *particlePool);
+
+#endif /* PARTICLE_POOL_H */
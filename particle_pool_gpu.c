@@ -0,0 +1,150 @@
+#include "particle_pool_gpu.h"
+
+#include <SDL.h>
+
+#include "compute_pass.h"
+
+typedef enum ParticlePoolPassType
+{
+	PARTICLE_POOL_PASS_KILL,
+	PARTICLE_POOL_PASS_SCAN,
+	PARTICLE_POOL_PASS_SCATTER,
+	PARTICLE_POOL_PASS_COPY,
+	PARTICLE_POOL_PASS_EMIT,
+	PARTICLE_POOL_PASS_TYPE_COUNT
+} ParticlePoolPassType;
+
+static const char *shaderPaths[PARTICLE_POOL_PASS_TYPE_COUNT] = {
+	"pool_kill.comp.spv",
+	"pool_scan.comp.spv",
+	"pool_scatter.comp.spv",
+	"pool_copy.comp.spv",
+	"pool_emit.comp.spv"
+};
+
+struct ParticlePoolGPU
+{
+	ParticlePool *particlePool;
+
+	REFRESH_Buffer *alive;
+	REFRESH_Buffer *blockOffsets;
+	REFRESH_Buffer *scratch;
+
+	ComputePass passes[PARTICLE_POOL_PASS_TYPE_COUNT];
+};
+
+ParticlePoolGPU* ParticlePoolGPU_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ParticlePool *particlePool,
+	ParticleBuffers *particleBuffers
+) {
+	uint32_t i;
+	uint32_t capacity = ParticlePool_GetCapacity(particlePool);
+	uint32_t blockCount = (capacity + PARTICLE_POOL_BLOCK_SIZE - 1) / PARTICLE_POOL_BLOCK_SIZE;
+	ParticlePoolGPU *poolGPU = SDL_malloc(sizeof(ParticlePoolGPU));
+
+	SDL_assert(particleBuffers->layout == PARTICLE_LAYOUT_INTERLEAVED);
+
+	SDL_zerop(poolGPU);
+	poolGPU->particlePool = particlePool;
+
+	poolGPU->alive = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, sizeof(uint32_t) * capacity);
+	poolGPU->blockOffsets = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, sizeof(uint32_t) * blockCount);
+	poolGPU->scratch = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, sizeof(Particle) * capacity);
+
+	REFRESH_Buffer *particles = particleBuffers->buffers[0];
+
+	REFRESH_Buffer *killBindings[] = { particles, poolGPU->alive, poolGPU->blockOffsets };
+	REFRESH_Buffer *scanBindings[] = { poolGPU->blockOffsets };
+	REFRESH_Buffer *scatterBindings[] = { particles, poolGPU->alive, poolGPU->blockOffsets, poolGPU->scratch };
+	REFRESH_Buffer *copyBindings[] = { poolGPU->scratch, particles };
+	REFRESH_Buffer *emitBindings[] = { particles };
+
+	REFRESH_Buffer **bindings[PARTICLE_POOL_PASS_TYPE_COUNT] = {
+		killBindings,
+		scanBindings,
+		scatterBindings,
+		copyBindings,
+		emitBindings
+	};
+	uint32_t bindingCounts[PARTICLE_POOL_PASS_TYPE_COUNT] = {
+		SDL_arraysize(killBindings),
+		SDL_arraysize(scanBindings),
+		SDL_arraysize(scatterBindings),
+		SDL_arraysize(copyBindings),
+		SDL_arraysize(emitBindings)
+	};
+
+	for (i = 0; i < PARTICLE_POOL_PASS_TYPE_COUNT; i += 1)
+	{
+		if (!ComputePass_Create(device, shaderCache, &poolGPU->passes[i], shaderPaths[i], sizeof(ParticlePoolUniforms), bindings[i], bindingCounts[i]))
+		{
+			ParticlePoolGPU_Destroy(device, poolGPU);
+			return NULL;
+		}
+	}
+
+	return poolGPU;
+}
+
+void ParticlePoolGPU_Destroy(REFRESH_Device *device, ParticlePoolGPU *poolGPU)
+{
+	uint32_t i;
+
+	if (poolGPU == NULL)
+	{
+		return;
+	}
+
+	for (i = 0; i < PARTICLE_POOL_PASS_TYPE_COUNT; i += 1)
+	{
+		ComputePass_Destroy(device, &poolGPU->passes[i]);
+	}
+
+	REFRESH_AddDisposeBuffer(device, poolGPU->alive);
+	REFRESH_AddDisposeBuffer(device, poolGPU->blockOffsets);
+	REFRESH_AddDisposeBuffer(device, poolGPU->scratch);
+	SDL_free(poolGPU);
+}
+
+void ParticlePoolGPU_Record(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	ParticlePoolGPU *poolGPU,
+	const ParticlePoolFrame *frame
+) {
+	ParticlePoolUniforms uniforms;
+	ComputePass *passes = poolGPU->passes;
+
+	ParticlePool_FillUniforms(poolGPU->particlePool, frame, &uniforms);
+
+	if (frame->previousCount > 0)
+	{
+		ComputePass_Record(device, commandBuffer, &passes[PARTICLE_POOL_PASS_KILL], &uniforms, uniforms.blockCount);
+		ComputePass_Record(device, commandBuffer, &passes[PARTICLE_POOL_PASS_SCAN], &uniforms, 1);
+		ComputePass_Record(device, commandBuffer, &passes[PARTICLE_POOL_PASS_SCATTER], &uniforms, uniforms.blockCount);
+
+		if (frame->survivorCount > 0)
+		{
+			ComputePass_Record(
+				device,
+				commandBuffer,
+				&passes[PARTICLE_POOL_PASS_COPY],
+				&uniforms,
+				(frame->survivorCount + PARTICLE_POOL_BLOCK_SIZE - 1) / PARTICLE_POOL_BLOCK_SIZE
+			);
+		}
+	}
+
+	if (frame->emitCount > 0)
+	{
+		ComputePass_Record(
+			device,
+			commandBuffer,
+			&passes[PARTICLE_POOL_PASS_EMIT],
+			&uniforms,
+			(frame->emitCount + PARTICLE_POOL_BLOCK_SIZE - 1) / PARTICLE_POOL_BLOCK_SIZE
+		);
+	}
+}
@@ -0,0 +1,39 @@
+#ifndef PARTICLE_POOL_GPU_H
+#define PARTICLE_POOL_GPU_H
+
+#include <Refresh.h>
+
+#include "particle_buffers.h"
+#include "particle_pool.h"
+#include "shader_module.h"
+
+/* The particle_pool.comp passes and their scratch buffers.
+ *
+ * Recording a frame ages the live particles and flags the survivors,
+ * scans the per-block survivor counts, scatters the survivors into a
+ * scratch buffer in order, copies them back to the front of the particle
+ * buffer and appends the frame's emitted particles. Every dispatch is
+ * sized from the CPU-predicted counts in the ParticlePoolFrame, so none of
+ * them touches slots past the live particles. The particle update for the
+ * frame must follow.
+ */
+
+typedef struct ParticlePoolGPU ParticlePoolGPU;
+
+/* Interleaved layout only. Returns NULL if a shader could not be loaded. */
+ParticlePoolGPU* ParticlePoolGPU_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ParticlePool *particlePool,
+	ParticleBuffers *particleBuffers
+);
+void ParticlePoolGPU_Destroy(REFRESH_Device *device, ParticlePoolGPU *poolGPU);
+
+void ParticlePoolGPU_Record(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	ParticlePoolGPU *poolGPU,
+	const ParticlePoolFrame *frame
+);
+
+#endif /* PARTICLE_POOL_GPU_H */
@@ -0,0 +1,364 @@
+#include "particle_quantize.h"
+
+#include <SDL.h>
+
+#include "cpu_sim.h"
+
+/* The 1280x720 window spans [-1, 1] on both axes */
+#define PARTICLE_QUANTIZE_PIXELS_X 640.0
+#define PARTICLE_QUANTIZE_PIXELS_Y 360.0
+
+/* Drift is logged after each quarter of the steps */
+#define PARTICLE_QUANTIZE_CHECKPOINTS 4
+
+uint16_t ParticleQuantize_FloatToHalf(float value)
+{
+	uint32_t bits, sign, mantissa, half, remainder, halfway, shift;
+	int32_t exponent;
+
+	SDL_memcpy(&bits, &value, sizeof(bits));
+	sign = (bits >> 16) & 0x8000;
+	exponent = (int32_t) ((bits >> 23) & 0xFF);
+	mantissa = bits & 0x7FFFFF;
+
+	if (exponent == 0xFF)
+	{
+		return (uint16_t) (sign | 0x7C00 | ((mantissa != 0) ? 0x200 : 0));
+	}
+
+	exponent = exponent - 127 + 15;
+	if (exponent >= 31)
+	{
+		return (uint16_t) (sign | 0x7C00);
+	}
+
+	if (exponent <= 0)
+	{
+		/* Subnormal half: the implicit bit becomes explicit and the
+		 * mantissa is shifted down to units of 2^-24
+		 */
+		if (exponent < -10)
+		{
+			return (uint16_t) sign;
+		}
+		mantissa |= 0x800000;
+		shift = (uint32_t) (14 - exponent);
+		half = mantissa >> shift;
+		remainder = mantissa & ((1u << shift) - 1);
+		halfway = 1u << (shift - 1);
+	}
+	else
+	{
+		half = ((uint32_t) exponent << 10) | (mantissa >> 13);
+		remainder = mantissa & 0x1FFF;
+		halfway = 0x1000;
+	}
+
+	/* A carry out of the mantissa correctly bumps the exponent, up to infinity */
+	if (remainder > halfway || (remainder == halfway && (half & 1)))
+	{
+		half += 1;
+	}
+
+	return (uint16_t) (sign | half);
+}
+
+float ParticleQuantize_HalfToFloat(uint16_t half)
+{
+	uint32_t sign = (uint32_t) (half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1F;
+	uint32_t mantissa = half & 0x3FF;
+	uint32_t bits;
+	float value;
+
+	if (exponent == 0)
+	{
+		value = (float) mantissa * (1.0f / 16777216.0f);
+		return sign ? -value : value;
+	}
+
+	if (exponent == 31)
+	{
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+
+	SDL_memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+int16_t ParticleQuantize_FloatToSnorm16(float value)
+{
+	value = SDL_clamp(value, -1.0f, 1.0f);
+	return (int16_t) SDL_floorf(value * 32767.0f + 0.5f);
+}
+
+float ParticleQuantize_Snorm16ToFloat(int16_t snorm)
+{
+	return SDL_max((float) snorm / 32767.0f, -1.0f);
+}
+
+void ParticleQuantize_Encode(const Particle *particles, QuantizedParticle *quantized, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i += 1)
+	{
+		quantized[i].xPosition = ParticleQuantize_FloatToSnorm16(particles[i].xPosition);
+		quantized[i].yPosition = ParticleQuantize_FloatToSnorm16(particles[i].yPosition);
+		quantized[i].xVelocity = ParticleQuantize_FloatToHalf(particles[i].xVelocity);
+		quantized[i].yVelocity = ParticleQuantize_FloatToHalf(particles[i].yVelocity);
+		quantized[i].gradientPosition = ParticleQuantize_FloatToSnorm16(particles[i].gradientPosition);
+		quantized[i].padding = 0;
+	}
+}
+
+void ParticleQuantize_Decode(const QuantizedParticle *quantized, Particle *particles, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i += 1)
+	{
+		particles[i].xPosition = ParticleQuantize_Snorm16ToFloat(quantized[i].xPosition);
+		particles[i].yPosition = ParticleQuantize_Snorm16ToFloat(quantized[i].yPosition);
+		particles[i].xVelocity = ParticleQuantize_HalfToFloat(quantized[i].xVelocity);
+		particles[i].yVelocity = ParticleQuantize_HalfToFloat(quantized[i].yVelocity);
+		particles[i].gradientPosition = ParticleQuantize_Snorm16ToFloat(quantized[i].gradientPosition);
+		particles[i].life = 0;
+		particles[i].dummy2 = 0;
+		particles[i].dummy3 = 0;
+	}
+}
+
+/* Drift report */
+
+typedef void (*ParticleQuantizeRoundTripFunc)(Particle *particle);
+
+typedef struct ParticleQuantizeFormat
+{
+	const char *name;
+	uint32_t size; /* bytes per particle */
+	ParticleQuantizeRoundTripFunc roundTrip;
+} ParticleQuantizeFormat;
+
+static float ParticleQuantize_Snorm16(float value)
+{
+	return ParticleQuantize_Snorm16ToFloat(ParticleQuantize_FloatToSnorm16(value));
+}
+
+static float ParticleQuantize_Half(float value)
+{
+	return ParticleQuantize_HalfToFloat(ParticleQuantize_FloatToHalf(value));
+}
+
+static void ParticleQuantize_RoundTripPosition(Particle *particle)
+{
+	particle->xPosition = ParticleQuantize_Snorm16(particle->xPosition);
+	particle->yPosition = ParticleQuantize_Snorm16(particle->yPosition);
+}
+
+static void ParticleQuantize_RoundTripLayout(Particle *particle)
+{
+	QuantizedParticle quantized;
+	float life = particle->life;
+
+	ParticleQuantize_Encode(particle, &quantized, 1);
+	ParticleQuantize_Decode(&quantized, particle, 1);
+	particle->life = life;
+}
+
+static void ParticleQuantize_RoundTripHalf(Particle *particle)
+{
+	particle->xPosition = ParticleQuantize_Half(particle->xPosition);
+	particle->yPosition = ParticleQuantize_Half(particle->yPosition);
+	particle->xVelocity = ParticleQuantize_Half(particle->xVelocity);
+	particle->yVelocity = ParticleQuantize_Half(particle->yVelocity);
+	particle->gradientPosition = ParticleQuantize_Half(particle->gradientPosition);
+}
+
+static const ParticleQuantizeFormat particleQuantizeFormats[] =
+{
+	{ "snorm16 position",  16, ParticleQuantize_RoundTripPosition },
+	{ "quantized layout",  12, ParticleQuantize_RoundTripLayout },
+	{ "half",              10, ParticleQuantize_RoundTripHalf }
+};
+
+#define PARTICLE_QUANTIZE_FORMAT_COUNT SDL_arraysize(particleQuantizeFormats)
+
+typedef struct ParticleQuantizeDriftContext
+{
+	const ParticleComputeUniforms *steps;
+	uint32_t firstStep;
+	uint32_t endStep;
+	Particle *reference; /* [sampleCount] */
+	Particle *formats;   /* [PARTICLE_QUANTIZE_FORMAT_COUNT][sampleCount] */
+	uint32_t sampleCount;
+} ParticleQuantizeDriftContext;
+
+/* Particles never interact here, so each range runs every step on its own */
+static void ParticleQuantize_DriftRange(void *userdata, uint32_t start, uint32_t end)
+{
+	ParticleQuantizeDriftContext *context = (ParticleQuantizeDriftContext*) userdata;
+	ParticleComputeUniforms uniforms;
+	Particle *particles;
+	uint32_t step, format, i;
+
+	for (step = context->firstStep; step < context->endStep; step += 1)
+	{
+		uniforms = context->steps[step];
+		uniforms.particleCount = end - start;
+
+		CPUSim_ReferenceStep(context->reference + start, &uniforms);
+
+		for (format = 0; format < PARTICLE_QUANTIZE_FORMAT_COUNT; format += 1)
+		{
+			particles = context->formats + (size_t) format * context->sampleCount;
+			CPUSim_ReferenceStep(particles + start, &uniforms);
+			for (i = start; i < end; i += 1)
+			{
+				particleQuantizeFormats[format].roundTrip(&particles[i]);
+			}
+		}
+	}
+}
+
+static void ParticleQuantize_LogFormatDrift(
+	const ParticleQuantizeFormat *format,
+	const Particle *reference,
+	const Particle *particles,
+	uint32_t sampleCount
+) {
+	uint32_t i, overPixel = 0;
+	double dx, dy, error, gradientError;
+	double sum = 0.0, sum2 = 0.0, maxError = 0.0;
+	double velocity2 = 0.0, reference2 = 0.0, maxGradientError = 0.0;
+
+	for (i = 0; i < sampleCount; i += 1)
+	{
+		dx = (particles[i].xPosition - reference[i].xPosition) * PARTICLE_QUANTIZE_PIXELS_X;
+		dy = (particles[i].yPosition - reference[i].yPosition) * PARTICLE_QUANTIZE_PIXELS_Y;
+		error = SDL_sqrt(dx * dx + dy * dy);
+		sum += error;
+		sum2 += error * error;
+		maxError = SDL_max(maxError, error);
+		overPixel += (error > 1.0) ? 1 : 0;
+
+		dx = particles[i].xVelocity - reference[i].xVelocity;
+		dy = particles[i].yVelocity - reference[i].yVelocity;
+		velocity2 += dx * dx + dy * dy;
+		reference2 += (double) reference[i].xVelocity * reference[i].xVelocity +
+			(double) reference[i].yVelocity * reference[i].yVelocity;
+
+		/* The gradient wraps at 1 */
+		gradientError = SDL_fabs(particles[i].gradientPosition - reference[i].gradientPosition);
+		gradientError = SDL_min(gradientError, SDL_fabs(1.0 - gradientError));
+		maxGradientError = SDL_max(maxGradientError, gradientError);
+	}
+
+	SDL_Log(
+		"  %-18s %2u B  position px mean %8.4f  rms %8.4f  max %8.3f  >1px %6.2f%%  velocity rms %6.3f%%  gradient max %.2e",
+		format->name,
+		format->size,
+		sum / sampleCount,
+		SDL_sqrt(sum2 / sampleCount),
+		maxError,
+		100.0 * overPixel / sampleCount,
+		100.0 * SDL_sqrt(velocity2 / SDL_max(reference2, 1e-30)),
+		maxGradientError
+	);
+}
+
+void ParticleQuantize_LogDrift(
+	const Particle *particles,
+	uint32_t count,
+	uint32_t stepCount,
+	uint32_t sampleCount,
+	ThreadPool *pool
+) {
+	ParticleQuantizeDriftContext context;
+	ParticleComputeUniforms *steps;
+	uint32_t i, format, checkpoint;
+	double t = 0.0;
+	double dt = 0.01;
+
+	if (count == 0 || stepCount == 0)
+	{
+		return;
+	}
+
+	sampleCount = SDL_max(SDL_min(sampleCount, count), 1);
+	steps = SDL_malloc(sizeof(ParticleComputeUniforms) * stepCount);
+	context.steps = steps;
+	context.sampleCount = sampleCount;
+	context.reference = SDL_malloc(sizeof(Particle) * sampleCount);
+	context.formats = SDL_malloc(sizeof(Particle) * sampleCount * PARTICLE_QUANTIZE_FORMAT_COUNT);
+
+	/* The same attractor path as the headless run */
+	for (i = 0; i < stepCount; i += 1)
+	{
+		t += dt;
+		Particle_FillUniforms(&steps[i], sampleCount, t, dt);
+	}
+
+	/* Spread the samples over the whole array, each format starting from
+	 * its own rounding of the initial state
+	 */
+	for (i = 0; i < sampleCount; i += 1)
+	{
+		context.reference[i] = particles[(uint32_t) ((uint64_t) i * count / sampleCount)];
+	}
+	for (format = 0; format < PARTICLE_QUANTIZE_FORMAT_COUNT; format += 1)
+	{
+		Particle *formatParticles = context.formats + (size_t) format * sampleCount;
+		SDL_memcpy(formatParticles, context.reference, sizeof(Particle) * sampleCount);
+		for (i = 0; i < sampleCount; i += 1)
+		{
+			particleQuantizeFormats[format].roundTrip(&formatParticles[i]);
+		}
+	}
+
+	SDL_Log(
+		"Quantization drift: %u of %u particles, %u steps against fp32 (32 B), positions in 1280x720 window pixels",
+		sampleCount,
+		count,
+		stepCount
+	);
+
+	context.endStep = 0;
+	for (checkpoint = 1; checkpoint <= PARTICLE_QUANTIZE_CHECKPOINTS; checkpoint += 1)
+	{
+		context.firstStep = context.endStep;
+		context.endStep = (uint32_t) ((uint64_t) stepCount * checkpoint / PARTICLE_QUANTIZE_CHECKPOINTS);
+		if (context.endStep == context.firstStep)
+		{
+			continue;
+		}
+
+		if (pool == NULL)
+		{
+			ParticleQuantize_DriftRange(&context, 0, sampleCount);
+		}
+		else
+		{
+			ThreadPool_ParallelFor(pool, sampleCount, 256, ParticleQuantize_DriftRange, &context);
+		}
+
+		SDL_Log(" after %u steps:", context.endStep);
+		for (format = 0; format < PARTICLE_QUANTIZE_FORMAT_COUNT; format += 1)
+		{
+			ParticleQuantize_LogFormatDrift(
+				&particleQuantizeFormats[format],
+				context.reference,
+				context.formats + (size_t) format * sampleCount,
+				sampleCount
+			);
+		}
+	}
+
+	SDL_free(steps);
+	SDL_free(context.reference);
+	SDL_free(context.formats);
+}
@@ -0,0 +1,63 @@
+#ifndef PARTICLE_QUANTIZE_H
+#define PARTICLE_QUANTIZE_H
+
+#include <stdint.h>
+
+#include "particle.h"
+#include "thread_pool.h"
+
+/* The 12 byte particle of PARTICLE_LAYOUT_QUANTIZED.
+ *
+ * Positions live in [-1, 1] and gradients in (-1, 1], so both are snorm16
+ * with a resolution of 1/32767, a fiftieth of a pixel across the 1280 pixel
+ * wide window. Velocities have no fixed range and are IEEE half floats.
+ * Matches the three words of struct QuantizedParticle in
+ * particle_quantized.comp, which are read with unpackSnorm2x16,
+ * unpackHalf2x16 and unpackSnorm2x16 respectively.
+ */
+typedef struct QuantizedParticle
+{
+	int16_t xPosition, yPosition;
+	uint16_t xVelocity, yVelocity; /* half */
+	int16_t gradientPosition;
+	int16_t padding;
+} QuantizedParticle;
+
+/* Round to nearest even, with subnormals, infinities and NaN kept */
+uint16_t ParticleQuantize_FloatToHalf(float value);
+float ParticleQuantize_HalfToFloat(uint16_t half);
+
+/* packSnorm2x16 and unpackSnorm2x16 for one component */
+int16_t ParticleQuantize_FloatToSnorm16(float value);
+float ParticleQuantize_Snorm16ToFloat(int16_t snorm);
+
+void ParticleQuantize_Encode(const Particle *particles, QuantizedParticle *quantized, uint32_t count);
+
+/* Fields the quantized layout does not store come back as zero */
+void ParticleQuantize_Decode(const QuantizedParticle *quantized, Particle *particles, uint32_t count);
+
+/* Default --validate tolerance for the quantized layout. A half rounds the
+ * velocity to within 2^-12 of its magnitude on every store, and a frame may
+ * store MAX_SUBSTEPS times before it is compared.
+ */
+#define PARTICLE_QUANTIZE_TOLERANCE 4e-3f
+
+/* Particles the drift report follows */
+#define PARTICLE_QUANTIZE_DRIFT_SAMPLES 16384
+
+/* Runs sampleCount of the particles through stepCount steps of
+ * CPUSim_ReferenceStep in fp32 and, side by side, in each candidate
+ * storage format, rounding every particle through the format after every
+ * step the way a kernel would load and store it. Logs the position error
+ * in window pixels and the velocity and gradient error against fp32 at
+ * four points along the way. The pool may be NULL.
+ */
+void ParticleQuantize_LogDrift(
+	const Particle *particles,
+	uint32_t count,
+	uint32_t stepCount,
+	uint32_t sampleCount,
+	ThreadPool *pool
+);
+
+#endif /* PARTICLE_QUANTIZE_H */
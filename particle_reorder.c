@@ -0,0 +1,497 @@
+#include "particle_reorder.h"
+
+#include <SDL.h>
+
+#include "bench.h"
+#include "particle_quantize.h"
+
+/* Two passes of 10 bits cover the 20 bit keys */
+#define PARTICLE_REORDER_DIGIT_BITS 10
+#define PARTICLE_REORDER_DIGIT_COUNT (1 << PARTICLE_REORDER_DIGIT_BITS)
+#define PARTICLE_REORDER_PASS_COUNT (PARTICLE_REORDER_KEY_BITS / PARTICLE_REORDER_DIGIT_BITS)
+
+/* Particles per block. Every block counts its digits into its own
+ * histogram and scatters from its own offsets, which keeps the sort
+ * stable however the blocks are spread over threads.
+ */
+#define PARTICLE_REORDER_BLOCK_SIZE 16384
+
+#define PARTICLE_REORDER_GRAIN_SIZE 4096
+
+struct ParticleReorder
+{
+	ThreadPool *pool;
+	uint32_t capacity;
+	uint32_t blockCount;
+
+	uint32_t *keys;       /* [capacity], ping-ponged with sortedKeys */
+	uint32_t *sortedKeys;
+	uint32_t *order;      /* [capacity], ping-ponged with sortedOrder */
+	uint32_t *sortedOrder;
+	uint32_t *histograms; /* [blockCount][DIGIT_COUNT], turned into offsets in place */
+	double *blockDistances;
+	float *scratch;       /* swapped with the stream being permuted */
+
+	uint32_t count; /* of the last sort */
+	ParticleReorderTimings timings;
+};
+
+typedef struct ParticleReorderContext
+{
+	ParticleReorder *reorder;
+	const float *xPosition;
+	const float *yPosition;
+	uint32_t count;
+
+	/* Radix pass */
+	uint32_t shift;
+	const uint32_t *keys;
+	const uint32_t *order; /* NULL for the identity */
+	uint32_t *sortedKeys;
+	uint32_t *sortedOrder;
+
+	/* Permutation */
+	const float *stream;
+} ParticleReorderContext;
+
+/* Keys */
+
+static uint32_t ParticleReorder_CellCoordinate(float position)
+{
+	float scaled = (position + 1.0f) * (PARTICLE_REORDER_GRID_SIZE * 0.5f);
+
+	/* NaN goes to the first cell */
+	if (!(scaled > 0.0f))
+	{
+		return 0;
+	}
+	if (scaled >= (float) (PARTICLE_REORDER_GRID_SIZE - 1))
+	{
+		return PARTICLE_REORDER_GRID_SIZE - 1;
+	}
+	return (uint32_t) scaled;
+}
+
+/* Moves the low 10 bits of value to the even bits */
+static uint32_t ParticleReorder_SpreadBits(uint32_t value)
+{
+	value &= 0x000003FF;
+	value = (value | (value << 8)) & 0x00FF00FF;
+	value = (value | (value << 4)) & 0x0F0F0F0F;
+	value = (value | (value << 2)) & 0x33333333;
+	value = (value | (value << 1)) & 0x55555555;
+	return value;
+}
+
+uint32_t ParticleReorder_GetKey(float x, float y)
+{
+	return ParticleReorder_SpreadBits(ParticleReorder_CellCoordinate(x)) |
+		(ParticleReorder_SpreadBits(ParticleReorder_CellCoordinate(y)) << 1);
+}
+
+uint32_t ParticleReorder_GetQuantizedKey(int16_t x, int16_t y)
+{
+	uint32_t cellX = (uint32_t) (x + 32768) >> (16 - PARTICLE_REORDER_CELL_BITS);
+	uint32_t cellY = (uint32_t) (y + 32768) >> (16 - PARTICLE_REORDER_CELL_BITS);
+
+	return ParticleReorder_SpreadBits(cellX) | (ParticleReorder_SpreadBits(cellY) << 1);
+}
+
+static double ParticleReorder_Distance(float x0, float y0, float x1, float y1)
+{
+	double dx = (double) x1 - x0;
+	double dy = (double) y1 - y0;
+	return SDL_sqrt(dx * dx + dy * dy);
+}
+
+/* Public API */
+
+ParticleReorder* ParticleReorder_Create(uint32_t particleCount, ThreadPool *pool)
+{
+	ParticleReorder *reorder = SDL_malloc(sizeof(ParticleReorder));
+	uint32_t capacity = SDL_max(particleCount, 1);
+
+	SDL_zerop(reorder);
+	reorder->pool = pool;
+	reorder->capacity = capacity;
+	reorder->blockCount = (capacity + PARTICLE_REORDER_BLOCK_SIZE - 1) / PARTICLE_REORDER_BLOCK_SIZE;
+
+	reorder->keys = SDL_malloc(sizeof(uint32_t) * capacity);
+	reorder->sortedKeys = SDL_malloc(sizeof(uint32_t) * capacity);
+	reorder->order = SDL_malloc(sizeof(uint32_t) * capacity);
+	reorder->sortedOrder = SDL_malloc(sizeof(uint32_t) * capacity);
+	reorder->histograms = SDL_malloc(sizeof(uint32_t) * PARTICLE_REORDER_DIGIT_COUNT * reorder->blockCount);
+	reorder->blockDistances = SDL_malloc(sizeof(double) * reorder->blockCount);
+	reorder->scratch = SDL_malloc(sizeof(float) * capacity);
+
+	return reorder;
+}
+
+void ParticleReorder_Destroy(ParticleReorder *reorder)
+{
+	if (reorder == NULL)
+	{
+		return;
+	}
+
+	SDL_free(reorder->keys);
+	SDL_free(reorder->sortedKeys);
+	SDL_free(reorder->order);
+	SDL_free(reorder->sortedOrder);
+	SDL_free(reorder->histograms);
+	SDL_free(reorder->blockDistances);
+	SDL_free(reorder->scratch);
+	SDL_free(reorder);
+}
+
+/* Threaded passes, over blocks except for the permutation */
+
+static void ParticleReorder_ParallelFor(ParticleReorder *reorder, uint32_t count, uint32_t grainSize, ThreadPoolRangeFunc func, void *userdata)
+{
+	if (reorder->pool == NULL)
+	{
+		func(userdata, 0, count);
+	}
+	else
+	{
+		ThreadPool_ParallelFor(reorder->pool, count, grainSize, func, userdata);
+	}
+}
+
+/* Keys, and the distance from each particle to the next in memory */
+static void ParticleReorder_KeyBlocks(void *userdata, uint32_t start, uint32_t end)
+{
+	ParticleReorderContext *context = (ParticleReorderContext*) userdata;
+	ParticleReorder *reorder = context->reorder;
+	uint32_t block, i, blockEnd;
+	double distance;
+
+	for (block = start; block < end; block += 1)
+	{
+		distance = 0.0;
+		blockEnd = SDL_min((block + 1) * PARTICLE_REORDER_BLOCK_SIZE, context->count);
+
+		for (i = block * PARTICLE_REORDER_BLOCK_SIZE; i < blockEnd; i += 1)
+		{
+			reorder->keys[i] = ParticleReorder_GetKey(context->xPosition[i], context->yPosition[i]);
+			if (i + 1 < context->count)
+			{
+				distance += ParticleReorder_Distance(
+					context->xPosition[i],
+					context->yPosition[i],
+					context->xPosition[i + 1],
+					context->yPosition[i + 1]
+				);
+			}
+		}
+
+		reorder->blockDistances[block] = distance;
+	}
+}
+
+static void ParticleReorder_CountBlocks(void *userdata, uint32_t start, uint32_t end)
+{
+	ParticleReorderContext *context = (ParticleReorderContext*) userdata;
+	uint32_t block, i, blockEnd;
+	uint32_t *histogram;
+
+	for (block = start; block < end; block += 1)
+	{
+		histogram = &context->reorder->histograms[block * PARTICLE_REORDER_DIGIT_COUNT];
+		SDL_memset(histogram, 0, sizeof(uint32_t) * PARTICLE_REORDER_DIGIT_COUNT);
+		blockEnd = SDL_min((block + 1) * PARTICLE_REORDER_BLOCK_SIZE, context->count);
+
+		for (i = block * PARTICLE_REORDER_BLOCK_SIZE; i < blockEnd; i += 1)
+		{
+			histogram[(context->keys[i] >> context->shift) & (PARTICLE_REORDER_DIGIT_COUNT - 1)] += 1;
+		}
+	}
+}
+
+static void ParticleReorder_ScatterBlocks(void *userdata, uint32_t start, uint32_t end)
+{
+	ParticleReorderContext *context = (ParticleReorderContext*) userdata;
+	uint32_t block, i, blockEnd, key, slot;
+	uint32_t *offsets;
+
+	for (block = start; block < end; block += 1)
+	{
+		offsets = &context->reorder->histograms[block * PARTICLE_REORDER_DIGIT_COUNT];
+		blockEnd = SDL_min((block + 1) * PARTICLE_REORDER_BLOCK_SIZE, context->count);
+
+		for (i = block * PARTICLE_REORDER_BLOCK_SIZE; i < blockEnd; i += 1)
+		{
+			key = context->keys[i];
+			slot = offsets[(key >> context->shift) & (PARTICLE_REORDER_DIGIT_COUNT - 1)]++;
+			context->sortedKeys[slot] = key;
+			context->sortedOrder[slot] = (context->order != NULL) ? context->order[i] : i;
+		}
+	}
+}
+
+/* The same distance once the particles are in their new order */
+static void ParticleReorder_SortedDistanceBlocks(void *userdata, uint32_t start, uint32_t end)
+{
+	ParticleReorderContext *context = (ParticleReorderContext*) userdata;
+	ParticleReorder *reorder = context->reorder;
+	uint32_t block, i, blockEnd, from, to;
+	double distance;
+
+	for (block = start; block < end; block += 1)
+	{
+		distance = 0.0;
+		blockEnd = SDL_min((block + 1) * PARTICLE_REORDER_BLOCK_SIZE, context->count - 1);
+
+		for (i = block * PARTICLE_REORDER_BLOCK_SIZE; i < blockEnd; i += 1)
+		{
+			from = reorder->order[i];
+			to = reorder->order[i + 1];
+			distance += ParticleReorder_Distance(
+				context->xPosition[from],
+				context->yPosition[from],
+				context->xPosition[to],
+				context->yPosition[to]
+			);
+		}
+
+		reorder->blockDistances[block] = distance;
+	}
+}
+
+static void ParticleReorder_PermuteRange(void *userdata, uint32_t start, uint32_t end)
+{
+	ParticleReorderContext *context = (ParticleReorderContext*) userdata;
+	const uint32_t *order = context->reorder->order;
+	float *scratch = context->reorder->scratch;
+	uint32_t i;
+
+	for (i = start; i < end; i += 1)
+	{
+		scratch[i] = context->stream[order[i]];
+	}
+}
+
+static double ParticleReorder_SumBlockDistances(ParticleReorder *reorder, uint32_t blockCount)
+{
+	double sum = 0.0;
+	uint32_t block;
+
+	/* In block order, so the total does not depend on the thread count */
+	for (block = 0; block < blockCount; block += 1)
+	{
+		sum += reorder->blockDistances[block];
+	}
+
+	return sum;
+}
+
+const uint32_t* ParticleReorder_Sort(
+	ParticleReorder *reorder,
+	const float *xPosition,
+	const float *yPosition,
+	uint32_t count
+) {
+	ParticleReorderContext context;
+	uint64_t start = Bench_Now();
+	uint32_t blockCount, pass, digit, block, running, digitCount;
+	uint32_t *swap;
+
+	count = SDL_min(count, reorder->capacity);
+	blockCount = (count + PARTICLE_REORDER_BLOCK_SIZE - 1) / PARTICLE_REORDER_BLOCK_SIZE;
+
+	SDL_zero(context);
+	context.reorder = reorder;
+	context.xPosition = xPosition;
+	context.yPosition = yPosition;
+	context.count = count;
+
+	ParticleReorder_ParallelFor(reorder, blockCount, 1, ParticleReorder_KeyBlocks, &context);
+	if (count > 1)
+	{
+		reorder->timings.distanceBefore += ParticleReorder_SumBlockDistances(reorder, blockCount) / (count - 1);
+	}
+
+	for (pass = 0; pass < PARTICLE_REORDER_PASS_COUNT; pass += 1)
+	{
+		context.shift = pass * PARTICLE_REORDER_DIGIT_BITS;
+		context.keys = reorder->keys;
+		context.order = (pass > 0) ? reorder->order : NULL;
+		context.sortedKeys = reorder->sortedKeys;
+		context.sortedOrder = reorder->sortedOrder;
+
+		ParticleReorder_ParallelFor(reorder, blockCount, 1, ParticleReorder_CountBlocks, &context);
+
+		/* Exclusive prefix sum, digit by digit and within a digit block by
+		 * block, so earlier blocks keep their particles first
+		 */
+		running = 0;
+		for (digit = 0; digit < PARTICLE_REORDER_DIGIT_COUNT; digit += 1)
+		{
+			for (block = 0; block < blockCount; block += 1)
+			{
+				digitCount = reorder->histograms[block * PARTICLE_REORDER_DIGIT_COUNT + digit];
+				reorder->histograms[block * PARTICLE_REORDER_DIGIT_COUNT + digit] = running;
+				running += digitCount;
+			}
+		}
+
+		ParticleReorder_ParallelFor(reorder, blockCount, 1, ParticleReorder_ScatterBlocks, &context);
+
+		swap = reorder->keys;
+		reorder->keys = reorder->sortedKeys;
+		reorder->sortedKeys = swap;
+		swap = reorder->order;
+		reorder->order = reorder->sortedOrder;
+		reorder->sortedOrder = swap;
+	}
+
+	if (count > 1)
+	{
+		ParticleReorder_ParallelFor(reorder, blockCount, 1, ParticleReorder_SortedDistanceBlocks, &context);
+		reorder->timings.distanceAfter += ParticleReorder_SumBlockDistances(reorder, blockCount) / (count - 1);
+	}
+
+	reorder->count = count;
+	reorder->timings.sortCount += 1;
+	reorder->timings.sortSeconds += Bench_Seconds(start, Bench_Now());
+
+	return reorder->order;
+}
+
+void ParticleReorder_Permute(ParticleReorder *reorder, float **stream)
+{
+	ParticleReorderContext context;
+	uint64_t start = Bench_Now();
+	float *swap;
+
+	SDL_zero(context);
+	context.reorder = reorder;
+	context.stream = *stream;
+
+	ParticleReorder_ParallelFor(reorder, reorder->count, PARTICLE_REORDER_GRAIN_SIZE, ParticleReorder_PermuteRange, &context);
+
+	swap = *stream;
+	*stream = reorder->scratch;
+	reorder->scratch = swap;
+
+	reorder->timings.sortSeconds += Bench_Seconds(start, Bench_Now());
+}
+
+/* Reference: one serial counting sort over the whole key, visiting
+ * particles in index order
+ */
+
+static uint32_t* ParticleReorder_ReferenceOrder(const Particle *particles, uint32_t count, ParticleLayout layout)
+{
+	uint32_t keyCount = 1u << PARTICLE_REORDER_KEY_BITS;
+	uint32_t *cursor = SDL_calloc(keyCount, sizeof(uint32_t));
+	uint32_t *keys = SDL_malloc(sizeof(uint32_t) * SDL_max(count, 1));
+	uint32_t *order = SDL_malloc(sizeof(uint32_t) * SDL_max(count, 1));
+	uint32_t i, key, running, keyTotal;
+
+	for (i = 0; i < count; i += 1)
+	{
+		if (layout == PARTICLE_LAYOUT_QUANTIZED)
+		{
+			key = ParticleReorder_GetQuantizedKey(
+				ParticleQuantize_FloatToSnorm16(particles[i].xPosition),
+				ParticleQuantize_FloatToSnorm16(particles[i].yPosition)
+			);
+		}
+		else
+		{
+			key = ParticleReorder_GetKey(particles[i].xPosition, particles[i].yPosition);
+		}
+		keys[i] = key;
+		cursor[key] += 1;
+	}
+
+	running = 0;
+	for (key = 0; key < keyCount; key += 1)
+	{
+		keyTotal = cursor[key];
+		cursor[key] = running;
+		running += keyTotal;
+	}
+
+	for (i = 0; i < count; i += 1)
+	{
+		order[cursor[keys[i]]++] = i;
+	}
+
+	SDL_free(cursor);
+	SDL_free(keys);
+	return order;
+}
+
+void ParticleReorder_ReferenceApply(Particle *particles, uint32_t count, ParticleLayout layout)
+{
+	uint32_t *order = ParticleReorder_ReferenceOrder(particles, count, layout);
+	Particle *sorted = SDL_malloc(sizeof(Particle) * SDL_max(count, 1));
+	uint32_t i;
+
+	for (i = 0; i < count; i += 1)
+	{
+		sorted[i] = particles[order[i]];
+	}
+	SDL_memcpy(particles, sorted, sizeof(Particle) * count);
+
+	SDL_free(sorted);
+	SDL_free(order);
+}
+
+void ParticleReorder_GetTimings(ParticleReorder *reorder, ParticleReorderTimings *timings)
+{
+	*timings = reorder->timings;
+}
+
+void ParticleReorder_LogTimings(ParticleReorder *reorder)
+{
+	ParticleReorderTimings *timings = &reorder->timings;
+	double scale = (timings->sortCount > 0) ? (1.0 / timings->sortCount) : 0.0;
+
+	SDL_Log(
+		"Morton reorder, %u sorts: %.3f ms per sort, neighbors in memory %.5f apart before a sort and %.5f after",
+		timings->sortCount,
+		timings->sortSeconds * scale * 1000.0,
+		timings->distanceBefore * scale,
+		timings->distanceAfter * scale
+	);
+}
+
+void ParticleReorder_LogLocality(const Particle *particles, uint32_t count, ParticleLayout layout)
+{
+	uint32_t *order;
+	double before = 0.0;
+	double after = 0.0;
+	uint32_t i;
+
+	if (count < 2)
+	{
+		return;
+	}
+
+	order = ParticleReorder_ReferenceOrder(particles, count, layout);
+	for (i = 0; i + 1 < count; i += 1)
+	{
+		before += ParticleReorder_Distance(
+			particles[i].xPosition,
+			particles[i].yPosition,
+			particles[i + 1].xPosition,
+			particles[i + 1].yPosition
+		);
+		after += ParticleReorder_Distance(
+			particles[order[i]].xPosition,
+			particles[order[i]].yPosition,
+			particles[order[i + 1]].xPosition,
+			particles[order[i + 1]].yPosition
+		);
+	}
+	SDL_free(order);
+
+	SDL_Log(
+		"Morton reorder: neighbors in memory are %.5f apart at the end of the run, %.5f if sorted now",
+		before / (count - 1),
+		after / (count - 1)
+	);
+}
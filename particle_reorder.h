@@ -0,0 +1,84 @@
+#ifndef PARTICLE_REORDER_H
+#define PARTICLE_REORDER_H
+
+#include <stdint.h>
+
+#include "particle.h"
+#include "thread_pool.h"
+
+/* Periodic Z-order (Morton) sorting of the particles in memory.
+ *
+ * Particles start out in random order and the simulation never moves them
+ * in memory, so neighbors in space are scattered across the whole buffer.
+ * Sorting them along a Z-order curve every so often puts particles that are
+ * close in space close in memory again, which is what the neighbor grid,
+ * the mesh deposit and the splat binning all walk through.
+ *
+ * The key of a particle interleaves the bits of its cell on a
+ * PARTICLE_REORDER_GRID_SIZE square grid over [-1, 1], positions outside
+ * clamped to the border. Keys are sorted with a stable LSD radix sort,
+ * ties kept in memory order, so the permutation only depends on the keys:
+ * the threaded sort here, the reference and particle_reorder.comp (see
+ * particle_reorder_gpu.h) all produce the same one.
+ *
+ * The sort also measures locality as the mean distance between particles
+ * that are next to each other in memory, before and after, so the gain can
+ * be weighed against the time the sort takes when picking an interval.
+ */
+
+#define PARTICLE_REORDER_CELL_BITS 10
+#define PARTICLE_REORDER_GRID_SIZE (1 << PARTICLE_REORDER_CELL_BITS)
+#define PARTICLE_REORDER_KEY_BITS (2 * PARTICLE_REORDER_CELL_BITS)
+
+typedef struct ParticleReorderTimings
+{
+	uint32_t sortCount;
+	double sortSeconds;    /* keys, sort and permutation */
+	double distanceBefore; /* summed over the sorts */
+	double distanceAfter;
+} ParticleReorderTimings;
+
+typedef struct ParticleReorder ParticleReorder;
+
+/* pool may be NULL */
+ParticleReorder* ParticleReorder_Create(uint32_t particleCount, ThreadPool *pool);
+void ParticleReorder_Destroy(ParticleReorder *reorder);
+
+/* The Morton key of a position, and of a quantized layout's snorm16
+ * position, whose grid is the same but whose cells are found without
+ * floating point
+ */
+uint32_t ParticleReorder_GetKey(float x, float y);
+uint32_t ParticleReorder_GetQuantizedKey(int16_t x, int16_t y);
+
+/* Sorts count positions and returns the new order: entry i is the index
+ * the particle that goes to i comes from. Valid until the next sort.
+ */
+const uint32_t* ParticleReorder_Sort(
+	ParticleReorder *reorder,
+	const float *xPosition,
+	const float *yPosition,
+	uint32_t count
+);
+
+/* Moves *stream into the order of the last sort. The stream is gathered
+ * into a scratch buffer that is swapped with it, so *stream must come from
+ * SDL_malloc and may point elsewhere afterwards.
+ */
+void ParticleReorder_Permute(ParticleReorder *reorder, float **stream);
+
+/* Single-threaded sort and permutation of the GPU layout, for validation.
+ * For PARTICLE_LAYOUT_QUANTIZED the keys are taken from the positions
+ * rounded back to snorm16, as particle_reorder.comp sees them.
+ */
+void ParticleReorder_ReferenceApply(Particle *particles, uint32_t count, ParticleLayout layout);
+
+void ParticleReorder_GetTimings(ParticleReorder *reorder, ParticleReorderTimings *timings);
+void ParticleReorder_LogTimings(ParticleReorder *reorder);
+
+/* Logs the locality of particles as they are, and as a sort would leave
+ * them, for a state the CPU did not sort itself
+ */
+void ParticleReorder_LogLocality(const Particle *particles, uint32_t count, ParticleLayout layout);
+
+#endif /* PARTICLE_REORDER_H */
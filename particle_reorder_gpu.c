@@ -0,0 +1,250 @@
+#include "particle_reorder_gpu.h"
+
+#include <stdbool.h>
+
+#include <SDL.h>
+
+#include "compute_pass.h"
+#include "particle_snapshot.h"
+
+/* Particles per workgroup, and so per tile of the sort */
+#define PARTICLE_REORDER_GPU_TILE_SIZE 256
+
+#define PARTICLE_REORDER_GPU_DIGIT_BITS 4
+#define PARTICLE_REORDER_GPU_DIGIT_COUNT (1 << PARTICLE_REORDER_GPU_DIGIT_BITS)
+#define PARTICLE_REORDER_GPU_PASS_COUNT (PARTICLE_REORDER_KEY_BITS / PARTICLE_REORDER_GPU_DIGIT_BITS)
+
+/* The guaranteed maxComputeWorkGroupCount; the tile passes cannot stride */
+#define PARTICLE_REORDER_GPU_MAX_TILES 65535
+
+/* Matches the UBO block in particle_reorder.comp */
+typedef struct ParticleReorderUniforms
+{
+	uint32_t particleCount;
+	uint32_t tileCount;
+	uint32_t shift;
+	uint32_t wordsPerParticle;
+} ParticleReorderUniforms;
+
+struct ParticleReorderGPU
+{
+	uint32_t particleCount;
+	uint32_t tileCount;
+	uint32_t streamCount;
+	uint32_t wordsPerParticle[MAX_PARTICLE_BUFFERS];
+
+	/* Every stream as it was before the sort, gathered from */
+	ParticleSnapshot snapshot;
+
+	/* Ping-ponged between radix passes */
+	REFRESH_Buffer *keys[2];
+	REFRESH_Buffer *order[2];
+	REFRESH_Buffer *tileOffsets; /* [DIGIT_COUNT][tileCount] */
+
+	ComputePass keyPass;
+	ComputePass countPasses[2];   /* counting keys[i] */
+	ComputePass scanPass;
+	ComputePass scatterPasses[2]; /* from keys[i] and order[i] into the other pair */
+	ComputePass gatherPasses[MAX_PARTICLE_BUFFERS];
+};
+
+ParticleReorderGPU* ParticleReorderGPU_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ParticleBuffers *particleBuffers
+) {
+	uint32_t i;
+	bool created;
+	uint32_t particleCount = particleBuffers->particleCount;
+	uint32_t tileCount = (particleCount + PARTICLE_REORDER_GPU_TILE_SIZE - 1) / PARTICLE_REORDER_GPU_TILE_SIZE;
+	uint32_t keyBufferSize = sizeof(uint32_t) * SDL_max(particleCount, 1);
+	ParticleReorderGPU *reorderGPU;
+
+	if (tileCount > PARTICLE_REORDER_GPU_MAX_TILES)
+	{
+		SDL_Log("The GPU reorder sorts at most %u particles", PARTICLE_REORDER_GPU_MAX_TILES * PARTICLE_REORDER_GPU_TILE_SIZE);
+		return NULL;
+	}
+
+	reorderGPU = SDL_malloc(sizeof(ParticleReorderGPU));
+	SDL_zerop(reorderGPU);
+	reorderGPU->particleCount = particleCount;
+	reorderGPU->tileCount = tileCount;
+	reorderGPU->streamCount = particleBuffers->bufferCount;
+
+	/* Every stream is a whole number of words per particle */
+	for (i = 0; i < particleBuffers->bufferCount; i += 1)
+	{
+		reorderGPU->wordsPerParticle[i] = (particleCount > 0) ?
+			particleBuffers->bufferSizes[i] / particleCount / sizeof(uint32_t) :
+			0;
+	}
+
+	for (i = 0; i < 2; i += 1)
+	{
+		reorderGPU->keys[i] = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, keyBufferSize);
+		reorderGPU->order[i] = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, keyBufferSize);
+	}
+	reorderGPU->tileOffsets = REFRESH_CreateBuffer(
+		device,
+		REFRESH_BUFFERUSAGE_COMPUTE_BIT,
+		sizeof(uint32_t) * PARTICLE_REORDER_GPU_DIGIT_COUNT * SDL_max(tileCount, 1)
+	);
+
+	created = ParticleSnapshot_Create(device, shaderCache, &reorderGPU->snapshot, particleBuffers);
+
+	/* Positions are the first words of buffers[0] in every layout */
+	REFRESH_Buffer *keyBindings[] = {
+		reorderGPU->snapshot.buffers[0],
+		reorderGPU->keys[0],
+		reorderGPU->order[0]
+	};
+	REFRESH_Buffer *scanBindings[] = { reorderGPU->tileOffsets };
+
+	created = ComputePass_Create(
+		device,
+		shaderCache,
+		&reorderGPU->keyPass,
+		(particleBuffers->layout == PARTICLE_LAYOUT_QUANTIZED) ? "reorder_quantized_key.comp.spv" : "reorder_key.comp.spv",
+		sizeof(ParticleReorderUniforms),
+		keyBindings,
+		SDL_arraysize(keyBindings)
+	) && created;
+
+	created = ComputePass_Create(
+		device,
+		shaderCache,
+		&reorderGPU->scanPass,
+		"reorder_scan.comp.spv",
+		sizeof(ParticleReorderUniforms),
+		scanBindings,
+		SDL_arraysize(scanBindings)
+	) && created;
+
+	for (i = 0; i < 2; i += 1)
+	{
+		REFRESH_Buffer *countBindings[] = { reorderGPU->keys[i], reorderGPU->tileOffsets };
+		REFRESH_Buffer *scatterBindings[] = {
+			reorderGPU->keys[i],
+			reorderGPU->order[i],
+			reorderGPU->tileOffsets,
+			reorderGPU->keys[1 - i],
+			reorderGPU->order[1 - i]
+		};
+
+		created = ComputePass_Create(
+			device,
+			shaderCache,
+			&reorderGPU->countPasses[i],
+			"reorder_count.comp.spv",
+			sizeof(ParticleReorderUniforms),
+			countBindings,
+			SDL_arraysize(countBindings)
+		) && created;
+
+		created = ComputePass_Create(
+			device,
+			shaderCache,
+			&reorderGPU->scatterPasses[i],
+			"reorder_scatter.comp.spv",
+			sizeof(ParticleReorderUniforms),
+			scatterBindings,
+			SDL_arraysize(scatterBindings)
+		) && created;
+	}
+
+	for (i = 0; i < particleBuffers->bufferCount; i += 1)
+	{
+		REFRESH_Buffer *gatherBindings[] = {
+			reorderGPU->order[PARTICLE_REORDER_GPU_PASS_COUNT % 2],
+			reorderGPU->snapshot.buffers[i],
+			particleBuffers->buffers[i]
+		};
+
+		created = ComputePass_Create(
+			device,
+			shaderCache,
+			&reorderGPU->gatherPasses[i],
+			"reorder_gather.comp.spv",
+			sizeof(ParticleReorderUniforms),
+			gatherBindings,
+			SDL_arraysize(gatherBindings)
+		) && created;
+	}
+
+	if (!created)
+	{
+		ParticleReorderGPU_Destroy(device, reorderGPU);
+		return NULL;
+	}
+
+	return reorderGPU;
+}
+
+void ParticleReorderGPU_Destroy(REFRESH_Device *device, ParticleReorderGPU *reorderGPU)
+{
+	uint32_t i;
+
+	if (reorderGPU == NULL)
+	{
+		return;
+	}
+
+	ComputePass_Destroy(device, &reorderGPU->keyPass);
+	ComputePass_Destroy(device, &reorderGPU->scanPass);
+	for (i = 0; i < 2; i += 1)
+	{
+		ComputePass_Destroy(device, &reorderGPU->countPasses[i]);
+		ComputePass_Destroy(device, &reorderGPU->scatterPasses[i]);
+	}
+	for (i = 0; i < reorderGPU->streamCount; i += 1)
+	{
+		ComputePass_Destroy(device, &reorderGPU->gatherPasses[i]);
+	}
+	ParticleSnapshot_Destroy(device, &reorderGPU->snapshot);
+
+	for (i = 0; i < 2; i += 1)
+	{
+		REFRESH_AddDisposeBuffer(device, reorderGPU->keys[i]);
+		REFRESH_AddDisposeBuffer(device, reorderGPU->order[i]);
+	}
+	REFRESH_AddDisposeBuffer(device, reorderGPU->tileOffsets);
+	SDL_free(reorderGPU);
+}
+
+void ParticleReorderGPU_Record(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	ParticleReorderGPU *reorderGPU
+) {
+	ParticleReorderUniforms uniforms;
+	uint32_t pass, i;
+
+	if (reorderGPU->particleCount == 0)
+	{
+		return;
+	}
+
+	uniforms.particleCount = reorderGPU->particleCount;
+	uniforms.tileCount = reorderGPU->tileCount;
+	uniforms.shift = 0;
+	uniforms.wordsPerParticle = reorderGPU->wordsPerParticle[0];
+
+	ParticleSnapshot_Record(device, commandBuffer, &reorderGPU->snapshot);
+	ComputePass_Record(device, commandBuffer, &reorderGPU->keyPass, &uniforms, reorderGPU->tileCount);
+
+	for (pass = 0; pass < PARTICLE_REORDER_GPU_PASS_COUNT; pass += 1)
+	{
+		uniforms.shift = pass * PARTICLE_REORDER_GPU_DIGIT_BITS;
+
+		ComputePass_Record(device, commandBuffer, &reorderGPU->countPasses[pass % 2], &uniforms, reorderGPU->tileCount);
+		ComputePass_Record(device, commandBuffer, &reorderGPU->scanPass, &uniforms, 1);
+		ComputePass_Record(device, commandBuffer, &reorderGPU->scatterPasses[pass % 2], &uniforms, reorderGPU->tileCount);
+	}
+
+	for (i = 0; i < reorderGPU->streamCount; i += 1)
+	{
+		uniforms.wordsPerParticle = reorderGPU->wordsPerParticle[i];
+		ComputePass_Record(device, commandBuffer, &reorderGPU->gatherPasses[i], &uniforms, reorderGPU->tileCount);
+	}
+}
@@ -0,0 +1,38 @@
+#ifndef PARTICLE_REORDER_GPU_H
+#define PARTICLE_REORDER_GPU_H
+
+#include <Refresh.h>
+
+#include "particle_buffers.h"
+#include "particle_reorder.h"
+#include "shader_module.h"
+
+/* The particle_reorder.comp passes and their scratch buffers.
+ *
+ * Recording a reorder snapshots every particle stream (particle_snapshot.h),
+ * computes the Morton keys from the snapshot, sorts them with five 4-bit
+ * radix passes of count, scan and scatter, and gathers every stream back
+ * into the particle buffers in sorted order. That is 16 dispatches plus two
+ * per stream, each rebinding its buffers so Refresh places a barrier
+ * between them. Record it before a frame's steps, never between them.
+ */
+
+typedef struct ParticleReorderGPU ParticleReorderGPU;
+
+/* Returns NULL if a shader could not be loaded or there are more than
+ * 65535 tiles of 256 particles
+ */
+ParticleReorderGPU* ParticleReorderGPU_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ParticleBuffers *particleBuffers
+);
+void ParticleReorderGPU_Destroy(REFRESH_Device *device, ParticleReorderGPU *reorderGPU);
+
+void ParticleReorderGPU_Record(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	ParticleReorderGPU *reorderGPU
+);
+
+#endif /* PARTICLE_REORDER_GPU_H */
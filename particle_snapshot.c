@@ -0,0 +1,91 @@
+#include "particle_snapshot.h"
+
+#include <SDL.h>
+
+/* Past the guaranteed maxComputeWorkGroupCount; particle_snapshot.comp strides */
+#define PARTICLE_SNAPSHOT_MAX_GROUPS 65535
+
+/* Matches the UBO block in particle_snapshot.comp */
+typedef struct ParticleSnapshotUniforms
+{
+	uint32_t wordCount;
+	uint32_t invocationCount;
+} ParticleSnapshotUniforms;
+
+bool ParticleSnapshot_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ParticleSnapshot *snapshot,
+	ParticleBuffers *particleBuffers
+) {
+	uint32_t i;
+	REFRESH_Buffer *buffers[2];
+
+	SDL_zerop(snapshot);
+
+	for (i = 0; i < particleBuffers->bufferCount; i += 1)
+	{
+		snapshot->bufferSizes[i] = particleBuffers->bufferSizes[i];
+		snapshot->buffers[i] = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, snapshot->bufferSizes[i]);
+		snapshot->bufferCount = i + 1;
+
+		buffers[0] = particleBuffers->buffers[i];
+		buffers[1] = snapshot->buffers[i];
+		if (!ComputePass_Create(
+			device,
+			shaderCache,
+			&snapshot->passes[i],
+			"particle_snapshot.comp.spv",
+			sizeof(ParticleSnapshotUniforms),
+			buffers,
+			2
+		)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void ParticleSnapshot_Destroy(REFRESH_Device *device, ParticleSnapshot *snapshot)
+{
+	uint32_t i;
+
+	for (i = 0; i < snapshot->bufferCount; i += 1)
+	{
+		ComputePass_Destroy(device, &snapshot->passes[i]);
+		REFRESH_AddDisposeBuffer(device, snapshot->buffers[i]);
+	}
+
+	snapshot->bufferCount = 0;
+}
+
+void ParticleSnapshot_Record(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	ParticleSnapshot *snapshot
+) {
+	ParticleSnapshotUniforms uniforms;
+	uint32_t groupCount;
+	uint32_t i;
+
+	for (i = 0; i < snapshot->bufferCount; i += 1)
+	{
+		/* Every stream is a whole number of 4-byte words */
+		uniforms.wordCount = snapshot->bufferSizes[i] / sizeof(uint32_t);
+		groupCount = SDL_min((uniforms.wordCount + 255) / 256, PARTICLE_SNAPSHOT_MAX_GROUPS);
+		uniforms.invocationCount = SDL_max(groupCount, 1) * 256;
+
+		ComputePass_Record(device, commandBuffer, &snapshot->passes[i], &uniforms, groupCount);
+	}
+}
+
+void ParticleSnapshot_Download(REFRESH_Device *device, ParticleSnapshot *snapshot, uint8_t *const *streams)
+{
+	uint32_t i;
+
+	for (i = 0; i < snapshot->bufferCount; i += 1)
+	{
+		REFRESH_GetBufferData(device, snapshot->buffers[i], streams[i], snapshot->bufferSizes[i]);
+	}
+}
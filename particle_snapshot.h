@@ -0,0 +1,54 @@
+#ifndef PARTICLE_SNAPSHOT_H
+#define PARTICLE_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <Refresh.h>
+
+#include "compute_pass.h"
+#include "particle_buffers.h"
+#include "shader_module.h"
+
+/* A copy of every particle stream taken in the middle of a command buffer,
+ * for readbacks that must not stall the frame (checkpoints, the trajectory
+ * export).
+ *
+ * Refresh has no buffer-to-buffer copy, so each stream is copied by a
+ * particle_snapshot.comp dispatch into a buffer of the same size. The
+ * particle buffers keep changing every frame, while the snapshot stays put
+ * until the caller has read it back, once the frame has retired.
+ */
+
+typedef struct ParticleSnapshot
+{
+	ComputePass passes[MAX_PARTICLE_BUFFERS];
+	REFRESH_Buffer *buffers[MAX_PARTICLE_BUFFERS];
+	uint32_t bufferSizes[MAX_PARTICLE_BUFFERS]; /* in bytes */
+	uint32_t bufferCount;
+} ParticleSnapshot;
+
+/* Returns false if the copy shader could not be loaded. The snapshot may
+ * be partially created either way and must still be destroyed.
+ */
+bool ParticleSnapshot_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ParticleSnapshot *snapshot,
+	ParticleBuffers *particleBuffers
+);
+void ParticleSnapshot_Destroy(REFRESH_Device *device, ParticleSnapshot *snapshot);
+
+/* Records the copy of every stream, after whatever updated the particles */
+void ParticleSnapshot_Record(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	ParticleSnapshot *snapshot
+);
+
+/* Reads stream i into streams[i]; the caller is responsible for
+ * synchronization
+ */
+void ParticleSnapshot_Download(REFRESH_Device *device, ParticleSnapshot *snapshot, uint8_t *const *streams);
+
+#endif /* PARTICLE_SNAPSHOT_H */
@@ -0,0 +1,57 @@
+#include "readback_ring.h"
+
+#include <SDL.h>
+
+void ReadbackRing_Create(ReadbackRing *ring, uint32_t latency, uint32_t slotCount)
+{
+	SDL_zerop(ring);
+
+	ring->latency = SDL_max(latency, 1);
+	ring->slotCount = (slotCount > 0) ? slotCount : ring->latency + 1;
+	ring->slots = SDL_calloc(ring->slotCount, sizeof(ReadbackRingSlot));
+}
+
+void ReadbackRing_Destroy(ReadbackRing *ring)
+{
+	SDL_free(ring->slots);
+	ring->slots = NULL;
+}
+
+bool ReadbackRing_CanRecord(const ReadbackRing *ring)
+{
+	return !ring->slots[ring->nextRecordSlot].pending;
+}
+
+uint32_t ReadbackRing_Record(ReadbackRing *ring)
+{
+	uint32_t index = ring->nextRecordSlot;
+
+	SDL_assert(!ring->slots[index].pending);
+
+	ring->slots[index].pending = true;
+	ring->slots[index].recordedFrame = ring->frameIndex;
+	ring->nextRecordSlot = (index + 1) % ring->slotCount;
+
+	return index;
+}
+
+bool ReadbackRing_Retire(ReadbackRing *ring, bool drained, uint32_t *slot)
+{
+	ReadbackRingSlot *oldest = &ring->slots[ring->nextRetireSlot];
+
+	if (!oldest->pending || (!drained && ring->frameIndex - oldest->recordedFrame < ring->latency))
+	{
+		return false;
+	}
+
+	oldest->pending = false;
+	*slot = ring->nextRetireSlot;
+	ring->nextRetireSlot = (ring->nextRetireSlot + 1) % ring->slotCount;
+
+	return true;
+}
+
+void ReadbackRing_EndFrame(ReadbackRing *ring)
+{
+	ring->frameIndex += 1;
+}
@@ -0,0 +1,68 @@
+#ifndef READBACK_RING_H
+#define READBACK_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Bookkeeping for GPU readbacks that must not stall the frame (frame
+ * captures, checkpoints, the trajectory export).
+ *
+ * A readback is recorded into one of a ring of slots and read back once
+ * `latency` more frames have been submitted. Slots are filled and retired
+ * in order. The ring only tracks which slots are in flight; the buffers,
+ * snapshots and whatever goes with them live in the caller's own array,
+ * indexed by slot.
+ *
+ * Refresh does not expose per-submission fences. Its Submit waits for the
+ * previous submission to retire before queueing the next one, so a copy
+ * recorded in frame N is complete once frame N + 1 has been submitted, and
+ * latency is at least 1. With latency + 1 slots, latency frames in flight
+ * plus the one being recorded, recording every frame never finds its slot
+ * busy.
+ *
+ * Every call is made on the thread that records and submits the frames.
+ */
+
+typedef struct ReadbackRingSlot
+{
+	bool pending;
+	uint64_t recordedFrame;
+} ReadbackRingSlot;
+
+typedef struct ReadbackRing
+{
+	ReadbackRingSlot *slots;
+	uint32_t slotCount;
+	uint32_t latency;
+	uint64_t frameIndex; /* frame currently being recorded */
+	uint32_t nextRecordSlot;
+	uint32_t nextRetireSlot;
+} ReadbackRing;
+
+/* latency is clamped to at least 1. slotCount 0 makes latency + 1 slots;
+ * fewer save memory, and drop readbacks recorded while every slot is in
+ * flight.
+ */
+void ReadbackRing_Create(ReadbackRing *ring, uint32_t latency, uint32_t slotCount);
+
+/* Safe on a zeroed ring */
+void ReadbackRing_Destroy(ReadbackRing *ring);
+
+/* Whether the next slot is free to record into */
+bool ReadbackRing_CanRecord(const ReadbackRing *ring);
+
+/* Marks the next slot in flight from the current frame and returns its
+ * index. Only call it when ReadbackRing_CanRecord.
+ */
+uint32_t ReadbackRing_Record(ReadbackRing *ring);
+
+/* Takes the oldest slot in flight once it is at least latency frames old,
+ * or whatever its age if drained, after REFRESH_Wait. Returns false when
+ * there is none; call it until then.
+ */
+bool ReadbackRing_Retire(ReadbackRing *ring, bool drained, uint32_t *slot);
+
+/* Call once per frame after REFRESH_Submit and retiring */
+void ReadbackRing_EndFrame(ReadbackRing *ring);
+
+#endif /* READBACK_RING_H */
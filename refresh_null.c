@@ -0,0 +1,706 @@
+/* The recording null device: every REFRESH_ device call the program makes,
+ * implemented without a GPU and logged with refresh_record.h. Linked ahead
+ * of libRefresh in the RefreshComputeNull build, whose image helpers still
+ * come from the library.
+ */
+
+#include <Refresh.h>
+
+#include <SDL.h>
+
+#include "refresh_record.h"
+#include "shader_bundle.h"
+
+typedef struct NullObject
+{
+	uint32_t id;
+} NullObject;
+
+typedef struct NullBuffer
+{
+	NullObject object;
+	uint32_t size;
+	uint8_t *contents;
+	bool uploaded; /* the first upload's contents went into the log */
+} NullBuffer;
+
+typedef struct NullComputePipeline
+{
+	NullObject object;
+	uint32_t bufferBindingCount;
+	uint32_t uniformBufferSize;
+} NullComputePipeline;
+
+typedef struct NullGraphicsPipeline
+{
+	NullObject object;
+	uint32_t fragmentSamplerBindingCount;
+} NullGraphicsPipeline;
+
+typedef struct NullCommandBuffer
+{
+	NullObject object;
+	NullComputePipeline *computePipeline;
+	NullGraphicsPipeline *graphicsPipeline;
+	uint32_t paramOffset;
+} NullCommandBuffer;
+
+typedef struct NullDevice
+{
+	RefreshRecordWriter *writer;
+	char *path;
+	SDL_atomic_t lastId;
+} NullDevice;
+
+static uint32_t NullDevice_GetId(const void *object)
+{
+	return (object != NULL) ? ((const NullObject*) object)->id : 0;
+}
+
+static void* NullDevice_CreateObject(NullDevice *device, size_t size)
+{
+	NullObject *object = SDL_malloc(size);
+
+	SDL_memset(object, 0, size);
+	object->id = (uint32_t) SDL_AtomicAdd(&device->lastId, 1) + 1;
+	return object;
+}
+
+static uint64_t NullDevice_Now(NullDevice *device)
+{
+	return RefreshRecordWriter_Now(device->writer);
+}
+
+/* start is when the call was entered; the call ends here, before the log
+ * is written
+ */
+static void NullDevice_Record(
+	NullDevice *device,
+	RefreshRecordKind kind,
+	uint64_t start,
+	const uint32_t *arguments,
+	uint32_t argumentCount,
+	const void *data,
+	uint32_t dataSize
+) {
+	uint64_t end = NullDevice_Now(device);
+	RefreshRecordWriter_Append(device->writer, kind, start, end - start, arguments, argumentCount, data, dataSize);
+}
+
+#define NULL_RECORD(device, kind, start, ...) \
+	NullDevice_Record( \
+		device, \
+		kind, \
+		start, \
+		(const uint32_t[]) { __VA_ARGS__ }, \
+		sizeof((const uint32_t[]) { __VA_ARGS__ }) / sizeof(uint32_t), \
+		NULL, \
+		0 \
+	)
+
+/* Device */
+
+REFRESH_Device* REFRESH_CreateDevice(REFRESH_PresentationParameters *presentationParameters, uint8_t debugMode)
+{
+	const char *path = SDL_getenv("REFRESH_RECORD_PATH");
+	RefreshRecordWriter *writer;
+	NullDevice *device;
+
+	if (path == NULL || path[0] == '\0')
+	{
+		path = REFRESH_RECORD_DEFAULT_PATH;
+	}
+
+	if ((writer = RefreshRecordWriter_Create(path)) == NULL)
+	{
+		return NULL;
+	}
+
+	device = SDL_malloc(sizeof(NullDevice));
+	SDL_zerop(device);
+	device->writer = writer;
+	device->path = SDL_strdup(path);
+
+	NullDevice_Record(device, REFRESH_RECORD_CREATE_DEVICE, NullDevice_Now(device), NULL, 0, NULL, 0);
+	SDL_Log("Null device: recording Refresh calls to %s", path);
+
+	return (REFRESH_Device*) device;
+}
+
+void REFRESH_DestroyDevice(REFRESH_Device *device)
+{
+	NullDevice *nullDevice = (NullDevice*) device;
+
+	if (nullDevice == NULL)
+	{
+		return;
+	}
+
+	NullDevice_Record(nullDevice, REFRESH_RECORD_DESTROY_DEVICE, NullDevice_Now(nullDevice), NULL, 0, NULL, 0);
+	if (!RefreshRecordWriter_Close(nullDevice->writer))
+	{
+		SDL_Log("Could not write %s", nullDevice->path);
+	}
+
+	SDL_free(nullDevice->path);
+	SDL_free(nullDevice);
+}
+
+/* Object creation */
+
+REFRESH_Buffer* REFRESH_CreateBuffer(REFRESH_Device *device, REFRESH_BufferUsageFlags usageFlags, uint32_t sizeInBytes)
+{
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+	NullBuffer *buffer = NullDevice_CreateObject(nullDevice, sizeof(NullBuffer));
+
+	buffer->size = sizeInBytes;
+	buffer->contents = SDL_calloc(SDL_max(sizeInBytes, 1), 1);
+
+	NULL_RECORD(nullDevice, REFRESH_RECORD_CREATE_BUFFER, start, buffer->object.id, usageFlags, sizeInBytes);
+	return (REFRESH_Buffer*) buffer;
+}
+
+REFRESH_Texture* REFRESH_CreateTexture2D(
+	REFRESH_Device *device,
+	REFRESH_ColorFormat format,
+	uint32_t width,
+	uint32_t height,
+	uint32_t levelCount,
+	REFRESH_TextureUsageFlags usageFlags
+) {
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+	NullObject *texture = NullDevice_CreateObject(nullDevice, sizeof(NullObject));
+
+	NULL_RECORD(nullDevice, REFRESH_RECORD_CREATE_TEXTURE_2D, start, texture->id, format, width, height, levelCount, usageFlags);
+	return (REFRESH_Texture*) texture;
+}
+
+REFRESH_Sampler* REFRESH_CreateSampler(REFRESH_Device *device, REFRESH_SamplerStateCreateInfo *samplerStateCreateInfo)
+{
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+	NullObject *sampler = NullDevice_CreateObject(nullDevice, sizeof(NullObject));
+
+	NULL_RECORD(nullDevice, REFRESH_RECORD_CREATE_SAMPLER, start, sampler->id);
+	return (REFRESH_Sampler*) sampler;
+}
+
+REFRESH_ColorTarget* REFRESH_CreateColorTarget(
+	REFRESH_Device *device,
+	REFRESH_SampleCount multisampleCount,
+	REFRESH_TextureSlice *textureSlice
+) {
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+	NullObject *colorTarget = NullDevice_CreateObject(nullDevice, sizeof(NullObject));
+
+	NULL_RECORD(nullDevice, REFRESH_RECORD_CREATE_COLOR_TARGET, start, colorTarget->id, NullDevice_GetId(textureSlice->texture));
+	return (REFRESH_ColorTarget*) colorTarget;
+}
+
+REFRESH_DepthStencilTarget* REFRESH_CreateDepthStencilTarget(
+	REFRESH_Device *device,
+	uint32_t width,
+	uint32_t height,
+	REFRESH_DepthFormat format
+) {
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+	NullObject *depthStencilTarget = NullDevice_CreateObject(nullDevice, sizeof(NullObject));
+
+	NULL_RECORD(nullDevice, REFRESH_RECORD_CREATE_DEPTH_STENCIL_TARGET, start, depthStencilTarget->id, width, height);
+	return (REFRESH_DepthStencilTarget*) depthStencilTarget;
+}
+
+REFRESH_RenderPass* REFRESH_CreateRenderPass(REFRESH_Device *device, REFRESH_RenderPassCreateInfo *renderPassCreateInfo)
+{
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+	NullObject *renderPass = NullDevice_CreateObject(nullDevice, sizeof(NullObject));
+
+	NULL_RECORD(nullDevice, REFRESH_RECORD_CREATE_RENDER_PASS, start, renderPass->id);
+	return (REFRESH_RenderPass*) renderPass;
+}
+
+REFRESH_Framebuffer* REFRESH_CreateFramebuffer(REFRESH_Device *device, REFRESH_FramebufferCreateInfo *framebufferCreateInfo)
+{
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+	NullObject *framebuffer = NullDevice_CreateObject(nullDevice, sizeof(NullObject));
+
+	NULL_RECORD(nullDevice, REFRESH_RECORD_CREATE_FRAMEBUFFER, start, framebuffer->id, NullDevice_GetId(framebufferCreateInfo->renderPass));
+	return (REFRESH_Framebuffer*) framebuffer;
+}
+
+REFRESH_ShaderModule* REFRESH_CreateShaderModule(REFRESH_Device *device, REFRESH_ShaderModuleCreateInfo *shaderModuleCreateInfo)
+{
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+	NullObject *shaderModule = NullDevice_CreateObject(nullDevice, sizeof(NullObject));
+
+	/* The bundle's hash, so a replay can name the shader */
+	uint64_t hash = ShaderBundle_Hash(shaderModuleCreateInfo->byteCode, shaderModuleCreateInfo->codeSize);
+
+	NULL_RECORD(
+		nullDevice,
+		REFRESH_RECORD_CREATE_SHADER_MODULE,
+		start,
+		shaderModule->id,
+		(uint32_t) shaderModuleCreateInfo->codeSize,
+		(uint32_t) hash,
+		(uint32_t) (hash >> 32)
+	);
+	return (REFRESH_ShaderModule*) shaderModule;
+}
+
+REFRESH_ComputePipeline* REFRESH_CreateComputePipeline(
+	REFRESH_Device *device,
+	REFRESH_ComputePipelineCreateInfo *pipelineCreateInfo
+) {
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+	NullComputePipeline *pipeline = NullDevice_CreateObject(nullDevice, sizeof(NullComputePipeline));
+
+	pipeline->bufferBindingCount = pipelineCreateInfo->pipelineLayoutCreateInfo.bufferBindingCount;
+	pipeline->uniformBufferSize = (uint32_t) pipelineCreateInfo->computeShaderState.uniformBufferSize;
+
+	NULL_RECORD(
+		nullDevice,
+		REFRESH_RECORD_CREATE_COMPUTE_PIPELINE,
+		start,
+		pipeline->object.id,
+		NullDevice_GetId(pipelineCreateInfo->computeShaderState.shaderModule),
+		pipeline->bufferBindingCount,
+		pipelineCreateInfo->pipelineLayoutCreateInfo.imageBindingCount,
+		pipeline->uniformBufferSize
+	);
+	return (REFRESH_ComputePipeline*) pipeline;
+}
+
+REFRESH_GraphicsPipeline* REFRESH_CreateGraphicsPipeline(
+	REFRESH_Device *device,
+	REFRESH_GraphicsPipelineCreateInfo *pipelineCreateInfo
+) {
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+	NullGraphicsPipeline *pipeline = NullDevice_CreateObject(nullDevice, sizeof(NullGraphicsPipeline));
+
+	pipeline->fragmentSamplerBindingCount = pipelineCreateInfo->pipelineLayoutCreateInfo.fragmentSamplerBindingCount;
+
+	NULL_RECORD(
+		nullDevice,
+		REFRESH_RECORD_CREATE_GRAPHICS_PIPELINE,
+		start,
+		pipeline->object.id,
+		NullDevice_GetId(pipelineCreateInfo->vertexShaderState.shaderModule),
+		NullDevice_GetId(pipelineCreateInfo->fragmentShaderState.shaderModule)
+	);
+	return (REFRESH_GraphicsPipeline*) pipeline;
+}
+
+/* Disposal. Nothing can still be in flight, so objects go right away. */
+
+static void NullDevice_Dispose(NullDevice *device, NullObject *object)
+{
+	uint64_t start;
+
+	if (object == NULL)
+	{
+		return;
+	}
+
+	start = NullDevice_Now(device);
+	NULL_RECORD(device, REFRESH_RECORD_DISPOSE, start, object->id);
+	SDL_free(object);
+}
+
+void REFRESH_AddDisposeBuffer(REFRESH_Device *device, REFRESH_Buffer *buffer)
+{
+	if (buffer != NULL)
+	{
+		SDL_free(((NullBuffer*) buffer)->contents);
+	}
+	NullDevice_Dispose((NullDevice*) device, (NullObject*) buffer);
+}
+
+void REFRESH_AddDisposeTexture(REFRESH_Device *device, REFRESH_Texture *texture)
+{
+	NullDevice_Dispose((NullDevice*) device, (NullObject*) texture);
+}
+
+void REFRESH_AddDisposeSampler(REFRESH_Device *device, REFRESH_Sampler *sampler)
+{
+	NullDevice_Dispose((NullDevice*) device, (NullObject*) sampler);
+}
+
+void REFRESH_AddDisposeColorTarget(REFRESH_Device *device, REFRESH_ColorTarget *colorTarget)
+{
+	NullDevice_Dispose((NullDevice*) device, (NullObject*) colorTarget);
+}
+
+void REFRESH_AddDisposeDepthStencilTarget(REFRESH_Device *device, REFRESH_DepthStencilTarget *depthStencilTarget)
+{
+	NullDevice_Dispose((NullDevice*) device, (NullObject*) depthStencilTarget);
+}
+
+void REFRESH_AddDisposeFramebuffer(REFRESH_Device *device, REFRESH_Framebuffer *frameBuffer)
+{
+	NullDevice_Dispose((NullDevice*) device, (NullObject*) frameBuffer);
+}
+
+void REFRESH_AddDisposeShaderModule(REFRESH_Device *device, REFRESH_ShaderModule *shaderModule)
+{
+	NullDevice_Dispose((NullDevice*) device, (NullObject*) shaderModule);
+}
+
+void REFRESH_AddDisposeRenderPass(REFRESH_Device *device, REFRESH_RenderPass *renderPass)
+{
+	NullDevice_Dispose((NullDevice*) device, (NullObject*) renderPass);
+}
+
+void REFRESH_AddDisposeComputePipeline(REFRESH_Device *device, REFRESH_ComputePipeline *computePipeline)
+{
+	NullDevice_Dispose((NullDevice*) device, (NullObject*) computePipeline);
+}
+
+void REFRESH_AddDisposeGraphicsPipeline(REFRESH_Device *device, REFRESH_GraphicsPipeline *graphicsPipeline)
+{
+	NullDevice_Dispose((NullDevice*) device, (NullObject*) graphicsPipeline);
+}
+
+/* Transfers */
+
+void REFRESH_SetBufferData(
+	REFRESH_Device *device,
+	REFRESH_Buffer *buffer,
+	uint32_t offsetInBytes,
+	void *data,
+	uint32_t dataLength
+) {
+	NullDevice *nullDevice = (NullDevice*) device;
+	NullBuffer *nullBuffer = (NullBuffer*) buffer;
+	uint64_t start = NullDevice_Now(nullDevice);
+	uint32_t arguments[] = { nullBuffer->object.id, offsetInBytes, dataLength };
+	bool keep = !nullBuffer->uploaded || dataLength <= REFRESH_RECORD_MAX_INLINE;
+
+	if (offsetInBytes < nullBuffer->size)
+	{
+		SDL_memcpy(nullBuffer->contents + offsetInBytes, data, SDL_min(dataLength, nullBuffer->size - offsetInBytes));
+	}
+	nullBuffer->uploaded = true;
+
+	NullDevice_Record(
+		nullDevice,
+		REFRESH_RECORD_SET_BUFFER_DATA,
+		start,
+		arguments,
+		SDL_arraysize(arguments),
+		keep ? data : NULL,
+		dataLength
+	);
+}
+
+void REFRESH_SetTextureData(
+	REFRESH_Device *device,
+	REFRESH_TextureSlice *textureSlice,
+	void *data,
+	uint32_t dataLengthInBytes
+) {
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+
+	NULL_RECORD(nullDevice, REFRESH_RECORD_SET_TEXTURE_DATA, start, NullDevice_GetId(textureSlice->texture), dataLengthInBytes);
+}
+
+void REFRESH_GetBufferData(
+	REFRESH_Device *device,
+	REFRESH_Buffer *buffer,
+	void *data,
+	uint32_t dataLengthInBytes
+) {
+	NullDevice *nullDevice = (NullDevice*) device;
+	NullBuffer *nullBuffer = (NullBuffer*) buffer;
+	uint64_t start = NullDevice_Now(nullDevice);
+
+	SDL_memcpy(data, nullBuffer->contents, SDL_min(dataLengthInBytes, nullBuffer->size));
+
+	NULL_RECORD(nullDevice, REFRESH_RECORD_GET_BUFFER_DATA, start, nullBuffer->object.id, dataLengthInBytes);
+}
+
+/* Command buffers */
+
+REFRESH_CommandBuffer* REFRESH_AcquireCommandBuffer(REFRESH_Device *device, uint8_t fixed)
+{
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+	NullCommandBuffer *commandBuffer = NullDevice_CreateObject(nullDevice, sizeof(NullCommandBuffer));
+
+	NULL_RECORD(nullDevice, REFRESH_RECORD_ACQUIRE_COMMAND_BUFFER, start, commandBuffer->object.id);
+	return (REFRESH_CommandBuffer*) commandBuffer;
+}
+
+void REFRESH_BindComputePipeline(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	REFRESH_ComputePipeline *computePipeline
+) {
+	NullDevice *nullDevice = (NullDevice*) device;
+	NullCommandBuffer *nullCommandBuffer = (NullCommandBuffer*) commandBuffer;
+	uint64_t start = NullDevice_Now(nullDevice);
+
+	nullCommandBuffer->computePipeline = (NullComputePipeline*) computePipeline;
+
+	NULL_RECORD(nullDevice, REFRESH_RECORD_BIND_COMPUTE_PIPELINE, start, nullCommandBuffer->object.id, NullDevice_GetId(computePipeline));
+}
+
+void REFRESH_BindComputeBuffers(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	REFRESH_Buffer **pBuffers
+) {
+	NullDevice *nullDevice = (NullDevice*) device;
+	NullCommandBuffer *nullCommandBuffer = (NullCommandBuffer*) commandBuffer;
+	uint64_t start = NullDevice_Now(nullDevice);
+	uint32_t arguments[REFRESH_RECORD_MAX_ARGUMENTS];
+	uint32_t count = 0;
+	uint32_t i;
+
+	/* The bound pipeline says how many there are */
+	if (nullCommandBuffer->computePipeline != NULL)
+	{
+		count = SDL_min(nullCommandBuffer->computePipeline->bufferBindingCount, REFRESH_RECORD_MAX_ARGUMENTS - 1);
+	}
+
+	arguments[0] = nullCommandBuffer->object.id;
+	for (i = 0; i < count; i += 1)
+	{
+		arguments[1 + i] = NullDevice_GetId(pBuffers[i]);
+	}
+
+	NullDevice_Record(nullDevice, REFRESH_RECORD_BIND_COMPUTE_BUFFERS, start, arguments, 1 + count, NULL, 0);
+}
+
+uint32_t REFRESH_PushComputeShaderParams(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	void *data,
+	uint32_t elementCount
+) {
+	NullDevice *nullDevice = (NullDevice*) device;
+	NullCommandBuffer *nullCommandBuffer = (NullCommandBuffer*) commandBuffer;
+	uint64_t start = NullDevice_Now(nullDevice);
+	uint32_t size = 0;
+	uint32_t offset = nullCommandBuffer->paramOffset;
+	uint32_t arguments[3];
+
+	if (nullCommandBuffer->computePipeline != NULL)
+	{
+		size = elementCount * nullCommandBuffer->computePipeline->uniformBufferSize;
+	}
+	nullCommandBuffer->paramOffset += size;
+
+	arguments[0] = nullCommandBuffer->object.id;
+	arguments[1] = elementCount;
+	arguments[2] = offset;
+	NullDevice_Record(nullDevice, REFRESH_RECORD_PUSH_COMPUTE_SHADER_PARAMS, start, arguments, SDL_arraysize(arguments), data, size);
+
+	return offset;
+}
+
+void REFRESH_DispatchCompute(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	uint32_t groupCountX,
+	uint32_t groupCountY,
+	uint32_t groupCountZ,
+	uint32_t computeParamOffset
+) {
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+
+	NULL_RECORD(
+		nullDevice,
+		REFRESH_RECORD_DISPATCH_COMPUTE,
+		start,
+		NullDevice_GetId(commandBuffer),
+		groupCountX,
+		groupCountY,
+		groupCountZ,
+		computeParamOffset
+	);
+}
+
+void REFRESH_CopyTextureToBuffer(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	REFRESH_TextureSlice *textureSlice,
+	REFRESH_Buffer *buffer
+) {
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+
+	/* Every texture the program reads back is R8G8B8A8 */
+	NULL_RECORD(
+		nullDevice,
+		REFRESH_RECORD_COPY_TEXTURE_TO_BUFFER,
+		start,
+		NullDevice_GetId(commandBuffer),
+		NullDevice_GetId(textureSlice->texture),
+		NullDevice_GetId(buffer),
+		(uint32_t) (textureSlice->rectangle.w * textureSlice->rectangle.h * 4)
+	);
+}
+
+void REFRESH_BeginRenderPass(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	REFRESH_RenderPass *renderPass,
+	REFRESH_Framebuffer *framebuffer,
+	REFRESH_Rect renderArea,
+	REFRESH_Color *pColorClearValues,
+	uint32_t colorClearCount,
+	REFRESH_DepthStencilValue *depthStencilClearValue
+) {
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+
+	NULL_RECORD(
+		nullDevice,
+		REFRESH_RECORD_BEGIN_RENDER_PASS,
+		start,
+		NullDevice_GetId(commandBuffer),
+		NullDevice_GetId(renderPass),
+		NullDevice_GetId(framebuffer)
+	);
+}
+
+void REFRESH_EndRenderPass(REFRESH_Device *device, REFRESH_CommandBuffer *commandBuffer)
+{
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+
+	NULL_RECORD(nullDevice, REFRESH_RECORD_END_RENDER_PASS, start, NullDevice_GetId(commandBuffer));
+}
+
+void REFRESH_BindGraphicsPipeline(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	REFRESH_GraphicsPipeline *graphicsPipeline
+) {
+	NullDevice *nullDevice = (NullDevice*) device;
+	NullCommandBuffer *nullCommandBuffer = (NullCommandBuffer*) commandBuffer;
+	uint64_t start = NullDevice_Now(nullDevice);
+
+	nullCommandBuffer->graphicsPipeline = (NullGraphicsPipeline*) graphicsPipeline;
+
+	NULL_RECORD(nullDevice, REFRESH_RECORD_BIND_GRAPHICS_PIPELINE, start, nullCommandBuffer->object.id, NullDevice_GetId(graphicsPipeline));
+}
+
+void REFRESH_BindVertexBuffers(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	uint32_t firstBinding,
+	uint32_t bindingCount,
+	REFRESH_Buffer **pBuffers,
+	uint64_t *pOffsets
+) {
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+	uint32_t arguments[REFRESH_RECORD_MAX_ARGUMENTS];
+	uint32_t count = SDL_min(bindingCount, REFRESH_RECORD_MAX_ARGUMENTS - 2);
+	uint32_t i;
+
+	arguments[0] = NullDevice_GetId(commandBuffer);
+	arguments[1] = firstBinding;
+	for (i = 0; i < count; i += 1)
+	{
+		arguments[2 + i] = NullDevice_GetId(pBuffers[i]);
+	}
+
+	NullDevice_Record(nullDevice, REFRESH_RECORD_BIND_VERTEX_BUFFERS, start, arguments, 2 + count, NULL, 0);
+}
+
+void REFRESH_SetFragmentSamplers(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	REFRESH_Texture **pTextures,
+	REFRESH_Sampler **pSamplers
+) {
+	NullDevice *nullDevice = (NullDevice*) device;
+	NullCommandBuffer *nullCommandBuffer = (NullCommandBuffer*) commandBuffer;
+	uint64_t start = NullDevice_Now(nullDevice);
+	uint32_t arguments[REFRESH_RECORD_MAX_ARGUMENTS];
+	uint32_t count = 0;
+	uint32_t i;
+
+	if (nullCommandBuffer->graphicsPipeline != NULL)
+	{
+		count = SDL_min(nullCommandBuffer->graphicsPipeline->fragmentSamplerBindingCount, REFRESH_RECORD_MAX_ARGUMENTS - 1);
+	}
+
+	arguments[0] = nullCommandBuffer->object.id;
+	for (i = 0; i < count; i += 1)
+	{
+		arguments[1 + i] = NullDevice_GetId(pTextures[i]);
+	}
+
+	NullDevice_Record(nullDevice, REFRESH_RECORD_SET_FRAGMENT_SAMPLERS, start, arguments, 1 + count, NULL, 0);
+}
+
+void REFRESH_DrawPrimitives(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	uint32_t vertexStart,
+	uint32_t primitiveCount,
+	uint32_t vertexParamOffset,
+	uint32_t fragmentParamOffset
+) {
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+
+	NULL_RECORD(nullDevice, REFRESH_RECORD_DRAW_PRIMITIVES, start, NullDevice_GetId(commandBuffer), vertexStart, primitiveCount);
+}
+
+void REFRESH_QueuePresent(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	REFRESH_TextureSlice *textureSlice,
+	REFRESH_Rect *destinationRectangle,
+	REFRESH_Filter filter
+) {
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+
+	NULL_RECORD(nullDevice, REFRESH_RECORD_QUEUE_PRESENT, start, NullDevice_GetId(commandBuffer), NullDevice_GetId(textureSlice->texture));
+}
+
+void REFRESH_Submit(REFRESH_Device *device, uint32_t commandBufferCount, REFRESH_CommandBuffer **pCommandBuffers)
+{
+	NullDevice *nullDevice = (NullDevice*) device;
+	uint64_t start = NullDevice_Now(nullDevice);
+	uint32_t arguments[REFRESH_RECORD_MAX_ARGUMENTS];
+	uint32_t count = SDL_min(commandBufferCount, REFRESH_RECORD_MAX_ARGUMENTS);
+	uint32_t i;
+
+	for (i = 0; i < count; i += 1)
+	{
+		arguments[i] = NullDevice_GetId(pCommandBuffers[i]);
+	}
+
+	NullDevice_Record(nullDevice, REFRESH_RECORD_SUBMIT, start, arguments, count, NULL, 0);
+
+	/* Executed instantly, so the command buffers are done with */
+	for (i = 0; i < commandBufferCount; i += 1)
+	{
+		SDL_free(pCommandBuffers[i]);
+	}
+}
+
+void REFRESH_Wait(REFRESH_Device *device)
+{
+	NullDevice *nullDevice = (NullDevice*) device;
+
+	NullDevice_Record(nullDevice, REFRESH_RECORD_WAIT, NullDevice_Now(nullDevice), NULL, 0, NULL, 0);
+}
@@ -0,0 +1,278 @@
+#include "refresh_record.h"
+
+#include <SDL.h>
+
+#include "file_map.h"
+
+/* Calls are gathered here and written in blocks; larger data goes to the
+ * file directly
+ */
+#define REFRESH_RECORD_BUFFER_SIZE (1024 * 1024)
+
+#define REFRESH_RECORD_ALIGNMENT 8
+
+static const char* kindNames[REFRESH_RECORD_KIND_COUNT] =
+{
+	"CreateDevice",
+	"DestroyDevice",
+	"CreateBuffer",
+	"CreateTexture2D",
+	"CreateSampler",
+	"CreateColorTarget",
+	"CreateDepthStencilTarget",
+	"CreateRenderPass",
+	"CreateFramebuffer",
+	"CreateShaderModule",
+	"CreateComputePipeline",
+	"CreateGraphicsPipeline",
+	"AddDispose",
+	"SetBufferData",
+	"SetTextureData",
+	"GetBufferData",
+	"AcquireCommandBuffer",
+	"BindComputePipeline",
+	"BindComputeBuffers",
+	"PushComputeShaderParams",
+	"DispatchCompute",
+	"CopyTextureToBuffer",
+	"BeginRenderPass",
+	"EndRenderPass",
+	"BindGraphicsPipeline",
+	"BindVertexBuffers",
+	"SetFragmentSamplers",
+	"DrawPrimitives",
+	"QueuePresent",
+	"Submit",
+	"Wait"
+};
+
+const char* RefreshRecord_GetKindName(RefreshRecordKind kind)
+{
+	return (kind < REFRESH_RECORD_KIND_COUNT) ? kindNames[kind] : "unknown";
+}
+
+static uint64_t RefreshRecord_Padding(uint64_t size)
+{
+	return (REFRESH_RECORD_ALIGNMENT - size % REFRESH_RECORD_ALIGNMENT) % REFRESH_RECORD_ALIGNMENT;
+}
+
+/* Writing */
+
+struct RefreshRecordWriter
+{
+	SDL_RWops *file;
+	SDL_mutex *lock;
+	uint64_t startTime;
+	uint64_t frequency;
+
+	uint8_t *buffer;
+	uint32_t bufferUsed;
+	bool failed;
+};
+
+static void RefreshRecordWriter_Flush(RefreshRecordWriter *writer)
+{
+	if (writer->bufferUsed > 0 && SDL_RWwrite(writer->file, writer->buffer, 1, writer->bufferUsed) != writer->bufferUsed)
+	{
+		writer->failed = true;
+	}
+	writer->bufferUsed = 0;
+}
+
+static void RefreshRecordWriter_Write(RefreshRecordWriter *writer, const void *data, uint64_t size)
+{
+	if (size == 0)
+	{
+		return;
+	}
+
+	if (writer->bufferUsed + size > REFRESH_RECORD_BUFFER_SIZE)
+	{
+		RefreshRecordWriter_Flush(writer);
+
+		if (size > REFRESH_RECORD_BUFFER_SIZE)
+		{
+			if (SDL_RWwrite(writer->file, data, 1, size) != size)
+			{
+				writer->failed = true;
+			}
+			return;
+		}
+	}
+
+	SDL_memcpy(writer->buffer + writer->bufferUsed, data, size);
+	writer->bufferUsed += (uint32_t) size;
+}
+
+RefreshRecordWriter* RefreshRecordWriter_Create(const char *path)
+{
+	RefreshRecordWriter *writer;
+	RefreshRecordHeader header;
+	SDL_RWops *file = SDL_RWFromFile(path, "wb");
+
+	if (file == NULL)
+	{
+		SDL_Log("Could not open %s for writing", path);
+		return NULL;
+	}
+
+	writer = SDL_malloc(sizeof(RefreshRecordWriter));
+	SDL_zerop(writer);
+
+	writer->file = file;
+	writer->lock = SDL_CreateMutex();
+	writer->startTime = SDL_GetPerformanceCounter();
+	writer->frequency = SDL_GetPerformanceFrequency();
+	writer->buffer = SDL_malloc(REFRESH_RECORD_BUFFER_SIZE);
+
+	SDL_zero(header);
+	header.magic = REFRESH_RECORD_MAGIC;
+	header.version = REFRESH_RECORD_VERSION;
+	RefreshRecordWriter_Write(writer, &header, sizeof(RefreshRecordHeader));
+
+	return writer;
+}
+
+bool RefreshRecordWriter_Close(RefreshRecordWriter *writer)
+{
+	bool written;
+
+	if (writer == NULL)
+	{
+		return true;
+	}
+
+	RefreshRecordWriter_Flush(writer);
+	written = (SDL_RWclose(writer->file) == 0) && !writer->failed;
+
+	SDL_DestroyMutex(writer->lock);
+	SDL_free(writer->buffer);
+	SDL_free(writer);
+	return written;
+}
+
+uint64_t RefreshRecordWriter_Now(RefreshRecordWriter *writer)
+{
+	uint64_t ticks = SDL_GetPerformanceCounter() - writer->startTime;
+
+	/* Split so the multiply cannot overflow */
+	return (ticks / writer->frequency) * 1000000000ull +
+		(ticks % writer->frequency) * 1000000000ull / writer->frequency;
+}
+
+void RefreshRecordWriter_Append(
+	RefreshRecordWriter *writer,
+	RefreshRecordKind kind,
+	uint64_t time,
+	uint64_t duration,
+	const uint32_t *arguments,
+	uint32_t argumentCount,
+	const void *data,
+	uint32_t dataSize
+) {
+	static const uint8_t padding[REFRESH_RECORD_ALIGNMENT] = { 0 };
+	RefreshRecordCall call;
+
+	call.kind = (uint16_t) kind;
+	call.argumentCount = (uint16_t) argumentCount;
+	call.dataSize = (data != NULL) ? dataSize : 0;
+	call.time = time;
+	call.duration = (uint32_t) SDL_min(duration, UINT32_MAX);
+	call.reserved = 0;
+
+	SDL_LockMutex(writer->lock);
+	RefreshRecordWriter_Write(writer, &call, sizeof(RefreshRecordCall));
+	RefreshRecordWriter_Write(writer, arguments, sizeof(uint32_t) * argumentCount);
+	if (call.dataSize > 0)
+	{
+		RefreshRecordWriter_Write(writer, data, call.dataSize);
+	}
+	RefreshRecordWriter_Write(
+		writer,
+		padding,
+		RefreshRecord_Padding(sizeof(uint32_t) * argumentCount + call.dataSize)
+	);
+	SDL_UnlockMutex(writer->lock);
+}
+
+/* Reading */
+
+struct RefreshRecordReader
+{
+	FileMap map;
+	uint64_t offset; /* of the next call */
+};
+
+RefreshRecordReader* RefreshRecordReader_Open(const char *path)
+{
+	RefreshRecordReader *reader = SDL_malloc(sizeof(RefreshRecordReader));
+	const RefreshRecordHeader *header;
+
+	SDL_zerop(reader);
+
+	if (!FileMap_Open(&reader->map, path))
+	{
+		SDL_Log("Could not open %s", path);
+		SDL_free(reader);
+		return NULL;
+	}
+
+	header = (const RefreshRecordHeader*) reader->map.data;
+	if (reader->map.size < sizeof(RefreshRecordHeader) ||
+		header->magic != REFRESH_RECORD_MAGIC ||
+		header->version != REFRESH_RECORD_VERSION)
+	{
+		SDL_Log("%s is not a version %d Refresh call log", path, REFRESH_RECORD_VERSION);
+		RefreshRecordReader_Close(reader);
+		return NULL;
+	}
+
+	reader->offset = sizeof(RefreshRecordHeader);
+	return reader;
+}
+
+void RefreshRecordReader_Close(RefreshRecordReader *reader)
+{
+	if (reader == NULL)
+	{
+		return;
+	}
+
+	FileMap_Close(&reader->map);
+	SDL_free(reader);
+}
+
+bool RefreshRecordReader_Next(RefreshRecordReader *reader, RefreshRecordEntry *entry)
+{
+	const RefreshRecordCall *call;
+	uint64_t bodySize;
+
+	if (reader->offset + sizeof(RefreshRecordCall) > reader->map.size)
+	{
+		return false;
+	}
+
+	call = (const RefreshRecordCall*) (reader->map.data + reader->offset);
+	bodySize = sizeof(uint32_t) * call->argumentCount + call->dataSize;
+	if (reader->offset + sizeof(RefreshRecordCall) + bodySize > reader->map.size)
+	{
+		return false;
+	}
+
+	entry->call = call;
+	entry->arguments = (const uint32_t*) (call + 1);
+	entry->data = (call->dataSize > 0) ? (const void*) (entry->arguments + call->argumentCount) : NULL;
+
+	reader->offset += sizeof(RefreshRecordCall) + bodySize + RefreshRecord_Padding(bodySize);
+	return true;
+}
+
+void RefreshRecordReader_Rewind(RefreshRecordReader *reader)
+{
+	reader->offset = sizeof(RefreshRecordHeader);
+}
+
+uint64_t RefreshRecordReader_GetSize(RefreshRecordReader *reader)
+{
+	return reader->map.size;
+}
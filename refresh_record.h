@@ -0,0 +1,150 @@
+#ifndef REFRESH_RECORD_H
+#define REFRESH_RECORD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Logs of the Refresh command stream, for looking at command-level costs
+ * on machines without a GPU.
+ *
+ * The RefreshComputeNull build links refresh_null.c, a null device that
+ * implements every REFRESH_ device call the program makes: objects are
+ * handles, buffers are host memory and nothing is executed or drawn. Each
+ * call is appended to a log instead, with its arguments, when it was made
+ * and how long the device spent in it. RefreshReplay (refresh_replay.c)
+ * reports a log per frame and can step its particle updates on the CPU
+ * backend.
+ *
+ * The log is written to the file named by the REFRESH_RECORD_PATH
+ * environment variable, REFRESH_RECORD_DEFAULT_PATH if it is unset.
+ * Uploaded contents are kept for the first upload to each buffer and for
+ * any upload of at most REFRESH_RECORD_MAX_INLINE bytes; re-uploads larger
+ * than that, such as the CPU backend's particles every frame, only record
+ * their size. Pushed uniforms are always kept.
+ *
+ * As nothing runs, downloads return whatever was last uploaded, so
+ * validation, checksums and checkpoints of a null session mean nothing.
+ *
+ * Layout: a RefreshRecordHeader, then one RefreshRecordCall per call,
+ * followed by its argumentCount uint32_t arguments and dataSize bytes of
+ * data, zero padded to a multiple of 8 bytes. Objects are numbered from 1
+ * in creation order, 0 being NULL. All fields are little endian.
+ */
+
+#define REFRESH_RECORD_MAGIC 0x4C435252 /* "RRCL" */
+#define REFRESH_RECORD_VERSION 1
+
+#define REFRESH_RECORD_DEFAULT_PATH "refresh.rec"
+#define REFRESH_RECORD_MAX_INLINE 65536
+#define REFRESH_RECORD_MAX_ARGUMENTS 16
+
+/* The arguments of each call, in order. The data is the uploaded contents
+ * for SET_BUFFER_DATA and the uniforms for PUSH_COMPUTE_SHADER_PARAMS.
+ */
+typedef enum RefreshRecordKind
+{
+	REFRESH_RECORD_CREATE_DEVICE,           /* - */
+	REFRESH_RECORD_DESTROY_DEVICE,          /* - */
+	REFRESH_RECORD_CREATE_BUFFER,           /* buffer, usage, size */
+	REFRESH_RECORD_CREATE_TEXTURE_2D,       /* texture, format, width, height, levelCount, usage */
+	REFRESH_RECORD_CREATE_SAMPLER,          /* sampler */
+	REFRESH_RECORD_CREATE_COLOR_TARGET,     /* colorTarget, texture */
+	REFRESH_RECORD_CREATE_DEPTH_STENCIL_TARGET, /* depthStencilTarget, width, height */
+	REFRESH_RECORD_CREATE_RENDER_PASS,      /* renderPass */
+	REFRESH_RECORD_CREATE_FRAMEBUFFER,      /* framebuffer, renderPass */
+	REFRESH_RECORD_CREATE_SHADER_MODULE,    /* shaderModule, size, hash low, hash high (ShaderBundle_Hash) */
+	REFRESH_RECORD_CREATE_COMPUTE_PIPELINE, /* pipeline, shaderModule, bufferBindingCount, imageBindingCount, uniformBufferSize */
+	REFRESH_RECORD_CREATE_GRAPHICS_PIPELINE, /* pipeline, vertex shaderModule, fragment shaderModule */
+	REFRESH_RECORD_DISPOSE,                 /* object */
+	REFRESH_RECORD_SET_BUFFER_DATA,         /* buffer, offset, length */
+	REFRESH_RECORD_SET_TEXTURE_DATA,        /* texture, length */
+	REFRESH_RECORD_GET_BUFFER_DATA,         /* buffer, length */
+	REFRESH_RECORD_ACQUIRE_COMMAND_BUFFER,  /* commandBuffer */
+	REFRESH_RECORD_BIND_COMPUTE_PIPELINE,   /* commandBuffer, pipeline */
+	REFRESH_RECORD_BIND_COMPUTE_BUFFERS,    /* commandBuffer, buffer... */
+	REFRESH_RECORD_PUSH_COMPUTE_SHADER_PARAMS, /* commandBuffer, elementCount, offset */
+	REFRESH_RECORD_DISPATCH_COMPUTE,        /* commandBuffer, groupCountX, groupCountY, groupCountZ, paramOffset */
+	REFRESH_RECORD_COPY_TEXTURE_TO_BUFFER,  /* commandBuffer, texture, buffer, length */
+	REFRESH_RECORD_BEGIN_RENDER_PASS,       /* commandBuffer, renderPass, framebuffer */
+	REFRESH_RECORD_END_RENDER_PASS,         /* commandBuffer */
+	REFRESH_RECORD_BIND_GRAPHICS_PIPELINE,  /* commandBuffer, pipeline */
+	REFRESH_RECORD_BIND_VERTEX_BUFFERS,     /* commandBuffer, firstBinding, buffer... */
+	REFRESH_RECORD_SET_FRAGMENT_SAMPLERS,   /* commandBuffer, texture... */
+	REFRESH_RECORD_DRAW_PRIMITIVES,         /* commandBuffer, vertexStart, primitiveCount */
+	REFRESH_RECORD_QUEUE_PRESENT,           /* commandBuffer, texture */
+	REFRESH_RECORD_SUBMIT,                  /* commandBuffer... */
+	REFRESH_RECORD_WAIT,                    /* - */
+	REFRESH_RECORD_KIND_COUNT
+} RefreshRecordKind;
+
+typedef struct RefreshRecordHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t reserved[2];
+} RefreshRecordHeader;
+
+typedef struct RefreshRecordCall
+{
+	uint16_t kind;          /* RefreshRecordKind */
+	uint16_t argumentCount;
+	uint32_t dataSize;      /* in bytes, before padding */
+	uint64_t time;          /* ns since the device was created, when the call was made */
+	uint32_t duration;      /* ns spent in the call, writing the log excluded */
+	uint32_t reserved;
+} RefreshRecordCall;
+
+const char* RefreshRecord_GetKindName(RefreshRecordKind kind);
+
+/* Writing, done by the null device. Appending is thread safe. */
+
+typedef struct RefreshRecordWriter RefreshRecordWriter;
+
+/* Logs and returns NULL if the file cannot be created */
+RefreshRecordWriter* RefreshRecordWriter_Create(const char *path);
+
+/* Flushes and closes the file. Returns false if any write failed. */
+bool RefreshRecordWriter_Close(RefreshRecordWriter *writer);
+
+/* ns since the writer was created */
+uint64_t RefreshRecordWriter_Now(RefreshRecordWriter *writer);
+
+void RefreshRecordWriter_Append(
+	RefreshRecordWriter *writer,
+	RefreshRecordKind kind,
+	uint64_t time,
+	uint64_t duration,
+	const uint32_t *arguments,
+	uint32_t argumentCount,
+	const void *data,
+	uint32_t dataSize
+);
+
+/* Reading */
+
+typedef struct RefreshRecordEntry
+{
+	const RefreshRecordCall *call;
+	const uint32_t *arguments;
+	const void *data; /* NULL without data */
+} RefreshRecordEntry;
+
+typedef struct RefreshRecordReader RefreshRecordReader;
+
+/* Maps the file. Logs and returns NULL if it is not a version
+ * REFRESH_RECORD_VERSION log.
+ */
+RefreshRecordReader* RefreshRecordReader_Open(const char *path);
+void RefreshRecordReader_Close(RefreshRecordReader *reader);
+
+/* Reads the next call. Returns false at the end of the log, including a
+ * call the writer did not get to finish.
+ */
+bool RefreshRecordReader_Next(RefreshRecordReader *reader, RefreshRecordEntry *entry);
+
+/* Back to the first call */
+void RefreshRecordReader_Rewind(RefreshRecordReader *reader);
+
+uint64_t RefreshRecordReader_GetSize(RefreshRecordReader *reader);
+
+#endif /* REFRESH_RECORD_H */
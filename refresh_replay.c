@@ -0,0 +1,1057 @@
+/* Reports Refresh call logs written by the recording null device
+ * (refresh_record.h), and replays their particle updates on the CPU.
+ *
+ * Usage: RefreshReplay <log> [--bundle PATH] [--csv PATH] [--cpu] [--threads N]
+ *
+ * A frame is every call up to and including a Submit. For each one the
+ * report counts bytes uploaded and downloaded, dispatches and draws, and
+ * what the calls cost: how many there were, the time the device spent in
+ * them and the host time from the frame's first call to its submit. Calls
+ * are also broken down by kind, and dispatches by shader, named through
+ * the shader bundle (shaders.bundle by default). With --csv every frame is
+ * written to PATH as a row.
+ *
+ * With --cpu the dispatches of the particle update are stepped on the CPU
+ * backend, from the state the session uploaded or initialized on the
+ * device and with the uniforms it pushed, and the checksum of the final
+ * state is printed as the benchmark report does. Of a session with several
+ * particle systems, such as the dispatch tuner's scratch one, the system
+ * updated most often is replayed. Only the update shader is stepped: the
+ * field, mesh, neighbor, pool and reorder passes are counted but not run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "bench.h"
+#include "cpu_sim.h"
+#include "particle_buffers.h"
+#include "refresh_record.h"
+#include "shader_bundle.h"
+#include "thread_pool.h"
+
+#define REPLAY_MAX_BINDINGS REFRESH_RECORD_MAX_ARGUMENTS
+
+/* Object ids are handed out in creation order. Anything this high is not a
+ * log the null device wrote, and would only grow the table.
+ */
+#define REPLAY_MAX_OBJECTS (1u << 24)
+
+/* Shaders other than the update that write particle state */
+static const char* particlePassPrefixes[] =
+{
+	"ff_",
+	"mesh_kick",
+	"mesh_split_kick",
+	"neighbor_separate",
+	"neighbor_split_separate",
+	"pool_",
+	"reorder_gather"
+};
+
+typedef struct ReplayPush
+{
+	uint32_t offset;
+	uint32_t size;
+	const void *data;
+} ReplayPush;
+
+typedef struct ReplayCommandBuffer
+{
+	uint32_t computePipeline;
+	uint32_t buffers[REPLAY_MAX_BINDINGS];
+	uint32_t bufferCount;
+
+	ReplayPush *pushes;
+	uint32_t pushCount;
+	uint32_t pushCapacity;
+
+	uint32_t dispatchCount;
+	uint32_t drawCount;
+} ReplayCommandBuffer;
+
+typedef struct ReplayObject
+{
+	RefreshRecordKind kind; /* of the call that created it */
+	uint32_t size;          /* buffers */
+	uint32_t shaderModule;  /* compute pipelines */
+	const char *name;       /* shader modules, NULL if not in the bundle */
+	ReplayCommandBuffer *commandBuffer;
+
+	uint32_t dispatchCount;   /* shader modules */
+	uint64_t groupCount;
+	uint32_t updateCount;     /* buffers, as the first binding of the update */
+} ReplayObject;
+
+typedef struct ReplayFrame
+{
+	uint64_t submitTime;
+	uint64_t hostTime;
+	uint64_t callTime;
+	uint32_t callCount;
+	uint32_t dispatchCount;
+	uint32_t drawCount;
+	uint64_t uploadBytes;
+	uint64_t downloadBytes;
+} ReplayFrame;
+
+/* The particle system --cpu steps */
+typedef struct ReplaySystem
+{
+	uint32_t streams[MAX_PARTICLE_BUFFERS];
+	uint32_t streamCount;
+	ParticleLayout layout;
+	bool substep;
+
+	uint8_t *contents[MAX_PARTICLE_BUFFERS];
+	bool uploaded;
+	bool initialized;
+	uint64_t initKey;
+	bool dirty; /* written since the CPU last took the state */
+	uint32_t missedUploads;
+
+	CPUSim *sim;
+	Particle *particles;
+	uint32_t particleCount;
+	uint32_t dispatchCount;
+	uint32_t stepCount;
+	uint32_t skippedDispatchCount;
+	double seconds;
+} ReplaySystem;
+
+typedef struct Replay
+{
+	RefreshRecordReader *reader;
+	ShaderBundle *bundle;
+
+	ReplayObject *objects; /* by id */
+	uint32_t objectCapacity;
+	uint32_t badObjectId; /* the first one out of range, 0 if none */
+
+	ReplayFrame *frames;
+	uint32_t frameCount;
+	uint32_t frameCapacity;
+	ReplayFrame current;
+	bool frameStarted;
+	uint64_t frameStart;
+
+	uint32_t callCount;
+	uint64_t lastTime;
+	uint32_t kindCounts[REFRESH_RECORD_KIND_COUNT];
+	uint64_t kindTimes[REFRESH_RECORD_KIND_COUNT];
+
+	ThreadPool *pool;
+	ReplaySystem *system; /* NULL unless stepping on the CPU */
+} Replay;
+
+static void Replay_Usage(const char *program)
+{
+	fprintf(stderr, "Usage: %s <log> [--bundle PATH] [--csv PATH] [--cpu] [--threads N]\n", program);
+}
+
+static uint32_t Replay_Argument(const RefreshRecordEntry *entry, uint32_t index)
+{
+	return (index < entry->call->argumentCount) ? entry->arguments[index] : 0;
+}
+
+static ReplayObject* Replay_GetObject(Replay *replay, uint32_t id)
+{
+	uint32_t capacity;
+
+	if (id == 0)
+	{
+		return NULL;
+	}
+
+	if (id >= REPLAY_MAX_OBJECTS)
+	{
+		if (replay->badObjectId == 0)
+		{
+			replay->badObjectId = id;
+		}
+		return NULL;
+	}
+
+	if (id >= replay->objectCapacity)
+	{
+		capacity = SDL_max(replay->objectCapacity * 2, id + 1);
+		replay->objects = SDL_realloc(replay->objects, sizeof(ReplayObject) * capacity);
+		SDL_memset(replay->objects + replay->objectCapacity, 0, sizeof(ReplayObject) * (capacity - replay->objectCapacity));
+		replay->objectCapacity = capacity;
+	}
+
+	return &replay->objects[id];
+}
+
+static ReplayCommandBuffer* Replay_GetCommandBuffer(Replay *replay, uint32_t id)
+{
+	ReplayObject *object = Replay_GetObject(replay, id);
+
+	return (object != NULL) ? object->commandBuffer : NULL;
+}
+
+/* The shader module behind the pipeline a command buffer has bound */
+static ReplayObject* Replay_GetBoundShader(Replay *replay, ReplayCommandBuffer *commandBuffer)
+{
+	ReplayObject *pipeline = Replay_GetObject(replay, commandBuffer->computePipeline);
+
+	return (pipeline != NULL) ? Replay_GetObject(replay, pipeline->shaderModule) : NULL;
+}
+
+static const ReplayPush* Replay_FindPush(ReplayCommandBuffer *commandBuffer, uint32_t offset)
+{
+	uint32_t i;
+
+	for (i = commandBuffer->pushCount; i > 0; i -= 1)
+	{
+		if (commandBuffer->pushes[i - 1].offset == offset)
+		{
+			return &commandBuffer->pushes[i - 1];
+		}
+	}
+
+	return NULL;
+}
+
+/* Shader names */
+
+/* base itself, or one of its workgroup shape variants (dispatch_tuner.h) */
+static bool Replay_IsVariantOf(const char *name, const char *base)
+{
+	const char *extension = SDL_strstr(base, ".comp.spv");
+	size_t stemLength = (extension != NULL) ? (size_t) (extension - base) : SDL_strlen(base);
+
+	return SDL_strcmp(name, base) == 0 ||
+		(SDL_strncmp(name, base, stemLength) == 0 && SDL_strncmp(name + stemLength, "_wg", 3) == 0);
+}
+
+static bool Replay_IsUpdateShader(const char *name, ParticleLayout *layout, bool *substep)
+{
+	ParticleLayout candidate;
+
+	if (name == NULL)
+	{
+		return false;
+	}
+
+	for (candidate = PARTICLE_LAYOUT_INTERLEAVED; candidate <= PARTICLE_LAYOUT_QUANTIZED; candidate += 1)
+	{
+		if (Replay_IsVariantOf(name, ParticleLayout_GetComputeShaderPath(candidate)) ||
+			Replay_IsVariantOf(name, ParticleLayout_GetSubstepShaderPath(candidate)))
+		{
+			*layout = candidate;
+			*substep = Replay_IsVariantOf(name, ParticleLayout_GetSubstepShaderPath(candidate));
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool Replay_IsInitShader(const char *name)
+{
+	ParticleLayout candidate;
+
+	for (candidate = PARTICLE_LAYOUT_INTERLEAVED; name != NULL && candidate <= PARTICLE_LAYOUT_QUANTIZED; candidate += 1)
+	{
+		if (SDL_strcmp(name, ParticleLayout_GetInitShaderPath(candidate)) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool Replay_IsParticlePass(const char *name)
+{
+	uint32_t i;
+
+	for (i = 0; name != NULL && i < SDL_arraysize(particlePassPrefixes); i += 1)
+	{
+		if (SDL_strncmp(name, particlePassPrefixes[i], SDL_strlen(particlePassPrefixes[i])) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* CPU stepping */
+
+static int32_t Replay_FindStream(ReplaySystem *system, uint32_t buffer)
+{
+	uint32_t i;
+
+	for (i = 0; i < system->streamCount; i += 1)
+	{
+		if (system->streams[i] == buffer)
+		{
+			return (int32_t) i;
+		}
+	}
+
+	return -1;
+}
+
+static void Replay_SystemUpload(Replay *replay, const RefreshRecordEntry *entry)
+{
+	ReplaySystem *system = replay->system;
+	ReplayObject *buffer = Replay_GetObject(replay, Replay_Argument(entry, 0));
+	int32_t stream = Replay_FindStream(system, Replay_Argument(entry, 0));
+	uint32_t offset = Replay_Argument(entry, 1);
+
+	if (stream < 0 || buffer == NULL)
+	{
+		return;
+	}
+
+	if (entry->data == NULL)
+	{
+		system->missedUploads += 1;
+		return;
+	}
+
+	if (system->contents[stream] == NULL)
+	{
+		system->contents[stream] = SDL_calloc(SDL_max(buffer->size, 1), 1);
+	}
+	if (offset < buffer->size)
+	{
+		SDL_memcpy(system->contents[stream] + offset, entry->data, SDL_min(entry->call->dataSize, buffer->size - offset));
+	}
+
+	system->uploaded = true;
+	system->initialized = false;
+	system->dirty = true;
+}
+
+/* Hands the state the device would hold to the CPU simulation */
+static void Replay_SystemTakeState(Replay *replay, uint32_t particleCount)
+{
+	ReplaySystem *system = replay->system;
+	const uint8_t *streams[MAX_PARTICLE_BUFFERS];
+	uint32_t i;
+
+	if (system->sim == NULL)
+	{
+		system->particleCount = particleCount;
+		system->particles = SDL_calloc(SDL_max(particleCount, 1), sizeof(Particle));
+		system->sim = CPUSim_Create(particleCount, CPUSIM_KERNEL_AUTO, replay->pool);
+	}
+
+	if (system->initialized)
+	{
+		Particle_InitializeArrayFromKey(system->particles, system->particleCount, system->initKey, replay->pool);
+	}
+	else if (system->uploaded)
+	{
+		for (i = 0; i < system->streamCount; i += 1)
+		{
+			/* A stream that was never uploaded decodes as zeros */
+			if (system->contents[i] == NULL)
+			{
+				ReplayObject *buffer = Replay_GetObject(replay, system->streams[i]);
+				system->contents[i] = SDL_calloc(SDL_max((buffer != NULL) ? buffer->size : 0, 1), 1);
+			}
+			streams[i] = system->contents[i];
+		}
+		ParticleLayout_DecodeStreams(system->layout, streams, system->particleCount, system->particles);
+	}
+	else
+	{
+		fprintf(stderr, "The starting state of the particles was not recorded, starting from zeros\n");
+	}
+
+	CPUSim_SetParticles(system->sim, system->particles);
+	system->dirty = false;
+}
+
+static void Replay_SystemDispatch(Replay *replay, ReplayCommandBuffer *commandBuffer, const ReplayObject *shader, uint32_t paramOffset)
+{
+	ReplaySystem *system = replay->system;
+	ParticleComputeUniforms steps[MAX_SUBSTEPS];
+	const ParticleSubstepUniforms *substepUniforms;
+	const ParticleInitUniforms *initUniforms;
+	const ReplayPush *push = Replay_FindPush(commandBuffer, paramOffset);
+	ParticleLayout layout;
+	bool substep;
+	uint32_t stepCount, i;
+	uint64_t start;
+
+	if (commandBuffer->bufferCount == 0 || commandBuffer->buffers[0] != system->streams[0])
+	{
+		return;
+	}
+
+	if (Replay_IsInitShader(shader->name))
+	{
+		if (push != NULL && push->size >= sizeof(ParticleInitUniforms))
+		{
+			initUniforms = (const ParticleInitUniforms*) push->data;
+			system->initKey = ((uint64_t) initUniforms->keyHigh << 32) | initUniforms->keyLow;
+			system->initialized = true;
+			system->dirty = true;
+		}
+		return;
+	}
+
+	if (!Replay_IsUpdateShader(shader->name, &layout, &substep))
+	{
+		if (Replay_IsParticlePass(shader->name))
+		{
+			system->skippedDispatchCount += 1;
+		}
+		return;
+	}
+
+	if (push == NULL)
+	{
+		return;
+	}
+
+	if (substep && push->size >= sizeof(ParticleSubstepUniforms))
+	{
+		substepUniforms = (const ParticleSubstepUniforms*) push->data;
+		stepCount = SDL_min(substepUniforms->stepCount, MAX_SUBSTEPS);
+		for (i = 0; i < stepCount; i += 1)
+		{
+			steps[i].deltaTime = substepUniforms->steps[i].deltaTime;
+			steps[i].destinationX = substepUniforms->steps[i].destinationX;
+			steps[i].destinationY = substepUniforms->steps[i].destinationY;
+			steps[i].particleCount = substepUniforms->particleCount;
+		}
+	}
+	else if (!substep && push->size >= sizeof(ParticleComputeUniforms))
+	{
+		SDL_memcpy(&steps[0], push->data, sizeof(ParticleComputeUniforms));
+		stepCount = 1;
+	}
+	else
+	{
+		return;
+	}
+
+	if (stepCount == 0)
+	{
+		return;
+	}
+
+	if (system->sim == NULL || system->dirty)
+	{
+		Replay_SystemTakeState(replay, steps[0].particleCount);
+	}
+
+	start = Bench_Now();
+	CPUSim_StepMany(system->sim, steps, stepCount);
+	system->seconds += Bench_Seconds(start, Bench_Now());
+
+	system->dispatchCount += 1;
+	system->stepCount += stepCount;
+}
+
+/* The walk over the log */
+
+static void Replay_EndFrame(Replay *replay, const RefreshRecordEntry *entry)
+{
+	ReplayCommandBuffer *commandBuffer;
+	uint32_t i;
+
+	for (i = 0; i < entry->call->argumentCount; i += 1)
+	{
+		ReplayObject *object = Replay_GetObject(replay, entry->arguments[i]);
+
+		if (object == NULL || (commandBuffer = object->commandBuffer) == NULL)
+		{
+			continue;
+		}
+
+		replay->current.dispatchCount += commandBuffer->dispatchCount;
+		replay->current.drawCount += commandBuffer->drawCount;
+
+		SDL_free(commandBuffer->pushes);
+		SDL_free(commandBuffer);
+		object->commandBuffer = NULL;
+	}
+
+	replay->current.submitTime = entry->call->time;
+	replay->current.hostTime = entry->call->time + entry->call->duration - replay->frameStart;
+
+	if (replay->frameCount == replay->frameCapacity)
+	{
+		replay->frameCapacity = SDL_max(replay->frameCapacity * 2, 256);
+		replay->frames = SDL_realloc(replay->frames, sizeof(ReplayFrame) * replay->frameCapacity);
+	}
+	replay->frames[replay->frameCount] = replay->current;
+	replay->frameCount += 1;
+
+	SDL_zero(replay->current);
+	replay->frameStarted = false;
+}
+
+static void Replay_Call(Replay *replay, const RefreshRecordEntry *entry)
+{
+	const RefreshRecordCall *call = entry->call;
+	ReplayObject *object = Replay_GetObject(replay, Replay_Argument(entry, 0));
+	ReplayCommandBuffer *commandBuffer;
+	ReplayObject *shader;
+	ParticleLayout layout;
+	bool substep;
+	uint64_t hash;
+	uint32_t i;
+
+	if (call->kind >= REFRESH_RECORD_KIND_COUNT)
+	{
+		return;
+	}
+
+	if (!replay->frameStarted)
+	{
+		replay->frameStarted = true;
+		replay->frameStart = call->time;
+	}
+
+	replay->callCount += 1;
+	replay->lastTime = call->time + call->duration;
+	replay->kindCounts[call->kind] += 1;
+	replay->kindTimes[call->kind] += call->duration;
+	replay->current.callCount += 1;
+	replay->current.callTime += call->duration;
+
+	switch (call->kind)
+	{
+	case REFRESH_RECORD_CREATE_BUFFER:
+	case REFRESH_RECORD_CREATE_TEXTURE_2D:
+	case REFRESH_RECORD_CREATE_SAMPLER:
+	case REFRESH_RECORD_CREATE_COLOR_TARGET:
+	case REFRESH_RECORD_CREATE_DEPTH_STENCIL_TARGET:
+	case REFRESH_RECORD_CREATE_RENDER_PASS:
+	case REFRESH_RECORD_CREATE_FRAMEBUFFER:
+	case REFRESH_RECORD_CREATE_GRAPHICS_PIPELINE:
+		if (object != NULL)
+		{
+			SDL_zerop(object);
+			object->kind = (RefreshRecordKind) call->kind;
+			object->size = (call->kind == REFRESH_RECORD_CREATE_BUFFER) ? Replay_Argument(entry, 2) : 0;
+		}
+		break;
+
+	case REFRESH_RECORD_CREATE_SHADER_MODULE:
+		if (object != NULL)
+		{
+			SDL_zerop(object);
+			object->kind = REFRESH_RECORD_CREATE_SHADER_MODULE;
+			hash = ((uint64_t) Replay_Argument(entry, 3) << 32) | Replay_Argument(entry, 2);
+			object->name = (replay->bundle != NULL) ? ShaderBundle_FindName(replay->bundle, hash) : NULL;
+		}
+		break;
+
+	case REFRESH_RECORD_CREATE_COMPUTE_PIPELINE:
+		if (object != NULL)
+		{
+			SDL_zerop(object);
+			object->kind = REFRESH_RECORD_CREATE_COMPUTE_PIPELINE;
+			object->shaderModule = Replay_Argument(entry, 1);
+		}
+		break;
+
+	case REFRESH_RECORD_SET_BUFFER_DATA:
+		replay->current.uploadBytes += Replay_Argument(entry, 2);
+		if (replay->system != NULL)
+		{
+			Replay_SystemUpload(replay, entry);
+		}
+		break;
+
+	case REFRESH_RECORD_SET_TEXTURE_DATA:
+		replay->current.uploadBytes += Replay_Argument(entry, 1);
+		break;
+
+	case REFRESH_RECORD_GET_BUFFER_DATA:
+		replay->current.downloadBytes += Replay_Argument(entry, 1);
+		break;
+
+	case REFRESH_RECORD_COPY_TEXTURE_TO_BUFFER:
+		replay->current.downloadBytes += Replay_Argument(entry, 3);
+		break;
+
+	case REFRESH_RECORD_ACQUIRE_COMMAND_BUFFER:
+		if (object != NULL)
+		{
+			SDL_zerop(object);
+			object->kind = REFRESH_RECORD_ACQUIRE_COMMAND_BUFFER;
+			object->commandBuffer = SDL_calloc(1, sizeof(ReplayCommandBuffer));
+		}
+		break;
+
+	case REFRESH_RECORD_BIND_COMPUTE_PIPELINE:
+		if ((commandBuffer = Replay_GetCommandBuffer(replay, Replay_Argument(entry, 0))) != NULL)
+		{
+			commandBuffer->computePipeline = Replay_Argument(entry, 1);
+		}
+		break;
+
+	case REFRESH_RECORD_BIND_COMPUTE_BUFFERS:
+		if ((commandBuffer = Replay_GetCommandBuffer(replay, Replay_Argument(entry, 0))) != NULL)
+		{
+			commandBuffer->bufferCount = SDL_min((uint32_t) SDL_max(call->argumentCount, 1) - 1, REPLAY_MAX_BINDINGS);
+			for (i = 0; i < commandBuffer->bufferCount; i += 1)
+			{
+				commandBuffer->buffers[i] = entry->arguments[1 + i];
+			}
+		}
+		break;
+
+	case REFRESH_RECORD_PUSH_COMPUTE_SHADER_PARAMS:
+		if ((commandBuffer = Replay_GetCommandBuffer(replay, Replay_Argument(entry, 0))) != NULL)
+		{
+			if (commandBuffer->pushCount == commandBuffer->pushCapacity)
+			{
+				commandBuffer->pushCapacity = SDL_max(commandBuffer->pushCapacity * 2, 16);
+				commandBuffer->pushes = SDL_realloc(commandBuffer->pushes, sizeof(ReplayPush) * commandBuffer->pushCapacity);
+			}
+			commandBuffer->pushes[commandBuffer->pushCount].offset = Replay_Argument(entry, 2);
+			commandBuffer->pushes[commandBuffer->pushCount].size = call->dataSize;
+			commandBuffer->pushes[commandBuffer->pushCount].data = entry->data;
+			commandBuffer->pushCount += 1;
+		}
+		break;
+
+	case REFRESH_RECORD_DISPATCH_COMPUTE:
+		if ((commandBuffer = Replay_GetCommandBuffer(replay, Replay_Argument(entry, 0))) == NULL)
+		{
+			break;
+		}
+
+		commandBuffer->dispatchCount += 1;
+		if ((shader = Replay_GetBoundShader(replay, commandBuffer)) == NULL)
+		{
+			break;
+		}
+
+		shader->dispatchCount += 1;
+		shader->groupCount += (uint64_t) Replay_Argument(entry, 1) * Replay_Argument(entry, 2) * Replay_Argument(entry, 3);
+
+		if (commandBuffer->bufferCount > 0 && Replay_IsUpdateShader(shader->name, &layout, &substep))
+		{
+			ReplayObject *stream = Replay_GetObject(replay, commandBuffer->buffers[0]);
+			if (stream != NULL)
+			{
+				stream->updateCount += 1;
+			}
+		}
+
+		if (replay->system != NULL)
+		{
+			Replay_SystemDispatch(replay, commandBuffer, shader, Replay_Argument(entry, 4));
+		}
+		break;
+
+	case REFRESH_RECORD_DRAW_PRIMITIVES:
+		if ((commandBuffer = Replay_GetCommandBuffer(replay, Replay_Argument(entry, 0))) != NULL)
+		{
+			commandBuffer->drawCount += 1;
+		}
+		break;
+
+	case REFRESH_RECORD_SUBMIT:
+		Replay_EndFrame(replay, entry);
+		break;
+
+	default:
+		break;
+	}
+}
+
+static void Replay_Reset(Replay *replay)
+{
+	uint32_t i;
+
+	for (i = 0; i < replay->objectCapacity; i += 1)
+	{
+		if (replay->objects[i].commandBuffer != NULL)
+		{
+			SDL_free(replay->objects[i].commandBuffer->pushes);
+			SDL_free(replay->objects[i].commandBuffer);
+		}
+	}
+	SDL_free(replay->objects);
+	replay->objects = NULL;
+	replay->objectCapacity = 0;
+	replay->badObjectId = 0;
+
+	SDL_free(replay->frames);
+	replay->frames = NULL;
+	replay->frameCount = 0;
+	replay->frameCapacity = 0;
+	SDL_zero(replay->current);
+	replay->frameStarted = false;
+	replay->callCount = 0;
+	SDL_zero(replay->kindCounts);
+	SDL_zero(replay->kindTimes);
+
+	RefreshRecordReader_Rewind(replay->reader);
+}
+
+/* Returns false, having stopped, at an object id out of range */
+static bool Replay_Run(Replay *replay)
+{
+	RefreshRecordEntry entry;
+
+	Replay_Reset(replay);
+	while (replay->badObjectId == 0 && RefreshRecordReader_Next(replay->reader, &entry))
+	{
+		Replay_Call(replay, &entry);
+	}
+
+	return replay->badObjectId == 0;
+}
+
+/* Picks the particle system the update ran on most, and the streams it
+ * had bound, from a first pass. Returns false if there is none.
+ */
+static bool Replay_FindSystem(Replay *replay, ReplaySystem *system)
+{
+	RefreshRecordEntry entry;
+	ReplayCommandBuffer *commandBuffer;
+	ReplayObject *shader;
+	uint32_t target = 0;
+	uint32_t i;
+
+	for (i = 1; i < replay->objectCapacity; i += 1)
+	{
+		if (replay->objects[i].updateCount > 0 &&
+			(target == 0 || replay->objects[i].updateCount > replay->objects[target].updateCount))
+		{
+			target = i;
+		}
+	}
+
+	if (target == 0)
+	{
+		return false;
+	}
+
+	/* Walk again only to see the bindings of its first update */
+	SDL_zerop(system);
+	Replay_Reset(replay);
+	while (replay->badObjectId == 0 && RefreshRecordReader_Next(replay->reader, &entry))
+	{
+		if (entry.call->kind != REFRESH_RECORD_DISPATCH_COMPUTE)
+		{
+			Replay_Call(replay, &entry);
+			continue;
+		}
+
+		commandBuffer = Replay_GetCommandBuffer(replay, Replay_Argument(&entry, 0));
+		shader = (commandBuffer != NULL) ? Replay_GetBoundShader(replay, commandBuffer) : NULL;
+
+		if (shader != NULL &&
+			commandBuffer->bufferCount > 0 &&
+			commandBuffer->buffers[0] == target &&
+			Replay_IsUpdateShader(shader->name, &system->layout, &system->substep))
+		{
+			system->streamCount = SDL_min(commandBuffer->bufferCount, MAX_PARTICLE_BUFFERS);
+			for (i = 0; i < system->streamCount; i += 1)
+			{
+				system->streams[i] = commandBuffer->buffers[i];
+			}
+			return true;
+		}
+
+		Replay_Call(replay, &entry);
+	}
+
+	return false;
+}
+
+/* Output */
+
+static int Replay_CompareDouble(const void *a, const void *b)
+{
+	double x = *(const double*) a;
+	double y = *(const double*) b;
+
+	return (x < y) ? -1 : (x > y);
+}
+
+static void Replay_PrintRow(const char *name, double *values, uint32_t count)
+{
+	double total = 0.0;
+	uint32_t i;
+
+	for (i = 0; i < count; i += 1)
+	{
+		total += values[i];
+	}
+	SDL_qsort(values, count, sizeof(double), Replay_CompareDouble);
+
+	printf(
+		"    %-16s %12.1f %12.1f %12.1f %14.0f\n",
+		name,
+		values[count / 2],
+		values[SDL_min((uint32_t) (count * 0.99), count - 1)],
+		values[count - 1],
+		total
+	);
+}
+
+static void Replay_PrintSummary(Replay *replay, const char *path)
+{
+	double *values;
+	uint32_t i, kind;
+
+	printf("%s\n", path);
+	printf("  calls             %u over %.3f ms\n", replay->callCount, replay->lastTime / 1e6);
+	printf("  file size         %llu bytes\n", (unsigned long long) RefreshRecordReader_GetSize(replay->reader));
+	printf("  frames            %u submits\n", replay->frameCount);
+	if (replay->current.callCount > 0)
+	{
+		printf("  after the last    %u calls\n", replay->current.callCount);
+	}
+
+	if (replay->frameCount > 0)
+	{
+		values = SDL_malloc(sizeof(double) * replay->frameCount);
+
+		printf("  per frame              median          p99          max          total\n");
+
+#define REPLAY_ROW(name, expression) \
+		for (i = 0; i < replay->frameCount; i += 1) \
+		{ \
+			const ReplayFrame *frame = &replay->frames[i]; \
+			values[i] = (double) (expression); \
+		} \
+		Replay_PrintRow(name, values, replay->frameCount);
+
+		REPLAY_ROW("calls", frame->callCount)
+		REPLAY_ROW("call time us", frame->callTime / 1e3)
+		REPLAY_ROW("host time us", frame->hostTime / 1e3)
+		REPLAY_ROW("uploaded bytes", frame->uploadBytes)
+		REPLAY_ROW("downloaded bytes", frame->downloadBytes)
+		REPLAY_ROW("dispatches", frame->dispatchCount)
+		REPLAY_ROW("draws", frame->drawCount)
+
+#undef REPLAY_ROW
+
+		SDL_free(values);
+	}
+
+	printf("  calls by kind            count      time us   mean ns\n");
+	for (kind = 0; kind < REFRESH_RECORD_KIND_COUNT; kind += 1)
+	{
+		if (replay->kindCounts[kind] > 0)
+		{
+			printf(
+				"    %-24s %8u %12.1f %9.0f\n",
+				RefreshRecord_GetKindName((RefreshRecordKind) kind),
+				replay->kindCounts[kind],
+				replay->kindTimes[kind] / 1e3,
+				(double) replay->kindTimes[kind] / replay->kindCounts[kind]
+			);
+		}
+	}
+
+	printf("  dispatches by shader                           count   workgroups\n");
+	for (i = 1; i < replay->objectCapacity; i += 1)
+	{
+		const ReplayObject *object = &replay->objects[i];
+		char unnamed[32];
+
+		if (object->kind != REFRESH_RECORD_CREATE_SHADER_MODULE || object->dispatchCount == 0)
+		{
+			continue;
+		}
+
+		SDL_snprintf(unnamed, sizeof(unnamed), "shader module %u", i);
+		printf(
+			"    %-40s %8u %12llu\n",
+			(object->name != NULL) ? object->name : unnamed,
+			object->dispatchCount,
+			(unsigned long long) object->groupCount
+		);
+	}
+}
+
+static bool Replay_WriteCSV(Replay *replay, const char *path)
+{
+	FILE *file = fopen(path, "w");
+	uint32_t i;
+	bool written;
+
+	if (file == NULL)
+	{
+		fprintf(stderr, "Could not open %s for writing\n", path);
+		return false;
+	}
+
+	fprintf(file, "frame,submit_ms,calls,call_us,host_us,upload_bytes,download_bytes,dispatches,draws\n");
+	for (i = 0; i < replay->frameCount; i += 1)
+	{
+		const ReplayFrame *frame = &replay->frames[i];
+
+		fprintf(
+			file,
+			"%u,%.3f,%u,%.3f,%.3f,%llu,%llu,%u,%u\n",
+			i,
+			frame->submitTime / 1e6,
+			frame->callCount,
+			frame->callTime / 1e3,
+			frame->hostTime / 1e3,
+			(unsigned long long) frame->uploadBytes,
+			(unsigned long long) frame->downloadBytes,
+			frame->dispatchCount,
+			frame->drawCount
+		);
+	}
+
+	written = !ferror(file);
+	written = (fclose(file) == 0) && written;
+	if (!written)
+	{
+		fprintf(stderr, "Could not write %s\n", path);
+	}
+	return written;
+}
+
+static void Replay_PrintSystem(ReplaySystem *system, uint32_t threadCount)
+{
+	if (system->sim == NULL)
+	{
+		printf("cpu replay: no particle update was dispatched\n");
+		return;
+	}
+
+	CPUSim_GetParticles(system->sim, system->particles);
+
+	printf(
+		"cpu replay: %u steps in %u dispatches on %u particles (%s layout, %s), %.3f ms on %u threads with the %s kernel, checksum %016llx\n",
+		system->stepCount,
+		system->dispatchCount,
+		system->particleCount,
+		ParticleLayout_GetName(system->layout),
+		system->substep ? "substeps" : "one step per dispatch",
+		system->seconds * 1e3,
+		threadCount,
+		CPUSim_GetKernelName(CPUSim_GetKernel(system->sim)),
+		(unsigned long long) Bench_Checksum(system->particles, sizeof(Particle) * system->particleCount)
+	);
+
+	if (system->skippedDispatchCount > 0)
+	{
+		printf("  %u dispatches of other passes writing the particles were not replayed\n", system->skippedDispatchCount);
+	}
+	if (system->missedUploads > 0)
+	{
+		printf("  %u uploads to the particles were recorded without their contents\n", system->missedUploads);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = NULL;
+	const char *bundlePath = "shaders.bundle";
+	const char *csvPath = NULL;
+	bool cpu = false;
+	uint32_t threadCount = (uint32_t) SDL_GetCPUCount();
+	Replay replay;
+	ReplaySystem system;
+	int result = 0;
+	int i;
+
+	for (i = 1; i < argc; i += 1)
+	{
+		if (strcmp(argv[i], "--bundle") == 0 && i + 1 < argc)
+		{
+			bundlePath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+		{
+			csvPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--cpu") == 0)
+		{
+			cpu = true;
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			threadCount = (uint32_t) strtoul(argv[++i], NULL, 10);
+			threadCount = SDL_max(threadCount, 1);
+		}
+		else if (argv[i][0] != '-' && path == NULL)
+		{
+			path = argv[i];
+		}
+		else
+		{
+			Replay_Usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (path == NULL)
+	{
+		Replay_Usage(argv[0]);
+		return 1;
+	}
+
+	SDL_zero(replay);
+	if ((replay.reader = RefreshRecordReader_Open(path)) == NULL)
+	{
+		return 1;
+	}
+
+	replay.bundle = ShaderBundle_Open(bundlePath);
+	if (replay.bundle == NULL)
+	{
+		fprintf(stderr, "No shader bundle at %s, shaders are left unnamed\n", bundlePath);
+	}
+
+	if (!Replay_Run(&replay))
+	{
+		fprintf(stderr, "%s: object id %u is out of range, the log is corrupt\n", path, replay.badObjectId);
+		Replay_Reset(&replay);
+		ShaderBundle_Close(replay.bundle);
+		RefreshRecordReader_Close(replay.reader);
+		return 1;
+	}
+	Replay_PrintSummary(&replay, path);
+
+	if (csvPath != NULL && !Replay_WriteCSV(&replay, csvPath))
+	{
+		result = 1;
+	}
+
+	if (cpu)
+	{
+		if (!Replay_FindSystem(&replay, &system))
+		{
+			fprintf(stderr, "No particle update to replay%s\n", (replay.bundle == NULL) ? " without the shader bundle" : "");
+			result = 1;
+		}
+		else
+		{
+			replay.pool = (threadCount > 1) ? ThreadPool_Create(threadCount) : NULL;
+			replay.system = &system;
+			Replay_Run(&replay);
+			Replay_PrintSystem(&system, threadCount);
+
+			CPUSim_Destroy(system.sim);
+			SDL_free(system.particles);
+			for (i = 0; i < MAX_PARTICLE_BUFFERS; i += 1)
+			{
+				SDL_free(system.contents[i]);
+			}
+			ThreadPool_Destroy(replay.pool);
+		}
+	}
+
+	Replay_Reset(&replay);
+	ShaderBundle_Close(replay.bundle);
+	RefreshRecordReader_Close(replay.reader);
+	return result;
+}
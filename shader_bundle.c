@@ -0,0 +1,145 @@
+#include "shader_bundle.h"
+
+#include <SDL.h>
+
+#include "file_map.h"
+
+struct ShaderBundle
+{
+	FileMap map;
+
+	const ShaderBundleEntry *entries;
+	uint32_t entryCount;
+};
+
+static bool ShaderBundle_Validate(ShaderBundle *bundle)
+{
+	const ShaderBundleHeader *header = (const ShaderBundleHeader*) bundle->map.data;
+	uint64_t tableEnd;
+	uint32_t i;
+
+	if (bundle->map.size < sizeof(ShaderBundleHeader) ||
+		header->magic != SHADER_BUNDLE_MAGIC ||
+		header->version != SHADER_BUNDLE_VERSION)
+	{
+		return false;
+	}
+
+	tableEnd = sizeof(ShaderBundleHeader) + (uint64_t) header->entryCount * sizeof(ShaderBundleEntry);
+	if (tableEnd > bundle->map.size)
+	{
+		return false;
+	}
+
+	bundle->entries = (const ShaderBundleEntry*) (bundle->map.data + sizeof(ShaderBundleHeader));
+	bundle->entryCount = header->entryCount;
+
+	for (i = 0; i < bundle->entryCount; i += 1)
+	{
+		const ShaderBundleEntry *entry = &bundle->entries[i];
+
+		if (entry->name[SHADER_BUNDLE_NAME_LENGTH - 1] != '\0' ||
+			(entry->offset % SHADER_BUNDLE_ALIGNMENT) != 0 ||
+			(entry->size % sizeof(uint32_t)) != 0 ||
+			entry->offset < tableEnd ||
+			(uint64_t) entry->offset + entry->size > bundle->map.size)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Public API */
+
+ShaderBundle* ShaderBundle_Open(const char *path)
+{
+	ShaderBundle *bundle = SDL_malloc(sizeof(ShaderBundle));
+
+	SDL_zerop(bundle);
+
+	if (!FileMap_Open(&bundle->map, path))
+	{
+		SDL_free(bundle);
+		return NULL;
+	}
+
+	if (!ShaderBundle_Validate(bundle))
+	{
+		SDL_Log("%s is not a version %u shader bundle, ignoring it", path, SHADER_BUNDLE_VERSION);
+		ShaderBundle_Close(bundle);
+		return NULL;
+	}
+
+	return bundle;
+}
+
+void ShaderBundle_Close(ShaderBundle *bundle)
+{
+	if (bundle == NULL)
+	{
+		return;
+	}
+
+	FileMap_Close(&bundle->map);
+	SDL_free(bundle);
+}
+
+bool ShaderBundle_Find(
+	ShaderBundle *bundle,
+	const char *name,
+	const uint32_t **code,
+	uint32_t *size,
+	uint64_t *hash
+) {
+	uint32_t i;
+
+	for (i = 0; i < bundle->entryCount; i += 1)
+	{
+		if (SDL_strcmp(bundle->entries[i].name, name) == 0)
+		{
+			*code = (const uint32_t*) (bundle->map.data + bundle->entries[i].offset);
+			*size = bundle->entries[i].size;
+			*hash = bundle->entries[i].hash;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const char* ShaderBundle_FindName(ShaderBundle *bundle, uint64_t hash)
+{
+	uint32_t i;
+
+	for (i = 0; i < bundle->entryCount; i += 1)
+	{
+		if (bundle->entries[i].hash == hash)
+		{
+			return bundle->entries[i].name;
+		}
+	}
+
+	return NULL;
+}
+
+uint32_t ShaderBundle_GetEntryCount(ShaderBundle *bundle)
+{
+	return bundle->entryCount;
+}
+
+uint64_t ShaderBundle_Hash(const void *data, uint64_t length)
+{
+	const uint8_t *bytes = (const uint8_t*) data;
+	uint64_t hash = 0xCBF29CE484222325ull;
+	uint64_t i;
+
+	for (i = 0; i < length; i += 1)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ull;
+	}
+
+	return hash;
+}
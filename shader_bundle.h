@@ -0,0 +1,67 @@
+#ifndef SHADER_BUNDLE_H
+#define SHADER_BUNDLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Every SPIR-V binary packed into one file, written at build time by the
+ * PackShaders target and memory-mapped at startup. Shader modules are
+ * created straight from the mapping, so no shader is read or copied into
+ * a heap buffer first.
+ *
+ * Layout: a ShaderBundleHeader, entryCount ShaderBundleEntry records, then
+ * the SPIR-V of every entry at its offset, each aligned to
+ * SHADER_BUNDLE_ALIGNMENT bytes. All fields are little endian.
+ */
+
+#define SHADER_BUNDLE_MAGIC 0x42485352 /* "RSHB" */
+#define SHADER_BUNDLE_VERSION 1
+#define SHADER_BUNDLE_NAME_LENGTH 48
+#define SHADER_BUNDLE_ALIGNMENT 16
+
+typedef struct ShaderBundleHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t reserved;
+} ShaderBundleHeader;
+
+typedef struct ShaderBundleEntry
+{
+	char name[SHADER_BUNDLE_NAME_LENGTH]; /* file name the SPIR-V was packed from, NUL terminated */
+	uint64_t hash;                        /* ShaderBundle_Hash of the SPIR-V */
+	uint32_t offset;                      /* from the start of the file */
+	uint32_t size;                        /* in bytes */
+} ShaderBundleEntry;
+
+typedef struct ShaderBundle ShaderBundle;
+
+/* Returns NULL without logging if the file does not exist, and logs if it
+ * exists but is not a valid bundle.
+ */
+ShaderBundle* ShaderBundle_Open(const char *path);
+void ShaderBundle_Close(ShaderBundle *bundle);
+
+/* Finds an entry by file name. code points into the mapping and stays
+ * valid until the bundle is closed.
+ */
+bool ShaderBundle_Find(
+	ShaderBundle *bundle,
+	const char *name,
+	const uint32_t **code,
+	uint32_t *size,
+	uint64_t *hash
+);
+
+/* The name of the first entry whose SPIR-V hashes to hash, or NULL. It
+ * points into the mapping.
+ */
+const char* ShaderBundle_FindName(ShaderBundle *bundle, uint64_t hash);
+
+uint32_t ShaderBundle_GetEntryCount(ShaderBundle *bundle);
+
+/* FNV-1a, the same hash the packer stores */
+uint64_t ShaderBundle_Hash(const void *data, uint64_t length);
+
+#endif /* SHADER_BUNDLE_H */
@@ -0,0 +1,488 @@
+#include "shader_module.h"
+
+#include <SDL.h>
+
+#include "bench.h"
+#include "shader_bundle.h"
+
+#define PIPELINE_INDEX_MAGIC 0x494C5052 /* "RPLI" */
+#define PIPELINE_INDEX_VERSION 1
+
+typedef struct PipelineIndexHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t reserved;
+	double coldStartupSeconds;
+} PipelineIndexHeader;
+
+typedef struct PipelineIndexEntry
+{
+	uint64_t key;
+	double coldSeconds; /* creation time the first time it was seen */
+} PipelineIndexEntry;
+
+typedef struct ShaderCacheModule
+{
+	REFRESH_ShaderModule *module;
+	uint64_t hash;
+} ShaderCacheModule;
+
+struct ShaderCache
+{
+	ShaderBundle *bundle;
+
+	ShaderCacheModule *modules;
+	uint32_t moduleCount;
+	uint32_t moduleCapacity;
+
+	char *indexPath;
+	PipelineIndexEntry *entries;
+	uint32_t entryCount;
+	uint32_t entryCapacity;
+	bool indexDirty;
+
+	ShaderCacheStats stats;
+};
+
+/* Keys are built from individual values rather than raw structs so that
+ * padding and pointers never reach the hash.
+ */
+
+static uint64_t ShaderCache_Mix(uint64_t hash, uint64_t value)
+{
+	uint32_t i;
+
+	for (i = 0; i < 8; i += 1)
+	{
+		hash ^= (value >> (i * 8)) & 0xFF;
+		hash *= 0x100000001B3ull;
+	}
+
+	return hash;
+}
+
+static uint64_t ShaderCache_MixFloat(uint64_t hash, float value)
+{
+	uint32_t bits;
+	SDL_memcpy(&bits, &value, sizeof(bits));
+	return ShaderCache_Mix(hash, bits);
+}
+
+static uint64_t ShaderCache_MixString(uint64_t hash, const char *value)
+{
+	return ShaderCache_Mix(hash, ShaderBundle_Hash(value, SDL_strlen(value)));
+}
+
+static uint64_t ShaderCache_GetModuleHash(ShaderCache *cache, REFRESH_ShaderModule *module)
+{
+	uint32_t i;
+
+	for (i = 0; i < cache->moduleCount; i += 1)
+	{
+		if (cache->modules[i].module == module)
+		{
+			return cache->modules[i].hash;
+		}
+	}
+
+	/* Not loaded through this cache; the pointer is the best key there is */
+	return (uint64_t) (uintptr_t) module;
+}
+
+static uint64_t ShaderCache_MixStage(ShaderCache *cache, uint64_t hash, const REFRESH_ShaderStageState *stage)
+{
+	hash = ShaderCache_Mix(hash, ShaderCache_GetModuleHash(cache, stage->shaderModule));
+	hash = ShaderCache_MixString(hash, stage->entryPointName);
+	return ShaderCache_Mix(hash, stage->uniformBufferSize);
+}
+
+static uint64_t ShaderCache_MixStencil(uint64_t hash, const REFRESH_StencilOpState *stencil)
+{
+	hash = ShaderCache_Mix(hash, stencil->failOp);
+	hash = ShaderCache_Mix(hash, stencil->passOp);
+	hash = ShaderCache_Mix(hash, stencil->depthFailOp);
+	hash = ShaderCache_Mix(hash, stencil->compareOp);
+	hash = ShaderCache_Mix(hash, stencil->compareMask);
+	hash = ShaderCache_Mix(hash, stencil->writeMask);
+	return ShaderCache_Mix(hash, stencil->reference);
+}
+
+static uint64_t ShaderCache_ComputeKey(ShaderCache *cache, REFRESH_ComputePipelineCreateInfo *createInfo)
+{
+	uint64_t hash = ShaderCache_Mix(0xCBF29CE484222325ull, 'C');
+
+	hash = ShaderCache_MixStage(cache, hash, &createInfo->computeShaderState);
+	hash = ShaderCache_Mix(hash, createInfo->pipelineLayoutCreateInfo.bufferBindingCount);
+	return ShaderCache_Mix(hash, createInfo->pipelineLayoutCreateInfo.imageBindingCount);
+}
+
+/* The render pass is left out: it only has to be compatible, and this
+ * program creates one per run with the same formats.
+ */
+static uint64_t ShaderCache_GraphicsKey(ShaderCache *cache, REFRESH_GraphicsPipelineCreateInfo *createInfo)
+{
+	uint32_t i;
+	uint64_t hash = ShaderCache_Mix(0xCBF29CE484222325ull, 'G');
+	const REFRESH_VertexInputState *vertexInput = &createInfo->vertexInputState;
+	const REFRESH_ViewportState *viewportState = &createInfo->viewportState;
+	const REFRESH_RasterizerState *rasterizer = &createInfo->rasterizerState;
+	const REFRESH_DepthStencilState *depthStencil = &createInfo->depthStencilState;
+	const REFRESH_ColorBlendState *colorBlend = &createInfo->colorBlendState;
+
+	hash = ShaderCache_MixStage(cache, hash, &createInfo->vertexShaderState);
+	hash = ShaderCache_MixStage(cache, hash, &createInfo->fragmentShaderState);
+
+	hash = ShaderCache_Mix(hash, vertexInput->vertexBindingCount);
+	for (i = 0; i < vertexInput->vertexBindingCount; i += 1)
+	{
+		hash = ShaderCache_Mix(hash, vertexInput->vertexBindings[i].binding);
+		hash = ShaderCache_Mix(hash, vertexInput->vertexBindings[i].inputRate);
+		hash = ShaderCache_Mix(hash, vertexInput->vertexBindings[i].stride);
+	}
+	hash = ShaderCache_Mix(hash, vertexInput->vertexAttributeCount);
+	for (i = 0; i < vertexInput->vertexAttributeCount; i += 1)
+	{
+		hash = ShaderCache_Mix(hash, vertexInput->vertexAttributes[i].location);
+		hash = ShaderCache_Mix(hash, vertexInput->vertexAttributes[i].binding);
+		hash = ShaderCache_Mix(hash, vertexInput->vertexAttributes[i].format);
+		hash = ShaderCache_Mix(hash, vertexInput->vertexAttributes[i].offset);
+	}
+
+	hash = ShaderCache_Mix(hash, createInfo->topologyState.topology);
+
+	hash = ShaderCache_Mix(hash, viewportState->viewportCount);
+	for (i = 0; i < viewportState->viewportCount; i += 1)
+	{
+		hash = ShaderCache_MixFloat(hash, viewportState->viewports[i].x);
+		hash = ShaderCache_MixFloat(hash, viewportState->viewports[i].y);
+		hash = ShaderCache_MixFloat(hash, viewportState->viewports[i].w);
+		hash = ShaderCache_MixFloat(hash, viewportState->viewports[i].h);
+		hash = ShaderCache_MixFloat(hash, viewportState->viewports[i].minDepth);
+		hash = ShaderCache_MixFloat(hash, viewportState->viewports[i].maxDepth);
+	}
+	hash = ShaderCache_Mix(hash, viewportState->scissorCount);
+	for (i = 0; i < viewportState->scissorCount; i += 1)
+	{
+		hash = ShaderCache_Mix(hash, (uint32_t) viewportState->scissors[i].x);
+		hash = ShaderCache_Mix(hash, (uint32_t) viewportState->scissors[i].y);
+		hash = ShaderCache_Mix(hash, (uint32_t) viewportState->scissors[i].w);
+		hash = ShaderCache_Mix(hash, (uint32_t) viewportState->scissors[i].h);
+	}
+
+	hash = ShaderCache_Mix(hash, rasterizer->depthClampEnable);
+	hash = ShaderCache_Mix(hash, rasterizer->fillMode);
+	hash = ShaderCache_Mix(hash, rasterizer->cullMode);
+	hash = ShaderCache_Mix(hash, rasterizer->frontFace);
+	hash = ShaderCache_Mix(hash, rasterizer->depthBiasEnable);
+	hash = ShaderCache_MixFloat(hash, rasterizer->depthBiasConstantFactor);
+	hash = ShaderCache_MixFloat(hash, rasterizer->depthBiasClamp);
+	hash = ShaderCache_MixFloat(hash, rasterizer->depthBiasSlopeFactor);
+	hash = ShaderCache_MixFloat(hash, rasterizer->lineWidth);
+
+	hash = ShaderCache_Mix(hash, createInfo->multisampleState.multisampleCount);
+	hash = ShaderCache_Mix(hash, createInfo->multisampleState.sampleMask);
+
+	hash = ShaderCache_Mix(hash, depthStencil->depthTestEnable);
+	hash = ShaderCache_Mix(hash, depthStencil->depthWriteEnable);
+	hash = ShaderCache_Mix(hash, depthStencil->compareOp);
+	hash = ShaderCache_Mix(hash, depthStencil->depthBoundsTestEnable);
+	hash = ShaderCache_Mix(hash, depthStencil->stencilTestEnable);
+	hash = ShaderCache_MixStencil(hash, &depthStencil->frontStencilState);
+	hash = ShaderCache_MixStencil(hash, &depthStencil->backStencilState);
+	hash = ShaderCache_MixFloat(hash, depthStencil->minDepthBounds);
+	hash = ShaderCache_MixFloat(hash, depthStencil->maxDepthBounds);
+
+	hash = ShaderCache_Mix(hash, colorBlend->logicOpEnable);
+	hash = ShaderCache_Mix(hash, colorBlend->logicOp);
+	hash = ShaderCache_Mix(hash, colorBlend->blendStateCount);
+	for (i = 0; i < colorBlend->blendStateCount; i += 1)
+	{
+		hash = ShaderCache_Mix(hash, colorBlend->blendStates[i].blendEnable);
+		hash = ShaderCache_Mix(hash, colorBlend->blendStates[i].srcColorBlendFactor);
+		hash = ShaderCache_Mix(hash, colorBlend->blendStates[i].dstColorBlendFactor);
+		hash = ShaderCache_Mix(hash, colorBlend->blendStates[i].colorBlendOp);
+		hash = ShaderCache_Mix(hash, colorBlend->blendStates[i].srcAlphaBlendFactor);
+		hash = ShaderCache_Mix(hash, colorBlend->blendStates[i].dstAlphaBlendFactor);
+		hash = ShaderCache_Mix(hash, colorBlend->blendStates[i].alphaBlendOp);
+		hash = ShaderCache_Mix(hash, colorBlend->blendStates[i].colorWriteMask);
+	}
+	for (i = 0; i < 4; i += 1)
+	{
+		hash = ShaderCache_MixFloat(hash, colorBlend->blendConstants[i]);
+	}
+
+	hash = ShaderCache_Mix(hash, createInfo->pipelineLayoutCreateInfo.vertexSamplerBindingCount);
+	return ShaderCache_Mix(hash, createInfo->pipelineLayoutCreateInfo.fragmentSamplerBindingCount);
+}
+
+/* Pipeline index file */
+
+static void ShaderCache_ReadIndex(ShaderCache *cache)
+{
+	PipelineIndexHeader header;
+	SDL_RWops *file = SDL_RWFromFile(cache->indexPath, "rb");
+
+	if (file == NULL)
+	{
+		return;
+	}
+
+	if (SDL_RWread(file, &header, sizeof(header), 1) != 1 ||
+		header.magic != PIPELINE_INDEX_MAGIC ||
+		header.version != PIPELINE_INDEX_VERSION)
+	{
+		SDL_Log("%s is not a version %u pipeline cache, starting a new one", cache->indexPath, PIPELINE_INDEX_VERSION);
+		SDL_RWclose(file);
+		return;
+	}
+
+	cache->entries = SDL_malloc(sizeof(PipelineIndexEntry) * SDL_max(header.entryCount, 1));
+	cache->entryCapacity = SDL_max(header.entryCount, 1);
+	cache->entryCount = (uint32_t) SDL_RWread(file, cache->entries, sizeof(PipelineIndexEntry), header.entryCount);
+	cache->stats.coldStartupSeconds = header.coldStartupSeconds;
+
+	SDL_RWclose(file);
+}
+
+static void ShaderCache_WriteIndex(ShaderCache *cache)
+{
+	PipelineIndexHeader header;
+	SDL_RWops *file = SDL_RWFromFile(cache->indexPath, "wb");
+
+	if (file == NULL)
+	{
+		SDL_Log("Could not open %s for writing: %s", cache->indexPath, SDL_GetError());
+		return;
+	}
+
+	header.magic = PIPELINE_INDEX_MAGIC;
+	header.version = PIPELINE_INDEX_VERSION;
+	header.entryCount = cache->entryCount;
+	header.reserved = 0;
+	header.coldStartupSeconds = cache->stats.coldStartupSeconds;
+
+	SDL_RWwrite(file, &header, sizeof(header), 1);
+	SDL_RWwrite(file, cache->entries, sizeof(PipelineIndexEntry), cache->entryCount);
+	SDL_RWclose(file);
+}
+
+static PipelineIndexEntry* ShaderCache_FindEntry(ShaderCache *cache, uint64_t key)
+{
+	uint32_t i;
+
+	for (i = 0; i < cache->entryCount; i += 1)
+	{
+		if (cache->entries[i].key == key)
+		{
+			return &cache->entries[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void ShaderCache_RecordPipeline(ShaderCache *cache, uint64_t key, double seconds)
+{
+	PipelineIndexEntry *entry;
+
+	if (cache->indexPath == NULL)
+	{
+		cache->stats.coldPipelineCount += 1;
+		cache->stats.coldPipelineSeconds += seconds;
+		return;
+	}
+
+	entry = ShaderCache_FindEntry(cache, key);
+	if (entry != NULL)
+	{
+		cache->stats.warmPipelineCount += 1;
+		cache->stats.warmPipelineSeconds += seconds;
+		return;
+	}
+
+	cache->stats.coldPipelineCount += 1;
+	cache->stats.coldPipelineSeconds += seconds;
+
+	if (cache->entryCount == cache->entryCapacity)
+	{
+		cache->entryCapacity = SDL_max(cache->entryCapacity * 2, 16);
+		cache->entries = SDL_realloc(cache->entries, sizeof(PipelineIndexEntry) * cache->entryCapacity);
+	}
+
+	cache->entries[cache->entryCount].key = key;
+	cache->entries[cache->entryCount].coldSeconds = seconds;
+	cache->entryCount += 1;
+	cache->indexDirty = true;
+}
+
+/* Public API */
+
+ShaderCache* ShaderCache_Create(const char *bundlePath, const char *pipelineCachePath)
+{
+	ShaderCache *cache = SDL_malloc(sizeof(ShaderCache));
+
+	SDL_zerop(cache);
+
+	if (bundlePath != NULL)
+	{
+		cache->bundle = ShaderBundle_Open(bundlePath);
+	}
+
+	if (pipelineCachePath != NULL)
+	{
+		cache->indexPath = SDL_strdup(pipelineCachePath);
+		ShaderCache_ReadIndex(cache);
+	}
+
+	return cache;
+}
+
+void ShaderCache_Destroy(ShaderCache *cache)
+{
+	if (cache == NULL)
+	{
+		return;
+	}
+
+	if (cache->indexPath != NULL && cache->indexDirty)
+	{
+		ShaderCache_WriteIndex(cache);
+	}
+
+	ShaderBundle_Close(cache->bundle);
+	SDL_free(cache->modules);
+	SDL_free(cache->entries);
+	SDL_free(cache->indexPath);
+	SDL_free(cache);
+}
+
+REFRESH_ShaderModule* ShaderModule_Load(REFRESH_Device *device, ShaderCache *cache, const char *path)
+{
+	REFRESH_ShaderModuleCreateInfo shaderModuleCreateInfo;
+	REFRESH_ShaderModule *shaderModule;
+	const uint32_t *bundledCode;
+	uint32_t bundledSize;
+	uint64_t hash;
+
+	if (cache != NULL && cache->bundle != NULL && ShaderBundle_Find(cache->bundle, path, &bundledCode, &bundledSize, &hash))
+	{
+		/* Straight from the mapping, no copy */
+		shaderModuleCreateInfo.byteCode = bundledCode;
+		shaderModuleCreateInfo.codeSize = bundledSize;
+		shaderModule = REFRESH_CreateShaderModule(device, &shaderModuleCreateInfo);
+		cache->stats.bundledShaderCount += 1;
+	}
+	else
+	{
+		SDL_RWops* file = SDL_RWFromFile(path, "rb");
+		if (file == NULL)
+		{
+			SDL_Log("Could not open shader %s: %s", path, SDL_GetError());
+			return NULL;
+		}
+
+		Sint64 shaderCodeSize = SDL_RWsize(file);
+		uint32_t* byteCode = SDL_malloc(shaderCodeSize);
+		SDL_RWread(file, byteCode, 1, shaderCodeSize);
+		SDL_RWclose(file);
+
+		shaderModuleCreateInfo.byteCode = byteCode;
+		shaderModuleCreateInfo.codeSize = shaderCodeSize;
+		shaderModule = REFRESH_CreateShaderModule(device, &shaderModuleCreateInfo);
+
+		hash = ShaderBundle_Hash(byteCode, shaderCodeSize);
+		SDL_free(byteCode);
+
+		if (cache != NULL)
+		{
+			cache->stats.looseShaderCount += 1;
+		}
+	}
+
+	if (cache != NULL && shaderModule != NULL)
+	{
+		if (cache->moduleCount == cache->moduleCapacity)
+		{
+			cache->moduleCapacity = SDL_max(cache->moduleCapacity * 2, 16);
+			cache->modules = SDL_realloc(cache->modules, sizeof(ShaderCacheModule) * cache->moduleCapacity);
+		}
+		cache->modules[cache->moduleCount].module = shaderModule;
+		cache->modules[cache->moduleCount].hash = hash;
+		cache->moduleCount += 1;
+	}
+
+	return shaderModule;
+}
+
+REFRESH_ComputePipeline* ShaderCache_CreateComputePipeline(
+	ShaderCache *cache,
+	REFRESH_Device *device,
+	REFRESH_ComputePipelineCreateInfo *createInfo
+) {
+	uint64_t start = Bench_Now();
+	REFRESH_ComputePipeline *pipeline = REFRESH_CreateComputePipeline(device, createInfo);
+
+	if (cache != NULL)
+	{
+		ShaderCache_RecordPipeline(cache, ShaderCache_ComputeKey(cache, createInfo), Bench_Seconds(start, Bench_Now()));
+	}
+
+	return pipeline;
+}
+
+REFRESH_GraphicsPipeline* ShaderCache_CreateGraphicsPipeline(
+	ShaderCache *cache,
+	REFRESH_Device *device,
+	REFRESH_GraphicsPipelineCreateInfo *createInfo
+) {
+	uint64_t start = Bench_Now();
+	REFRESH_GraphicsPipeline *pipeline = REFRESH_CreateGraphicsPipeline(device, createInfo);
+
+	if (cache != NULL)
+	{
+		ShaderCache_RecordPipeline(cache, ShaderCache_GraphicsKey(cache, createInfo), Bench_Seconds(start, Bench_Now()));
+	}
+
+	return pipeline;
+}
+
+void ShaderCache_FinishStartup(ShaderCache *cache, double startupSeconds)
+{
+	if (cache->indexPath != NULL && cache->stats.coldPipelineCount > 0)
+	{
+		cache->stats.coldStartupSeconds = startupSeconds;
+		cache->indexDirty = true;
+	}
+}
+
+const char* ShaderCache_GetStartupKind(ShaderCache *cache)
+{
+	if (cache->indexPath == NULL)
+	{
+		return "off";
+	}
+	return (cache->stats.coldPipelineCount > 0) ? "cold" : "warm";
+}
+
+void ShaderCache_GetStats(ShaderCache *cache, ShaderCacheStats *stats)
+{
+	*stats = cache->stats;
+}
+
+void ShaderCache_LogStats(ShaderCache *cache)
+{
+	ShaderCacheStats *stats = &cache->stats;
+
+	SDL_Log(
+		"Shaders: %u from the bundle, %u loose; pipelines: %u cold in %.3f ms, %u warm in %.3f ms (%s start)",
+		stats->bundledShaderCount,
+		stats->looseShaderCount,
+		stats->coldPipelineCount,
+		stats->coldPipelineSeconds * 1000.0,
+		stats->warmPipelineCount,
+		stats->warmPipelineSeconds * 1000.0,
+		ShaderCache_GetStartupKind(cache)
+	);
+}
@@ -0,0 +1,72 @@
+#ifndef SHADER_MODULE_H
+#define SHADER_MODULE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <Refresh.h>
+
+/* Where shader modules and pipelines come from.
+ *
+ * A ShaderCache maps the shader bundle, if there is one, and keeps a small
+ * on-disk index of every pipeline this machine has created before, keyed
+ * by the hash of its SPIR-V and of its create info. Refresh does not
+ * expose the Vulkan pipeline cache, so the index cannot hand a compiled
+ * pipeline back; warm starts are fast because the driver's own shader
+ * cache is keyed on the same inputs. What the index provides is knowing
+ * whether a start was cold or warm, and what the cold start cost, so the
+ * two can be reported side by side.
+ */
+
+typedef struct ShaderCache ShaderCache;
+
+typedef struct ShaderCacheStats
+{
+	uint32_t bundledShaderCount; /* modules created straight from the mapped bundle */
+	uint32_t looseShaderCount;   /* modules read from individual .spv files */
+	uint32_t coldPipelineCount;  /* not in the index */
+	uint32_t warmPipelineCount;
+	double coldPipelineSeconds;
+	double warmPipelineSeconds;
+	double coldStartupSeconds; /* of the run that last filled the index, 0 if unknown */
+} ShaderCacheStats;
+
+/* Either path may be NULL. A missing bundle falls back to loose .spv
+ * files, and a missing or unreadable index starts an empty one.
+ */
+ShaderCache* ShaderCache_Create(const char *bundlePath, const char *pipelineCachePath);
+
+/* Writes the index back if it changed */
+void ShaderCache_Destroy(ShaderCache *cache);
+
+/* Loads a SPIR-V file by name, from the bundle if it has it. cache may be
+ * NULL. Logs and returns NULL if the shader cannot be found.
+ */
+REFRESH_ShaderModule* ShaderModule_Load(REFRESH_Device *device, ShaderCache *cache, const char *path);
+
+/* REFRESH_Create*Pipeline, timed and looked up in the index. The shader
+ * modules must have come from ShaderModule_Load with the same cache.
+ */
+REFRESH_ComputePipeline* ShaderCache_CreateComputePipeline(
+	ShaderCache *cache,
+	REFRESH_Device *device,
+	REFRESH_ComputePipelineCreateInfo *createInfo
+);
+REFRESH_GraphicsPipeline* ShaderCache_CreateGraphicsPipeline(
+	ShaderCache *cache,
+	REFRESH_Device *device,
+	REFRESH_GraphicsPipelineCreateInfo *createInfo
+);
+
+/* Once every pipeline is created: a start with any cold pipeline stores
+ * its startup time as the cold one to compare warm starts against.
+ */
+void ShaderCache_FinishStartup(ShaderCache *cache, double startupSeconds);
+
+/* "cold", "warm", or "off" without an index */
+const char* ShaderCache_GetStartupKind(ShaderCache *cache);
+
+void ShaderCache_GetStats(ShaderCache *cache, ShaderCacheStats *stats);
+void ShaderCache_LogStats(ShaderCache *cache);
+
+#endif /* SHADER_MODULE_H */
@@ -0,0 +1,52 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdint.h>
+
+#include <SDL.h>
+
+/* What the SSE2 and AVX2 CPU kernels (cpu_sim.c, force_field.c,
+ * particle_mesh.c) share.
+ *
+ * Each kernel is compiled for its instruction set with SIMD_TARGET_SSE2 or
+ * SIMD_TARGET_AVX2, whatever the rest of the file is built for, and picked
+ * at runtime from what the CPU supports. The AVX2 kernels deliberately do
+ * not use FMA: a fused multiply-add rounds once where the scalar and SSE2
+ * kernels round twice, and every width has to match the scalar reference.
+ */
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET_SSE2 __attribute__((target("sse2")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMD_TARGET_SSE2
+#define SIMD_TARGET_AVX2
+#endif
+
+/* The widest kernel this CPU runs, in floats (1, 4 or 8), up to
+ * maxVectorWidth
+ */
+static inline uint32_t Simd_ResolveVectorWidth(uint32_t maxVectorWidth)
+{
+#ifdef SIMD_X86
+	if (maxVectorWidth >= 8 && SDL_HasAVX2())
+	{
+		return 8;
+	}
+	if (maxVectorWidth >= 4 && SDL_HasSSE2())
+	{
+		return 4;
+	}
+#else
+	(void) maxVectorWidth;
+#endif
+	return 1;
+}
+
+#endif /* SIMD_H */
@@ -0,0 +1,574 @@
+#include "splat.h"
+
+#include <SDL.h>
+
+#include "bench.h"
+
+/* Particles binned per job; tile lists keep particle order within a chunk
+ * and chunks in order, so they come out sorted by particle index
+ */
+#define SPLAT_CHUNK_SIZE 16384
+
+/* A point covers at most 2x2 tiles */
+#define SPLAT_MAX_TILES_PER_POINT 4
+
+/* Tiles handed to a worker at a time */
+#define SPLAT_TILE_GRAIN 4
+
+typedef struct SplatPoint
+{
+	float x, y; /* center in window pixels */
+	float color[3];
+} SplatPoint;
+
+/* Inclusive pixel range a point covers, clipped to the image */
+typedef struct SplatRect
+{
+	int32_t x0, y0, x1, y1;
+} SplatRect;
+
+struct Splatter
+{
+	ThreadPool *pool;
+	uint32_t width;
+	uint32_t height;
+	uint32_t tilesX;
+	uint32_t tilesY;
+	uint32_t tileCount;
+	uint32_t capacity;
+	uint32_t chunkCapacity;
+
+	const SplatTexture *sprite;
+	float *spriteTexels; /* [height][width][3] */
+	float ramp[SPLAT_MAX_RAMP_WIDTH][3];
+	uint32_t rampWidth;
+
+	SplatPoint *points;    /* [capacity] */
+	uint32_t *chunkCounts; /* [chunkCapacity][tileCount], counts then write offsets */
+	uint32_t *tileStart;   /* [tileCount + 1] */
+	uint32_t *entries;     /* [capacity * SPLAT_MAX_TILES_PER_POINT] point indices */
+
+	SplatTimings timings;
+};
+
+typedef struct SplatJob
+{
+	Splatter *splatter;
+	const float *positions;
+	const float *gradientPositions;
+	uint32_t count;
+	uint8_t *rgba;
+} SplatJob;
+
+static void Splatter_ParallelFor(Splatter *splatter, uint32_t count, uint32_t grainSize, ThreadPoolRangeFunc func, void *userdata)
+{
+	if (splatter->pool == NULL)
+	{
+		func(userdata, 0, count);
+	}
+	else
+	{
+		ThreadPool_ParallelFor(splatter->pool, count, grainSize, func, userdata);
+	}
+}
+
+/* Shared by every path; splat.comp has the same functions */
+
+static float Splat_Lerp(float a, float b, float t)
+{
+	return a * (1.0f - t) + b * t;
+}
+
+static uint32_t Splat_Wrap(int32_t i, uint32_t size)
+{
+	int32_t wrapped = i % (int32_t) size;
+	return (uint32_t) ((wrapped < 0) ? (wrapped + (int32_t) size) : wrapped);
+}
+
+static void Splatter_RampColor(const Splatter *splatter, float gradientPosition, float color[3])
+{
+	float u = gradientPosition * (float) splatter->rampWidth - 0.5f;
+	float base = SDL_floorf(u);
+	float t = u - base;
+	uint32_t i0 = Splat_Wrap((int32_t) base, splatter->rampWidth);
+	uint32_t i1 = (i0 + 1) % splatter->rampWidth;
+	uint32_t c;
+
+	for (c = 0; c < 3; c += 1)
+	{
+		color[c] = Splat_Lerp(splatter->ramp[i0][c], splatter->ramp[i1][c], t);
+	}
+}
+
+static void Splatter_MakePoint(const Splatter *splatter, float x, float y, float gradientPosition, SplatPoint *point)
+{
+	point->x = (x + 1.0f) * 0.5f * (float) splatter->width;
+	point->y = (y + 1.0f) * 0.5f * (float) splatter->height;
+	Splatter_RampColor(splatter, gradientPosition, point->color);
+}
+
+/* The pixels whose centers fall inside the point's square */
+static bool Splatter_PointRect(const Splatter *splatter, const SplatPoint *point, SplatRect *rect)
+{
+	const float reach = SPLAT_POINT_SIZE * 0.5f + 0.5f;
+
+	/* Also rejects NaN */
+	if (!(point->x > -reach && point->x < (float) splatter->width + reach &&
+		point->y > -reach && point->y < (float) splatter->height + reach))
+	{
+		return false;
+	}
+
+	rect->x0 = (int32_t) SDL_ceilf(point->x - reach);
+	rect->y0 = (int32_t) SDL_ceilf(point->y - reach);
+	rect->x1 = SDL_min(rect->x0 + SPLAT_POINT_SIZE - 1, (int32_t) splatter->width - 1);
+	rect->y1 = SDL_min(rect->y0 + SPLAT_POINT_SIZE - 1, (int32_t) splatter->height - 1);
+	rect->x0 = SDL_max(rect->x0, 0);
+	rect->y0 = SDL_max(rect->y0, 0);
+
+	return rect->x0 <= rect->x1 && rect->y0 <= rect->y1;
+}
+
+/* particle.frag at one pixel: the sprite at gl_PointCoord times the ramp
+ * color, in fixed point
+ */
+static void Splatter_Contribution(
+	const Splatter *splatter,
+	const SplatPoint *point,
+	int32_t px,
+	int32_t py,
+	uint32_t contribution[3]
+) {
+	const SplatTexture *sprite = splatter->sprite;
+	float u = ((float) px + 0.5f - point->x) * (1.0f / SPLAT_POINT_SIZE) + 0.5f;
+	float v = ((float) py + 0.5f - point->y) * (1.0f / SPLAT_POINT_SIZE) + 0.5f;
+	float sx = u * (float) sprite->width - 0.5f;
+	float sy = v * (float) sprite->height - 0.5f;
+	float baseX = SDL_floorf(sx);
+	float baseY = SDL_floorf(sy);
+	float tx = sx - baseX;
+	float ty = sy - baseY;
+	uint32_t x0 = Splat_Wrap((int32_t) baseX, sprite->width);
+	uint32_t y0 = Splat_Wrap((int32_t) baseY, sprite->height);
+	uint32_t x1 = (x0 + 1) % sprite->width;
+	uint32_t y1 = (y0 + 1) % sprite->height;
+	const float *t00 = &splatter->spriteTexels[(y0 * sprite->width + x0) * 3];
+	const float *t10 = &splatter->spriteTexels[(y0 * sprite->width + x1) * 3];
+	const float *t01 = &splatter->spriteTexels[(y1 * sprite->width + x0) * 3];
+	const float *t11 = &splatter->spriteTexels[(y1 * sprite->width + x1) * 3];
+	uint32_t c;
+
+	for (c = 0; c < 3; c += 1)
+	{
+		float texel = Splat_Lerp(Splat_Lerp(t00[c], t10[c], tx), Splat_Lerp(t01[c], t11[c], tx), ty);
+		contribution[c] = (uint32_t) (texel * point->color[c] * (float) SPLAT_FIXED_SCALE + 0.5f);
+	}
+}
+
+static void Splat_Accumulate(uint32_t *sum, const uint32_t contribution[3])
+{
+	sum[0] = SDL_min(sum[0] + contribution[0], SPLAT_FIXED_SCALE);
+	sum[1] = SDL_min(sum[1] + contribution[1], SPLAT_FIXED_SCALE);
+	sum[2] = SDL_min(sum[2] + contribution[2], SPLAT_FIXED_SCALE);
+}
+
+/* Round to nearest, like a UNORM8 color target */
+static void Splat_StorePixel(const uint32_t *sum, uint8_t *pixel)
+{
+	pixel[0] = (uint8_t) ((sum[0] * 255u + SPLAT_FIXED_SCALE / 2) / SPLAT_FIXED_SCALE);
+	pixel[1] = (uint8_t) ((sum[1] * 255u + SPLAT_FIXED_SCALE / 2) / SPLAT_FIXED_SCALE);
+	pixel[2] = (uint8_t) ((sum[2] * 255u + SPLAT_FIXED_SCALE / 2) / SPLAT_FIXED_SCALE);
+	pixel[3] = 255;
+}
+
+/* Binning */
+
+static void Splatter_CountChunks(void *userdata, uint32_t start, uint32_t end)
+{
+	SplatJob *job = (SplatJob*) userdata;
+	Splatter *splatter = job->splatter;
+	SplatRect rect;
+	uint32_t chunk, i, first, last, tx, ty;
+
+	for (chunk = start; chunk < end; chunk += 1)
+	{
+		uint32_t *counts = &splatter->chunkCounts[(size_t) chunk * splatter->tileCount];
+
+		SDL_memset(counts, 0, sizeof(uint32_t) * splatter->tileCount);
+
+		first = chunk * SPLAT_CHUNK_SIZE;
+		last = SDL_min(first + SPLAT_CHUNK_SIZE, job->count);
+		for (i = first; i < last; i += 1)
+		{
+			SplatPoint *point = &splatter->points[i];
+
+			Splatter_MakePoint(
+				splatter,
+				job->positions[i * 2 + 0],
+				job->positions[i * 2 + 1],
+				job->gradientPositions[i],
+				point
+			);
+
+			if (!Splatter_PointRect(splatter, point, &rect))
+			{
+				continue;
+			}
+			for (ty = rect.y0 / SPLAT_TILE_SIZE; ty <= (uint32_t) rect.y1 / SPLAT_TILE_SIZE; ty += 1)
+			{
+				for (tx = rect.x0 / SPLAT_TILE_SIZE; tx <= (uint32_t) rect.x1 / SPLAT_TILE_SIZE; tx += 1)
+				{
+					counts[ty * splatter->tilesX + tx] += 1;
+				}
+			}
+		}
+	}
+}
+
+static void Splatter_ScatterChunks(void *userdata, uint32_t start, uint32_t end)
+{
+	SplatJob *job = (SplatJob*) userdata;
+	Splatter *splatter = job->splatter;
+	SplatRect rect;
+	uint32_t chunk, i, first, last, tx, ty;
+
+	for (chunk = start; chunk < end; chunk += 1)
+	{
+		uint32_t *offsets = &splatter->chunkCounts[(size_t) chunk * splatter->tileCount];
+
+		first = chunk * SPLAT_CHUNK_SIZE;
+		last = SDL_min(first + SPLAT_CHUNK_SIZE, job->count);
+		for (i = first; i < last; i += 1)
+		{
+			if (!Splatter_PointRect(splatter, &splatter->points[i], &rect))
+			{
+				continue;
+			}
+			for (ty = rect.y0 / SPLAT_TILE_SIZE; ty <= (uint32_t) rect.y1 / SPLAT_TILE_SIZE; ty += 1)
+			{
+				for (tx = rect.x0 / SPLAT_TILE_SIZE; tx <= (uint32_t) rect.x1 / SPLAT_TILE_SIZE; tx += 1)
+				{
+					splatter->entries[offsets[ty * splatter->tilesX + tx]++] = i;
+				}
+			}
+		}
+	}
+}
+
+/* Exclusive prefix sum in tile-major, chunk-minor order */
+static void Splatter_ScanChunks(Splatter *splatter, uint32_t chunkCount)
+{
+	uint32_t tile, chunk, count;
+	uint32_t running = 0;
+
+	for (tile = 0; tile < splatter->tileCount; tile += 1)
+	{
+		splatter->tileStart[tile] = running;
+		for (chunk = 0; chunk < chunkCount; chunk += 1)
+		{
+			uint32_t *slot = &splatter->chunkCounts[(size_t) chunk * splatter->tileCount + tile];
+			count = *slot;
+			*slot = running;
+			running += count;
+		}
+	}
+	splatter->tileStart[splatter->tileCount] = running;
+}
+
+/* Raster */
+
+static void Splatter_RasterTiles(void *userdata, uint32_t start, uint32_t end)
+{
+	SplatJob *job = (SplatJob*) userdata;
+	Splatter *splatter = job->splatter;
+	uint32_t sums[SPLAT_TILE_SIZE * SPLAT_TILE_SIZE * 3];
+	uint32_t contribution[3];
+	SplatRect rect;
+	uint32_t tile, entry;
+	int32_t tileX0, tileY0, tileX1, tileY1, x, y;
+
+	for (tile = start; tile < end; tile += 1)
+	{
+		tileX0 = (int32_t) ((tile % splatter->tilesX) * SPLAT_TILE_SIZE);
+		tileY0 = (int32_t) ((tile / splatter->tilesX) * SPLAT_TILE_SIZE);
+		tileX1 = SDL_min(tileX0 + SPLAT_TILE_SIZE, (int32_t) splatter->width) - 1;
+		tileY1 = SDL_min(tileY0 + SPLAT_TILE_SIZE, (int32_t) splatter->height) - 1;
+
+		SDL_memset(sums, 0, sizeof(sums));
+
+		for (entry = splatter->tileStart[tile]; entry < splatter->tileStart[tile + 1]; entry += 1)
+		{
+			const SplatPoint *point = &splatter->points[splatter->entries[entry]];
+
+			Splatter_PointRect(splatter, point, &rect);
+			for (y = SDL_max(rect.y0, tileY0); y <= SDL_min(rect.y1, tileY1); y += 1)
+			{
+				for (x = SDL_max(rect.x0, tileX0); x <= SDL_min(rect.x1, tileX1); x += 1)
+				{
+					Splatter_Contribution(splatter, point, x, y, contribution);
+					Splat_Accumulate(&sums[((y - tileY0) * SPLAT_TILE_SIZE + (x - tileX0)) * 3], contribution);
+				}
+			}
+		}
+
+		for (y = tileY0; y <= tileY1; y += 1)
+		{
+			for (x = tileX0; x <= tileX1; x += 1)
+			{
+				Splat_StorePixel(
+					&sums[((y - tileY0) * SPLAT_TILE_SIZE + (x - tileX0)) * 3],
+					&job->rgba[((size_t) y * splatter->width + x) * 4]
+				);
+			}
+		}
+	}
+}
+
+/* Public API */
+
+bool Splat_FillUniforms(
+	SplatUniforms *uniforms,
+	uint32_t width,
+	uint32_t height,
+	const SplatTexture *sprite,
+	const SplatTexture *ramp,
+	uint32_t particleCount
+) {
+	uint32_t i, c;
+
+	if (ramp->width > SPLAT_MAX_RAMP_WIDTH)
+	{
+		SDL_Log("Splat ramp is %u texels wide, at most %u are supported", ramp->width, SPLAT_MAX_RAMP_WIDTH);
+		return false;
+	}
+
+	SDL_zerop(uniforms);
+	uniforms->particleCount = particleCount;
+	uniforms->width = width;
+	uniforms->height = height;
+	uniforms->tilesX = (width + SPLAT_TILE_SIZE - 1) / SPLAT_TILE_SIZE;
+	uniforms->tileCount = uniforms->tilesX * ((height + SPLAT_TILE_SIZE - 1) / SPLAT_TILE_SIZE);
+	uniforms->spriteWidth = sprite->width;
+	uniforms->spriteHeight = sprite->height;
+	uniforms->rampWidth = ramp->width;
+
+	/* The ramp is sampled along its first row */
+	for (i = 0; i < ramp->width; i += 1)
+	{
+		for (c = 0; c < 4; c += 1)
+		{
+			uniforms->ramp[i][c] = ramp->pixels[i * 4 + c] / 255.0f;
+		}
+	}
+
+	return true;
+}
+
+Splatter* Splatter_Create(
+	uint32_t width,
+	uint32_t height,
+	const SplatTexture *sprite,
+	const SplatTexture *ramp,
+	uint32_t capacity,
+	ThreadPool *pool
+) {
+	SplatUniforms uniforms;
+	Splatter *splatter;
+	uint32_t i, c, texelCount;
+
+	if (!Splat_FillUniforms(&uniforms, width, height, sprite, ramp, capacity))
+	{
+		return NULL;
+	}
+
+	splatter = SDL_malloc(sizeof(Splatter));
+	SDL_zerop(splatter);
+
+	splatter->pool = pool;
+	splatter->width = width;
+	splatter->height = height;
+	splatter->tilesX = uniforms.tilesX;
+	splatter->tileCount = uniforms.tileCount;
+	splatter->tilesY = uniforms.tileCount / uniforms.tilesX;
+	splatter->capacity = capacity;
+	splatter->chunkCapacity = SDL_max((capacity + SPLAT_CHUNK_SIZE - 1) / SPLAT_CHUNK_SIZE, 1);
+	splatter->sprite = sprite;
+	splatter->rampWidth = ramp->width;
+
+	for (i = 0; i < ramp->width; i += 1)
+	{
+		for (c = 0; c < 3; c += 1)
+		{
+			splatter->ramp[i][c] = uniforms.ramp[i][c];
+		}
+	}
+
+	texelCount = sprite->width * sprite->height;
+	splatter->spriteTexels = SDL_malloc(sizeof(float) * 3 * texelCount);
+	for (i = 0; i < texelCount; i += 1)
+	{
+		for (c = 0; c < 3; c += 1)
+		{
+			splatter->spriteTexels[i * 3 + c] = sprite->pixels[i * 4 + c] / 255.0f;
+		}
+	}
+
+	splatter->points = SDL_malloc(sizeof(SplatPoint) * SDL_max(capacity, 1));
+	splatter->chunkCounts = SDL_malloc(sizeof(uint32_t) * splatter->tileCount * splatter->chunkCapacity);
+	splatter->tileStart = SDL_malloc(sizeof(uint32_t) * (splatter->tileCount + 1));
+	splatter->entries = SDL_malloc(sizeof(uint32_t) * SPLAT_MAX_TILES_PER_POINT * SDL_max(capacity, 1));
+
+	return splatter;
+}
+
+void Splatter_Destroy(Splatter *splatter)
+{
+	if (splatter == NULL)
+	{
+		return;
+	}
+
+	SDL_free(splatter->spriteTexels);
+	SDL_free(splatter->points);
+	SDL_free(splatter->chunkCounts);
+	SDL_free(splatter->tileStart);
+	SDL_free(splatter->entries);
+	SDL_free(splatter);
+}
+
+void Splatter_Render(
+	Splatter *splatter,
+	const float *positions,
+	const float *gradientPositions,
+	uint32_t count,
+	uint8_t *rgba
+) {
+	SplatJob job;
+	uint32_t chunkCount;
+	uint64_t start = Bench_Now();
+	uint64_t now;
+
+	count = SDL_min(count, splatter->capacity);
+	chunkCount = SDL_max((count + SPLAT_CHUNK_SIZE - 1) / SPLAT_CHUNK_SIZE, 1);
+
+	job.splatter = splatter;
+	job.positions = positions;
+	job.gradientPositions = gradientPositions;
+	job.count = count;
+	job.rgba = rgba;
+
+	Splatter_ParallelFor(splatter, chunkCount, 1, Splatter_CountChunks, &job);
+	Splatter_ScanChunks(splatter, chunkCount);
+	Splatter_ParallelFor(splatter, chunkCount, 1, Splatter_ScatterChunks, &job);
+
+	now = Bench_Now();
+	splatter->timings.binSeconds += Bench_Seconds(start, now);
+	start = now;
+
+	/* Every chunk's offsets now end where the next chunk's begin, and the
+	 * tile starts are unchanged
+	 */
+	Splatter_ParallelFor(splatter, splatter->tileCount, SPLAT_TILE_GRAIN, Splatter_RasterTiles, &job);
+
+	splatter->timings.rasterSeconds += Bench_Seconds(start, Bench_Now());
+	splatter->timings.frameCount += 1;
+}
+
+void Splatter_RenderReference(
+	Splatter *splatter,
+	const float *positions,
+	const float *gradientPositions,
+	uint32_t count,
+	uint8_t *rgba
+) {
+	uint32_t *sums = SDL_calloc((size_t) splatter->width * splatter->height * 3, sizeof(uint32_t));
+	uint32_t contribution[3];
+	SplatPoint point;
+	SplatRect rect;
+	uint32_t i, pixel, pixelCount = splatter->width * splatter->height;
+	int32_t x, y;
+
+	for (i = 0; i < count; i += 1)
+	{
+		Splatter_MakePoint(splatter, positions[i * 2 + 0], positions[i * 2 + 1], gradientPositions[i], &point);
+		if (!Splatter_PointRect(splatter, &point, &rect))
+		{
+			continue;
+		}
+
+		for (y = rect.y0; y <= rect.y1; y += 1)
+		{
+			for (x = rect.x0; x <= rect.x1; x += 1)
+			{
+				Splatter_Contribution(splatter, &point, x, y, contribution);
+				Splat_Accumulate(&sums[((size_t) y * splatter->width + x) * 3], contribution);
+			}
+		}
+	}
+
+	for (pixel = 0; pixel < pixelCount; pixel += 1)
+	{
+		Splat_StorePixel(&sums[(size_t) pixel * 3], &rgba[(size_t) pixel * 4]);
+	}
+
+	SDL_free(sums);
+}
+
+void Splatter_GetTimings(Splatter *splatter, SplatTimings *timings)
+{
+	*timings = splatter->timings;
+}
+
+void Splatter_LogTimings(Splatter *splatter)
+{
+	const SplatTimings *timings = &splatter->timings;
+	double scale = (timings->frameCount > 0) ? (1000.0 / timings->frameCount) : 0.0;
+
+	SDL_Log(
+		"Splat: %ux%u in %ux%u tiles, %u frames, bin %.3f ms  raster %.3f ms per frame",
+		splatter->width,
+		splatter->height,
+		splatter->tilesX,
+		splatter->tilesY,
+		timings->frameCount,
+		timings->binSeconds * scale,
+		timings->rasterSeconds * scale
+	);
+}
+
+bool Splat_CompareImages(
+	const uint8_t *expected,
+	const uint8_t *actual,
+	uint32_t pixelCount,
+	uint32_t tolerance,
+	SplatCompareReport *report
+) {
+	uint32_t pixel, c, difference, worst;
+	double squares = 0.0;
+
+	report->pixelCount = pixelCount;
+	report->differentCount = 0;
+	report->maxDifference = 0;
+
+	for (pixel = 0; pixel < pixelCount; pixel += 1)
+	{
+		worst = 0;
+		for (c = 0; c < 3; c += 1)
+		{
+			int32_t delta = (int32_t) expected[pixel * 4 + c] - (int32_t) actual[pixel * 4 + c];
+			difference = (uint32_t) ((delta < 0) ? -delta : delta);
+			squares += (double) difference * difference;
+			worst = SDL_max(worst, difference);
+		}
+
+		report->maxDifference = SDL_max(report->maxDifference, worst);
+		if (worst > tolerance)
+		{
+			report->differentCount += 1;
+		}
+	}
+
+	report->psnr = (squares > 0.0) ? 10.0 * SDL_log10(255.0 * 255.0 * 3.0 * pixelCount / squares) : 0.0;
+
+	return report->differentCount == 0;
+}
@@ -0,0 +1,149 @@
+#ifndef SPLAT_H
+#define SPLAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "thread_pool.h"
+
+/* Tiled particle splatting, the compute alternative to drawing every
+ * particle as a blended point sprite.
+ *
+ * Each particle covers the same SPLAT_POINT_SIZE square of pixels the
+ * rasterizer gives particle.vert's point, and adds the sprite texel times
+ * its gradient ramp color to each of them, like particle.frag with
+ * additive blending. Instead of blending fragments one at a time, the
+ * particles are binned into SPLAT_TILE_SIZE square screen tiles (a counting
+ * sort: per-tile counts, an exclusive prefix sum into tile ranges, then a
+ * scatter) and every tile sums the contributions to its pixels at once.
+ *
+ * Contributions are rounded to SPLAT_FIXED_SCALE fixed point and summed as
+ * integers that saturate at 1.0, so a pixel does not depend on the order
+ * particles arrive in. The threaded tiled path and the one-particle-at-a-
+ * time reference therefore match bit for bit however the work is split.
+ * splat.comp uses the same formulas and differs from them only by GPU float
+ * rounding. The rasterized point sprites differ a little more, as texture
+ * filtering and blending round to fewer bits.
+ */
+
+#define SPLAT_POINT_SIZE 8 /* gl_PointSize in particle.vert */
+#define SPLAT_TILE_SIZE 16 /* one splat.comp workgroup per tile */
+#define SPLAT_FIXED_SCALE 65536
+#define SPLAT_MAX_RAMP_WIDTH 32
+
+/* The window's color target in main.c, which splat_resolve.vert assumes too */
+#define SPLAT_IMAGE_WIDTH 1280
+#define SPLAT_IMAGE_HEIGHT 720
+
+/* The textures particle.frag samples */
+#define SPLAT_SPRITE_TEXTURE "particle01_rgba.png"
+#define SPLAT_RAMP_TEXTURE "particle_gradient_rgba.png"
+
+/* Largest per-channel difference, in 8 bit levels, Splat_CompareImages
+ * accepts against an image from another renderer
+ */
+#define SPLAT_COMPARE_TOLERANCE 2
+
+/* Level 0 of an R8G8B8A8 texture; sampled bilinearly with repeat, as the
+ * main sampler does
+ */
+typedef struct SplatTexture
+{
+	const uint8_t *pixels;
+	uint32_t width;
+	uint32_t height;
+} SplatTexture;
+
+/* Matches the UBO block in splat.comp (std140) */
+typedef struct SplatUniforms
+{
+	uint32_t particleCount;
+	uint32_t width;
+	uint32_t height;
+	uint32_t tilesX;
+	uint32_t tileCount;
+	uint32_t spriteWidth;
+	uint32_t spriteHeight;
+	uint32_t rampWidth;
+	float ramp[SPLAT_MAX_RAMP_WIDTH][4];
+} SplatUniforms;
+
+typedef struct SplatTimings
+{
+	uint32_t frameCount;
+	double binSeconds;    /* screen positions, colors, tile counts and scatter */
+	double rasterSeconds; /* per-tile sums into the image */
+} SplatTimings;
+
+typedef struct SplatCompareReport
+{
+	uint32_t pixelCount;
+	uint32_t differentCount; /* pixels with any channel off by more than the tolerance */
+	uint32_t maxDifference;
+	double psnr; /* dB, 0 for identical images */
+} SplatCompareReport;
+
+/* Returns false if the ramp is wider than SPLAT_MAX_RAMP_WIDTH */
+bool Splat_FillUniforms(
+	SplatUniforms *uniforms,
+	uint32_t width,
+	uint32_t height,
+	const SplatTexture *sprite,
+	const SplatTexture *ramp,
+	uint32_t particleCount
+);
+
+typedef struct Splatter Splatter;
+
+/* Renders width x height images of up to capacity particles. The textures
+ * must outlive the splatter. pool may be NULL. Returns NULL if the ramp is
+ * too wide.
+ */
+Splatter* Splatter_Create(
+	uint32_t width,
+	uint32_t height,
+	const SplatTexture *sprite,
+	const SplatTexture *ramp,
+	uint32_t capacity,
+	ThreadPool *pool
+);
+void Splatter_Destroy(Splatter *splatter);
+
+/* Renders count particles from their render streams (xy position pairs and
+ * gradients, as CPUSim_GetRenderStreams writes them) into rgba, which holds
+ * width * height R8G8B8A8 pixels. Tiles run in parallel on the pool.
+ */
+void Splatter_Render(
+	Splatter *splatter,
+	const float *positions,
+	const float *gradientPositions,
+	uint32_t count,
+	uint8_t *rgba
+);
+
+/* The same image one particle at a time on the calling thread, with no
+ * binning
+ */
+void Splatter_RenderReference(
+	Splatter *splatter,
+	const float *positions,
+	const float *gradientPositions,
+	uint32_t count,
+	uint8_t *rgba
+);
+
+void Splatter_GetTimings(Splatter *splatter, SplatTimings *timings);
+void Splatter_LogTimings(Splatter *splatter);
+
+/* Returns true if no channel of any pixel differs by more than tolerance;
+ * alpha is ignored
+ */
+bool Splat_CompareImages(
+	const uint8_t *expected,
+	const uint8_t *actual,
+	uint32_t pixelCount,
+	uint32_t tolerance,
+	SplatCompareReport *report
+);
+
+#endif /* SPLAT_H */
@@ -0,0 +1,232 @@
+#include "splat_gpu.h"
+
+#include <SDL.h>
+
+#include "compute_pass.h"
+
+typedef enum SplatPassType
+{
+	SPLAT_PASS_CLEAR,
+	SPLAT_PASS_BIN,
+	SPLAT_PASS_SCAN,
+	SPLAT_PASS_SCATTER,
+	SPLAT_PASS_RASTER,
+	SPLAT_PASS_TYPE_COUNT
+} SplatPassType;
+
+/* struct SplatPoint in splat.comp */
+#define SPLAT_GPU_POINT_SIZE (sizeof(float) * 8)
+
+struct SplatGPU
+{
+	SplatUniforms uniforms;
+
+	REFRESH_Buffer *tileStart;
+	REFRESH_Buffer *points;
+	REFRESH_Buffer *ranks;
+	REFRESH_Buffer *entries;
+	REFRESH_Buffer *sprite;
+	REFRESH_Buffer *image;
+
+	ComputePass passes[SPLAT_PASS_TYPE_COUNT];
+};
+
+static const char* SplatGPU_GetShaderPath(SplatPassType type, ParticleLayout layout)
+{
+	switch (type)
+	{
+	case SPLAT_PASS_CLEAR:
+		return "splat_clear.comp.spv";
+	case SPLAT_PASS_BIN:
+		switch (layout)
+		{
+		case PARTICLE_LAYOUT_SPLIT:
+			return "splat_split_bin.comp.spv";
+		case PARTICLE_LAYOUT_QUANTIZED:
+			return "splat_quantized_bin.comp.spv";
+		default:
+			return "splat_bin.comp.spv";
+		}
+	case SPLAT_PASS_SCAN:
+		return "splat_scan.comp.spv";
+	case SPLAT_PASS_SCATTER:
+		return "splat_scatter.comp.spv";
+	case SPLAT_PASS_RASTER:
+		return "splat_raster.comp.spv";
+	default:
+		return NULL;
+	}
+}
+
+SplatGPU* SplatGPU_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ParticleBuffers *particleBuffers,
+	uint32_t width,
+	uint32_t height,
+	const SplatTexture *sprite,
+	const SplatTexture *ramp
+) {
+	uint32_t i;
+	uint32_t particleCount = particleBuffers->particleCount;
+	SplatGPU *splatGPU = SDL_malloc(sizeof(SplatGPU));
+
+	SDL_zerop(splatGPU);
+
+	if (!Splat_FillUniforms(&splatGPU->uniforms, width, height, sprite, ramp, particleCount))
+	{
+		SDL_free(splatGPU);
+		return NULL;
+	}
+
+	splatGPU->tileStart = REFRESH_CreateBuffer(
+		device,
+		REFRESH_BUFFERUSAGE_COMPUTE_BIT,
+		sizeof(uint32_t) * (splatGPU->uniforms.tileCount + 1)
+	);
+	splatGPU->points = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, SPLAT_GPU_POINT_SIZE * particleCount);
+	splatGPU->ranks = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, sizeof(uint32_t) * 4 * particleCount);
+	splatGPU->entries = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, sizeof(uint32_t) * 4 * particleCount);
+	splatGPU->sprite = REFRESH_CreateBuffer(device, REFRESH_BUFFERUSAGE_COMPUTE_BIT, sizeof(uint32_t) * sprite->width * sprite->height);
+	splatGPU->image = REFRESH_CreateBuffer(
+		device,
+		REFRESH_BUFFERUSAGE_VERTEX_BIT | REFRESH_BUFFERUSAGE_COMPUTE_BIT,
+		sizeof(uint32_t) * width * height
+	);
+
+	/* R8G8B8A8 bytes read as little-endian words are what unpackUnorm4x8 expects */
+	REFRESH_SetBufferData(device, splatGPU->sprite, 0, (void*) sprite->pixels, sizeof(uint32_t) * sprite->width * sprite->height);
+
+	/* The split layout keeps gradients in their own stream; the others have
+	 * nothing at binding 1 and rebind the particle buffer there.
+	 */
+	REFRESH_Buffer *particles = particleBuffers->buffers[0];
+	REFRESH_Buffer *gradients = (particleBuffers->layout == PARTICLE_LAYOUT_SPLIT) ?
+		particleBuffers->buffers[2] :
+		particleBuffers->buffers[0];
+
+	REFRESH_Buffer *clearBindings[] = { splatGPU->tileStart };
+	REFRESH_Buffer *binBindings[] = {
+		particles,
+		gradients,
+		splatGPU->tileStart,
+		splatGPU->points,
+		splatGPU->ranks
+	};
+	REFRESH_Buffer *scatterBindings[] = {
+		splatGPU->points,
+		splatGPU->tileStart,
+		splatGPU->ranks,
+		splatGPU->entries
+	};
+	REFRESH_Buffer *rasterBindings[] = {
+		splatGPU->points,
+		splatGPU->tileStart,
+		splatGPU->entries,
+		splatGPU->sprite,
+		splatGPU->image
+	};
+
+	REFRESH_Buffer **bindings[SPLAT_PASS_TYPE_COUNT] = {
+		clearBindings,
+		binBindings,
+		clearBindings,
+		scatterBindings,
+		rasterBindings
+	};
+	uint32_t bindingCounts[SPLAT_PASS_TYPE_COUNT] = {
+		SDL_arraysize(clearBindings),
+		SDL_arraysize(binBindings),
+		SDL_arraysize(clearBindings),
+		SDL_arraysize(scatterBindings),
+		SDL_arraysize(rasterBindings)
+	};
+
+	for (i = 0; i < SPLAT_PASS_TYPE_COUNT; i += 1)
+	{
+		const char *shaderPath = SplatGPU_GetShaderPath((SplatPassType) i, particleBuffers->layout);
+
+		if (!ComputePass_Create(device, shaderCache, &splatGPU->passes[i], shaderPath, sizeof(SplatUniforms), bindings[i], bindingCounts[i]))
+		{
+			SplatGPU_Destroy(device, splatGPU);
+			return NULL;
+		}
+	}
+
+	return splatGPU;
+}
+
+void SplatGPU_Destroy(REFRESH_Device *device, SplatGPU *splatGPU)
+{
+	uint32_t i;
+
+	if (splatGPU == NULL)
+	{
+		return;
+	}
+
+	for (i = 0; i < SPLAT_PASS_TYPE_COUNT; i += 1)
+	{
+		ComputePass_Destroy(device, &splatGPU->passes[i]);
+	}
+
+	REFRESH_AddDisposeBuffer(device, splatGPU->tileStart);
+	REFRESH_AddDisposeBuffer(device, splatGPU->points);
+	REFRESH_AddDisposeBuffer(device, splatGPU->ranks);
+	REFRESH_AddDisposeBuffer(device, splatGPU->entries);
+	REFRESH_AddDisposeBuffer(device, splatGPU->sprite);
+	REFRESH_AddDisposeBuffer(device, splatGPU->image);
+	SDL_free(splatGPU);
+}
+
+void SplatGPU_Record(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	SplatGPU *splatGPU,
+	uint32_t particleCount
+) {
+	SplatUniforms *uniforms = &splatGPU->uniforms;
+	ComputePass *passes = splatGPU->passes;
+	uint32_t particleGroupCount = (particleCount + 255) / 256;
+	uint32_t clearGroupCount = (uniforms->tileCount + 1 + 255) / 256;
+
+	uniforms->particleCount = particleCount;
+
+	ComputePass_Record(device, commandBuffer, &passes[SPLAT_PASS_CLEAR], uniforms, clearGroupCount);
+	ComputePass_Record(device, commandBuffer, &passes[SPLAT_PASS_BIN], uniforms, particleGroupCount);
+	ComputePass_Record(device, commandBuffer, &passes[SPLAT_PASS_SCAN], uniforms, 1);
+	ComputePass_Record(device, commandBuffer, &passes[SPLAT_PASS_SCATTER], uniforms, particleGroupCount);
+	ComputePass_Record(device, commandBuffer, &passes[SPLAT_PASS_RASTER], uniforms, uniforms->tileCount);
+}
+
+REFRESH_Buffer* SplatGPU_GetImageBuffer(SplatGPU *splatGPU)
+{
+	return splatGPU->image;
+}
+
+uint32_t SplatGPU_GetPixelCount(SplatGPU *splatGPU)
+{
+	return splatGPU->uniforms.width * splatGPU->uniforms.height;
+}
+
+void SplatGPU_GetVertexInput(ParticleVertexInput *vertexInput)
+{
+	vertexInput->bindings[0].binding = 0;
+	vertexInput->bindings[0].inputRate = REFRESH_VERTEXINPUTRATE_VERTEX;
+	vertexInput->bindings[0].stride = sizeof(uint32_t);
+
+	vertexInput->attributes[0].binding = 0;
+	vertexInput->attributes[0].location = 0;
+	vertexInput->attributes[0].format = REFRESH_VERTEXELEMENTFORMAT_COLOR;
+	vertexInput->attributes[0].offset = 0;
+
+	vertexInput->state.vertexBindings = vertexInput->bindings;
+	vertexInput->state.vertexBindingCount = 1;
+	vertexInput->state.vertexAttributes = vertexInput->attributes;
+	vertexInput->state.vertexAttributeCount = 1;
+}
+
+void SplatGPU_Download(REFRESH_Device *device, SplatGPU *splatGPU, uint8_t *rgba)
+{
+	REFRESH_GetBufferData(device, splatGPU->image, rgba, sizeof(uint32_t) * SplatGPU_GetPixelCount(splatGPU));
+}
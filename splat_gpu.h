@@ -0,0 +1,57 @@
+#ifndef SPLAT_GPU_H
+#define SPLAT_GPU_H
+
+#include <Refresh.h>
+
+#include "particle_buffers.h"
+#include "shader_module.h"
+#include "splat.h"
+
+/* The splat.comp passes, the GPU counterpart of Splatter.
+ *
+ * Recording a frame clears the tile counts, bins every particle (its
+ * screen position and ramp color, and its slot in each tile it touches),
+ * scans the counts into tile ranges, scatters particle indices into the
+ * ranges and sums each tile's pixels. Refresh has no storage images, so the
+ * result lands in a buffer of R8G8B8A8 pixels that the resolve pipeline
+ * (splat_resolve.vert/.frag) draws into the color target as one point per
+ * pixel.
+ */
+
+typedef struct SplatGPU SplatGPU;
+
+/* Renders width x height images of the particles in particleBuffers. The
+ * sprite is uploaded once and the ramp goes into the uniforms, so neither
+ * needs to outlive the call. Returns NULL if a shader could not be loaded
+ * or the ramp is too wide.
+ */
+SplatGPU* SplatGPU_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ParticleBuffers *particleBuffers,
+	uint32_t width,
+	uint32_t height,
+	const SplatTexture *sprite,
+	const SplatTexture *ramp
+);
+void SplatGPU_Destroy(REFRESH_Device *device, SplatGPU *splatGPU);
+
+/* Five dispatches; must be recorded outside a render pass */
+void SplatGPU_Record(
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	SplatGPU *splatGPU,
+	uint32_t particleCount
+);
+
+/* The resolve draw's vertex buffer and vertex count */
+REFRESH_Buffer* SplatGPU_GetImageBuffer(SplatGPU *splatGPU);
+uint32_t SplatGPU_GetPixelCount(SplatGPU *splatGPU);
+
+/* One R8G8B8A8 color per vertex at location 0, for splat_resolve.vert */
+void SplatGPU_GetVertexInput(ParticleVertexInput *vertexInput);
+
+/* Reads the last image back into rgba; the frame must have completed */
+void SplatGPU_Download(REFRESH_Device *device, SplatGPU *splatGPU, uint8_t *rgba);
+
+#endif /* SPLAT_GPU_H */
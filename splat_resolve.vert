@@ -0,0 +1,27 @@
+// Draws the image splat.comp accumulated into the color target, one
+// unblended point per pixel: Refresh has no storage images to write it
+// directly. The size is the window's in main.c.
+#version 450
+
+#define WIDTH 1280
+#define HEIGHT 720
+
+layout (location = 0) in vec4 inColor;
+
+layout (location = 0) out vec4 outColor;
+
+out gl_PerVertex
+{
+	vec4 gl_Position;
+	float gl_PointSize;
+};
+
+void main ()
+{
+  uint pixel = uint(gl_VertexIndex);
+  vec2 center = vec2(pixel % WIDTH, pixel / WIDTH) + 0.5;
+
+  gl_PointSize = 1.0;
+  outColor = inColor;
+  gl_Position = vec4(center / vec2(WIDTH, HEIGHT) * 2.0 - 1.0, 1.0, 1.0);
+}
@@ -0,0 +1,148 @@
+#include "texture_bundle.h"
+
+#include <SDL.h>
+
+#include "file_map.h"
+
+struct TextureBundle
+{
+	FileMap map;
+
+	const TextureBundleEntry *entries;
+	uint32_t entryCount;
+};
+
+static bool TextureBundle_Validate(TextureBundle *bundle)
+{
+	const TextureBundleHeader *header = (const TextureBundleHeader*) bundle->map.data;
+	uint64_t tableEnd;
+	uint32_t i, level;
+
+	if (bundle->map.size < sizeof(TextureBundleHeader) ||
+		header->magic != TEXTURE_BUNDLE_MAGIC ||
+		header->version != TEXTURE_BUNDLE_VERSION)
+	{
+		return false;
+	}
+
+	tableEnd = sizeof(TextureBundleHeader) + (uint64_t) header->entryCount * sizeof(TextureBundleEntry);
+	if (tableEnd > bundle->map.size)
+	{
+		return false;
+	}
+
+	bundle->entries = (const TextureBundleEntry*) (bundle->map.data + sizeof(TextureBundleHeader));
+	bundle->entryCount = header->entryCount;
+
+	for (i = 0; i < bundle->entryCount; i += 1)
+	{
+		const TextureBundleEntry *entry = &bundle->entries[i];
+
+		if (entry->name[TEXTURE_BUNDLE_NAME_LENGTH - 1] != '\0' ||
+			entry->format != TEXTURE_BUNDLE_FORMAT_RGBA8 ||
+			entry->width == 0 ||
+			entry->height == 0 ||
+			entry->levelCount == 0 ||
+			entry->levelCount > TEXTURE_BUNDLE_MAX_LEVELS)
+		{
+			return false;
+		}
+
+		for (level = 0; level < entry->levelCount; level += 1)
+		{
+			uint64_t offset = entry->levelOffset[level];
+			uint32_t size = TextureBundle_LevelSize(entry->format, entry->width, entry->height, level);
+
+			if ((offset % TEXTURE_BUNDLE_ALIGNMENT) != 0 ||
+				offset < tableEnd ||
+				offset + size > bundle->map.size)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/* Public API */
+
+TextureBundle* TextureBundle_Open(const char *path)
+{
+	TextureBundle *bundle = SDL_malloc(sizeof(TextureBundle));
+
+	SDL_zerop(bundle);
+
+	if (!FileMap_Open(&bundle->map, path))
+	{
+		SDL_free(bundle);
+		return NULL;
+	}
+
+	if (!TextureBundle_Validate(bundle))
+	{
+		SDL_Log("%s is not a version %u texture bundle, ignoring it", path, TEXTURE_BUNDLE_VERSION);
+		TextureBundle_Close(bundle);
+		return NULL;
+	}
+
+	return bundle;
+}
+
+void TextureBundle_Close(TextureBundle *bundle)
+{
+	if (bundle == NULL)
+	{
+		return;
+	}
+
+	FileMap_Close(&bundle->map);
+	SDL_free(bundle);
+}
+
+const TextureBundleEntry* TextureBundle_Find(TextureBundle *bundle, const char *name)
+{
+	uint32_t i;
+
+	for (i = 0; i < bundle->entryCount; i += 1)
+	{
+		if (SDL_strcmp(bundle->entries[i].name, name) == 0)
+		{
+			return &bundle->entries[i];
+		}
+	}
+
+	return NULL;
+}
+
+const uint8_t* TextureBundle_GetLevel(
+	TextureBundle *bundle,
+	const TextureBundleEntry *entry,
+	uint32_t level,
+	uint32_t *size
+) {
+	*size = TextureBundle_LevelSize(entry->format, entry->width, entry->height, level);
+	return bundle->map.data + entry->levelOffset[level];
+}
+
+void TextureBundle_Prefetch(TextureBundle *bundle, const TextureBundleEntry *entry)
+{
+	uint32_t level;
+
+	for (level = 0; level < entry->levelCount; level += 1)
+	{
+		FileMap_Prefetch(
+			&bundle->map,
+			entry->levelOffset[level],
+			TextureBundle_LevelSize(entry->format, entry->width, entry->height, level)
+		);
+	}
+}
+
+uint32_t TextureBundle_LevelSize(uint32_t format, uint32_t width, uint32_t height, uint32_t level)
+{
+	uint32_t levelWidth = SDL_max(width >> level, 1);
+	uint32_t levelHeight = SDL_max(height >> level, 1);
+
+	return levelWidth * levelHeight * 4;
+}
@@ -0,0 +1,74 @@
+#ifndef TEXTURE_BUNDLE_H
+#define TEXTURE_BUNDLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Textures decoded ahead of time, written at build time by the
+ * BakeTextures target and memory-mapped at startup. Every mip level is
+ * stored as raw texels ready to hand to REFRESH_SetTextureData, so loading
+ * a texture is faulting in its pages rather than decoding a PNG.
+ *
+ * Layout: a TextureBundleHeader, entryCount TextureBundleEntry records,
+ * then the texels of every level at its offset, each aligned to
+ * TEXTURE_BUNDLE_ALIGNMENT bytes so a level starts on its own page. All
+ * fields are little endian.
+ */
+
+#define TEXTURE_BUNDLE_MAGIC 0x42585452 /* "RTXB" */
+#define TEXTURE_BUNDLE_VERSION 1
+#define TEXTURE_BUNDLE_NAME_LENGTH 48
+#define TEXTURE_BUNDLE_MAX_LEVELS 16
+#define TEXTURE_BUNDLE_ALIGNMENT 4096
+
+/* Texel formats, only what the program samples today */
+#define TEXTURE_BUNDLE_FORMAT_RGBA8 0
+
+typedef struct TextureBundleHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t reserved;
+} TextureBundleHeader;
+
+typedef struct TextureBundleEntry
+{
+	char name[TEXTURE_BUNDLE_NAME_LENGTH]; /* file name the image was baked from, NUL terminated */
+	uint32_t format;
+	uint32_t width;                        /* of level 0 */
+	uint32_t height;
+	uint32_t levelCount;                   /* each level halves both sides, down to 1 */
+	uint32_t levelOffset[TEXTURE_BUNDLE_MAX_LEVELS]; /* from the start of the file */
+} TextureBundleEntry;
+
+typedef struct TextureBundle TextureBundle;
+
+/* Returns NULL without logging if the file does not exist, and logs if it
+ * exists but is not a valid bundle.
+ */
+TextureBundle* TextureBundle_Open(const char *path);
+void TextureBundle_Close(TextureBundle *bundle);
+
+/* Finds an entry by file name, NULL if the bundle does not have it */
+const TextureBundleEntry* TextureBundle_Find(TextureBundle *bundle, const char *name);
+
+/* Texels of one level. Points into the mapping and stays valid until the
+ * bundle is closed.
+ */
+const uint8_t* TextureBundle_GetLevel(
+	TextureBundle *bundle,
+	const TextureBundleEntry *entry,
+	uint32_t level,
+	uint32_t *size
+);
+
+/* Faults in every page of an entry so a later upload does not stall on
+ * the disk. Meant for a worker thread.
+ */
+void TextureBundle_Prefetch(TextureBundle *bundle, const TextureBundleEntry *entry);
+
+/* Bytes in one level of a width x height texture */
+uint32_t TextureBundle_LevelSize(uint32_t format, uint32_t width, uint32_t height, uint32_t level);
+
+#endif /* TEXTURE_BUNDLE_H */
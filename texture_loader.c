@@ -0,0 +1,310 @@
+#include "texture_loader.h"
+
+#include <SDL.h>
+#include <Refresh_Image.h>
+
+#include "bench.h"
+#include "texture_bundle.h"
+#include "trace.h"
+
+typedef struct LoadedTexture
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	const uint8_t *levels[TEXTURE_BUNDLE_MAX_LEVELS];
+	uint32_t levelSizes[TEXTURE_BUNDLE_MAX_LEVELS];
+	uint8_t *decoded; /* REFRESH_Image_Load result when not from the bundle */
+	bool bundled;
+	double loadSeconds;
+} LoadedTexture;
+
+struct TextureLoader
+{
+	const char *bundlePath;
+	const char **names;
+	uint32_t count;
+
+	TextureBundle *bundle;
+	LoadedTexture *textures;
+	double openSeconds;
+
+	/* One or the other does the loading */
+	SDL_Thread *thread;
+	JobSystem *jobs;
+	Job **loadJobs;
+};
+
+typedef struct TextureLoadJob
+{
+	TextureLoader *loader;
+	uint32_t index;
+} TextureLoadJob;
+
+static void TextureLoader_OpenBundle(void *data)
+{
+	TextureLoader *loader = (TextureLoader*) data;
+	uint64_t start = Bench_Now();
+
+	TRACE_BEGIN(openScope, "open texture bundle");
+	loader->bundle = TextureBundle_Open(loader->bundlePath);
+	loader->openSeconds = Bench_Seconds(start, Bench_Now());
+	TRACE_END(openScope);
+}
+
+static void TextureLoader_LoadOne(TextureLoader *loader, uint32_t index)
+{
+	LoadedTexture *texture = &loader->textures[index];
+	const TextureBundleEntry *entry = NULL;
+	int32_t width, height, channelCount;
+	uint32_t level;
+	uint64_t start = Bench_Now();
+
+	TRACE_BEGIN(loadScope, "load texture");
+
+	if (loader->bundle != NULL)
+	{
+		entry = TextureBundle_Find(loader->bundle, loader->names[index]);
+	}
+
+	if (entry != NULL)
+	{
+		TextureBundle_Prefetch(loader->bundle, entry);
+
+		texture->width = entry->width;
+		texture->height = entry->height;
+		texture->levelCount = entry->levelCount;
+		for (level = 0; level < entry->levelCount; level += 1)
+		{
+			texture->levels[level] = TextureBundle_GetLevel(loader->bundle, entry, level, &texture->levelSizes[level]);
+		}
+
+		texture->bundled = true;
+	}
+	else
+	{
+		/* Refresh_Image always hands back four channels */
+		texture->decoded = REFRESH_Image_Load(loader->names[index], &width, &height, &channelCount);
+		if (texture->decoded != NULL)
+		{
+			texture->width = (uint32_t) width;
+			texture->height = (uint32_t) height;
+			texture->levelCount = 1;
+			texture->levels[0] = texture->decoded;
+			texture->levelSizes[0] = texture->width * texture->height * 4;
+		}
+	}
+
+	texture->loadSeconds = Bench_Seconds(start, Bench_Now());
+	TRACE_END(loadScope);
+}
+
+static void TextureLoader_LoadJob(void *data)
+{
+	TextureLoadJob *job = (TextureLoadJob*) data;
+
+	TextureLoader_LoadOne(job->loader, job->index);
+}
+
+static int TextureLoader_WorkerMain(void *data)
+{
+	TextureLoader *loader = (TextureLoader*) data;
+	uint32_t i;
+
+	if (loader->bundlePath != NULL)
+	{
+		TextureLoader_OpenBundle(loader);
+	}
+
+	for (i = 0; i < loader->count; i += 1)
+	{
+		TextureLoader_LoadOne(loader, i);
+	}
+
+	return 0;
+}
+
+static void TextureLoader_StartJobs(TextureLoader *loader)
+{
+	TextureLoadJob *loadJobs = (TextureLoadJob*) (loader->loadJobs + loader->count);
+	Job *openJob = NULL;
+	uint32_t i;
+
+	if (loader->bundlePath != NULL)
+	{
+		openJob = JobSystem_Add(loader->jobs, "open texture bundle", TextureLoader_OpenBundle, loader, NULL, 0);
+	}
+
+	for (i = 0; i < loader->count; i += 1)
+	{
+		loadJobs[i].loader = loader;
+		loadJobs[i].index = i;
+		loader->loadJobs[i] = JobSystem_Add(loader->jobs, "load texture", TextureLoader_LoadJob, &loadJobs[i], &openJob, 1);
+	}
+
+	JobSystem_Release(loader->jobs, openJob);
+}
+
+/* Public API */
+
+TextureLoader* TextureLoader_Start(
+	const char *bundlePath,
+	const char **names,
+	uint32_t count,
+	JobSystem *jobs
+) {
+	TextureLoader *loader = SDL_malloc(sizeof(TextureLoader));
+
+	SDL_zerop(loader);
+	loader->bundlePath = bundlePath;
+	loader->names = names;
+	loader->count = count;
+	loader->textures = SDL_calloc(count, sizeof(LoadedTexture));
+
+	if (jobs != NULL)
+	{
+		/* The handles, then what each job loads */
+		loader->jobs = jobs;
+		loader->loadJobs = SDL_malloc((sizeof(Job*) + sizeof(TextureLoadJob)) * count);
+		TextureLoader_StartJobs(loader);
+		return loader;
+	}
+
+	loader->thread = SDL_CreateThread(TextureLoader_WorkerMain, "TextureLoader", loader);
+	if (loader->thread == NULL)
+	{
+		/* Load in place; Upload finds the work already done */
+		TextureLoader_WorkerMain(loader);
+	}
+
+	return loader;
+}
+
+static void TextureLoader_Wait(TextureLoader *loader)
+{
+	uint32_t i;
+
+	if (loader->thread != NULL)
+	{
+		SDL_WaitThread(loader->thread, NULL);
+		loader->thread = NULL;
+	}
+
+	if (loader->loadJobs != NULL)
+	{
+		for (i = 0; i < loader->count; i += 1)
+		{
+			JobSystem_Wait(loader->jobs, loader->loadJobs[i]);
+		}
+		SDL_free(loader->loadJobs);
+		loader->loadJobs = NULL;
+	}
+}
+
+void TextureLoader_Upload(TextureLoader *loader, REFRESH_Device *device, REFRESH_Texture **textures)
+{
+	REFRESH_TextureSlice slice;
+	uint64_t waitStart = Bench_Now();
+	double waitSeconds;
+	double loadSeconds;
+	uint32_t bundledCount = 0;
+	uint32_t i, level;
+
+	TextureLoader_Wait(loader);
+	waitSeconds = Bench_Seconds(waitStart, Bench_Now());
+	loadSeconds = loader->openSeconds;
+
+	for (i = 0; i < loader->count; i += 1)
+	{
+		LoadedTexture *texture = &loader->textures[i];
+
+		loadSeconds += texture->loadSeconds;
+		if (texture->bundled)
+		{
+			bundledCount += 1;
+		}
+
+		if (texture->levelCount == 0)
+		{
+			SDL_Log("Could not load texture %s", loader->names[i]);
+			textures[i] = NULL;
+			continue;
+		}
+
+		textures[i] = REFRESH_CreateTexture2D(
+			device,
+			REFRESH_COLORFORMAT_R8G8B8A8,
+			texture->width,
+			texture->height,
+			texture->levelCount,
+			REFRESH_TEXTUREUSAGE_SAMPLER_BIT
+		);
+
+		for (level = 0; level < texture->levelCount; level += 1)
+		{
+			slice.texture = textures[i];
+			slice.rectangle.x = 0;
+			slice.rectangle.y = 0;
+			slice.rectangle.w = SDL_max(texture->width >> level, 1);
+			slice.rectangle.h = SDL_max(texture->height >> level, 1);
+			slice.depth = 0;
+			slice.layer = 0;
+			slice.level = level;
+
+			REFRESH_SetTextureData(
+				device,
+				&slice,
+				(void*) texture->levels[level],
+				texture->levelSizes[level]
+			);
+		}
+	}
+
+	SDL_Log(
+		"Textures: %u of %u from the bundle, loaded in %.2f ms off the main thread, waited %.2f ms",
+		bundledCount,
+		loader->count,
+		loadSeconds * 1000.0,
+		waitSeconds * 1000.0
+	);
+}
+
+const uint8_t* TextureLoader_GetPixels(TextureLoader *loader, uint32_t index, uint32_t *width, uint32_t *height)
+{
+	LoadedTexture *texture = &loader->textures[index];
+
+	TextureLoader_Wait(loader);
+
+	if (texture->levelCount == 0)
+	{
+		return NULL;
+	}
+
+	*width = texture->width;
+	*height = texture->height;
+	return texture->levels[0];
+}
+
+void TextureLoader_Destroy(TextureLoader *loader)
+{
+	uint32_t i;
+
+	if (loader == NULL)
+	{
+		return;
+	}
+
+	TextureLoader_Wait(loader);
+
+	for (i = 0; i < loader->count; i += 1)
+	{
+		if (loader->textures[i].decoded != NULL)
+		{
+			REFRESH_Image_Free(loader->textures[i].decoded);
+		}
+	}
+
+	TextureBundle_Close(loader->bundle);
+	SDL_free(loader->textures);
+	SDL_free(loader);
+}
@@ -0,0 +1,47 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <stdint.h>
+
+#include <Refresh.h>
+
+#include "job_system.h"
+
+/* Loads the sampled textures on a background thread, or as jobs, while the
+ * main thread creates shaders and pipelines.
+ *
+ * Textures come from the baked texture bundle when it has them, in which
+ * case the loader only faults in their pages, and are otherwise decoded
+ * from the PNG of the same name. Refresh is not safe to call from two
+ * threads, so creating the textures and uploading their levels waits for
+ * TextureLoader_Upload on the main thread.
+ */
+
+typedef struct TextureLoader TextureLoader;
+
+/* bundlePath may be NULL to always decode PNGs. names must outlive the
+ * loader. With jobs, opening the bundle is one job and each texture
+ * another that depends on it, so textures load side by side; NULL loads
+ * them one after another on a thread of the loader's own.
+ */
+TextureLoader* TextureLoader_Start(
+	const char *bundlePath,
+	const char **names,
+	uint32_t count,
+	JobSystem *jobs
+);
+
+/* Waits for the loads, then creates each texture and uploads every level
+ * it has. textures[i] is NULL if names[i] could not be loaded.
+ */
+void TextureLoader_Upload(TextureLoader *loader, REFRESH_Device *device, REFRESH_Texture **textures);
+
+/* Level 0 of names[index] as R8G8B8A8 for CPU-side use, waiting for the
+ * loads if they are still running. Returns NULL if the texture could not be
+ * loaded. The pixels stay valid until the loader is destroyed.
+ */
+const uint8_t* TextureLoader_GetPixels(TextureLoader *loader, uint32_t index, uint32_t *width, uint32_t *height);
+
+void TextureLoader_Destroy(TextureLoader *loader);
+
+#endif /* TEXTURE_LOADER_H */
@@ -0,0 +1,186 @@
+#include "thread_pool.h"
+
+#include <SDL.h>
+
+#include "trace.h"
+
+/* Oversubscribe the chunk count a little so uneven cores still balance */
+#define CHUNKS_PER_THREAD 4
+
+struct ThreadPool
+{
+	SDL_Thread **threads;
+	uint32_t threadCount; /* includes the calling thread */
+
+	SDL_sem *wakeSemaphore;
+	SDL_sem *doneSemaphore;
+	SDL_atomic_t shutdown;
+
+	/* Current job, written before the workers are woken */
+	ThreadPoolRangeFunc func;
+	void *userdata;
+	uint32_t count;
+	uint32_t chunkSize;
+	uint32_t chunkCount;
+	SDL_atomic_t nextChunk;
+};
+
+static void ThreadPool_RunChunks(ThreadPool *pool)
+{
+	uint32_t chunk, start, end;
+
+	for (;;)
+	{
+		chunk = (uint32_t) SDL_AtomicAdd(&pool->nextChunk, 1);
+		if (chunk >= pool->chunkCount)
+		{
+			break;
+		}
+
+		start = chunk * pool->chunkSize;
+		end = SDL_min(start + pool->chunkSize, pool->count);
+		pool->func(pool->userdata, start, end);
+	}
+}
+
+static int ThreadPool_WorkerMain(void *data)
+{
+	ThreadPool *pool = (ThreadPool*) data;
+
+	Trace_SetThreadName("pool worker");
+
+	for (;;)
+	{
+		SDL_SemWait(pool->wakeSemaphore);
+
+		if (SDL_AtomicGet(&pool->shutdown))
+		{
+			break;
+		}
+
+		TRACE_BEGIN(chunkScope, "parallel for");
+		ThreadPool_RunChunks(pool);
+		TRACE_END(chunkScope);
+		SDL_SemPost(pool->doneSemaphore);
+	}
+
+	return 0;
+}
+
+ThreadPool* ThreadPool_Create(uint32_t threadCount)
+{
+	uint32_t i;
+	ThreadPool *pool = SDL_malloc(sizeof(ThreadPool));
+
+	if (threadCount == 0)
+	{
+		threadCount = (uint32_t) SDL_max(SDL_GetCPUCount(), 1);
+	}
+
+	pool->threadCount = threadCount;
+	pool->threads = SDL_malloc(sizeof(SDL_Thread*) * threadCount);
+	pool->wakeSemaphore = SDL_CreateSemaphore(0);
+	pool->doneSemaphore = SDL_CreateSemaphore(0);
+	SDL_AtomicSet(&pool->shutdown, 0);
+	SDL_AtomicSet(&pool->nextChunk, 0);
+
+	pool->func = NULL;
+	pool->userdata = NULL;
+	pool->count = 0;
+	pool->chunkSize = 0;
+	pool->chunkCount = 0;
+
+	/* Slot 0 is the calling thread */
+	pool->threads[0] = NULL;
+	for (i = 1; i < threadCount; i += 1)
+	{
+		pool->threads[i] = SDL_CreateThread(ThreadPool_WorkerMain, "ThreadPoolWorker", pool);
+	}
+
+	return pool;
+}
+
+void ThreadPool_Destroy(ThreadPool *pool)
+{
+	uint32_t i;
+
+	if (pool == NULL)
+	{
+		return;
+	}
+
+	SDL_AtomicSet(&pool->shutdown, 1);
+	for (i = 1; i < pool->threadCount; i += 1)
+	{
+		SDL_SemPost(pool->wakeSemaphore);
+	}
+	for (i = 1; i < pool->threadCount; i += 1)
+	{
+		SDL_WaitThread(pool->threads[i], NULL);
+	}
+
+	SDL_DestroySemaphore(pool->wakeSemaphore);
+	SDL_DestroySemaphore(pool->doneSemaphore);
+	SDL_free(pool->threads);
+	SDL_free(pool);
+}
+
+uint32_t ThreadPool_GetThreadCount(ThreadPool *pool)
+{
+	return pool->threadCount;
+}
+
+void ThreadPool_ParallelFor(
+	ThreadPool *pool,
+	uint32_t count,
+	uint32_t grainSize,
+	ThreadPoolRangeFunc func,
+	void *userdata
+) {
+	uint32_t i, chunkSize, chunkCount, wakeCount;
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	if (grainSize == 0)
+	{
+		grainSize = 1;
+	}
+
+	chunkSize = count / (pool->threadCount * CHUNKS_PER_THREAD);
+	chunkSize = ((chunkSize + grainSize - 1) / grainSize) * grainSize;
+	chunkSize = SDL_max(chunkSize, grainSize);
+	chunkCount = (count + chunkSize - 1) / chunkSize;
+
+	if (pool->threadCount == 1 || chunkCount == 1)
+	{
+		func(userdata, 0, count);
+		return;
+	}
+
+	pool->func = func;
+	pool->userdata = userdata;
+	pool->count = count;
+	pool->chunkSize = chunkSize;
+	pool->chunkCount = chunkCount;
+	SDL_AtomicSet(&pool->nextChunk, 0);
+
+	wakeCount = SDL_min(pool->threadCount - 1, chunkCount - 1);
+	for (i = 0; i < wakeCount; i += 1)
+	{
+		SDL_SemPost(pool->wakeSemaphore);
+	}
+
+	TRACE_BEGIN(chunkScope, "parallel for");
+	ThreadPool_RunChunks(pool);
+	TRACE_END(chunkScope);
+
+	TRACE_BEGIN(joinScope, "parallel for join");
+	for (i = 0; i < wakeCount; i += 1)
+	{
+		SDL_SemWait(pool->doneSemaphore);
+	}
+	TRACE_END(joinScope);
+}
@@ -0,0 +1,32 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stdint.h>
+
+/* A fixed set of SDL worker threads that split index ranges between them.
+ * The calling thread always participates, so a pool of 1 thread runs inline.
+ */
+
+typedef struct ThreadPool ThreadPool;
+
+/* Called once per chunk with the half-open range [start, end) */
+typedef void (*ThreadPoolRangeFunc)(void *userdata, uint32_t start, uint32_t end);
+
+/* threadCount of 0 uses SDL_GetCPUCount() */
+ThreadPool* ThreadPool_Create(uint32_t threadCount);
+void ThreadPool_Destroy(ThreadPool *pool);
+
+uint32_t ThreadPool_GetThreadCount(ThreadPool *pool);
+
+/* Blocks until every chunk of [0, count) has been processed.
+ * Chunk boundaries are always multiples of grainSize.
+ */
+void ThreadPool_ParallelFor(
+	ThreadPool *pool,
+	uint32_t count,
+	uint32_t grainSize,
+	ThreadPoolRangeFunc func,
+	void *userdata
+);
+
+#endif /* THREAD_POOL_H */
@@ -0,0 +1,307 @@
+#include "trace.h"
+
+#ifdef TRACE_ENABLED
+
+#include <stdio.h>
+
+#include <SDL.h>
+
+#include "bench.h"
+
+#define TRACE_THREAD_NAME_LENGTH 32
+
+typedef struct TraceEvent
+{
+	const char *name;
+	uint64_t start;
+	uint64_t end;
+	int64_t value;
+} TraceEvent;
+
+/* One thread's ring. head only ever grows and is written by the owner
+ * alone, after the event it covers.
+ */
+typedef struct TraceBuffer
+{
+	TraceEvent *events;
+	uint32_t mask;
+	volatile uint32_t head;
+	SDL_atomic_t ready; /* set once events and the name are in place */
+	char name[TRACE_THREAD_NAME_LENGTH];
+} TraceBuffer;
+
+typedef struct Trace
+{
+	SDL_atomic_t active;
+	bool started;
+	SDL_TLSID bufferKey;
+	uint32_t capacity;
+	uint64_t origin;
+
+	TraceBuffer buffers[TRACE_MAX_THREADS];
+	SDL_atomic_t bufferCount; /* claimed, possibly past TRACE_MAX_THREADS */
+	SDL_atomic_t droppedThreads;
+
+	TraceBuffer gpu;
+} Trace;
+
+static Trace trace;
+
+static void Trace_InitBuffer(TraceBuffer *buffer, const char *name)
+{
+	buffer->events = SDL_malloc(sizeof(TraceEvent) * trace.capacity);
+	buffer->mask = trace.capacity - 1;
+	buffer->head = 0;
+	SDL_strlcpy(buffer->name, name, sizeof(buffer->name));
+	SDL_AtomicSet(&buffer->ready, 1);
+}
+
+/* The calling thread's ring, claimed on its first event */
+static TraceBuffer* Trace_GetBuffer(void)
+{
+	TraceBuffer *buffer = (TraceBuffer*) SDL_TLSGet(trace.bufferKey);
+	char name[TRACE_THREAD_NAME_LENGTH];
+	int index;
+
+	if (buffer != NULL)
+	{
+		return buffer;
+	}
+
+	index = SDL_AtomicAdd(&trace.bufferCount, 1);
+	if (index >= TRACE_MAX_THREADS)
+	{
+		SDL_AtomicAdd(&trace.droppedThreads, 1);
+		return NULL;
+	}
+
+	buffer = &trace.buffers[index];
+	SDL_snprintf(name, sizeof(name), "thread %d", index);
+	Trace_InitBuffer(buffer, name);
+	SDL_TLSSet(trace.bufferKey, buffer, NULL);
+
+	return buffer;
+}
+
+static void Trace_Record(TraceBuffer *buffer, const char *name, uint64_t start, uint64_t end, int64_t value)
+{
+	uint32_t head = buffer->head;
+	TraceEvent *event = &buffer->events[head & buffer->mask];
+
+	event->name = name;
+	event->start = start;
+	event->end = end;
+	event->value = value;
+
+	SDL_MemoryBarrierRelease();
+	buffer->head = head + 1;
+}
+
+void Trace_Start(uint32_t eventsPerThread)
+{
+	/* Threads keep their ring pointers in TLS, so rings are never handed
+	 * out twice
+	 */
+	SDL_assert(!trace.started);
+	if (trace.started)
+	{
+		return;
+	}
+
+	trace.capacity = 1;
+	while (trace.capacity < SDL_max(eventsPerThread, 1))
+	{
+		trace.capacity *= 2;
+	}
+
+	trace.bufferKey = SDL_TLSCreate();
+	trace.origin = Bench_Now();
+	SDL_AtomicSet(&trace.bufferCount, 0);
+	SDL_AtomicSet(&trace.droppedThreads, 0);
+	Trace_InitBuffer(&trace.gpu, "GPU (submit to retire)");
+
+	trace.started = true;
+	SDL_AtomicSet(&trace.active, 1);
+}
+
+void Trace_Stop(void)
+{
+	int i;
+	int count;
+
+	if (!SDL_AtomicGet(&trace.active))
+	{
+		return;
+	}
+
+	SDL_AtomicSet(&trace.active, 0);
+
+	count = SDL_min(SDL_AtomicGet(&trace.bufferCount), TRACE_MAX_THREADS);
+	for (i = 0; i < count; i += 1)
+	{
+		SDL_free(trace.buffers[i].events);
+		trace.buffers[i].events = NULL;
+		SDL_AtomicSet(&trace.buffers[i].ready, 0);
+	}
+	SDL_free(trace.gpu.events);
+	trace.gpu.events = NULL;
+}
+
+bool Trace_IsActive(void)
+{
+	return SDL_AtomicGet(&trace.active) != 0;
+}
+
+void Trace_SetThreadName(const char *name)
+{
+	TraceBuffer *buffer;
+
+	if (!Trace_IsActive() || (buffer = Trace_GetBuffer()) == NULL)
+	{
+		return;
+	}
+
+	SDL_strlcpy(buffer->name, name, sizeof(buffer->name));
+}
+
+void Trace_Add(const char *name, uint64_t start, uint64_t end, int64_t value)
+{
+	TraceBuffer *buffer;
+
+	if (!Trace_IsActive() || (buffer = Trace_GetBuffer()) == NULL)
+	{
+		return;
+	}
+
+	Trace_Record(buffer, name, start, end, value);
+}
+
+void Trace_AddGPU(const char *name, uint64_t start, uint64_t end, int64_t value)
+{
+	if (!Trace_IsActive())
+	{
+		return;
+	}
+
+	Trace_Record(&trace.gpu, name, start, end, value);
+}
+
+TraceScope Trace_BeginScope(const char *name)
+{
+	TraceScope scope;
+
+	scope.name = name;
+	scope.start = Trace_IsActive() ? Bench_Now() : 0;
+	return scope;
+}
+
+void Trace_EndScope(const TraceScope *scope)
+{
+	if (scope->start != 0)
+	{
+		Trace_Add(scope->name, scope->start, Bench_Now(), TRACE_NO_VALUE);
+	}
+}
+
+/* Export */
+
+static double Trace_Microseconds(uint64_t ticks)
+{
+	return (ticks > trace.origin) ? Bench_Seconds(trace.origin, ticks) * 1e6 : 0.0;
+}
+
+/* Writes the buffer's surviving events and returns how many were
+ * overwritten
+ */
+static uint64_t Trace_WriteBuffer(FILE *file, TraceBuffer *buffer, uint32_t tid, bool *first)
+{
+	uint32_t head, i, count;
+	TraceEvent *event;
+
+	if (!SDL_AtomicGet(&buffer->ready))
+	{
+		return 0;
+	}
+
+	head = buffer->head;
+	SDL_MemoryBarrierAcquire();
+	count = SDL_min(head, trace.capacity);
+
+	fprintf(
+		file,
+		"%s\n\t\t{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": { \"name\": \"%s\" } }",
+		*first ? "" : ",",
+		tid,
+		buffer->name
+	);
+	*first = false;
+
+	for (i = head - count; i != head; i += 1)
+	{
+		event = &buffer->events[i & buffer->mask];
+
+		fprintf(
+			file,
+			",\n\t\t{ \"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f",
+			event->name,
+			tid,
+			Trace_Microseconds(event->start),
+			Trace_Microseconds(event->end) - Trace_Microseconds(event->start)
+		);
+		if (event->value != TRACE_NO_VALUE)
+		{
+			fprintf(file, ", \"args\": { \"value\": %lld }", (long long) event->value);
+		}
+		fprintf(file, " }");
+	}
+
+	return head - count;
+}
+
+bool Trace_WriteChromeJSON(const char *path)
+{
+	int i, count;
+	uint64_t eventCount = 0;
+	uint64_t overwritten = 0;
+	bool first = true;
+	FILE *file;
+
+	if (!Trace_IsActive())
+	{
+		return false;
+	}
+
+	file = fopen(path, "w");
+	if (file == NULL)
+	{
+		SDL_Log("Could not open %s for writing", path);
+		return false;
+	}
+
+	fprintf(file, "{\n\t\"displayTimeUnit\": \"ms\",\n\t\"traceEvents\": [");
+
+	count = SDL_min(SDL_AtomicGet(&trace.bufferCount), TRACE_MAX_THREADS);
+	for (i = 0; i < count; i += 1)
+	{
+		overwritten += Trace_WriteBuffer(file, &trace.buffers[i], (uint32_t) i, &first);
+		eventCount += SDL_min(trace.buffers[i].head, trace.capacity);
+	}
+	overwritten += Trace_WriteBuffer(file, &trace.gpu, TRACE_MAX_THREADS, &first);
+	eventCount += SDL_min(trace.gpu.head, trace.capacity);
+
+	fprintf(file, "\n\t]\n}\n");
+	fclose(file);
+
+	SDL_Log(
+		"Trace: %llu events on %d threads written to %s, %llu older events overwritten, %d threads untraced",
+		(unsigned long long) eventCount,
+		count,
+		path,
+		(unsigned long long) overwritten,
+		SDL_AtomicGet(&trace.droppedThreads)
+	);
+
+	return true;
+}
+
+#endif /* TRACE_ENABLED */
@@ -0,0 +1,89 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Scoped timers for the frame's hot paths, exported as a Chrome trace
+ * (chrome://tracing, or ui.perfetto.dev).
+ *
+ * Every thread that records an event gets its own ring of eventsPerThread
+ * events on first use. Only that thread writes to it, so recording takes no
+ * lock: it reads the clock and stores the event. Once a ring is full the
+ * oldest events are overwritten, so a long run keeps its most recent part.
+ *
+ * Refresh has no timestamp queries. The GPU track instead shows each
+ * frame from its submission until the CPU knows it has retired, which is
+ * an upper bound on its GPU time (see frame_ring.h).
+ *
+ * The build defines TRACE_ENABLED unless tracing is configured off or the
+ * build is a release one. Without it the macros expand to nothing and the
+ * functions to empty inlines, so no instrumentation is left in the binary.
+ */
+
+#define TRACE_DEFAULT_EVENTS_PER_THREAD 65536
+#define TRACE_MAX_THREADS 64
+
+/* Events with no value attached */
+#define TRACE_NO_VALUE (-1)
+
+typedef struct TraceScope
+{
+	const char *name;
+	uint64_t start; /* 0 when tracing was off at the start of the scope */
+} TraceScope;
+
+#ifdef TRACE_ENABLED
+
+#define TRACE_COMPILED_IN 1
+
+/* Starts recording. eventsPerThread is rounded up to a power of two. */
+void Trace_Start(uint32_t eventsPerThread);
+
+/* Stops recording and frees every ring. Threads still recording must be
+ * done by then.
+ */
+void Trace_Stop(void);
+
+bool Trace_IsActive(void);
+
+/* Names the calling thread's track */
+void Trace_SetThreadName(const char *name);
+
+/* name must be a string literal or otherwise outlive the trace. A value
+ * other than TRACE_NO_VALUE is shown in the event's arguments.
+ */
+void Trace_Add(const char *name, uint64_t start, uint64_t end, int64_t value);
+
+/* The same on the GPU track, from the thread that submits */
+void Trace_AddGPU(const char *name, uint64_t start, uint64_t end, int64_t value);
+
+TraceScope Trace_BeginScope(const char *name);
+void Trace_EndScope(const TraceScope *scope);
+
+/* Writes every ring as complete ("X") events, sorted by thread. Call it
+ * while no other thread is recording.
+ */
+bool Trace_WriteChromeJSON(const char *path);
+
+#define TRACE_BEGIN(scope, name) TraceScope scope = Trace_BeginScope(name)
+#define TRACE_END(scope) Trace_EndScope(&scope)
+
+#else
+
+#define TRACE_COMPILED_IN 0
+
+static inline void Trace_Start(uint32_t eventsPerThread) { (void) eventsPerThread; }
+static inline void Trace_Stop(void) { }
+static inline bool Trace_IsActive(void) { return false; }
+static inline void Trace_SetThreadName(const char *name) { (void) name; }
+static inline void Trace_Add(const char *name, uint64_t start, uint64_t end, int64_t value) { (void) name; (void) start; (void) end; (void) value; }
+static inline void Trace_AddGPU(const char *name, uint64_t start, uint64_t end, int64_t value) { (void) name; (void) start; (void) end; (void) value; }
+static inline bool Trace_WriteChromeJSON(const char *path) { (void) path; return false; }
+
+#define TRACE_BEGIN(scope, name)
+#define TRACE_END(scope)
+
+#endif /* TRACE_ENABLED */
+
+#endif /* TRACE_H */
@@ -0,0 +1,769 @@
+#include "trajectory.h"
+
+#include <stddef.h>
+
+#include <SDL.h>
+
+#include "file_map.h"
+
+/* Longest zigzag varint of a 32-bit difference */
+#define TRAJECTORY_MAX_VARINT 5
+
+/* The rANS coder: byte-wise renormalization of a 32-bit state, with
+ * symbol frequencies scaled to sum to 1 << TRAJECTORY_RANS_PROB_BITS
+ */
+#define TRAJECTORY_RANS_PROB_BITS 12
+#define TRAJECTORY_RANS_PROB_SCALE (1u << TRAJECTORY_RANS_PROB_BITS)
+#define TRAJECTORY_RANS_LOWER (1u << 23)
+#define TRAJECTORY_SYMBOL_COUNT 256
+#define TRAJECTORY_FREQUENCY_TABLE_SIZE (sizeof(uint16_t) * TRAJECTORY_SYMBOL_COUNT)
+
+#define TRAJECTORY_FRAME_ALIGNMENT 8
+
+static const size_t fieldOffsets[TRAJECTORY_FIELD_COUNT] =
+{
+	offsetof(Particle, xPosition),
+	offsetof(Particle, yPosition),
+	offsetof(Particle, xVelocity),
+	offsetof(Particle, yVelocity),
+	offsetof(Particle, gradientPosition)
+};
+
+static uint32_t Trajectory_MaxRawSize(uint32_t particleCount)
+{
+	return particleCount * TRAJECTORY_FIELD_COUNT * TRAJECTORY_MAX_VARINT;
+}
+
+/* Frames are padded to TRAJECTORY_FRAME_ALIGNMENT so every header in the
+ * mapping is aligned
+ */
+static uint64_t Trajectory_FrameSize(const TrajectoryFrameHeader *frameHeader)
+{
+	uint64_t size = sizeof(TrajectoryFrameHeader) +
+		((frameHeader->flags & TRAJECTORY_FRAME_RAW) ? 0 : TRAJECTORY_FREQUENCY_TABLE_SIZE) +
+		frameHeader->payloadSize;
+
+	return (size + TRAJECTORY_FRAME_ALIGNMENT - 1) & ~((uint64_t) TRAJECTORY_FRAME_ALIGNMENT - 1);
+}
+
+/* Saturates, and takes NaN to 0 */
+static int32_t Trajectory_Quantize(float value, double inverseStep)
+{
+	double scaled = SDL_floor((double) value * inverseStep + 0.5);
+
+	if (!(scaled == scaled))
+	{
+		return 0;
+	}
+	if (scaled >= 2147483647.0)
+	{
+		return 2147483647;
+	}
+	if (scaled <= -2147483648.0)
+	{
+		return (-2147483647 - 1);
+	}
+	return (int32_t) scaled;
+}
+
+/* Frequencies summing to TRAJECTORY_RANS_PROB_SCALE, at least 1 for every
+ * symbol that occurs
+ */
+static void Trajectory_NormalizeFrequencies(const uint32_t *counts, uint32_t total, uint16_t *frequencies)
+{
+	uint32_t symbol, largest = 0, sum = 0, take;
+
+	for (symbol = 0; symbol < TRAJECTORY_SYMBOL_COUNT; symbol += 1)
+	{
+		frequencies[symbol] = 0;
+		if (counts[symbol] > 0)
+		{
+			frequencies[symbol] = (uint16_t) SDL_max((uint64_t) counts[symbol] * TRAJECTORY_RANS_PROB_SCALE / total, 1);
+			sum += frequencies[symbol];
+			if (frequencies[symbol] > frequencies[largest])
+			{
+				largest = symbol;
+			}
+		}
+	}
+
+	if (sum < TRAJECTORY_RANS_PROB_SCALE)
+	{
+		frequencies[largest] += (uint16_t) (TRAJECTORY_RANS_PROB_SCALE - sum);
+		return;
+	}
+
+	/* Rare symbols rounded up to 1; take the excess from the common ones */
+	while (sum > TRAJECTORY_RANS_PROB_SCALE)
+	{
+		for (symbol = 0, largest = 0; symbol < TRAJECTORY_SYMBOL_COUNT; symbol += 1)
+		{
+			if (frequencies[symbol] > frequencies[largest])
+			{
+				largest = symbol;
+			}
+		}
+		take = SDL_min(sum - TRAJECTORY_RANS_PROB_SCALE, (uint32_t) frequencies[largest] - 1);
+		frequencies[largest] -= (uint16_t) take;
+		sum -= take;
+	}
+}
+
+/* Codes input backwards from the end of output, which holds at least
+ * 2 * length + 4 bytes, and returns where the code starts
+ */
+static uint8_t* Trajectory_EncodeRANS(
+	const uint8_t *input,
+	uint32_t length,
+	const uint16_t *frequencies,
+	uint8_t *outputEnd
+) {
+	uint32_t starts[TRAJECTORY_SYMBOL_COUNT];
+	uint32_t symbol, start = 0, x = TRAJECTORY_RANS_LOWER, frequency, xMax;
+	uint8_t *output = outputEnd;
+	uint32_t i;
+
+	for (symbol = 0; symbol < TRAJECTORY_SYMBOL_COUNT; symbol += 1)
+	{
+		starts[symbol] = start;
+		start += frequencies[symbol];
+	}
+
+	for (i = length; i > 0; i -= 1)
+	{
+		symbol = input[i - 1];
+		frequency = frequencies[symbol];
+
+		xMax = ((TRAJECTORY_RANS_LOWER >> TRAJECTORY_RANS_PROB_BITS) << 8) * frequency;
+		while (x >= xMax)
+		{
+			*--output = (uint8_t) (x & 0xFF);
+			x >>= 8;
+		}
+		x = ((x / frequency) << TRAJECTORY_RANS_PROB_BITS) + (x % frequency) + starts[symbol];
+	}
+
+	output -= 4;
+	output[0] = (uint8_t) (x >> 0);
+	output[1] = (uint8_t) (x >> 8);
+	output[2] = (uint8_t) (x >> 16);
+	output[3] = (uint8_t) (x >> 24);
+
+	return output;
+}
+
+/* slotSymbols has TRAJECTORY_RANS_PROB_SCALE entries. Returns false if
+ * the frequencies do not sum to the scale.
+ */
+static bool Trajectory_DecodeRANS(
+	const uint8_t *input,
+	uint32_t inputLength,
+	const uint16_t *frequencies,
+	uint8_t *slotSymbols,
+	uint8_t *output,
+	uint32_t length
+) {
+	uint32_t starts[TRAJECTORY_SYMBOL_COUNT];
+	const uint8_t *end = input + inputLength;
+	uint32_t symbol, start = 0, slot, x, i;
+
+	for (symbol = 0; symbol < TRAJECTORY_SYMBOL_COUNT; symbol += 1)
+	{
+		if (start + frequencies[symbol] > TRAJECTORY_RANS_PROB_SCALE)
+		{
+			return false;
+		}
+		starts[symbol] = start;
+		SDL_memset(slotSymbols + start, (int) symbol, frequencies[symbol]);
+		start += frequencies[symbol];
+	}
+
+	if (start != TRAJECTORY_RANS_PROB_SCALE || inputLength < 4)
+	{
+		return false;
+	}
+
+	x = (uint32_t) input[0] | ((uint32_t) input[1] << 8) | ((uint32_t) input[2] << 16) | ((uint32_t) input[3] << 24);
+	input += 4;
+
+	for (i = 0; i < length; i += 1)
+	{
+		slot = x & (TRAJECTORY_RANS_PROB_SCALE - 1);
+		symbol = slotSymbols[slot];
+		output[i] = (uint8_t) symbol;
+
+		x = frequencies[symbol] * (x >> TRAJECTORY_RANS_PROB_BITS) + slot - starts[symbol];
+		while (x < TRAJECTORY_RANS_LOWER && input < end)
+		{
+			x = (x << 8) | *input++;
+		}
+	}
+
+	return true;
+}
+
+/* Writing */
+
+struct TrajectoryWriter
+{
+	SDL_RWops *file;
+	TrajectoryHeader header;
+	uint64_t offset; /* where the next frame goes */
+	uint32_t frameCount;
+	uint64_t startTime;
+	bool failed;
+
+	TrajectoryChunk *chunks;
+	uint32_t chunkCount;
+	uint32_t chunkCapacity;
+
+	/* Field-major quantized values of the last frame */
+	int32_t *previous;
+	uint8_t *raw;
+	uint8_t *coded;
+	uint32_t codedCapacity;
+};
+
+static bool TrajectoryWriter_Write(TrajectoryWriter *writer, const void *data, uint64_t size)
+{
+	if (size > 0 && SDL_RWwrite(writer->file, data, (size_t) size, 1) != 1)
+	{
+		writer->failed = true;
+		return false;
+	}
+
+	writer->offset += size;
+	return true;
+}
+
+TrajectoryWriter* TrajectoryWriter_Create(
+	const char *path,
+	uint32_t particleCount,
+	float step,
+	uint32_t framesPerChunk
+) {
+	TrajectoryWriter *writer;
+	SDL_RWops *file = SDL_RWFromFile(path, "wb");
+	uint32_t i;
+
+	if (file == NULL)
+	{
+		SDL_Log("Could not open %s for writing", path);
+		return NULL;
+	}
+
+	writer = SDL_malloc(sizeof(TrajectoryWriter));
+	SDL_zerop(writer);
+
+	writer->file = file;
+	writer->header.magic = TRAJECTORY_MAGIC;
+	writer->header.version = TRAJECTORY_VERSION;
+	writer->header.particleCount = particleCount;
+	writer->header.fieldCount = TRAJECTORY_FIELD_COUNT;
+	writer->header.framesPerChunk = SDL_max(framesPerChunk, 1);
+	for (i = 0; i < TRAJECTORY_FIELD_COUNT; i += 1)
+	{
+		writer->header.fieldStep[i] = step;
+	}
+	writer->startTime = SDL_GetPerformanceCounter();
+
+	writer->previous = SDL_malloc(sizeof(int32_t) * TRAJECTORY_FIELD_COUNT * SDL_max(particleCount, 1));
+	writer->raw = SDL_malloc(SDL_max(Trajectory_MaxRawSize(particleCount), 1));
+	writer->codedCapacity = Trajectory_MaxRawSize(particleCount) * 2 + 4;
+	writer->coded = SDL_malloc(writer->codedCapacity);
+
+	/* indexOffset is filled in on close */
+	TrajectoryWriter_Write(writer, &writer->header, sizeof(TrajectoryHeader));
+
+	return writer;
+}
+
+bool TrajectoryWriter_Append(
+	TrajectoryWriter *writer,
+	const Particle *particles,
+	uint32_t frame,
+	double t
+) {
+	static const uint8_t padding[TRAJECTORY_FRAME_ALIGNMENT] = { 0 };
+	TrajectoryFrameHeader frameHeader;
+	uint64_t frameEnd;
+	uint32_t counts[TRAJECTORY_SYMBOL_COUNT];
+	uint16_t frequencies[TRAJECTORY_SYMBOL_COUNT];
+	uint32_t particleCount = writer->header.particleCount;
+	bool keyframe = (writer->frameCount % writer->header.framesPerChunk) == 0;
+	uint8_t *out = writer->raw;
+	uint8_t *code = NULL;
+	int32_t *previous;
+	int32_t value;
+	uint32_t field, i, zigzag;
+	double inverseStep;
+	const uint8_t *source;
+
+	if (writer->failed)
+	{
+		return false;
+	}
+
+	if (keyframe)
+	{
+		if (writer->chunkCount == writer->chunkCapacity)
+		{
+			writer->chunkCapacity = SDL_max(writer->chunkCapacity * 2, 16);
+			writer->chunks = SDL_realloc(writer->chunks, sizeof(TrajectoryChunk) * writer->chunkCapacity);
+		}
+		writer->chunks[writer->chunkCount].offset = writer->offset;
+		writer->chunks[writer->chunkCount].firstFrame = writer->frameCount;
+		writer->chunks[writer->chunkCount].frameCount = 0;
+		writer->chunkCount += 1;
+
+		SDL_memset(writer->previous, 0, sizeof(int32_t) * TRAJECTORY_FIELD_COUNT * particleCount);
+	}
+
+	/* Differences, field by field, so similar bytes sit together */
+	for (field = 0; field < TRAJECTORY_FIELD_COUNT; field += 1)
+	{
+		inverseStep = 1.0 / writer->header.fieldStep[field];
+		previous = writer->previous + field * particleCount;
+		source = (const uint8_t*) particles + fieldOffsets[field];
+
+		for (i = 0; i < particleCount; i += 1)
+		{
+			value = Trajectory_Quantize(*(const float*) (source + sizeof(Particle) * i), inverseStep);
+			zigzag = (uint32_t) value - (uint32_t) previous[i];
+			zigzag = (zigzag << 1) ^ (uint32_t) ((int32_t) zigzag >> 31);
+			previous[i] = value;
+
+			while (zigzag >= 0x80)
+			{
+				*out++ = (uint8_t) (zigzag | 0x80);
+				zigzag >>= 7;
+			}
+			*out++ = (uint8_t) zigzag;
+		}
+	}
+
+	SDL_zero(frameHeader);
+	frameHeader.magic = TRAJECTORY_FRAME_MAGIC;
+	frameHeader.flags = keyframe ? TRAJECTORY_FRAME_KEYFRAME : 0;
+	frameHeader.frame = frame;
+	frameHeader.rawSize = (uint32_t) (out - writer->raw);
+	frameHeader.t = t;
+	frameHeader.seconds = (double) (SDL_GetPerformanceCounter() - writer->startTime) / (double) SDL_GetPerformanceFrequency();
+
+	if (frameHeader.rawSize > 0)
+	{
+		SDL_zero(counts);
+		for (i = 0; i < frameHeader.rawSize; i += 1)
+		{
+			counts[writer->raw[i]] += 1;
+		}
+		Trajectory_NormalizeFrequencies(counts, frameHeader.rawSize, frequencies);
+
+		code = Trajectory_EncodeRANS(writer->raw, frameHeader.rawSize, frequencies, writer->coded + writer->codedCapacity);
+		frameHeader.payloadSize = (uint32_t) (writer->coded + writer->codedCapacity - code);
+	}
+
+	if (code == NULL || frameHeader.payloadSize + TRAJECTORY_FREQUENCY_TABLE_SIZE >= frameHeader.rawSize)
+	{
+		frameHeader.flags |= TRAJECTORY_FRAME_RAW;
+		frameHeader.payloadSize = frameHeader.rawSize;
+		code = writer->raw;
+	}
+
+	frameEnd = writer->offset + Trajectory_FrameSize(&frameHeader);
+
+	if (!TrajectoryWriter_Write(writer, &frameHeader, sizeof(TrajectoryFrameHeader)) ||
+		(!(frameHeader.flags & TRAJECTORY_FRAME_RAW) && !TrajectoryWriter_Write(writer, frequencies, TRAJECTORY_FREQUENCY_TABLE_SIZE)) ||
+		!TrajectoryWriter_Write(writer, code, frameHeader.payloadSize) ||
+		!TrajectoryWriter_Write(writer, padding, frameEnd - writer->offset))
+	{
+		return false;
+	}
+
+	writer->chunks[writer->chunkCount - 1].frameCount += 1;
+	writer->frameCount += 1;
+
+	return true;
+}
+
+bool TrajectoryWriter_Close(TrajectoryWriter *writer)
+{
+	TrajectoryIndexHeader indexHeader;
+	bool written;
+
+	if (writer == NULL)
+	{
+		return true;
+	}
+
+	indexHeader.magic = TRAJECTORY_INDEX_MAGIC;
+	indexHeader.chunkCount = writer->chunkCount;
+	indexHeader.frameCount = writer->frameCount;
+	indexHeader.reserved = 0;
+
+	writer->header.indexOffset = writer->offset;
+
+	if (!writer->failed &&
+		TrajectoryWriter_Write(writer, &indexHeader, sizeof(TrajectoryIndexHeader)) &&
+		TrajectoryWriter_Write(writer, writer->chunks, sizeof(TrajectoryChunk) * writer->chunkCount))
+	{
+		if (SDL_RWseek(writer->file, 0, RW_SEEK_SET) != 0 ||
+			SDL_RWwrite(writer->file, &writer->header, sizeof(TrajectoryHeader), 1) != 1)
+		{
+			writer->failed = true;
+		}
+	}
+
+	written = (SDL_RWclose(writer->file) == 0) && !writer->failed;
+
+	SDL_free(writer->chunks);
+	SDL_free(writer->previous);
+	SDL_free(writer->raw);
+	SDL_free(writer->coded);
+	SDL_free(writer);
+
+	return written;
+}
+
+uint32_t TrajectoryWriter_GetFrameCount(TrajectoryWriter *writer)
+{
+	return writer->frameCount;
+}
+
+uint64_t TrajectoryWriter_GetSize(TrajectoryWriter *writer)
+{
+	return writer->offset;
+}
+
+/* Reading */
+
+struct TrajectoryReader
+{
+	FileMap map;
+	TrajectoryHeader header;
+	bool hasIndex;
+
+	TrajectoryChunk *chunks;
+	uint32_t chunkCount;
+	uint32_t frameCount;
+
+	/* The last frame decoded, and where the one after it starts */
+	int32_t *values;
+	uint8_t *raw;
+	uint8_t slotSymbols[TRAJECTORY_RANS_PROB_SCALE];
+	int64_t lastFrame;
+	uint64_t nextOffset;
+	TrajectoryFrameInfo lastInfo;
+};
+
+/* The frame header at offset, if the whole frame is in the file */
+static const TrajectoryFrameHeader* TrajectoryReader_GetFrameHeader(TrajectoryReader *reader, uint64_t offset)
+{
+	const TrajectoryFrameHeader *frameHeader;
+
+	if (offset > reader->map.size || reader->map.size - offset < sizeof(TrajectoryFrameHeader))
+	{
+		return NULL;
+	}
+
+	frameHeader = (const TrajectoryFrameHeader*) (reader->map.data + offset);
+	if (frameHeader->magic != TRAJECTORY_FRAME_MAGIC ||
+		frameHeader->rawSize > Trajectory_MaxRawSize(reader->header.particleCount) ||
+		Trajectory_FrameSize(frameHeader) > reader->map.size - offset)
+	{
+		return NULL;
+	}
+
+	return frameHeader;
+}
+
+static bool TrajectoryReader_ReadIndex(TrajectoryReader *reader)
+{
+	const TrajectoryIndexHeader *indexHeader;
+	uint64_t offset = reader->header.indexOffset;
+	uint64_t size = reader->map.size;
+
+	if (offset == 0 || offset > size || size - offset < sizeof(TrajectoryIndexHeader))
+	{
+		return false;
+	}
+
+	indexHeader = (const TrajectoryIndexHeader*) (reader->map.data + offset);
+	if (indexHeader->magic != TRAJECTORY_INDEX_MAGIC ||
+		(size - offset - sizeof(TrajectoryIndexHeader)) / sizeof(TrajectoryChunk) < indexHeader->chunkCount)
+	{
+		return false;
+	}
+
+	reader->chunkCount = indexHeader->chunkCount;
+	reader->frameCount = indexHeader->frameCount;
+	reader->chunks = SDL_malloc(sizeof(TrajectoryChunk) * SDL_max(reader->chunkCount, 1));
+	SDL_memcpy(reader->chunks, indexHeader + 1, sizeof(TrajectoryChunk) * reader->chunkCount);
+
+	return true;
+}
+
+/* For a file whose writer never closed it: walks the frames up to the
+ * first incomplete one
+ */
+static void TrajectoryReader_ScanChunks(TrajectoryReader *reader)
+{
+	const TrajectoryFrameHeader *frameHeader;
+	uint64_t offset = sizeof(TrajectoryHeader);
+	uint32_t capacity = 16;
+
+	reader->chunks = SDL_malloc(sizeof(TrajectoryChunk) * capacity);
+	reader->chunkCount = 0;
+	reader->frameCount = 0;
+
+	while ((frameHeader = TrajectoryReader_GetFrameHeader(reader, offset)) != NULL)
+	{
+		if (frameHeader->flags & TRAJECTORY_FRAME_KEYFRAME)
+		{
+			if (reader->chunkCount == capacity)
+			{
+				capacity *= 2;
+				reader->chunks = SDL_realloc(reader->chunks, sizeof(TrajectoryChunk) * capacity);
+			}
+			reader->chunks[reader->chunkCount].offset = offset;
+			reader->chunks[reader->chunkCount].firstFrame = reader->frameCount;
+			reader->chunks[reader->chunkCount].frameCount = 0;
+			reader->chunkCount += 1;
+		}
+		else if (reader->chunkCount == 0)
+		{
+			break;
+		}
+
+		reader->chunks[reader->chunkCount - 1].frameCount += 1;
+		reader->frameCount += 1;
+		offset += Trajectory_FrameSize(frameHeader);
+	}
+}
+
+TrajectoryReader* TrajectoryReader_Open(const char *path)
+{
+	TrajectoryReader *reader = SDL_malloc(sizeof(TrajectoryReader));
+
+	SDL_zerop(reader);
+	reader->lastFrame = -1;
+
+	if (!FileMap_Open(&reader->map, path))
+	{
+		SDL_Log("Could not read the trajectory %s", path);
+		SDL_free(reader);
+		return NULL;
+	}
+
+	if (reader->map.size < sizeof(TrajectoryHeader))
+	{
+		SDL_Log("%s is not a version %u trajectory", path, TRAJECTORY_VERSION);
+		TrajectoryReader_Close(reader);
+		return NULL;
+	}
+
+	SDL_memcpy(&reader->header, reader->map.data, sizeof(TrajectoryHeader));
+
+	if (reader->header.magic != TRAJECTORY_MAGIC ||
+		reader->header.version != TRAJECTORY_VERSION ||
+		reader->header.fieldCount != TRAJECTORY_FIELD_COUNT)
+	{
+		SDL_Log("%s is not a version %u trajectory", path, TRAJECTORY_VERSION);
+		TrajectoryReader_Close(reader);
+		return NULL;
+	}
+
+	reader->hasIndex = TrajectoryReader_ReadIndex(reader);
+	if (!reader->hasIndex)
+	{
+		TrajectoryReader_ScanChunks(reader);
+	}
+
+	reader->values = SDL_malloc(sizeof(int32_t) * TRAJECTORY_FIELD_COUNT * SDL_max(reader->header.particleCount, 1));
+	reader->raw = SDL_malloc(SDL_max(Trajectory_MaxRawSize(reader->header.particleCount), 1));
+
+	return reader;
+}
+
+void TrajectoryReader_Close(TrajectoryReader *reader)
+{
+	if (reader == NULL)
+	{
+		return;
+	}
+
+	FileMap_Close(&reader->map);
+	SDL_free(reader->chunks);
+	SDL_free(reader->values);
+	SDL_free(reader->raw);
+	SDL_free(reader);
+}
+
+const TrajectoryHeader* TrajectoryReader_GetHeader(TrajectoryReader *reader)
+{
+	return &reader->header;
+}
+
+uint32_t TrajectoryReader_GetFrameCount(TrajectoryReader *reader)
+{
+	return reader->frameCount;
+}
+
+uint32_t TrajectoryReader_GetChunkCount(TrajectoryReader *reader)
+{
+	return reader->chunkCount;
+}
+
+bool TrajectoryReader_HasIndex(TrajectoryReader *reader)
+{
+	return reader->hasIndex;
+}
+
+/* Decodes the frame at reader->nextOffset on top of reader->values */
+static bool TrajectoryReader_DecodeNext(TrajectoryReader *reader, bool keyframe)
+{
+	const TrajectoryFrameHeader *frameHeader = TrajectoryReader_GetFrameHeader(reader, reader->nextOffset);
+	const uint8_t *payload, *in, *end;
+	uint32_t particleCount = reader->header.particleCount;
+	uint32_t count = particleCount * TRAJECTORY_FIELD_COUNT;
+	uint32_t i, zigzag, shift;
+
+	if (frameHeader == NULL || ((frameHeader->flags & TRAJECTORY_FRAME_KEYFRAME) != 0) != keyframe)
+	{
+		return false;
+	}
+
+	payload = (const uint8_t*) (frameHeader + 1);
+
+	if (frameHeader->flags & TRAJECTORY_FRAME_RAW)
+	{
+		if (frameHeader->payloadSize != frameHeader->rawSize)
+		{
+			return false;
+		}
+		in = payload;
+	}
+	else
+	{
+		if (!Trajectory_DecodeRANS(
+			payload + TRAJECTORY_FREQUENCY_TABLE_SIZE,
+			frameHeader->payloadSize,
+			(const uint16_t*) payload,
+			reader->slotSymbols,
+			reader->raw,
+			frameHeader->rawSize
+		)) {
+			return false;
+		}
+		in = reader->raw;
+	}
+	end = in + frameHeader->rawSize;
+
+	if (keyframe)
+	{
+		SDL_memset(reader->values, 0, sizeof(int32_t) * count);
+	}
+
+	for (i = 0; i < count; i += 1)
+	{
+		zigzag = 0;
+		shift = 0;
+		do
+		{
+			if (in == end || shift > 28)
+			{
+				return false;
+			}
+			zigzag |= (uint32_t) (*in & 0x7F) << shift;
+			shift += 7;
+		} while (*in++ & 0x80);
+
+		reader->values[i] = (int32_t) ((uint32_t) reader->values[i] + ((zigzag >> 1) ^ (0u - (zigzag & 1))));
+	}
+
+	if (in != end)
+	{
+		return false;
+	}
+
+	reader->lastInfo.frame = frameHeader->frame;
+	reader->lastInfo.t = frameHeader->t;
+	reader->lastInfo.seconds = frameHeader->seconds;
+	reader->lastInfo.size = Trajectory_FrameSize(frameHeader);
+	reader->nextOffset += reader->lastInfo.size;
+
+	return true;
+}
+
+bool TrajectoryReader_ReadFrame(
+	TrajectoryReader *reader,
+	uint32_t index,
+	Particle *particles,
+	TrajectoryFrameInfo *info
+) {
+	const TrajectoryChunk *chunk;
+	uint32_t low = 0, high, middle;
+	uint32_t particleCount = reader->header.particleCount;
+	uint32_t field, i;
+	const int32_t *values;
+	uint8_t *destination;
+	float step;
+
+	if (index >= reader->frameCount || reader->chunkCount == 0)
+	{
+		return false;
+	}
+
+	/* The last chunk starting at or before index */
+	high = reader->chunkCount - 1;
+	while (low < high)
+	{
+		middle = (low + high + 1) / 2;
+		if (reader->chunks[middle].firstFrame <= index)
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle - 1;
+		}
+	}
+	chunk = &reader->chunks[low];
+
+	if (reader->lastFrame < (int64_t) chunk->firstFrame || reader->lastFrame > (int64_t) index)
+	{
+		reader->nextOffset = chunk->offset;
+		reader->lastFrame = (int64_t) chunk->firstFrame - 1;
+	}
+
+	while (reader->lastFrame < (int64_t) index)
+	{
+		if (!TrajectoryReader_DecodeNext(reader, reader->lastFrame + 1 == (int64_t) chunk->firstFrame))
+		{
+			SDL_Log("Trajectory frame %lld is corrupt", (long long) (reader->lastFrame + 1));
+			reader->lastFrame = -1;
+			return false;
+		}
+		reader->lastFrame += 1;
+	}
+
+	SDL_memset(particles, 0, sizeof(Particle) * particleCount);
+	for (field = 0; field < TRAJECTORY_FIELD_COUNT; field += 1)
+	{
+		step = reader->header.fieldStep[field];
+		values = reader->values + field * particleCount;
+		destination = (uint8_t*) particles + fieldOffsets[field];
+
+		for (i = 0; i < particleCount; i += 1)
+		{
+			*(float*) (destination + sizeof(Particle) * i) = (float) ((double) values[i] * step);
+		}
+	}
+
+	if (info != NULL)
+	{
+		*info = reader->lastInfo;
+	}
+
+	return true;
+}
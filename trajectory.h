@@ -0,0 +1,157 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "particle.h"
+
+/* Recorded particle trajectories, for offline analysis and replay.
+ *
+ * Each frame stores the five fields of every particle (position, velocity,
+ * gradient) quantized to multiples of a per-field step, as the difference
+ * from the previous frame's quantized values. Differences are zigzag
+ * varints, field by field, and the bytes are then entropy coded with an
+ * order-0 rANS coder whose frequency table travels with the frame. A frame
+ * that would not shrink is stored as plain varints instead.
+ *
+ * Every framesPerChunk frames a keyframe is stored against zero instead,
+ * so decoding can start at the chunk holding a frame rather than at the
+ * beginning of the file. The chunk index at the end of the file says where
+ * every chunk starts; a file whose writer never closed it has no index and
+ * is scanned instead.
+ *
+ * Layout: a TrajectoryHeader, then the frames, each a TrajectoryFrameHeader,
+ * for coded frames a table of 256 uint16_t symbol frequencies, and the
+ * payload, zero padded to a multiple of 8 bytes. Then a
+ * TrajectoryIndexHeader and chunkCount TrajectoryChunk records at
+ * indexOffset. All fields are little endian.
+ */
+
+#define TRAJECTORY_MAGIC 0x4A545052 /* "RPTJ" */
+#define TRAJECTORY_FRAME_MAGIC 0x46545052 /* "RPTF" */
+#define TRAJECTORY_INDEX_MAGIC 0x49545052 /* "RPTI" */
+#define TRAJECTORY_VERSION 1
+
+/* xPosition, yPosition, xVelocity, yVelocity, gradientPosition */
+#define TRAJECTORY_FIELD_COUNT 5
+
+#define TRAJECTORY_DEFAULT_FRAMES_PER_CHUNK 64
+
+/* Finer than the quantized layout's snorm16 positions */
+#define TRAJECTORY_DEFAULT_STEP (1.0f / 65536.0f)
+
+#define TRAJECTORY_FRAME_KEYFRAME 0x1 /* against zero rather than the previous frame */
+#define TRAJECTORY_FRAME_RAW 0x2      /* plain varints, no frequency table */
+
+typedef struct TrajectoryHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t particleCount;
+	uint32_t fieldCount;
+	uint32_t framesPerChunk;
+	uint32_t reserved;
+	float fieldStep[TRAJECTORY_FIELD_COUNT]; /* a field's value is its integer times this */
+	uint32_t padding;
+	uint64_t indexOffset; /* 0 until the writer is closed */
+} TrajectoryHeader;
+
+typedef struct TrajectoryFrameHeader
+{
+	uint32_t magic;
+	uint32_t flags;
+	uint32_t frame;       /* the program's frame number */
+	uint32_t rawSize;     /* bytes of varints */
+	uint32_t payloadSize; /* bytes after the frequency table, if any */
+	uint32_t reserved;
+	double t;             /* simulation time */
+	double seconds;       /* wall time since the writer was created */
+} TrajectoryFrameHeader;
+
+typedef struct TrajectoryIndexHeader
+{
+	uint32_t magic;
+	uint32_t chunkCount;
+	uint32_t frameCount;
+	uint32_t reserved;
+} TrajectoryIndexHeader;
+
+typedef struct TrajectoryChunk
+{
+	uint64_t offset;     /* of its keyframe, from the start of the file */
+	uint32_t firstFrame; /* position in the file, counting from 0 */
+	uint32_t frameCount;
+} TrajectoryChunk;
+
+typedef struct TrajectoryFrameInfo
+{
+	uint32_t frame;
+	double t;
+	double seconds;
+	uint64_t size; /* bytes in the file, headers included */
+} TrajectoryFrameInfo;
+
+/* Writing. Not thread safe: one thread appends, see trajectory_export.h
+ * for the frame loop side.
+ */
+
+typedef struct TrajectoryWriter TrajectoryWriter;
+
+/* step is the quantization step of every field. Logs and returns NULL if
+ * the file cannot be created.
+ */
+TrajectoryWriter* TrajectoryWriter_Create(
+	const char *path,
+	uint32_t particleCount,
+	float step,
+	uint32_t framesPerChunk
+);
+
+/* Writes the chunk index and closes the file. Returns false if any write
+ * failed.
+ */
+bool TrajectoryWriter_Close(TrajectoryWriter *writer);
+
+/* Encodes and appends one frame. Returns false if the write failed. */
+bool TrajectoryWriter_Append(
+	TrajectoryWriter *writer,
+	const Particle *particles,
+	uint32_t frame,
+	double t
+);
+
+uint32_t TrajectoryWriter_GetFrameCount(TrajectoryWriter *writer);
+uint64_t TrajectoryWriter_GetSize(TrajectoryWriter *writer);
+
+/* Reading */
+
+typedef struct TrajectoryReader TrajectoryReader;
+
+/* Maps the file. Logs and returns NULL if it is not a version
+ * TRAJECTORY_VERSION trajectory.
+ */
+TrajectoryReader* TrajectoryReader_Open(const char *path);
+void TrajectoryReader_Close(TrajectoryReader *reader);
+
+const TrajectoryHeader* TrajectoryReader_GetHeader(TrajectoryReader *reader);
+uint32_t TrajectoryReader_GetFrameCount(TrajectoryReader *reader);
+uint32_t TrajectoryReader_GetChunkCount(TrajectoryReader *reader);
+
+/* False if the file had no index and the chunks were found by scanning */
+bool TrajectoryReader_HasIndex(TrajectoryReader *reader);
+
+/* Decodes frame index (its position in the file) into particleCount
+ * Particles; info may be NULL. Decoding starts at the frame's chunk, or
+ * continues from the last frame read when that is in the same chunk and
+ * earlier, so reading in order decodes every frame once. Logs and returns
+ * false for a corrupt frame.
+ */
+bool TrajectoryReader_ReadFrame(
+	TrajectoryReader *reader,
+	uint32_t index,
+	Particle *particles,
+	TrajectoryFrameInfo *info
+);
+
+#endif /* TRAJECTORY_H */
@@ -0,0 +1,349 @@
+#include "trajectory_export.h"
+
+#include <SDL.h>
+
+#include "bench.h"
+#include "particle_snapshot.h"
+#include "readback_ring.h"
+#include "trace.h"
+#include "trajectory.h"
+
+/* Stream blocks shared between the queue and the worker; bounds memory use */
+#define TRAJECTORY_EXPORT_QUEUE_SIZE 4
+
+typedef struct TrajectoryExportSlot
+{
+	ParticleSnapshot snapshot;
+	uint32_t frame;
+	double t;
+} TrajectoryExportSlot;
+
+typedef struct TrajectoryExportJob
+{
+	uint8_t *block; /* every stream back to back, as in the snapshot */
+	uint32_t frame;
+	double t;
+} TrajectoryExportJob;
+
+struct TrajectoryExport
+{
+	ParticleLayout layout;
+	uint32_t particleCount;
+	uint32_t streamCount;
+	uint32_t streamOffsets[MAX_PARTICLE_BUFFERS]; /* within a block */
+	uint32_t blockSize;
+
+	/* One per ring slot */
+	ReadbackRing ring;
+	TrajectoryExportSlot *slots;
+
+	/* Only touched by the worker */
+	TrajectoryWriter *writer;
+	Particle *particles;
+
+	/* Everything below is guarded by mutex */
+	SDL_mutex *mutex;
+	SDL_cond *jobAvailable;
+	SDL_cond *blockAvailable;
+	TrajectoryExportJob jobs[TRAJECTORY_EXPORT_QUEUE_SIZE];
+	uint32_t jobHead;
+	uint32_t jobCount;
+	uint8_t *freeBlocks[TRAJECTORY_EXPORT_QUEUE_SIZE];
+	uint32_t freeBlockCount;
+	bool shutdown;
+	TrajectoryExportStats stats;
+
+	SDL_Thread *thread;
+};
+
+static int TrajectoryExport_WorkerMain(void *data)
+{
+	TrajectoryExport *trajectoryExport = (TrajectoryExport*) data;
+	TrajectoryExportJob job;
+	const uint8_t *streams[MAX_PARTICLE_BUFFERS];
+	uint32_t i;
+	bool written;
+
+	Trace_SetThreadName("trajectory export");
+
+	SDL_LockMutex(trajectoryExport->mutex);
+
+	for (;;)
+	{
+		while (trajectoryExport->jobCount == 0 && !trajectoryExport->shutdown)
+		{
+			SDL_CondWait(trajectoryExport->jobAvailable, trajectoryExport->mutex);
+		}
+
+		/* Shutdown only takes effect once the queue is drained */
+		if (trajectoryExport->jobCount == 0)
+		{
+			break;
+		}
+
+		job = trajectoryExport->jobs[trajectoryExport->jobHead];
+		trajectoryExport->jobHead = (trajectoryExport->jobHead + 1) % TRAJECTORY_EXPORT_QUEUE_SIZE;
+		trajectoryExport->jobCount -= 1;
+
+		SDL_UnlockMutex(trajectoryExport->mutex);
+
+		TRACE_BEGIN(encodeScope, "encode trajectory frame");
+		for (i = 0; i < trajectoryExport->streamCount; i += 1)
+		{
+			streams[i] = job.block + trajectoryExport->streamOffsets[i];
+		}
+		ParticleLayout_DecodeStreams(trajectoryExport->layout, streams, trajectoryExport->particleCount, trajectoryExport->particles);
+		written = TrajectoryWriter_Append(trajectoryExport->writer, trajectoryExport->particles, job.frame, job.t);
+		TRACE_END(encodeScope);
+
+		SDL_LockMutex(trajectoryExport->mutex);
+
+		trajectoryExport->freeBlocks[trajectoryExport->freeBlockCount] = job.block;
+		trajectoryExport->freeBlockCount += 1;
+		if (written)
+		{
+			trajectoryExport->stats.written += 1;
+		}
+		else
+		{
+			trajectoryExport->stats.failed += 1;
+		}
+		SDL_CondSignal(trajectoryExport->blockAvailable);
+	}
+
+	SDL_UnlockMutex(trajectoryExport->mutex);
+
+	return 0;
+}
+
+TrajectoryExport* TrajectoryExport_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ParticleBuffers *particleBuffers,
+	const char *path,
+	float step,
+	uint32_t framesPerChunk,
+	uint32_t latency
+) {
+	uint32_t i;
+	bool created = true;
+	TrajectoryExport *trajectoryExport;
+	TrajectoryWriter *writer = TrajectoryWriter_Create(path, particleBuffers->particleCount, step, framesPerChunk);
+
+	if (writer == NULL)
+	{
+		return NULL;
+	}
+
+	trajectoryExport = SDL_malloc(sizeof(TrajectoryExport));
+	SDL_zerop(trajectoryExport);
+
+	trajectoryExport->writer = writer;
+	trajectoryExport->layout = particleBuffers->layout;
+	trajectoryExport->particleCount = particleBuffers->particleCount;
+	trajectoryExport->streamCount = particleBuffers->bufferCount;
+
+	for (i = 0; i < particleBuffers->bufferCount; i += 1)
+	{
+		trajectoryExport->streamOffsets[i] = trajectoryExport->blockSize;
+		trajectoryExport->blockSize += particleBuffers->bufferSizes[i];
+	}
+
+	ReadbackRing_Create(&trajectoryExport->ring, latency, 0);
+	trajectoryExport->slots = SDL_malloc(sizeof(TrajectoryExportSlot) * trajectoryExport->ring.slotCount);
+	SDL_memset(trajectoryExport->slots, 0, sizeof(TrajectoryExportSlot) * trajectoryExport->ring.slotCount);
+
+	for (i = 0; i < trajectoryExport->ring.slotCount; i += 1)
+	{
+		created = ParticleSnapshot_Create(device, shaderCache, &trajectoryExport->slots[i].snapshot, particleBuffers) && created;
+	}
+
+	if (!created)
+	{
+		for (i = 0; i < trajectoryExport->ring.slotCount; i += 1)
+		{
+			ParticleSnapshot_Destroy(device, &trajectoryExport->slots[i].snapshot);
+		}
+		TrajectoryWriter_Close(writer);
+		ReadbackRing_Destroy(&trajectoryExport->ring);
+		SDL_free(trajectoryExport->slots);
+		SDL_free(trajectoryExport);
+		return NULL;
+	}
+
+	trajectoryExport->particles = SDL_malloc(sizeof(Particle) * SDL_max(trajectoryExport->particleCount, 1));
+
+	for (i = 0; i < TRAJECTORY_EXPORT_QUEUE_SIZE; i += 1)
+	{
+		trajectoryExport->freeBlocks[i] = SDL_malloc(trajectoryExport->blockSize);
+	}
+	trajectoryExport->freeBlockCount = TRAJECTORY_EXPORT_QUEUE_SIZE;
+
+	trajectoryExport->mutex = SDL_CreateMutex();
+	trajectoryExport->jobAvailable = SDL_CreateCond();
+	trajectoryExport->blockAvailable = SDL_CreateCond();
+	trajectoryExport->thread = SDL_CreateThread(TrajectoryExport_WorkerMain, "TrajectoryExport", trajectoryExport);
+
+	return trajectoryExport;
+}
+
+/* Reads a retired slot back and queues it for encoding, waiting for a free
+ * block if the encoder is behind
+ */
+static void TrajectoryExport_RetireSlot(TrajectoryExport *trajectoryExport, REFRESH_Device *device, uint32_t slotIndex)
+{
+	TrajectoryExportSlot *slot = &trajectoryExport->slots[slotIndex];
+	TrajectoryExportJob *job;
+	uint8_t *streams[MAX_PARTICLE_BUFFERS];
+	uint8_t *block;
+	uint64_t waitStart;
+	uint32_t i;
+
+	TRACE_BEGIN(retireScope, "trajectory readback");
+
+	SDL_LockMutex(trajectoryExport->mutex);
+
+	if (trajectoryExport->freeBlockCount == 0)
+	{
+		waitStart = Bench_Now();
+		while (trajectoryExport->freeBlockCount == 0)
+		{
+			SDL_CondWait(trajectoryExport->blockAvailable, trajectoryExport->mutex);
+		}
+		trajectoryExport->stats.encoderWaitSeconds += Bench_Seconds(waitStart, Bench_Now());
+	}
+
+	trajectoryExport->freeBlockCount -= 1;
+	block = trajectoryExport->freeBlocks[trajectoryExport->freeBlockCount];
+
+	SDL_UnlockMutex(trajectoryExport->mutex);
+
+	for (i = 0; i < trajectoryExport->streamCount; i += 1)
+	{
+		streams[i] = block + trajectoryExport->streamOffsets[i];
+	}
+	ParticleSnapshot_Download(device, &slot->snapshot, streams);
+
+	SDL_LockMutex(trajectoryExport->mutex);
+
+	job = &trajectoryExport->jobs[(trajectoryExport->jobHead + trajectoryExport->jobCount) % TRAJECTORY_EXPORT_QUEUE_SIZE];
+	job->block = block;
+	job->frame = slot->frame;
+	job->t = slot->t;
+	trajectoryExport->jobCount += 1;
+	SDL_CondSignal(trajectoryExport->jobAvailable);
+
+	SDL_UnlockMutex(trajectoryExport->mutex);
+
+	TRACE_END(retireScope);
+}
+
+void TrajectoryExport_Destroy(REFRESH_Device *device, TrajectoryExport *trajectoryExport)
+{
+	uint32_t i, slotIndex;
+	uint32_t frameCount;
+	uint64_t size;
+
+	if (trajectoryExport == NULL)
+	{
+		return;
+	}
+
+	REFRESH_Wait(device);
+
+	while (ReadbackRing_Retire(&trajectoryExport->ring, true, &slotIndex))
+	{
+		TrajectoryExport_RetireSlot(trajectoryExport, device, slotIndex);
+	}
+
+	SDL_LockMutex(trajectoryExport->mutex);
+	trajectoryExport->shutdown = true;
+	SDL_CondSignal(trajectoryExport->jobAvailable);
+	SDL_UnlockMutex(trajectoryExport->mutex);
+
+	SDL_WaitThread(trajectoryExport->thread, NULL);
+
+	frameCount = TrajectoryWriter_GetFrameCount(trajectoryExport->writer);
+	size = TrajectoryWriter_GetSize(trajectoryExport->writer);
+	if (!TrajectoryWriter_Close(trajectoryExport->writer))
+	{
+		SDL_Log("Trajectory export: the file could not be written completely");
+	}
+
+	SDL_Log(
+		"Trajectory export: %u frames written, %.2f bytes per particle per frame, %u dropped, %u failed, %.3f s waiting on the encoder",
+		frameCount,
+		(frameCount > 0 && trajectoryExport->particleCount > 0) ? (double) size / frameCount / trajectoryExport->particleCount : 0.0,
+		trajectoryExport->stats.droppedNoSlot,
+		trajectoryExport->stats.failed,
+		trajectoryExport->stats.encoderWaitSeconds
+	);
+
+	for (i = 0; i < trajectoryExport->ring.slotCount; i += 1)
+	{
+		ParticleSnapshot_Destroy(device, &trajectoryExport->slots[i].snapshot);
+	}
+
+	for (i = 0; i < trajectoryExport->freeBlockCount; i += 1)
+	{
+		SDL_free(trajectoryExport->freeBlocks[i]);
+	}
+
+	SDL_DestroyCond(trajectoryExport->blockAvailable);
+	SDL_DestroyCond(trajectoryExport->jobAvailable);
+	SDL_DestroyMutex(trajectoryExport->mutex);
+	SDL_free(trajectoryExport->particles);
+	ReadbackRing_Destroy(&trajectoryExport->ring);
+	SDL_free(trajectoryExport->slots);
+	SDL_free(trajectoryExport);
+}
+
+bool TrajectoryExport_Record(
+	TrajectoryExport *trajectoryExport,
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	uint32_t frame,
+	double t
+) {
+	TrajectoryExportSlot *slot;
+	bool canRecord = ReadbackRing_CanRecord(&trajectoryExport->ring);
+
+	SDL_LockMutex(trajectoryExport->mutex);
+	trajectoryExport->stats.requested += 1;
+	if (!canRecord)
+	{
+		trajectoryExport->stats.droppedNoSlot += 1;
+	}
+	SDL_UnlockMutex(trajectoryExport->mutex);
+
+	if (!canRecord)
+	{
+		return false;
+	}
+
+	slot = &trajectoryExport->slots[ReadbackRing_Record(&trajectoryExport->ring)];
+	ParticleSnapshot_Record(device, commandBuffer, &slot->snapshot);
+	slot->frame = frame;
+	slot->t = t;
+
+	return true;
+}
+
+void TrajectoryExport_EndFrame(TrajectoryExport *trajectoryExport, REFRESH_Device *device)
+{
+	uint32_t slotIndex;
+
+	while (ReadbackRing_Retire(&trajectoryExport->ring, false, &slotIndex))
+	{
+		TrajectoryExport_RetireSlot(trajectoryExport, device, slotIndex);
+	}
+
+	ReadbackRing_EndFrame(&trajectoryExport->ring);
+}
+
+void TrajectoryExport_GetStats(TrajectoryExport *trajectoryExport, TrajectoryExportStats *stats)
+{
+	SDL_LockMutex(trajectoryExport->mutex);
+	*stats = trajectoryExport->stats;
+	SDL_UnlockMutex(trajectoryExport->mutex);
+}
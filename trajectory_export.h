@@ -0,0 +1,76 @@
+#ifndef TRAJECTORY_EXPORT_H
+#define TRAJECTORY_EXPORT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <Refresh.h>
+
+#include "particle_buffers.h"
+#include "shader_module.h"
+
+/* Streams the GPU particles into a trajectory file (trajectory.h) while the
+ * simulation runs.
+ *
+ * Each exported frame records a ParticleSnapshot into a slot of a readback
+ * ring (readback_ring.h), read back once `latency` more frames have been
+ * submitted. A worker thread decodes the layout,
+ * encodes the frame and appends it to the file.
+ *
+ * A trajectory with holes is of little use, so unlike FrameCapture a full
+ * queue does not drop frames: the readback waits for the encoder to free a
+ * block, and the time spent waiting is reported. Only a frame whose ring
+ * slot is still in flight is dropped, which cannot happen when EndFrame is
+ * called every frame.
+ */
+
+typedef struct TrajectoryExport TrajectoryExport;
+
+typedef struct TrajectoryExportStats
+{
+	uint32_t requested;
+	uint32_t written;
+	uint32_t droppedNoSlot; /* every snapshot still in flight */
+	uint32_t failed;        /* the write failed */
+	double encoderWaitSeconds; /* frame thread waiting on a full queue */
+} TrajectoryExportStats;
+
+/* step is the quantization step of every field, framesPerChunk the
+ * distance between keyframes. Returns NULL if the file cannot be created
+ * or the snapshot shader could not be loaded.
+ */
+TrajectoryExport* TrajectoryExport_Create(
+	REFRESH_Device *device,
+	ShaderCache *shaderCache,
+	ParticleBuffers *particleBuffers,
+	const char *path,
+	float step,
+	uint32_t framesPerChunk,
+	uint32_t latency
+);
+
+/* Waits for the device, writes every outstanding frame, closes the file
+ * with its chunk index, joins the worker and logs the stats
+ */
+void TrajectoryExport_Destroy(REFRESH_Device *device, TrajectoryExport *trajectoryExport);
+
+/* Records a snapshot of the particles into commandBuffer, after everything
+ * that updates them this frame. frame and t are stored with it. Returns
+ * false if the frame had to be dropped.
+ */
+bool TrajectoryExport_Record(
+	TrajectoryExport *trajectoryExport,
+	REFRESH_Device *device,
+	REFRESH_CommandBuffer *commandBuffer,
+	uint32_t frame,
+	double t
+);
+
+/* Call once per frame after REFRESH_Submit. Hands every snapshot that is
+ * at least `latency` frames old to the worker thread.
+ */
+void TrajectoryExport_EndFrame(TrajectoryExport *trajectoryExport, REFRESH_Device *device);
+
+void TrajectoryExport_GetStats(TrajectoryExport *trajectoryExport, TrajectoryExportStats *stats);
+
+#endif /* TRAJECTORY_EXPORT_H */
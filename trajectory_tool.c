@@ -0,0 +1,187 @@
+/* Inspects trajectory files written by --export.
+ *
+ * Usage: TrajectoryTool <file> [--frame N] [--csv PATH]
+ *
+ * Prints a summary of the file: its frames, chunks and how well they
+ * compressed. With --frame, frame N (its position in the file) is decoded
+ * through the chunk index and described; with --csv as well, its particles
+ * are written to PATH, one per row.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+
+#include "trajectory.h"
+
+static void TrajectoryTool_Usage(const char *program)
+{
+	fprintf(stderr, "Usage: %s <file> [--frame N] [--csv PATH]\n", program);
+}
+
+static bool TrajectoryTool_WriteCSV(const char *path, const Particle *particles, uint32_t particleCount)
+{
+	FILE *file = fopen(path, "w");
+	uint32_t i;
+	bool written;
+
+	if (file == NULL)
+	{
+		fprintf(stderr, "Could not open %s for writing\n", path);
+		return false;
+	}
+
+	fprintf(file, "index,x,y,vx,vy,gradient\n");
+	for (i = 0; i < particleCount; i += 1)
+	{
+		fprintf(
+			file,
+			"%u,%.9g,%.9g,%.9g,%.9g,%.9g\n",
+			i,
+			particles[i].xPosition,
+			particles[i].yPosition,
+			particles[i].xVelocity,
+			particles[i].yVelocity,
+			particles[i].gradientPosition
+		);
+	}
+
+	written = !ferror(file);
+	written = (fclose(file) == 0) && written;
+	if (!written)
+	{
+		fprintf(stderr, "Could not write %s\n", path);
+	}
+	return written;
+}
+
+static void TrajectoryTool_PrintSummary(TrajectoryReader *reader, const char *path, Particle *particles)
+{
+	const TrajectoryHeader *header = TrajectoryReader_GetHeader(reader);
+	uint32_t frameCount = TrajectoryReader_GetFrameCount(reader);
+	TrajectoryFrameInfo first, last;
+	uint64_t fileSize = 0;
+	SDL_RWops *file;
+
+	if ((file = SDL_RWFromFile(path, "rb")) != NULL)
+	{
+		fileSize = (uint64_t) SDL_RWsize(file);
+		SDL_RWclose(file);
+	}
+
+	printf("%s\n", path);
+	printf("  particles         %u\n", header->particleCount);
+	printf("  frames            %u\n", frameCount);
+	printf(
+		"  chunks            %u of up to %u frames (%s)\n",
+		TrajectoryReader_GetChunkCount(reader),
+		header->framesPerChunk,
+		TrajectoryReader_HasIndex(reader) ? "indexed" : "no index, scanned"
+	);
+	printf("  quantization step %g\n", header->fieldStep[0]);
+	printf("  file size         %llu bytes\n", (unsigned long long) fileSize);
+
+	if (frameCount == 0 || header->particleCount == 0)
+	{
+		return;
+	}
+
+	printf(
+		"  per particle      %.2f bytes per frame, %.2f uncompressed\n",
+		(double) fileSize / frameCount / header->particleCount,
+		(double) sizeof(float) * TRAJECTORY_FIELD_COUNT
+	);
+
+	/* The first and last frame are a keyframe and whatever follows the
+	 * last chunk's keyframe, so this touches at most two chunks
+	 */
+	if (TrajectoryReader_ReadFrame(reader, 0, particles, &first) &&
+		TrajectoryReader_ReadFrame(reader, frameCount - 1, particles, &last))
+	{
+		printf("  program frames    %u to %u\n", first.frame, last.frame);
+		printf("  simulation time   %.4f to %.4f\n", first.t, last.t);
+		printf("  recorded over     %.3f s\n", last.seconds - first.seconds);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = NULL;
+	const char *csvPath = NULL;
+	int64_t frameIndex = -1;
+	TrajectoryReader *reader;
+	TrajectoryFrameInfo info;
+	Particle *particles;
+	int result = 0;
+	int i;
+
+	for (i = 1; i < argc; i += 1)
+	{
+		if (strcmp(argv[i], "--frame") == 0 && i + 1 < argc)
+		{
+			frameIndex = strtoll(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+		{
+			csvPath = argv[++i];
+		}
+		else if (argv[i][0] != '-' && path == NULL)
+		{
+			path = argv[i];
+		}
+		else
+		{
+			TrajectoryTool_Usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (path == NULL || (csvPath != NULL && frameIndex < 0))
+	{
+		TrajectoryTool_Usage(argv[0]);
+		return 1;
+	}
+
+	if ((reader = TrajectoryReader_Open(path)) == NULL)
+	{
+		return 1;
+	}
+
+	particles = malloc(sizeof(Particle) * SDL_max(TrajectoryReader_GetHeader(reader)->particleCount, 1));
+
+	if (frameIndex < 0)
+	{
+		TrajectoryTool_PrintSummary(reader, path, particles);
+	}
+	else if (frameIndex >= TrajectoryReader_GetFrameCount(reader))
+	{
+		fprintf(stderr, "%s has %u frames\n", path, TrajectoryReader_GetFrameCount(reader));
+		result = 1;
+	}
+	else if (!TrajectoryReader_ReadFrame(reader, (uint32_t) frameIndex, particles, &info))
+	{
+		result = 1;
+	}
+	else
+	{
+		printf(
+			"frame %u: program frame %u, t = %.4f, %.3f s into the recording, %llu bytes\n",
+			(uint32_t) frameIndex,
+			info.frame,
+			info.t,
+			info.seconds,
+			(unsigned long long) info.size
+		);
+
+		if (csvPath != NULL && !TrajectoryTool_WriteCSV(csvPath, particles, TrajectoryReader_GetHeader(reader)->particleCount))
+		{
+			result = 1;
+		}
+	}
+
+	free(particles);
+	TrajectoryReader_Close(reader);
+	return result;
+}